@@ -6,8 +6,11 @@ SSL_VERSION=3.5.3
 CRYPTO_VERSION=3.5.3
 CARES_VERSION=1.18.1
 CURL_VERSION=7.86.0
+NGHTTP2_VERSION=1.51.0
 PACPARSER_VERSION=1.3.8
 ZLIB_VERSION=1.2.8
+ZSTD_VERSION=1.5.5
+LZ4_VERSION=1.9.4
 SPARSEHASH_VERSION=1.12
 LEVELDB_VERSION=1.18
 GOOGLETEST_VERSION=1.8.0
@@ -166,6 +169,13 @@ build_lib() {
       do_extract "c-ares" "c-ares-${CARES_VERSION}.tar.gz"
       do_build "c-ares"
 
+      # The nghttp2 release tarball is not yet part of externals/
+      if [ x"$ENABLE_HTTP2" != x"" ]; then
+        rm -rf $externals_build_dir/build_nghttp2
+        do_extract "nghttp2" "nghttp2-${NGHTTP2_VERSION}.tar.gz"
+        do_build "nghttp2"
+      fi
+
       do_extract "libcurl" "curl-${CURL_VERSION}.tar.bz2"
       patch_external "libcurl" "reenable_poll_darwin.patch"
       do_build "libcurl"
@@ -183,6 +193,18 @@ build_lib() {
       do_extract "zlib"         "zlib-${ZLIB_VERSION}.tar.gz"
       do_build "zlib"
       ;;
+    zstd)
+      if [ x"$ENABLE_ZSTD_LZ4" != x"" ]; then
+        do_extract "zstd"       "zstd-${ZSTD_VERSION}.tar.gz"
+        do_build "zstd"
+      fi
+      ;;
+    lz4)
+      if [ x"$ENABLE_ZSTD_LZ4" != x"" ]; then
+        do_extract "lz4"        "lz4-${LZ4_VERSION}.tar.gz"
+        do_build "lz4"
+      fi
+      ;;
     sparsehash)
       do_extract "sparsehash"   "sparsehash-${SPARSEHASH_VERSION}.tar.gz"
       patch_external "sparsehash"  "fix_sl4_compilation.patch"          \
@@ -270,6 +292,10 @@ missing_libs="libcurl libcrypto pacparser zlib sparsehash leveldb googletest ipa
 if [ x"$BUILD_QC_TESTS" != x"" ]; then
     missing_libs="$missing_libs rapidcheck"
 fi
+# The zstd and lz4 release tarballs are not yet part of externals/
+if [ x"$ENABLE_ZSTD_LZ4" != x"" ]; then
+    missing_libs="$missing_libs zstd lz4"
+fi
 if [ x"$BUILD_GATEWAY" != x ] || [ x"$BUILD_DUCC" != x ] || [ x"$BUILD_SNAPSHOTTER" != x ]; then
     missing_libs="$missing_libs go"
 fi
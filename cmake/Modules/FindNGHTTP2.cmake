@@ -0,0 +1,32 @@
+# - Try to find nghttp2
+#
+# Once done this will define
+#
+#  NGHTTP2_FOUND - system has nghttp2
+#  NGHTTP2_INCLUDE_DIRS - the nghttp2 include directory
+#  NGHTTP2_LIBRARIES - Link these to use nghttp2
+#
+
+find_path(
+    NGHTTP2_INCLUDE_DIRS
+    NAMES nghttp2/nghttp2.h
+    HINTS ${NGHTTP2_INCLUDE_DIRS}
+)
+
+find_library(
+    NGHTTP2_LIBRARIES
+    NAMES nghttp2
+    HINTS ${NGHTTP2_LIBRARY_DIRS}
+)
+
+include(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(
+    NGHTTP2
+    DEFAULT_MSG
+    NGHTTP2_LIBRARIES
+    NGHTTP2_INCLUDE_DIRS
+)
+
+if(NGHTTP2_FOUND)
+    mark_as_advanced(NGHTTP2_LIBRARIES NGHTTP2_INCLUDE_DIRS)
+endif()
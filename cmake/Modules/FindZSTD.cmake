@@ -0,0 +1,32 @@
+# - Try to find Zstandard
+#
+# Once done this will define
+#
+#  ZSTD_FOUND - system has Zstandard
+#  ZSTD_INCLUDE_DIRS - the Zstandard include directory
+#  ZSTD_LIBRARIES - Link these to use Zstandard
+#
+
+find_path(
+    ZSTD_INCLUDE_DIRS
+    NAMES zstd.h
+    HINTS ${ZSTD_INCLUDE_DIRS}
+)
+
+find_library(
+    ZSTD_LIBRARIES
+    NAMES zstd
+    HINTS ${ZSTD_LIBRARY_DIRS}
+)
+
+include(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(
+    ZSTD
+    DEFAULT_MSG
+    ZSTD_LIBRARIES
+    ZSTD_INCLUDE_DIRS
+)
+
+if(ZSTD_FOUND)
+    mark_as_advanced(ZSTD_LIBRARIES ZSTD_INCLUDE_DIRS)
+endif()
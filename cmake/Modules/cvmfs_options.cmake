@@ -28,6 +28,8 @@ option (BUILD_COVERAGE          "Compile to collect code coverage reports"
 option (BUILD_ALL               "Build client, server, lib, preload, shrinkwrap, unit tests"       OFF)
 
 option (ENABLE_ASAN             "Enable the Address Sanitizer"                                     OFF)
+option (ENABLE_ZSTD_LZ4         "Support the zstd and lz4 compression algorithms"                  OFF)
+option (ENABLE_HTTP2            "Build the built-in libcurl with HTTP/2 support (nghttp2)"         OFF)
 
 option (INSTALL_UNITTESTS       "Install the unit test binary (mainly for packaging)"              OFF)
 option (INSTALL_UNITTESTS_DEBUG "Install the unit test debug binary"                               OFF)
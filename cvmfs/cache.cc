@@ -101,9 +101,11 @@ void CacheManager::FreeState(const int fd_progress, void *data) {
   State *state = reinterpret_cast<State *>(data);
   if (fd_progress >= 0)
     SendMsg2Socket(fd_progress, "Releasing saved open files table\n");
-  assert(state->version == kStateVersion);
+  assert(state->version <= kStateVersion);
   assert(state->manager_type == id());
-  bool result = DoFreeState(state->concrete_state);
+  bool result = (state->version == kStateVersion)
+    ? DoFreeState(state->concrete_state)
+    : DoFreeOldState(state->concrete_state, state->version);
   if (!result) {
     if (fd_progress >= 0) {
       SendMsg2Socket(fd_progress,
@@ -195,7 +197,7 @@ int CacheManager::RestoreState(const int fd_progress, void *data) {
   State *state = reinterpret_cast<State *>(data);
   if (fd_progress >= 0)
     SendMsg2Socket(fd_progress, "Restoring open files table... ");
-  if (state->version != kStateVersion) {
+  if (state->version > kStateVersion) {
     if (fd_progress >= 0)
       SendMsg2Socket(fd_progress, "unsupported state version!\n");
     abort();
@@ -205,7 +207,9 @@ int CacheManager::RestoreState(const int fd_progress, void *data) {
       SendMsg2Socket(fd_progress, "switching cache manager unsupported!\n");
     abort();
   }
-  int new_root_fd = DoRestoreState(state->concrete_state);
+  int new_root_fd = (state->version == kStateVersion)
+    ? DoRestoreState(state->concrete_state)
+    : DoRestoreOldState(state->concrete_state, state->version);
   if (new_root_fd < -1) {
     if (fd_progress >= 0) SendMsg2Socket(fd_progress, "FAILED!\n");
     abort();
@@ -170,6 +170,12 @@ class CacheManager : SingleCopy {
   virtual int64_t Pread(int fd, void *buf, uint64_t size, uint64_t offset) = 0;
   virtual int Dup(int fd) = 0;
   virtual int Readahead(int fd) = 0;
+  /**
+   * True if the file descriptors returned by Open() are file descriptors of the
+   * operating system.  Only then can they be handed to the kernel, e.g. for
+   * splicing read replies or for fuse passthrough.
+   */
+  virtual bool HasNativeFds() { return false; }
 
   virtual uint32_t SizeOfTxn() = 0;
   virtual int StartTxn(const shash::Any &id, uint64_t size, void *txn) = 0;
@@ -230,6 +236,16 @@ class CacheManager : SingleCopy {
   virtual void *DoSaveState() { return NULL; }
   virtual int DoRestoreState(void *data) { return false; }
   virtual bool DoFreeState(void *data) { return false; }
+  /**
+   * Used for states saved by a cache manager with an older kStateVersion.
+   * Unless overwritten, the concrete state did not change with the version.
+   */
+  virtual int DoRestoreOldState(void *data, const unsigned version) {
+    return DoRestoreState(data);
+  }
+  virtual bool DoFreeOldState(void *data, const unsigned version) {
+    return DoFreeState(data);
+  }
 
   /**
    * Never NULL but defaults to NoopQuotaManager.
@@ -237,7 +253,11 @@ class CacheManager : SingleCopy {
   QuotaManager *quota_mgr_;
 
  private:
-  static const unsigned kStateVersion = 0;
+  /**
+   * 0 --> 1: file descriptors of the external cache manager carry the
+   *          location of the object in the shared memory region
+   */
+  static const unsigned kStateVersion = 1;
 
   /**
    * Wraps around the concrete cache manager's state block in memory.  The
@@ -8,21 +8,22 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <stdint.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
 #include <algorithm>
 #include <cassert>
-#ifdef __APPLE__
 #include <cstdlib>
-#endif
 #include <cstring>
 #include <map>
 #include <new>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "cache.pb.h"
+#include "compat.h"
 #include "crypto/hash.h"
 #include "util/atomic.h"
 #include "util/concurrency.h"
@@ -30,9 +31,7 @@
 #include "util/logging.h"
 #include "util/pointer.h"
 #include "util/posix.h"
-#ifdef __APPLE__
 #include "util/smalloc.h"
-#endif
 #include "util/string.h"
 
 using namespace std;  // NOLINT
@@ -68,6 +67,24 @@ int Ack2Errno(cvmfs::EnumStatus status_code) {
   }
 }
 
+/**
+ * A part of a ReadRange that is small enough to be transferred in a single
+ * reply.  Filled with the outcome once the reply arrived.
+ */
+struct ReadPiece {
+  ReadPiece(unsigned r, const shash::Any &i, char *b, uint64_t o, uint32_t s)
+    : range_idx(r), id(i), buf(b), offset(o), size(s)
+    , status(cvmfs::STATUS_UNKNOWN), nbytes(0) { }
+
+  unsigned range_idx;
+  shash::Any id;
+  char *buf;
+  uint64_t offset;
+  uint32_t size;
+  cvmfs::EnumStatus status;
+  uint32_t nbytes;
+};
+
 }  // anonymous namespace
 
 const shash::Any ExternalCacheManager::kInvalidHandle;
@@ -123,7 +140,48 @@ void ExternalCacheManager::CallRemotely(ExternalCacheManager::RpcJob *rpc_job) {
 }
 
 
-int ExternalCacheManager::ChangeRefcount(const shash::Any &id, int change_by) {
+/**
+ * Sends all the requests before waiting for the first reply, at most
+ * kMaxPipelineDepth at a time.  Replies can arrive in any order; the reader
+ * thread matches them by request id.  Before the reader thread is spawned, the
+ * requests are processed one by one.
+ */
+void ExternalCacheManager::CallRemotely(const vector<RpcJob *> &rpc_jobs) {
+  if (!spawned_) {
+    for (unsigned i = 0; i < rpc_jobs.size(); ++i)
+      CallRemotely(rpc_jobs[i]);
+    return;
+  }
+
+  Signal signals[kMaxPipelineDepth];
+  for (unsigned i = 0; i < rpc_jobs.size(); i += kMaxPipelineDepth) {
+    const unsigned depth = std::min(
+      static_cast<unsigned>(rpc_jobs.size()) - i, kMaxPipelineDepth);
+    {
+      MutexLockGuard guard(lock_inflight_rpcs_);
+      for (unsigned j = 0; j < depth; ++j)
+        inflight_rpcs_.push_back(RpcInFlight(rpc_jobs[i + j], &signals[j]));
+    }
+    {
+      MutexLockGuard guard(lock_send_fd_);
+      for (unsigned j = 0; j < depth; ++j)
+        transport_.SendFrame(rpc_jobs[i + j]->frame_send());
+    }
+    for (unsigned j = 0; j < depth; ++j)
+      signals[j].Wait();
+  }
+}
+
+
+/**
+ * If handle is given, it receives the location of the object in the shared
+ * memory region, provided that the plugin sent one.
+ */
+int ExternalCacheManager::ChangeRefcount(
+  const shash::Any &id,
+  int change_by,
+  ReadOnlyHandle *handle)
+{
   cvmfs::MsgHash object_id;
   transport_.FillMsgHash(id, &object_id);
   cvmfs::MsgRefcountReq msg_refcount;
@@ -136,6 +194,15 @@ int ExternalCacheManager::ChangeRefcount(const shash::Any &id, int change_by) {
   msg_refcount.release_object_id();
 
   cvmfs::MsgRefcountReply *msg_reply = rpc_job.msg_refcount_reply();
+  if ((handle != NULL) && (shm_region_ != NULL) &&
+      (msg_reply->status() == cvmfs::STATUS_OK) &&
+      msg_reply->has_shm_offset() && msg_reply->has_shm_size() &&
+      msg_reply->has_shm_generation())
+  {
+    handle->shm_offset = msg_reply->shm_offset();
+    handle->shm_size = msg_reply->shm_size();
+    handle->shm_generation = msg_reply->shm_generation();
+  }
   return Ack2Errno(msg_reply->status());
 }
 
@@ -233,6 +300,8 @@ ExternalCacheManager *ExternalCacheManager::Create(
   cache_mgr->session_id_ = msg_ack->session_id();
   cache_mgr->capabilities_ = msg_ack->capabilities();
   cache_mgr->max_object_size_ = msg_ack->max_object_size();
+  cache_mgr->protocol_version_ =
+    std::min(kPbProtocolVersion, msg_ack->protocol_version());
   assert(cache_mgr->max_object_size_ > 0);
   if (cache_mgr->max_object_size_ > kMaxSupportedObjectSize) {
     LogCvmfs(kLogCache, kLogDebug | kLogSyslogErr,
@@ -248,6 +317,22 @@ ExternalCacheManager *ExternalCacheManager::Create(
   }
   if (msg_ack->has_pid())
     cache_mgr->pid_plugin_ = msg_ack->pid();
+  if (msg_ack->has_shm_size()) {
+    // The plugin sends the region's file descriptor right after the ack
+    int fd_shm = RecvFdFromSocket(fd_connection);
+    if (fd_shm < 0) {
+      LogCvmfs(kLogCache, kLogDebug | kLogSyslogWarn,
+               "failed to receive shared memory region (%d)", fd_shm);
+      return NULL;
+    }
+    retval = cache_mgr->MapShm(fd_shm, msg_ack->shm_size());
+    close(fd_shm);
+    if (!retval) {
+      LogCvmfs(kLogCache, kLogDebug | kLogSyslogWarn,
+               "failed to map shared memory region of the cache plugin, "
+               "falling back to socket reads");
+    }
+  }
   return cache_mgr.Release();
 }
 
@@ -319,26 +404,27 @@ bool ExternalCacheManager::DoFreeState(void *data) {
 }
 
 
+/**
+ * Takes the reference first, so that the file descriptor is created together
+ * with the object's location in the shared memory region.
+ */
 int ExternalCacheManager::DoOpen(const shash::Any &id) {
+  ReadOnlyHandle handle(id);
+  int status_refcnt = ChangeRefcount(id, 1, &handle);
+  if (status_refcnt != 0)
+    return status_refcnt;
+
   int fd = -1;
   {
     WriteLockGuard guard(rwlock_fd_table_);
-    fd = fd_table_.OpenFd(ReadOnlyHandle(id));
-    if (fd < 0) {
-      LogCvmfs(kLogCache, kLogDebug, "error while creating new fd",
-               strerror(-fd));
-      return fd;
-    }
+    fd = fd_table_.OpenFd(handle);
   }
-
-  int status_refcnt = ChangeRefcount(id, 1);
-  if (status_refcnt == 0)
-    return fd;
-
-  WriteLockGuard guard(rwlock_fd_table_);
-  int retval = fd_table_.CloseFd(fd);
-  assert(retval == 0);
-  return status_refcnt;
+  if (fd < 0) {
+    LogCvmfs(kLogCache, kLogDebug, "error while creating new fd (%s)",
+             strerror(-fd));
+    ChangeRefcount(id, -1);
+  }
+  return fd;
 }
 
 
@@ -370,6 +456,31 @@ int ExternalCacheManager::DoRestoreState(void *data) {
 }
 
 
+/**
+ * Version 0 file descriptors do not know the shared memory location of the
+ * object.  The data of these file descriptors is read through the plugin.
+ */
+int ExternalCacheManager::DoRestoreOldState(
+  void *data,
+  const unsigned version)
+{
+  assert(version == 0);
+  FdTable<compat::cache_extern::ReadOnlyHandle> *old_fd_table =
+    reinterpret_cast<FdTable<compat::cache_extern::ReadOnlyHandle> *>(data);
+  FdTable<ReadOnlyHandle> fd_table(1, ReadOnlyHandle());
+  compat::cache_extern::Migrate(*old_fd_table, &fd_table);
+  return DoRestoreState(&fd_table);
+}
+
+
+bool ExternalCacheManager::DoFreeOldState(void *data, const unsigned version) {
+  assert(version == 0);
+  delete reinterpret_cast<FdTable<compat::cache_extern::ReadOnlyHandle> *>(
+    data);
+  return true;
+}
+
+
 void *ExternalCacheManager::DoSaveState() {
   cvmfs::MsgIoctl msg_ioctl;
   msg_ioctl.set_session_id(session_id_);
@@ -396,9 +507,12 @@ ExternalCacheManager::ExternalCacheManager(
   , transport_(fd_connection)
   , session_id_(-1)
   , max_object_size_(0)
+  , protocol_version_(0)
   , spawned_(false)
   , terminated_(false)
   , capabilities_(cvmfs::CAP_NONE)
+  , shm_region_(NULL)
+  , shm_region_size_(0)
 {
   int retval = pthread_rwlock_init(&rwlock_fd_table_, NULL);
   assert(retval == 0);
@@ -424,6 +538,8 @@ ExternalCacheManager::~ExternalCacheManager() {
   if (spawned_)
     pthread_join(thread_read_, NULL);
   close(transport_.fd_connection());
+  if (shm_region_ != NULL)
+    munmap(shm_region_, shm_region_size_);
   pthread_rwlock_destroy(&rwlock_fd_table_);
   pthread_mutex_destroy(&lock_send_fd_);
   pthread_mutex_destroy(&lock_inflight_rpcs_);
@@ -521,6 +637,8 @@ void *ExternalCacheManager::MainRead(void *data) {
       req_id = reinterpret_cast<cvmfs::MsgObjectInfoReply *>(msg)->req_id();
     } else if (msg->GetTypeName() == "cvmfs.MsgReadReply") {
       req_id = reinterpret_cast<cvmfs::MsgReadReply *>(msg)->req_id();
+    } else if (msg->GetTypeName() == "cvmfs.MsgReadvReply") {
+      req_id = reinterpret_cast<cvmfs::MsgReadvReply *>(msg)->req_id();
     } else if (msg->GetTypeName() == "cvmfs.MsgStoreReply") {
       req_id = reinterpret_cast<cvmfs::MsgStoreReply *>(msg)->req_id();
       part_nr = reinterpret_cast<cvmfs::MsgStoreReply *>(msg)->part_nr();
@@ -572,6 +690,26 @@ void *ExternalCacheManager::MainRead(void *data) {
 }
 
 
+bool ExternalCacheManager::MapShm(int fd_shm, uint64_t size) {
+  if (size <= CacheTransport::kShmHeaderSize)
+    return false;
+  void *region = mmap(NULL, size, PROT_READ, MAP_SHARED, fd_shm, 0);
+  if (region == MAP_FAILED)
+    return false;
+  const CacheTransport::ShmHeader *header =
+    reinterpret_cast<const CacheTransport::ShmHeader *>(region);
+  if (header->magic != CacheTransport::kShmMagic) {
+    munmap(region, size);
+    return false;
+  }
+  shm_region_ = reinterpret_cast<unsigned char *>(region);
+  shm_region_size_ = size;
+  LogCvmfs(kLogCache, kLogDebug, "mapped %" PRIu64 " bytes of cache plugin "
+           "shared memory", size);
+  return true;
+}
+
+
 int ExternalCacheManager::Open(const BlessedObject &object) {
   return DoOpen(object.id);
 }
@@ -606,39 +744,202 @@ int64_t ExternalCacheManager::Pread(
   uint64_t size,
   uint64_t offset)
 {
-  shash::Any id = GetHandle(fd);
-  if (id == kInvalidHandle)
-    return -EBADF;
+  vector<ReadRange> ranges(1, ReadRange(fd, buf, size, offset));
+  Preadv(&ranges);
+  return ranges[0].result;
+}
 
-  cvmfs::MsgHash object_id;
-  transport_.FillMsgHash(id, &object_id);
-  uint64_t nbytes = 0;
-  while (nbytes < size) {
-    uint64_t batch_size =
-      std::min(size - nbytes, static_cast<uint64_t>(max_object_size_));
-    cvmfs::MsgReadReq msg_read;
-    msg_read.set_session_id(session_id_);
-    msg_read.set_req_id(NextRequestId());
-    msg_read.set_allocated_object_id(&object_id);
-    msg_read.set_offset(offset + nbytes);
-    msg_read.set_size(batch_size);
-    RpcJob rpc_job(&msg_read);
-    rpc_job.set_attachment_recv(reinterpret_cast<char *>(buf) + nbytes,
-                                batch_size);
-    CallRemotely(&rpc_job);
-    msg_read.release_object_id();
-
-    cvmfs::MsgReadReply *msg_reply = rpc_job.msg_read_reply();
-    if (msg_reply->status() == cvmfs::STATUS_OK) {
-      nbytes += rpc_job.frame_recv()->att_size();
-      // Fuse sends in rounded up buffers, so short reads are expected
-      if (rpc_job.frame_recv()->att_size() < batch_size)
-        return nbytes;
+
+/**
+ * Reads several ranges, possibly from different objects, with as few round
+ * trips as possible.  Ranges are cut into pieces of at most max_object_size_.
+ * With protocol version 2, neighboring small pieces are packed into vectored
+ * read requests.  All the requests are pipelined.  Ranges of objects that the
+ * plugin exports through shared memory are copied directly from the mapping.
+ */
+void ExternalCacheManager::Preadv(vector<ReadRange> *ranges) {
+  vector<ReadPiece> pieces;
+  for (unsigned i = 0; i < ranges->size(); ++i) {
+    ReadRange *range = &(*ranges)[i];
+    range->result = 0;
+    ReadOnlyHandle handle;
+    {
+      ReadLockGuard guard(rwlock_fd_table_);
+      handle = fd_table_.GetHandle(range->fd);
+    }
+    const shash::Any &id = handle.id;
+    if (id == kInvalidHandle) {
+      range->result = -EBADF;
+      continue;
+    }
+    if (handle.HasShmLocation()) {
+      int64_t nbytes_shm =
+        ReadShm(handle, range->buf, range->size, range->offset);
+      if (nbytes_shm != -EAGAIN) {
+        range->result = nbytes_shm;
+        continue;
+      }
+    }
+    uint64_t nbytes = 0;
+    while (nbytes < range->size) {
+      uint64_t batch_size = std::min(range->size - nbytes,
+                                     static_cast<uint64_t>(max_object_size_));
+      pieces.push_back(ReadPiece(
+        i, id, reinterpret_cast<char *>(range->buf) + nbytes,
+        range->offset + nbytes, batch_size));
+      nbytes += batch_size;
+    }
+  }
+  if (pieces.empty())
+    return;
+
+  // Every request covers the pieces [first_piece[i], first_piece[i + 1])
+  vector<unsigned> first_piece;
+  vector<google::protobuf::MessageLite *> msgs;
+  vector<RpcJob *> rpc_jobs;
+  vector<char *> scratch_buffers;
+  unsigned idx = 0;
+  while (idx < pieces.size()) {
+    first_piece.push_back(idx);
+    uint64_t total_size = pieces[idx].size;
+    unsigned end = idx + 1;
+    if (protocol_version_ >= 2) {
+      while ((end < pieces.size()) &&
+             (total_size + pieces[end].size <= max_object_size_))
+      {
+        total_size += pieces[end].size;
+        end++;
+      }
+    }
+
+    if (end - idx == 1) {
+      cvmfs::MsgReadReq *msg_read = new cvmfs::MsgReadReq();
+      msg_read->set_session_id(session_id_);
+      msg_read->set_req_id(NextRequestId());
+      transport_.FillMsgHash(pieces[idx].id, msg_read->mutable_object_id());
+      msg_read->set_offset(pieces[idx].offset);
+      msg_read->set_size(pieces[idx].size);
+      RpcJob *rpc_job = new RpcJob(msg_read);
+      rpc_job->set_attachment_recv(pieces[idx].buf, pieces[idx].size);
+      msgs.push_back(msg_read);
+      rpc_jobs.push_back(rpc_job);
+      scratch_buffers.push_back(NULL);
     } else {
-      return Ack2Errno(msg_reply->status());
+      cvmfs::MsgReadvReq *msg_readv = new cvmfs::MsgReadvReq();
+      msg_readv->set_session_id(session_id_);
+      msg_readv->set_req_id(NextRequestId());
+      for (unsigned i = idx; i < end; ++i) {
+        cvmfs::MsgReadRange *msg_range = msg_readv->add_ranges();
+        transport_.FillMsgHash(pieces[i].id, msg_range->mutable_object_id());
+        msg_range->set_offset(pieces[i].offset);
+        msg_range->set_size(pieces[i].size);
+      }
+      char *scratch = reinterpret_cast<char *>(smalloc(total_size));
+      RpcJob *rpc_job = new RpcJob(msg_readv);
+      rpc_job->set_attachment_recv(scratch, total_size);
+      msgs.push_back(msg_readv);
+      rpc_jobs.push_back(rpc_job);
+      scratch_buffers.push_back(scratch);
+    }
+    idx = end;
+  }
+  first_piece.push_back(pieces.size());
+
+  CallRemotely(rpc_jobs);
+
+  for (unsigned i = 0; i < rpc_jobs.size(); ++i) {
+    const unsigned begin = first_piece[i];
+    const unsigned end = first_piece[i + 1];
+    if (scratch_buffers[i] == NULL) {
+      cvmfs::MsgReadReply *msg_reply = rpc_jobs[i]->msg_read_reply();
+      pieces[begin].status = msg_reply->status();
+      if (msg_reply->status() == cvmfs::STATUS_OK)
+        pieces[begin].nbytes = rpc_jobs[i]->frame_recv()->att_size();
+    } else {
+      cvmfs::MsgReadvReply *msg_reply = rpc_jobs[i]->msg_readv_reply();
+      cvmfs::EnumStatus status = msg_reply->status();
+      if ((status == cvmfs::STATUS_OK) &&
+          ((msg_reply->statuses_size() != static_cast<int>(end - begin)) ||
+           (msg_reply->sizes_size() != static_cast<int>(end - begin))))
+      {
+        status = cvmfs::STATUS_MALFORMED;
+      }
+      uint32_t pos = 0;
+      const uint32_t att_size = rpc_jobs[i]->frame_recv()->att_size();
+      for (unsigned j = begin; j < end; ++j) {
+        if (status != cvmfs::STATUS_OK) {
+          pieces[j].status = status;
+          continue;
+        }
+        pieces[j].status = msg_reply->statuses(j - begin);
+        const uint32_t nbytes = msg_reply->sizes(j - begin);
+        if ((nbytes > pieces[j].size) || (pos + nbytes > att_size)) {
+          pieces[j].status = cvmfs::STATUS_MALFORMED;
+          continue;
+        }
+        memcpy(pieces[j].buf, scratch_buffers[i] + pos, nbytes);
+        pieces[j].nbytes = nbytes;
+        pos += nbytes;
+      }
+      free(scratch_buffers[i]);
+    }
+    delete rpc_jobs[i];
+    delete msgs[i];
+  }
+
+  // Pieces of the same range are consecutive.  As with a single read, a short
+  // piece marks the end of the object.
+  vector<bool> is_complete(ranges->size(), false);
+  for (unsigned i = 0; i < pieces.size(); ++i) {
+    const unsigned r = pieces[i].range_idx;
+    if (is_complete[r])
+      continue;
+    if (pieces[i].status != cvmfs::STATUS_OK) {
+      (*ranges)[r].result = Ack2Errno(pieces[i].status);
+      is_complete[r] = true;
+      continue;
     }
+    (*ranges)[r].result += pieces[i].nbytes;
+    // Fuse sends in rounded up buffers, so short reads are expected
+    if (pieces[i].nbytes < pieces[i].size)
+      is_complete[r] = true;
   }
-  return size;
+}
+
+
+/**
+ * Copies directly from the plugin's shared memory region.  Returns -EAGAIN if
+ * the object's location is stale, i.e. the plugin moved data in the region
+ * since the object was opened or while copying.  In this case, the caller has
+ * to read through the socket.
+ */
+int64_t ExternalCacheManager::ReadShm(
+  const ReadOnlyHandle &handle,
+  void *buf,
+  uint64_t size,
+  uint64_t offset)
+{
+  if ((shm_region_ == NULL) || (handle.shm_offset > shm_region_size_) ||
+      (handle.shm_size > shm_region_size_ - handle.shm_offset))
+  {
+    return -EAGAIN;
+  }
+  // The region is mapped read-only, so the atomic_* functions cannot be used
+  volatile const int64_t *generation = &reinterpret_cast<
+    const CacheTransport::ShmHeader *>(shm_region_)->generation;
+  const int64_t generation_before = *generation;
+  __sync_synchronize();
+  if (generation_before != handle.shm_generation)
+    return -EAGAIN;
+  if (offset > handle.shm_size)
+    return -EINVAL;
+
+  const uint64_t nbytes = std::min(size, handle.shm_size - offset);
+  memcpy(buf, shm_region_ + handle.shm_offset + offset, nbytes);
+  __sync_synchronize();
+  if (*generation != generation_before)
+    return -EAGAIN;
+  return nbytes;
 }
 
 
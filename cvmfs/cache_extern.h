@@ -29,10 +29,28 @@
 
 class ExternalCacheManager : public CacheManager {
   FRIEND_TEST(T_ExternalCacheManager, TransactionAbort);
+  FRIEND_TEST(T_ExternalCacheManager, RestoreOldState);
   friend class ExternalQuotaManager;
 
  public:
-  static const unsigned kPbProtocolVersion = 1;
+  static const unsigned kPbProtocolVersion = 3;
+
+  /**
+   * One element of a vectored read.  On return, result is set to the number of
+   * bytes read or to a negative errno code, as it would be returned by Pread().
+   */
+  struct ReadRange {
+    ReadRange() : fd(-1), buf(NULL), size(0), offset(0), result(0) { }
+    ReadRange(int f, void *b, uint64_t s, uint64_t o)
+      : fd(f), buf(b), size(s), offset(o), result(0) { }
+
+    int fd;
+    void *buf;
+    uint64_t size;
+    uint64_t offset;
+    int64_t result;
+  };
+
   /**
    * Used for race-free startup of an external cache plugin.
    */
@@ -72,6 +90,7 @@ class ExternalCacheManager : public CacheManager {
   virtual int64_t Pread(int fd, void *buf, uint64_t size, uint64_t offset);
   virtual int Dup(int fd);
   virtual int Readahead(int fd);
+  void Preadv(std::vector<ReadRange> *ranges);
 
 #ifdef __APPLE__
   virtual uint32_t SizeOfTxn() { return sizeof(Transaction); }
@@ -98,12 +117,15 @@ class ExternalCacheManager : public CacheManager {
   int64_t session_id() const { return session_id_; }
   uint32_t max_object_size() const { return max_object_size_; }
   uint64_t capabilities() const { return capabilities_; }
+  unsigned protocol_version() const { return protocol_version_; }
   pid_t pid_plugin() const { return pid_plugin_; }
 
  protected:
   virtual void *DoSaveState();
   virtual int DoRestoreState(void *data);
   virtual bool DoFreeState(void *data);
+  virtual int DoRestoreOldState(void *data, const unsigned version);
+  virtual bool DoFreeOldState(void *data, const unsigned version);
 
  private:
   /**
@@ -120,6 +142,11 @@ class ExternalCacheManager : public CacheManager {
    * Statistically, at least half of our objects should not be further chunked.
    */
   static const unsigned kMinSupportedObjectSize = 4 * 1024;
+  /**
+   * Upper bound for the number of read requests that a single Preadv() call
+   * keeps in flight.
+   */
+  static const unsigned kMaxPipelineDepth = 32;
 
   struct Transaction {
     explicit Transaction(const shash::Any &id)
@@ -153,16 +180,27 @@ class ExternalCacheManager : public CacheManager {
     shash::Any id;
   };  // class Transaction
 
+  /**
+   * If the plugin exports its data through shared memory, the handle also
+   * carries the location of the object in the mapped region.  The location
+   * is only valid as long as the region's generation is unchanged.
+   */
   struct ReadOnlyHandle {
-    ReadOnlyHandle() : id(kInvalidHandle) { }
-    explicit ReadOnlyHandle(const shash::Any &h) : id(h) { }
+    ReadOnlyHandle()
+      : id(kInvalidHandle), shm_offset(0), shm_size(0), shm_generation(-1) { }
+    explicit ReadOnlyHandle(const shash::Any &h)
+      : id(h), shm_offset(0), shm_size(0), shm_generation(-1) { }
     bool operator ==(const ReadOnlyHandle &other) const {
       return this->id == other.id;
     }
     bool operator !=(const ReadOnlyHandle &other) const {
       return this->id != other.id;
     }
+    bool HasShmLocation() const { return shm_generation >= 0; }
     shash::Any id;
+    uint64_t shm_offset;
+    uint64_t shm_size;
+    int64_t shm_generation;
   };  // class ReadOnlyHandle
 
   class RpcJob {
@@ -173,6 +211,8 @@ class ExternalCacheManager : public CacheManager {
       : req_id_(msg->req_id()), part_nr_(0), msg_req_(msg), frame_send_(msg) { }
     explicit RpcJob(cvmfs::MsgReadReq *msg)
       : req_id_(msg->req_id()), part_nr_(0), msg_req_(msg), frame_send_(msg) { }
+    explicit RpcJob(cvmfs::MsgReadvReq *msg)
+      : req_id_(msg->req_id()), part_nr_(0), msg_req_(msg), frame_send_(msg) { }
     explicit RpcJob(cvmfs::MsgStoreReq *msg)
       : req_id_(msg->req_id()), part_nr_(msg->part_nr()), msg_req_(msg),
         frame_send_(msg) { }
@@ -219,6 +259,12 @@ class ExternalCacheManager : public CacheManager {
       assert(m->req_id() == req_id_);
       return m;
     }
+    cvmfs::MsgReadvReply *msg_readv_reply() {
+      cvmfs::MsgReadvReply *m = reinterpret_cast<cvmfs::MsgReadvReply *>(
+        frame_recv_.GetMsgTyped());
+      assert(m->req_id() == req_id_);
+      return m;
+    }
     cvmfs::MsgStoreReply *msg_store_reply() {
       cvmfs::MsgStoreReply *m = reinterpret_cast<cvmfs::MsgStoreReply *>(
         frame_recv_.GetMsgTyped());
@@ -280,9 +326,14 @@ class ExternalCacheManager : public CacheManager {
   explicit ExternalCacheManager(int fd_connection, unsigned max_open_fds);
   int64_t NextRequestId() { return atomic_xadd64(&next_request_id_, 1); }
   void CallRemotely(RpcJob *rpc_job);
-  int ChangeRefcount(const shash::Any &id, int change_by);
+  void CallRemotely(const std::vector<RpcJob *> &rpc_jobs);
+  int ChangeRefcount(const shash::Any &id, int change_by,
+                     ReadOnlyHandle *handle = NULL);
   int DoOpen(const shash::Any &id);
   shash::Any GetHandle(int fd);
+  bool MapShm(int fd_shm, uint64_t size);
+  int64_t ReadShm(const ReadOnlyHandle &handle, void *buf, uint64_t size,
+                  uint64_t offset);
   int Flush(bool do_commit, Transaction *transaction);
 
   pid_t pid_plugin_;
@@ -290,6 +341,10 @@ class ExternalCacheManager : public CacheManager {
   CacheTransport transport_;
   int64_t session_id_;
   uint32_t max_object_size_;
+  /**
+   * The lower one of the client's and the plugin's protocol version
+   */
+  unsigned protocol_version_;
   bool spawned_;
   bool terminated_;
   pthread_rwlock_t rwlock_fd_table_;
@@ -303,6 +358,11 @@ class ExternalCacheManager : public CacheManager {
   pthread_mutex_t lock_inflight_rpcs_;
   pthread_t thread_read_;
   uint64_t capabilities_;
+  /**
+   * Read-only mapping of the plugin's shared memory region, if any (CAP_SHM)
+   */
+  unsigned char *shm_region_;
+  uint64_t shm_region_size_;
 };  // class ExternalCacheManager
 
 
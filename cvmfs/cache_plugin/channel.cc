@@ -5,9 +5,12 @@
 #include "channel.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <poll.h>
 #include <signal.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
 #include <sys/un.h>
 #include <unistd.h>
 
@@ -175,6 +178,9 @@ CachePlugin::CachePlugin(uint64_t capabilities)
   , num_workers_(0)
   , max_object_size_(kDefaultMaxObjectSize)
   , num_inlimbo_clients_(0)
+  , shm_fd_(-1)
+  , shm_region_(NULL)
+  , shm_size_(0)
 {
   atomic_init64(&next_session_id_);
   atomic_init64(&next_txn_id_);
@@ -194,6 +200,79 @@ CachePlugin::~CachePlugin() {
     close(fd_socket_);
   if (fd_socket_lock_ >= 0)
     UnlockFile(fd_socket_lock_);
+  if (shm_region_ != NULL)
+    munmap(shm_region_, shm_size_);
+  if (shm_fd_ >= 0)
+    close(shm_fd_);
+}
+
+
+/**
+ * Creates the shared memory region that is handed out to local clients and
+ * returns the area of the given size where the plugin should place the object
+ * data.  Should be called once, before Listen().  Returns NULL on failure, in
+ * which case clients fall back to reading through the socket.
+ */
+unsigned char *CachePlugin::CreateShm(uint64_t size) {
+  assert(shm_region_ == NULL);
+  const uint64_t region_size = CacheTransport::kShmHeaderSize + size;
+#ifdef SYS_memfd_create
+  const unsigned kMfdCloexec = 0x0001U;
+  int fd = syscall(SYS_memfd_create, "cvmfs_cache_shm", kMfdCloexec);
+#else
+  const string shm_name = "/cvmfs_cache_shm." + StringifyInt(getpid());
+  int fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd >= 0)
+    shm_unlink(shm_name.c_str());
+#endif
+  if (fd < 0) {
+    LogCvmfs(kLogCache, kLogDebug | kLogSyslogWarn,
+             "failed to create shared memory region (%d)", errno);
+    return NULL;
+  }
+  if (ftruncate(fd, region_size) != 0) {
+    LogCvmfs(kLogCache, kLogDebug | kLogSyslogWarn,
+             "failed to size shared memory region (%d)", errno);
+    close(fd);
+    return NULL;
+  }
+  void *region =
+    mmap(NULL, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (region == MAP_FAILED) {
+    LogCvmfs(kLogCache, kLogDebug | kLogSyslogWarn,
+             "failed to map shared memory region (%d)", errno);
+    close(fd);
+    return NULL;
+  }
+
+  shm_fd_ = fd;
+  shm_region_ = reinterpret_cast<unsigned char *>(region);
+  shm_size_ = region_size;
+  CacheTransport::ShmHeader *header =
+    reinterpret_cast<CacheTransport::ShmHeader *>(shm_region_);
+  header->magic = CacheTransport::kShmMagic;
+  atomic_init64(&header->generation);
+  return shm_region_ + CacheTransport::kShmHeaderSize;
+}
+
+
+/**
+ * Brackets operations that move object data in the shared memory region, such
+ * as compaction.  Locations handed out before become stale.
+ */
+void CachePlugin::BeginShmMove() {
+  if (shm_region_ == NULL)
+    return;
+  atomic_inc64(
+    &reinterpret_cast<CacheTransport::ShmHeader *>(shm_region_)->generation);
+}
+
+
+void CachePlugin::EndShmMove() {
+  if (shm_region_ == NULL)
+    return;
+  atomic_inc64(
+    &reinterpret_cast<CacheTransport::ShmHeader *>(shm_region_)->generation);
 }
 
 
@@ -272,7 +351,19 @@ void CachePlugin::HandleHandshake(
   msg_ack.set_capabilities(capabilities_);
   if (is_local_)
     msg_ack.set_pid(getpid());
+  const bool export_shm = (shm_region_ != NULL) && is_local_ &&
+                          (capabilities_ & cvmfs::CAP_SHM) &&
+                          (msg_req->protocol_version() >= 3);
+  if (export_shm)
+    msg_ack.set_shm_size(shm_size_);
   transport->SendFrame(&frame_send);
+  if (export_shm) {
+    bool retval = SendFd2Socket(transport->fd_connection(), shm_fd_);
+    if (!retval) {
+      LogSessionError(session_id, cvmfs::STATUS_IOERR,
+                      "failed to pass shared memory region");
+    }
+  }
 }
 
 
@@ -444,6 +535,67 @@ void CachePlugin::HandleRead(
 }
 
 
+/**
+ * Serves all ranges of a vectored read from the plugin's Pread() callback and
+ * sends the payloads back to back in a single reply.
+ */
+void CachePlugin::HandleReadv(
+  cvmfs::MsgReadvReq *msg_req,
+  CacheTransport *transport)
+{
+  SessionCtxGuard session_guard(msg_req->session_id(), this);
+  cvmfs::MsgReadvReply msg_reply;
+  CacheTransport::Frame frame_send(&msg_reply);
+
+  msg_reply.set_req_id(msg_req->req_id());
+  const unsigned num_ranges = msg_req->ranges_size();
+  vector<shash::Any> object_ids(num_ranges);
+  uint64_t total_size = 0;
+  for (unsigned i = 0; i < num_ranges; ++i) {
+    const cvmfs::MsgReadRange &range = msg_req->ranges(i);
+    total_size += range.size();
+    bool retval = transport->ParseMsgHash(range.object_id(), &object_ids[i]);
+    if (!retval || (total_size > max_object_size_)) {
+      LogSessionError(msg_req->session_id(), cvmfs::STATUS_MALFORMED,
+                      "malformed vectored read received from client");
+      msg_reply.set_status(cvmfs::STATUS_MALFORMED);
+      transport->SendFrame(&frame_send);
+      return;
+    }
+  }
+
+#ifdef __APPLE__
+  unsigned char *buffer =
+    reinterpret_cast<unsigned char *>(smalloc(total_size));
+#else
+  unsigned char buffer[total_size];
+#endif
+  unsigned pos = 0;
+  for (unsigned i = 0; i < num_ranges; ++i) {
+    const cvmfs::MsgReadRange &range = msg_req->ranges(i);
+    unsigned size = range.size();
+    cvmfs::EnumStatus status =
+      Pread(object_ids[i], range.offset(), &size, buffer + pos);
+    msg_reply.add_statuses(status);
+    if (status == cvmfs::STATUS_OK) {
+      msg_reply.add_sizes(size);
+      pos += size;
+    } else {
+      msg_reply.add_sizes(0);
+      LogSessionError(msg_req->session_id(), status,
+                      "failed to read from object");
+    }
+  }
+  msg_reply.set_status(cvmfs::STATUS_OK);
+  if (pos > 0)
+    frame_send.set_attachment(buffer, pos);
+  transport->SendFrame(&frame_send);
+#ifdef __APPLE__
+  free(buffer);
+#endif
+}
+
+
 void CachePlugin::HandleRefcount(
   cvmfs::MsgRefcountReq *msg_req,
   CacheTransport *transport)
@@ -466,6 +618,19 @@ void CachePlugin::HandleRefcount(
       LogSessionError(msg_req->session_id(), status,
                       "failed to open/close object " + object_id.ToString());
     }
+    if ((status == cvmfs::STATUS_OK) && (msg_req->change_by() > 0) &&
+        (shm_region_ != NULL) && (capabilities_ & cvmfs::CAP_SHM))
+    {
+      uint64_t offset;
+      uint64_t size;
+      if (LocateShm(object_id, &offset, &size) == cvmfs::STATUS_OK) {
+        CacheTransport::ShmHeader *header =
+          reinterpret_cast<CacheTransport::ShmHeader *>(shm_region_);
+        msg_reply.set_shm_offset(CacheTransport::kShmHeaderSize + offset);
+        msg_reply.set_shm_size(size);
+        msg_reply.set_shm_generation(header->generation);
+      }
+    }
   }
   transport->SendFrame(&frame_send);
 }
@@ -513,6 +678,10 @@ bool CachePlugin::HandleRequest(int fd_con) {
     cvmfs::MsgReadReq *msg_req =
       reinterpret_cast<cvmfs::MsgReadReq *>(msg_typed);
     HandleRead(msg_req, &transport);
+  } else if (msg_typed->GetTypeName() == "cvmfs.MsgReadvReq") {
+    cvmfs::MsgReadvReq *msg_req =
+      reinterpret_cast<cvmfs::MsgReadvReq *>(msg_typed);
+    HandleReadv(msg_req, &transport);
   } else if (msg_typed->GetTypeName() == "cvmfs.MsgStoreReq") {
     cvmfs::MsgStoreReq *msg_req =
       reinterpret_cast<cvmfs::MsgStoreReq *>(msg_typed);
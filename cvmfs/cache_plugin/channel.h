@@ -67,7 +67,7 @@ class SessionCtx : SingleCopy {
 
 class CachePlugin {
  public:
-  static const unsigned kPbProtocolVersion = 1;
+  static const unsigned kPbProtocolVersion = 3;
   static const uint64_t kSizeUnknown;
 
   struct ObjectInfo {
@@ -99,6 +99,10 @@ class CachePlugin {
   void WaitFor();
   void AskToDetach();
 
+  unsigned char *CreateShm(uint64_t size);
+  void BeginShmMove();
+  void EndShmMove();
+
   unsigned max_object_size() const { return max_object_size_; }
   uint64_t capabilities() const { return capabilities_; }
 
@@ -136,6 +140,17 @@ class CachePlugin {
   virtual cvmfs::EnumStatus StoreBreadcrumb(
     const std::string &fqrn, const manifest::Breadcrumb &breadcrumb) = 0;
 
+  /**
+   * Only used with CAP_SHM.  Returns the position of the object data relative
+   * to the area returned by CreateShm().
+   */
+  virtual cvmfs::EnumStatus LocateShm(const shash::Any &id,
+                                      uint64_t *offset,
+                                      uint64_t *size)
+  {
+    return cvmfs::STATUS_NOSUPPORT;
+  }
+
  private:
   static const unsigned kDefaultMaxObjectSize = 256 * 1024;  // 256kB
   static const unsigned kListingSize = 4 * 1024 * 1024;  // 4MB
@@ -223,6 +238,8 @@ class CachePlugin {
                         CacheTransport *transport);
   void HandleRead(cvmfs::MsgReadReq *msg_req,
                      CacheTransport *transport);
+  void HandleReadv(cvmfs::MsgReadvReq *msg_req,
+                   CacheTransport *transport);
   void HandleStore(cvmfs::MsgStoreReq *msg_req,
                    CacheTransport::Frame *frame,
                    CacheTransport *transport);
@@ -266,6 +283,13 @@ class CachePlugin {
   std::map<uint64_t, SessionInfo> sessions_;
   pthread_t thread_io_;
   int pipe_ctrl_[2];
+  /**
+   * Memfd backed region that is passed to local clients if the plugin exports
+   * its object data (CAP_SHM).  Starts with a CacheTransport::ShmHeader.
+   */
+  int shm_fd_;
+  unsigned char *shm_region_;
+  uint64_t shm_size_;
 };  // class CachePlugin
 
 #endif  // CVMFS_CACHE_PLUGIN_CHANNEL_H_
@@ -157,7 +157,7 @@ struct cvmcache_context *ctx;
  */
 class PluginRamCache : public Callbackable<MallocHeap::BlockPtr> {
  public:
-  static PluginRamCache *Create(const string &mem_size_str) {
+  static PluginRamCache *Create(const string &mem_size_str, bool use_shm) {
     assert(instance_ == NULL);
 
     uint64_t mem_size_bytes;
@@ -166,7 +166,7 @@ class PluginRamCache : public Callbackable<MallocHeap::BlockPtr> {
     } else {
       mem_size_bytes = String2Uint64(mem_size_str) * 1024 * 1024;
     }
-    instance_ = new PluginRamCache(mem_size_bytes);
+    instance_ = new PluginRamCache(mem_size_bytes, use_shm);
     return instance_;
   }
 
@@ -250,6 +250,21 @@ class PluginRamCache : public Callbackable<MallocHeap::BlockPtr> {
     return CVMCACHE_STATUS_OK;
   }
 
+  static int ram_shm_locate(struct cvmcache_hash *id,
+                            uint64_t *offset,
+                            uint64_t *size)
+  {
+    if (Me()->shm_arena_ == NULL)
+      return CVMCACHE_STATUS_NOSUPPORT;
+    ComparableHash h(*id);
+    ObjectHeader *object;
+    if (!Me()->objects_all_->Lookup(h, &object, false))
+      return CVMCACHE_STATUS_NOENTRY;
+    *offset = object->GetData() - Me()->shm_arena_;
+    *size = object->size_data;
+    return CVMCACHE_STATUS_OK;
+  }
+
 
   static int ram_start_txn(
     struct cvmcache_hash *id,
@@ -476,15 +491,31 @@ class PluginRamCache : public Callbackable<MallocHeap::BlockPtr> {
   static PluginRamCache *Me() {
     return instance_;
   }
-  explicit PluginRamCache(uint64_t mem_size) {
+  PluginRamCache(uint64_t mem_size, bool use_shm) {
     in_danger_zone_ = false;
 
     uint64_t heap_size = RoundUp8(
       std::max(kMinSize, uint64_t(mem_size * (1.0 - kSlotFraction))));
     memset(&cache_info_, 0, sizeof(cache_info_));
     cache_info_.size_bytes = heap_size;
-    storage_ = new MallocHeap(
-      heap_size, this->MakeCallback(&PluginRamCache::OnBlockMove, this));
+    // With shared memory, clients can copy object data directly from the heap
+    shm_arena_ = NULL;
+    if (use_shm) {
+      shm_arena_ =
+        reinterpret_cast<unsigned char *>(cvmcache_shm_create(ctx, heap_size));
+      if (shm_arena_ == NULL) {
+        LogCvmfs(kLogCache, kLogDebug | kLogSyslogWarn,
+                 "failed to create shared memory heap, using private memory");
+      }
+    }
+    if (shm_arena_ != NULL) {
+      storage_ = new MallocHeap(
+        heap_size, this->MakeCallback(&PluginRamCache::OnBlockMove, this),
+        shm_arena_);
+    } else {
+      storage_ = new MallocHeap(
+        heap_size, this->MakeCallback(&PluginRamCache::OnBlockMove, this));
+    }
 
     struct cvmcache_hash hash_empty;
     memset(&hash_empty, 0, sizeof(hash_empty));
@@ -526,7 +557,9 @@ class PluginRamCache : public Callbackable<MallocHeap::BlockPtr> {
     // Free space occupied due to piecewise catalog storage
     if (!objects_all_->IsFull()) {
       LogCvmfs(kLogCache, kLogDebug, "compacting ram cache");
+      cvmcache_shm_move_begin(ctx);
       storage_->Compact();
+      cvmcache_shm_move_end(ctx);
       if (storage_->HasSpaceFor(bytes_required))
         return true;
     }
@@ -592,7 +625,9 @@ class PluginRamCache : public Callbackable<MallocHeap::BlockPtr> {
     }
     objects_all_->FilterEnd();
 
+    cvmcache_shm_move_begin(ctx);
     storage_->Compact();
+    cvmcache_shm_move_end(ctx);
     cache_info_.no_shrink++;
   }
 
@@ -620,6 +655,10 @@ class PluginRamCache : public Callbackable<MallocHeap::BlockPtr> {
   lru::LruCache<ComparableHash, ObjectHeader *> *objects_volatile_;
   map<std::string, cvmcache_breadcrumb> breadcrumbs_;
   MallocHeap *storage_;
+  /**
+   * Start of the heap if it lives in the plugin's shared memory region
+   */
+  unsigned char *shm_arena_;
   bool in_danger_zone_;
 };  // class PluginRamCache
 
@@ -680,11 +719,43 @@ int main(int argc, char **argv) {
     return 1;
   }
   char *test_mode = cvmcache_options_get(options, "CVMFS_CACHE_PLUGIN_TEST");
+  bool use_shm = false;
+  char *shm = cvmcache_options_get(options, "CVMFS_CACHE_PLUGIN_SHM");
+  if (shm != NULL) {
+    const string shm_upper = ToUpper(shm);
+    use_shm = (shm_upper == "YES") || (shm_upper == "ON") ||
+              (shm_upper == "1") || (shm_upper == "TRUE");
+    cvmcache_options_free(shm);
+  }
 
   if (!test_mode)
     cvmcache_spawn_watchdog(NULL);
 
-  PluginRamCache *plugin = PluginRamCache::Create(mem_size);
+  // The plugin instance is created after the context because its heap might
+  // be placed in the context's shared memory region
+  struct cvmcache_callbacks callbacks;
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.cvmcache_chrefcnt = PluginRamCache::ram_chrefcnt;
+  callbacks.cvmcache_obj_info = PluginRamCache::ram_obj_info;
+  callbacks.cvmcache_pread = PluginRamCache::ram_pread;
+  callbacks.cvmcache_start_txn = PluginRamCache::ram_start_txn;
+  callbacks.cvmcache_write_txn = PluginRamCache::ram_write_txn;
+  callbacks.cvmcache_commit_txn = PluginRamCache::ram_commit_txn;
+  callbacks.cvmcache_abort_txn = PluginRamCache::ram_abort_txn;
+  callbacks.cvmcache_info = PluginRamCache::ram_info;
+  callbacks.cvmcache_shrink = PluginRamCache::ram_shrink;
+  callbacks.cvmcache_listing_begin = PluginRamCache::ram_listing_begin;
+  callbacks.cvmcache_listing_next = PluginRamCache::ram_listing_next;
+  callbacks.cvmcache_listing_end = PluginRamCache::ram_listing_end;
+  callbacks.cvmcache_breadcrumb_store = PluginRamCache::ram_breadcrumb_store;
+  callbacks.cvmcache_breadcrumb_load = PluginRamCache::ram_breadcrumb_load;
+  callbacks.cvmcache_shm_locate = PluginRamCache::ram_shm_locate;
+  callbacks.capabilities = CVMCACHE_CAP_ALL_V2;
+  if (use_shm)
+    callbacks.capabilities |= CVMCACHE_CAP_SHM;
+
+  ctx = cvmcache_init(&callbacks);
+  PluginRamCache::Create(mem_size, use_shm);
   struct sigaction sa;
   memset(&sa, 0, sizeof(sa));
   sa.sa_sigaction = DropBreadcrumbs;
@@ -693,25 +764,6 @@ int main(int argc, char **argv) {
   int retval = sigaction(SIGUSR2, &sa, NULL);
   assert(retval == 0);
 
-  struct cvmcache_callbacks callbacks;
-  memset(&callbacks, 0, sizeof(callbacks));
-  callbacks.cvmcache_chrefcnt = plugin->ram_chrefcnt;
-  callbacks.cvmcache_obj_info = plugin->ram_obj_info;
-  callbacks.cvmcache_pread = plugin->ram_pread;
-  callbacks.cvmcache_start_txn = plugin->ram_start_txn;
-  callbacks.cvmcache_write_txn = plugin->ram_write_txn;
-  callbacks.cvmcache_commit_txn = plugin->ram_commit_txn;
-  callbacks.cvmcache_abort_txn = plugin->ram_abort_txn;
-  callbacks.cvmcache_info = plugin->ram_info;
-  callbacks.cvmcache_shrink = plugin->ram_shrink;
-  callbacks.cvmcache_listing_begin = plugin->ram_listing_begin;
-  callbacks.cvmcache_listing_next = plugin->ram_listing_next;
-  callbacks.cvmcache_listing_end = plugin->ram_listing_end;
-  callbacks.cvmcache_breadcrumb_store = plugin->ram_breadcrumb_store;
-  callbacks.cvmcache_breadcrumb_load = plugin->ram_breadcrumb_load;
-  callbacks.capabilities = CVMCACHE_CAP_ALL_V2;
-
-  ctx = cvmcache_init(&callbacks);
   retval = cvmcache_listen(ctx, locator);
   if (!retval) {
     LogCvmfs(kLogCache, kLogStderr, "failed to listen on %s", locator);
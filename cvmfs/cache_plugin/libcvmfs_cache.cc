@@ -78,6 +78,8 @@ class ForwardCachePlugin : public CachePlugin {
       assert(callbacks->cvmcache_listing_next != NULL);
       assert(callbacks->cvmcache_listing_end != NULL);
     }
+    if (callbacks->capabilities & CVMCACHE_CAP_SHM)
+      assert(callbacks->cvmcache_shm_locate != NULL);
     if (callbacks->capabilities & CVMCACHE_CAP_BREADCRUMB) {
       assert(callbacks->cvmcache_breadcrumb_store != NULL);
       assert(callbacks->cvmcache_breadcrumb_load != NULL);
@@ -276,6 +278,19 @@ class ForwardCachePlugin : public CachePlugin {
     return static_cast<cvmfs::EnumStatus>(result);
   }
 
+  virtual cvmfs::EnumStatus LocateShm(
+    const shash::Any &id,
+    uint64_t *offset,
+    uint64_t *size)
+  {
+    if (!(callbacks_.capabilities & CVMCACHE_CAP_SHM))
+      return cvmfs::STATUS_NOSUPPORT;
+
+    struct cvmcache_hash c_hash = Cpphash2Chash(id);
+    int result = callbacks_.cvmcache_shm_locate(&c_hash, offset, size);
+    return static_cast<cvmfs::EnumStatus>(result);
+  }
+
  private:
   struct cvmcache_callbacks callbacks_;
 };
@@ -347,6 +362,18 @@ uint32_t cvmcache_max_object_size(struct cvmcache_context *ctx) {
   return ctx->plugin->max_object_size();
 }
 
+void *cvmcache_shm_create(struct cvmcache_context *ctx, uint64_t size) {
+  return ctx->plugin->CreateShm(size);
+}
+
+void cvmcache_shm_move_begin(struct cvmcache_context *ctx) {
+  ctx->plugin->BeginShmMove();
+}
+
+void cvmcache_shm_move_end(struct cvmcache_context *ctx) {
+  ctx->plugin->EndShmMove();
+}
+
 void cvmcache_get_session(cvmcache_session *session) {
   assert(session != NULL);
   SessionCtx *session_ctx = SessionCtx::GetInstance();
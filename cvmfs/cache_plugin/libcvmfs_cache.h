@@ -13,7 +13,9 @@
 //   - Add cvmcache_get_session()
 // 3 --> 4:
 //   - Add breadcrumb management
-#define LIBCVMFS_CACHE_REVISION 4
+// 4 --> 5:
+//   - Add shared memory data plane (cvmcache_shm_...)
+#define LIBCVMFS_CACHE_REVISION 5
 
 #include <stdint.h>
 
@@ -29,7 +31,8 @@ typedef struct OptionsManager cvmcache_option_map;
 enum cvmcache_hash_algorithm {
   CVMCACHE_HASH_SHA1 = 1,
   CVMCACHE_HASH_RIPEMD160,
-  CVMCACHE_HASH_SHAKE128
+  CVMCACHE_HASH_SHAKE128,
+  CVMCACHE_HASH_BLAKE3
 };
 
 // Mirrors cvmfs::EnumStatus protobuf definition
@@ -74,6 +77,10 @@ enum cvmcache_capabilities {
   CVMCACHE_CAP_ALL_V1      = 63,
   CVMCACHE_CAP_BREADCRUMB  = 64,  // cache can load and store breadcrumps
   CVMCACHE_CAP_ALL_V2      = 127,
+  // Object data live in the region from cvmcache_shm_create() and local
+  // clients copy from there directly
+  CVMCACHE_CAP_SHM         = 128,
+  CVMCACHE_CAP_ALL_V3      = 255,
 };
 
 #define CVMCACHE_SIZE_UNKNOWN (uint64_t(-1))
@@ -176,6 +183,16 @@ struct cvmcache_callbacks {
                                    const cvmcache_breadcrumb *breadcrumb);
   int (*cvmcache_breadcrumb_load)(const char *fqrn,
                                   cvmcache_breadcrumb *breadcrumb);
+  /**
+   * Only with CVMCACHE_CAP_SHM.  Returns the offset of the object data
+   * relative to the area returned by cvmcache_shm_create() and the data size.
+   * The location must remain valid while the object's reference counter is
+   * larger than zero, except in between cvmcache_shm_move_begin() and
+   * cvmcache_shm_move_end().
+   */
+  int (*cvmcache_shm_locate)(struct cvmcache_hash *id,
+                             uint64_t *offset,
+                             uint64_t *size);
 
   int capabilities;
 };
@@ -223,6 +240,21 @@ void cvmcache_terminate(struct cvmcache_context *ctx);
 void cvmcache_wait_for(struct cvmcache_context *ctx);
 uint32_t cvmcache_max_object_size(struct cvmcache_context *ctx);
 
+/**
+ * Creates a shared memory region of the given size that local clients map
+ * read-only.  Plugins with CVMCACHE_CAP_SHM store their object data in the
+ * returned area.  Must be called before cvmcache_listen().  Returns NULL if
+ * the region cannot be created.
+ */
+void *cvmcache_shm_create(struct cvmcache_context *ctx, uint64_t size);
+/**
+ * Must bracket any operation that moves object data within the shared memory
+ * region, e.g. a compaction.  Clients detect the move and fall back to reading
+ * through the socket.
+ */
+void cvmcache_shm_move_begin(struct cvmcache_context *ctx);
+void cvmcache_shm_move_end(struct cvmcache_context *ctx);
+
 /**
  * Can be used to spawn a second process that superwises the cache plugin.
  * The watchdog can use gdb/lldb to generate stack traces.  Must be closed by
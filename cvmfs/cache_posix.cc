@@ -58,6 +58,7 @@
 #include "quota.h"
 #include "shortstring.h"
 #include "statistics.h"
+#include "util/algorithm.h"
 #include "util/atomic.h"
 #include "util/logging.h"
 #include "util/platform.h"
@@ -213,6 +214,7 @@ int PosixCacheManager::CommitTxn(void *txn) {
     }
   } else {
     // Success, inform quota manager
+    const uint64_t timestamp_ns = platform_monotonic_time_ns();
     if (transaction->object_info.type == kTypeVolatile) {
       quota_mgr_->InsertVolatile(transaction->id, transaction->size,
                                  transaction->object_info.description);
@@ -220,6 +222,9 @@ int PosixCacheManager::CommitTxn(void *txn) {
       quota_mgr_->Insert(transaction->id, transaction->size,
                          transaction->object_info.description);
     }
+    if (hist_quota_insert_ != NULL)
+      hist_quota_insert_->Add(
+        (platform_monotonic_time_ns() - timestamp_ns) / 1000);
   }
   transaction->~Transaction();
   atomic_dec32(&no_inflight_txns_);
@@ -81,6 +81,7 @@ class PosixCacheManager : public CacheManager {
   virtual int64_t Pread(int fd, void *buf, uint64_t size, uint64_t offset);
   virtual int Dup(int fd);
   virtual int Readahead(int fd);
+  virtual bool HasNativeFds() { return true; }
 
   virtual uint32_t SizeOfTxn() { return sizeof(Transaction); }
   virtual int StartTxn(const shash::Any &id, uint64_t size, void *txn);
@@ -103,6 +104,11 @@ class PosixCacheManager : public CacheManager {
   CacheModes cache_mode() { return cache_mode_; }
   bool alien_cache() { return alien_cache_; }
   std::string cache_path() { return cache_path_; }
+  /**
+   * Optional, records the time the quota manager needs to register committed
+   * objects.
+   */
+  void set_hist_quota_insert(Log2Histogram *hist) { hist_quota_insert_ = hist; }
 
  protected:
   virtual void *DoSaveState();
@@ -140,6 +146,7 @@ class PosixCacheManager : public CacheManager {
     , rename_workaround_(kRenameNormal)
     , cache_mode_(kCacheReadWrite)
     , reports_correct_filesize_(true)
+    , hist_quota_insert_(NULL)
   {
     atomic_init32(&no_inflight_txns_);
   }
@@ -165,6 +172,8 @@ class PosixCacheManager : public CacheManager {
    * Hack for HDFS which writes file sizes asynchronously.
    */
   bool reports_correct_filesize_;
+
+  Log2Histogram *hist_quota_insert_;
 };  // class PosixCacheManager
 
 #endif  // CVMFS_CACHE_POSIX_H_
@@ -45,16 +45,12 @@ RamCacheManager::RamCacheManager(
                       perf::StatisticsTemplate("kv.volatile", statistics))
   , counters_(statistics)
 {
-  int retval = pthread_rwlock_init(&rwlock_, NULL);
-  assert(retval == 0);
   LogCvmfs(kLogCache, kLogDebug, "max %u B, %u entries",
            max_size, max_entries);
 }
 
 
-RamCacheManager::~RamCacheManager() {
-  pthread_rwlock_destroy(&rwlock_);
-}
+RamCacheManager::~RamCacheManager() { }
 
 
 int RamCacheManager::AddFd(const ReadOnlyHandle &handle) {
@@ -76,7 +72,7 @@ bool RamCacheManager::AcquireQuotaManager(QuotaManager *quota_mgr) {
 
 
 int RamCacheManager::Open(const BlessedObject &object) {
-  WriteLockGuard guard(rwlock_);
+  EpochWriteGuard guard(&lock_);
   return DoOpen(object.id);
 }
 
@@ -119,7 +115,7 @@ int RamCacheManager::DoOpen(const shash::Any &id) {
 
 
 int64_t RamCacheManager::GetSize(int fd) {
-  ReadLockGuard guard(rwlock_);
+  EpochReadGuard guard(&lock_);
   ReadOnlyHandle generic_handle = fd_table_.GetHandle(fd);
   if (generic_handle.handle == kInvalidHandle) {
     LogCvmfs(kLogCache, kLogDebug, "bad fd %d on GetSize", fd);
@@ -133,7 +129,7 @@ int64_t RamCacheManager::GetSize(int fd) {
 int RamCacheManager::Close(int fd) {
   bool rc;
 
-  WriteLockGuard guard(rwlock_);
+  EpochWriteGuard guard(&lock_);
   ReadOnlyHandle generic_handle = fd_table_.GetHandle(fd);
   if (generic_handle.handle == kInvalidHandle) {
     LogCvmfs(kLogCache, kLogDebug, "bad fd %d on Close", fd);
@@ -156,7 +152,7 @@ int64_t RamCacheManager::Pread(
   uint64_t size,
   uint64_t offset)
 {
-  ReadLockGuard guard(rwlock_);
+  EpochReadGuard guard(&lock_);
   ReadOnlyHandle generic_handle = fd_table_.GetHandle(fd);
   if (generic_handle.handle == kInvalidHandle) {
     LogCvmfs(kLogCache, kLogDebug, "bad fd %d on Pread", fd);
@@ -171,7 +167,7 @@ int64_t RamCacheManager::Pread(
 int RamCacheManager::Dup(int fd) {
   bool ok;
   int rc;
-  WriteLockGuard guard(rwlock_);
+  EpochWriteGuard guard(&lock_);
   ReadOnlyHandle generic_handle = fd_table_.GetHandle(fd);
   if (generic_handle.handle == kInvalidHandle) {
     LogCvmfs(kLogCache, kLogDebug, "bad fd %d on Dup", fd);
@@ -191,7 +187,7 @@ int RamCacheManager::Dup(int fd) {
  * For a RAM cache, read-ahead is a no-op.
  */
 int RamCacheManager::Readahead(int fd) {
-  ReadLockGuard guard(rwlock_);
+  EpochReadGuard guard(&lock_);
   ReadOnlyHandle generic_handle = fd_table_.GetHandle(fd);
   if (generic_handle.handle == kInvalidHandle) {
     LogCvmfs(kLogCache, kLogDebug, "bad fd %d on Readahead", fd);
@@ -288,7 +284,7 @@ int RamCacheManager::Reset(void *txn) {
 
 
 int RamCacheManager::OpenFromTxn(void *txn) {
-  WriteLockGuard guard(rwlock_);
+  EpochWriteGuard guard(&lock_);
   Transaction *transaction = reinterpret_cast<Transaction *>(txn);
   int64_t retval = CommitToKvStore(transaction);
   if (retval < 0) {
@@ -315,7 +311,7 @@ int RamCacheManager::AbortTxn(void *txn) {
 
 
 int RamCacheManager::CommitTxn(void *txn) {
-  WriteLockGuard guard(rwlock_);
+  EpochWriteGuard guard(&lock_);
   Transaction *transaction = reinterpret_cast<Transaction *>(txn);
   perf::Inc(counters_.n_committxn);
   int64_t rc = CommitToKvStore(transaction);
@@ -16,6 +16,7 @@
 #include "fd_table.h"
 #include "kvstore.h"
 #include "statistics.h"
+#include "util/concurrency.h"
 #include "util/pointer.h"
 
 
@@ -67,7 +68,7 @@ class RamCacheManager : public CacheManager {
         "Number of GetSize calls");
       n_close = statistics.RegisterTemplated("n_close",
         "Number of Close calls");
-      n_pread = statistics.RegisterTemplated("n_pread",
+      n_pread = statistics.RegisterShardedTemplated("n_pread",
         "Number of Pread calls");
       n_dup = statistics.RegisterTemplated("n_dup",
         "Number of Dup calls");
@@ -297,7 +298,11 @@ class RamCacheManager : public CacheManager {
 
   uint64_t max_size_;
   FdTable<ReadOnlyHandle> fd_table_;
-  pthread_rwlock_t rwlock_;
+  /**
+   * Pread() and GetSize() only take the read side, which does not write to
+   * shared cache lines.  Open/close and transactions take the write side.
+   */
+  EpochLock lock_;
   MemoryKvStore regular_entries_;
   MemoryKvStore volatile_entries_;
   Counters counters_;
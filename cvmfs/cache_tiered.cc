@@ -1,18 +1,30 @@
 /**
  * This file is part of the CernVM File System.
  */
+#define __STDC_FORMAT_MACROS
+
 #include "cvmfs_config.h"
 #include "cache_tiered.h"
 
 #include <errno.h>
+#include <inttypes.h>
 
+#include <algorithm>
+#include <cassert>
 #include <string>
 #include <vector>
 
 #include "quota.h"
+#include "util/concurrency.h"
+#include "util/logging.h"
 #include "util/platform.h"
 #include "util/posix.h"
 
+const unsigned TieredCacheManager::kDefaultNumPromotionThreads;
+const unsigned TieredCacheManager::kMaxNumPromotionThreads;
+const unsigned TieredCacheManager::kMaxPromotionQueue;
+const int TieredCacheManager::kLowerFdFlag;
+
 
 std::string TieredCacheManager::Describe() {
   return "Tiered Cache\n"
@@ -48,6 +60,31 @@ void *TieredCacheManager::DoSaveState() {
 }
 
 
+TieredCacheManager::TieredCacheManager(
+  CacheManager *upper_cache,
+  CacheManager *lower_cache,
+  perf::StatisticsTemplate statistics)
+  : upper_(upper_cache)
+  , lower_(lower_cache)
+  , lower_readonly_(false)
+  , num_promotion_threads_(0)
+  , spawned_(false)
+  , terminate_(false)
+  , counters_(statistics)
+{
+  int retval = pthread_mutex_init(&lock_promotion_, NULL);
+  assert(retval == 0);
+  retval = pthread_cond_init(&cond_promotion_, NULL);
+  assert(retval == 0);
+}
+
+
+void TieredCacheManager::SetNumPromotionThreads(const unsigned num_threads) {
+  assert(!spawned_);
+  num_promotion_threads_ = std::min(num_threads, kMaxNumPromotionThreads);
+}
+
+
 int TieredCacheManager::Open(const BlessedObject &object) {
   int fd = upper_->Open(object);
   if ((fd >= 0) || (fd != -ENOENT)) {return fd;}
@@ -55,18 +92,55 @@ int TieredCacheManager::Open(const BlessedObject &object) {
   int fd2 = lower_->Open(object);
   if (fd2 < 0) {return fd;}  // NOTE: use error code from upper.
 
-  // Lower cache hit; upper cache miss.  Copy object into the upper cache.
-  int64_t size = lower_->GetSize(fd2);
-  if (size < 0) {
-    lower_->Close(fd2);
-    return fd;
+  // Lower cache hit; upper cache miss.  Serve the object from the lower cache
+  // if it can be copied into the upper cache in the background.
+  if ((fd2 < kLowerFdFlag) && SchedulePromotion(object)) {
+    perf::Inc(counters_.n_open_lower);
+    return fd2 | kLowerFdFlag;
   }
 
-  void *txn = alloca(upper_->SizeOfTxn());
-  if (upper_->StartTxn(object.id, size, txn) < 0) {
-    lower_->Close(fd2);
-    return fd;
+  // Otherwise copy object into the upper cache before returning.
+  int fd_return;
+  int64_t retval = CopyUp(object, fd2, &fd_return);
+  lower_->Close(fd2);
+  return (retval < 0) ? fd : fd_return;
+}
+
+
+int TieredCacheManager::Dup(int fd) {
+  if (!IsLowerFd(fd))
+    return upper_->Dup(fd);
+
+  int fd_dup = lower_->Dup(fd & ~kLowerFdFlag);
+  if (fd_dup < 0)
+    return fd_dup;
+  if (fd_dup >= kLowerFdFlag) {
+    lower_->Close(fd_dup);
+    return -ENFILE;
   }
+  return fd_dup | kLowerFdFlag;
+}
+
+
+/**
+ * Copies the object behind fd_lower into the upper cache.  If fd_upper is
+ * given, the object is opened in the upper cache before the transaction is
+ * committed.  Returns the object size or a negative error code.  The caller
+ * closes fd_lower.
+ */
+int64_t TieredCacheManager::CopyUp(
+  const BlessedObject &object,
+  int fd_lower,
+  int *fd_upper)
+{
+  int64_t size = lower_->GetSize(fd_lower);
+  if (size < 0)
+    return size;
+
+  void *txn = alloca(upper_->SizeOfTxn());
+  int retval = upper_->StartTxn(object.id, size, txn);
+  if (retval < 0)
+    return retval;
   upper_->CtrlTxn(object.info, 0, txn);
 
   std::vector<char> m_buffer;
@@ -75,33 +149,123 @@ int TieredCacheManager::Open(const BlessedObject &object) {
   uint64_t offset = 0;
   while (remaining > 0) {
     unsigned nbytes = remaining > kCopyBufferSize ? kCopyBufferSize : remaining;
-    int64_t result = lower_->Pread(fd2, &m_buffer[0], nbytes, offset);
+    int64_t result = lower_->Pread(fd_lower, &m_buffer[0], nbytes, offset);
     // The file we are reading is supposed to be exactly `size` bytes.
     if ((result < 0) || (result != nbytes)) {
-      lower_->Close(fd2);
       upper_->AbortTxn(txn);
-      return fd;
+      return (result < 0) ? result : -EIO;
     }
     result = upper_->Write(&m_buffer[0], nbytes, txn);
     if (result < 0) {
-      lower_->Close(fd2);
       upper_->AbortTxn(txn);
-      return fd;
+      return result;
     }
     offset += nbytes;
     remaining -= nbytes;
   }
-  lower_->Close(fd2);
-  int fd_return = upper_->OpenFromTxn(txn);
-  if (fd_return < 0) {
+
+  if (fd_upper == NULL) {
+    retval = upper_->CommitTxn(txn);
+    return (retval < 0) ? retval : size;
+  }
+
+  *fd_upper = upper_->OpenFromTxn(txn);
+  if (*fd_upper < 0) {
     upper_->AbortTxn(txn);
-    return fd;
+    return *fd_upper;
   }
-  if (upper_->CommitTxn(txn) < 0) {
-    upper_->Close(fd_return);
-    return fd;
+  retval = upper_->CommitTxn(txn);
+  if (retval < 0) {
+    upper_->Close(*fd_upper);
+    return retval;
   }
-  return fd_return;
+  return size;
+}
+
+
+/**
+ * Returns false if the object needs to be copied synchronously.  If the
+ * object is already queued or the queue is full, the object is still served
+ * from the lower cache.
+ */
+bool TieredCacheManager::SchedulePromotion(const BlessedObject &object) {
+  if ((object.info.type != kTypeRegular) && (object.info.type != kTypeVolatile))
+    return false;
+
+  MutexLockGuard m(&lock_promotion_);
+  if (!spawned_)
+    return false;
+  if (promotions_in_flight_.find(object.id) != promotions_in_flight_.end())
+    return true;
+  if (promotion_queue_.size() >= kMaxPromotionQueue) {
+    perf::Inc(counters_.n_promotion_dropped);
+    return true;
+  }
+  promotion_queue_.push_back(object);
+  promotions_in_flight_.insert(object.id);
+  perf::Inc(counters_.n_promotion_scheduled);
+  counters_.sz_promotion_queue->Set(promotion_queue_.size());
+  int retval = pthread_cond_signal(&cond_promotion_);
+  assert(retval == 0);
+  return true;
+}
+
+
+void *TieredCacheManager::MainPromotion(void *data) {
+  TieredCacheManager *cache_mgr = reinterpret_cast<TieredCacheManager *>(data);
+  LogCvmfs(kLogCache, kLogDebug, "starting tiered cache promotion thread");
+
+  while (true) {
+    BlessedObject object((shash::Any()));
+    {
+      MutexLockGuard m(&cache_mgr->lock_promotion_);
+      while (cache_mgr->promotion_queue_.empty() && !cache_mgr->terminate_) {
+        int retval = pthread_cond_wait(&cache_mgr->cond_promotion_,
+                                       &cache_mgr->lock_promotion_);
+        assert(retval == 0);
+      }
+      if (cache_mgr->terminate_)
+        break;
+      object = cache_mgr->promotion_queue_.front();
+      cache_mgr->promotion_queue_.pop_front();
+      cache_mgr->counters_.sz_promotion_queue->Set(
+        cache_mgr->promotion_queue_.size());
+    }
+    cache_mgr->Promote(object);
+    MutexLockGuard m(&cache_mgr->lock_promotion_);
+    cache_mgr->promotions_in_flight_.erase(object.id);
+  }
+
+  LogCvmfs(kLogCache, kLogDebug, "stopping tiered cache promotion thread");
+  return NULL;
+}
+
+
+void TieredCacheManager::Promote(const BlessedObject &object) {
+  int fd = upper_->Open(object);
+  if (fd >= 0) {
+    // Meanwhile committed to both caches by a regular download
+    upper_->Close(fd);
+    return;
+  }
+
+  int64_t retval = -ENOENT;
+  fd = lower_->Open(object);
+  if (fd >= 0) {
+    retval = CopyUp(object, fd, NULL);
+    lower_->Close(fd);
+  }
+  if (retval < 0) {
+    LogCvmfs(kLogCache, kLogDebug, "failed to promote %s (%" PRId64 ")",
+             object.id.ToString().c_str(), retval);
+    perf::Inc(counters_.n_promotion_failed);
+    return;
+  }
+  LogCvmfs(kLogCache, kLogDebug,
+           "promoted %s to the upper cache (%" PRId64 " bytes)",
+           object.id.ToString().c_str(), retval);
+  perf::Inc(counters_.n_promoted);
+  perf::Xadd(counters_.sz_promoted, retval);
 }
 
 
@@ -123,10 +287,11 @@ int TieredCacheManager::StartTxn(const shash::Any &id, uint64_t size, void *txn)
 
 CacheManager *TieredCacheManager::Create(
   CacheManager *upper_cache,
-  CacheManager *lower_cache)
+  CacheManager *lower_cache,
+  perf::StatisticsTemplate statistics)
 {
   TieredCacheManager *cache_mgr =
-    new TieredCacheManager(upper_cache, lower_cache);
+    new TieredCacheManager(upper_cache, lower_cache, statistics);
   delete cache_mgr->quota_mgr_;
   cache_mgr->quota_mgr_ = upper_cache->quota_mgr();
 
@@ -216,10 +381,34 @@ bool TieredCacheManager::StoreBreadcrumb(const manifest::Manifest &manifest) {
 void TieredCacheManager::Spawn() {
   upper_->Spawn();
   lower_->Spawn();
+
+  MutexLockGuard m(&lock_promotion_);
+  for (unsigned i = 0; i < num_promotion_threads_; ++i) {
+    pthread_t thread;
+    int retval = pthread_create(&thread, NULL, MainPromotion, this);
+    assert(retval == 0);
+    promotion_threads_.push_back(thread);
+  }
+  spawned_ = !promotion_threads_.empty();
 }
 
 
 TieredCacheManager::~TieredCacheManager() {
+  if (spawned_) {
+    {
+      MutexLockGuard m(&lock_promotion_);
+      terminate_ = true;
+      int retval = pthread_cond_broadcast(&cond_promotion_);
+      assert(retval == 0);
+    }
+    for (unsigned i = 0; i < promotion_threads_.size(); ++i) {
+      int retval = pthread_join(promotion_threads_[i], NULL);
+      assert(retval == 0);
+    }
+  }
+  pthread_cond_destroy(&cond_promotion_);
+  pthread_mutex_destroy(&lock_promotion_);
+
   quota_mgr_ = NULL;  // gets deleted by upper
   delete upper_;
   delete lower_;
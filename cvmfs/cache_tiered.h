@@ -7,10 +7,17 @@
 #ifndef CVMFS_CACHE_TIERED_H_
 #define CVMFS_CACHE_TIERED_H_
 
+#include <pthread.h>
+
+#include <deque>
+#include <set>
 #include <string>
+#include <vector>
 
 #include "cache.h"
+#include "crypto/hash.h"
 #include "gtest/gtest_prod.h"
+#include "statistics.h"
 
 /**
  * Cache manager implementation that provides a hierarchical cache.
@@ -22,6 +29,12 @@
  * - Writes are done to both caches simultaneously.
  *
  * The quota manager is only applied to the upper cache.
+ *
+ * Once spawned with promotion threads, regular and volatile objects found
+ * only in the lower cache are served from the lower cache and copied to the
+ * upper cache in the background.  File descriptors of the lower cache are
+ * marked by kLowerFdFlag.  Catalogs and pinned objects are always copied
+ * synchronously because they need to be pinned in the upper cache.
  */
 class TieredCacheManager : public CacheManager {
   FRIEND_TEST(T_MountPoint, TieredCacheMgr);
@@ -31,9 +44,27 @@ class TieredCacheManager : public CacheManager {
   virtual CacheManagerIds id() { return kTieredCacheManager; }
   virtual std::string Describe();
 
+  /**
+   * Used by the mount point unless CVMFS_CACHE_<instance>_PROMOTION_THREADS
+   * is set
+   */
+  static const unsigned kDefaultNumPromotionThreads = 2;
+  static const unsigned kMaxNumPromotionThreads = 32;
+  /**
+   * Upper bound of promotions waiting for a thread
+   */
+  static const unsigned kMaxPromotionQueue = 1024;
+
   static CacheManager *Create(CacheManager *upper_cache,
-                              CacheManager *lower_cache);
+                              CacheManager *lower_cache,
+                              perf::StatisticsTemplate statistics);
   void SetLowerReadOnly() { lower_readonly_ = true; }
+  /**
+   * Needs to be called before Spawn().  Zero threads keep the synchronous copy
+   * to the upper cache on Open().  That is the case unless this is called; the
+   * mount point sets kDefaultNumPromotionThreads by default.
+   */
+  void SetNumPromotionThreads(const unsigned num_threads);
 
   virtual ~TieredCacheManager();
   virtual bool AcquireQuotaManager(QuotaManager *quota_mgr) {
@@ -43,12 +74,23 @@ class TieredCacheManager : public CacheManager {
   }
 
   virtual int Open(const BlessedObject &object);
-  virtual int64_t GetSize(int fd) {return upper_->GetSize(fd);}
-  virtual int Close(int fd) {return upper_->Close(fd);}
-  virtual int64_t Pread(int fd, void *buf, uint64_t size, uint64_t offset)
-  { return upper_->Pread(fd, buf, size, offset); }
-  virtual int Dup(int fd) { return upper_->Dup(fd); }
-  virtual int Readahead(int fd) { return upper_->Readahead(fd); }
+  virtual int64_t GetSize(int fd) {
+    return IsLowerFd(fd) ? lower_->GetSize(fd & ~kLowerFdFlag)
+                         : upper_->GetSize(fd);
+  }
+  virtual int Close(int fd) {
+    return IsLowerFd(fd) ? lower_->Close(fd & ~kLowerFdFlag)
+                         : upper_->Close(fd);
+  }
+  virtual int64_t Pread(int fd, void *buf, uint64_t size, uint64_t offset) {
+    return IsLowerFd(fd) ? lower_->Pread(fd & ~kLowerFdFlag, buf, size, offset)
+                         : upper_->Pread(fd, buf, size, offset);
+  }
+  virtual int Dup(int fd);
+  virtual int Readahead(int fd) {
+    return IsLowerFd(fd) ? lower_->Readahead(fd & ~kLowerFdFlag)
+                         : upper_->Readahead(fd);
+  }
 
   virtual uint32_t SizeOfTxn()
   { return upper_->SizeOfTxn() + lower_->SizeOfTxn(); }
@@ -72,7 +114,42 @@ class TieredCacheManager : public CacheManager {
   virtual bool DoFreeState(void *data);
 
  private:
+  FRIEND_TEST(T_TieredCacheManager, AsyncPromotion);
+
   static const unsigned kCopyBufferSize = 64 * 1024;  // 64kB
+  /**
+   * Set on file descriptors that refer to the lower cache.  File descriptors
+   * of the cache managers stay well below 2^30.
+   */
+  static const int kLowerFdFlag = 1 << 30;
+
+  struct Counters {
+    perf::Counter *sz_promotion_queue;
+    perf::Counter *n_open_lower;
+    perf::Counter *n_promotion_scheduled;
+    perf::Counter *n_promotion_dropped;
+    perf::Counter *n_promoted;
+    perf::Counter *n_promotion_failed;
+    perf::Counter *sz_promoted;
+
+    explicit Counters(perf::StatisticsTemplate statistics) {
+      sz_promotion_queue = statistics.RegisterTemplated("sz_promotion_queue",
+        "Number of objects waiting for promotion to the upper cache");
+      n_open_lower = statistics.RegisterTemplated("n_open_lower",
+        "Number of opens served from the lower cache");
+      n_promotion_scheduled = statistics.RegisterTemplated(
+        "n_promotion_scheduled", "Number of objects queued for promotion");
+      n_promotion_dropped = statistics.RegisterTemplated(
+        "n_promotion_dropped",
+        "Number of promotions dropped due to a full queue");
+      n_promoted = statistics.RegisterTemplated("n_promoted",
+        "Number of objects copied to the upper cache");
+      n_promotion_failed = statistics.RegisterTemplated("n_promotion_failed",
+        "Number of failed promotions");
+      sz_promoted = statistics.RegisterTemplated("sz_promoted",
+        "Number of bytes copied to the upper cache");
+    }
+  };
 
   struct SavedState {
     SavedState() : state_upper(NULL), state_lower(NULL) { }
@@ -82,12 +159,35 @@ class TieredCacheManager : public CacheManager {
 
   // NOTE: TieredCacheManager takes ownership of both caches passed.
   TieredCacheManager(CacheManager *upper_cache,
-                     CacheManager *lower_cache)
-    : upper_(upper_cache), lower_(lower_cache), lower_readonly_(false) { }
+                     CacheManager *lower_cache,
+                     perf::StatisticsTemplate statistics);
+
+  static bool IsLowerFd(int fd) { return (fd >= 0) && (fd & kLowerFdFlag); }
+  static void *MainPromotion(void *data);
+  int64_t CopyUp(const BlessedObject &object, int fd_lower, int *fd_upper);
+  bool SchedulePromotion(const BlessedObject &object);
+  void Promote(const BlessedObject &object);
 
   CacheManager *upper_;
   CacheManager *lower_;
   bool lower_readonly_;
+
+  unsigned num_promotion_threads_;
+  bool spawned_;
+  bool terminate_;
+  std::vector<pthread_t> promotion_threads_;
+  /**
+   * Protects the promotion queue and the set of objects in flight
+   */
+  pthread_mutex_t lock_promotion_;
+  pthread_cond_t cond_promotion_;
+  std::deque<BlessedObject> promotion_queue_;
+  /**
+   * Objects queued or being copied; used to deduplicate concurrent promotions
+   */
+  std::set<shash::Any> promotions_in_flight_;
+
+  Counters counters_;
 };  // class TieredCacheManager
 
 #endif  // CVMFS_CACHE_TIERED_H_
@@ -113,6 +113,8 @@ void CacheTransport::Frame::Release() {
   msg_rpc_.release_msg_refcount_reply();
   msg_rpc_.release_msg_read_req();
   msg_rpc_.release_msg_read_reply();
+  msg_rpc_.release_msg_readv_req();
+  msg_rpc_.release_msg_readv_reply();
   msg_rpc_.release_msg_object_info_req();
   msg_rpc_.release_msg_object_info_reply();
   msg_rpc_.release_msg_store_req();
@@ -177,6 +179,12 @@ void CacheTransport::Frame::WrapMsg() {
   } else if (msg_typed_->GetTypeName() == "cvmfs.MsgReadReply") {
     msg_rpc_.set_allocated_msg_read_reply(
       reinterpret_cast<cvmfs::MsgReadReply *>(msg_typed_));
+  } else if (msg_typed_->GetTypeName() == "cvmfs.MsgReadvReq") {
+    msg_rpc_.set_allocated_msg_readv_req(
+      reinterpret_cast<cvmfs::MsgReadvReq *>(msg_typed_));
+  } else if (msg_typed_->GetTypeName() == "cvmfs.MsgReadvReply") {
+    msg_rpc_.set_allocated_msg_readv_reply(
+      reinterpret_cast<cvmfs::MsgReadvReply *>(msg_typed_));
   } else if (msg_typed_->GetTypeName() == "cvmfs.MsgStoreReq") {
     msg_rpc_.set_allocated_msg_store_req(
       reinterpret_cast<cvmfs::MsgStoreReq *>(msg_typed_));
@@ -246,6 +254,10 @@ void CacheTransport::Frame::UnwrapMsg() {
     msg_typed_ = msg_rpc_.mutable_msg_read_req();
   } else if (msg_rpc_.has_msg_read_reply()) {
     msg_typed_ = msg_rpc_.mutable_msg_read_reply();
+  } else if (msg_rpc_.has_msg_readv_req()) {
+    msg_typed_ = msg_rpc_.mutable_msg_readv_req();
+  } else if (msg_rpc_.has_msg_readv_reply()) {
+    msg_typed_ = msg_rpc_.mutable_msg_readv_reply();
   } else if (msg_rpc_.has_msg_store_req()) {
     msg_typed_ = msg_rpc_.mutable_msg_store_req();
   } else if (msg_rpc_.has_msg_store_abort_req()) {
@@ -313,6 +325,9 @@ void CacheTransport::FillMsgHash(
     case shash::kShake128:
       msg_hash->set_algorithm(cvmfs::HASH_SHAKE128);
       break;
+    case shash::kBlake3:
+      msg_hash->set_algorithm(cvmfs::HASH_BLAKE3);
+      break;
     default:
       PANIC(NULL);
   }
@@ -356,6 +371,9 @@ bool CacheTransport::ParseMsgHash(
     case cvmfs::HASH_SHAKE128:
       hash->algorithm = shash::kShake128;
       break;
+    case cvmfs::HASH_BLAKE3:
+      hash->algorithm = shash::kBlake3;
+      break;
     default:
       return false;
   }
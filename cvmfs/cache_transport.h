@@ -10,6 +10,7 @@
 
 #include "cache.h"
 #include "cache.pb.h"
+#include "util/atomic.h"
 #include "util/single_copy.h"
 
 namespace shash {
@@ -82,6 +83,21 @@ class CacheTransport {
   static const uint32_t kFlagSendIgnoreFailure = 0x01;
   static const uint32_t kFlagSendNonBlocking   = 0x02;
 
+  /**
+   * Beginning of the shared memory region through which a plugin can export
+   * object data to local clients (CAP_SHM).  Object data starts after the first
+   * kShmHeaderSize bytes.  The plugin increments the generation before and
+   * after it moves objects in the region, so the generation is odd while data
+   * are in flux.  Clients verify that the generation is unchanged after they
+   * copied from the region (seqlock).
+   */
+  struct ShmHeader {
+    uint64_t magic;
+    atomic_int64 generation;
+  };
+  static const uint64_t kShmMagic = 0x636d766673686d31ULL;  // "cvmfshm1"
+  static const unsigned kShmHeaderSize = 4096;
+
 
   /**
    * A single unit of data transfer contains a "typed" Msg... protobuf message
@@ -11,16 +11,24 @@
 #include <cassert>
 
 #include "catalog_mgr.h"
+#include "catalog_path_filter.h"
+#include "sqlitevfs.h"
 #include "util/concurrency.h"
 #include "util/logging.h"
 #include "util/platform.h"
 #include "util/smalloc.h"
+#include "util/string.h"
 
 using namespace std;  // NOLINT
 
 namespace catalog {
 
 const shash::Md5 Catalog::kMd5PathEmpty("", 0);
+const unsigned Catalog::kMaxReaders;
+const unsigned Catalog::kMaxIdleReaders;
+const unsigned Catalog::kMaxReadersTotal;
+atomic_int32 Catalog::num_readers_total_ = 0;
+const char *Catalog::kPathFilterKey = "path_filter";
 
 
 /**
@@ -66,10 +74,21 @@ Catalog::Catalog(const PathString &mountpoint,
   lock_ = reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
   int retval = pthread_mutex_init(lock_, NULL);
   assert(retval == 0);
+  num_readers_ = 0;
+  readers_failed_ = false;
+  lock_readers_ =
+    reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
+  retval = pthread_mutex_init(lock_readers_, NULL);
+  assert(retval == 0);
+  lock_hardlinks_ =
+    reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
+  retval = pthread_mutex_init(lock_hardlinks_, NULL);
+  assert(retval == 0);
 
   database_ = NULL;
   uid_map_ = NULL;
   gid_map_ = NULL;
+  path_filter_ = NULL;
   sql_listing_ = NULL;
   sql_lookup_md5path_ = NULL;
   sql_lookup_nested_ = NULL;
@@ -82,9 +101,16 @@ Catalog::Catalog(const PathString &mountpoint,
 
 
 Catalog::~Catalog() {
+  for (unsigned i = 0; i < idle_readers_.size(); ++i)
+    CloseReader(idle_readers_[i]);
+  pthread_mutex_destroy(lock_hardlinks_);
+  free(lock_hardlinks_);
+  pthread_mutex_destroy(lock_readers_);
+  free(lock_readers_);
   pthread_mutex_destroy(lock_);
   free(lock_);
   FinalizePreparedStatements();
+  delete path_filter_;
   delete database_;
 }
 
@@ -182,6 +208,7 @@ bool Catalog::OpenDatabase(const string &db_path) {
   }
 
   InitPreparedStatements();
+  EnableMmap(*database_);
 
   // Set the database file ownership if requested
   if (managed_database_) {
@@ -225,6 +252,8 @@ bool Catalog::OpenDatabase(const string &db_path) {
     return false;
   }
 
+  LoadPathFilter();
+
   if (HasParent()) {
     parent_->AddChild(this);
   }
@@ -305,14 +334,20 @@ bool Catalog::LookupEntry(const shash::Md5 &md5path, const bool expand_symlink,
 {
   assert(IsInitialized());
 
-  MutexLockGuard m(lock_);
-  sql_lookup_md5path_->BindPathHash(md5path);
-  bool found = sql_lookup_md5path_->FetchRow();
+  if ((path_filter_ != NULL) && !path_filter_->MayContain(md5path))
+    return false;
+
+  Reader *reader = LockReader();
+  SqlLookupPathHash *sql_lookup_md5path =
+    (reader == NULL) ? sql_lookup_md5path_ : reader->sql_lookup_md5path;
+  sql_lookup_md5path->BindPathHash(md5path);
+  bool found = sql_lookup_md5path->FetchRow();
   if (found && (dirent != NULL)) {
-    *dirent = sql_lookup_md5path_->GetDirent(this, expand_symlink);
+    *dirent = sql_lookup_md5path->GetDirent(this, expand_symlink);
     FixTransitionPoint(md5path, dirent);
   }
-  sql_lookup_md5path_->Reset();
+  sql_lookup_md5path->Reset();
+  UnlockReader(reader);
 
   return found;
 }
@@ -374,10 +409,12 @@ bool Catalog::ListingMd5PathStat(const shash::Md5 &md5path,
   DirectoryEntry dirent;
   StatEntry entry;
 
-  MutexLockGuard m(lock_);
-  sql_listing_->BindPathHash(md5path);
-  while (sql_listing_->FetchRow()) {
-    dirent = sql_listing_->GetDirent(this);
+  Reader *reader = LockReader();
+  SqlListing *sql_listing =
+    (reader == NULL) ? sql_listing_ : reader->sql_listing;
+  sql_listing->BindPathHash(md5path);
+  while (sql_listing->FetchRow()) {
+    dirent = sql_listing->GetDirent(this);
     if (dirent.IsHidden())
       continue;
     FixTransitionPoint(md5path, &dirent);
@@ -385,7 +422,8 @@ bool Catalog::ListingMd5PathStat(const shash::Md5 &md5path,
     entry.info = dirent.GetStatStructure();
     listing->PushBack(entry);
   }
-  sql_listing_->Reset();
+  sql_listing->Reset();
+  UnlockReader(reader);
 
   return true;
 }
@@ -603,6 +641,7 @@ inode_t Catalog::GetMangledInode(const uint64_t row_id,
   // Hardlinks are encoded in catalog-wide unique hard link group ids.
   // These ids must be resolved to actual inode relationships at runtime.
   if (hardlink_group > 0) {
+    MutexLockGuard m(lock_hardlinks_);
     HardlinkGroupMap::const_iterator inode_iter =
       hardlink_groups_.find(hardlink_group);
 
@@ -845,4 +884,195 @@ void Catalog::FixTransitionPoint(const shash::Md5 &md5path,
   }
 }
 
+
+/**
+ * The path filter is only used if it was created for exactly this state of
+ * the catalog, i.e. for the current revision and maximum row id.  A stale
+ * filter, e.g. left behind by a tool that modified the catalog, would hide
+ * entries.
+ */
+void Catalog::LoadPathFilter() {
+  if (IsWritable() || !database_->HasProperty(kPathFilterKey))
+    return;
+
+  const vector<string> tokens =
+    SplitString(database_->GetProperty<string>(kPathFilterKey), ':');
+  string data;
+  if ((tokens.size() != 3) ||
+      (String2Uint64(tokens[0]) != GetRevision()) ||
+      (String2Uint64(tokens[1]) != max_row_id_) ||
+      !Debase64(tokens[2], &data))
+  {
+    LogCvmfs(kLogCatalog, kLogDebug, "ignoring stale path filter of %s",
+             mountpoint_.c_str());
+    return;
+  }
+  path_filter_ = PathFilter::Deserialize(data);
+  if (path_filter_ == NULL) {
+    LogCvmfs(kLogCatalog, kLogDebug, "invalid path filter in %s",
+             mountpoint_.c_str());
+  }
+}
+
+
+/**
+ * Locks the main database connection if it is idle.  Otherwise tries to get
+ * an additional reader, so that concurrent lookups in the same catalog do not
+ * queue up behind each other.  Returns NULL if the main connection is to be
+ * used.  Every call needs to be matched by UnlockReader().
+ */
+Catalog::Reader *Catalog::LockReader() const {
+  if (pthread_mutex_trylock(lock_) == 0)
+    return NULL;
+  Reader *reader = AcquireReader();
+  if (reader == NULL)
+    pthread_mutex_lock(lock_);
+  return reader;
+}
+
+
+/**
+ * Keeps up to kMaxIdleReaders readers for reuse and closes the others.
+ */
+void Catalog::UnlockReader(Reader *reader) const {
+  if (reader == NULL) {
+    pthread_mutex_unlock(lock_);
+    return;
+  }
+  {
+    MutexLockGuard m(lock_readers_);
+    if (idle_readers_.size() < kMaxIdleReaders) {
+      idle_readers_.push_back(reader);
+      return;
+    }
+    num_readers_--;
+  }
+  CloseReader(reader);
+}
+
+
+/**
+ * Reuses an idle reader or opens a new one unless the limit of this catalog or
+ * of all catalogs is reached.  Writable catalogs don't use readers because they
+ * would not see the changes of the current transaction.
+ */
+Catalog::Reader *Catalog::AcquireReader() const {
+  if (IsWritable())
+    return NULL;
+
+  {
+    MutexLockGuard m(lock_readers_);
+    if (!idle_readers_.empty()) {
+      Reader *reader = idle_readers_.back();
+      idle_readers_.pop_back();
+      return reader;
+    }
+    if (readers_failed_ || (num_readers_ >= kMaxReaders))
+      return NULL;
+    if (atomic_xadd32(&num_readers_total_, 1) >=
+        static_cast<int32_t>(kMaxReadersTotal))
+    {
+      atomic_dec32(&num_readers_total_);
+      return NULL;
+    }
+    num_readers_++;
+  }
+
+  Reader *reader = OpenReader();
+  if (reader == NULL) {
+    atomic_dec32(&num_readers_total_);
+    MutexLockGuard m(lock_readers_);
+    num_readers_--;
+    readers_failed_ = true;
+  }
+  return reader;
+}
+
+
+/**
+ * Opening the database happens outside the catalog locks.
+ */
+Catalog::Reader *Catalog::OpenReader() const {
+  const string reader_path = GetReaderPath();
+  if (reader_path.empty())
+    return NULL;
+
+  CatalogDatabase *reader_database =
+    CatalogDatabase::Open(reader_path, CatalogDatabase::kOpenReadOnly);
+  if (reader_database == NULL) {
+    LogCvmfs(kLogCatalog, kLogDebug, "failed to open reader for catalog %s",
+             mountpoint_.c_str());
+    return NULL;
+  }
+  // Carry over a possible schema fix-up of the main connection
+  reader_database->EnforceSchema(database_->schema_version(),
+                                 database_->schema_revision());
+  EnableMmap(*reader_database);
+
+  Reader *reader = new Reader();
+  reader->database = reader_database;
+  reader->sql_lookup_md5path = new SqlLookupPathHash(*reader_database);
+  reader->sql_listing = new SqlListing(*reader_database);
+  LogCvmfs(kLogCatalog, kLogDebug, "opened additional reader for catalog %s",
+           mountpoint_.c_str());
+  return reader;
+}
+
+
+/**
+ * Catalogs in the client are opened through the read-only VFS by file
+ * descriptor, which then needs to be duplicated for another connection.  That
+ * requires the main connection, so the caller must not hold lock_.
+ */
+string Catalog::GetReaderPath() const {
+  const string &filename = database_->filename();
+  if (filename.empty() || (filename[0] != '@'))
+    return filename;
+
+  int fd = -1;
+  int retval;
+  {
+    MutexLockGuard m(lock_);
+    retval = sqlite3_file_control(database_->sqlite_db(), "main",
+                                  sqlite::kFcntlDupFd, &fd);
+  }
+  if ((retval != SQLITE_OK) || (fd < 0))
+    return "";
+  return "@" + StringifyInt(fd);
+}
+
+
+/**
+ * Catalogs opened through the read-only VFS of the client are memory-mapped by
+ * the VFS if the cache manager allows for it.  SQlite only uses the mapping up
+ * to mmap_size, which is set to the size of the catalog file.  Other databases
+ * keep SQlite's default of reading through xRead().
+ */
+void Catalog::EnableMmap(const CatalogDatabase &database) {
+  const string &filename = database.filename();
+  if (database.read_write() || filename.empty() || (filename[0] != '@'))
+    return;
+
+  sqlite::Sql sql_page_count(database.sqlite_db(), "PRAGMA page_count;");
+  sqlite::Sql sql_page_size(database.sqlite_db(), "PRAGMA page_size;");
+  if (!sql_page_count.FetchRow() || !sql_page_size.FetchRow())
+    return;
+  const uint64_t size = static_cast<uint64_t>(sql_page_count.RetrieveInt64(0))
+                        * sql_page_size.RetrieveInt64(0);
+  const string pragma = "PRAGMA mmap_size=" + StringifyUint(size) + ";";
+  if (!sqlite::Sql(database.sqlite_db(), pragma).Execute()) {
+    LogCvmfs(kLogCatalog, kLogDebug, "failed to enable mmap for %s",
+             filename.c_str());
+  }
+}
+
+
+void Catalog::CloseReader(Reader *reader) {
+  delete reader->sql_listing;
+  delete reader->sql_lookup_md5path;
+  delete reader->database;
+  delete reader;
+  atomic_dec32(&num_readers_total_);
+}
+
 }  // namespace catalog
@@ -22,6 +22,7 @@
 #include "shortstring.h"
 #include "sql.h"
 #include "uid_map.h"
+#include "util/atomic.h"
 #include "xattr.h"
 
 namespace swissknife {
@@ -34,6 +35,7 @@ template <class CatalogT>
 class AbstractCatalogManager;
 
 class Catalog;
+class PathFilter;
 
 class Counters;
 
@@ -91,6 +93,10 @@ class InodeAnnotation {
 class Catalog : SingleCopy {
   FRIEND_TEST(T_Catalog, NormalizePath);
   FRIEND_TEST(T_Catalog, PlantPath);
+  FRIEND_TEST(T_Catalog, Readers);
+  FRIEND_TEST(T_Catalog, ReaderLimits);
+  FRIEND_TEST(T_Catalog, Mmap);
+  FRIEND_TEST(T_Catalog, PathFilter);
   friend class swissknife::CommandMigrate;  // for catalog version migration
 
  public:
@@ -254,6 +260,11 @@ class Catalog : SingleCopy {
 
   bool LookupMd5Path(const shash::Md5 &md5path, DirectoryEntry *dirent) const;
 
+  /**
+   * Name of the catalog property that stores the PathFilter
+   */
+  static const char *kPathFilterKey;
+
  private:
   typedef std::map<PathString, Catalog*> NestedCatalogMap;
 
@@ -275,6 +286,42 @@ class Catalog : SingleCopy {
 
   void FixTransitionPoint(const shash::Md5 &md5path,
                           DirectoryEntry *dirent) const;
+  void LoadPathFilter();
+
+  /**
+   * An additional read-only connection to the catalog database together with
+   * its prepared statements for the hot lookup paths.  Readers are only used
+   * if the main connection is busy with another thread.
+   */
+  struct Reader {
+    Reader() : database(NULL), sql_lookup_md5path(NULL), sql_listing(NULL) { }
+    CatalogDatabase   *database;
+    SqlLookupPathHash *sql_lookup_md5path;
+    SqlListing        *sql_listing;
+  };
+
+  /**
+   * Upper bound for the number of additional connections per catalog
+   */
+  static const unsigned kMaxReaders = 8;
+  /**
+   * Readers beyond this number are closed when they become idle, so that a
+   * burst of lookups does not leave file descriptors open in cold catalogs
+   */
+  static const unsigned kMaxIdleReaders = 2;
+  /**
+   * Upper bound for the number of additional connections of all catalogs.
+   * Each one holds a file descriptor and possibly a mapping of the catalog.
+   */
+  static const unsigned kMaxReadersTotal = 128;
+
+  Reader *LockReader() const;
+  void UnlockReader(Reader *reader) const;
+  Reader *AcquireReader() const;
+  Reader *OpenReader() const;
+  std::string GetReaderPath() const;
+  static void CloseReader(Reader *reader);
+  static void EnableMmap(const CatalogDatabase &database);
 
   bool LookupXattrsMd5Path(const shash::Md5 &md5path, XattrList *xattrs) const;
   bool ListMd5PathChunks(const shash::Md5 &md5path,
@@ -324,6 +371,11 @@ class Catalog : SingleCopy {
   // Point to the maps in the catalog manager
   const OwnerMap *uid_map_;
   const OwnerMap *gid_map_;
+  /**
+   * Loaded for read-only catalogs if the publisher stored a filter that
+   * matches this revision of the catalog, otherwise NULL.
+   */
+  PathFilter *path_filter_;
 
   SqlListing                  *sql_listing_;
   SqlLookupPathHash           *sql_lookup_md5path_;
@@ -334,6 +386,24 @@ class Catalog : SingleCopy {
   SqlChunksListing            *sql_chunks_listing_;
   SqlLookupXattrs             *sql_lookup_xattrs_;
 
+  /**
+   * Pool of idle readers.  Protected by lock_readers_.  Once opening a reader
+   * fails, readers_failed_ is set so that no further attempts are made.
+   */
+  mutable std::vector<Reader *> idle_readers_;
+  mutable unsigned num_readers_;
+  mutable bool readers_failed_;
+  pthread_mutex_t *lock_readers_;
+  /**
+   * Open readers of all catalogs
+   */
+  static atomic_int32 num_readers_total_;
+  /**
+   * Protects hardlink_groups_, which is filled while entries are retrieved
+   * through concurrent readers.
+   */
+  pthread_mutex_t *lock_hardlinks_;
+
   mutable HashVector        referenced_hashes_;
 };  // class Catalog
 
@@ -176,6 +176,7 @@ class AbstractCatalogManager : public SingleCopy {
   }
   bool volatile_flag() const { return volatile_flag_; }
   uint64_t GetRevision() const;
+  uint64_t GetIncarnation() const;
   uint64_t GetTTL() const;
   bool HasExplicitTTL() const;
   bool GetVOMSAuthz(std::string *authz) const;
@@ -298,7 +299,8 @@ class AbstractCatalogManager : public SingleCopy {
    */
   std::string authz_cache_;
   /**
-   * Counts how often the inodes have been invalidated.
+   * Counts how often the inodes have been invalidated.  Increased whenever a
+   * catalog is detached because it gets new inodes if it is attached again.
    */
   uint64_t incarnation_;
   // TODO(molina) we could just add an atomic global counter instead
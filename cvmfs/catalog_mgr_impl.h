@@ -674,6 +674,16 @@ uint64_t AbstractCatalogManager<CatalogT>::GetRevision() const {
 }
 
 
+template <class CatalogT>
+uint64_t AbstractCatalogManager<CatalogT>::GetIncarnation() const {
+  ReadLock();
+  const uint64_t incarnation = incarnation_;
+  Unlock();
+
+  return incarnation;
+}
+
+
 template <class CatalogT>
 bool AbstractCatalogManager<CatalogT>::GetVOMSAuthz(std::string *authz) const {
   ReadLock();
@@ -997,6 +1007,7 @@ void AbstractCatalogManager<CatalogT>::DetachCatalog(CatalogT *catalog) {
     catalog->parent()->RemoveChild(catalog);
 
   ReleaseInodes(catalog->inode_range());
+  ++incarnation_;
   UnloadCatalog(catalog);
 
   // Delete catalog from internal lists
@@ -49,6 +49,7 @@ WritableCatalogManager::WritableCatalogManager(
   , nested_kcatalog_limit_(nested_kcatalog_limit)
   , root_kcatalog_limit_(root_kcatalog_limit)
   , file_mbyte_limit_(file_mbyte_limit)
+  , path_filters_(false)
   , is_balanceable_(is_balanceable)
   , max_weight_(max_weight)
   , min_weight_(min_weight)
@@ -1216,6 +1217,9 @@ void WritableCatalogManager::FinalizeCatalog(WritableCatalog *catalog,
 
   // compaction of bloated catalogs (usually after high database churn)
   catalog->VacuumDatabaseIfNecessary();
+
+  // the path filter is tied to the row ids, which change during compaction
+  catalog->UpdatePathFilter(path_filters_);
 }
 
 
@@ -141,6 +141,10 @@ class WritableCatalogManager : public SimpleCatalogManager {
 
   void SetTTL(const uint64_t new_ttl);
   bool SetVOMSAuthz(const std::string &voms_authz);
+  /**
+   * If enabled, committed catalogs store a PathFilter for the clients.
+   */
+  void SetPathFilters(const bool enabled) { path_filters_ = enabled; }
   bool Commit(const bool           stop_for_tweaks,
               const uint64_t       manual_revision,
               manifest::Manifest  *manifest);
@@ -240,6 +244,8 @@ class WritableCatalogManager : public SimpleCatalogManager {
   unsigned root_kcatalog_limit_;
   unsigned file_mbyte_limit_;
 
+  bool path_filters_;
+
   /**
    * Directories don't have extended attributes at this point.
    */
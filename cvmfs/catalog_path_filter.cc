@@ -0,0 +1,88 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "catalog_path_filter.h"
+
+using namespace std;  // NOLINT
+
+namespace catalog {
+
+const unsigned PathFilter::kBitsPerEntry;
+const unsigned PathFilter::kNumHashes;
+const unsigned char PathFilter::kVersion;
+
+
+PathFilter::PathFilter(const uint64_t num_entries)
+  : num_hashes_(kNumHashes)
+{
+  const uint64_t num_words = (num_entries * kBitsPerEntry + 63) / 64;
+  bits_.resize((num_words > 0) ? num_words : 1, 0);
+  num_bits_ = bits_.size() * 64;
+}
+
+
+void PathFilter::Add(const shash::Md5 &md5path) {
+  uint64_t h1, h2;
+  md5path.ToIntPair(&h1, &h2);
+  for (unsigned i = 0; i < num_hashes_; ++i) {
+    const uint64_t pos = (h1 + i * h2) % num_bits_;
+    bits_[pos / 64] |= uint64_t(1) << (pos % 64);
+  }
+}
+
+
+bool PathFilter::MayContain(const shash::Md5 &md5path) const {
+  uint64_t h1, h2;
+  md5path.ToIntPair(&h1, &h2);
+  for (unsigned i = 0; i < num_hashes_; ++i) {
+    const uint64_t pos = (h1 + i * h2) % num_bits_;
+    if ((bits_[pos / 64] & (uint64_t(1) << (pos % 64))) == 0)
+      return false;
+  }
+  return true;
+}
+
+
+/**
+ * Format: version byte, number of hash functions byte, followed by the bit
+ * array as little-endian 64bit words.
+ */
+string PathFilter::Serialize() const {
+  string result;
+  result.reserve(2 + bits_.size() * 8);
+  result.push_back(static_cast<char>(kVersion));
+  result.push_back(static_cast<char>(num_hashes_));
+  for (unsigned i = 0; i < bits_.size(); ++i) {
+    for (unsigned j = 0; j < 8; ++j)
+      result.push_back(static_cast<char>((bits_[i] >> (8 * j)) & 0xFF));
+  }
+  return result;
+}
+
+
+PathFilter *PathFilter::Deserialize(const string &data) {
+  if ((data.length() < 2 + 8) || (((data.length() - 2) % 8) != 0))
+    return NULL;
+  if (static_cast<unsigned char>(data[0]) != kVersion)
+    return NULL;
+  const unsigned num_hashes = static_cast<unsigned char>(data[1]);
+  if (num_hashes == 0)
+    return NULL;
+
+  PathFilter *filter = new PathFilter();
+  filter->num_hashes_ = num_hashes;
+  filter->bits_.resize((data.length() - 2) / 8, 0);
+  filter->num_bits_ = filter->bits_.size() * 64;
+  const unsigned char *bytes =
+    reinterpret_cast<const unsigned char *>(data.data()) + 2;
+  for (unsigned i = 0; i < filter->bits_.size(); ++i) {
+    uint64_t word = 0;
+    for (unsigned j = 0; j < 8; ++j)
+      word |= static_cast<uint64_t>(bytes[i * 8 + j]) << (8 * j);
+    filter->bits_[i] = word;
+  }
+  return filter;
+}
+
+}  // namespace catalog
@@ -0,0 +1,58 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_CATALOG_PATH_FILTER_H_
+#define CVMFS_CATALOG_PATH_FILTER_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "crypto/hash.h"
+
+namespace catalog {
+
+/**
+ * Bloom filter over the md5 path hashes of a catalog.  It is created by the
+ * publisher and stored as a catalog property.  Clients consult it before
+ * querying the catalog database, so that most lookups of absent paths are
+ * answered from memory.  There are no false negatives; with kBitsPerEntry bits
+ * per path about 1% of the absent paths still need a database query.
+ *
+ * The md5 path hashes are already uniformly distributed, so the bit positions
+ * are derived from the two halves of the hash by double hashing.
+ */
+class PathFilter {
+ public:
+  static const unsigned kBitsPerEntry = 10;
+  static const unsigned kNumHashes = 7;
+  static const unsigned char kVersion = 1;
+
+  /**
+   * Creates an empty filter sized for num_entries paths.
+   */
+  explicit PathFilter(const uint64_t num_entries);
+  /**
+   * Returns NULL if the data is not a valid serialized filter.
+   */
+  static PathFilter *Deserialize(const std::string &data);
+
+  void Add(const shash::Md5 &md5path);
+  bool MayContain(const shash::Md5 &md5path) const;
+  std::string Serialize() const;
+
+  uint64_t num_bits() const { return num_bits_; }
+
+ private:
+  PathFilter() : num_bits_(0), num_hashes_(0) { }
+
+  uint64_t num_bits_;
+  unsigned num_hashes_;
+  std::vector<uint64_t> bits_;
+};
+
+}  // namespace catalog
+
+#endif  // CVMFS_CATALOG_PATH_FILTER_H_
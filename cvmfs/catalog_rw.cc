@@ -10,9 +10,11 @@
 #include <cstdio>
 #include <cstdlib>
 
+#include "catalog_path_filter.h"
 #include "util/concurrency.h"
 #include "util/exception.h"
 #include "util/logging.h"
+#include "util/string.h"
 #include "xattr.h"
 
 using namespace std;  // NOLINT
@@ -354,6 +356,41 @@ void WritableCatalog::SetPreviousRevision(const shash::Any &hash) {
 }
 
 
+/**
+ * Stores a PathFilter of all the path hashes in this catalog.  Needs to be
+ * called after the last modification of the entries and the revision.  If
+ * disabled, removes the filter of a previous revision.
+ */
+void WritableCatalog::UpdatePathFilter(const bool enabled) {
+  if (!enabled) {
+    SqlCatalog sql_remove(database(),
+                          "DELETE FROM properties WHERE key = :key;");
+    const bool retval =
+      sql_remove.BindText(1, kPathFilterKey) && sql_remove.Execute();
+    assert(retval);
+    return;
+  }
+
+  SqlCatalog sql_count(database(), "SELECT count(*), MAX(rowid) FROM catalog;");
+  bool retval = sql_count.FetchRow();
+  assert(retval);
+  PathFilter path_filter(sql_count.RetrieveInt64(0));
+  const uint64_t max_row_id = sql_count.RetrieveInt64(1);
+
+  SqlCatalog sql_paths(database(), "SELECT md5path_1, md5path_2 FROM catalog;");
+  while (sql_paths.FetchRow())
+    path_filter.Add(sql_paths.RetrieveMd5(0, 1));
+
+  retval = database().SetProperty(kPathFilterKey,
+    StringifyUint(GetRevision()) + ":" + StringifyUint(max_row_id) + ":" +
+    Base64(path_filter.Serialize()));
+  assert(retval);
+  LogCvmfs(kLogCatalog, kLogVerboseMsg, "stored path filter of %" PRIu64
+           " bits for catalog '%s'",
+           path_filter.num_bits(), mountpoint().c_str());
+}
+
+
 /**
  * Moves a subtree from this catalog into a just created nested catalog.
  */
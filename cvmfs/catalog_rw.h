@@ -105,6 +105,7 @@ class WritableCatalog : public Catalog {
   void SetPreviousRevision(const shash::Any &hash);
   void SetTTL(const uint64_t new_ttl);
   bool SetVOMSAuthz(const std::string &voms_authz);
+  void UpdatePathFilter(const bool enabled);
 
  protected:
   static const double kMaximalFreePageRatio;  // = 0.2
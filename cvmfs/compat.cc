@@ -168,6 +168,65 @@ void Migrate(InodeTracker *old_tracker, glue::InodeTracker *new_tracker) {
 //------------------------------------------------------------------------------
 
 
+namespace inode_tracker_v4 {
+
+void Migrate(InodeTracker *old_tracker, glue::InodeTracker *new_tracker) {
+  // The old hash tables may refer to the hash functions of the unloaded
+  // library.  Copies are filled using the hash functions of this library.
+  glue::PathMap path_map;
+  path_map = old_tracker->path_map_;
+  glue::InodeExMap inode_ex_map;
+  inode_ex_map = old_tracker->inode_ex_map_;
+
+  SmallHashDynamic<uint64_t, uint32_t> *old_inodes =
+    &old_tracker->inode_references_.map_;
+  for (unsigned i = 0; i < old_inodes->capacity(); ++i) {
+    const uint64_t inode = old_inodes->keys()[i];
+    if (inode == 0) continue;
+
+    const uint32_t references = old_inodes->values()[i];
+    glue::InodeEx inode_ex(inode, glue::InodeEx::kUnknownType);
+    shash::Md5 md5path;
+    bool retval = inode_ex_map.LookupMd5Path(&inode_ex, &md5path);
+    assert(retval);
+    PathString path;
+    retval = path_map.LookupPath(md5path, &path);
+    assert(retval);
+    new_tracker->VfsGetBy(inode_ex, references, path);
+  }
+}
+
+}  // namespace inode_tracker_v4
+
+
+//------------------------------------------------------------------------------
+
+
+namespace dentry_tracker {
+
+void Migrate(DentryTracker *old_tracker, glue::DentryTracker *new_tracker) {
+  if (!old_tracker->is_active_)
+    new_tracker->Disable();
+
+  DentryTracker::Entry *head = NULL;
+  if (!old_tracker->entries_.Peek(&head))
+    return;
+  const uint64_t now = platform_monotonic_time();
+  for (size_t i = 0; i < old_tracker->entries_.size(); ++i) {
+    const DentryTracker::Entry *entry = head + i;
+    if (entry->expiry <= now)
+      continue;
+    new_tracker->Add(entry->inode_parent, entry->name.ToString().c_str(),
+                     entry->expiry - now);
+  }
+}
+
+}  // namespace dentry_tracker
+
+
+//------------------------------------------------------------------------------
+
+
 namespace chunk_tables {
 
 ChunkTables::~ChunkTables() {
@@ -18,6 +18,7 @@
 #include "bigvector.h"
 #include "catalog_mgr.h"
 #include "crypto/hash.h"
+#include "fd_table.h"
 #include "file_chunk.h"
 #include "glue_buffer.h"
 #include "shortstring.h"
@@ -835,6 +836,102 @@ void Migrate(InodeTracker *old_tracker, glue::InodeTracker *new_tracker);
 //------------------------------------------------------------------------------
 
 
+namespace inode_tracker_v4 {
+
+/**
+ * Same memory layout as glue::InodeReferences with accessible reference
+ * counters
+ */
+class InodeReferences {
+ public:
+  InodeReferences() { assert(false); }
+// private:
+  SmallHashDynamic<uint64_t, uint32_t> map_;
+};
+
+/**
+ * The inode tracker before it was split into stripes.  The containers are
+ * unchanged.
+ */
+class InodeTracker {
+ public:
+  InodeTracker() { assert(false); }
+  explicit InodeTracker(const InodeTracker &other) { assert(false); }
+  InodeTracker &operator= (const InodeTracker &other) { assert(false); }
+  ~InodeTracker() {
+    pthread_mutex_destroy(lock_);
+    free(lock_);
+  }
+
+// private:
+  static const unsigned kVersion = 4;
+
+  unsigned version_;
+  pthread_mutex_t *lock_;
+  glue::PathMap path_map_;
+  glue::InodeExMap inode_ex_map_;
+  InodeReferences inode_references_;
+  glue::InodeTracker::Statistics statistics_;
+};
+
+void Migrate(InodeTracker *old_tracker, glue::InodeTracker *new_tracker);
+
+}  // namespace inode_tracker_v4
+
+
+//------------------------------------------------------------------------------
+
+
+namespace dentry_tracker {
+
+/**
+ * The dentry tracker before it was split into stripes
+ */
+class DentryTracker {
+ public:
+  struct Entry {
+    Entry() { assert(false); }
+    uint64_t expiry;
+    uint64_t inode_parent;
+    NameString name;
+  };
+
+  struct Statistics {
+    int64_t num_insert;
+    int64_t num_remove;
+    int64_t num_prune;
+  };
+
+  DentryTracker() { assert(false); }
+  DentryTracker(const DentryTracker &other) { assert(false); }
+  DentryTracker &operator= (const DentryTracker &other) { assert(false); }
+  ~DentryTracker() {
+    pthread_mutex_destroy(lock_);
+    free(lock_);
+  }
+
+// private:
+  static const unsigned kVersion = 0;
+
+  pthread_mutex_t *lock_;
+  unsigned version_;
+  Statistics statistics_;
+  bool is_active_;
+  BigQueue<Entry> entries_;
+
+  int pipe_terminate_[2];
+  int cleaning_interval_ms_;
+  pthread_t thread_cleaner_;
+};
+
+void Migrate(DentryTracker *old_tracker, glue::DentryTracker *new_tracker);
+
+}  // namespace dentry_tracker
+
+
+//------------------------------------------------------------------------------
+
+
 namespace chunk_tables {
 
 class FileChunk {
@@ -984,6 +1081,45 @@ void Migrate(ChunkTables *old_tables, ::ChunkTables *new_tables);
 }  // namespace chunk_tables_v3
 
 
+//------------------------------------------------------------------------------
+
+
+namespace cache_extern {
+
+/**
+ * The file descriptor of the external cache manager before it carried the
+ * location of the object in the shared memory region
+ */
+struct ReadOnlyHandle {
+  ReadOnlyHandle() : id() { }
+  explicit ReadOnlyHandle(const shash::Any &h) : id(h) { }
+  bool operator ==(const ReadOnlyHandle &other) const {
+    return this->id == other.id;
+  }
+  bool operator !=(const ReadOnlyHandle &other) const {
+    return this->id != other.id;
+  }
+  shash::Any id;
+};
+
+/**
+ * The shared memory location of the migrated handles remains unknown.
+ */
+template <class NewHandleT>
+NewHandleT MigrateHandle(const ReadOnlyHandle &old_handle) {
+  return NewHandleT(old_handle.id);
+}
+
+template <class NewHandleT>
+void Migrate(const FdTable<ReadOnlyHandle> &old_fd_table,
+             FdTable<NewHandleT> *new_fd_table)
+{
+  new_fd_table->AssignFrom(old_fd_table, &MigrateHandle<NewHandleT>);
+}
+
+}  // namespace cache_extern
+
+
 }  // namespace compat
 
 #endif  // CVMFS_COMPAT_H_
@@ -3,6 +3,8 @@
  *
  * This is a wrapper around zlib.  It provides
  * a set of functions to conveniently compress and decompress stuff.
+ * Zstandard and LZ4 are available through the Compressor and Decompressor
+ * classes if the build enables them (ENABLE_ZSTD_LZ4).
  * Almost all of the functions return true on success, otherwise false.
  *
  * TODO: think about code deduplication
@@ -14,6 +16,12 @@
 #include <alloca.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef CVMFS_ENABLE_ZSTD_LZ4
+#include <lz4frame.h>
+#include <zstd.h>
+#endif
 
 #include <algorithm>
 #include <cassert>
@@ -23,8 +31,10 @@
 #include "util/exception.h"
 #include "util/logging.h"
 #include "util/platform.h"
+#include "util/pointer.h"
 #include "util/posix.h"
 #include "util/smalloc.h"
+#include "util/string.h"
 
 using namespace std;  // NOLINT
 
@@ -150,11 +160,48 @@ Algorithms ParseCompressionAlgorithm(const std::string &algorithm_option) {
     return kZlibDefault;
   if (algorithm_option == "none")
     return kNoCompression;
+#ifdef CVMFS_ENABLE_ZSTD_LZ4
+  if (algorithm_option == "lz4")
+    return kLz4;
+  // Zstandard takes an optional compression level, e.g. zstd:19
+  if (algorithm_option == "zstd")
+    return kZstd;
+  if (HasPrefix(algorithm_option, "zstd:", false) &&
+      (ParseCompressionLevel(algorithm_option) > 0))
+  {
+    return kZstd;
+  }
+#else
+  if ((algorithm_option == "lz4") ||
+      HasPrefix(algorithm_option, "zstd", false))
+  {
+    PANIC(kLogStderr, "compression algorithm %s is not supported by this "
+          "build", algorithm_option.c_str());
+  }
+#endif
   PANIC(kLogStderr, "unknown compression algorithms: %s",
         algorithm_option.c_str());
 }
 
 
+/**
+ * Returns the level of an algorithm option such as zstd:19 or 0 if the option
+ * does not specify a level, i.e. the algorithm's default level is used.
+ */
+int ParseCompressionLevel(const std::string &algorithm_option) {
+  const size_t separator = algorithm_option.find(':');
+  if (separator == std::string::npos)
+    return 0;
+  uint64_t level;
+  if (!String2Uint64Parse(algorithm_option.substr(separator + 1), &level) ||
+      (level == 0) || (level > 99))
+  {
+    return 0;
+  }
+  return static_cast<int>(level);
+}
+
+
 std::string AlgorithmName(const zlib::Algorithms alg) {
   switch (alg) {
     case kZlibDefault:
@@ -163,6 +210,12 @@ std::string AlgorithmName(const zlib::Algorithms alg) {
     case kNoCompression:
       return "none";
       break;
+    case kZstd:
+      return "zstd";
+      break;
+    case kLz4:
+      return "lz4";
+      break;
     // Purposely did not add a 'default' statement here: this will
     // cause the compiler to generate a warning if a new algorithm
     // is added but this function is not updated.
@@ -171,6 +224,24 @@ std::string AlgorithmName(const zlib::Algorithms alg) {
 }
 
 
+/**
+ * Clients older than the returned version do not know the algorithm and
+ * would serve the compressed bytes as file contents.  Empty if all clients
+ * support the algorithm.
+ */
+std::string MinClientVersion(const zlib::Algorithms alg) {
+  switch (alg) {
+    case kZlibDefault:
+    case kNoCompression:
+      return "";
+    case kZstd:
+    case kLz4:
+      return "2.11.0";
+  }
+  return "";
+}
+
+
 void CompressInit(z_stream *strm) {
   strm->zalloc = Z_NULL;
   strm->zfree = Z_NULL;
@@ -858,6 +929,20 @@ bool DecompressMem2Mem(const void *buf, const int64_t size,
 void Compressor::RegisterPlugins() {
   RegisterPlugin<ZlibCompressor>();
   RegisterPlugin<EchoCompressor>();
+#ifdef CVMFS_ENABLE_ZSTD_LZ4
+  RegisterPlugin<ZstdCompressor>();
+  RegisterPlugin<Lz4Compressor>();
+#endif
+}
+
+
+void Decompressor::RegisterPlugins() {
+  RegisterPlugin<ZlibDecompressor>();
+  RegisterPlugin<EchoDecompressor>();
+#ifdef CVMFS_ENABLE_ZSTD_LZ4
+  RegisterPlugin<ZstdDecompressor>();
+  RegisterPlugin<Lz4Decompressor>();
+#endif
 }
 
 
@@ -979,4 +1064,512 @@ size_t EchoCompressor::DeflateBound(const size_t bytes) {
   return (bytes == 0) ? 1 : bytes;
 }
 
+
+
+//------------------------------------------------------------------------------
+
+
+#ifdef CVMFS_ENABLE_ZSTD_LZ4
+const int ZstdCompressor::kDefaultLevel;
+
+
+ZstdCompressor::ZstdCompressor(const zlib::Algorithms &alg)
+  : Compressor(alg)
+  , cctx_(ZSTD_createCCtx())
+  , level_(kDefaultLevel)
+{
+  assert(cctx_ != NULL);
+  size_t retval =
+    ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, level_);
+  assert(!ZSTD_isError(retval));
+}
+
+
+ZstdCompressor::~ZstdCompressor() {
+  ZSTD_freeCCtx(cctx_);
+}
+
+
+bool ZstdCompressor::WillHandle(const zlib::Algorithms &alg) {
+  return alg == kZstd;
+}
+
+
+void ZstdCompressor::SetLevel(const int level) {
+  level_ = std::max(1, std::min(level, ZSTD_maxCLevel()));
+  size_t retval =
+    ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, level_);
+  assert(!ZSTD_isError(retval));
+}
+
+
+/**
+ * A zstd stream cannot be copied once compression started, so the clone
+ * starts a fresh stream with the same compression level.
+ */
+Compressor* ZstdCompressor::Clone() {
+  ZstdCompressor *other = new ZstdCompressor(zlib::kZstd);
+  other->SetLevel(level_);
+  return other;
+}
+
+
+bool ZstdCompressor::Deflate(
+  const bool flush,
+  unsigned char **inbuf, size_t *inbufsize,
+  unsigned char **outbuf, size_t *outbufsize)
+{
+  ZSTD_inBuffer input = { *inbuf, *inbufsize, 0 };
+  ZSTD_outBuffer output = { *outbuf, *outbufsize, 0 };
+  const ZSTD_EndDirective mode = flush ? ZSTD_e_end : ZSTD_e_continue;
+
+  size_t remaining = ZSTD_compressStream2(cctx_, &output, &input, mode);
+  assert(!ZSTD_isError(remaining));
+
+  *outbufsize = output.pos;
+  *inbuf += input.pos;
+  *inbufsize -= input.pos;
+
+  if (flush)
+    return (remaining == 0) && (*inbufsize == 0);
+  return *inbufsize == 0;
+}
+
+
+size_t ZstdCompressor::DeflateBound(const size_t bytes) {
+  return ZSTD_compressBound(bytes);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+const size_t Lz4Compressor::kInputSlice;
+
+
+Lz4Compressor::Lz4Compressor(const zlib::Algorithms &alg)
+  : Compressor(alg)
+  , cctx_(NULL)
+  , staging_size_(0)
+  , staging_pos_(0)
+  , header_written_(false)
+  , finished_(false)
+{
+  LZ4F_errorCode_t retval = LZ4F_createCompressionContext(&cctx_,
+                                                          LZ4F_VERSION);
+  assert(!LZ4F_isError(retval));
+  // Large enough for the frame header, a compressed input slice, and the
+  // frame footer including the data buffered by the library
+  staging_capacity_ =
+    LZ4F_compressBound(kInputSlice, NULL) + LZ4F_HEADER_SIZE_MAX;
+  staging_ = static_cast<unsigned char *>(smalloc(staging_capacity_));
+}
+
+
+Lz4Compressor::~Lz4Compressor() {
+  LZ4F_freeCompressionContext(cctx_);
+  free(staging_);
+}
+
+
+bool Lz4Compressor::WillHandle(const zlib::Algorithms &alg) {
+  return alg == kLz4;
+}
+
+
+Compressor* Lz4Compressor::Clone() {
+  return new Lz4Compressor(zlib::kLz4);
+}
+
+
+bool Lz4Compressor::Deflate(
+  const bool flush,
+  unsigned char **inbuf, size_t *inbufsize,
+  unsigned char **outbuf, size_t *outbufsize)
+{
+  size_t out_pos = 0;
+  while (true) {
+    // Hand out staged output first
+    if (staging_pos_ < staging_size_) {
+      const size_t nbytes =
+        std::min(*outbufsize - out_pos, staging_size_ - staging_pos_);
+      memcpy(*outbuf + out_pos, staging_ + staging_pos_, nbytes);
+      out_pos += nbytes;
+      staging_pos_ += nbytes;
+      if (staging_pos_ < staging_size_)
+        break;
+    }
+    staging_size_ = staging_pos_ = 0;
+
+    size_t retval;
+    if (!header_written_) {
+      retval = LZ4F_compressBegin(cctx_, staging_, staging_capacity_, NULL);
+      header_written_ = true;
+    } else if (*inbufsize > 0) {
+      const size_t nbytes = std::min(*inbufsize, kInputSlice);
+      retval = LZ4F_compressUpdate(cctx_, staging_, staging_capacity_,
+                                   *inbuf, nbytes, NULL);
+      *inbuf += nbytes;
+      *inbufsize -= nbytes;
+    } else if (flush && !finished_) {
+      retval = LZ4F_compressEnd(cctx_, staging_, staging_capacity_, NULL);
+      finished_ = true;
+    } else {
+      break;
+    }
+    assert(!LZ4F_isError(retval));
+    staging_size_ = retval;
+  }
+  *outbufsize = out_pos;
+
+  if (flush)
+    return finished_ && (staging_pos_ == staging_size_);
+  return *inbufsize == 0;
+}
+
+
+size_t Lz4Compressor::DeflateBound(const size_t bytes) {
+  return LZ4F_compressFrameBound(bytes, NULL);
+}
+#endif  // CVMFS_ENABLE_ZSTD_LZ4
+
+
+//------------------------------------------------------------------------------
+
+
+namespace {
+
+class FileSink : public cvmfs::Sink {
+ public:
+  explicit FileSink(FILE *f) : file_(f) { }
+  virtual int64_t Write(const void *buf, uint64_t sz) {
+    if (fwrite(buf, 1, sz, file_) != sz)
+      return -EIO;
+    return sz;
+  }
+  virtual int Reset() {
+    return (ftruncate(fileno(file_), 0) == 0) ? 0 : -errno;
+  }
+
+ private:
+  FILE *file_;
+};
+
+
+/**
+ * Collects output in a growing buffer which is handed over to the caller.
+ */
+class MemSink : public cvmfs::Sink {
+ public:
+  MemSink() : data_(NULL), size_(0), capacity_(0) { }
+  virtual ~MemSink() { free(data_); }
+  virtual int64_t Write(const void *buf, uint64_t sz) {
+    if (size_ + sz > capacity_) {
+      capacity_ = std::max(2 * capacity_,
+                           std::max(size_ + sz, uint64_t(kZChunk)));
+      data_ = static_cast<unsigned char *>(srealloc(data_, capacity_));
+    }
+    memcpy(data_ + size_, buf, sz);
+    size_ += sz;
+    return sz;
+  }
+  virtual int Reset() {
+    size_ = 0;
+    return 0;
+  }
+  void Release(void **buf, uint64_t *size) {
+    *buf = (data_ == NULL) ? smalloc(1) : data_;
+    *size = size_;
+    data_ = NULL;
+    size_ = capacity_ = 0;
+  }
+
+ private:
+  unsigned char *data_;
+  uint64_t size_;
+  uint64_t capacity_;
+};
+
+}  // anonymous namespace
+
+
+StreamStates Decompressor::Decompress2File(
+  const void *buf,
+  const int64_t size,
+  FILE *f)
+{
+  FileSink sink(f);
+  return Decompress2Sink(buf, size, &sink);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+ZlibDecompressor::ZlibDecompressor(const zlib::Algorithms &alg)
+  : Decompressor(alg)
+{
+  DecompressInit(&stream_);
+}
+
+
+ZlibDecompressor::~ZlibDecompressor() {
+  DecompressFini(&stream_);
+}
+
+
+bool ZlibDecompressor::WillHandle(const zlib::Algorithms &alg) {
+  return alg == kZlibDefault;
+}
+
+
+StreamStates ZlibDecompressor::Decompress2Sink(
+  const void *buf,
+  const int64_t size,
+  cvmfs::Sink *sink)
+{
+  return DecompressZStream2Sink(buf, size, &stream_, sink);
+}
+
+
+void ZlibDecompressor::Reset() {
+  int retval = inflateReset(&stream_);
+  assert(retval == Z_OK);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+bool EchoDecompressor::WillHandle(const zlib::Algorithms &alg) {
+  return alg == kNoCompression;
+}
+
+
+StreamStates EchoDecompressor::Decompress2Sink(
+  const void *buf,
+  const int64_t size,
+  cvmfs::Sink *sink)
+{
+  int64_t written = sink->Write(buf, size);
+  if ((written < 0) || (written != size))
+    return kStreamIOError;
+  return kStreamContinue;
+}
+
+
+//------------------------------------------------------------------------------
+
+
+#ifdef CVMFS_ENABLE_ZSTD_LZ4
+ZstdDecompressor::ZstdDecompressor(const zlib::Algorithms &alg)
+  : Decompressor(alg)
+  , dctx_(ZSTD_createDCtx())
+{
+  assert(dctx_ != NULL);
+}
+
+
+ZstdDecompressor::~ZstdDecompressor() {
+  ZSTD_freeDCtx(dctx_);
+}
+
+
+bool ZstdDecompressor::WillHandle(const zlib::Algorithms &alg) {
+  return alg == kZstd;
+}
+
+
+StreamStates ZstdDecompressor::Decompress2Sink(
+  const void *buf,
+  const int64_t size,
+  cvmfs::Sink *sink)
+{
+  unsigned char out[kZChunk];
+  ZSTD_inBuffer input = { buf, static_cast<size_t>(size), 0 };
+  size_t retval = 0;
+  bool output_full;
+
+  do {
+    ZSTD_outBuffer output = { out, kZChunk, 0 };
+    retval = ZSTD_decompressStream(dctx_, &output, &input);
+    if (ZSTD_isError(retval))
+      return kStreamDataError;
+    int64_t written = sink->Write(out, output.pos);
+    if ((written < 0) || (static_cast<uint64_t>(written) != output.pos))
+      return kStreamIOError;
+    // A full output buffer might leave data in the decompressor
+    output_full = (output.pos == output.size);
+  } while ((retval != 0) && ((input.pos < input.size) || output_full));
+
+  if (retval == 0)
+    return (input.pos == input.size) ? kStreamEnd : kStreamDataError;
+  return kStreamContinue;
+}
+
+
+void ZstdDecompressor::Reset() {
+  size_t retval = ZSTD_DCtx_reset(dctx_, ZSTD_reset_session_only);
+  assert(!ZSTD_isError(retval));
+}
+
+
+//------------------------------------------------------------------------------
+
+
+Lz4Decompressor::Lz4Decompressor(const zlib::Algorithms &alg)
+  : Decompressor(alg)
+  , dctx_(NULL)
+{
+  LZ4F_errorCode_t retval = LZ4F_createDecompressionContext(&dctx_,
+                                                            LZ4F_VERSION);
+  assert(!LZ4F_isError(retval));
+}
+
+
+Lz4Decompressor::~Lz4Decompressor() {
+  LZ4F_freeDecompressionContext(dctx_);
+}
+
+
+bool Lz4Decompressor::WillHandle(const zlib::Algorithms &alg) {
+  return alg == kLz4;
+}
+
+
+StreamStates Lz4Decompressor::Decompress2Sink(
+  const void *buf,
+  const int64_t size,
+  cvmfs::Sink *sink)
+{
+  unsigned char out[kZChunk];
+  const unsigned char *input = static_cast<const unsigned char *>(buf);
+  size_t remaining = size;
+  size_t retval = 1;
+  size_t out_size;
+
+  do {
+    out_size = kZChunk;
+    size_t in_size = remaining;
+    retval = LZ4F_decompress(dctx_, out, &out_size, input, &in_size, NULL);
+    if (LZ4F_isError(retval))
+      return kStreamDataError;
+    input += in_size;
+    remaining -= in_size;
+    int64_t written = sink->Write(out, out_size);
+    if ((written < 0) || (static_cast<uint64_t>(written) != out_size))
+      return kStreamIOError;
+    // A full output buffer might leave data in the decompression context
+  } while (((remaining > 0) || (out_size == kZChunk)) && (retval != 0));
+
+  if (retval == 0)
+    return (remaining == 0) ? kStreamEnd : kStreamDataError;
+  return kStreamContinue;
+}
+
+
+void Lz4Decompressor::Reset() {
+  LZ4F_resetDecompressionContext(dctx_);
+}
+#endif  // CVMFS_ENABLE_ZSTD_LZ4
+
+
+//------------------------------------------------------------------------------
+
+
+bool CompressMem2Mem(
+  const Algorithms alg,
+  const void *buf,
+  const int64_t size,
+  void **out_buf,
+  uint64_t *out_size)
+{
+  if (alg == kZlibDefault)
+    return CompressMem2Mem(buf, size, out_buf, out_size);
+
+  UniquePtr<Compressor> compressor(Compressor::Construct(alg));
+  unsigned char *input =
+    const_cast<unsigned char *>(static_cast<const unsigned char *>(buf));
+  size_t remaining = size;
+  uint64_t alloc_size = std::max(compressor->DeflateBound(size),
+                                 static_cast<size_t>(kZChunk));
+  *out_buf = smalloc(alloc_size);
+  *out_size = 0;
+
+  bool done = false;
+  while (!done) {
+    if (alloc_size - *out_size < kZChunk) {
+      alloc_size *= 2;
+      *out_buf = srealloc(*out_buf, alloc_size);
+    }
+    unsigned char *output = static_cast<unsigned char *>(*out_buf) + *out_size;
+    size_t have = alloc_size - *out_size;
+    done = compressor->Deflate(true, &input, &remaining, &output, &have);
+    *out_size += have;
+  }
+  return true;
+}
+
+
+bool DecompressMem2Mem(
+  const Algorithms alg,
+  const void *buf,
+  const int64_t size,
+  void **out_buf,
+  uint64_t *out_size)
+{
+  if (alg == kZlibDefault)
+    return DecompressMem2Mem(buf, size, out_buf, out_size);
+
+  UniquePtr<Decompressor> decompressor(Decompressor::Construct(alg));
+  if (!decompressor.IsValid()) {
+    *out_buf = NULL;
+    *out_size = 0;
+    return false;
+  }
+  MemSink sink;
+  StreamStates retval = decompressor->Decompress2Sink(buf, size, &sink);
+  if ((retval != kStreamEnd) &&
+      !((alg == kNoCompression) && (retval == kStreamContinue)))
+  {
+    *out_buf = NULL;
+    *out_size = 0;
+    return false;
+  }
+  sink.Release(out_buf, out_size);
+  return true;
+}
+
+
+
+bool DecompressPath2File(
+  const Algorithms alg,
+  const string &src,
+  FILE *fdest)
+{
+  if (alg == kZlibDefault)
+    return DecompressPath2File(src, fdest);
+
+  UniquePtr<Decompressor> decompressor(Decompressor::Construct(alg));
+  if (!decompressor.IsValid())
+    return false;
+
+  FILE *fsrc = fopen(src.c_str(), "r");
+  if (!fsrc)
+    return false;
+  StreamStates stream_state = kStreamContinue;
+  size_t have;
+  unsigned char buf[kBufferSize];
+  while ((have = fread(buf, 1, kBufferSize, fsrc)) > 0) {
+    stream_state = decompressor->Decompress2File(buf, have, fdest);
+    if ((stream_state == kStreamDataError) || (stream_state == kStreamIOError))
+      break;
+  }
+  const bool result = !ferror(fsrc) &&
+    ((stream_state == kStreamEnd) ||
+     ((alg == kNoCompression) && (stream_state == kStreamContinue)));
+  fclose(fsrc);
+  return result;
+}
+
 }  // namespace zlib
@@ -20,6 +20,13 @@ struct Any;
 class ContextPtr;
 }
 
+#ifdef CVMFS_ENABLE_ZSTD_LZ4
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+struct LZ4F_cctx_s;
+struct LZ4F_dctx_s;
+#endif
+
 bool CopyPath2Path(const std::string &src, const std::string &dest);
 bool CopyPath2File(const std::string &src, FILE *fdest);
 bool CopyMem2Path(const unsigned char *buffer, const unsigned buffer_size,
@@ -44,6 +51,8 @@ enum StreamStates {
 enum Algorithms {
   kZlibDefault = 0,
   kNoCompression,
+  kZstd,
+  kLz4,
 };
 
 /**
@@ -91,6 +100,12 @@ class Compressor: public PolymorphicConstruction<Compressor, Algorithms> {
   virtual size_t DeflateBound(const size_t bytes) = 0;
   virtual Compressor* Clone() = 0;
 
+  /**
+   * Sets the compression level for algorithms that have one.  Must be called
+   * before the first call to Deflate.  Ignored by the other algorithms.
+   */
+  virtual void SetLevel(const int /* level */) { }
+
   static void RegisterPlugins();
 };
 
@@ -125,8 +140,156 @@ class EchoCompressor: public Compressor {
 };
 
 
+#ifdef CVMFS_ENABLE_ZSTD_LZ4
+/**
+ * Zstandard frames, compressed with kDefaultLevel unless a different level is
+ * set by SetLevel().
+ */
+class ZstdCompressor: public Compressor {
+ public:
+  static const int kDefaultLevel = 3;
+
+  explicit ZstdCompressor(const Algorithms &alg);
+  ~ZstdCompressor();
+
+  bool Deflate(const bool flush,
+               unsigned char **inbuf, size_t *inbufsize,
+               unsigned char **outbuf, size_t *outbufsize);
+  size_t DeflateBound(const size_t bytes);
+  Compressor* Clone();
+  static bool WillHandle(const zlib::Algorithms &alg);
+
+  void SetLevel(const int level);
+  int level() const { return level_; }
+
+ private:
+  ZSTD_CCtx_s *cctx_;
+  int level_;
+};
+
+
+/**
+ * LZ4 frames.  The LZ4 frame API needs an output buffer that can hold a
+ * compressed block, so the output is staged internally and handed out in
+ * pieces of the size provided by the caller.
+ */
+class Lz4Compressor: public Compressor {
+ public:
+  explicit Lz4Compressor(const Algorithms &alg);
+  ~Lz4Compressor();
+
+  bool Deflate(const bool flush,
+               unsigned char **inbuf, size_t *inbufsize,
+               unsigned char **outbuf, size_t *outbufsize);
+  size_t DeflateBound(const size_t bytes);
+  Compressor* Clone();
+  static bool WillHandle(const zlib::Algorithms &alg);
+
+ private:
+  /**
+   * Size of the input slices passed to LZ4F_compressUpdate()
+   */
+  static const size_t kInputSlice = 64 * 1024;
+
+  LZ4F_cctx_s *cctx_;
+  unsigned char *staging_;
+  size_t staging_capacity_;
+  size_t staging_size_;
+  size_t staging_pos_;
+  bool header_written_;
+  bool finished_;
+};
+#endif  // CVMFS_ENABLE_ZSTD_LZ4
+
+
+/**
+ * Streaming counterpart of the Compressor classes.  Used by the download
+ * manager to decompress objects on the fly for the algorithms that are not
+ * handled by the z_stream based functions below.
+ */
+class Decompressor
+  : public PolymorphicConstruction<Decompressor, Algorithms>
+{
+ public:
+  explicit Decompressor(const Algorithms & /* alg */) { }
+  virtual ~Decompressor() { }
+
+  /**
+   * Decompresses the next piece of the compressed stream and writes the
+   * result to sink.  Returns kStreamEnd once the end of the compressed stream
+   * has been reached.
+   */
+  virtual StreamStates Decompress2Sink(const void *buf, const int64_t size,
+                                       cvmfs::Sink *sink) = 0;
+  /**
+   * Prepares the decompressor for a new stream, e.g. on download retries
+   */
+  virtual void Reset() = 0;
+
+  StreamStates Decompress2File(const void *buf, const int64_t size, FILE *f);
+
+  static void RegisterPlugins();
+};
+
+
+class ZlibDecompressor: public Decompressor {
+ public:
+  explicit ZlibDecompressor(const Algorithms &alg);
+  ~ZlibDecompressor();
+  StreamStates Decompress2Sink(const void *buf, const int64_t size,
+                               cvmfs::Sink *sink);
+  void Reset();
+  static bool WillHandle(const zlib::Algorithms &alg);
+
+ private:
+  z_stream stream_;
+};
+
+
+class EchoDecompressor: public Decompressor {
+ public:
+  explicit EchoDecompressor(const Algorithms &alg) : Decompressor(alg) { }
+  StreamStates Decompress2Sink(const void *buf, const int64_t size,
+                               cvmfs::Sink *sink);
+  void Reset() { }
+  static bool WillHandle(const zlib::Algorithms &alg);
+};
+
+
+#ifdef CVMFS_ENABLE_ZSTD_LZ4
+class ZstdDecompressor: public Decompressor {
+ public:
+  explicit ZstdDecompressor(const Algorithms &alg);
+  ~ZstdDecompressor();
+  StreamStates Decompress2Sink(const void *buf, const int64_t size,
+                               cvmfs::Sink *sink);
+  void Reset();
+  static bool WillHandle(const zlib::Algorithms &alg);
+
+ private:
+  ZSTD_DCtx_s *dctx_;
+};
+
+
+class Lz4Decompressor: public Decompressor {
+ public:
+  explicit Lz4Decompressor(const Algorithms &alg);
+  ~Lz4Decompressor();
+  StreamStates Decompress2Sink(const void *buf, const int64_t size,
+                               cvmfs::Sink *sink);
+  void Reset();
+  static bool WillHandle(const zlib::Algorithms &alg);
+
+ private:
+  LZ4F_dctx_s *dctx_;
+};
+#endif  // CVMFS_ENABLE_ZSTD_LZ4
+
+
 Algorithms ParseCompressionAlgorithm(const std::string &algorithm_option);
+int ParseCompressionLevel(const std::string &algorithm_option);
 std::string AlgorithmName(const zlib::Algorithms alg);
+std::string MinClientVersion(const zlib::Algorithms alg);
 
 
 void CompressInit(z_stream *strm);
@@ -157,6 +320,8 @@ bool CompressPath2File(const std::string &src, FILE *fdest,
                        shash::Any *compressed_hash);
 bool DecompressFile2File(FILE *fsrc, FILE *fdest);
 bool DecompressPath2File(const std::string &src, FILE *fdest);
+bool DecompressPath2File(const Algorithms alg,
+                         const std::string &src, FILE *fdest);
 
 bool CompressMem2File(const unsigned char *buf, const size_t size,
                       FILE *fdest, shash::Any *compressed_hash);
@@ -166,6 +331,12 @@ bool CompressMem2Mem(const void *buf, const int64_t size,
                      void **out_buf, uint64_t *out_size);
 bool DecompressMem2Mem(const void *buf, const int64_t size,
                        void **out_buf, uint64_t *out_size);
+bool CompressMem2Mem(const Algorithms alg,
+                     const void *buf, const int64_t size,
+                     void **out_buf, uint64_t *out_size);
+bool DecompressMem2Mem(const Algorithms alg,
+                       const void *buf, const int64_t size,
+                       void **out_buf, uint64_t *out_size);
 
 }  // namespace zlib
 
@@ -0,0 +1,399 @@
+/**
+ * This file is part of the CernVM File System.
+ *
+ * Follows the structure of the BLAKE3 reference implementation.  The SIMD
+ * lanes use the GCC/clang vector extensions, so that the compiler picks the
+ * widest available instruction set (SSE2, AVX2, NEON, ...) for the target.
+ */
+
+#include "cvmfs_config.h"
+#include "crypto/blake3.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "util/exception.h"
+
+#ifdef CVMFS_NAMESPACE_GUARD
+namespace CVMFS_NAMESPACE_GUARD {
+#endif
+
+namespace shash {
+
+namespace {
+
+const uint32_t kIv[8] = {
+  0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+  0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+// The message word permutation applied to every round
+const unsigned kMsgSchedule[7][16] = {
+  {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+  {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+  {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+  {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+  {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+  {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+  {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+const uint32_t kFlagChunkStart = 1 << 0;
+const uint32_t kFlagChunkEnd   = 1 << 1;
+const uint32_t kFlagParent     = 1 << 2;
+const uint32_t kFlagRoot       = 1 << 3;
+
+typedef uint32_t VecU32 __attribute__((vector_size(4 * kBlake3Lanes)));
+
+
+inline uint32_t LoadLe32(const unsigned char *p) {
+  return static_cast<uint32_t>(p[0]) |
+         (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+
+/**
+ * Loads a possibly incomplete block, padded with zeros
+ */
+inline void LoadBlock(const unsigned char *block, unsigned block_len,
+                      uint32_t words[16])
+{
+  if (block_len == kBlake3BlockSize) {
+    for (unsigned i = 0; i < 16; ++i)
+      words[i] = LoadLe32(block + 4 * i);
+    return;
+  }
+  unsigned char padded[kBlake3BlockSize];
+  memset(padded, 0, kBlake3BlockSize);
+  if (block_len > 0)
+    memcpy(padded, block, block_len);
+  for (unsigned i = 0; i < 16; ++i)
+    words[i] = LoadLe32(padded + 4 * i);
+}
+
+
+void StoreDigest(const uint32_t cv[8], unsigned char *digest,
+                 unsigned digest_size)
+{
+  assert(digest_size <= 32);
+  for (unsigned i = 0; i < digest_size; ++i)
+    digest[i] = static_cast<unsigned char>(cv[i / 4] >> (8 * (i % 4)));
+}
+
+
+/**
+ * Works on scalars as well as on vectors of independent states
+ */
+template <typename T>
+inline void XorRotr(T *w, const T &v, unsigned c) {
+  *w ^= v;
+  *w = (*w >> c) | (*w << (32 - c));
+}
+
+template <typename T>
+inline void G(T *s, unsigned a, unsigned b, unsigned c, unsigned d,
+              const T &x, const T &y)
+{
+  s[a] = s[a] + s[b] + x;
+  XorRotr(&s[d], s[a], 16);
+  s[c] = s[c] + s[d];
+  XorRotr(&s[b], s[c], 12);
+  s[a] = s[a] + s[b] + y;
+  XorRotr(&s[d], s[a], 8);
+  s[c] = s[c] + s[d];
+  XorRotr(&s[b], s[c], 7);
+}
+
+template <typename T>
+inline void Rounds(T s[16], const T m[16]) {
+  for (unsigned r = 0; r < 7; ++r) {
+    const unsigned *sched = kMsgSchedule[r];
+    G(s, 0, 4, 8, 12, m[sched[0]], m[sched[1]]);
+    G(s, 1, 5, 9, 13, m[sched[2]], m[sched[3]]);
+    G(s, 2, 6, 10, 14, m[sched[4]], m[sched[5]]);
+    G(s, 3, 7, 11, 15, m[sched[6]], m[sched[7]]);
+    G(s, 0, 5, 10, 15, m[sched[8]], m[sched[9]]);
+    G(s, 1, 6, 11, 12, m[sched[10]], m[sched[11]]);
+    G(s, 2, 7, 8, 13, m[sched[12]], m[sched[13]]);
+    G(s, 3, 4, 9, 14, m[sched[14]], m[sched[15]]);
+  }
+}
+
+
+/**
+ * Returns the first 8 words of the compression output, which is the chaining
+ * value or, with the root flag, the beginning of the hash output.
+ */
+void Compress(const uint32_t cv[8], const uint32_t m[16], uint64_t counter,
+              uint32_t block_len, uint32_t flags, uint32_t out[8])
+{
+  uint32_t s[16] = {
+    cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+    kIv[0], kIv[1], kIv[2], kIv[3],
+    static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32),
+    block_len, flags
+  };
+  Rounds(s, m);
+  for (unsigned i = 0; i < 8; ++i)
+    out[i] = s[i] ^ s[i + 8];
+}
+
+
+void ParentCv(const uint32_t left[8], const uint32_t right[8],
+              uint32_t flags, uint32_t out[8])
+{
+  uint32_t m[16];
+  memcpy(m, left, 32);
+  memcpy(m + 8, right, 32);
+  Compress(kIv, m, 0, kBlake3BlockSize, kFlagParent | flags, out);
+}
+
+
+inline void Splat(uint32_t x, VecU32 *v) {
+  for (unsigned l = 0; l < kBlake3Lanes; ++l)
+    (*v)[l] = x;
+}
+
+
+/**
+ * Hashes up to kBlake3Lanes independent chunks of up to kBlake3ChunkSize
+ * bytes in lockstep.  Lanes with fewer blocks keep their chaining value once
+ * they are done.  The root flag is used for inputs that consist of a single
+ * chunk.
+ */
+void HashChunksLanes(unsigned n,
+                     const unsigned char * const *inputs,
+                     const unsigned *sizes,
+                     const uint64_t *counters,
+                     bool root,
+                     uint32_t cvs[][8])
+{
+  assert(n <= kBlake3Lanes);
+  unsigned nblocks[kBlake3Lanes];
+  unsigned max_blocks = 0;
+  for (unsigned l = 0; l < kBlake3Lanes; ++l) {
+    if (l < n) {
+      assert(sizes[l] <= kBlake3ChunkSize);
+      nblocks[l] = (sizes[l] == 0) ? 1 :
+        (sizes[l] + kBlake3BlockSize - 1) / kBlake3BlockSize;
+    } else {
+      nblocks[l] = 0;
+    }
+    if (nblocks[l] > max_blocks)
+      max_blocks = nblocks[l];
+  }
+
+  VecU32 cv[8];
+  VecU32 iv[4];
+  for (unsigned i = 0; i < 8; ++i)
+    Splat(kIv[i], &cv[i]);
+  for (unsigned i = 0; i < 4; ++i)
+    Splat(kIv[i], &iv[i]);
+  VecU32 counter_lo;
+  VecU32 counter_hi;
+  Splat(0, &counter_lo);
+  Splat(0, &counter_hi);
+  for (unsigned l = 0; l < n; ++l) {
+    counter_lo[l] = static_cast<uint32_t>(counters[l]);
+    counter_hi[l] = static_cast<uint32_t>(counters[l] >> 32);
+  }
+
+  uint32_t words[16][kBlake3Lanes];
+  uint32_t lane_words[16];
+  for (unsigned b = 0; b < max_blocks; ++b) {
+    VecU32 block_len;
+    VecU32 flags;
+    VecU32 active;
+    for (unsigned l = 0; l < kBlake3Lanes; ++l) {
+      if (b >= nblocks[l]) {
+        block_len[l] = flags[l] = active[l] = 0;
+        for (unsigned i = 0; i < 16; ++i)
+          words[i][l] = 0;
+        continue;
+      }
+      const unsigned offset = b * kBlake3BlockSize;
+      const unsigned len = (b == nblocks[l] - 1) ?
+        sizes[l] - offset : kBlake3BlockSize;
+      LoadBlock(inputs[l] + offset, len, lane_words);
+      for (unsigned i = 0; i < 16; ++i)
+        words[i][l] = lane_words[i];
+      block_len[l] = len;
+      flags[l] = (b == 0) ? kFlagChunkStart : 0;
+      if (b == nblocks[l] - 1)
+        flags[l] |= kFlagChunkEnd | (root ? kFlagRoot : 0);
+      active[l] = 0xFFFFFFFF;
+    }
+
+    VecU32 m[16];
+    memcpy(m, words, sizeof(m));
+    VecU32 s[16] = {
+      cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+      iv[0], iv[1], iv[2], iv[3],
+      counter_lo, counter_hi, block_len, flags
+    };
+    Rounds(s, m);
+    for (unsigned i = 0; i < 8; ++i)
+      cv[i] = ((s[i] ^ s[i + 8]) & active) | (cv[i] & ~active);
+  }
+
+  for (unsigned l = 0; l < n; ++l) {
+    for (unsigned i = 0; i < 8; ++i)
+      cvs[l][i] = cv[i][l];
+  }
+}
+
+
+/**
+ * Merges complete subtrees.  The number of trailing zero bits of the total
+ * number of chunks is the number of subtrees completed by the new chunk.
+ */
+void PushChunkCv(Blake3Context *ctx, const uint32_t cv[8],
+                 uint64_t total_chunks)
+{
+  uint32_t merged[8];
+  memcpy(merged, cv, 32);
+  while ((total_chunks & 1) == 0) {
+    ctx->cv_stack_len--;
+    ParentCv(ctx->cv_stack[ctx->cv_stack_len], merged, 0, merged);
+    total_chunks >>= 1;
+  }
+  if (ctx->cv_stack_len >= kBlake3MaxDepth)
+    PANIC(kLogStderr, "BLAKE3 input too large");
+  memcpy(ctx->cv_stack[ctx->cv_stack_len], merged, 32);
+  ctx->cv_stack_len++;
+}
+
+}  // anonymous namespace
+
+
+void Blake3Init(Blake3Context *ctx) {
+  memcpy(ctx->chunk_cv, kIv, 32);
+  ctx->chunk_counter = 0;
+  ctx->block_len = 0;
+  ctx->blocks_compressed = 0;
+  ctx->cv_stack_len = 0;
+}
+
+
+void Blake3Update(Blake3Context *ctx,
+                  const unsigned char *buffer,
+                  unsigned buffer_length)
+{
+  uint32_t m[16];
+  while (buffer_length > 0) {
+    unsigned chunk_len =
+      ctx->blocks_compressed * kBlake3BlockSize + ctx->block_len;
+
+    // The current chunk is complete and more input follows, so it is not the
+    // root
+    if (chunk_len == kBlake3ChunkSize) {
+      LoadBlock(ctx->block, kBlake3BlockSize, m);
+      uint32_t cv[8];
+      Compress(ctx->chunk_cv, m, ctx->chunk_counter, kBlake3BlockSize,
+               kFlagChunkEnd, cv);
+      ctx->chunk_counter++;
+      PushChunkCv(ctx, cv, ctx->chunk_counter);
+      memcpy(ctx->chunk_cv, kIv, 32);
+      ctx->block_len = ctx->blocks_compressed = 0;
+      chunk_len = 0;
+    }
+
+    // Whole chunks in the input are hashed in parallel.  The last chunk is
+    // always kept back because it could be the root.
+    if ((chunk_len == 0) && (buffer_length > kBlake3ChunkSize)) {
+      unsigned nchunks = (buffer_length - 1) / kBlake3ChunkSize;
+      if (nchunks > kBlake3Lanes)
+        nchunks = kBlake3Lanes;
+      const unsigned char *inputs[kBlake3Lanes];
+      unsigned sizes[kBlake3Lanes];
+      uint64_t counters[kBlake3Lanes];
+      for (unsigned i = 0; i < nchunks; ++i) {
+        inputs[i] = buffer + i * kBlake3ChunkSize;
+        sizes[i] = kBlake3ChunkSize;
+        counters[i] = ctx->chunk_counter + i;
+      }
+      uint32_t cvs[kBlake3Lanes][8];
+      HashChunksLanes(nchunks, inputs, sizes, counters, false, cvs);
+      for (unsigned i = 0; i < nchunks; ++i) {
+        ctx->chunk_counter++;
+        PushChunkCv(ctx, cvs[i], ctx->chunk_counter);
+      }
+      buffer += nchunks * kBlake3ChunkSize;
+      buffer_length -= nchunks * kBlake3ChunkSize;
+      continue;
+    }
+
+    if (ctx->block_len == kBlake3BlockSize) {
+      LoadBlock(ctx->block, kBlake3BlockSize, m);
+      Compress(ctx->chunk_cv, m, ctx->chunk_counter, kBlake3BlockSize,
+               (ctx->blocks_compressed == 0) ? kFlagChunkStart : 0,
+               ctx->chunk_cv);
+      ctx->blocks_compressed++;
+      ctx->block_len = 0;
+    }
+    unsigned nbytes = kBlake3BlockSize - ctx->block_len;
+    if (nbytes > buffer_length)
+      nbytes = buffer_length;
+    memcpy(ctx->block + ctx->block_len, buffer, nbytes);
+    ctx->block_len += nbytes;
+    buffer += nbytes;
+    buffer_length -= nbytes;
+  }
+}
+
+
+void Blake3Final(const Blake3Context *ctx,
+                 unsigned char *digest,
+                 unsigned digest_size)
+{
+  // The pending output is either the last chunk or a parent node
+  uint32_t input_cv[8];
+  uint32_t m[16];
+  uint64_t counter = ctx->chunk_counter;
+  uint32_t block_len = ctx->block_len;
+  uint32_t flags = kFlagChunkEnd |
+    ((ctx->blocks_compressed == 0) ? kFlagChunkStart : 0);
+  memcpy(input_cv, ctx->chunk_cv, 32);
+  LoadBlock(ctx->block, ctx->block_len, m);
+
+  for (unsigned i = ctx->cv_stack_len; i > 0; --i) {
+    uint32_t right[8];
+    Compress(input_cv, m, counter, block_len, flags, right);
+    memcpy(m, ctx->cv_stack[i - 1], 32);
+    memcpy(m + 8, right, 32);
+    memcpy(input_cv, kIv, 32);
+    counter = 0;
+    block_len = kBlake3BlockSize;
+    flags = kFlagParent;
+  }
+
+  uint32_t out[8];
+  Compress(input_cv, m, counter, block_len, flags | kFlagRoot, out);
+  StoreDigest(out, digest, digest_size);
+}
+
+
+void Blake3HashSmall(unsigned n,
+                     const unsigned char * const *buffers,
+                     const unsigned *buffer_sizes,
+                     unsigned char *digests,
+                     unsigned digest_size)
+{
+  const uint64_t counters[kBlake3Lanes] = {0};
+  uint32_t cvs[kBlake3Lanes][8];
+  for (unsigned i = 0; i < n; i += kBlake3Lanes) {
+    const unsigned nlanes = (n - i < kBlake3Lanes) ? n - i : kBlake3Lanes;
+    HashChunksLanes(nlanes, buffers + i, buffer_sizes + i, counters, true,
+                    cvs);
+    for (unsigned l = 0; l < nlanes; ++l)
+      StoreDigest(cvs[l], digests + (i + l) * digest_size, digest_size);
+  }
+}
+
+}  // namespace shash
+
+#ifdef CVMFS_NAMESPACE_GUARD
+}  // namespace CVMFS_NAMESPACE_GUARD
+#endif
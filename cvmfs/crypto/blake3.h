@@ -0,0 +1,71 @@
+/**
+ * This file is part of the CernVM File System.
+ *
+ * A portable implementation of the BLAKE3 hash function (unkeyed mode).
+ * Used by shash for the kBlake3 algorithm.  Independent inputs of up to one
+ * BLAKE3 chunk (1kB) can be hashed together in SIMD lanes, which is much
+ * faster than hashing them one after another.  Large inputs use the same
+ * lanes for up to kBlake3Lanes chunks at a time.
+ */
+
+#ifndef CVMFS_CRYPTO_BLAKE3_H_
+#define CVMFS_CRYPTO_BLAKE3_H_
+
+#include <stdint.h>
+
+#ifdef CVMFS_NAMESPACE_GUARD
+namespace CVMFS_NAMESPACE_GUARD {
+#endif
+
+namespace shash {
+
+const unsigned kBlake3BlockSize = 64;
+const unsigned kBlake3ChunkSize = 1024;
+const unsigned kBlake3Lanes = 8;
+/**
+ * Supports inputs of up to 2^kBlake3MaxDepth chunks, i.e. 4TB
+ */
+const unsigned kBlake3MaxDepth = 32;
+
+/**
+ * Streaming state.  The stack holds the chaining values of complete subtrees
+ * that still wait for their right sibling.
+ */
+struct Blake3Context {
+  uint32_t cv_stack[kBlake3MaxDepth][8];
+  uint32_t chunk_cv[8];
+  uint64_t chunk_counter;
+  unsigned char block[kBlake3BlockSize];
+  uint8_t block_len;
+  uint8_t blocks_compressed;
+  uint8_t cv_stack_len;
+};
+
+void Blake3Init(Blake3Context *ctx);
+void Blake3Update(Blake3Context *ctx,
+                  const unsigned char *buffer,
+                  unsigned buffer_length);
+/**
+ * Writes the first digest_size (<= 32) bytes of the output
+ */
+void Blake3Final(const Blake3Context *ctx,
+                 unsigned char *digest,
+                 unsigned digest_size);
+
+/**
+ * Hashes n independent buffers of at most kBlake3ChunkSize bytes each.  The
+ * digests are written consecutively, digest_size bytes per buffer.
+ */
+void Blake3HashSmall(unsigned n,
+                     const unsigned char * const *buffers,
+                     const unsigned *buffer_sizes,
+                     unsigned char *digests,
+                     unsigned digest_size);
+
+}  // namespace shash
+
+#ifdef CVMFS_NAMESPACE_GUARD
+}  // namespace CVMFS_NAMESPACE_GUARD
+#endif
+
+#endif  // CVMFS_CRYPTO_BLAKE3_H_
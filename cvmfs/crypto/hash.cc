@@ -17,6 +17,7 @@
 #include <cstdio>
 #include <cstring>
 
+#include "crypto/blake3.h"
 #include "crypto/openssl_version.h"
 #include "util/exception.h"
 #include "KeccakHash.h"
@@ -31,7 +32,7 @@ namespace CVMFS_NAMESPACE_GUARD {
 namespace shash {
 
 const char *kAlgorithmIds[] =
-  {"", "", "-rmd160", "-shake128", ""};
+  {"", "", "-rmd160", "-shake128", "-blake3", ""};
 
 
 bool HexPtr::IsValid() const {
@@ -76,10 +77,37 @@ Algorithms ParseHashAlgorithm(const string &algorithm_option) {
     return kRmd160;
   if (algorithm_option == "shake128")
     return kShake128;
+  if (algorithm_option == "blake3")
+    return kBlake3;
   return kAny;
 }
 
 
+/**
+ * Clients older than the returned version cannot verify content hashed with
+ * the algorithm.  Empty if all clients support the algorithm.
+ */
+std::string MinClientVersion(const Algorithms algorithm) {
+  switch (algorithm) {
+    case kBlake3:
+      return "2.11.0";
+    default:
+      return "";
+  }
+}
+
+
+/**
+ * Algorithms with hex representations of the same length are told apart by
+ * their identifier, e.g. -rmd160 and -blake3.
+ */
+static bool HasAlgorithmId(const HexPtr hex, const Algorithms algorithm) {
+  return hex.str->compare(2*kDigestSizes[algorithm],
+                          kAlgorithmIdSizes[algorithm],
+                          kAlgorithmIds[algorithm]) == 0;
+}
+
+
 Any MkFromHexPtr(const HexPtr hex, const char suffix) {
   Any result;
 
@@ -88,11 +116,21 @@ Any MkFromHexPtr(const HexPtr hex, const char suffix) {
     result = Any(kMd5, hex);
   if (length == 2*kDigestSizes[kSha1])
     result = Any(kSha1, hex);
-  // TODO(jblomer) compare -rmd160, -shake128
-  if ((length == 2*kDigestSizes[kRmd160] + kAlgorithmIdSizes[kRmd160]))
+  if ((length == 2*kDigestSizes[kRmd160] + kAlgorithmIdSizes[kRmd160]) &&
+      HasAlgorithmId(hex, kRmd160))
+  {
     result = Any(kRmd160, hex);
-  if ((length == 2*kDigestSizes[kShake128] + kAlgorithmIdSizes[kShake128]))
+  }
+  if ((length == 2*kDigestSizes[kShake128] + kAlgorithmIdSizes[kShake128]) &&
+      HasAlgorithmId(hex, kShake128))
+  {
     result = Any(kShake128, hex);
+  }
+  if ((length == 2*kDigestSizes[kBlake3] + kAlgorithmIdSizes[kBlake3]) &&
+      HasAlgorithmId(hex, kBlake3))
+  {
+    result = Any(kBlake3, hex);
+  }
 
   result.suffix = suffix;
   return result;
@@ -119,8 +157,9 @@ Any MkFromSuffixedHexPtr(const HexPtr hex) {
       *(hex.str->rbegin()) : kSuffixNone;
     result = Any(kSha1, hex, suffix);
   }
-  if ((length == 2*kDigestSizes[kRmd160] + kAlgorithmIdSizes[kRmd160]) ||
-      (length == 2*kDigestSizes[kRmd160] + kAlgorithmIdSizes[kRmd160] + 1))
+  if (((length == 2*kDigestSizes[kRmd160] + kAlgorithmIdSizes[kRmd160]) ||
+       (length == 2*kDigestSizes[kRmd160] + kAlgorithmIdSizes[kRmd160] + 1)) &&
+      HasAlgorithmId(hex, kRmd160))
   {
     Suffix suffix =
       (length == 2*kDigestSizes[kRmd160] + kAlgorithmIdSizes[kRmd160] + 1)
@@ -128,8 +167,10 @@ Any MkFromSuffixedHexPtr(const HexPtr hex) {
         : kSuffixNone;
     result = Any(kRmd160, hex, suffix);
   }
-  if ((length == 2*kDigestSizes[kShake128] + kAlgorithmIdSizes[kShake128]) ||
-      (length == 2*kDigestSizes[kShake128] + kAlgorithmIdSizes[kShake128] + 1))
+  if (((length == 2*kDigestSizes[kShake128] + kAlgorithmIdSizes[kShake128]) ||
+       (length ==
+        2*kDigestSizes[kShake128] + kAlgorithmIdSizes[kShake128] + 1)) &&
+      HasAlgorithmId(hex, kShake128))
   {
     Suffix suffix =
       (length == 2*kDigestSizes[kShake128] + kAlgorithmIdSizes[kShake128] + 1)
@@ -137,6 +178,16 @@ Any MkFromSuffixedHexPtr(const HexPtr hex) {
         : kSuffixNone;
     result = Any(kShake128, hex, suffix);
   }
+  if (((length == 2*kDigestSizes[kBlake3] + kAlgorithmIdSizes[kBlake3]) ||
+       (length == 2*kDigestSizes[kBlake3] + kAlgorithmIdSizes[kBlake3] + 1)) &&
+      HasAlgorithmId(hex, kBlake3))
+  {
+    Suffix suffix =
+      (length == 2*kDigestSizes[kBlake3] + kAlgorithmIdSizes[kBlake3] + 1)
+        ? *(hex.str->rbegin())
+        : kSuffixNone;
+    result = Any(kBlake3, hex, suffix);
+  }
 
   return result;
 }
@@ -155,6 +206,8 @@ unsigned GetContextSize(const Algorithms algorithm) {
       return sizeof(RIPEMD160_CTX);
     case kShake128:
       return sizeof(Keccak_HashInstance);
+    case kBlake3:
+      return sizeof(Blake3Context);
     default:
       PANIC(kLogDebug | kLogSyslogErr,
             "tried to generate hash context for unspecified hash. Aborting...");
@@ -182,6 +235,10 @@ void Init(ContextPtr context) {
         reinterpret_cast<Keccak_HashInstance *>(context.buffer));
       assert(keccak_result == SUCCESS);
       break;
+    case kBlake3:
+      assert(context.size == sizeof(Blake3Context));
+      Blake3Init(reinterpret_cast<Blake3Context *>(context.buffer));
+      break;
     default:
       PANIC(NULL);  // Undefined hash
   }
@@ -213,6 +270,11 @@ void Update(const unsigned char *buffer, const unsigned buffer_length,
                         context.buffer), buffer, buffer_length * 8);
       assert(keccak_result == SUCCESS);
       break;
+    case kBlake3:
+      assert(context.size == sizeof(Blake3Context));
+      Blake3Update(reinterpret_cast<Blake3Context *>(context.buffer),
+                   buffer, buffer_length);
+      break;
     default:
       PANIC(NULL);  // Undefined hash
   }
@@ -245,6 +307,11 @@ void Final(ContextPtr context, Any *any_digest) {
         Keccak_HashSqueeze(reinterpret_cast<Keccak_HashInstance *>(
           context.buffer), any_digest->digest, kDigestSizes[kShake128] * 8);
       break;
+    case kBlake3:
+      assert(context.size == sizeof(Blake3Context));
+      Blake3Final(reinterpret_cast<Blake3Context *>(context.buffer),
+                  any_digest->digest, kDigestSizes[kBlake3]);
+      break;
     default:
       PANIC(NULL);  // Undefined hash
   }
@@ -271,6 +338,64 @@ void HashString(const std::string &content, Any *any_digest) {
 }
 
 
+static void HashLanesBlake3(
+  const unsigned nlanes,
+  const unsigned char * const *lane_buffers,
+  const unsigned *lane_sizes,
+  Any * const *lane_digests)
+{
+  unsigned char lane_output[kBlake3Lanes * kDigestSizes[kBlake3]];
+  Blake3HashSmall(nlanes, lane_buffers, lane_sizes, lane_output,
+                  kDigestSizes[kBlake3]);
+  for (unsigned l = 0; l < nlanes; ++l) {
+    memcpy(lane_digests[l]->digest, lane_output + l * kDigestSizes[kBlake3],
+           kDigestSizes[kBlake3]);
+  }
+}
+
+
+void HashMemMulti(
+  const unsigned n,
+  const unsigned char * const *buffers,
+  const unsigned *buffer_sizes,
+  Any *digests)
+{
+  if (n == 0)
+    return;
+  const Algorithms algorithm = digests[0].algorithm;
+  if (algorithm != kBlake3) {
+    for (unsigned i = 0; i < n; ++i) {
+      assert(digests[i].algorithm == algorithm);
+      HashMem(buffers[i], buffer_sizes[i], &digests[i]);
+    }
+    return;
+  }
+
+  // Small buffers are collected until all lanes are used
+  const unsigned char *lane_buffers[kBlake3Lanes];
+  unsigned lane_sizes[kBlake3Lanes];
+  Any *lane_digests[kBlake3Lanes];
+  unsigned nlanes = 0;
+  for (unsigned i = 0; i < n; ++i) {
+    assert(digests[i].algorithm == kBlake3);
+    if (buffer_sizes[i] > kBlake3ChunkSize) {
+      HashMem(buffers[i], buffer_sizes[i], &digests[i]);
+      continue;
+    }
+    lane_buffers[nlanes] = buffers[i];
+    lane_sizes[nlanes] = buffer_sizes[i];
+    lane_digests[nlanes] = &digests[i];
+    nlanes++;
+    if (nlanes == kBlake3Lanes) {
+      HashLanesBlake3(nlanes, lane_buffers, lane_sizes, lane_digests);
+      nlanes = 0;
+    }
+  }
+  if (nlanes > 0)
+    HashLanesBlake3(nlanes, lane_buffers, lane_sizes, lane_digests);
+}
+
+
 void Hmac(
   const string &key,
   const unsigned char *buffer,
@@ -21,6 +21,7 @@
 #include <cstring>
 #include <string>
 
+#include "crypto/blake3.h"
 #include "util/export.h"
 #include "util/logging.h"
 #include "util/prng.h"
@@ -43,6 +44,7 @@ enum Algorithms {
   kSha1,
   kRmd160,
   kShake128,  // with 160 output bits
+  kBlake3,  // with 160 output bits
   kAny,
 };
 
@@ -67,14 +69,15 @@ const char kSuffixMetainfo     = 'M';
  * PosixQuotaManager::LruCommand changes, too!
  */
 const unsigned kDigestSizes[] =
-  {16,  20,   20,     20,       20};
-// Md5  Sha1  Rmd160  Shake128  Any
+  {16,  20,   20,     20,       20,     20};
+// Md5  Sha1  Rmd160  Shake128  Blake3  Any
 const unsigned kMaxDigestSize = 20;
 
 /**
- * The maximum of GetContextSize()
+ * The maximum of GetContextSize().  BLAKE3 contexts are about 1.1kB, the
+ * others fit in 256 bytes, so buffers should be sized by GetContextSize().
  */
-const unsigned kMaxContextSize = 256;
+const unsigned kMaxContextSize = sizeof(Blake3Context);
 
 /**
  * Hex representations of hashes with the same length need a suffix
@@ -84,8 +87,8 @@ const unsigned kMaxContextSize = 256;
  */
 CVMFS_EXPORT extern const char *kAlgorithmIds[];
 const unsigned kAlgorithmIdSizes[] =
-  {0,   0,    7,       9,         0};
-// Md5  Sha1  -rmd160  -shake128  Any
+  {0,   0,    7,       9,         7,       0};
+// Md5  Sha1  -rmd160  -shake128  -blake3  Any
 const unsigned kMaxAlgorithmIdentifierSize = 9;
 
 /**
@@ -93,8 +96,8 @@ const unsigned kMaxAlgorithmIdentifierSize = 9;
  * Is an HMAC for SHAKE well-defined?
  */
 const unsigned kBlockSizes[] =
-  {64,  64,   64,     168};
-// Md5  Sha1  Rmd160  Shake128
+  {64,  64,   64,     168,      64};
+// Md5  Sha1  Rmd160  Shake128  Blake3
 
 /**
  * Distinguishes between interpreting a string as hex hash and hashing over
@@ -458,6 +461,7 @@ struct CVMFS_EXPORT Md5 : public Digest<16, kMd5> {
 struct CVMFS_EXPORT Sha1 : public Digest<20, kSha1> { };
 struct CVMFS_EXPORT Rmd160 : public Digest<20, kRmd160> { };
 struct CVMFS_EXPORT Shake128 : public Digest<20, kShake128> { };
+struct CVMFS_EXPORT Blake3 : public Digest<20, kBlake3> { };
 
 /**
  * Any as such must not be used except for digest storage.
@@ -520,6 +524,16 @@ CVMFS_EXPORT void HashMem(const unsigned char *buffer,
                           const unsigned buffer_size,
                           Any *any_digest);
 CVMFS_EXPORT void HashString(const std::string &content, Any *any_digest);
+/**
+ * Hashes n independent buffers into digests, which all need to be set to the
+ * same algorithm.  For BLAKE3, buffers of up to kBlake3ChunkSize bytes are
+ * hashed together in SIMD lanes.  Other algorithms hash one buffer after the
+ * other.
+ */
+CVMFS_EXPORT void HashMemMulti(const unsigned n,
+                               const unsigned char * const *buffers,
+                               const unsigned *buffer_sizes,
+                               Any *digests);
 CVMFS_EXPORT void Hmac(const std::string &key,
                        const unsigned char *buffer,
                        const unsigned buffer_size,
@@ -550,6 +564,7 @@ CVMFS_EXPORT std::string Sha256String(const std::string &content);
 
 CVMFS_EXPORT
 Algorithms ParseHashAlgorithm(const std::string &algorithm_option);
+CVMFS_EXPORT std::string MinClientVersion(const Algorithms algorithm);
 CVMFS_EXPORT
 Any MkFromHexPtr(const HexPtr hex, const Suffix suffix = kSuffixNone);
 CVMFS_EXPORT Any MkFromSuffixedHexPtr(const HexPtr hex);
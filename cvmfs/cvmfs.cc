@@ -82,10 +82,12 @@
 #include "file_chunk.h"
 #include "fuse_inode_gen.h"
 #include "fuse_remount.h"
+#include "fuse_splice.h"
 #include "globals.h"
 #include "glue_buffer.h"
 #include "history_sqlite.h"
 #include "interrupt.h"
+#include "listing_cache.h"
 #include "loader.h"
 #include "lru_md.h"
 #include "magic_xattr.h"
@@ -98,6 +100,7 @@
 #include "options.h"
 #include "quota_listener.h"
 #include "quota_posix.h"
+#include "readahead.h"
 #include "shortstring.h"
 #include "sqlitemem.h"
 #include "sqlitevfs.h"
@@ -158,6 +161,18 @@ DirectoryHandles *directory_handles_ = NULL;
 pthread_mutex_t lock_directory_handles_ = PTHREAD_MUTEX_INITIALIZER;
 uint64_t next_directory_handle_ = 0;
 
+/**
+ * Maps file handles of files opened in fuse passthrough mode to the kernel's
+ * backing id.  Backing ids of files opened before a reload are not known to
+ * the new fuse module; they are released by the kernel on unmount.
+ */
+typedef google::dense_hash_map<uint64_t, int, hash_murmur<uint64_t> >
+        PassthroughHandles;
+PassthroughHandles *passthrough_handles_ = NULL;
+pthread_mutex_t lock_passthrough_handles_ = PTHREAD_MUTEX_INITIALIZER;
+
+SplicePipes *splice_pipes_ = NULL;
+
 unsigned max_open_files_; /**< maximum allowed number of open files */
 /**
  * Number of reserved file descriptors for internal use
@@ -498,12 +513,16 @@ static void cvmfs_lookup(fuse_req_t req, fuse_ino_t parent, const char *name) {
   LogCvmfs(kLogCvmfs, kLogDebug,
            "cvmfs_lookup in parent inode: %" PRIu64 " for name: %s",
            uint64_t(parent), name);
+  TraceGuard trace_guard(mount_point_->tracer(), Tracer::kEventLookup, parent);
 
   PathString path;
   PathString parent_path;
   uint64_t live_inode = 0;
   catalog::DirectoryEntry dirent;
   struct fuse_entry_param result;
+  lru::NegativeLookupCache *negative_lookup_cache =
+    mount_point_->negative_lookup_cache();
+  lru::ParentNameKey negative_key;
 
   memset(&result, 0, sizeof(result));
   double timeout = GetKcacheTimeout();
@@ -535,6 +554,13 @@ static void cvmfs_lookup(fuse_req_t req, fuse_ino_t parent, const char *name) {
     assert(false);
   }
 
+  // Repeated lookups of non-existing names, e.g. from search paths
+  if (negative_lookup_cache != NULL) {
+    negative_key = lru::ParentNameKey(parent, name, strlen(name));
+    if (negative_lookup_cache->Contains(negative_key))
+      goto lookup_reply_negative;
+  }
+
   if (!GetPathForInode(parent, &parent_path)) {
     LogCvmfs(kLogCvmfs, kLogDebug, "no path for parent inode found");
     goto lookup_reply_negative;
@@ -546,10 +572,13 @@ static void cvmfs_lookup(fuse_req_t req, fuse_ino_t parent, const char *name) {
   mount_point_->tracer()->Trace(Tracer::kEventLookup, path, "lookup()");
   live_inode = GetDirentForPath(path, &dirent);
   if (live_inode == 0) {
-    if (dirent.GetSpecial() == catalog::kDirentNegative)
+    if (dirent.GetSpecial() == catalog::kDirentNegative) {
+      if (negative_lookup_cache != NULL)
+        negative_lookup_cache->Add(negative_key);
       goto lookup_reply_negative;
-    else
+    } else {
       goto lookup_reply_error;
+    }
   }
 
  lookup_reply_positive:
@@ -583,6 +612,7 @@ static void cvmfs_lookup(fuse_req_t req, fuse_ino_t parent, const char *name) {
   fuse_remounter_->fence()->Leave();
   result.ino = dirent.inode();
   result.attr = dirent.GetStatStructure();
+  trace_guard.set_inode(dirent.inode());
   fuse_reply_entry(req, &result);
   return;
 
@@ -592,6 +622,7 @@ static void cvmfs_lookup(fuse_req_t req, fuse_ino_t parent, const char *name) {
   fuse_remounter_->fence()->Leave();
   perf::Inc(file_system_->n_fs_lookup_negative());
   result.ino = 0;
+  trace_guard.Errno(ENOENT);
   fuse_reply_entry(req, &result);
   return;
 
@@ -602,7 +633,7 @@ static void cvmfs_lookup(fuse_req_t req, fuse_ino_t parent, const char *name) {
   perf::Inc(file_system_->n_eio_total());
   perf::Inc(file_system_->n_eio_01());
 
-  fuse_reply_err(req, EIO);
+  fuse_reply_err(req, trace_guard.Errno(EIO));
 }
 
 
@@ -696,12 +727,13 @@ static void cvmfs_forget_multi(
  * ENOENT negative reply.  We do not need to store the reply in the negative
  * cache tracker because ReplyNegative is called on inode queries.  Inodes,
  * however, change anyway when a new catalog is applied.
+ * The error code is recorded in the trace guard.
  */
 static void ReplyNegative(const catalog::DirectoryEntry &dirent,
-                          fuse_req_t req)
+                          fuse_req_t req, TraceGuard *trace_guard)
 {
   if (dirent.GetSpecial() == catalog::kDirentNegative) {
-    fuse_reply_err(req, ENOENT);
+    fuse_reply_err(req, trace_guard->Errno(ENOENT));
   } else {
     const char * name = dirent.name().c_str();
     const char * link = dirent.symlink().c_str();
@@ -713,7 +745,7 @@ static void ReplyNegative(const catalog::DirectoryEntry &dirent,
 
     perf::Inc(file_system_->n_eio_total());
     perf::Inc(file_system_->n_eio_02());
-    fuse_reply_err(req, EIO);
+    fuse_reply_err(req, trace_guard->Errno(EIO));
   }
 }
 
@@ -734,12 +766,13 @@ static void cvmfs_getattr(fuse_req_t req, fuse_ino_t ino,
 
   fuse_remounter_->fence()->Enter();
   ino = mount_point_->catalog_mgr()->MangleInode(ino);
+  TraceGuard trace_guard(mount_point_->tracer(), Tracer::kEventGetAttr, ino);
   LogCvmfs(kLogCvmfs, kLogDebug, "cvmfs_getattr (stat) for inode: %" PRIu64,
            uint64_t(ino));
 
   if (!CheckVoms(*fuse_ctx)) {
     fuse_remounter_->fence()->Leave();
-    fuse_reply_err(req, EACCES);
+    fuse_reply_err(req, trace_guard.Errno(EACCES));
     return;
   }
   catalog::DirectoryEntry dirent;
@@ -777,7 +810,7 @@ static void cvmfs_getattr(fuse_req_t req, fuse_ino_t ino,
   fuse_remounter_->fence()->Leave();
 
   if (!found) {
-    ReplyNegative(dirent, req);
+    ReplyNegative(dirent, req, &trace_guard);
     return;
   }
 
@@ -800,6 +833,7 @@ static void cvmfs_readlink(fuse_req_t req, fuse_ino_t ino) {
 
   fuse_remounter_->fence()->Enter();
   ino = mount_point_->catalog_mgr()->MangleInode(ino);
+  TraceGuard trace_guard(mount_point_->tracer(), Tracer::kEventReadlink, ino);
   LogCvmfs(kLogCvmfs, kLogDebug, "cvmfs_readlink on inode: %" PRIu64,
            uint64_t(ino));
 
@@ -809,12 +843,12 @@ static void cvmfs_readlink(fuse_req_t req, fuse_ino_t ino) {
   fuse_remounter_->fence()->Leave();
 
   if (!found) {
-    ReplyNegative(dirent, req);
+    ReplyNegative(dirent, req, &trace_guard);
     return;
   }
 
   if (!dirent.IsLink()) {
-    fuse_reply_err(req, EINVAL);
+    fuse_reply_err(req, trace_guard.Errno(EINVAL));
     return;
   }
 
@@ -846,6 +880,65 @@ static void AddToDirListing(const fuse_req_t req,
 }
 
 
+/**
+ * Builds the fuse listing of the directory d at path from the catalog.  Sets
+ * is_complete to false if entries had to be skipped, so that the listing is
+ * not cached.  Returns false if the directory cannot be listed.
+ */
+static bool BuildDirListing(const fuse_req_t req,
+                            const PathString &path,
+                            const catalog::DirectoryEntry &d,
+                            BigVector<char> *fuse_listing,
+                            bool *is_complete)
+{
+  catalog::ClientCatalogManager *catalog_mgr = mount_point_->catalog_mgr();
+  *is_complete = true;
+
+  // Add current directory link
+  struct stat info;
+  info = d.GetStatStructure();
+  AddToDirListing(req, ".", &info, fuse_listing);
+
+  // Add parent directory link
+  catalog::DirectoryEntry p;
+  if (d.inode() != catalog_mgr->GetRootInode() &&
+      (GetDirentForPath(GetParentPath(path), &p) > 0))
+  {
+    info = p.GetStatStructure();
+    AddToDirListing(req, "..", &info, fuse_listing);
+  }
+
+  // Add all names
+  catalog::StatEntryList listing_from_catalog;
+  bool retval = catalog_mgr->ListingStat(path, &listing_from_catalog);
+  if (!retval)
+    return false;
+
+  for (unsigned i = 0; i < listing_from_catalog.size(); ++i) {
+    // Fix inodes
+    PathString entry_path;
+    entry_path.Assign(path);
+    entry_path.Append("/", 1);
+    entry_path.Append(listing_from_catalog.AtPtr(i)->name.GetChars(),
+                      listing_from_catalog.AtPtr(i)->name.GetLength());
+
+    catalog::DirectoryEntry entry_dirent;
+    if (!GetDirentForPath(entry_path, &entry_dirent)) {
+      LogCvmfs(kLogCvmfs, kLogDebug, "listing entry %s vanished, skipping",
+               entry_path.c_str());
+      *is_complete = false;
+      continue;
+    }
+
+    struct stat fixed_info = listing_from_catalog.AtPtr(i)->info;
+    fixed_info.st_ino = entry_dirent.inode();
+    AddToDirListing(req, listing_from_catalog.AtPtr(i)->name.c_str(),
+                    &fixed_info, fuse_listing);
+  }
+  return true;
+}
+
+
 /**
  * Open a directory for listing.
  */
@@ -862,11 +955,12 @@ static void cvmfs_opendir(fuse_req_t req, fuse_ino_t ino,
   fuse_remounter_->fence()->Enter();
   catalog::ClientCatalogManager *catalog_mgr = mount_point_->catalog_mgr();
   ino = catalog_mgr->MangleInode(ino);
+  TraceGuard trace_guard(mount_point_->tracer(), Tracer::kEventOpenDir, ino);
   LogCvmfs(kLogCvmfs, kLogDebug, "cvmfs_opendir on inode: %" PRIu64,
            uint64_t(ino));
   if (!CheckVoms(*fuse_ctx)) {
     fuse_remounter_->fence()->Leave();
-    fuse_reply_err(req, EACCES);
+    fuse_reply_err(req, trace_guard.Errno(EACCES));
     return;
   }
 
@@ -876,47 +970,37 @@ static void cvmfs_opendir(fuse_req_t req, fuse_ino_t ino,
   bool found = GetPathForInode(ino, &path);
   if (!found) {
     fuse_remounter_->fence()->Leave();
-    fuse_reply_err(req, ENOENT);
+    fuse_reply_err(req, trace_guard.Errno(ENOENT));
     return;
   }
   found = GetDirentForInode(ino, &d);
 
   if (!found) {
     fuse_remounter_->fence()->Leave();
-    ReplyNegative(d, req);
+    ReplyNegative(d, req, &trace_guard);
     return;
   }
   if (!d.IsDirectory()) {
     fuse_remounter_->fence()->Leave();
-    fuse_reply_err(req, ENOTDIR);
+    fuse_reply_err(req, trace_guard.Errno(ENOTDIR));
     return;
   }
 
   LogCvmfs(kLogCvmfs, kLogDebug, "cvmfs_opendir on inode: %" PRIu64 ", path %s",
            uint64_t(ino), path.c_str());
 
-  // Build listing
+  // Build listing, unless a listing of this directory, catalog revision, and
+  // set of attached catalogs is cached
   BigVector<char> fuse_listing(512);
-
-  // Add current directory link
-  struct stat info;
-  info = d.GetStatStructure();
-  AddToDirListing(req, ".", &info, &fuse_listing);
-
-  // Add parent directory link
-  catalog::DirectoryEntry p;
-  if (d.inode() != catalog_mgr->GetRootInode() &&
-      (GetDirentForPath(GetParentPath(path), &p) > 0))
+  cvmfs::DirectoryListingCache *listing_cache = mount_point_->listing_cache();
+  const uint64_t revision = catalog_mgr->GetRevision();
+  const uint64_t incarnation = catalog_mgr->GetIncarnation();
+  bool is_cached = (listing_cache != NULL) &&
+    listing_cache->Lookup(ino, revision, incarnation, &fuse_listing);
+  bool is_complete = false;
+  if (!is_cached &&
+      !BuildDirListing(req, path, d, &fuse_listing, &is_complete))
   {
-    info = p.GetStatStructure();
-    AddToDirListing(req, "..", &info, &fuse_listing);
-  }
-
-  // Add all names
-  catalog::StatEntryList listing_from_catalog;
-  bool retval = catalog_mgr->ListingStat(path, &listing_from_catalog);
-
-  if (!retval) {
     fuse_remounter_->fence()->Leave();
     fuse_listing.Clear();  // Buffer is shared, empty manually
 
@@ -924,29 +1008,9 @@ static void cvmfs_opendir(fuse_req_t req, fuse_ino_t ino,
          "EIO (03) on %s", path.c_str());
     perf::Inc(file_system_->n_eio_total());
     perf::Inc(file_system_->n_eio_03());
-    fuse_reply_err(req, EIO);
+    fuse_reply_err(req, trace_guard.Errno(EIO));
     return;
   }
-  for (unsigned i = 0; i < listing_from_catalog.size(); ++i) {
-    // Fix inodes
-    PathString entry_path;
-    entry_path.Assign(path);
-    entry_path.Append("/", 1);
-    entry_path.Append(listing_from_catalog.AtPtr(i)->name.GetChars(),
-                      listing_from_catalog.AtPtr(i)->name.GetLength());
-
-    catalog::DirectoryEntry entry_dirent;
-    if (!GetDirentForPath(entry_path, &entry_dirent)) {
-      LogCvmfs(kLogCvmfs, kLogDebug, "listing entry %s vanished, skipping",
-               entry_path.c_str());
-      continue;
-    }
-
-    struct stat fixed_info = listing_from_catalog.AtPtr(i)->info;
-    fixed_info.st_ino = entry_dirent.inode();
-    AddToDirListing(req, listing_from_catalog.AtPtr(i)->name.c_str(),
-                    &fixed_info, &fuse_listing);
-  }
   fuse_remounter_->fence()->Leave();
 
   DirectoryListing stream_listing;
@@ -956,6 +1020,10 @@ static void cvmfs_opendir(fuse_req_t req, fuse_ino_t ino,
   fuse_listing.ShareBuffer(&stream_listing.buffer, &large_alloc);
   if (large_alloc)
     stream_listing.capacity = 0;
+  if ((listing_cache != NULL) && !is_cached && is_complete) {
+    listing_cache->Insert(ino, revision, incarnation, stream_listing.buffer,
+                          stream_listing.size);
+  }
 
   // Save the directory listing and return a handle to the listing
   {
@@ -1069,6 +1137,44 @@ static void FillOpenFlags(const glue::PageCacheTracker::OpenDirectives od,
 }
 
 
+#ifdef FUSE_CAP_PASSTHROUGH
+/**
+ * Lets the kernel read directly from the cache file in fi->fh.  Passthrough is
+ * only enabled if the fuse module has CAP_SYS_ADMIN (see cvmfs_init()).  If the
+ * kernel still refuses the backing file, reads are served by cvmfs_read() as
+ * usual.
+ */
+static void OpenPassthrough(fuse_req_t req, struct fuse_file_info *fi) {
+  const int backing_id = fuse_passthrough_open(req, fi->fh);
+  if (backing_id <= 0) {
+    LogCvmfs(kLogCvmfs, kLogDebug, "passthrough refused for fd %d",
+             static_cast<int>(fi->fh));
+    return;
+  }
+  fi->backing_id = backing_id;
+  {
+    MutexLockGuard m(&lock_passthrough_handles_);
+    (*passthrough_handles_)[fi->fh] = backing_id;
+  }
+  perf::Inc(file_system_->n_fs_open_passthrough());
+}
+
+
+static void ClosePassthrough(fuse_req_t req, const uint64_t fh) {
+  int backing_id;
+  {
+    MutexLockGuard m(&lock_passthrough_handles_);
+    PassthroughHandles::iterator iter_handle = passthrough_handles_->find(fh);
+    if (iter_handle == passthrough_handles_->end())
+      return;
+    backing_id = iter_handle->second;
+    passthrough_handles_->erase(iter_handle);
+  }
+  fuse_passthrough_close(req, backing_id);
+}
+#endif
+
+
 #ifdef __APPLE__
 // On macOS, xattr on a symlink opens and closes the file (with O_SYMLINK)
 // around the actual getxattr call. In order to not run into an I/O error
@@ -1093,6 +1199,7 @@ static void cvmfs_open(fuse_req_t req, fuse_ino_t ino,
   fuse_remounter_->fence()->Enter();
   catalog::ClientCatalogManager *catalog_mgr = mount_point_->catalog_mgr();
   ino = catalog_mgr->MangleInode(ino);
+  TraceGuard trace_guard(mount_point_->tracer(), Tracer::kEventOpen, ino);
   LogCvmfs(kLogCvmfs, kLogDebug, "cvmfs_open on inode: %" PRIu64,
            uint64_t(ino));
 
@@ -1103,19 +1210,19 @@ static void cvmfs_open(fuse_req_t req, fuse_ino_t ino,
   bool found = GetPathForInode(ino, &path);
   if (!found) {
     fuse_remounter_->fence()->Leave();
-    fuse_reply_err(req, ENOENT);
+    fuse_reply_err(req, trace_guard.Errno(ENOENT));
     return;
   }
   found = GetDirentForInode(ino, &dirent);
   if (!found) {
     fuse_remounter_->fence()->Leave();
-    ReplyNegative(dirent, req);
+    ReplyNegative(dirent, req, &trace_guard);
     return;
   }
 
   if (!CheckVoms(*fuse_ctx)) {
     fuse_remounter_->fence()->Leave();
-    fuse_reply_err(req, EACCES);
+    fuse_reply_err(req, trace_guard.Errno(EACCES));
     return;
   }
 
@@ -1129,7 +1236,7 @@ static void cvmfs_open(fuse_req_t req, fuse_ino_t ino,
 #ifdef __APPLE__
   if ((fi->flags & O_SHLOCK) || (fi->flags & O_EXLOCK)) {
     fuse_remounter_->fence()->Leave();
-    fuse_reply_err(req, EOPNOTSUPP);
+    fuse_reply_err(req, trace_guard.Errno(EOPNOTSUPP));
     return;
   }
   if (fi->flags & O_SYMLINK) {
@@ -1141,7 +1248,7 @@ static void cvmfs_open(fuse_req_t req, fuse_ino_t ino,
 #endif
   if (fi->flags & O_EXCL) {
     fuse_remounter_->fence()->Leave();
-    fuse_reply_err(req, EEXIST);
+    fuse_reply_err(req, trace_guard.Errno(EEXIST));
     return;
   }
 
@@ -1168,7 +1275,7 @@ static void cvmfs_open(fuse_req_t req, fuse_ino_t ino,
       perf::Dec(file_system_->no_open_files());
       fuse_remounter_->fence()->Leave();
       LogCvmfs(kLogCvmfs, kLogSyslogErr, "open file descriptor limit exceeded");
-      fuse_reply_err(req, EMFILE);
+      fuse_reply_err(req, trace_guard.Errno(EMFILE));
       return;
     }
 
@@ -1181,7 +1288,7 @@ static void cvmfs_open(fuse_req_t req, fuse_ino_t ino,
       fuse_remounter_->fence()->Leave();
       LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogErr,
                "chunked file %s vanished unexpectedly", path.c_str());
-      fuse_reply_err(req, ENOENT);
+      fuse_reply_err(req, trace_guard.Errno(ENOENT));
       return;
     }
     const uint64_t unique_inode = dirent_origin.inode();
@@ -1203,7 +1310,7 @@ static void cvmfs_open(fuse_req_t req, fuse_ino_t ino,
            path.c_str());
         perf::Inc(file_system_->n_eio_total());
         perf::Inc(file_system_->n_eio_04());
-        fuse_reply_err(req, EIO);
+        fuse_reply_err(req, trace_guard.Errno(EIO));
         return;
       }
       fuse_remounter_->fence()->Leave();
@@ -1282,13 +1389,18 @@ static void cvmfs_open(fuse_req_t req, fuse_ino_t ino,
                path.c_str(), fd);
       fi->fh = fd;
       FillOpenFlags(open_directives, fi);
+#ifdef FUSE_CAP_PASSTHROUGH
+      // The page cache of passthrough files is managed by the backing file
+      if (mount_point_->fuse_passthrough() && !fi->direct_io)
+        OpenPassthrough(req, fi);
+#endif
       fuse_reply_open(req, fi);
       return;
     } else {
       if (file_system_->cache_mgr()->Close(fd) == 0)
         perf::Dec(file_system_->no_open_files());
       LogCvmfs(kLogCvmfs, kLogSyslogErr, "open file descriptor limit exceeded");
-      fuse_reply_err(req, EMFILE);
+      fuse_reply_err(req, trace_guard.Errno(EMFILE));
       return;
     }
     assert(false);
@@ -1299,7 +1411,7 @@ static void cvmfs_open(fuse_req_t req, fuse_ino_t ino,
            "failed to open inode: %" PRIu64 ", CAS key %s, error code %d",
            uint64_t(ino), dirent.checksum().ToString().c_str(), errno);
   if (errno == EMFILE) {
-    fuse_reply_err(req, EMFILE);
+    fuse_reply_err(req, trace_guard.Errno(EMFILE));
     return;
   }
 
@@ -1313,7 +1425,29 @@ static void cvmfs_open(fuse_req_t req, fuse_ino_t ino,
     perf::Inc(file_system_->n_eio_06());
   }
 
-  fuse_reply_err(req, -fd);
+  fuse_reply_err(req, trace_guard.Errno(-fd));
+}
+
+
+/**
+ * Replies a failed read of a regular file's cache file, both for the copying
+ * and the splicing read.
+ */
+static void ReplyReadError(fuse_req_t req, fuse_ino_t ino, int64_t nbytes) {
+  if ( EIO == errno || EIO == -nbytes ) {
+    PathString path;
+    bool found = GetPathForInode(ino, &path);
+    if ( found ) {
+      LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogErr,
+         "EIO (08) on %s", path.ToString().c_str() );
+    } else {
+      LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogErr,
+         "EIO (08) on <unknown inode>");
+    }
+    perf::Inc(file_system_->n_eio_total());
+    perf::Inc(file_system_->n_eio_08());
+  }
+  fuse_reply_err(req, -nbytes);
 }
 
 
@@ -1338,14 +1472,39 @@ static void cvmfs_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
   }
 #endif
 
-  // Get data chunk (<=128k guaranteed by Fuse)
-  char *data = static_cast<char *>(alloca(size));
-  unsigned int overall_bytes_fetched = 0;
-
   int64_t fd = static_cast<int64_t>(fi->fh);
   uint64_t abs_fd = (fd < 0) ? -fd : fd;
   ClearBit(glue::PageCacheTracker::kBitDirectIo, &abs_fd);
 
+#ifdef FUSE_CAP_SPLICE_WRITE
+  // Regular files: the data is spliced from the cache file through a pipe to
+  // the fuse device without passing through a buffer of ours.  If no pipe is
+  // available, the data is copied.
+  if ((fd >= 0) && mount_point_->fuse_splice_read()) {
+    SplicePipes::Pipe pipe;
+    const int64_t nbytes =
+      splice_pipes_->Splice(static_cast<int>(abs_fd), off, size, &pipe);
+    if (nbytes != -ENOBUFS) {
+      if (nbytes < 0) {
+        ReplyReadError(req, ino, nbytes);
+        return;
+      }
+      struct fuse_bufvec bufvec =
+        FUSE_BUFVEC_INIT(static_cast<size_t>(nbytes));
+      bufvec.buf[0].flags = FUSE_BUF_IS_FD;
+      bufvec.buf[0].fd = pipe.fd[0];
+      perf::Inc(file_system_->n_fs_read_splice());
+      fuse_reply_data(req, &bufvec, FUSE_BUF_SPLICE_MOVE);
+      splice_pipes_->Release(&pipe);
+      return;
+    }
+  }
+#endif
+
+  // Get data chunk (<=128k guaranteed by Fuse)
+  char *data = static_cast<char *>(alloca(size));
+  unsigned int overall_bytes_fetched = 0;
+
   // Do we have a a chunked file?
   if (fd < 0) {
     const struct fuse_ctx *fuse_ctx = fuse_req_ctx(req);
@@ -1385,7 +1544,16 @@ static void cvmfs_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
     do {
       // Open file descriptor to chunk
       if ((chunk_fd.fd == -1) || (chunk_fd.chunk_idx != chunk_idx)) {
+        // Moving from one chunk to the next one indicates a sequential reader
+        const bool is_sequential =
+          (chunk_fd.fd != -1) && (chunk_idx == chunk_fd.chunk_idx + 1);
         if (chunk_fd.fd != -1) file_system_->cache_mgr()->Close(chunk_fd.fd);
+        const CacheManager::ObjectType object_type =
+          mount_point_->catalog_mgr()->volatile_flag()
+            ? CacheManager::kTypeVolatile
+            : CacheManager::kTypeRegular;
+        mount_point_->read_ahead()->OnChunkOpen(
+          chunks, chunk_idx, is_sequential, object_type);
         string verbose_path = "Part of " + chunks.path.ToString();
         if (chunks.external_data) {
           chunk_fd.fd = mount_point_->external_fetcher()->Fetch(
@@ -1393,9 +1561,7 @@ static void cvmfs_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
             chunks.list->AtPtr(chunk_idx)->size(),
             verbose_path,
             chunks.compression_alg,
-            mount_point_->catalog_mgr()->volatile_flag()
-              ? CacheManager::kTypeVolatile
-              : CacheManager::kTypeRegular,
+            object_type,
             chunks.path.ToString(),
             chunks.list->AtPtr(chunk_idx)->offset());
         } else {
@@ -1404,9 +1570,7 @@ static void cvmfs_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
             chunks.list->AtPtr(chunk_idx)->size(),
             verbose_path,
             chunks.compression_alg,
-            mount_point_->catalog_mgr()->volatile_flag()
-              ? CacheManager::kTypeVolatile
-              : CacheManager::kTypeRegular);
+            object_type);
         }
         if (chunk_fd.fd < 0) {
           chunk_fd.fd = -1;
@@ -1470,26 +1634,14 @@ static void cvmfs_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
   } else {
     int64_t nbytes = file_system_->cache_mgr()->Pread(abs_fd, data, size, off);
     if (nbytes < 0) {
-      if ( EIO == errno || EIO == -nbytes ) {
-        PathString path;
-        bool found = GetPathForInode(ino, &path);
-        if ( found ) {
-          LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogErr,
-             "EIO (08) on %s", path.ToString().c_str() );
-        } else {
-          LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogErr,
-             "EIO (08) on <unknown inode>");
-        }
-        perf::Inc(file_system_->n_eio_total());
-        perf::Inc(file_system_->n_eio_08());
-      }
-      fuse_reply_err(req, -nbytes);
+      ReplyReadError(req, ino, nbytes);
       return;
     }
     overall_bytes_fetched = nbytes;
   }
 
   // Push it to user
+  perf::Inc(file_system_->n_fs_read_copy());
   fuse_reply_buf(req, data, overall_bytes_fetched);
   LogCvmfs(kLogCvmfs, kLogDebug, "pushed %d bytes to user",
            overall_bytes_fetched);
@@ -1567,6 +1719,10 @@ static void cvmfs_release(fuse_req_t req, fuse_ino_t ino,
       file_system_->cache_mgr()->Close(chunk_fd.fd);
     perf::Dec(file_system_->no_open_files());
   } else {
+#ifdef FUSE_CAP_PASSTHROUGH
+    if (mount_point_->fuse_passthrough())
+      ClosePassthrough(req, fi->fh);
+#endif
     if (file_system_->cache_mgr()->Close(abs_fd) == 0) {
       perf::Dec(file_system_->no_open_files());
     }
@@ -1587,6 +1743,7 @@ static void cvmfs_statfs(fuse_req_t req, fuse_ino_t ino) {
            uint64_t(ino));
 
   TraceInode(Tracer::kEventStatFs, ino, "statfs()");
+  TraceGuard trace_guard(mount_point_->tracer(), Tracer::kEventStatFs, ino);
 
   perf::Inc(file_system_->n_fs_statfs());
 
@@ -1658,12 +1815,13 @@ static void cvmfs_getxattr(fuse_req_t req, fuse_ino_t ino, const char *name,
   fuse_remounter_->fence()->Enter();
   catalog::ClientCatalogManager *catalog_mgr = mount_point_->catalog_mgr();
   ino = catalog_mgr->MangleInode(ino);
+  TraceGuard trace_guard(mount_point_->tracer(), Tracer::kEventGetXAttr, ino);
   LogCvmfs(kLogCvmfs, kLogDebug,
            "cvmfs_getxattr on inode: %" PRIu64 " for xattr: %s",
            uint64_t(ino), name);
   if (!CheckVoms(*fuse_ctx)) {
     fuse_remounter_->fence()->Leave();
-    fuse_reply_err(req, EACCES);
+    fuse_reply_err(req, trace_guard.Errno(EACCES));
     return;
   }
   TraceInode(Tracer::kEventGetXAttr, ino, "getxattr()");
@@ -1693,7 +1851,7 @@ static void cvmfs_getxattr(fuse_req_t req, fuse_ino_t ino, const char *name,
                      "LookupXattrs did not succeed for path %s",
                      path.c_str())) {
       fuse_remounter_->fence()->Leave();
-      fuse_reply_err(req, ESTALE);
+      fuse_reply_err(req, trace_guard.Errno(ESTALE));
     }
   }
 
@@ -1708,12 +1866,12 @@ static void cvmfs_getxattr(fuse_req_t req, fuse_ino_t ino, const char *name,
   fuse_remounter_->fence()->Leave();
 
   if (!found) {
-    ReplyNegative(d, req);
+    ReplyNegative(d, req, &trace_guard);
     return;
   }
 
   if (!magic_xattr_success) {
-    fuse_reply_err(req, ENOATTR);
+    fuse_reply_err(req, trace_guard.Errno(ENOATTR));
     return;
   }
 
@@ -1723,7 +1881,7 @@ static void cvmfs_getxattr(fuse_req_t req, fuse_ino_t ino, const char *name,
     attribute_value = magic_xattr->GetValue();
   } else {
     if (!xattrs.Get(attr, &attribute_value)) {
-      fuse_reply_err(req, ENOATTR);
+      fuse_reply_err(req, trace_guard.Errno(ENOATTR));
       return;
     }
   }
@@ -1733,7 +1891,7 @@ static void cvmfs_getxattr(fuse_req_t req, fuse_ino_t ino, const char *name,
   } else if (size >= attribute_value.length()) {
     fuse_reply_buf(req, &attribute_value[0], attribute_value.length());
   } else {
-    fuse_reply_err(req, ERANGE);
+    fuse_reply_err(req, trace_guard.Errno(ERANGE));
   }
 }
 
@@ -1747,6 +1905,7 @@ static void cvmfs_listxattr(fuse_req_t req, fuse_ino_t ino, size_t size) {
   catalog::ClientCatalogManager *catalog_mgr = mount_point_->catalog_mgr();
   ino = catalog_mgr->MangleInode(ino);
   TraceInode(Tracer::kEventListAttr, ino, "listxattr()");
+  TraceGuard trace_guard(mount_point_->tracer(), Tracer::kEventListAttr, ino);
   LogCvmfs(kLogCvmfs, kLogDebug,
            "cvmfs_listxattr on inode: %" PRIu64 ", size %u [visibility %d]",
            uint64_t(ino), size,
@@ -1764,7 +1923,7 @@ static void cvmfs_listxattr(fuse_req_t req, fuse_ino_t ino, size_t size) {
                      "GetPathForInode did not succeed for ino %lu",
                      ino)) {
       fuse_remounter_->fence()->Leave();
-      fuse_reply_err(req, ESTALE);
+      fuse_reply_err(req, trace_guard.Errno(ESTALE));
       return;
     }
 
@@ -1774,14 +1933,14 @@ static void cvmfs_listxattr(fuse_req_t req, fuse_ino_t ino, size_t size) {
                      "LookupXattrs did not succeed for ino %lu",
                      ino)) {
       fuse_remounter_->fence()->Leave();
-      fuse_reply_err(req, ESTALE);
+      fuse_reply_err(req, trace_guard.Errno(ESTALE));
       return;
     }
   }
   fuse_remounter_->fence()->Leave();
 
   if (!found) {
-    ReplyNegative(d, req);
+    ReplyNegative(d, req, &trace_guard);
     return;
   }
 
@@ -1797,7 +1956,7 @@ static void cvmfs_listxattr(fuse_req_t req, fuse_ino_t ino, size_t size) {
     else
       fuse_reply_buf(req, &attribute_list[0], attribute_list.length());
   } else {
-    fuse_reply_err(req, ERANGE);
+    fuse_reply_err(req, trace_guard.Errno(ERANGE));
   }
 }
 
@@ -1960,6 +2119,64 @@ static void cvmfs_init(void *userdata, struct fuse_conn_info *conn) {
       "mountpoints on top of symlinks will break!");
   }
 #endif
+
+  const bool has_native_fds = file_system_->cache_mgr()->HasNativeFds();
+  if (mount_point_->fuse_splice_read()) {
+#ifdef FUSE_CAP_SPLICE_WRITE
+    if (!has_native_fds) {
+      mount_point_->DisableFuseSpliceRead();
+      LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogWarn,
+           "FUSE: splice read requested but not supported by the cache "
+           "manager, falling back to copying");
+    } else if ((conn->capable & FUSE_CAP_SPLICE_WRITE) ==
+               FUSE_CAP_SPLICE_WRITE)
+    {
+      conn->want |= FUSE_CAP_SPLICE_WRITE;
+      LogCvmfs(kLogCvmfs, kLogDebug, "FUSE: Enable splice read");
+    } else {
+      mount_point_->DisableFuseSpliceRead();
+      LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogWarn,
+           "FUSE: splice read requested but missing fuse kernel support, "
+           "falling back to copying");
+    }
+#else
+    mount_point_->DisableFuseSpliceRead();
+    LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogWarn,
+          "FUSE: splice read requested but missing libfuse support, "
+          "falling back to copying");
+#endif
+  }
+
+  if (mount_point_->fuse_passthrough()) {
+#ifdef FUSE_CAP_PASSTHROUGH
+    if (!has_native_fds) {
+      mount_point_->DisableFusePassthrough();
+      LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogWarn,
+           "FUSE: passthrough requested but not supported by the cache "
+           "manager, disabling");
+    } else if (!HasEffectiveCapability(kCapSysAdmin)) {
+      // The kernel only accepts backing files from a privileged fuse daemon
+      mount_point_->DisableFusePassthrough();
+      LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogWarn,
+           "FUSE: passthrough requested but missing CAP_SYS_ADMIN, disabling");
+    } else if ((conn->capable & FUSE_CAP_PASSTHROUGH) ==
+               FUSE_CAP_PASSTHROUGH)
+    {
+      conn->want |= FUSE_CAP_PASSTHROUGH;
+      LogCvmfs(kLogCvmfs, kLogDebug, "FUSE: Enable passthrough");
+    } else {
+      mount_point_->DisableFusePassthrough();
+      LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogWarn,
+           "FUSE: passthrough requested but missing fuse kernel support, "
+           "disabling");
+    }
+#else
+    mount_point_->DisableFusePassthrough();
+    LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogWarn,
+          "FUSE: passthrough requested but missing libfuse support, "
+          "disabling");
+#endif
+  }
 }
 
 static void cvmfs_destroy(void *unused __attribute__((unused))) {
@@ -2234,6 +2451,10 @@ static int Init(const loader::LoaderExports *loader_exports) {
   cvmfs::directory_handles_ = new cvmfs::DirectoryHandles();
   cvmfs::directory_handles_->set_empty_key((uint64_t)(-1));
   cvmfs::directory_handles_->set_deleted_key((uint64_t)(-2));
+  cvmfs::passthrough_handles_ = new cvmfs::PassthroughHandles();
+  cvmfs::passthrough_handles_->set_empty_key((uint64_t)(-1));
+  cvmfs::passthrough_handles_->set_deleted_key((uint64_t)(-2));
+  cvmfs::splice_pipes_ = new SplicePipes();
 
   LogCvmfs(kLogCvmfs, kLogDebug, "fuse inode size is %d bits",
            sizeof(fuse_ino_t) * 8);
@@ -2342,6 +2563,7 @@ static void Spawn() {
       cvmfs::mount_point_->uuid()->uuid() + "-unpin");
   }
   cvmfs::mount_point_->tracer()->Spawn();
+  cvmfs::mount_point_->read_ahead()->Spawn();
   cvmfs::talk_mgr_->Spawn();
 
   if (cvmfs::notification_client_ != NULL) {
@@ -2394,8 +2616,12 @@ static void ShutdownMountpoint() {
     cvmfs::watchdog_listener_ = NULL;
   }
 
+  delete cvmfs::splice_pipes_;
+  delete cvmfs::passthrough_handles_;
   delete cvmfs::directory_handles_;
   delete cvmfs::mount_point_;
+  cvmfs::splice_pipes_ = NULL;
+  cvmfs::passthrough_handles_ = NULL;
   cvmfs::directory_handles_ = NULL;
   cvmfs::mount_point_ = NULL;
 }
@@ -2478,7 +2704,7 @@ static bool SaveState(const int fd_progress, loader::StateList *saved_states) {
     glue::InodeTracker *saved_inode_tracker =
       new glue::InodeTracker(*cvmfs::mount_point_->inode_tracker());
     loader::SavedState *state_glue_buffer = new loader::SavedState();
-    state_glue_buffer->state_id = loader::kStateGlueBufferV4;
+    state_glue_buffer->state_id = loader::kStateGlueBufferV5;
     state_glue_buffer->state = saved_inode_tracker;
     saved_states->push_back(state_glue_buffer);
   }
@@ -2488,7 +2714,7 @@ static bool SaveState(const int fd_progress, loader::StateList *saved_states) {
   glue::DentryTracker *saved_dentry_tracker =
     new glue::DentryTracker(*cvmfs::mount_point_->dentry_tracker());
   loader::SavedState *state_dentry_tracker = new loader::SavedState();
-  state_dentry_tracker->state_id = loader::kStateDentryTracker;
+  state_dentry_tracker->state_id = loader::kStateDentryTrackerV2;
   state_dentry_tracker->state = saved_dentry_tracker;
   saved_states->push_back(state_dentry_tracker);
 
@@ -2598,6 +2824,15 @@ static bool RestoreState(const int fd_progress,
     }
 
     if (saved_states[i]->state_id == loader::kStateGlueBufferV4) {
+      SendMsg2Socket(fd_progress, "Migrating inode tracker (v4 to v5)... ");
+      compat::inode_tracker_v4::InodeTracker *saved_inode_tracker =
+        (compat::inode_tracker_v4::InodeTracker *)saved_states[i]->state;
+      compat::inode_tracker_v4::Migrate(saved_inode_tracker,
+                                        cvmfs::mount_point_->inode_tracker());
+      SendMsg2Socket(fd_progress, " done\n");
+    }
+
+    if (saved_states[i]->state_id == loader::kStateGlueBufferV5) {
       SendMsg2Socket(fd_progress, "Restoring inode tracker... ");
       cvmfs::mount_point_->inode_tracker()->~InodeTracker();
       glue::InodeTracker *saved_inode_tracker =
@@ -2608,6 +2843,16 @@ static bool RestoreState(const int fd_progress,
     }
 
     if (saved_states[i]->state_id == loader::kStateDentryTracker) {
+      SendMsg2Socket(fd_progress, "Migrating dentry tracker (v1 to v2)... ");
+      compat::dentry_tracker::DentryTracker *saved_dentry_tracker =
+        static_cast<compat::dentry_tracker::DentryTracker *>(
+          saved_states[i]->state);
+      compat::dentry_tracker::Migrate(saved_dentry_tracker,
+                                      cvmfs::mount_point_->dentry_tracker());
+      SendMsg2Socket(fd_progress, " done\n");
+    }
+
+    if (saved_states[i]->state_id == loader::kStateDentryTrackerV2) {
       SendMsg2Socket(fd_progress, "Restoring dentry tracker... ");
       cvmfs::mount_point_->dentry_tracker()->~DentryTracker();
       glue::DentryTracker *saved_dentry_tracker =
@@ -2737,10 +2982,22 @@ static void FreeSavedState(const int fd_progress,
           saved_states[i]->state);
         break;
       case loader::kStateGlueBufferV4:
+        SendMsg2Socket(
+          fd_progress, "Releasing saved glue buffer (version 4)\n");
+        delete static_cast<compat::inode_tracker_v4::InodeTracker *>(
+          saved_states[i]->state);
+        break;
+      case loader::kStateGlueBufferV5:
         SendMsg2Socket(fd_progress, "Releasing saved glue buffer\n");
         delete static_cast<glue::InodeTracker *>(saved_states[i]->state);
         break;
       case loader::kStateDentryTracker:
+        SendMsg2Socket(
+          fd_progress, "Releasing saved dentry tracker (version 1)\n");
+        delete static_cast<compat::dentry_tracker::DentryTracker *>(
+          saved_states[i]->state);
+        break;
+      case loader::kStateDentryTrackerV2:
         SendMsg2Socket(fd_progress, "Releasing saved dentry tracker\n");
         delete static_cast<glue::DentryTracker *>(saved_states[i]->state);
         break;
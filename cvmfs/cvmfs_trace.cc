@@ -0,0 +1,106 @@
+/**
+ * This file is part of the CernVM File System.
+ *
+ * cvmfs_trace converts a binary trace file written with
+ * CVMFS_TRACEFILE_FORMAT=binary into CSV or into the Chrome trace event format.
+ */
+
+#include "cvmfs_config.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "tracer.h"
+#include "util/logging.h"
+
+using namespace std;  // NOLINT
+
+enum Errors {
+  kErrorOk = 0,
+  kErrorUsage = 1,
+  kErrorIo = 2,
+  kErrorFormat = 3,
+};
+
+
+static void Usage() {
+  LogCvmfs(kLogCvmfs, kLogStdout,
+           "CernVM File System trace converter, version %s\n\n"
+           "This tool converts a binary client trace file into a readable "
+           "format.\n\n"
+           "Usage: cvmfs_trace [-f csv|chrome] [-o output file] <trace file>\n"
+           "Options:\n"
+           "  -f output format, defaults to csv\n"
+           "  -o output file, defaults to stdout\n",
+           VERSION);
+}
+
+
+int main(int argc, char **argv) {
+  Tracer::ConvertFormat format = Tracer::kConvertCsv;
+  string output_path;
+
+  int c;
+  while ((c = getopt(argc, argv, "hf:o:")) != -1) {
+    switch (c) {
+      case 'h':
+        Usage();
+        return kErrorOk;
+      case 'f':
+        if (strcmp(optarg, "csv") == 0) {
+          format = Tracer::kConvertCsv;
+        } else if (strcmp(optarg, "chrome") == 0) {
+          format = Tracer::kConvertChrome;
+        } else {
+          LogCvmfs(kLogCvmfs, kLogStderr, "unknown output format: %s",
+                   optarg);
+          return kErrorUsage;
+        }
+        break;
+      case 'o':
+        output_path = optarg;
+        break;
+      case '?':
+      default:
+        Usage();
+        return kErrorUsage;
+    }
+  }
+
+  if (optind >= argc) {
+    Usage();
+    return kErrorUsage;
+  }
+
+  FILE *src = fopen(argv[optind], "r");
+  if (src == NULL) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to open %s (%d)",
+             argv[optind], errno);
+    return kErrorIo;
+  }
+  FILE *dst = stdout;
+  if (!output_path.empty()) {
+    dst = fopen(output_path.c_str(), "w");
+    if (dst == NULL) {
+      LogCvmfs(kLogCvmfs, kLogStderr, "failed to open %s (%d)",
+               output_path.c_str(), errno);
+      fclose(src);
+      return kErrorIo;
+    }
+  }
+
+  const bool retval = Tracer::ConvertBinary(src, dst, format);
+  fclose(src);
+  if (dst != stdout)
+    fclose(dst);
+  if (!retval) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "%s is not a valid binary trace file",
+             argv[optind]);
+    return kErrorFormat;
+  }
+  return kErrorOk;
+}
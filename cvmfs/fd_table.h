@@ -56,6 +56,25 @@ class FdTable : SingleCopy {
     }
   }
 
+  /**
+   * Used to restore a state that was saved with an older handle type.  The
+   * file descriptor numbers are preserved.
+   */
+  template <class OtherHandleT>
+  void AssignFrom(const FdTable<OtherHandleT> &other,
+                  HandleT (*migrate_handle)(const OtherHandleT &))
+  {
+    invalid_handle_ = migrate_handle(other.invalid_handle_);
+    fd_pivot_ = other.fd_pivot_;
+    fd_index_.resize(other.fd_index_.size());
+    open_fds_.resize(other.open_fds_.size(), FdWrapper(invalid_handle_, 0));
+    for (unsigned i = 0; i < fd_index_.size(); ++i) {
+      fd_index_[i] = other.fd_index_[i];
+      open_fds_[i] = FdWrapper(migrate_handle(other.open_fds_[i].handle),
+                               other.open_fds_[i].index);
+    }
+  }
+
   /**
    * Used to save the state.
    */
@@ -125,6 +144,8 @@ class FdTable : SingleCopy {
   unsigned GetMaxFds() const { return fd_index_.size(); }
 
  private:
+  template <class OtherHandleT> friend class FdTable;
+
   struct FdWrapper {
     FdWrapper(HandleT h, unsigned i) : handle(h), index(i) { }
 
@@ -14,6 +14,7 @@
 #include "network/download.h"
 #include "quota.h"
 #include "statistics.h"
+#include "util/algorithm.h"
 #include "util/concurrency.h"
 #include "util/logging.h"
 #include "util/posix.h"
@@ -140,18 +141,13 @@ int Fetcher::Fetch(
 
   // Involve the download manager
   LogCvmfs(kLogCache, kLogDebug, "downloading %s", name.c_str());
-  std::string url;
-  if (external_) {
-    url = !alt_url.empty() ? alt_url : name;
-  } else {
-    url = "/" + (alt_url.size() ? alt_url : "data/" + id.MakePath());
-  }
+  const std::string url = GetUrl(id, name, alt_url);
   void *txn = alloca(cache_mgr_->SizeOfTxn());
   retval = cache_mgr_->StartTxn(id, size, txn);
   if (retval < 0) {
     LogCvmfs(kLogCache, kLogDebug, "could not start transaction on %s",
              name.c_str());
-    SignalWaitingThreads(retval, id, tls);
+    SignalWaitingThreads(retval, id, &tls->other_pipes_waiting);
     return retval;
   }
   cache_mgr_->CtrlTxn(CacheManager::ObjectInfo(object_type, name), 0, txn);
@@ -169,7 +165,9 @@ int Fetcher::Fetch(
              &tls->download_job.pid,
              &tls->download_job.interrupt_cue);
   }
-  tls->download_job.compressed = (compression_algorithm == zlib::kZlibDefault);
+  tls->download_job.compressed =
+    (compression_algorithm != zlib::kNoCompression);
+  tls->download_job.compression_alg = compression_algorithm;
   tls->download_job.range_offset = range_offset;
   tls->download_job.range_size = size;
   download_mgr_->Fetch(&tls->download_job);
@@ -180,17 +178,17 @@ int Fetcher::Fetch(
     fd_return = cache_mgr_->OpenFromTxn(txn);
     if (fd_return < 0) {
       cache_mgr_->AbortTxn(txn);
-      SignalWaitingThreads(fd_return, id, tls);
+      SignalWaitingThreads(fd_return, id, &tls->other_pipes_waiting);
       return fd_return;
     }
 
-    retval = cache_mgr_->CommitTxn(txn);
+    retval = CommitTxn(txn);
     if (retval < 0) {
       cache_mgr_->Close(fd_return);
-      SignalWaitingThreads(retval, id, tls);
+      SignalWaitingThreads(retval, id, &tls->other_pipes_waiting);
       return retval;
     }
-    SignalWaitingThreads(fd_return, id, tls);
+    SignalWaitingThreads(fd_return, id, &tls->other_pipes_waiting);
     return fd_return;
   }
 
@@ -201,11 +199,236 @@ int Fetcher::Fetch(
            download::Code2Ascii(tls->download_job.error_code));
   cache_mgr_->AbortTxn(txn);
   backoff_throttle_->Throttle();
-  SignalWaitingThreads(-EIO, id, tls);
+  SignalWaitingThreads(-EIO, id, &tls->other_pipes_waiting);
   return -EIO;
 }
 
 
+/**
+ * Non-blocking variant of Fetch().  The callback is called exactly once with
+ * either a file descriptor or a negative errno code and deleted afterwards.
+ * On a cache hit or an early failure, the callback is called from the calling
+ * thread.  Otherwise it is called from the fetcher's completion thread once
+ * the object is committed to the cache, so it should not block for long.
+ * Requests for an object that is already being downloaded, either by Fetch()
+ * or by FetchAsync(), are collapsed onto the running download.
+ *
+ * The download is not tied to a fuse request and thus cannot be interrupted.
+ * All callbacks need to be called before the Fetcher is destroyed.
+ */
+void Fetcher::FetchAsync(
+  const shash::Any &id,
+  const uint64_t size,
+  const std::string &name,
+  const zlib::Algorithms compression_algorithm,
+  const CacheManager::ObjectType object_type,
+  const CallbackTN *callback,
+  const std::string &alt_url,
+  off_t range_offset)
+{
+  assert(callback != NULL);
+  perf::Inc(n_invocations);
+
+  int fd_return = OpenSelect(id, name, object_type);
+  if (fd_return >= 0) {
+    LogCvmfs(kLogCache, kLogDebug, "hit: %s", name.c_str());
+    InvokeCallback(fd_return, callback);
+    return;
+  }
+
+  if (id.IsNull()) {
+    LogCvmfs(kLogCache, kLogDebug, "cancel attempt to download null hash");
+    InvokeCallback(-EIO, callback);
+    return;
+  }
+
+  // Synchronization point, see Fetch()
+  pthread_mutex_lock(lock_queues_download_);
+  if (queues_download_.find(id) != queues_download_.end()) {
+    LogCvmfs(kLogCache, kLogDebug, "queue callback for download of %s",
+             name.c_str());
+    queues_callbacks_[id].push_back(callback);
+    pthread_mutex_unlock(lock_queues_download_);
+    return;
+  }
+  fd_return = OpenSelect(id, name, object_type);
+  if (fd_return >= 0) {
+    pthread_mutex_unlock(lock_queues_download_);
+    InvokeCallback(fd_return, callback);
+    return;
+  }
+  AsyncDownload *download = new AsyncDownload();
+  queues_download_[id] = &download->other_pipes_waiting;
+  pthread_mutex_unlock(lock_queues_download_);
+  SpawnCompletionThread();
+
+  perf::Inc(n_downloads);
+
+  download->id = id;
+  download->name = name;
+  download->url = GetUrl(id, name, alt_url);
+  download->callback = callback;
+  LogCvmfs(kLogCache, kLogDebug, "downloading asynchronously %s",
+           name.c_str());
+
+  download->txn = smalloc(cache_mgr_->SizeOfTxn());
+  int retval = cache_mgr_->StartTxn(id, size, download->txn);
+  if (retval < 0) {
+    LogCvmfs(kLogCache, kLogDebug, "could not start transaction on %s",
+             name.c_str());
+    SignalWaitingThreads(retval, id, &download->other_pipes_waiting);
+    delete download;
+    InvokeCallback(retval, callback);
+    return;
+  }
+  cache_mgr_->CtrlTxn(CacheManager::ObjectInfo(object_type, name), 0,
+                      download->txn);
+
+  LogCvmfs(kLogCache, kLogDebug, "miss: %s %s", name.c_str(),
+           download->url.c_str());
+  download->sink = new TransactionSink(cache_mgr_, download->txn);
+  download::JobInfo *download_job = &download->download_job;
+  download_job->url = &download->url;
+  download_job->destination = download::kDestinationSink;
+  download_job->destination_sink = download->sink;
+  download_job->expected_hash = &download->id;
+  download_job->extra_info = &download->name;
+  download_job->probe_hosts = true;
+  ClientCtx *ctx = ClientCtx::GetInstance();
+  if (ctx->IsSet()) {
+    // The interrupt cue lives on the stack of the calling fuse request, which
+    // is likely gone before the download finishes
+    InterruptCue *interrupt_cue;
+    ctx->Get(&download_job->uid,
+             &download_job->gid,
+             &download_job->pid,
+             &interrupt_cue);
+  }
+  download_job->interrupt_cue = NULL;
+  download_job->compressed = (compression_algorithm != zlib::kNoCompression);
+  download_job->compression_alg = compression_algorithm;
+  download_job->range_offset = range_offset;
+  download_job->range_size = size;
+  download->download_callback =
+    Callbackable<download::JobInfo *>::MakeClosure(
+      &Fetcher::OnAsyncDownloadDone, this, download);
+  download_job->callback = download->download_callback;
+  download_mgr_->FetchAsync(download_job);
+}
+
+
+/**
+ * Called by the download manager, usually in its I/O thread, when a download
+ * started by FetchAsync() is finished.  Committing to the cache may block, so
+ * the download is handed over to the completion thread.  Neither the closure
+ * running this method nor the download job are touched by the download
+ * manager once this method returns.
+ */
+void Fetcher::OnAsyncDownloadDone(
+  download::JobInfo * const & /* download_job */,
+  AsyncDownload * const download)
+{
+  MutexLockGuard m(&lock_completion_);
+  completed_downloads_.push_back(download);
+  int retval = pthread_cond_signal(&cond_completion_);
+  assert(retval == 0);
+}
+
+
+/**
+ * Completes a download started by FetchAsync() in the completion thread.
+ * Unlike Fetch(), failures are not throttled because that would stall all the
+ * other transfers.
+ */
+void Fetcher::FinishAsyncDownload(AsyncDownload *download) {
+  download::JobInfo *download_job = &download->download_job;
+  int fd_return;
+  if (download_job->error_code == download::kFailOk) {
+    LogCvmfs(kLogCache, kLogDebug, "finished downloading of %s",
+             download->url.c_str());
+    fd_return = cache_mgr_->OpenFromTxn(download->txn);
+    if (fd_return < 0) {
+      cache_mgr_->AbortTxn(download->txn);
+    } else {
+      int retval = CommitTxn(download->txn);
+      if (retval < 0) {
+        cache_mgr_->Close(fd_return);
+        fd_return = retval;
+      }
+    }
+  } else {
+    LogCvmfs(kLogCache, kLogDebug | kLogSyslogErr,
+             "failed to fetch %s (hash: %s, error %d [%s])",
+             download->name.c_str(), download->id.ToString().c_str(),
+             download_job->error_code,
+             download::Code2Ascii(download_job->error_code));
+    cache_mgr_->AbortTxn(download->txn);
+    fd_return = -EIO;
+  }
+
+  SignalWaitingThreads(fd_return, download->id,
+                       &download->other_pipes_waiting);
+  const CallbackTN *callback = download->callback;
+  delete download;
+  InvokeCallback(fd_return, callback);
+}
+
+
+void *Fetcher::MainCompletion(void *data) {
+  Fetcher *fetcher = reinterpret_cast<Fetcher *>(data);
+  LogCvmfs(kLogCache, kLogDebug, "starting fetcher completion thread");
+
+  while (true) {
+    AsyncDownload *download;
+    {
+      MutexLockGuard m(&fetcher->lock_completion_);
+      while (fetcher->completed_downloads_.empty() &&
+             !fetcher->completion_terminate_)
+      {
+        int retval = pthread_cond_wait(&fetcher->cond_completion_,
+                                       &fetcher->lock_completion_);
+        assert(retval == 0);
+      }
+      if (fetcher->completed_downloads_.empty())
+        break;
+      download = fetcher->completed_downloads_.front();
+      fetcher->completed_downloads_.pop_front();
+    }
+    fetcher->FinishAsyncDownload(download);
+  }
+
+  LogCvmfs(kLogCache, kLogDebug, "stopping fetcher completion thread");
+  return NULL;
+}
+
+
+void Fetcher::SpawnCompletionThread() {
+  MutexLockGuard m(&lock_completion_);
+  if (completion_spawned_)
+    return;
+  int retval = pthread_create(&thread_completion_, NULL, MainCompletion, this);
+  assert(retval == 0);
+  completion_spawned_ = true;
+}
+
+
+void Fetcher::InvokeCallback(const int fd, const CallbackTN *callback) {
+  (*callback)(fd);
+  delete callback;
+}
+
+
+std::string Fetcher::GetUrl(
+  const shash::Any &id,
+  const std::string &name,
+  const std::string &alt_url)
+{
+  if (external_)
+    return !alt_url.empty() ? alt_url : name;
+  return "/" + (alt_url.size() ? alt_url : "data/" + id.MakePath());
+}
+
+
 Fetcher::Fetcher(
   CacheManager *cache_mgr,
   download::DownloadManager *download_mgr,
@@ -218,6 +441,8 @@ Fetcher::Fetcher(
   , cache_mgr_(cache_mgr)
   , download_mgr_(download_mgr)
   , backoff_throttle_(backoff_throttle)
+  , completion_spawned_(false)
+  , completion_terminate_(false)
 {
   int retval;
   retval = pthread_key_create(&thread_local_storage_, TLSDestructor);
@@ -230,16 +455,35 @@ Fetcher::Fetcher(
     smalloc(sizeof(pthread_mutex_t)));
   retval = pthread_mutex_init(lock_tls_blocks_, NULL);
   assert(retval == 0);
+  retval = pthread_mutex_init(&lock_completion_, NULL);
+  assert(retval == 0);
+  retval = pthread_cond_init(&cond_completion_, NULL);
+  assert(retval == 0);
   n_downloads = statistics.RegisterTemplated("n_downloads",
     "overall number of downloaded files (incl. catalogs, chunks)");
   n_invocations = statistics.RegisterTemplated("n_invocations",
     "overall number of object requests (incl. catalogs, chunks)");
+  hist_commit = statistics.RegisterHistogramTemplated("hist_commit",
+    "time to commit downloaded objects to the cache");
 }
 
 
 Fetcher::~Fetcher() {
   int retval;
 
+  if (completion_spawned_) {
+    {
+      MutexLockGuard m(&lock_completion_);
+      completion_terminate_ = true;
+      retval = pthread_cond_signal(&cond_completion_);
+      assert(retval == 0);
+    }
+    retval = pthread_join(thread_completion_, NULL);
+    assert(retval == 0);
+  }
+  pthread_cond_destroy(&cond_completion_);
+  pthread_mutex_destroy(&lock_completion_);
+
   {
     MutexLockGuard m(lock_tls_blocks_);
     for (unsigned i = 0; i < tls_blocks_.size(); ++i)
@@ -277,18 +521,47 @@ int Fetcher::OpenSelect(
 }
 
 
+/**
+ * Commits a finished download to the cache and records the time it took.
+ */
+int Fetcher::CommitTxn(void *txn) {
+  const uint64_t timestamp_ns = platform_monotonic_time_ns();
+  const int retval = cache_mgr_->CommitTxn(txn);
+  hist_commit->Add((platform_monotonic_time_ns() - timestamp_ns) / 1000);
+  return retval;
+}
+
+
+/**
+ * Hands the result of a download to the threads blocked in Fetch() and to the
+ * callbacks queued by FetchAsync().  The callbacks are called outside the lock
+ * because they may issue new requests.
+ */
 void Fetcher::SignalWaitingThreads(
   const int fd,
   const shash::Any &id,
-  ThreadLocalStorage *tls)
+  std::vector<int> *other_pipes_waiting)
 {
-  MutexLockGuard m(lock_queues_download_);
-  for (unsigned i = 0, s = tls->other_pipes_waiting.size(); i < s; ++i) {
+  std::vector<const CallbackTN *> callbacks;
+  {
+    MutexLockGuard m(lock_queues_download_);
+    for (unsigned i = 0, s = other_pipes_waiting->size(); i < s; ++i) {
+      int fd_dup = (fd >= 0) ? cache_mgr_->Dup(fd) : fd;
+      WritePipe((*other_pipes_waiting)[i], &fd_dup, sizeof(int));
+    }
+    other_pipes_waiting->clear();
+    queues_download_.erase(id);
+    CallbackQueues::iterator i = queues_callbacks_.find(id);
+    if (i != queues_callbacks_.end()) {
+      callbacks.swap(i->second);
+      queues_callbacks_.erase(i);
+    }
+  }
+
+  for (unsigned i = 0, s = callbacks.size(); i < s; ++i) {
     int fd_dup = (fd >= 0) ? cache_mgr_->Dup(fd) : fd;
-    WritePipe(tls->other_pipes_waiting[i], &fd_dup, sizeof(int));
+    InvokeCallback(fd_dup, callbacks[i]);
   }
-  tls->other_pipes_waiting.clear();
-  queues_download_.erase(id);
 }
 
 }  // namespace cvmfs
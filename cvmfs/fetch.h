@@ -7,6 +7,8 @@
 
 #include <pthread.h>
 
+#include <cstdlib>
+#include <deque>
 #include <map>
 #include <string>
 #include <vector>
@@ -16,6 +18,7 @@
 #include "gtest/gtest_prod.h"
 #include "network/download.h"
 #include "network/sink.h"
+#include "util/async.h"
 
 class BackoffThrottle;
 
@@ -57,10 +60,18 @@ class TransactionSink : public Sink {
  * If the object is not in the cache, it is downloaded and stored in the cache.
  *
  * Concurrent download requests for the same id are collapsed.
+ *
+ * FetchAsync() does not occupy the calling thread while the object is being
+ * downloaded.  The download is driven by the download manager's I/O thread.
+ * Committing the object to the cache and calling the callback happen on a
+ * separate completion thread, so that the I/O thread is not blocked by the
+ * cache manager.  A small number of threads can thus keep many downloads in
+ * flight.
  */
-class Fetcher : SingleCopy {
+class Fetcher : SingleCopy, public Callbackable<int> {
   FRIEND_TEST(T_Fetcher, GetTls);
   FRIEND_TEST(T_Fetcher, SignalWaitingThreads);
+  FRIEND_TEST(T_Fetcher, FetchAsyncCollapse);
   friend void *TestGetTls(void *data);
   friend void *TestFetchCollapse(void *data);
   friend void *TestFetchCollapse2(void *data);
@@ -81,6 +92,14 @@ class Fetcher : SingleCopy {
             const CacheManager::ObjectType object_type,
             const std::string &alt_url = "",
             off_t range_offset = -1);
+  void FetchAsync(const shash::Any &id,
+                  const uint64_t size,
+                  const std::string &name,
+                  const zlib::Algorithms compression_algorithm,
+                  const CacheManager::ObjectType object_type,
+                  const CallbackTN *callback,
+                  const std::string &alt_url = "",
+                  off_t range_offset = -1);
 
   CacheManager *cache_mgr() { return cache_mgr_; }
   download::DownloadManager *download_mgr() { return download_mgr_; }
@@ -127,10 +146,60 @@ class Fetcher : SingleCopy {
    */
   typedef std::map< shash::Any, std::vector<int> * > ThreadQueues;
 
+  /**
+   * Callbacks of FetchAsync() calls that piggy-back on a download that is
+   * already in flight, regardless of whether the download was started by
+   * Fetch() or by FetchAsync().
+   */
+  typedef std::map< shash::Any, std::vector<const CallbackTN *> >
+    CallbackQueues;
+
+  /**
+   * State of a download started by FetchAsync().  It plays the role of the
+   * thread local storage and the stack frame of Fetch() and lives until the
+   * download manager reports back.
+   */
+  struct AsyncDownload {
+    AsyncDownload()
+      : txn(NULL)
+      , sink(NULL)
+      , callback(NULL)
+      , download_callback(NULL)
+    { }
+    ~AsyncDownload() {
+      delete download_callback;
+      delete sink;
+      free(txn);
+    }
+
+    shash::Any id;
+    std::string name;
+    std::string url;
+    void *txn;
+    TransactionSink *sink;
+    download::JobInfo download_job;
+    std::vector<int> other_pipes_waiting;
+    /**
+     * Callback of the FetchAsync() call that started the download
+     */
+    const CallbackTN *callback;
+    const CallbackBase<download::JobInfo *> *download_callback;
+  };
+
   ThreadLocalStorage *GetTls();
   void CleanupTls(ThreadLocalStorage *tls);
   void SignalWaitingThreads(const int fd, const shash::Any &id,
-                            ThreadLocalStorage *tls);
+                            std::vector<int> *other_pipes_waiting);
+  int CommitTxn(void *txn);
+  void OnAsyncDownloadDone(download::JobInfo * const &download_job,
+                           AsyncDownload * const download);
+  void FinishAsyncDownload(AsyncDownload *download);
+  void SpawnCompletionThread();
+  static void *MainCompletion(void *data);
+  void InvokeCallback(const int fd, const CallbackTN *callback);
+  std::string GetUrl(const shash::Any &id,
+                     const std::string &name,
+                     const std::string &alt_url);
   int OpenSelect(const shash::Any &id,
                  const std::string &name,
                  const CacheManager::ObjectType object_type);
@@ -148,6 +217,10 @@ class Fetcher : SingleCopy {
   pthread_key_t thread_local_storage_;
 
   ThreadQueues queues_download_;
+  CallbackQueues queues_callbacks_;
+  /**
+   * Protects queues_download_ and queues_callbacks_
+   */
   pthread_mutex_t *lock_queues_download_;
 
   /**
@@ -157,11 +230,24 @@ class Fetcher : SingleCopy {
   std::vector<ThreadLocalStorage *> tls_blocks_;
   pthread_mutex_t *lock_tls_blocks_;
 
+  /**
+   * Downloads of FetchAsync() that the I/O thread finished and that wait for
+   * the completion thread to be committed to the cache.  The completion thread
+   * is started by the first call to FetchAsync().
+   */
+  std::deque<AsyncDownload *> completed_downloads_;
+  pthread_mutex_t lock_completion_;
+  pthread_cond_t cond_completion_;
+  pthread_t thread_completion_;
+  bool completion_spawned_;
+  bool completion_terminate_;
+
   CacheManager *cache_mgr_;
   download::DownloadManager *download_mgr_;
   BackoffThrottle *backoff_throttle_;
   perf::Counter *n_downloads;
   perf::Counter *n_invocations;
+  Log2Histogram *hist_commit;
 };
 
 }  // namespace cvmfs
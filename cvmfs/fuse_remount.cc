@@ -319,6 +319,11 @@ void FuseRemounter::TryFinish(const shash::Any &root_hash) {
   mountpoint_->inode_cache()->Drop();
   mountpoint_->path_cache()->Drop();
   mountpoint_->md5path_cache()->Drop();
+  // Inodes change with the catalog revision, so do negative lookup results
+  if (mountpoint_->negative_lookup_cache() != NULL) {
+    mountpoint_->negative_lookup_cache()->Pause();
+    mountpoint_->negative_lookup_cache()->Drop();
+  }
 
   // Ensure that all Fuse callbacks left the catalog query code
   fence_->Drain();
@@ -338,6 +343,8 @@ void FuseRemounter::TryFinish(const shash::Any &root_hash) {
   mountpoint_->inode_cache()->Resume();
   mountpoint_->path_cache()->Resume();
   mountpoint_->md5path_cache()->Resume();
+  if (mountpoint_->negative_lookup_cache() != NULL)
+    mountpoint_->negative_lookup_cache()->Resume();
 
   atomic_xadd32(&drainout_mode_, -2);  // 2 --> 0, end of drainout mode
 
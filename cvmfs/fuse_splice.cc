@@ -0,0 +1,145 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "cvmfs_config.h"
+#include "fuse_splice.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cassert>
+
+#include "util/concurrency.h"
+
+using namespace std;  // NOLINT
+
+SplicePipes::SplicePipes() {
+  int retval = pthread_mutex_init(&lock_idle_pipes_, NULL);
+  assert(retval == 0);
+}
+
+
+SplicePipes::~SplicePipes() {
+  for (unsigned i = 0; i < idle_pipes_.size(); ++i)
+    Close(&idle_pipes_[i]);
+  pthread_mutex_destroy(&lock_idle_pipes_);
+}
+
+
+/**
+ * Takes an empty pipe from the pool or creates a new one.  The pipe is grown
+ * to hold at least size bytes.  Data that does not start at a page boundary
+ * occupies one more pipe buffer than its size suggests, hence the extra pages.
+ */
+bool SplicePipes::Acquire(size_t size, Pipe *pipe) {
+#ifdef __linux__
+  size += 2 * sysconf(_SC_PAGESIZE);
+  {
+    MutexLockGuard guard(&lock_idle_pipes_);
+    if (!idle_pipes_.empty()) {
+      *pipe = idle_pipes_.back();
+      idle_pipes_.pop_back();
+    }
+  }
+  if (pipe->fd[0] < 0) {
+    if (pipe2(pipe->fd, O_CLOEXEC) != 0) {
+      pipe->fd[0] = pipe->fd[1] = -1;
+      return false;
+    }
+    const int capacity = fcntl(pipe->fd[1], F_GETPIPE_SZ);
+    pipe->capacity = (capacity > 0) ? capacity : 0;
+  }
+  if (pipe->capacity < size) {
+    // May fail beyond /proc/sys/fs/pipe-max-size
+    const int capacity = fcntl(pipe->fd[1], F_SETPIPE_SZ, size);
+    if ((capacity < 0) || (static_cast<size_t>(capacity) < size)) {
+      Close(pipe);
+      return false;
+    }
+    pipe->capacity = capacity;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+/**
+ * Moves up to size bytes at offset of fd into a pipe.  Reads beyond the end of
+ * the file result in fewer bytes or in zero bytes.  On success, the data is
+ * ready to be read from pipe->fd[0] and the pipe needs to be returned with
+ * Release().
+ *
+ * \return the number of bytes in the pipe or -errno.  -ENOBUFS indicates that
+ * no suitable pipe could be provided, which is not an error of the file.
+ */
+int64_t SplicePipes::Splice(int fd, off_t offset, size_t size, Pipe *pipe) {
+#ifdef __linux__
+  if (!Acquire(size, pipe))
+    return -ENOBUFS;
+
+  loff_t off_in = offset;
+  size_t nbytes = 0;
+  while (nbytes < size) {
+    // The pipe is empty and should be large enough.  If it fills up anyway,
+    // the caller has to fall back to copying: a short reply would be taken as
+    // the end of the file.
+    const ssize_t retval = splice(fd, &off_in, pipe->fd[1], NULL,
+                                  size - nbytes,
+                                  SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (retval == 0)
+      break;
+    if (retval < 0) {
+      if (errno == EINTR)
+        continue;
+      const int save_errno = errno;
+      Release(pipe);
+      return (save_errno == EAGAIN) ? -ENOBUFS : -save_errno;
+    }
+    nbytes += retval;
+  }
+  return nbytes;
+#else
+  return -ENOBUFS;
+#endif
+}
+
+
+void SplicePipes::Release(Pipe *pipe) {
+  if (pipe->fd[0] < 0)
+    return;
+
+  int nbytes_buffered = 0;
+  const int retval = ioctl(pipe->fd[0], FIONREAD, &nbytes_buffered);
+  if ((retval != 0) || (nbytes_buffered != 0)) {
+    Close(pipe);
+    return;
+  }
+
+  {
+    MutexLockGuard guard(&lock_idle_pipes_);
+    if (idle_pipes_.size() < kMaxIdlePipes) {
+      idle_pipes_.push_back(*pipe);
+      *pipe = Pipe();
+      return;
+    }
+  }
+  Close(pipe);
+}
+
+
+void SplicePipes::Close(Pipe *pipe) {
+  if (pipe->fd[0] >= 0)
+    close(pipe->fd[0]);
+  if (pipe->fd[1] >= 0)
+    close(pipe->fd[1]);
+  *pipe = Pipe();
+}
@@ -0,0 +1,59 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_FUSE_SPLICE_H_
+#define CVMFS_FUSE_SPLICE_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <vector>
+
+#include "gtest/gtest_prod.h"
+#include "util/single_copy.h"
+
+/**
+ * Provides the pipes for splice reads.  A read moves the requested range of the
+ * cache file into a pipe, from where fuse_reply_data() moves it on into the
+ * fuse device.  Reading the cache file is a separate step so that its errors
+ * reach the caller instead of being replied by libfuse.
+ *
+ * Pipes are taken from a pool for the duration of a read.  A pipe that still
+ * holds data when it is returned, e.g. because the reply failed, is closed
+ * instead of being reused.  Splicing requires Linux; elsewhere no pipe is ever
+ * provided.
+ */
+class SplicePipes : SingleCopy {
+  FRIEND_TEST(T_SplicePipes, Reuse);
+  FRIEND_TEST(T_SplicePipes, DiscardFilled);
+
+ public:
+  struct Pipe {
+    Pipe() : capacity(0) { fd[0] = fd[1] = -1; }
+    int fd[2];
+    unsigned capacity;
+  };
+
+  SplicePipes();
+  ~SplicePipes();
+
+  int64_t Splice(int fd, off_t offset, size_t size, Pipe *pipe);
+  void Release(Pipe *pipe);
+
+ private:
+  /**
+   * Upper bound for the number of idle pipes kept open.  There is at most one
+   * busy pipe per fuse thread.
+   */
+  static const unsigned kMaxIdlePipes = 64;
+
+  bool Acquire(size_t size, Pipe *pipe);
+  static void Close(Pipe *pipe);
+
+  std::vector<Pipe> idle_pipes_;
+  pthread_mutex_t lock_idle_pipes_;
+};
+
+#endif  // CVMFS_FUSE_SPLICE_H_
@@ -24,6 +24,11 @@
  *               hashes found in condemned catalogs and decides if they are
  *               referenced by the preserved catalog revisions or not.
  *
+ * Both stages process catalogs concurrently: the listing of the objects
+ * referenced by a catalog, and the deletion of condemned objects through the
+ * uploader, run in the traversal threads.  Only the updates of the filters and
+ * of the counters are serialized.
+ *
  * The GarbageCollector is templated with CatalogTraversalT mainly for
  * testability and with HashFilterT as an instance of the Strategy Pattern to
  * abstract from the actual hash filtering method to be used.
@@ -33,6 +38,7 @@
 #define CVMFS_GARBAGE_COLLECTION_GARBAGE_COLLECTOR_H_
 
 #include <inttypes.h>
+#include <pthread.h>
 
 #include <vector>
 
@@ -40,6 +46,7 @@
 #include "garbage_collection/hash_filter.h"
 #include "statistics.h"
 #include "upload_facility.h"
+#include "util/concurrency.h"
 
 template<class CatalogTraversalT, class HashFilterT>
 class GarbageCollector {
@@ -89,6 +96,7 @@ class GarbageCollector {
 
  public:
   explicit GarbageCollector(const Configuration &configuration);
+  ~GarbageCollector();
 
   void UseReflogTimestamps();
   bool Collect();
@@ -147,7 +155,11 @@ class GarbageCollector {
   CatalogTraversalT    traversal_;
   HashFilterT          hash_filter_;
   HashFilterT          hash_map_delete_requests_;
-
+  /**
+   * Protects the hash filters and the counters, which are used from the
+   * concurrent traversal callbacks
+   */
+  pthread_mutex_t      lock_;
 
   bool use_reflog_timestamps_;
   /**
@@ -50,6 +50,13 @@ GarbageCollector<CatalogTraversalT, HashFilterT>::GarbageCollector(
   , duplicate_delete_requests_(0)
 {
   assert(configuration_.uploader != NULL);
+  pthread_mutex_init(&lock_, NULL);
+}
+
+
+template <class CatalogTraversalT, class HashFilterT>
+GarbageCollector<CatalogTraversalT, HashFilterT>::~GarbageCollector() {
+  pthread_mutex_destroy(&lock_);
 }
 
 
@@ -73,6 +80,7 @@ typename GarbageCollector<CatalogTraversalT, HashFilterT>::TraversalParameters
   params.ignore_load_failure = true;
   params.quiet               = !config.verbose;
   params.num_threads         = config.num_threads;
+  params.serialize_callbacks = false;
   return params;
 }
 
@@ -82,6 +90,11 @@ void GarbageCollector<CatalogTraversalT, HashFilterT>::PreserveDataObjects(
   const GarbageCollector<CatalogTraversalT, HashFilterT>::
     TraversalCallbackDataTN &data  // NOLINT(runtime/references)
 ) {
+  // Listing the referenced objects is the expensive part, it runs concurrently
+  // for different catalogs
+  const HashVector &referenced_hashes = data.catalog->GetReferencedObjects();
+
+  MutexLockGuard m(&lock_);
   ++preserved_catalogs_;
 
   if (data.catalog->IsRoot()) {
@@ -111,7 +124,6 @@ void GarbageCollector<CatalogTraversalT, HashFilterT>::PreserveDataObjects(
   hash_filter_.Fill(data.catalog->hash());
 
   // all the objects referenced from this catalog need to be preserved
-  const HashVector &referenced_hashes = data.catalog->GetReferencedObjects();
         typename HashVector::const_iterator i    = referenced_hashes.begin();
   const typename HashVector::const_iterator iend = referenced_hashes.end();
   for (; i != iend; ++i) {
@@ -125,23 +137,28 @@ void GarbageCollector<CatalogTraversalT, HashFilterT>::SweepDataObjects(
   const GarbageCollector<CatalogTraversalT, HashFilterT>::
     TraversalCallbackDataTN &data  // NOLINT(runtime/references)
 ) {
-  ++condemned_catalogs_;
-  if (data.catalog->IsRoot())
-    ++condemned_trees_;
+  const HashVector &referenced_hashes = data.catalog->GetReferencedObjects();
 
-  if (configuration_.verbose) {
-    if (data.catalog->IsRoot()) {
-      const int    rev   = data.catalog->revision();
-      const time_t mtime = static_cast<time_t>(data.catalog->GetLastModified());
-      LogCvmfs(kLogGc, kLogStdout | kLogDebug, "Sweeping Revision %d (%s)",
-               rev, StringifyTime(mtime, true).c_str());
+  {
+    MutexLockGuard m(&lock_);
+    ++condemned_catalogs_;
+    if (data.catalog->IsRoot())
+      ++condemned_trees_;
+
+    if (configuration_.verbose) {
+      if (data.catalog->IsRoot()) {
+        const int    rev   = data.catalog->revision();
+        const time_t mtime =
+          static_cast<time_t>(data.catalog->GetLastModified());
+        LogCvmfs(kLogGc, kLogStdout | kLogDebug, "Sweeping Revision %d (%s)",
+                 rev, StringifyTime(mtime, true).c_str());
+      }
+      PrintCatalogTreeEntry(data.tree_level, data.catalog);
     }
-    PrintCatalogTreeEntry(data.tree_level, data.catalog);
   }
 
   // all the objects referenced from this catalog need to be checked against the
   // the preserved hashes in the hash_filter_ and possibly deleted
-  const HashVector &referenced_hashes = data.catalog->GetReferencedObjects();
         typename HashVector::const_iterator i    = referenced_hashes.begin();
   const typename HashVector::const_iterator iend = referenced_hashes.end();
   for (; i != iend; ++i) {
@@ -151,6 +168,7 @@ void GarbageCollector<CatalogTraversalT, HashFilterT>::SweepDataObjects(
   // the catalog itself is also condemned and needs to be removed
   CheckAndSweep(data.catalog->hash());
 
+  MutexLockGuard m(&lock_);
   float threshold =
     static_cast<float>(condemned_trees_) /
     static_cast<float>(unreferenced_trees_);
@@ -168,27 +186,33 @@ template <class CatalogTraversalT, class HashFilterT>
 void GarbageCollector<CatalogTraversalT, HashFilterT>::CheckAndSweep(
   const shash::Any &hash)
 {
-  if (!hash_filter_.Contains(hash)) {
-    if (!hash_map_delete_requests_.Contains(hash)) {
-      hash_map_delete_requests_.Fill(hash);
-      Sweep(hash);
-    } else {
+  // The preserved hashes are frozen at this point and can be read concurrently
+  if (hash_filter_.Contains(hash))
+    return;
+
+  {
+    MutexLockGuard m(&lock_);
+    if (hash_map_delete_requests_.Contains(hash)) {
       ++duplicate_delete_requests_;
       LogCvmfs(kLogGc, kLogDebug, "Hash %s already marked as to delete",
                hash.ToString().c_str());
+      return;
     }
+    hash_map_delete_requests_.Fill(hash);
+    ++condemned_objects_;
   }
+  Sweep(hash);
 }
 
 
 template <class CatalogTraversalT, class HashFilterT>
 void GarbageCollector<CatalogTraversalT, HashFilterT>::Sweep(
                                                        const shash::Any &hash) {
-  ++condemned_objects_;
   if (configuration_.extended_stats) {
     if (!hash.HasSuffix() || hash.suffix == shash::kSuffixPartial) {
       int64_t condemned_bytes = configuration_.uploader->GetObjectSize(hash);
       if (condemned_bytes > 0) {
+        MutexLockGuard m(&lock_);
         condemned_bytes_ += condemned_bytes;
       }
     }
@@ -199,6 +223,8 @@ void GarbageCollector<CatalogTraversalT, HashFilterT>::Sweep(
     return;
   }
 
+  // Runs concurrently in the traversal threads; the number of pending
+  // deletions is bounded by the uploader
   configuration_.uploader->RemoveAsync(hash);
 }
 
@@ -242,6 +268,7 @@ bool GarbageCollector<CatalogTraversalT, HashFilterT>::
   oldest_trunk_catalog_found_ = true;
   success = success && traversal_.TraverseNamedSnapshots();
   traversal_.UnregisterListener(callback);
+  hash_filter_.Freeze();
 
   return success;
 }
@@ -9,7 +9,12 @@
 #ifndef CVMFS_GARBAGE_COLLECTION_HASH_FILTER_H_
 #define CVMFS_GARBAGE_COLLECTION_HASH_FILTER_H_
 
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstring>
 #include <set>
+#include <vector>
 
 #include "crypto/hash.h"
 #include "smallhash.h"
@@ -119,9 +124,191 @@ class SmallhashFilter : public AbstractHashFilter {
   void   Freeze()      { frozen_ = true;         }
   size_t Count() const { return hashmap_.size(); }
 
+  uint64_t bytes_allocated() const { return hashmap_.bytes_allocated(); }
+
  private:
   SmallHashDynamic<shash::Any, bool>  hashmap_;
   bool                                frozen_;
 };
 
+
+//------------------------------------------------------------------------------
+
+
+/**
+ * This is a memory efficient implementation of AbstractHashFilter for very
+ * large sets, e.g. all the objects of a repository with hundreds of millions
+ * of files.  Instead of the full hash, it stores a 64bit fingerprint, i.e. 8
+ * bytes per entry.  New fingerprints are collected in a small hash table that
+ * is merged into a sorted vector whenever it grows too large.  An index over
+ * the top bits of the fingerprints narrows the search in the sorted vector
+ * down to a few cache lines.  Queries look into both the hash table and the
+ * sorted vector and remain valid while the filter is being filled.
+ *
+ * Fingerprint collisions can only cause false positives, i.e. an unreferenced
+ * object might be kept but a referenced object is never reported as missing.
+ */
+class CompactHashFilter : public AbstractHashFilter {
+ protected:
+  static const uint64_t kEmptyFingerprint = 0;
+
+  static uint64_t Fingerprint(const shash::Any &hash) {
+    uint64_t fingerprint;
+    memcpy(&fingerprint, hash.digest, sizeof(fingerprint));
+    // Equal digests of different algorithms must not be mixed up
+    fingerprint ^= static_cast<uint64_t>(hash.algorithm) << 56;
+    return (fingerprint == kEmptyFingerprint) ? 1 : fingerprint;
+  }
+
+  static uint32_t hasher(const uint64_t &key) {
+    return static_cast<uint32_t>(key);
+  }
+
+  /**
+   * Average number of fingerprints per bucket of the index
+   */
+  static const unsigned kBucketSize = 16;
+
+ public:
+  /**
+   * The new fingerprints are merged once there are at least min_tail_size of
+   * them and at least an eighth of the already merged ones
+   */
+  static const unsigned kDefaultMinTailSize = 1024 * 1024;
+
+  explicit CompactHashFilter(
+    const unsigned min_tail_size = kDefaultMinTailSize)
+    : min_tail_size_(min_tail_size)
+    , index_bits_(0)
+    , frozen_(false)
+  {
+    tail_.Init(min_tail_size_, kEmptyFingerprint, &CompactHashFilter::hasher);
+    BuildIndex();
+  }
+
+  void Fill(const shash::Any &hash) {
+    assert(!frozen_);
+    tail_.Insert(Fingerprint(hash), true);
+    if ((tail_.size() >= min_tail_size_) &&
+        (tail_.size() >= sorted_.size() / 8))
+    {
+      Merge();
+    }
+  }
+
+  bool Contains(const shash::Any &hash) const {
+    const uint64_t fingerprint = Fingerprint(hash);
+    return tail_.Contains(fingerprint) || ContainsSorted(fingerprint);
+  }
+
+  /**
+   * No more fingerprints are added, so the sorted vector and its index give up
+   * their spare capacity (C++03 equivalent of shrink_to_fit).  As Merge() grows
+   * the sorted vector exactly, it normally has none and is not copied.
+   */
+  void Freeze() {
+    Merge();
+    if (sorted_.capacity() > sorted_.size())
+      std::vector<uint64_t>(sorted_).swap(sorted_);
+    if (index_.capacity() > index_.size())
+      std::vector<size_t>(index_).swap(index_);
+    frozen_ = true;
+  }
+
+  size_t Count() const {
+    size_t result = sorted_.size();
+    const uint64_t *keys = tail_.keys();
+    for (uint32_t i = 0; i < tail_.capacity(); ++i) {
+      if ((keys[i] != kEmptyFingerprint) && !ContainsSorted(keys[i])) {
+        ++result;
+      }
+    }
+    return result;
+  }
+
+  uint64_t bytes_allocated() const {
+    return sorted_.capacity() * sizeof(uint64_t) +
+           index_.capacity() * sizeof(size_t) +
+           tail_.bytes_allocated();
+  }
+
+ private:
+  uint64_t Bucket(const uint64_t fingerprint) const {
+    return (index_bits_ == 0) ? 0 : (fingerprint >> (64 - index_bits_));
+  }
+
+  bool ContainsSorted(const uint64_t fingerprint) const {
+    const uint64_t bucket = Bucket(fingerprint);
+    return std::binary_search(sorted_.begin() + index_[bucket],
+                              sorted_.begin() + index_[bucket + 1],
+                              fingerprint);
+  }
+
+  /**
+   * index_[b] is the position of the first fingerprint in sorted_ that falls
+   * into bucket b
+   */
+  void BuildIndex() {
+    index_bits_ = 0;
+    while ((index_bits_ < 32) &&
+           ((uint64_t(kBucketSize) << (index_bits_ + 1)) <= sorted_.size()))
+    {
+      ++index_bits_;
+    }
+    const uint64_t num_buckets = uint64_t(1) << index_bits_;
+    index_.resize(num_buckets + 1);
+    size_t pos = 0;
+    for (uint64_t b = 0; b < num_buckets; ++b) {
+      index_[b] = pos;
+      while ((pos < sorted_.size()) && (Bucket(sorted_[pos]) == b))
+        ++pos;
+    }
+    index_[num_buckets] = sorted_.size();
+  }
+
+  /**
+   * Moves the new fingerprints into the sorted vector.  The merge runs from the
+   * back, so that no second copy of the sorted vector is needed.  Fingerprints
+   * that are already sorted are dropped beforehand, so that the sorted vector
+   * grows by exactly the number of new ones.
+   */
+  void Merge() {
+    if (tail_.size() == 0)
+      return;
+    std::vector<uint64_t> tail;
+    tail.reserve(tail_.size());
+    const uint64_t *keys = tail_.keys();
+    for (uint32_t i = 0; i < tail_.capacity(); ++i) {
+      if ((keys[i] != kEmptyFingerprint) && !ContainsSorted(keys[i]))
+        tail.push_back(keys[i]);
+    }
+    tail_.Clear();
+    if (tail.empty())
+      return;
+    std::sort(tail.begin(), tail.end());
+
+    size_t i = sorted_.size();
+    size_t j = tail.size();
+    // Growing by resize() alone could double the capacity
+    sorted_.reserve(i + j);
+    sorted_.resize(i + j);
+    size_t k = sorted_.size();
+    while (j > 0) {
+      if ((i > 0) && (sorted_[i - 1] > tail[j - 1])) {
+        sorted_[--k] = sorted_[--i];
+      } else {
+        sorted_[--k] = tail[--j];
+      }
+    }
+    BuildIndex();
+  }
+
+  SmallHashDynamic<uint64_t, bool>  tail_;
+  std::vector<uint64_t>             sorted_;
+  std::vector<size_t>               index_;
+  unsigned                          min_tail_size_;
+  unsigned                          index_bits_;
+  bool                              frozen_;
+};
+
 #endif  // CVMFS_GARBAGE_COLLECTION_HASH_FILTER_H_
@@ -62,33 +62,41 @@ void PathStore::CopyFrom(const PathStore &other) {
 //------------------------------------------------------------------------------
 
 
-void InodeTracker::InitLock() {
-  lock_ =
-    reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
-  int retval = pthread_mutex_init(lock_, NULL);
-  assert(retval == 0);
+void InodeTracker::InitLocks() {
+  inode_locks_ = reinterpret_cast<StripeLock *>(
+    smalloc(kNumStripes * sizeof(StripeLock)));
+  path_locks_ = reinterpret_cast<StripeLock *>(
+    smalloc(kNumStripes * sizeof(StripeLock)));
+  for (unsigned i = 0; i < kNumStripes; ++i) {
+    int retval = pthread_mutex_init(&inode_locks_[i].mutex, NULL);
+    assert(retval == 0);
+    retval = pthread_mutex_init(&path_locks_[i].mutex, NULL);
+    assert(retval == 0);
+  }
 }
 
 
 void InodeTracker::CopyFrom(const InodeTracker &other) {
   assert(other.version_ == kVersion);
   version_ = kVersion;
-  path_map_ = other.path_map_;
-  inode_ex_map_ = other.inode_ex_map_;
-  inode_references_ = other.inode_references_;
+  for (unsigned i = 0; i < kNumStripes; ++i) {
+    inode_stripes_[i].inode_ex_map = other.inode_stripes_[i].inode_ex_map;
+    inode_stripes_[i].references = other.inode_stripes_[i].references;
+    path_stripes_[i] = other.path_stripes_[i];
+  }
   statistics_ = other.statistics_;
 }
 
 
 InodeTracker::InodeTracker() {
   version_ = kVersion;
-  InitLock();
+  InitLocks();
 }
 
 
 InodeTracker::InodeTracker(const InodeTracker &other) {
   CopyFrom(other);
-  InitLock();
+  InitLocks();
 }
 
 
@@ -102,8 +110,12 @@ InodeTracker &InodeTracker::operator= (const InodeTracker &other) {
 
 
 InodeTracker::~InodeTracker() {
-  pthread_mutex_destroy(lock_);
-  free(lock_);
+  for (unsigned i = 0; i < kNumStripes; ++i) {
+    pthread_mutex_destroy(&inode_locks_[i].mutex);
+    pthread_mutex_destroy(&path_locks_[i].mutex);
+  }
+  free(inode_locks_);
+  free(path_locks_);
 }
 
 
@@ -112,7 +124,7 @@ InodeTracker::~InodeTracker() {
 DentryTracker::DentryTracker() : version_(kVersion), is_active_(true) {
   pipe_terminate_[0] = pipe_terminate_[1] = -1;
   cleaning_interval_ms_ = -1;
-  InitLock();
+  InitLocks();
 }
 
 
@@ -123,8 +135,9 @@ DentryTracker::~DentryTracker() {
     pthread_join(thread_cleaner_, NULL);
     ClosePipe(pipe_terminate_);
   }
-  pthread_mutex_destroy(lock_);
-  free(lock_);
+  for (unsigned i = 0; i < kNumStripes; ++i)
+    pthread_mutex_destroy(&locks_[i].mutex);
+  free(locks_);
 }
 
 
@@ -132,7 +145,7 @@ DentryTracker::DentryTracker(const DentryTracker &other) {
   CopyFrom(other);
   pipe_terminate_[0] = pipe_terminate_[1] = -1;
   cleaning_interval_ms_ = -1;
-  InitLock();
+  InitLocks();
 }
 
 
@@ -140,9 +153,9 @@ DentryTracker &DentryTracker::operator= (const DentryTracker &other) {
   if (&other == this)
     return *this;
 
-  Lock();
+  LockAll();
   CopyFrom(other);
-  Unlock();
+  UnlockAll();
   return *this;
 }
 
@@ -151,22 +164,37 @@ void DentryTracker::CopyFrom(const DentryTracker &other) {
   assert(other.version_ == kVersion);
 
   version_ = kVersion;
-  statistics_ = other.statistics_;
   is_active_ = other.is_active_;
-  entries_ = other.entries_;
+  for (unsigned i = 0; i < kNumStripes; ++i) {
+    stripes_[i].entries = other.stripes_[i].entries;
+    stripes_[i].statistics = other.stripes_[i].statistics;
+  }
 }
 
 
 DentryTracker *DentryTracker::Move() {
-  Lock();
+  LockAll();
   DentryTracker *new_tracker = new DentryTracker(*this);
-  statistics_.num_remove += entries_.size();
-  entries_.Clear();
-  Unlock();
+  for (unsigned i = 0; i < kNumStripes; ++i) {
+    stripes_[i].statistics.num_remove += stripes_[i].entries.size();
+    stripes_[i].entries.Clear();
+  }
+  UnlockAll();
   return new_tracker;
 }
 
 
+DentryTracker::Statistics DentryTracker::GetStatistics() {
+  Statistics result;
+  for (unsigned i = 0; i < kNumStripes; ++i) {
+    result.num_insert += stripes_[i].statistics.num_insert;
+    result.num_remove += stripes_[i].statistics.num_remove;
+    result.num_prune += stripes_[i].statistics.num_prune;
+  }
+  return result;
+}
+
+
 void DentryTracker::SpawnCleaner(unsigned interval_s) {
   assert(pipe_terminate_[0] == -1);
   cleaning_interval_ms_ = interval_s * 1000;
@@ -220,46 +248,49 @@ void *DentryTracker::MainCleaner(void *data) {
 }
 
 
-void DentryTracker::InitLock() {
-  lock_ =
-    reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
-  int retval = pthread_mutex_init(lock_, NULL);
-  assert(retval == 0);
+void DentryTracker::InitLocks() {
+  locks_ = reinterpret_cast<StripeLock *>(
+    smalloc(kNumStripes * sizeof(StripeLock)));
+  for (unsigned i = 0; i < kNumStripes; ++i) {
+    int retval = pthread_mutex_init(&locks_[i].mutex, NULL);
+    assert(retval == 0);
+  }
 }
 
 
 void DentryTracker::Prune() {
-  Lock();
   DoPrune(platform_monotonic_time());
-  Unlock();
 }
 
 
 DentryTracker::Cursor DentryTracker::BeginEnumerate() {
-  Entry *head = NULL;
-  Lock();
-  entries_.Peek(&head);
-  return Cursor(head);
+  LockAll();
+  return Cursor();
 }
 
 
 bool DentryTracker::NextEntry(Cursor *cursor,
   uint64_t *inode_parent, NameString *name)
 {
-  if (cursor->head == NULL)
-    return false;
-  if (cursor->pos >= entries_.size())
-    return false;
-  Entry *e = cursor->head + cursor->pos;
-  *inode_parent = e->inode_parent;
-  *name = e->name;
-  cursor->pos++;
-  return true;
+  while (cursor->stripe < kNumStripes) {
+    BigQueue<Entry> *entries = &stripes_[cursor->stripe].entries;
+    Entry *head = NULL;
+    if ((cursor->pos < entries->size()) && entries->Peek(&head)) {
+      Entry *e = head + cursor->pos;
+      *inode_parent = e->inode_parent;
+      *name = e->name;
+      cursor->pos++;
+      return true;
+    }
+    cursor->stripe++;
+    cursor->pos = 0;
+  }
+  return false;
 }
 
 
 void DentryTracker::EndEnumerate(Cursor * /* cursor */) {
-  Unlock();
+  UnlockAll();
 }
 
 
@@ -13,6 +13,7 @@
 #include <sched.h>
 #include <stdint.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <map>
@@ -336,13 +337,16 @@ class PathStore {
     return Cursor();
   }
 
-  bool Next(Cursor *cursor, shash::Md5 *parent, StringRef *name) {
+  bool Next(Cursor *cursor, shash::Md5 *md5path, shash::Md5 *parent,
+            StringRef *name)
+  {
     shash::Md5 empty_key = map_.empty_key();
     while (cursor->idx < map_.capacity()) {
       if (map_.keys()[cursor->idx] == empty_key) {
         cursor->idx++;
         continue;
       }
+      *md5path = map_.keys()[cursor->idx];
       *parent = map_.values()[cursor->idx].parent;
       *name = map_.values()[cursor->idx].name;
       cursor->idx++;
@@ -435,11 +439,17 @@ class PathMap {
 
   shash::Md5 Insert(const PathString &path, const uint64_t inode) {
     shash::Md5 md5path(path.GetChars(), path.GetLength());
+    Insert(md5path, path, inode);
+    return md5path;
+  }
+
+  void Insert(const shash::Md5 &md5path, const PathString &path,
+              const uint64_t inode)
+  {
     if (!map_.Contains(md5path)) {
       path_store_.Insert(md5path, path);
       map_.Insert(md5path, inode);
     }
-    return md5path;
   }
 
   void Erase(const shash::Md5 &md5path) {
@@ -546,9 +556,15 @@ class InodeReferences {
     return false;
   }
 
-  void Replace(const uint64_t old_inode, const uint64_t new_inode) {
-    map_.Erase(old_inode);
-    map_.Insert(new_inode, 0);
+  /**
+   * Used by InodeTracker::ReplaceInode(), the old and the new inode can be
+   * in different stripes.  The new inode has reference counter 0.
+   */
+  void Erase(const uint64_t inode) {
+    map_.Erase(inode);
+  }
+  void InsertUnreferenced(const uint64_t inode) {
+    map_.Insert(inode, 0);
   }
 
   void Clear() {
@@ -581,52 +597,62 @@ class InodeReferences {
 //------------------------------------------------------------------------------
 
 
+/**
+ * A mutex that does not share a cache line with its neighbors in an array of
+ * locks.  Used for the stripes of the inode and the dentry tracker.
+ */
+struct StripeLock {
+  pthread_mutex_t mutex;
+  char padding[128 - sizeof(pthread_mutex_t)];
+};
+
+
+//------------------------------------------------------------------------------
+
+
 /**
  * Tracks inode reference counters as given by Fuse.
+ *
+ * In order to not serialize all lookup and forget calls on a single mutex,
+ * the tracker is split in stripes.  Inode references and the inode --> path
+ * map are striped by inode, the path --> inode map is striped by the md5 hash
+ * of the path.  Every stripe has its own lock.  Operations that need both,
+ * an inode stripe and a path stripe, always lock the inode stripe first.  No
+ * operation holds more than one path stripe lock except for the enumeration,
+ * which locks all stripes in order.
+ *
+ * The parent directories of a path are stored in the path stripe of the path.
+ * Directories can therefore be stored in multiple path stripes; they are only
+ * enumerated from the stripe that owns their md5 path hash.
  */
 class InodeTracker {
  public:
+  static const unsigned kNumStripes = 16;
+
   /**
    * Used to actively evict all known paths from kernel caches
    */
   struct Cursor {
-    explicit Cursor(
-      const PathStore::Cursor &p,
-      const InodeReferences::Cursor &i)
-      : csr_paths(p)
-      , csr_inos(i)
-    { }
+    Cursor() : stripe_paths(0), stripe_inos(0) { }
+    unsigned stripe_paths;
+    unsigned stripe_inos;
     PathStore::Cursor csr_paths;
     InodeReferences::Cursor csr_inos;
   };
 
   /**
-   * To avoid taking the InodeTracker mutex multiple times, the fuse
-   * forget_multi callback releases inodes references through this RAII object.
+   * The fuse forget_multi callback releases inodes references through this
+   * object.  It used to hold the global InodeTracker lock; as of the striped
+   * tracker, every VfsPut() only locks the stripes of the given inode.
    * Copy and assign operator should be deleted but that would require
    * all compilers to use RVO. TODO(jblomer): fix with C++11
    */
   class VfsPutRaii {
    public:
-    explicit VfsPutRaii(InodeTracker *t) : tracker_(t) {
-      tracker_->Lock();
-    }
-    ~VfsPutRaii() { tracker_->Unlock(); }
+    explicit VfsPutRaii(InodeTracker *t) : tracker_(t) { }
 
     bool VfsPut(const uint64_t inode, const uint32_t by) {
-      bool removed = tracker_->inode_references_.Put(inode, by);
-      if (removed) {
-        // TODO(jblomer): pop operation (Lookup+Erase)
-        shash::Md5 md5path;
-        InodeEx inode_ex(inode, InodeEx::kUnknownType);
-        bool found = tracker_->inode_ex_map_.LookupMd5Path(&inode_ex, &md5path);
-        assert(found);
-        tracker_->inode_ex_map_.Erase(inode);
-        tracker_->path_map_.Erase(md5path);
-        atomic_inc64(&tracker_->statistics_.num_removes);
-      }
-      atomic_xadd64(&tracker_->statistics_.num_references, -int32_t(by));
-      return removed;
+      return tracker_->DoVfsPut(inode, by);
     }
 
    private:
@@ -671,11 +697,16 @@ class InodeTracker {
                 const PathString &path)
   {
     uint64_t inode = inode_ex.GetInode();
-    Lock();
-    bool is_new_inode = inode_references_.Get(inode, by);
-    shash::Md5 md5path = path_map_.Insert(path, inode);
-    inode_ex_map_.Insert(inode_ex, md5path);
-    Unlock();
+    shash::Md5 md5path(path.GetChars(), path.GetLength());
+    const unsigned idx_inode = GetInodeStripe(inode);
+    const unsigned idx_path = GetPathStripe(md5path);
+    LockInodes(idx_inode);
+    LockPaths(idx_path);
+    bool is_new_inode = inode_stripes_[idx_inode].references.Get(inode, by);
+    path_stripes_[idx_path].Insert(md5path, path, inode);
+    inode_stripes_[idx_inode].inode_ex_map.Insert(inode_ex, md5path);
+    UnlockPaths(idx_path);
+    UnlockInodes(idx_inode);
 
     atomic_xadd64(&statistics_.num_references, by);
     if (is_new_inode) atomic_inc64(&statistics_.num_inserts);
@@ -688,14 +719,19 @@ class InodeTracker {
   VfsPutRaii GetVfsPutRaii() { return VfsPutRaii(this); }
 
   bool FindPath(InodeEx *inode_ex, PathString *path) {
-    Lock();
+    const unsigned idx_inode = GetInodeStripe(inode_ex->GetInode());
+    LockInodes(idx_inode);
     shash::Md5 md5path;
-    bool found = inode_ex_map_.LookupMd5Path(inode_ex, &md5path);
+    bool found =
+      inode_stripes_[idx_inode].inode_ex_map.LookupMd5Path(inode_ex, &md5path);
     if (found) {
-      found = path_map_.LookupPath(md5path, path);
+      const unsigned idx_path = GetPathStripe(md5path);
+      LockPaths(idx_path);
+      found = path_stripes_[idx_path].LookupPath(md5path, path);
+      UnlockPaths(idx_path);
       assert(found);
     }
-    Unlock();
+    UnlockInodes(idx_inode);
 
     if (found) {
       atomic_inc64(&statistics_.num_hits_path);
@@ -706,9 +742,11 @@ class InodeTracker {
   }
 
   uint64_t FindInode(const PathString &path) {
-    Lock();
-    uint64_t inode = path_map_.LookupInodeByPath(path);
-    Unlock();
+    shash::Md5 md5path(path.GetChars(), path.GetLength());
+    const unsigned idx_path = GetPathStripe(md5path);
+    LockPaths(idx_path);
+    uint64_t inode = path_stripes_[idx_path].LookupInodeByMd5Path(md5path);
+    UnlockPaths(idx_path);
     atomic_inc64(&statistics_.num_hits_inode);
     return inode;
   }
@@ -718,16 +756,25 @@ class InodeTracker {
     InodeEx inodex(ino, InodeEx::kUnknownType);
     shash::Md5 md5path;
 
-    Lock();
-    bool found = inode_ex_map_.LookupMd5Path(&inodex, &md5path);
+    const unsigned idx_inode = GetInodeStripe(ino);
+    LockInodes(idx_inode);
+    bool found =
+      inode_stripes_[idx_inode].inode_ex_map.LookupMd5Path(&inodex, &md5path);
     if (found) {
-      found = path_map_.LookupPath(md5path, &path);
+      unsigned idx_path = GetPathStripe(md5path);
+      LockPaths(idx_path);
+      found = path_stripes_[idx_path].LookupPath(md5path, &path);
+      UnlockPaths(idx_path);
       assert(found);
       *name = GetFileName(path);
       path = GetParentPath(path);
-      *parent_ino = path_map_.LookupInodeByPath(path);
+      md5path = shash::Md5(path.GetChars(), path.GetLength());
+      idx_path = GetPathStripe(md5path);
+      LockPaths(idx_path);
+      *parent_ino = path_stripes_[idx_path].LookupInodeByMd5Path(md5path);
+      UnlockPaths(idx_path);
     }
-    Unlock();
+    UnlockInodes(idx_inode);
     return found;
   }
 
@@ -738,66 +785,156 @@ class InodeTracker {
   bool ReplaceInode(uint64_t old_inode, const InodeEx &new_inode) {
     shash::Md5 md5path;
     InodeEx old_inode_ex(old_inode, InodeEx::kUnknownType);
-    Lock();
-    bool found = inode_ex_map_.LookupMd5Path(&old_inode_ex, &md5path);
+    const unsigned idx_old = GetInodeStripe(old_inode);
+    const unsigned idx_new = GetInodeStripe(new_inode.GetInode());
+    // Inode stripes are locked in ascending order
+    LockInodes(std::min(idx_old, idx_new));
+    if (idx_old != idx_new)
+      LockInodes(std::max(idx_old, idx_new));
+    bool found =
+      inode_stripes_[idx_old].inode_ex_map.LookupMd5Path(&old_inode_ex,
+                                                         &md5path);
     if (found) {
-      inode_references_.Replace(old_inode, new_inode.GetInode());
-      path_map_.Replace(md5path, new_inode.GetInode());
-      inode_ex_map_.Erase(old_inode);
-      inode_ex_map_.Insert(new_inode, md5path);
+      const unsigned idx_path = GetPathStripe(md5path);
+      LockPaths(idx_path);
+      path_stripes_[idx_path].Replace(md5path, new_inode.GetInode());
+      UnlockPaths(idx_path);
+      inode_stripes_[idx_old].references.Erase(old_inode);
+      inode_stripes_[idx_new].references.InsertUnreferenced(
+        new_inode.GetInode());
+      inode_stripes_[idx_old].inode_ex_map.Erase(old_inode);
+      inode_stripes_[idx_new].inode_ex_map.Insert(new_inode, md5path);
     }
-    Unlock();
+    if (idx_old != idx_new)
+      UnlockInodes(std::max(idx_old, idx_new));
+    UnlockInodes(std::min(idx_old, idx_new));
     return found;
   }
 
+  /**
+   * Locks all stripes until EndEnumerate()
+   */
   Cursor BeginEnumerate() {
-    Lock();
-    return Cursor(path_map_.path_store()->BeginEnumerate(),
-                  inode_references_.BeginEnumerate());
+    for (unsigned i = 0; i < kNumStripes; ++i)
+      LockInodes(i);
+    for (unsigned i = 0; i < kNumStripes; ++i)
+      LockPaths(i);
+    return Cursor();
   }
 
   bool NextEntry(Cursor *cursor, uint64_t *inode_parent, NameString *name) {
+    shash::Md5 md5path;
     shash::Md5 parent_md5;
     StringRef name_ref;
-    bool result = path_map_.path_store()->Next(
-      &(cursor->csr_paths), &parent_md5, &name_ref);
-    if (!result)
-      return false;
-    if (parent_md5.IsNull())
-      *inode_parent = 0;
-    else
-      *inode_parent = path_map_.LookupInodeByMd5Path(parent_md5);
-    name->Assign(name_ref.data(), name_ref.length());
-    return true;
+    while (cursor->stripe_paths < kNumStripes) {
+      bool result = path_stripes_[cursor->stripe_paths].path_store()->Next(
+        &(cursor->csr_paths), &md5path, &parent_md5, &name_ref);
+      if (!result) {
+        cursor->stripe_paths++;
+        cursor->csr_paths = PathStore::Cursor();
+        continue;
+      }
+      // A parent directory replicated from another stripe
+      if (GetPathStripe(md5path) != cursor->stripe_paths)
+        continue;
+
+      if (parent_md5.IsNull()) {
+        *inode_parent = 0;
+      } else {
+        *inode_parent = path_stripes_[GetPathStripe(parent_md5)]
+                          .LookupInodeByMd5Path(parent_md5);
+      }
+      name->Assign(name_ref.data(), name_ref.length());
+      return true;
+    }
+    return false;
   }
 
   bool NextInode(Cursor *cursor, uint64_t *inode) {
-    return inode_references_.Next(&(cursor->csr_inos), inode);
+    while (cursor->stripe_inos < kNumStripes) {
+      if (inode_stripes_[cursor->stripe_inos].references.Next(
+            &(cursor->csr_inos), inode))
+      {
+        return true;
+      }
+      cursor->stripe_inos++;
+      cursor->csr_inos = InodeReferences::Cursor();
+    }
+    return false;
   }
 
   void EndEnumerate(Cursor *cursor) {
-    Unlock();
+    for (unsigned i = kNumStripes; i > 0; --i)
+      UnlockPaths(i - 1);
+    for (unsigned i = kNumStripes; i > 0; --i)
+      UnlockInodes(i - 1);
   }
 
  private:
-  static const unsigned kVersion = 4;
+  static const unsigned kVersion = 5;
 
-  void InitLock();
+  struct InodeStripe {
+    InodeExMap inode_ex_map;
+    InodeReferences references;
+  };
+
+  static inline unsigned GetInodeStripe(const uint64_t inode) {
+    return inode % kNumStripes;
+  }
+  static inline unsigned GetPathStripe(const shash::Md5 &md5path) {
+    // hasher_md5 uses bytes 4-7 of the digest, use the last byte instead
+    return md5path.digest[shash::kDigestSizes[shash::kMd5] - 1] % kNumStripes;
+  }
+
+  bool DoVfsPut(const uint64_t inode, const uint32_t by) {
+    const unsigned idx_inode = GetInodeStripe(inode);
+    InodeStripe *stripe = &inode_stripes_[idx_inode];
+    LockInodes(idx_inode);
+    bool removed = stripe->references.Put(inode, by);
+    if (removed) {
+      // TODO(jblomer): pop operation (Lookup+Erase)
+      shash::Md5 md5path;
+      InodeEx inode_ex(inode, InodeEx::kUnknownType);
+      bool found = stripe->inode_ex_map.LookupMd5Path(&inode_ex, &md5path);
+      assert(found);
+      stripe->inode_ex_map.Erase(inode);
+      const unsigned idx_path = GetPathStripe(md5path);
+      LockPaths(idx_path);
+      path_stripes_[idx_path].Erase(md5path);
+      UnlockPaths(idx_path);
+    }
+    UnlockInodes(idx_inode);
+
+    if (removed)
+      atomic_inc64(&statistics_.num_removes);
+    atomic_xadd64(&statistics_.num_references, -int32_t(by));
+    return removed;
+  }
+
+  void InitLocks();
   void CopyFrom(const InodeTracker &other);
-  inline void Lock() const {
-    int retval = pthread_mutex_lock(lock_);
+  inline void LockInodes(const unsigned idx) const {
+    int retval = pthread_mutex_lock(&inode_locks_[idx].mutex);
+    assert(retval == 0);
+  }
+  inline void UnlockInodes(const unsigned idx) const {
+    int retval = pthread_mutex_unlock(&inode_locks_[idx].mutex);
     assert(retval == 0);
   }
-  inline void Unlock() const {
-    int retval = pthread_mutex_unlock(lock_);
+  inline void LockPaths(const unsigned idx) const {
+    int retval = pthread_mutex_lock(&path_locks_[idx].mutex);
+    assert(retval == 0);
+  }
+  inline void UnlockPaths(const unsigned idx) const {
+    int retval = pthread_mutex_unlock(&path_locks_[idx].mutex);
     assert(retval == 0);
   }
 
   unsigned version_;
-  pthread_mutex_t *lock_;
-  PathMap path_map_;
-  InodeExMap inode_ex_map_;
-  InodeReferences inode_references_;
+  StripeLock *inode_locks_;
+  StripeLock *path_locks_;
+  InodeStripe inode_stripes_[kNumStripes];
+  PathMap path_stripes_[kNumStripes];
   Statistics statistics_;
 };  // class InodeTracker
 
@@ -805,6 +942,9 @@ class InodeTracker {
 /**
  * Tracks fuse name lookup replies for active cache eviction.
  * Class renamed from previous name NentryTracker
+ *
+ * Entries are queued in stripes by parent inode.  Every stripe has its own
+ * lock so that concurrent lookups in different directories do not contend.
  */
 class DentryTracker {
   FRIEND_TEST(T_GlueBuffer, DentryTracker);
@@ -823,9 +963,11 @@ class DentryTracker {
   };
 
  public:
+  static const unsigned kNumStripes = 16;
+
   struct Cursor {
-    explicit Cursor(Entry *h) : head(h), pos(0) {}
-    Entry *head;
+    Cursor() : stripe(0), pos(0) {}
+    unsigned stripe;
     size_t pos;
   };
 
@@ -837,7 +979,7 @@ class DentryTracker {
     int64_t num_remove;
     int64_t num_prune;
   };
-  Statistics GetStatistics() { return statistics_; }
+  Statistics GetStatistics();
 
   static void *MainCleaner(void *data);
 
@@ -856,11 +998,14 @@ class DentryTracker {
     if (timeout_s == 0) return;
 
     uint64_t now = platform_monotonic_time();
-    Lock();
-    entries_.PushBack(Entry(now + timeout_s, inode_parent, name));
-    statistics_.num_insert++;
-    DoPrune(now);
-    Unlock();
+    const unsigned idx = GetStripe(inode_parent);
+    Stripe *stripe = &stripes_[idx];
+    Lock(idx);
+    stripe->entries.PushBack(Entry(now + timeout_s, inode_parent, name));
+    stripe->statistics.num_insert++;
+    DoPruneStripe(stripe, now);
+    stripe->statistics.num_prune++;
+    Unlock(idx);
   }
 
   void Prune();
@@ -873,41 +1018,72 @@ class DentryTracker {
 
   void SpawnCleaner(unsigned interval_s);
 
+  /**
+   * Locks all stripes until EndEnumerate()
+   */
   Cursor BeginEnumerate();
   bool NextEntry(Cursor *cursor, uint64_t *inode_parent, NameString *name);
   void EndEnumerate(Cursor *cursor);
 
  private:
-  static const unsigned kVersion = 0;
+  static const unsigned kVersion = 1;
+
+  struct Stripe {
+    BigQueue<Entry> entries;
+    Statistics statistics;
+  };
+
+  static inline unsigned GetStripe(const uint64_t inode_parent) {
+    return inode_parent % kNumStripes;
+  }
 
   void CopyFrom(const DentryTracker &other);
 
-  void InitLock();
-  inline void Lock() const {
-    int retval = pthread_mutex_lock(lock_);
+  void InitLocks();
+  inline void Lock(const unsigned idx) const {
+    int retval = pthread_mutex_lock(&locks_[idx].mutex);
     assert(retval == 0);
   }
-  inline void Unlock() const {
-    int retval = pthread_mutex_unlock(lock_);
+  inline void Unlock(const unsigned idx) const {
+    int retval = pthread_mutex_unlock(&locks_[idx].mutex);
     assert(retval == 0);
   }
+  void LockAll() const {
+    for (unsigned i = 0; i < kNumStripes; ++i)
+      Lock(i);
+  }
+  void UnlockAll() const {
+    for (unsigned i = kNumStripes; i > 0; --i)
+      Unlock(i - 1);
+  }
 
-  void DoPrune(uint64_t now) {
+  void DoPruneStripe(Stripe *stripe, uint64_t now) {
     Entry *entry;
-    while (entries_.Peek(&entry)) {
+    while (stripe->entries.Peek(&entry)) {
       if (entry->expiry >= now)
         break;
-      entries_.PopFront();
-      statistics_.num_remove++;
+      stripe->entries.PopFront();
+      stripe->statistics.num_remove++;
     }
-    statistics_.num_prune++;
   }
 
-  pthread_mutex_t *lock_;
+  /**
+   * Prunes all stripes, counts as a single prune operation
+   */
+  void DoPrune(uint64_t now) {
+    for (unsigned i = 0; i < kNumStripes; ++i) {
+      Lock(i);
+      DoPruneStripe(&stripes_[i], now);
+      if (i == 0)
+        stripes_[i].statistics.num_prune++;
+      Unlock(i);
+    }
+  }
+
+  StripeLock *locks_;
   unsigned version_;
-  Statistics statistics_;
   bool is_active_;
-  BigQueue<Entry> entries_;
+  Stripe stripes_[kNumStripes];
 
   int pipe_terminate_[2];
   int cleaning_interval_ms_;
@@ -0,0 +1,328 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "ingestion/async_reader.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(HAVE_LINUX_IO_URING_H)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "util/concurrency.h"
+#include "util/exception.h"
+#include "util/logging.h"
+
+using namespace std;  // NOLINT
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && \
+    defined(__NR_io_uring_enter)
+#define CVMFS_ASYNC_READER_IO_URING
+
+namespace {
+
+/**
+ * Submits vectored reads to an io_uring instance that is set up and driven
+ * with the raw system calls.  Submissions are collected and passed to the
+ * kernel in one call once the caller waits.
+ */
+class AsyncReaderIoUring : public AsyncReader {
+ public:
+  static AsyncReaderIoUring *Create(unsigned depth);
+  virtual ~AsyncReaderIoUring();
+  virtual Type type() const { return kIoUring; }
+  virtual void Submit(Request *request);
+  virtual void Wait(Request *request);
+
+ private:
+  explicit AsyncReaderIoUring(unsigned depth);
+  bool Setup();
+  void Reap();
+
+  int ring_fd_;
+  void *sq_ring_;
+  size_t sq_ring_size_;
+  void *cq_ring_;
+  size_t cq_ring_size_;
+  struct io_uring_sqe *sqes_;
+  size_t sqes_size_;
+
+  unsigned *sq_tail_;
+  unsigned *sq_ring_mask_;
+  unsigned *sq_array_;
+  unsigned *cq_head_;
+  unsigned *cq_tail_;
+  unsigned *cq_ring_mask_;
+  struct io_uring_cqe *cqes_;
+  /**
+   * Queued in the submission ring but not yet passed to the kernel
+   */
+  unsigned num_unsubmitted_;
+};
+
+
+AsyncReaderIoUring *AsyncReaderIoUring::Create(unsigned depth) {
+  AsyncReaderIoUring *reader = new AsyncReaderIoUring(depth);
+  if (!reader->Setup()) {
+    delete reader;
+    return NULL;
+  }
+  return reader;
+}
+
+
+AsyncReaderIoUring::AsyncReaderIoUring(unsigned depth)
+  : AsyncReader(depth)
+  , ring_fd_(-1)
+  , sq_ring_(MAP_FAILED)
+  , sq_ring_size_(0)
+  , cq_ring_(MAP_FAILED)
+  , cq_ring_size_(0)
+  , sqes_(NULL)
+  , sqes_size_(0)
+  , sq_tail_(NULL)
+  , sq_ring_mask_(NULL)
+  , sq_array_(NULL)
+  , cq_head_(NULL)
+  , cq_tail_(NULL)
+  , cq_ring_mask_(NULL)
+  , cqes_(NULL)
+  , num_unsubmitted_(0)
+{ }
+
+
+AsyncReaderIoUring::~AsyncReaderIoUring() {
+  if (sqes_ != NULL)
+    munmap(sqes_, sqes_size_);
+  if ((cq_ring_ != MAP_FAILED) && (cq_ring_ != sq_ring_))
+    munmap(cq_ring_, cq_ring_size_);
+  if (sq_ring_ != MAP_FAILED)
+    munmap(sq_ring_, sq_ring_size_);
+  if (ring_fd_ >= 0)
+    close(ring_fd_);
+}
+
+
+bool AsyncReaderIoUring::Setup() {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, depth_, &params));
+  if (ring_fd_ < 0) {
+    LogCvmfs(kLogSpooler, kLogDebug, "io_uring not available (%d)", errno);
+    return false;
+  }
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ =
+    params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    single_mmap = true;
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+#endif
+  sq_ring_ = mmap(NULL, sq_ring_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED)
+    return false;
+  if (single_mmap) {
+    cq_ring_ = sq_ring_;
+  } else {
+    cq_ring_ = mmap(NULL, cq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED)
+      return false;
+  }
+  sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  void *sqes = mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED)
+    return false;
+  sqes_ = static_cast<struct io_uring_sqe *>(sqes);
+
+  unsigned char *sq = static_cast<unsigned char *>(sq_ring_);
+  sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_ring_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  unsigned char *cq = static_cast<unsigned char *>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_ring_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+  return true;
+}
+
+
+void AsyncReaderIoUring::Submit(Request *request) {
+  request->done = false;
+  request->iov.iov_base = request->buffer;
+  request->iov.iov_len = request->size;
+
+  // Only this thread writes the submission tail
+  const unsigned tail = *sq_tail_;
+  const unsigned index = tail & *sq_ring_mask_;
+  struct io_uring_sqe *sqe = &sqes_[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_READV;
+  sqe->fd = request->fd;
+  sqe->off = request->offset;
+  sqe->addr = reinterpret_cast<uintptr_t>(&request->iov);
+  sqe->len = 1;
+  sqe->user_data = reinterpret_cast<uintptr_t>(request);
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  num_unsubmitted_++;
+}
+
+
+/**
+ * Marks the requests in the completion ring as done.
+ */
+void AsyncReaderIoUring::Reap() {
+  unsigned head = *cq_head_;
+  const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  while (head != tail) {
+    const struct io_uring_cqe *cqe = &cqes_[head & *cq_ring_mask_];
+    Request *request = reinterpret_cast<Request *>(cqe->user_data);
+    request->result = cqe->res;
+    request->done = true;
+    head++;
+  }
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+
+void AsyncReaderIoUring::Wait(Request *request) {
+  Reap();
+  while (!request->done) {
+    const long retval = syscall(__NR_io_uring_enter,  // NOLINT
+                                ring_fd_, num_unsubmitted_, 1,
+                                IORING_ENTER_GETEVENTS, NULL, 0);
+    if (retval < 0) {
+      if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY)) {
+        Reap();
+        continue;
+      }
+      PANIC(kLogStderr, "io_uring_enter failed (%d)", errno);
+    }
+    num_unsubmitted_ -= retval;
+    Reap();
+  }
+}
+
+}  // anonymous namespace
+
+#endif  // io_uring
+
+
+AsyncReader *AsyncReader::Create(Type type, unsigned depth) {
+  assert(depth > 0);
+#ifdef CVMFS_ASYNC_READER_IO_URING
+  if (type == kIoUring) {
+    AsyncReader *reader = AsyncReaderIoUring::Create(depth);
+    if (reader != NULL)
+      return reader;
+  }
+#endif
+  return new AsyncReaderPread(depth);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+AsyncReaderPread::AsyncReaderPread(unsigned depth)
+  : AsyncReader(depth)
+  , terminate_(false)
+{
+  int retval = pthread_mutex_init(&lock_, NULL);
+  assert(retval == 0);
+  retval = pthread_cond_init(&cond_submitted_, NULL);
+  assert(retval == 0);
+  retval = pthread_cond_init(&cond_done_, NULL);
+  assert(retval == 0);
+
+  workers_.resize(depth_);
+  for (unsigned i = 0; i < depth_; ++i) {
+    retval = pthread_create(&workers_[i], NULL, MainWorker, this);
+    assert(retval == 0);
+  }
+}
+
+
+AsyncReaderPread::~AsyncReaderPread() {
+  {
+    MutexLockGuard guard(&lock_);
+    terminate_ = true;
+    pthread_cond_broadcast(&cond_submitted_);
+  }
+  for (unsigned i = 0; i < workers_.size(); ++i)
+    pthread_join(workers_[i], NULL);
+  pthread_cond_destroy(&cond_done_);
+  pthread_cond_destroy(&cond_submitted_);
+  pthread_mutex_destroy(&lock_);
+}
+
+
+void *AsyncReaderPread::MainWorker(void *data) {
+  AsyncReaderPread *reader = reinterpret_cast<AsyncReaderPread *>(data);
+
+  while (true) {
+    Request *request;
+    {
+      MutexLockGuard guard(&reader->lock_);
+      while (reader->queue_.empty() && !reader->terminate_)
+        pthread_cond_wait(&reader->cond_submitted_, &reader->lock_);
+      if (reader->queue_.empty())
+        return NULL;
+      request = reader->queue_.front();
+      reader->queue_.pop_front();
+    }
+
+    int64_t nbytes = 0;
+    while (nbytes < request->size) {
+      const ssize_t retval = pread(request->fd, request->buffer + nbytes,
+                                   request->size - nbytes,
+                                   request->offset + nbytes);
+      if (retval < 0) {
+        if (errno == EINTR)
+          continue;
+        nbytes = -errno;
+        break;
+      }
+      if (retval == 0)
+        break;
+      nbytes += retval;
+    }
+
+    MutexLockGuard guard(&reader->lock_);
+    request->result = nbytes;
+    request->done = true;
+    pthread_cond_broadcast(&reader->cond_done_);
+  }
+}
+
+
+void AsyncReaderPread::Submit(Request *request) {
+  MutexLockGuard guard(&lock_);
+  request->done = false;
+  queue_.push_back(request);
+  pthread_cond_signal(&cond_submitted_);
+}
+
+
+void AsyncReaderPread::Wait(Request *request) {
+  MutexLockGuard guard(&lock_);
+  while (!request->done)
+    pthread_cond_wait(&cond_done_, &lock_);
+}
@@ -0,0 +1,108 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_INGESTION_ASYNC_READER_H_
+#define CVMFS_INGESTION_ASYNC_READER_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include <deque>
+#include <vector>
+
+#include "util/single_copy.h"
+
+/**
+ * Reads blocks of regular files asynchronously, so that a reader task can keep
+ * several blocks of a file in flight.  A reader is used by a single thread: it
+ * submits requests with Submit() and collects them with Wait().  At most
+ * depth() requests may be outstanding.
+ *
+ * Requests are passed to io_uring where the kernel allows it (Linux >= 5.1,
+ * using the raw system calls).  Otherwise, a pool of depth() threads serves
+ * them with pread().
+ */
+class AsyncReader : SingleCopy {
+ public:
+  enum Type {
+    kIoUring,
+    kPread,
+  };
+
+  struct Request {
+    Request() : fd(-1), offset(0), buffer(NULL), size(0), result(0),
+                done(false)
+    {
+      iov.iov_base = NULL;
+      iov.iov_len = 0;
+    }
+    Request(int f, uint64_t o, unsigned char *b, unsigned s)
+      : fd(f), offset(o), buffer(b), size(s), result(0), done(false)
+    {
+      iov.iov_base = b;
+      iov.iov_len = s;
+    }
+
+    int fd;
+    uint64_t offset;
+    unsigned char *buffer;
+    unsigned size;
+    /**
+     * Number of bytes read or -errno, valid once the request is done.  Fewer
+     * bytes than requested are only read at the end of the file.
+     */
+    int64_t result;
+    bool done;
+    /**
+     * Owned by the io_uring reader
+     */
+    struct iovec iov;
+  };
+
+  /**
+   * Falls back to the pread reader if io_uring is requested but not available.
+   */
+  static AsyncReader *Create(Type type, unsigned depth);
+  virtual ~AsyncReader() { }
+
+  virtual Type type() const = 0;
+  unsigned depth() const { return depth_; }
+  virtual void Submit(Request *request) = 0;
+  /**
+   * Blocks until the request is done.  Other requests may complete meanwhile.
+   */
+  virtual void Wait(Request *request) = 0;
+
+ protected:
+  explicit AsyncReader(unsigned depth) : depth_(depth) { }
+
+  unsigned depth_;
+};
+
+
+/**
+ * Serves requests with a pool of threads, each doing blocking preads.
+ */
+class AsyncReaderPread : public AsyncReader {
+ public:
+  explicit AsyncReaderPread(unsigned depth);
+  virtual ~AsyncReaderPread();
+  virtual Type type() const { return kPread; }
+  virtual void Submit(Request *request);
+  virtual void Wait(Request *request);
+
+ private:
+  static void *MainWorker(void *data);
+
+  std::deque<Request *> queue_;
+  std::vector<pthread_t> workers_;
+  bool terminate_;
+  pthread_mutex_t lock_;
+  pthread_cond_t cond_submitted_;
+  pthread_cond_t cond_done_;
+};
+
+
+#endif  // CVMFS_INGESTION_ASYNC_READER_H_
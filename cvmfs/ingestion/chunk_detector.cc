@@ -12,6 +12,33 @@
 #include "ingestion/item.h"
 
 
+bool ParseChunkDetectorAlgorithm(const std::string &algorithm_option,
+                                 ChunkDetectorAlgorithms *algorithm)
+{
+  if ((algorithm_option == "default") || (algorithm_option == "xor32")) {
+    *algorithm = kChunkDetectorXor32;
+    return true;
+  }
+  if (algorithm_option == "fastcdc") {
+    *algorithm = kChunkDetectorFastCdc;
+    return true;
+  }
+  return false;
+}
+
+
+std::string ChunkDetectorAlgorithmName(const ChunkDetectorAlgorithms alg) {
+  switch (alg) {
+    case kChunkDetectorXor32:
+      return "xor32";
+    case kChunkDetectorFastCdc:
+      return "fastcdc";
+    // Purposely no default statement, see zlib::AlgorithmName()
+  }
+  return "unknown";
+}
+
+
 uint64_t ChunkDetector::FindNextCutMark(BlockItem *block) {
   uint64_t result = DoFindNextCutMark(block);
   if (result == 0)
@@ -135,3 +162,151 @@ uint64_t Xor32Detector::DoFindNextCutMark(BlockItem *buffer) {
     return NoCut(internal_offset + offset());
   }
 }
+
+
+//------------------------------------------------------------------------------
+
+
+namespace {
+
+/**
+ * Random values for the Gear rolling hash, one per byte value.  Derived from a
+ * fixed seed with SplitMix64.  You should never change the seed, since it
+ * affects the definition of cut marks.
+ */
+class GearTable {
+ public:
+  GearTable() {
+    uint64_t state = 0x4cd1a2e5f9b8c730ULL;
+    for (unsigned i = 0; i < 256; ++i) {
+      state += 0x9e3779b97f4a7c15ULL;
+      uint64_t z = state;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      values[i] = z ^ (z >> 31);
+    }
+  }
+  uint64_t values[256];
+};
+
+const GearTable kGear;
+
+
+/**
+ * Rolls the Gear fingerprint over data[*pos, end).  Returns true if a byte was
+ * found after which none of the mask bits is set; *pos is then the position
+ * right after that byte.  Otherwise *pos is set to end.  The loop is unrolled
+ * since the fingerprint's dependency chain prevents vectorization.
+ */
+inline bool ScanGear(
+  const unsigned char *data,
+  uint64_t *pos,
+  const uint64_t end,
+  const uint64_t mask,
+  uint64_t *fingerprint)
+{
+  const uint64_t *gear = kGear.values;
+  uint64_t fp = *fingerprint;
+  uint64_t i = *pos;
+  bool found = false;
+  for (; i + 4 <= end; i += 4) {
+    fp = (fp << 1) + gear[data[i]];
+    if ((fp & mask) == 0) { i += 1; found = true; break; }
+    fp = (fp << 1) + gear[data[i + 1]];
+    if ((fp & mask) == 0) { i += 2; found = true; break; }
+    fp = (fp << 1) + gear[data[i + 2]];
+    if ((fp & mask) == 0) { i += 3; found = true; break; }
+    fp = (fp << 1) + gear[data[i + 3]];
+    if ((fp & mask) == 0) { i += 4; found = true; break; }
+  }
+  for (; !found && (i < end); ++i) {
+    fp = (fp << 1) + gear[data[i]];
+    found = ((fp & mask) == 0);
+  }
+  *fingerprint = fp;
+  *pos = i;
+  return found;
+}
+
+}  // anonymous namespace
+
+
+/**
+ * The mask selects the upper nbits of the fingerprint, which depend on the
+ * largest window of input bytes.
+ */
+uint64_t FastCdcDetector::MakeMask(const unsigned nbits) {
+  if (nbits == 0)
+    return 0;
+  return ~uint64_t(0) << (64 - std::min(nbits, 64U));
+}
+
+
+FastCdcDetector::FastCdcDetector(const uint64_t minimal_chunk_size,
+                                 const uint64_t average_chunk_size,
+                                 const uint64_t maximal_chunk_size)
+  : minimal_chunk_size_(minimal_chunk_size)
+  , average_chunk_size_(average_chunk_size)
+  , maximal_chunk_size_(maximal_chunk_size)
+  , mask_strict_(0)
+  , mask_loose_(0)
+  , gear_ptr_(0)
+  , gear_(0)
+{
+  assert((average_chunk_size_ == 0) || (minimal_chunk_size_ > 0));
+  if (minimal_chunk_size_ > 0) {
+    assert(minimal_chunk_size_ >= kGearWindow);
+    assert(minimal_chunk_size_ < average_chunk_size_);
+    assert(average_chunk_size_ < maximal_chunk_size_);
+  }
+
+  unsigned avg_bits = 0;
+  while ((uint64_t(1) << (avg_bits + 1)) <= average_chunk_size_)
+    avg_bits++;
+  mask_strict_ = MakeMask(avg_bits + kNormalizationLevel);
+  mask_loose_ = MakeMask((avg_bits > kNormalizationLevel)
+                         ? avg_bits - kNormalizationLevel : 1);
+}
+
+
+uint64_t FastCdcDetector::DoFindNextCutMark(BlockItem *buffer) {
+  assert(minimal_chunk_size_ > 0);
+  const unsigned char *data = buffer->data();
+  const uint64_t beginning = offset();
+  const uint64_t end = offset() + buffer->size();
+
+  // Continue where the last buffer left off or start warming up the
+  // fingerprint shortly before the minimal chunk size is reached
+  uint64_t pos = std::max(last_cut() + minimal_chunk_size_ - kGearWindow,
+                          gear_ptr_);
+  if (pos >= end)
+    return NoCut(pos);
+  assert(pos >= beginning);
+
+  const uint64_t min_end = last_cut() + minimal_chunk_size_;
+  const uint64_t avg_end = last_cut() + average_chunk_size_;
+  const uint64_t max_end = last_cut() + maximal_chunk_size_;
+  const uint64_t *gear = kGear.values;
+
+  for (const uint64_t warmup_end = std::min(min_end, end); pos < warmup_end;
+       ++pos)
+  {
+    gear_ = (gear_ << 1) + gear[data[pos - beginning]];
+  }
+
+  // Positions relative to the buffer; the average chunk size might have been
+  // passed in a previous buffer
+  uint64_t internal_pos = pos - beginning;
+  const uint64_t internal_avg_end =
+    (avg_end > beginning) ? std::min(avg_end, end) - beginning : 0;
+  const uint64_t internal_max_end = std::min(max_end, end) - beginning;
+  if (ScanGear(data, &internal_pos, internal_avg_end, mask_strict_, &gear_))
+    return DoCut(beginning + internal_pos);
+  if (ScanGear(data, &internal_pos, internal_max_end, mask_loose_, &gear_))
+    return DoCut(beginning + internal_pos);
+
+  // Hard cut at the maximal chunk size or continue with the next buffer
+  if (beginning + internal_pos == max_end)
+    return DoCut(max_end);
+  return NoCut(beginning + internal_pos);
+}
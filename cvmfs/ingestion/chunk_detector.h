@@ -11,9 +11,27 @@
 #include <cstdlib>
 
 #include <algorithm>
+#include <string>
 
 class BlockItem;
 
+/**
+ * Selects the ChunkDetector implementation used for new files.  Xor32 is the
+ * historic default; changing the algorithm of a repository changes the cut
+ * marks and thus the chunks of newly published files.
+ */
+enum ChunkDetectorAlgorithms {
+  kChunkDetectorXor32 = 0,
+  kChunkDetectorFastCdc,
+};
+
+/**
+ * Returns false if the string doesn't match any of the algorithms
+ */
+bool ParseChunkDetectorAlgorithm(const std::string &algorithm_option,
+                                 ChunkDetectorAlgorithms *algorithm);
+std::string ChunkDetectorAlgorithmName(const ChunkDetectorAlgorithms alg);
+
 /**
  * Abstract base class for a cutmark detector. This decides on which file
  * positions a File should be chunked.
@@ -135,4 +153,68 @@ class Xor32Detector : public ChunkDetector {
   uint32_t xor32_;
 };
 
+
+/**
+ * Content-defined chunking following FastCDC [1].
+ *
+ * The Gear rolling hash needs a single shift, add, and table lookup per byte.
+ * Due to the shift, the upper bits of the fingerprint only depend on the last
+ * 64 bytes of the stream, so cut marks are not affected by insertions or
+ * deletions further up in the file.  The first minimal_chunk_size bytes of a
+ * chunk are skipped except for the 64 bytes needed to warm up the fingerprint.
+ *
+ * Normalized chunking: up to the average chunk size, the cut condition uses a
+ * mask with more bits than log2(average_chunk_size), after that a mask with
+ * fewer bits.  That concentrates the chunk sizes around the average and
+ * reduces the number of chunks that are cut at the maximal chunk size.
+ *
+ * [1]     "FastCDC: a Fast and Efficient Content-Defined Chunking Approach
+ *          for Data Deduplication"
+ *     Wen Xia et al., USENIX ATC (2016)
+ */
+class FastCdcDetector : public ChunkDetector {
+  FRIEND_TEST(T_ChunkDetectors, FastCdcMasks);
+
+ public:
+  FastCdcDetector(const uint64_t minimal_chunk_size,
+                  const uint64_t average_chunk_size,
+                  const uint64_t maximal_chunk_size);
+
+  bool MightFindChunks(const uint64_t size) const {
+    return size > minimal_chunk_size_;
+  }
+
+ protected:
+  virtual uint64_t DoFindNextCutMark(BlockItem *buffer);
+
+  virtual uint64_t DoCut(const uint64_t offset) {
+    gear_     = 0;
+    gear_ptr_ = offset;
+    return ChunkDetector::DoCut(offset);
+  }
+
+  virtual uint64_t NoCut(const uint64_t offset) {
+    gear_ptr_ = offset;
+    return ChunkDetector::NoCut(offset);
+  }
+
+ private:
+  static const unsigned kGearWindow = 64;
+  /**
+   * Number of bits by which the masks deviate from log2(average_chunk_size)
+   */
+  static const unsigned kNormalizationLevel = 2;
+
+  static uint64_t MakeMask(const unsigned nbits);
+
+  const uint64_t minimal_chunk_size_;
+  const uint64_t average_chunk_size_;
+  const uint64_t maximal_chunk_size_;
+  uint64_t mask_strict_;  // before the average chunk size
+  uint64_t mask_loose_;   // after the average chunk size
+
+  uint64_t gear_ptr_;
+  uint64_t gear_;
+};
+
 #endif  // CVMFS_INGESTION_CHUNK_DETECTOR_H_
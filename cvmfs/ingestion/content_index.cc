@@ -0,0 +1,301 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "ingestion/content_index.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+#include "util/logging.h"
+#include "util/mutex.h"
+#include "util/pointer.h"
+#include "util/posix.h"
+#include "util/string.h"
+
+using namespace std;  // NOLINT
+
+
+bool ContentIndex::Key::operator <(const Key &other) const {
+  if (size != other.size)
+    return size < other.size;
+  if (hash_suffix != other.hash_suffix)
+    return hash_suffix < other.hash_suffix;
+  if (may_have_chunks != other.may_have_chunks)
+    return may_have_chunks < other.may_have_chunks;
+  return content_hash < other.content_hash;
+}
+
+
+ContentIndex *ContentIndex::Create(
+  const string &path,
+  const string &settings,
+  uint64_t max_entries)
+{
+  UniquePtr<ContentIndex> index(new ContentIndex(path, settings, max_entries));
+  if (!index->Load())
+    return NULL;
+  LogCvmfs(kLogSpooler, kLogDebug, "loaded %" PRIu64 " entries from content "
+           "index %s (run %" PRIu64 ")", index->size(), path.c_str(),
+           index->run());
+  return index.Release();
+}
+
+
+ContentIndex::ContentIndex(
+  const string &path,
+  const string &settings,
+  uint64_t max_entries)
+  : path_(path)
+  , settings_(settings)
+  , max_entries_(max_entries)
+  , run_(1)
+  , dirty_(false)
+{
+  atomic_init64(&n_hit_);
+  atomic_init64(&n_miss_);
+  int retval = pthread_mutex_init(&lock_, NULL);
+  assert(retval == 0);
+}
+
+
+ContentIndex::~ContentIndex() {
+  pthread_mutex_destroy(&lock_);
+}
+
+
+bool ContentIndex::Commit() {
+  MutexLockGuard lock_guard(lock_);
+  Prune();
+  if (!dirty_)
+    return true;
+
+  string tmp_path;
+  FILE *f = CreateTempFile(path_ + ".tmp", 0600, "w", &tmp_path);
+  if (f == NULL) {
+    LogCvmfs(kLogSpooler, kLogStderr, "failed to create %s.tmp (%d)",
+             path_.c_str(), errno);
+    return false;
+  }
+  bool retval = fprintf(f, "%s\n", GetHeader().c_str()) >= 0;
+  for (map<Key, Entry>::const_iterator i = entries_.begin(),
+       iEnd = entries_.end(); retval && (i != iEnd); ++i)
+  {
+    retval = fprintf(f, "%s\n", PrintEntry(i->first, i->second).c_str()) >= 0;
+  }
+  retval = (fclose(f) == 0) && retval;
+  if (!retval || (rename(tmp_path.c_str(), path_.c_str()) != 0)) {
+    LogCvmfs(kLogSpooler, kLogStderr, "failed to write content index %s (%d)",
+             path_.c_str(), errno);
+    unlink(tmp_path.c_str());
+    return false;
+  }
+
+  LogCvmfs(kLogSpooler, kLogDebug, "stored %" PRIu64 " entries in content "
+           "index %s (%" PRId64 " hits, %" PRId64 " misses)",
+           static_cast<uint64_t>(entries_.size()), path_.c_str(),
+           atomic_read64(&n_hit_), atomic_read64(&n_miss_));
+  dirty_ = false;
+  return true;
+}
+
+
+string ContentIndex::GetHeader() const {
+  return "version=" + StringifyUint(kFormatVersion) + " " + settings_;
+}
+
+
+void ContentIndex::Insert(const Key &key, const Entry &entry) {
+  MutexLockGuard lock_guard(lock_);
+  Entry *stored_entry = &entries_[key];
+  *stored_entry = entry;
+  stored_entry->last_run = run_;
+  dirty_ = true;
+}
+
+
+bool ContentIndex::Load() {
+  FILE *f = fopen(path_.c_str(), "r");
+  if (f == NULL)
+    return errno == ENOENT;
+
+  string line;
+  if (!GetLineFile(f, &line) || (line != GetHeader())) {
+    LogCvmfs(kLogSpooler, kLogDebug, "pipeline settings or format changed, "
+             "discarding content index %s", path_.c_str());
+    fclose(f);
+    dirty_ = true;
+    return true;
+  }
+
+  Key key;
+  Entry entry;
+  while (GetLineFile(f, &line)) {
+    if (!ParseEntry(line, &key, &entry)) {
+      LogCvmfs(kLogSpooler, kLogDebug | kLogSyslogWarn,
+               "ignoring corrupted entry in content index %s", path_.c_str());
+      dirty_ = true;
+      continue;
+    }
+    entries_[key] = entry;
+    run_ = std::max(run_, entry.last_run + 1);
+  }
+  fclose(f);
+  return true;
+}
+
+
+bool ContentIndex::Lookup(const Key &key, Entry *entry) {
+  MutexLockGuard lock_guard(lock_);
+  map<Key, Entry>::iterator iter = entries_.find(key);
+  if (iter == entries_.end()) {
+    atomic_inc64(&n_miss_);
+    return false;
+  }
+  atomic_inc64(&n_hit_);
+  if (iter->second.last_run != run_) {
+    iter->second.last_run = run_;
+    dirty_ = true;
+  }
+  *entry = iter->second;
+  return true;
+}
+
+
+/**
+ * Drops entries that have not been used for kMaxIdleRuns runs.  If there are
+ * still more than max_entries_ entries, drops the least recently used ones.
+ * Called with the lock held.
+ */
+void ContentIndex::Prune() {
+  const uint64_t min_run = (run_ > kMaxIdleRuns) ? (run_ - kMaxIdleRuns) : 0;
+  uint64_t num_dropped = 0;
+  for (map<Key, Entry>::iterator i = entries_.begin(); i != entries_.end(); ) {
+    if (i->second.last_run < min_run) {
+      entries_.erase(i++);
+      num_dropped++;
+    } else {
+      ++i;
+    }
+  }
+
+  if (entries_.size() > max_entries_) {
+    vector<uint64_t> last_runs;
+    last_runs.reserve(entries_.size());
+    for (map<Key, Entry>::const_iterator i = entries_.begin(),
+         iEnd = entries_.end(); i != iEnd; ++i)
+    {
+      last_runs.push_back(i->second.last_run);
+    }
+    // Entries of older runs are dropped entirely, entries of the threshold run
+    // as far as necessary
+    sort(last_runs.begin(), last_runs.end());
+    const uint64_t num_excess = entries_.size() - max_entries_;
+    const uint64_t threshold_run = last_runs[num_excess - 1];
+    uint64_t num_threshold_run = num_excess -
+      (lower_bound(last_runs.begin(), last_runs.end(), threshold_run) -
+       last_runs.begin());
+    for (map<Key, Entry>::iterator i = entries_.begin();
+         i != entries_.end(); )
+    {
+      const uint64_t last_run = i->second.last_run;
+      if ((last_run < threshold_run) ||
+          ((last_run == threshold_run) && (num_threshold_run > 0)))
+      {
+        if (last_run == threshold_run)
+          num_threshold_run--;
+        entries_.erase(i++);
+        num_dropped++;
+      } else {
+        ++i;
+      }
+    }
+  }
+
+  if (num_dropped > 0) {
+    LogCvmfs(kLogSpooler, kLogDebug, "pruned %" PRIu64 " entries from content "
+             "index %s", num_dropped, path_.c_str());
+    dirty_ = true;
+  }
+}
+
+
+/**
+ * Format: <last run> <content hash> <size> <hash suffix> <may have chunks>
+ *         <compression algorithm> <bulk hash or -> [<offset> <size> <hash>]*
+ * Hashes are stored without suffix.  The bulk hash takes the suffix of the
+ * key, chunks are always partial.
+ */
+bool ContentIndex::ParseEntry(const string &line, Key *key, Entry *entry) {
+  vector<string> fields = SplitString(line, ' ');
+  if ((fields.size() < 7) || (((fields.size() - 7) % 3) != 0))
+    return false;
+  for (unsigned i = 0; i < fields.size(); ++i) {
+    if (fields[i].empty())
+      return false;
+  }
+  if (!String2Uint64Parse(fields[0], &entry->last_run))
+    return false;
+  fields.erase(fields.begin());
+
+  if (!shash::HexPtr(fields[0]).IsValid())
+    return false;
+  key->content_hash = shash::MkFromHexPtr(shash::HexPtr(fields[0]));
+  key->size = String2Uint64(fields[1]);
+  key->hash_suffix = static_cast<shash::Suffix>(String2Uint64(fields[2]));
+  key->may_have_chunks = (fields[3] == "1");
+
+  entry->compression_algorithm =
+    static_cast<zlib::Algorithms>(String2Uint64(fields[4]));
+  if (fields[5] == "-") {
+    entry->bulk_hash = shash::Any();
+  } else {
+    if (!shash::HexPtr(fields[5]).IsValid())
+      return false;
+    entry->bulk_hash =
+      shash::MkFromHexPtr(shash::HexPtr(fields[5]), key->hash_suffix);
+  }
+  entry->chunks.clear();
+  for (unsigned i = 6; i < fields.size(); i += 3) {
+    if (!shash::HexPtr(fields[i + 2]).IsValid())
+      return false;
+    entry->chunks.push_back(FileChunk(
+      shash::MkFromHexPtr(shash::HexPtr(fields[i + 2]), shash::kSuffixPartial),
+      String2Uint64(fields[i]),
+      String2Uint64(fields[i + 1])));
+  }
+
+  // A chunked file without bulk hash needs at least two chunks
+  if (entry->bulk_hash.IsNull() && (entry->chunks.size() < 2))
+    return false;
+  return entry->chunks.size() != 1;
+}
+
+
+string ContentIndex::PrintEntry(const Key &key, const Entry &entry) {
+  string result = StringifyUint(entry.last_run) + " " +
+    key.content_hash.ToString() + " " +
+    StringifyUint(key.size) + " " +
+    StringifyUint(static_cast<unsigned char>(key.hash_suffix)) + " " +
+    (key.may_have_chunks ? "1" : "0") + " " +
+    StringifyInt(entry.compression_algorithm) + " " +
+    (entry.bulk_hash.IsNull() ? string("-") : entry.bulk_hash.ToString());
+  for (unsigned i = 0; i < entry.chunks.size(); ++i) {
+    result += " " + StringifyUint(entry.chunks[i].offset()) + " " +
+      StringifyUint(entry.chunks[i].size()) + " " +
+      entry.chunks[i].content_hash().ToString();
+  }
+  return result;
+}
+
+
+uint64_t ContentIndex::size() {
+  MutexLockGuard lock_guard(lock_);
+  return entries_.size();
+}
@@ -0,0 +1,133 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_INGESTION_CONTENT_INDEX_H_
+#define CVMFS_INGESTION_CONTENT_INDEX_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "compression.h"
+#include "crypto/hash.h"
+#include "file_chunk.h"
+#include "util/atomic.h"
+#include "util/single_copy.h"
+
+/**
+ * Publisher-side index that maps the hash of the uncompressed content of a
+ * file to the objects that the ingestion pipeline produced for it.  Files that
+ * are re-touched but unchanged in a transaction can thus be registered
+ * without being compressed, hashed, and uploaded again.
+ *
+ * The index is persisted as a text file, one entry per line.  The first line
+ * describes the format version and the pipeline settings (hash and compression
+ * algorithm, chunking parameters) under which the entries were produced.  If
+ * the settings change, the stored entries are discarded.  Entries can become
+ * stale when objects are garbage collected, so the caller has to verify that
+ * the objects of a hit still exist in the backend storage.
+ *
+ * Every instance of the index counts as one publish run.  Entries remember the
+ * last run that inserted or found them.  On commit, entries that have not been
+ * used for kMaxIdleRuns runs are dropped, and if the index has more than
+ * max_entries entries, the least recently used ones are dropped.
+ */
+class ContentIndex : SingleCopy {
+ public:
+  struct Key {
+    Key() : size(0), hash_suffix(shash::kSuffixNone), may_have_chunks(false) { }
+    Key(const shash::Any &h, uint64_t s, shash::Suffix x, bool c)
+      : content_hash(h), size(s), hash_suffix(x), may_have_chunks(c) { }
+    bool operator <(const Key &other) const;
+
+    /**
+     * Hash of the uncompressed file content
+     */
+    shash::Any content_hash;
+    uint64_t size;
+    shash::Suffix hash_suffix;
+    bool may_have_chunks;
+  };
+
+  struct Entry {
+    Entry() : compression_algorithm(zlib::kZlibDefault), last_run(0) { }
+    /**
+     * Null if the file is chunked and no legacy bulk chunk was created
+     */
+    shash::Any bulk_hash;
+    std::vector<FileChunk> chunks;
+    zlib::Algorithms compression_algorithm;
+    /**
+     * Maintained by the index
+     */
+    uint64_t last_run;
+  };
+
+  /**
+   * Entries unused for so many publish runs are dropped
+   */
+  static const uint64_t kMaxIdleRuns = 50;
+  /**
+   * Bounds the memory of the index to a few hundred megabytes
+   */
+  static const uint64_t kDefaultMaxEntries = 1000000;
+
+  /**
+   * Loads the index from path, if it exists.  Entries that were stored under
+   * different settings are dropped.  Returns NULL if the file exists but
+   * cannot be read.
+   */
+  static ContentIndex *Create(const std::string &path,
+                              const std::string &settings,
+                              uint64_t max_entries = kDefaultMaxEntries);
+  ~ContentIndex();
+
+  bool Lookup(const Key &key, Entry *entry);
+  void Insert(const Key &key, const Entry &entry);
+  /**
+   * Prunes the index and atomically replaces the index file if there are
+   * changes.
+   */
+  bool Commit();
+
+  uint64_t size();
+  uint64_t n_hit() { return atomic_read64(&n_hit_); }
+  uint64_t n_miss() { return atomic_read64(&n_miss_); }
+  uint64_t run() const { return run_; }
+
+ private:
+  /**
+   * Changes of the file format invalidate existing index files
+   */
+  static const unsigned kFormatVersion = 2;
+
+  ContentIndex(const std::string &path, const std::string &settings,
+               uint64_t max_entries);
+  std::string GetHeader() const;
+  bool Load();
+  void Prune();
+  static bool ParseEntry(const std::string &line, Key *key, Entry *entry);
+  static std::string PrintEntry(const Key &key, const Entry &entry);
+
+  std::string path_;
+  /**
+   * Serialized pipeline settings, written as the first line of the file
+   */
+  std::string settings_;
+  uint64_t max_entries_;
+  /**
+   * One more than the most recent run stored in the index file
+   */
+  uint64_t run_;
+  std::map<Key, Entry> entries_;
+  bool dirty_;
+  atomic_int64 n_hit_;
+  atomic_int64 n_miss_;
+  pthread_mutex_t lock_;
+};
+
+#endif  // CVMFS_INGESTION_CONTENT_INDEX_H_
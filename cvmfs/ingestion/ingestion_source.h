@@ -44,6 +44,15 @@ class IngestionSource : SingleCopy {
   virtual ssize_t Read(void* buffer, size_t nbyte) = 0;
   virtual bool Close() = 0;
   virtual bool GetSize(uint64_t* size) = 0;
+  /**
+   * Restarts reading from the beginning of an open source.  Only supported by
+   * sources that are real files.
+   */
+  virtual bool Rewind() { return false; }
+  /**
+   * File descriptor of an open source that is a real file, -1 otherwise
+   */
+  virtual int GetFd() const { return -1; }
 };
 
 class FileIngestionSource : public IngestionSource {
@@ -88,6 +97,13 @@ class FileIngestionSource : public IngestionSource {
     return (ret == 0);
   }
 
+  virtual bool Rewind() {
+    assert(fd_ >= 0);
+    return lseek(fd_, 0, SEEK_SET) == 0;
+  }
+
+  virtual int GetFd() const { return fd_; }
+
   bool GetSize(uint64_t* size) {
     if (stat_obtained_) {
       *size = stat_.st_size;
@@ -23,18 +23,31 @@ FileItem::FileItem(
   shash::Algorithms hash_algorithm,
   shash::Suffix hash_suffix,
   bool may_have_chunks,
-  bool has_legacy_bulk_chunk)
+  bool has_legacy_bulk_chunk,
+  ChunkDetectorAlgorithms chunk_detector_algorithm,
+  int compression_level)
   : source_(source)
   , compression_algorithm_(compression_algorithm)
+  , compression_level_(compression_level)
   , hash_algorithm_(hash_algorithm)
   , hash_suffix_(hash_suffix)
   , has_legacy_bulk_chunk_(has_legacy_bulk_chunk)
   , size_(kSizeUnknown)
   , may_have_chunks_(may_have_chunks)
-  , chunk_detector_(min_chunk_size, avg_chunk_size, max_chunk_size)
   , bulk_hash_(hash_algorithm)
   , chunks_(1)
 {
+  switch (chunk_detector_algorithm) {
+    case kChunkDetectorXor32:
+      chunk_detector_ =
+        new Xor32Detector(min_chunk_size, avg_chunk_size, max_chunk_size);
+      break;
+    case kChunkDetectorFastCdc:
+      chunk_detector_ =
+        new FastCdcDetector(min_chunk_size, avg_chunk_size, max_chunk_size);
+      break;
+  }
+  assert(chunk_detector_.IsValid());
   int retval = pthread_mutex_init(&lock_, NULL);
   assert(retval == 0);
   atomic_init64(&nchunks_in_fly_);
@@ -76,7 +89,8 @@ ChunkItem::ChunkItem(FileItem *file_item, uint64_t offset)
 {
   hash_ctx_.algorithm = file_item->hash_algorithm();
   hash_ctx_.size = shash::GetContextSize(hash_ctx_.algorithm);
-  hash_ctx_.buffer = hash_ctx_buffer_;
+  hash_ctx_buffer_.resize(hash_ctx_.size);
+  hash_ctx_.buffer = &hash_ctx_buffer_[0];
   shash::Init(hash_ctx_);
   hash_value_.algorithm = hash_ctx_.algorithm;
   hash_value_.suffix = shash::kSuffixPartial;
@@ -94,6 +108,8 @@ zlib::Compressor *ChunkItem::GetCompressor() {
   if (!compressor_.IsValid()) {
     compressor_ =
       zlib::Compressor::Construct(file_item_->compression_algorithm());
+    if (file_item_->compression_level() > 0)
+      compressor_->SetLevel(file_item_->compression_level());
   }
   return compressor_.weak_ref();
 }
@@ -175,7 +191,9 @@ void BlockItem::MakeDataMove(BlockItem *other) {
   assert(other->size_ > 0);
 
   type_ = kBlockData;
-  capacity_ = size_ = other->size_;
+  // Keep the capacity so that the managed bytes are released correctly
+  capacity_ = other->capacity_;
+  size_ = other->size_;
   data_ = other->data_;
   allocator_ = other->allocator_;
 
@@ -42,7 +42,9 @@ class FileItem : SingleCopy {
     shash::Algorithms hash_algorithm = shash::kSha1,
     shash::Suffix hash_suffix = shash::kSuffixNone,
     bool may_have_chunks = true,
-    bool has_legacy_bulk_chunk = false);
+    bool has_legacy_bulk_chunk = false,
+    ChunkDetectorAlgorithms chunk_detector_algorithm = kChunkDetectorXor32,
+    int compression_level = 0);
   ~FileItem();
 
   static FileItem *CreateQuitBeacon() {
@@ -56,9 +58,11 @@ class FileItem : SingleCopy {
 
   std::string path() { return source_->GetPath(); }
   uint64_t size() { return size_; }
-  Xor32Detector *chunk_detector() { return &chunk_detector_; }
+  ChunkDetector *chunk_detector() { return chunk_detector_.weak_ref(); }
   shash::Any bulk_hash() { return bulk_hash_; }
+  shash::Any content_hash() { return content_hash_; }
   zlib::Algorithms compression_algorithm() { return compression_algorithm_; }
+  int compression_level() { return compression_level_; }
   shash::Algorithms hash_algorithm() { return hash_algorithm_; }
   shash::Suffix hash_suffix() { return hash_suffix_; }
   bool may_have_chunks() { return may_have_chunks_; }
@@ -66,6 +70,7 @@ class FileItem : SingleCopy {
 
   void set_size(uint64_t val) { size_ = val; }
   void set_may_have_chunks(bool val) { may_have_chunks_ = val; }
+  void set_content_hash(const shash::Any &val) { content_hash_ = val; }
   void set_is_fully_chunked() { atomic_inc32(&is_fully_chunked_); }
   bool is_fully_chunked() { return atomic_read32(&is_fully_chunked_) != 0; }
   uint64_t nchunks_in_fly() { return atomic_read64(&nchunks_in_fly_); }
@@ -79,6 +84,9 @@ class FileItem : SingleCopy {
   }
   bool Close() { return source_->Close(); }
   bool GetSize(uint64_t *size) { return source_->GetSize(size); }
+  bool IsRealFile() { return source_->IsRealFile(); }
+  bool Rewind() { return source_->Rewind(); }
+  int GetFd() { return source_->GetFd(); }
 
   // Called by ChunkItem constructor, decremented when a chunk is registered
   void IncNchunksInFly() { atomic_inc64(&nchunks_in_fly_); }
@@ -93,6 +101,7 @@ class FileItem : SingleCopy {
 
   UniquePtr<IngestionSource> source_;
   const zlib::Algorithms compression_algorithm_;
+  const int compression_level_;
   const shash::Algorithms hash_algorithm_;
   const shash::Suffix hash_suffix_;
   const bool has_legacy_bulk_chunk_;
@@ -100,9 +109,14 @@ class FileItem : SingleCopy {
   uint64_t size_;
   bool may_have_chunks_;
 
-  Xor32Detector chunk_detector_;
+  UniquePtr<ChunkDetector> chunk_detector_;
   shash::Any bulk_hash_;
   FileChunkList chunks_;
+  /**
+   * Hash of the uncompressed file content, only set if the pipeline maintains
+   * a content index
+   */
+  shash::Any content_hash_;
   /**
    * Number of chunks created but not yet uploaded and registered
    */
@@ -167,7 +181,11 @@ class ChunkItem : SingleCopy {
   UniquePtr<zlib::Compressor> compressor_;
   shash::ContextPtr hash_ctx_;
   shash::Any hash_value_;
-  unsigned char hash_ctx_buffer_[shash::kMaxContextSize];
+  /**
+   * Sized for the hash algorithm of the file; BLAKE3 contexts are much larger
+   * than the others.
+   */
+  std::vector<unsigned char> hash_ctx_buffer_;
 };
 
 
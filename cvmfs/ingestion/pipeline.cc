@@ -27,23 +27,37 @@ IngestionPipeline::IngestionPipeline(
   upload::AbstractUploader *uploader,
   const upload::SpoolerDefinition &spooler_definition)
   : compression_algorithm_(spooler_definition.compression_alg)
+  , compression_level_(spooler_definition.compression_level)
   , hash_algorithm_(spooler_definition.hash_algorithm)
   , generate_legacy_bulk_chunks_(spooler_definition.generate_legacy_bulk_chunks)
   , chunking_enabled_(spooler_definition.use_file_chunking)
   , minimal_chunk_size_(spooler_definition.min_file_chunk_size)
   , average_chunk_size_(spooler_definition.avg_file_chunk_size)
   , maximal_chunk_size_(spooler_definition.max_file_chunk_size)
+  , chunk_detector_algorithm_(spooler_definition.chunk_detector_algorithm)
   , spawned_(false)
   , uploader_(uploader)
   , tube_counter_(kMaxFilesInFlight)
 {
   unsigned nfork_base = std::max(1U, GetNumberOfCpuCores() / 8);
 
+  if (!spooler_definition.content_index_path.empty()) {
+    content_index_ = ContentIndex::Create(
+      spooler_definition.content_index_path, GetContentIndexSettings());
+    if (!content_index_.IsValid()) {
+      LogCvmfs(kLogSpooler, kLogStderr | kLogSyslogWarn,
+               "failed to load content index %s, processing all files",
+               spooler_definition.content_index_path.c_str());
+    }
+  }
+
   for (unsigned i = 0; i < nfork_base * kNforkRegister; ++i) {
     Tube<FileItem> *tube = new Tube<FileItem>();
     tubes_register_.TakeTube(tube);
     TaskRegister *task = new TaskRegister(tube, &tube_counter_);
     task->RegisterListener(&IngestionPipeline::OnFileProcessed, this);
+    if (content_index_.IsValid())
+      task->SetContentIndex(content_index_.weak_ref());
     tasks_register_.TakeConsumer(task);
   }
   tubes_register_.Activate();
@@ -92,6 +106,12 @@ IngestionPipeline::IngestionPipeline(
     TaskRead *task_read =
       new TaskRead(&tube_input_, &tubes_chunk_, &item_allocator_);
     task_read->SetWatermarks(low, high);
+    if (spooler_definition.async_read)
+      task_read->SetAsyncReader(AsyncReader::kIoUring);
+    if (content_index_.IsValid()) {
+      task_read->SetContentIndex(content_index_.weak_ref(), &tubes_register_,
+                                 uploader_);
+    }
     tasks_read_.TakeConsumer(task_read);
   }
 }
@@ -109,6 +129,22 @@ IngestionPipeline::~IngestionPipeline() {
 }
 
 
+/**
+ * Everything that changes the objects produced for a given file content
+ */
+std::string IngestionPipeline::GetContentIndexSettings() const {
+  return "hash=" + StringifyInt(hash_algorithm_) +
+    " compression=" + zlib::AlgorithmName(compression_algorithm_) +
+    " compression_level=" + StringifyInt(compression_level_) +
+    " legacy_bulk_chunks=" + StringifyBool(generate_legacy_bulk_chunks_) +
+    " chunks=" + StringifyUint(minimal_chunk_size_) + "/" +
+      StringifyUint(average_chunk_size_) + "/" +
+      StringifyUint(maximal_chunk_size_) +
+    " chunk_detector=" +
+      ChunkDetectorAlgorithmName(chunk_detector_algorithm_);
+}
+
+
 void IngestionPipeline::OnFileProcessed(
   const upload::SpoolerResult &spooler_result)
 {
@@ -130,7 +166,9 @@ void IngestionPipeline::Process(
     hash_algorithm_,
     hash_suffix,
     allow_chunking && chunking_enabled_,
-    generate_legacy_bulk_chunks_);
+    generate_legacy_bulk_chunks_,
+    chunk_detector_algorithm_,
+    compression_level_);
   tube_counter_.EnqueueBack(file_item);
   tube_input_.EnqueueBack(file_item);
 }
@@ -149,6 +187,8 @@ void IngestionPipeline::Spawn() {
 
 void IngestionPipeline::WaitFor() {
   tube_counter_.Wait();
+  if (content_index_.IsValid())
+    content_index_->Commit();
 }
 
 
@@ -9,12 +9,14 @@
 
 #include "compression.h"
 #include "crypto/hash.h"
+#include "ingestion/content_index.h"
 #include "ingestion/item.h"
 #include "ingestion/item_mem.h"
 #include "ingestion/task.h"
 #include "ingestion/tube.h"
 #include "upload_spooler_result.h"
 #include "util/concurrency.h"
+#include "util/pointer.h"
 
 namespace upload {
 class AbstractUploader;
@@ -36,6 +38,8 @@ class IngestionPipeline : public Observable<upload::SpoolerResult> {
   void OnFileProcessed(const upload::SpoolerResult &spooler_result);
 
  private:
+  std::string GetContentIndexSettings() const;
+
   static const uint64_t kMaxPipelineMem;  // 1G
   static const unsigned kMaxFilesInFlight = 8000;
   static const unsigned kNforkRegister = 1;
@@ -46,15 +50,21 @@ class IngestionPipeline : public Observable<upload::SpoolerResult> {
   static const unsigned kNforkRead = 8;
 
   const zlib::Algorithms compression_algorithm_;
+  const int compression_level_;
   const shash::Algorithms hash_algorithm_;
   const bool generate_legacy_bulk_chunks_;
   const bool chunking_enabled_;
   const size_t minimal_chunk_size_;
   const size_t average_chunk_size_;
   const size_t maximal_chunk_size_;
+  const ChunkDetectorAlgorithms chunk_detector_algorithm_;
 
   bool spawned_;
   upload::AbstractUploader *uploader_;
+  /**
+   * NULL unless enabled in the spooler definition
+   */
+  UniquePtr<ContentIndex> content_index_;
   // TODO(jblomer): a semaphore would be faster!
   Tube<FileItem> tube_counter_;
   Tube<FileItem> tube_input_;
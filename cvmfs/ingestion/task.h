@@ -43,17 +43,33 @@ class TubeConsumer : SingleCopy {
   Tube<ItemT> *tube_;
 
  private:
+  /**
+   * Items are taken from the tube in batches of up to kMaxBatch items.  Larger
+   * batches make consumers drain their tube and go to sleep more often.
+   */
+  static const unsigned kMaxBatch = 4;
+
   static void *MainConsumer(void *data) {
     TubeConsumer<ItemT> *consumer =
       reinterpret_cast<TubeConsumer<ItemT> *>(data);
 
-    while (true) {
-      ItemT *item = consumer->tube_->PopFront();
-      if (item->IsQuitBeacon()) {
-        delete item;
-        break;
+    std::vector<ItemT *> items;
+    items.reserve(kMaxBatch);
+    bool quit = false;
+    while (!quit) {
+      items.clear();
+      consumer->tube_->PopFrontBatch(kMaxBatch, &items);
+      for (unsigned i = 0; i < items.size(); ++i) {
+        if (items[i]->IsQuitBeacon()) {
+          delete items[i];
+          // Items behind the beacon, e.g. other consumers' beacons, go back
+          for (unsigned j = items.size() - 1; j > i; --j)
+            consumer->tube_->EnqueueFront(items[j]);
+          quit = true;
+          break;
+        }
+        consumer->Process(items[i]);
       }
-      consumer->Process(item);
     }
     consumer->OnTerminate();
     return NULL;
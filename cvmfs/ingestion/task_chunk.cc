@@ -72,7 +72,7 @@ void TaskChunk::Process(BlockItem *input_block) {
         block_stop->SetFileItem(file_item);
         block_stop->SetChunkItem(chunk_info.next_chunk);
         block_stop->MakeStop();
-        tubes_out_->Dispatch(block_stop);
+        blocks_out_.push_back(block_stop);
       }
       tag_map_.Erase(input_tag);
       break;
@@ -106,7 +106,7 @@ void TaskChunk::Process(BlockItem *input_block) {
             block_tail->SetChunkItem(chunk_info.next_chunk);
             block_tail->MakeDataCopy(input_block->data() + offset_in_block,
                                      tail_size);
-            tubes_out_->Dispatch(block_tail);
+            blocks_out_.push_back(block_tail);
           }
 
           assert(cut_mark >= chunk_info.next_chunk->offset());
@@ -120,7 +120,7 @@ void TaskChunk::Process(BlockItem *input_block) {
             block_stop->SetFileItem(file_item);
             block_stop->SetChunkItem(chunk_info.next_chunk);
             block_stop->MakeStop();
-            tubes_out_->Dispatch(block_stop);
+            blocks_out_.push_back(block_stop);
 
             chunk_info.next_chunk = new ChunkItem(file_item, cut_mark);
             chunk_info.output_tag_chunk = atomic_xadd64(&tag_seq_, 1);
@@ -138,7 +138,7 @@ void TaskChunk::Process(BlockItem *input_block) {
           block_tail->SetChunkItem(chunk_info.next_chunk);
           block_tail->MakeDataCopy(input_block->data() + offset_in_block,
                                    tail_size);
-          tubes_out_->Dispatch(block_tail);
+          blocks_out_.push_back(block_tail);
           chunk_info.offset += tail_size;
         }
 
@@ -154,5 +154,7 @@ void TaskChunk::Process(BlockItem *input_block) {
   }
 
   delete input_block;
-  if (output_block_bulk) tubes_out_->Dispatch(output_block_bulk);
+  if (output_block_bulk) blocks_out_.push_back(output_block_bulk);
+  tubes_out_->DispatchBatch(blocks_out_);
+  blocks_out_.clear();
 }
@@ -8,6 +8,7 @@
 #include <stdint.h>
 
 #include <map>
+#include <vector>
 
 #include "ingestion/item.h"
 #include "ingestion/task.h"
@@ -87,6 +88,10 @@ class TaskChunk : public TubeConsumer<BlockItem> {
   TubeGroup<BlockItem> *tubes_out_;
   ItemAllocator *allocator_;
   TagMap tag_map_;
+  /**
+   * Output blocks of the current input block, dispatched in one go
+   */
+  std::vector<BlockItem *> blocks_out_;
 };
 
 #endif  // CVMFS_INGESTION_TASK_CHUNK_H_
@@ -4,13 +4,18 @@
 
 #include "ingestion/task_read.h"
 
+#include <alloca.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstring>
+#include <string>
 
 #include "backoff.h"
+#include "ingestion/content_index.h"
+#include "upload_facility.h"
 #include "util/exception.h"
 #include "util/logging.h"
 #include "util/platform.h"
@@ -44,29 +49,77 @@ void TaskRead::Process(FileItem *item) {
       item->chunk_detector()->MightFindChunks(item->size()));
   }
 
-  unsigned char *buffer[kBlockSize];
+  // Unchanged files are looked up by the hash of their uncompressed content.
+  // On a miss, the file is read a second time, typically from the page cache.
+  const bool use_index = (content_index_ != NULL) && item->IsRealFile();
+  shash::ContextPtr hash_ctx(item->hash_algorithm());
+  if (use_index) {
+    shash::Any content_hash(item->hash_algorithm());
+    HashContent(item, &content_hash);
+    if (ReuseIndexedContent(item, content_hash))
+      return;
+    if (item->Rewind() == false) {
+      PANIC(kLogStderr, "failed to rewind %s (%d)", item->path().c_str(),
+            errno);
+    }
+    hash_ctx.buffer = alloca(hash_ctx.size);
+    shash::Init(hash_ctx);
+  }
+
+  // Data is read directly into the pipeline buffers, which are sized to the
+  // expected rest of the file.  Once the expected size is consumed, a small
+  // probe read detects the end of the file or content that was appended.
+  unsigned char probe[kPageSize];
+  uint64_t remaining = item->size();
   uint64_t tag = atomic_xadd64(&tag_seq_, 1);
+  if (async_reader_.IsValid() && (item->GetFd() >= 0) && (remaining > 0)) {
+    remaining =
+      ReadAsync(item, tag, use_index ? &hash_ctx : NULL, &throttle);
+  }
   ssize_t nbytes = -1;
   unsigned cnt = 0;
   do {
-    nbytes = item->Read(buffer, kBlockSize);
+    BlockItem *block_item = new BlockItem(tag, allocator_);
+    block_item->SetFileItem(item);
+    if (remaining > 0) {
+      block_item->MakeData(
+        std::min(static_cast<uint64_t>(kBlockSize), remaining));
+      nbytes = item->Read(block_item->data(), block_item->capacity());
+    } else {
+      nbytes = item->Read(probe, kPageSize);
+    }
     if (nbytes < 0) {
       PANIC(kLogStderr, "failed to read %s (%d)", item->path().c_str(), errno);
     }
 
-    BlockItem *block_item = new BlockItem(tag, allocator_);
-    block_item->SetFileItem(item);
     if (nbytes == 0) {
+      if (block_item->type() == BlockItem::kBlockData)
+        block_item->Reset();
       item->Close();
+      if (use_index) {
+        // Recorded by the register task, hashed again in case the file
+        // changed after the lookup
+        shash::Any content_hash(item->hash_algorithm());
+        shash::Final(hash_ctx, &content_hash);
+        item->set_content_hash(content_hash);
+      }
       block_item->MakeStop();
     } else {
-      block_item->MakeDataCopy(reinterpret_cast<unsigned char *>(buffer),
-                               nbytes);
+      if (block_item->type() == BlockItem::kBlockData) {
+        // Short reads are not necessarily the end of the file, e.g. for tar
+        // sources
+        block_item->set_size(nbytes);
+        remaining -= nbytes;
+      } else {
+        block_item->MakeDataCopy(probe, nbytes);
+      }
+      if (use_index)
+        shash::Update(block_item->data(), nbytes, hash_ctx);
     }
     tubes_out_->Dispatch(block_item);
 
     cnt++;
-    if ((cnt % 32) == 0) {
+    if ((cnt % kThrottleBlocks) == 0) {
       if ((high_watermark_ > 0) &&
           (BlockItem::managed_bytes() > high_watermark_))
       {
@@ -77,6 +130,179 @@ void TaskRead::Process(FileItem *item) {
 }
 
 
+/**
+ * Reads the expected size of a real file with up to kAsyncDepth blocks in
+ * flight and dispatches the blocks in order.  Stops at a short read, e.g. if
+ * the file shrank.  The file position is set behind the dispatched data, so
+ * that the synchronous read loop can continue from there and detect the end of
+ * the file or appended content.
+ *
+ * \return the number of bytes of the expected size that were not read
+ */
+uint64_t TaskRead::ReadAsync(
+  FileItem *item,
+  uint64_t tag,
+  shash::ContextPtr *hash_ctx,
+  BackoffThrottle *throttle)
+{
+  const int fd = item->GetFd();
+  const uint64_t size = item->size();
+  AsyncReader::Request requests[kAsyncDepth];
+  BlockItem *block_items[kAsyncDepth];
+  // Requests in flight form a ring starting at head
+  unsigned head = 0;
+  unsigned num_inflight = 0;
+  uint64_t offset_submit = 0;
+  uint64_t offset_dispatched = 0;
+  bool short_read = false;
+  unsigned cnt = 0;
+
+  while (true) {
+    while (!short_read && (num_inflight < kAsyncDepth) &&
+           (offset_submit < size))
+    {
+      const unsigned slot = (head + num_inflight) % kAsyncDepth;
+      BlockItem *block_item = new BlockItem(tag, allocator_);
+      block_item->SetFileItem(item);
+      block_item->MakeData(
+        std::min(static_cast<uint64_t>(kBlockSize), size - offset_submit));
+      block_items[slot] = block_item;
+      requests[slot] = AsyncReader::Request(fd, offset_submit,
+                                            block_item->data(),
+                                            block_item->capacity());
+      async_reader_->Submit(&requests[slot]);
+      offset_submit += block_item->capacity();
+      num_inflight++;
+    }
+    if (num_inflight == 0)
+      break;
+
+    async_reader_->Wait(&requests[head]);
+    BlockItem *block_item = block_items[head];
+    const int64_t nbytes = requests[head].result;
+    const bool is_short = nbytes < requests[head].size;
+    head = (head + 1) % kAsyncDepth;
+    num_inflight--;
+
+    // Data behind a short read is not contiguous, it is read again
+    if (short_read || (nbytes == 0)) {
+      delete block_item;
+      short_read = true;
+      continue;
+    }
+    if (nbytes < 0) {
+      PANIC(kLogStderr, "failed to read %s (%d)", item->path().c_str(),
+            static_cast<int>(-nbytes));
+    }
+    short_read = is_short;
+
+    block_item->set_size(nbytes);
+    if (hash_ctx != NULL)
+      shash::Update(block_item->data(), nbytes, *hash_ctx);
+    tubes_out_->Dispatch(block_item);
+    offset_dispatched += nbytes;
+
+    cnt++;
+    if ((cnt % kThrottleBlocks) == 0) {
+      if ((high_watermark_ > 0) &&
+          (BlockItem::managed_bytes() > high_watermark_))
+      {
+        throttle->Throttle();
+      }
+    }
+  }
+
+  const off_t offset = static_cast<off_t>(offset_dispatched);
+  if (lseek(fd, offset, SEEK_SET) != offset) {
+    PANIC(kLogStderr, "failed to seek in %s (%d)", item->path().c_str(),
+          errno);
+  }
+  return size - offset_dispatched;
+}
+
+
+void TaskRead::HashContent(FileItem *item, shash::Any *content_hash) {
+  shash::ContextPtr hash_ctx(item->hash_algorithm());
+  hash_ctx.buffer = alloca(hash_ctx.size);
+  shash::Init(hash_ctx);
+
+  unsigned char buffer[kBlockSize];
+  ssize_t nbytes;
+  while ((nbytes = item->Read(buffer, kBlockSize)) != 0) {
+    if (nbytes < 0) {
+      PANIC(kLogStderr, "failed to read %s (%d)", item->path().c_str(), errno);
+    }
+    shash::Update(buffer, nbytes, hash_ctx);
+  }
+  shash::Final(hash_ctx, content_hash);
+}
+
+
+/**
+ * Registers the chunks of an indexed file and sends it directly to the
+ * register task.  Returns false if the file is not in the index or if any of
+ * its objects vanished from the backend storage.
+ */
+bool TaskRead::ReuseIndexedContent(
+  FileItem *item,
+  const shash::Any &content_hash)
+{
+  ContentIndex::Key key(content_hash, item->size(), item->hash_suffix(),
+                        item->may_have_chunks());
+  ContentIndex::Entry entry;
+  if (!content_index_->Lookup(key, &entry))
+    return false;
+  if (entry.compression_algorithm != item->compression_algorithm())
+    return false;
+  if (entry.bulk_hash.IsNull() && item->has_legacy_bulk_chunk())
+    return false;
+
+  if (!entry.bulk_hash.IsNull() &&
+      !uploader_->Peek("data/" + entry.bulk_hash.MakePath()))
+  {
+    return false;
+  }
+  for (unsigned i = 0; i < entry.chunks.size(); ++i) {
+    if (!uploader_->Peek("data/" + entry.chunks[i].content_hash().MakePath()))
+      return false;
+  }
+
+  item->Close();
+  for (unsigned i = 0; i < entry.chunks.size(); ++i) {
+    item->IncNchunksInFly();
+    item->RegisterChunk(entry.chunks[i]);
+  }
+  if (!entry.bulk_hash.IsNull()) {
+    item->IncNchunksInFly();
+    item->RegisterChunk(FileChunk(entry.bulk_hash, 0, item->size()));
+  }
+  item->set_is_fully_chunked();
+  atomic_inc64(&n_reuse_);
+  LogCvmfs(kLogSpooler, kLogVerboseMsg, "reusing indexed content for %s",
+           item->path().c_str());
+  tubes_register_->DispatchAny(item);
+  return true;
+}
+
+
+void TaskRead::SetAsyncReader(AsyncReader::Type type) {
+  async_reader_ = AsyncReader::Create(type, kAsyncDepth);
+}
+
+
+void TaskRead::SetContentIndex(
+  ContentIndex *content_index,
+  TubeGroup<FileItem> *tubes_register,
+  upload::AbstractUploader *uploader)
+{
+  assert((content_index != NULL) && (tubes_register != NULL) &&
+         (uploader != NULL));
+  content_index_ = content_index;
+  tubes_register_ = tubes_register;
+  uploader_ = uploader;
+}
+
+
 void TaskRead::SetWatermarks(uint64_t low, uint64_t high) {
   assert(high > low);
   assert(low > 0);
@@ -7,20 +7,41 @@
 
 #include <stdint.h>
 
+#include "crypto/hash.h"
+#include "ingestion/async_reader.h"
 #include "ingestion/item.h"
 #include "ingestion/task.h"
 #include "ingestion/tube.h"
 #include "util/atomic.h"
+#include "util/pointer.h"
 #include "util/posix.h"
 
+class BackoffThrottle;
+class ContentIndex;
 class ItemAllocator;
+namespace upload {
+class AbstractUploader;
+}
 
 class TaskRead : public TubeConsumer<FileItem> {
  public:
   static const unsigned kThrottleInitMs = 50;
   static const unsigned kThrottleMaxMs = 500;
   static const unsigned kThrottleResetMs = 2000;
-  static const unsigned kBlockSize = kPageSize * 4;
+  /**
+   * Maximum size of the blocks read into the pipeline.  Large blocks reduce
+   * the number of system calls and of items passed through the tubes for
+   * large files.  Smaller files are read into blocks of their size.
+   */
+  static const unsigned kBlockSize = kPageSize * 32;
+  /**
+   * Check the watermarks every kThrottleBlocks blocks of a file
+   */
+  static const unsigned kThrottleBlocks = 4;
+  /**
+   * Number of blocks of a file in flight with the asynchronous reader
+   */
+  static const unsigned kAsyncDepth = 4;
 
   TaskRead(
     Tube<FileItem> *tube_in,
@@ -31,16 +52,41 @@ class TaskRead : public TubeConsumer<FileItem> {
     , allocator_(allocator)
     , low_watermark_(0)
     , high_watermark_(0)
-  { atomic_init64(&n_block_); }
+    , content_index_(NULL)
+    , tubes_register_(NULL)
+    , uploader_(NULL)
+  {
+    atomic_init64(&n_block_);
+    atomic_init64(&n_reuse_);
+  }
 
   void SetWatermarks(uint64_t low, uint64_t high);
+  /**
+   * Reads real files with kAsyncDepth blocks in flight instead of block by
+   * block.
+   */
+  void SetAsyncReader(AsyncReader::Type type);
+  /**
+   * Files found in the content index skip the rest of the pipeline and are
+   * handed over directly to the register tubes.  The uploader is used to
+   * verify that the indexed objects still exist.
+   */
+  void SetContentIndex(ContentIndex *content_index,
+                       TubeGroup<FileItem> *tubes_register,
+                       upload::AbstractUploader *uploader);
 
   uint64_t n_block() { return atomic_read64(&n_block_); }
+  uint64_t n_reuse() { return atomic_read64(&n_reuse_); }
 
  protected:
   virtual void Process(FileItem *item);
 
  private:
+  void HashContent(FileItem *item, shash::Any *content_hash);
+  uint64_t ReadAsync(FileItem *item, uint64_t tag, shash::ContextPtr *hash_ctx,
+                     BackoffThrottle *throttle);
+  bool ReuseIndexedContent(FileItem *item, const shash::Any &content_hash);
+
   /**
    * Every new file increases the tag sequence counter that is used to annotate
    * BlockItems.
@@ -63,6 +109,17 @@ class TaskRead : public TubeConsumer<FileItem> {
    * Number of times reading was blocked on a high watermark.
    */
   atomic_int64 n_block_;
+  ContentIndex *content_index_;
+  TubeGroup<FileItem> *tubes_register_;
+  upload::AbstractUploader *uploader_;
+  /**
+   * Number of files that were found in the content index
+   */
+  atomic_int64 n_reuse_;
+  /**
+   * NULL unless set by SetAsyncReader()
+   */
+  UniquePtr<AsyncReader> async_reader_;
 };
 
 #endif  // CVMFS_INGESTION_TASK_READ_H_
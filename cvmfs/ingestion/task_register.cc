@@ -26,6 +26,19 @@ void TaskRegister::Process(FileItem *file_item) {
            file_item->bulk_hash().ToString().c_str(),
            file_item->hash_suffix());
 
+  if ((content_index_ != NULL) && !file_item->content_hash().IsNull()) {
+    ContentIndex::Key key(file_item->content_hash(), file_item->size(),
+                          file_item->hash_suffix(),
+                          file_item->may_have_chunks());
+    ContentIndex::Entry entry;
+    entry.bulk_hash = file_item->bulk_hash();
+    FileChunkList *chunks = file_item->GetChunksPtr();
+    for (unsigned i = 0; i < chunks->size(); ++i)
+      entry.chunks.push_back(chunks->At(i));
+    entry.compression_algorithm = file_item->compression_algorithm();
+    content_index_->Insert(key, entry);
+  }
+
   NotifyListeners(upload::SpoolerResult(0,
     file_item->path(),
     file_item->bulk_hash(),
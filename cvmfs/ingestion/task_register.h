@@ -5,6 +5,7 @@
 #ifndef CVMFS_INGESTION_TASK_REGISTER_H_
 #define CVMFS_INGESTION_TASK_REGISTER_H_
 
+#include "ingestion/content_index.h"
 #include "ingestion/item.h"
 #include "ingestion/task.h"
 #include "ingestion/tube.h"
@@ -25,13 +26,22 @@ class TaskRegister
                Tube<FileItem> *tube_counter)
     : TubeConsumer<FileItem>(tube_in)
     , tube_counter_(tube_counter)
+    , content_index_(NULL)
   { }
 
+  /**
+   * Processed files with a content hash are recorded in the content index
+   */
+  void SetContentIndex(ContentIndex *content_index) {
+    content_index_ = content_index;
+  }
+
  protected:
   virtual void Process(FileItem *file_item);
 
  private:
   Tube<FileItem> *tube_counter_;
+  ContentIndex *content_index_;
 };  // class TaskRegister
 
 #endif  // CVMFS_INGESTION_TASK_REGISTER_H_
@@ -8,6 +8,7 @@
 #include <pthread.h>
 #include <stdint.h>
 
+#include <algorithm>
 #include <cassert>
 #include <vector>
 
@@ -33,7 +34,9 @@
  * limit for the tube size is set.
  *
  * Internally, uses conditional variables to block when threads try to pop from
- * the empty tube or insert into the full tube.
+ * the empty tube or insert into the full tube.  Links are allocated and freed
+ * outside the critical section and waiting threads are only signaled if there
+ * are any.  The batch functions move many items with a single lock round trip.
  */
 template <class ItemT>
 class Tube : SingleCopy {
@@ -50,8 +53,16 @@ class Tube : SingleCopy {
     Link *prev_;
   };
 
-  Tube() : limit_(uint64_t(-1)), size_(0) { Init(); }
-  explicit Tube(uint64_t limit) : limit_(limit), size_(0) {
+  Tube()
+    : limit_(uint64_t(-1)), size_(0)
+    , num_waiting_pop_(0), num_waiting_push_(0), num_waiting_empty_(0)
+  {
+    Init();
+  }
+  explicit Tube(uint64_t limit)
+    : limit_(limit), size_(0)
+    , num_waiting_pop_(0), num_waiting_push_(0), num_waiting_empty_(0)
+  {
     Init();
   }
   ~Tube() {
@@ -72,38 +83,56 @@ class Tube : SingleCopy {
    */
   Link *EnqueueBack(ItemT *item) {
     assert(item != NULL);
-    MutexLockGuard lock_guard(&lock_);
-    while (size_ == limit_)
-      pthread_cond_wait(&cond_capacious_, &lock_);
-
     Link *link = new Link(item);
-    link->next_ = head_->next_;
-    link->prev_ = head_;
-    head_->next_->prev_ = link;
-    head_->next_ = link;
+    MutexLockGuard lock_guard(&lock_);
+    WaitCapacious();
+    LinkBackUnlocked(link);
     size_++;
-    int retval = pthread_cond_signal(&cond_populated_);
-    assert(retval == 0);
+    SignalPopulated(1);
     return link;
   }
 
+  /**
+   * Pushes the items to the back of the queue in the given order.  Blocks
+   * while the queue is full; in this case, the items might be interleaved
+   * with items of other producers.
+   */
+  void EnqueueBackBatch(const std::vector<ItemT *> &items) {
+    if (items.empty())
+      return;
+    std::vector<Link *> links(items.size());
+    for (unsigned i = 0; i < items.size(); ++i) {
+      assert(items[i] != NULL);
+      links[i] = new Link(items[i]);
+    }
+
+    MutexLockGuard lock_guard(&lock_);
+    unsigned i = 0;
+    while (i < links.size()) {
+      WaitCapacious();
+      unsigned n = 0;
+      for (; (i < links.size()) && (size_ < limit_); ++i, ++n) {
+        LinkBackUnlocked(links[i]);
+        size_++;
+      }
+      SignalPopulated(n);
+    }
+  }
+
   /**
    * Push an item to the front of the queue. Block if queue currently full.
    */
   Link *EnqueueFront(ItemT *item) {
     assert(item != NULL);
-    MutexLockGuard lock_guard(&lock_);
-    while (size_ == limit_)
-      pthread_cond_wait(&cond_capacious_, &lock_);
-
     Link *link = new Link(item);
+    MutexLockGuard lock_guard(&lock_);
+    WaitCapacious();
     link->next_ = head_;
     link->prev_ = head_->prev_;
     head_->prev_->next_ = link;
     head_->prev_ = link;
     size_++;
-    int retval = pthread_cond_signal(&cond_populated_);
-    assert(retval == 0);
+    SignalPopulated(1);
     return link;
   }
 
@@ -112,8 +141,13 @@ class Tube : SingleCopy {
    * element.
    */
   ItemT *Slice(Link *link) {
-    MutexLockGuard lock_guard(&lock_);
-    return SliceUnlocked(link);
+    ItemT *item;
+    {
+      MutexLockGuard lock_guard(&lock_);
+      item = SliceUnlocked(link);
+    }
+    delete link;
+    return item;
   }
 
   /**
@@ -121,10 +155,54 @@ class Tube : SingleCopy {
    * empty.
    */
   ItemT *PopFront() {
-    MutexLockGuard lock_guard(&lock_);
-    while (size_ == 0)
-      pthread_cond_wait(&cond_populated_, &lock_);
-    return SliceUnlocked(head_->prev_);
+    Link *link;
+    ItemT *item;
+    {
+      MutexLockGuard lock_guard(&lock_);
+      WaitPopulated();
+      link = head_->prev_;
+      item = SliceUnlocked(link);
+    }
+    delete link;
+    return item;
+  }
+
+  /**
+   * Removes up to max_items elements from the front of the queue and appends
+   * them to items in FIFO order.  Blocks if the tube is empty.  If other
+   * threads wait for items, leaves them a fair share.  Returns the number of
+   * removed items.
+   */
+  unsigned PopFrontBatch(unsigned max_items, std::vector<ItemT *> *items) {
+    assert(max_items > 0);
+    Link *first;
+    unsigned n;
+    {
+      MutexLockGuard lock_guard(&lock_);
+      WaitPopulated();
+      uint64_t share = size_ / (num_waiting_pop_ + 1);
+      n = std::max(uint64_t(1), std::min(uint64_t(max_items), share));
+
+      // Detach the n front links as a chain linked through prev_
+      first = head_->prev_;
+      Link *last = first;
+      for (unsigned i = 1; i < n; ++i)
+        last = last->prev_;
+      head_->prev_ = last->prev_;
+      last->prev_->next_ = head_;
+      last->prev_ = NULL;
+      size_ -= n;
+      SignalConsumed(n);
+    }
+
+    Link *link = first;
+    while (link != NULL) {
+      Link *prev = link->prev_;
+      items->push_back(link->item_);
+      delete link;
+      link = prev;
+    }
+    return n;
   }
 
   /**
@@ -132,10 +210,16 @@ class Tube : SingleCopy {
    * empty.
    */
   ItemT *PopBack() {
-    MutexLockGuard lock_guard(&lock_);
-    while (size_ == 0)
-      pthread_cond_wait(&cond_populated_, &lock_);
-    return SliceUnlocked(head_->next_);
+    Link *link;
+    ItemT *item;
+    {
+      MutexLockGuard lock_guard(&lock_);
+      WaitPopulated();
+      link = head_->next_;
+      item = SliceUnlocked(link);
+    }
+    delete link;
+    return item;
   }
 
   /**
@@ -143,8 +227,11 @@ class Tube : SingleCopy {
    */
   void Wait() {
     MutexLockGuard lock_guard(&lock_);
-    while (size_ > 0)
+    while (size_ > 0) {
+      num_waiting_empty_++;
       pthread_cond_wait(&cond_empty_, &lock_);
+      num_waiting_empty_--;
+    }
   }
 
   bool IsEmpty() {
@@ -173,21 +260,67 @@ class Tube : SingleCopy {
     assert(retval == 0);
   }
 
+  /**
+   * Unlinks the link but leaves its deletion to the caller, outside the lock
+   */
   ItemT *SliceUnlocked(Link *link) {
     // Cannot delete the sentinel link
     assert(link != head_);
     link->prev_->next_ = link->next_;
     link->next_->prev_ = link->prev_;
-    ItemT *item = link->item_;
-    delete link;
     size_--;
-    int retval = pthread_cond_signal(&cond_capacious_);
+    SignalConsumed(1);
+    return link->item_;
+  }
+
+  void LinkBackUnlocked(Link *link) {
+    link->next_ = head_->next_;
+    link->prev_ = head_;
+    head_->next_->prev_ = link;
+    head_->next_ = link;
+  }
+
+  void WaitPopulated() {
+    while (size_ == 0) {
+      num_waiting_pop_++;
+      pthread_cond_wait(&cond_populated_, &lock_);
+      num_waiting_pop_--;
+    }
+  }
+
+  void WaitCapacious() {
+    while (size_ >= limit_) {
+      num_waiting_push_++;
+      pthread_cond_wait(&cond_capacious_, &lock_);
+      num_waiting_push_--;
+    }
+  }
+
+  /**
+   * Called after n items have been added
+   */
+  void SignalPopulated(unsigned n) {
+    if (num_waiting_pop_ == 0)
+      return;
+    int retval = (n == 1) ? pthread_cond_signal(&cond_populated_)
+                          : pthread_cond_broadcast(&cond_populated_);
     assert(retval == 0);
-    if (size_ == 0) {
+  }
+
+  /**
+   * Called after n items have been removed
+   */
+  void SignalConsumed(unsigned n) {
+    int retval;
+    if (num_waiting_push_ > 0) {
+      retval = (n == 1) ? pthread_cond_signal(&cond_capacious_)
+                        : pthread_cond_broadcast(&cond_capacious_);
+      assert(retval == 0);
+    }
+    if ((size_ == 0) && (num_waiting_empty_ > 0)) {
       retval = pthread_cond_broadcast(&cond_empty_);
       assert(retval == 0);
     }
-    return item;
   }
 
 
@@ -199,6 +332,13 @@ class Tube : SingleCopy {
    * The current number of links in the list
    */
   uint64_t size_;
+  /**
+   * Number of threads blocked in a pop, a push, or in Wait().  Used to skip
+   * signaling condition variables nobody waits for.
+   */
+  unsigned num_waiting_pop_;
+  unsigned num_waiting_push_;
+  unsigned num_waiting_empty_;
   /**
    * Sentinel element in front of the first (front) element
    */
@@ -260,6 +400,23 @@ class TubeGroup : SingleCopy {
     return tubes_[tube_idx]->EnqueueBack(item);
   }
 
+  /**
+   * Like Dispatch() for a sequence of items.  Items that go to the same tube
+   * are enqueued with a single EnqueueBackBatch() call and keep their order.
+   */
+  void DispatchBatch(const std::vector<ItemT *> &items) {
+    assert(is_active_);
+    if (tubes_.size() == 1) {
+      tubes_[0]->EnqueueBackBatch(items);
+      return;
+    }
+    std::vector<std::vector<ItemT *> > batches(tubes_.size());
+    for (unsigned i = 0; i < items.size(); ++i)
+      batches[items[i]->tag() % tubes_.size()].push_back(items[i]);
+    for (unsigned i = 0; i < batches.size(); ++i)
+      tubes_[i]->EnqueueBackBatch(batches[i]);
+  }
+
   /**
    * Like Tube::EnqueueBack(), use tubes one after another
    */
@@ -46,8 +46,6 @@ MemoryKvStore::MemoryKvStore(
   , heap_(NULL)
   , counters_(statistics)
 {
-  int retval = pthread_rwlock_init(&rwlock_, NULL);
-  assert(retval == 0);
   switch (alloc) {
     case kMallocHeap:
       heap_ = new MallocHeap(alloc_size,
@@ -61,7 +59,6 @@ MemoryKvStore::MemoryKvStore(
 
 MemoryKvStore::~MemoryKvStore() {
   delete heap_;
-  pthread_rwlock_destroy(&rwlock_);
 }
 
 
@@ -88,8 +85,8 @@ void MemoryKvStore::OnBlockMove(const MallocHeap::BlockPtr &ptr) {
 bool MemoryKvStore::Contains(const shash::Any &id) {
   MemoryBuffer buf;
   // LogCvmfs(kLogKvStore, kLogDebug, "check buffer %s", id.ToString().c_str());
-  const bool update_lru = false;
-  return entries_.Lookup(id, &buf, update_lru);
+  EpochReadGuard guard(&lock_);
+  return entries_.Peek(id, &buf);
 }
 
 
@@ -166,8 +163,8 @@ bool MemoryKvStore::CompactMemory() {
 int64_t MemoryKvStore::GetSize(const shash::Any &id) {
   MemoryBuffer mem;
   perf::Inc(counters_.n_getsize);
-  const bool update_lru = false;
-  if (entries_.Lookup(id, &mem, update_lru)) {
+  EpochReadGuard guard(&lock_);
+  if (entries_.Peek(id, &mem)) {
     // LogCvmfs(kLogKvStore, kLogDebug, "%s is %u B", id.ToString().c_str(),
     //          mem.size);
     return mem.size;
@@ -182,8 +179,8 @@ int64_t MemoryKvStore::GetSize(const shash::Any &id) {
 int64_t MemoryKvStore::GetRefcount(const shash::Any &id) {
   MemoryBuffer mem;
   perf::Inc(counters_.n_getrefcount);
-  const bool update_lru = false;
-  if (entries_.Lookup(id, &mem, update_lru)) {
+  EpochReadGuard guard(&lock_);
+  if (entries_.Peek(id, &mem)) {
     // LogCvmfs(kLogKvStore, kLogDebug, "%s has refcount %u",
     //          id.ToString().c_str(), mem.refcount);
     return mem.refcount;
@@ -197,7 +194,7 @@ int64_t MemoryKvStore::GetRefcount(const shash::Any &id) {
 
 bool MemoryKvStore::IncRef(const shash::Any &id) {
   perf::Inc(counters_.n_incref);
-  WriteLockGuard guard(rwlock_);
+  EpochWriteGuard guard(&lock_);
   MemoryBuffer mem;
   if (entries_.Lookup(id, &mem)) {
     assert(mem.refcount < UINT_MAX);
@@ -216,7 +213,7 @@ bool MemoryKvStore::IncRef(const shash::Any &id) {
 
 bool MemoryKvStore::Unref(const shash::Any &id) {
   perf::Inc(counters_.n_unref);
-  WriteLockGuard guard(rwlock_);
+  EpochWriteGuard guard(&lock_);
   MemoryBuffer mem;
   if (entries_.Lookup(id, &mem)) {
     assert(mem.refcount > 0);
@@ -241,8 +238,8 @@ int64_t MemoryKvStore::Read(
 ) {
   MemoryBuffer mem;
   perf::Inc(counters_.n_read);
-  ReadLockGuard guard(rwlock_);
-  if (!entries_.Lookup(id, &mem)) {
+  EpochReadGuard guard(&lock_);
+  if (!entries_.Peek(id, &mem)) {
     LogCvmfs(kLogKvStore, kLogDebug, "miss %s on Read", id.ToString().c_str());
     return -ENOENT;
   }
@@ -261,7 +258,7 @@ int64_t MemoryKvStore::Read(
 
 
 int MemoryKvStore::Commit(const MemoryBuffer &buf) {
-  WriteLockGuard guard(rwlock_);
+  EpochWriteGuard guard(&lock_);
   return DoCommit(buf);
 }
 
@@ -320,7 +317,7 @@ int MemoryKvStore::DoCommit(const MemoryBuffer &buf) {
 
 bool MemoryKvStore::Delete(const shash::Any &id) {
   perf::Inc(counters_.n_delete);
-  WriteLockGuard guard(rwlock_);
+  EpochWriteGuard guard(&lock_);
   return DoDelete(id);
 }
 
@@ -351,7 +348,7 @@ bool MemoryKvStore::DoDelete(const shash::Any &id) {
 
 bool MemoryKvStore::ShrinkTo(size_t size) {
   perf::Inc(counters_.n_shrinkto);
-  WriteLockGuard guard(rwlock_);
+  EpochWriteGuard guard(&lock_);
   shash::Any key;
   MemoryBuffer buf;
 
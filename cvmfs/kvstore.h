@@ -16,6 +16,7 @@
 #include "malloc_heap.h"
 #include "statistics.h"
 #include "util/async.h"
+#include "util/concurrency.h"
 #include "util/single_copy.h"
 
 using namespace std;  // NOLINT
@@ -62,6 +63,12 @@ struct MemoryBuffer {
  * mid-operation, and decrement the reference count when done. The store
  * can attempt to reduce its size by removing the least recently used
  * entries without any outstanding references.
+ *
+ * Lookups and reads only take the read side of an EpochLock and do not change
+ * the LRU order, so concurrent reads of hot objects do not serialize.  An
+ * object being read is pinned by the reference taken when it was opened;
+ * all modifications, including moving and freeing object memory, wait for
+ * the readers to drain.  The recency of an entry is updated on IncRef().
  */
 class MemoryKvStore : SingleCopy, public Callbackable<MallocHeap::BlockPtr> {
  public:
@@ -95,14 +102,15 @@ class MemoryKvStore : SingleCopy, public Callbackable<MallocHeap::BlockPtr> {
         "Number of IncRef calls");
       n_unref = statistics.RegisterTemplated("n_unref",
         "Number of Unref calls");
-      n_read = statistics.RegisterTemplated("n_read", "Number of Read calls");
+      n_read = statistics.RegisterShardedTemplated("n_read",
+        "Number of Read calls");
       n_commit = statistics.RegisterTemplated("n_commit",
         "Number of Commit calls");
       n_delete = statistics.RegisterTemplated("n_delete",
         "Number of Delete calls");
       n_shrinkto = statistics.RegisterTemplated("n_shrinkto",
         "Number of ShrinkTo calls");
-      sz_read = statistics.RegisterTemplated("sz_read", "Bytes read");
+      sz_read = statistics.RegisterShardedTemplated("sz_read", "Bytes read");
       sz_committed = statistics.RegisterTemplated("sz_committed",
         "Bytes committed");
       sz_deleted = statistics.RegisterTemplated("sz_deleted", "Bytes deleted");
@@ -216,7 +224,7 @@ class MemoryKvStore : SingleCopy, public Callbackable<MallocHeap::BlockPtr> {
   unsigned int max_entries_;
   lru::LruCache<shash::Any, MemoryBuffer> entries_;
   MallocHeap *heap_;
-  pthread_rwlock_t rwlock_;
+  EpochLock lock_;
   Counters counters_;
 };
 
@@ -0,0 +1,151 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "listing_cache.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "malloc_arena.h"
+#include "util/concurrency.h"
+#include "util/murmur.hxx"
+
+using namespace std;  // NOLINT
+
+namespace cvmfs {
+
+const unsigned DirectoryListingCache::kMaxListingFraction;
+
+
+DirectoryListingCache::DirectoryListingCache(
+  const unsigned arena_size,
+  perf::StatisticsTemplate statistics)
+  : arena_(new MallocArena(arena_size))
+  , max_listing_size_(arena_size / kMaxListingFraction)
+{
+  int retval = pthread_mutex_init(&lock_, NULL);
+  assert(retval == 0);
+  entries_.Init(1024, Key(uint64_t(-1), uint64_t(-1), uint64_t(-1)),
+                HashKey);
+  head_.size = 0;
+  head_.prev = head_.next = &head_;
+
+  n_hit_ = statistics.RegisterTemplated("n_hit",
+    "overall number of directory listings served from the cache");
+  n_miss_ = statistics.RegisterTemplated("n_miss",
+    "overall number of directory listings not found in the cache");
+  n_insert_ = statistics.RegisterTemplated("n_insert",
+    "overall number of directory listings added to the cache");
+  n_evict_ = statistics.RegisterTemplated("n_evict",
+    "overall number of directory listings evicted from the cache");
+  n_too_large_ = statistics.RegisterTemplated("n_too_large",
+    "overall number of directory listings too large for the cache");
+  sz_listings_ = statistics.RegisterTemplated("sz_listings",
+    "number of bytes used by cached directory listings");
+}
+
+
+DirectoryListingCache::~DirectoryListingCache() {
+  // The entries live in the arena, which is unmapped as a whole
+  delete arena_;
+  pthread_mutex_destroy(&lock_);
+}
+
+
+uint32_t DirectoryListingCache::HashKey(const Key &key) {
+  return MurmurHash2(&key.inode, sizeof(key.inode), 0x07387a4f) ^
+         static_cast<uint32_t>(key.revision) ^
+         static_cast<uint32_t>(key.incarnation << 16);
+}
+
+
+void DirectoryListingCache::Unlink(Entry *entry) {
+  entry->prev->next = entry->next;
+  entry->next->prev = entry->prev;
+}
+
+
+void DirectoryListingCache::PushFront(Entry *entry) {
+  entry->prev = &head_;
+  entry->next = head_.next;
+  head_.next->prev = entry;
+  head_.next = entry;
+}
+
+
+void DirectoryListingCache::Evict(Entry *entry) {
+  Unlink(entry);
+  entries_.Erase(entry->key);
+  perf::Xadd(sz_listings_, -static_cast<int64_t>(entry->size));
+  perf::Inc(n_evict_);
+  arena_->Free(entry);
+}
+
+
+bool DirectoryListingCache::Lookup(
+  const uint64_t inode,
+  const uint64_t revision,
+  const uint64_t incarnation,
+  BigVector<char> *listing)
+{
+  MutexLockGuard m(&lock_);
+  Entry *entry;
+  if (!entries_.Lookup(Key(inode, revision, incarnation), &entry)) {
+    perf::Inc(n_miss_);
+    return false;
+  }
+  Unlink(entry);
+  PushFront(entry);
+
+  while (listing->capacity() < entry->size)
+    listing->DoubleCapacity();
+  char *buffer;
+  bool large_alloc;
+  listing->ShareBuffer(&buffer, &large_alloc);
+  memcpy(buffer, entry->data(), entry->size);
+  listing->SetSize(entry->size);
+  perf::Inc(n_hit_);
+  return true;
+}
+
+
+bool DirectoryListingCache::Insert(
+  const uint64_t inode,
+  const uint64_t revision,
+  const uint64_t incarnation,
+  const char *listing,
+  const uint32_t size)
+{
+  if (size > max_listing_size_) {
+    perf::Inc(n_too_large_);
+    return false;
+  }
+
+  MutexLockGuard m(&lock_);
+  const Key key(inode, revision, incarnation);
+  Entry *entry;
+  if (entries_.Lookup(key, &entry)) {
+    // Another thread built the same listing concurrently
+    return false;
+  }
+
+  void *mem;
+  while ((mem = arena_->Malloc(sizeof(Entry) + size)) == NULL) {
+    // Cannot fail before the arena is empty because size is bounded
+    assert(head_.prev != &head_);
+    Evict(head_.prev);
+  }
+  entry = reinterpret_cast<Entry *>(mem);
+  entry->key = key;
+  entry->size = size;
+  memcpy(entry->data(), listing, size);
+  PushFront(entry);
+  entries_.Insert(key, entry);
+  perf::Xadd(sz_listings_, size);
+  perf::Inc(n_insert_);
+  return true;
+}
+
+}  // namespace cvmfs
@@ -0,0 +1,117 @@
+/**
+ * This file is part of the CernVM File System.
+ *
+ * Cache of serialized directory listings shared by all directory handles of
+ * the fuse module.
+ */
+
+#ifndef CVMFS_LISTING_CACHE_H_
+#define CVMFS_LISTING_CACHE_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "bigvector.h"
+#include "gtest/gtest_prod.h"
+#include "smallhash.h"
+#include "statistics.h"
+#include "util/single_copy.h"
+
+class MallocArena;
+
+namespace cvmfs {
+
+/**
+ * LRU cache of directory listings in the format produced by
+ * fuse_add_direntry() (names plus inode and file type).  Listings are keyed by
+ * the directory inode, the catalog revision, and the catalog manager's
+ * incarnation, so that neither a new revision nor detached catalogs, whose
+ * inodes are reassigned when they are attached again, need to invalidate the
+ * cache explicitly; stale listings age out.
+ *
+ * Listings are stored in a single MallocArena together with their control
+ * block.  If the arena is full, the least recently used listings are removed
+ * until the new listing fits.  Listings larger than a fraction of the arena
+ * are not cached.
+ *
+ * Hits copy the listing into the caller's buffer, which is owned by the
+ * directory handle.
+ */
+class DirectoryListingCache : SingleCopy {
+  FRIEND_TEST(T_DirectoryListingCache, Lru);
+
+ public:
+  /**
+   * A single listing must not use more than 1/kMaxListingFraction of the arena
+   */
+  static const unsigned kMaxListingFraction = 8;
+
+  /**
+   * The arena size needs to be a multiple of 2MB, see MallocArena.
+   */
+  DirectoryListingCache(const unsigned arena_size,
+                        perf::StatisticsTemplate statistics);
+  ~DirectoryListingCache();
+
+  bool Lookup(const uint64_t inode, const uint64_t revision,
+              const uint64_t incarnation, BigVector<char> *listing);
+  bool Insert(const uint64_t inode, const uint64_t revision,
+              const uint64_t incarnation,
+              const char *listing, const uint32_t size);
+
+  uint32_t max_listing_size() const { return max_listing_size_; }
+
+ private:
+  struct Key {
+    Key() : inode(0), revision(0), incarnation(0) { }
+    Key(const uint64_t i, const uint64_t r, const uint64_t c)
+      : inode(i), revision(r), incarnation(c) { }
+    bool operator ==(const Key &other) const {
+      return (inode == other.inode) && (revision == other.revision) &&
+             (incarnation == other.incarnation);
+    }
+    bool operator !=(const Key &other) const { return !(*this == other); }
+    uint64_t inode;
+    uint64_t revision;
+    uint64_t incarnation;
+  };
+
+  /**
+   * Control block at the beginning of the arena allocation, followed by the
+   * listing itself.  Entries form a doubly linked list in LRU order.
+   */
+  struct Entry {
+    char *data() { return reinterpret_cast<char *>(this + 1); }
+    Key key;
+    uint32_t size;
+    Entry *prev;
+    Entry *next;
+  };
+
+  static uint32_t HashKey(const Key &key);
+
+  void Unlink(Entry *entry);
+  void PushFront(Entry *entry);
+  void Evict(Entry *entry);
+
+  pthread_mutex_t lock_;
+  MallocArena *arena_;
+  SmallHashDynamic<Key, Entry *> entries_;
+  /**
+   * Sentinel of the LRU list: head_.next is the most recently used entry,
+   * head_.prev the least recently used one.
+   */
+  Entry head_;
+  uint32_t max_listing_size_;
+
+  perf::Counter *n_hit_;
+  perf::Counter *n_miss_;
+  perf::Counter *n_insert_;
+  perf::Counter *n_evict_;
+  perf::Counter *n_too_large_;
+  perf::Counter *sz_listings_;
+};
+
+}  // namespace cvmfs
+
+#endif  // CVMFS_LISTING_CACHE_H_
@@ -39,6 +39,7 @@
 // If defined the cache is secured by a posix mutex
 #define LRU_CACHE_THREAD_SAFE
 
+#include <pthread.h>
 #include <stdint.h>
 
 #include <algorithm>
@@ -47,6 +48,7 @@
 #include <functional>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "smallhash.h"
 #include "statistics.h"
@@ -661,6 +663,25 @@ class LruCache : SingleCopy {
     return found;
   }
 
+  /**
+   * Retrieve an element without taking the cache lock and without changing
+   * the LRU order or the hit counters.  Concurrent peeks do not write to the
+   * cache.  It is up to the caller to ensure that no other thread modifies
+   * the cache at the same time, e.g. by an outer reader-writer lock.
+   * @param key the key to perform a lookup on
+   * @param value (out) here the result is saved (not touch in case of miss)
+   * @return true on successful lookup, false if key was not found
+   */
+  bool Peek(const Key &key, Value *value) const {
+    if (pause_)
+      return false;
+    CacheEntry entry;
+    if (!cache_.Lookup(key, &entry))
+      return false;
+    *value = entry.value;
+    return true;
+  }
+
   /**
    * Forgets about a specific cache entry
    * @param key the key to delete from the cache
@@ -871,6 +892,355 @@ class LruCache : SingleCopy {
 #endif
 };  // class LruCache
 
+
+/**
+ * A concurrent approximation of the LruCache for the hot meta-data caches of
+ * the fuse module.  Keys are distributed over independent shards by their
+ * hash value.  Every shard evicts according to the CLOCK algorithm: a hit only
+ * sets the reference flag of the entry instead of moving it in a list, so
+ * that lookups can run in parallel under the shard's read lock.  The insertion
+ * of a new entry sweeps the clock hand over the shard's slots, clearing
+ * reference flags, until it finds an unreferenced victim.
+ *
+ * Provides the subset of the LruCache interface that is used by the meta-data
+ * caches, including Pause() / Resume() / Drop() for the catalog reload.
+ * Filtering and explicit LRU updates are not supported.
+ */
+template<class Key, class Value>
+class ShardedLruCache : SingleCopy {
+ private:
+  /**
+   * Value in the hash table, slot refers to the shard's clock arrays
+   */
+  typedef struct {
+    uint32_t slot;
+    Value value;
+  } CacheEntry;
+
+  class Shard : SingleCopy {
+   public:
+    Shard() : size(0), gauge(0), next_unused(0), hand(0), keys(NULL),
+              referenced(NULL)
+    {
+      int retval = pthread_rwlock_init(&rwlock, NULL);
+      assert(retval == 0);
+    }
+    ~Shard() {
+      pthread_rwlock_destroy(&rwlock);
+      for (unsigned i = 0; i < size; ++i)
+        keys[i].~Key();
+      free(keys);
+      free(referenced);
+    }
+
+    void Init(const unsigned shard_size, const Key &empty_key,
+              uint32_t (*hasher)(const Key &key))
+    {
+      size = shard_size;
+      cache.Init(size, empty_key, hasher);
+      keys = reinterpret_cast<Key *>(smalloc(size * sizeof(Key)));
+      for (unsigned i = 0; i < size; ++i)
+        new (keys + i) Key(empty_key);
+      referenced =
+        reinterpret_cast<unsigned char *>(scalloc(size, sizeof(unsigned char)));
+    }
+
+    uint64_t bytes_allocated() const {
+      return cache.bytes_allocated() +
+             size * (sizeof(Key) + sizeof(unsigned char));
+    }
+
+    /**
+     * Reference flags are accessed with relaxed atomics because readers set
+     * them concurrently under the read lock.
+     */
+    bool IsReferenced(const uint32_t slot) const {
+      return __atomic_load_n(&referenced[slot], __ATOMIC_RELAXED) != 0;
+    }
+    void SetReferenced(const uint32_t slot, const bool value) {
+      __atomic_store_n(&referenced[slot], value ? 1 : 0, __ATOMIC_RELAXED);
+    }
+
+    /**
+     * Returns a slot for a new entry, evicts an entry if the shard is full.
+     * Needs to be called with the write lock held.
+     */
+    uint32_t AcquireSlot(perf::Counter *n_replace) {
+      if (!free_slots.empty()) {
+        const uint32_t slot = free_slots.back();
+        free_slots.pop_back();
+        return slot;
+      }
+      if (next_unused < size)
+        return next_unused++;
+
+      // Full: all slots are occupied
+      while (IsReferenced(hand)) {
+        SetReferenced(hand, false);
+        hand = (hand + 1) % size;
+      }
+      const uint32_t victim = hand;
+      hand = (hand + 1) % size;
+      cache.Erase(keys[victim]);
+      gauge--;
+      perf::Inc(n_replace);
+      return victim;
+    }
+
+    void Clear() {
+      cache.Clear();
+      free_slots.clear();
+      memset(referenced, 0, size);
+      gauge = 0;
+      next_unused = 0;
+      hand = 0;
+    }
+
+    unsigned size;
+    unsigned gauge;
+    unsigned next_unused;
+    unsigned hand;
+    Key *keys;  /**< The key of every occupied slot, needed for eviction */
+    /**
+     * Set by concurrent readers under the read lock, all of them write the
+     * same value.  Cleared by the clock hand under the write lock.  Only to be
+     * accessed through IsReferenced() / SetReferenced().
+     */
+    unsigned char *referenced;
+    std::vector<uint32_t> free_slots;  /**< Slots released by Forget() */
+    SmallHashFixed<Key, CacheEntry> cache;
+    pthread_rwlock_t rwlock;
+  };
+
+ public:
+  /**
+   * Caches smaller than that are not split in multiple shards
+   */
+  static const unsigned kMinShardedSize = 1024;
+  static const unsigned kNumShards = 16;
+
+  ShardedLruCache(const unsigned   cache_size,
+                  const Key       &empty_key,
+                  uint32_t (*hasher)(const Key &key),
+                  perf::StatisticsTemplate statistics) :
+    counters_(statistics),
+    pause_(false),
+    cache_size_(cache_size),
+    num_shards_((cache_size >= kMinShardedSize) ? kNumShards : 1),
+    hasher_(hasher)
+  {
+    assert(cache_size > 0);
+
+    counters_.sz_size->Set(cache_size_);
+    shards_ = new Shard[num_shards_];
+    uint64_t bytes_allocated = 0;
+    for (unsigned i = 0; i < num_shards_; ++i) {
+      unsigned shard_size = cache_size_ / num_shards_;
+      if (i < (cache_size_ % num_shards_))
+        shard_size++;
+      shards_[i].Init(shard_size, empty_key, hasher);
+      bytes_allocated += shards_[i].bytes_allocated();
+    }
+    perf::Xadd(counters_.sz_allocated, bytes_allocated);
+  }
+
+  static double GetEntrySize() {
+    return SmallHashFixed<Key, CacheEntry>::GetEntrySize() +
+           static_cast<double>(sizeof(Key) + sizeof(unsigned char));
+  }
+
+  virtual ~ShardedLruCache() {
+    delete[] shards_;
+  }
+
+  /**
+   * Inserts a new key-value pair or updates the value of an existing key.
+   * If the shard of the key is full, an entry that was not used since the
+   * last pass of the clock hand is removed.
+   * @return true on insert, false on update
+   */
+  virtual bool Insert(const Key &key, const Value &value) {
+    Shard *shard = GetShard(key);
+    WriteLock(shard);
+    if (pause_) {
+      Unlock(shard);
+      return false;
+    }
+
+    CacheEntry entry;
+    if (shard->cache.Lookup(key, &entry)) {
+      perf::Inc(counters_.n_update);
+      entry.value = value;
+      shard->cache.Insert(key, entry);
+      shard->SetReferenced(entry.slot, true);
+      Unlock(shard);
+      return false;
+    }
+
+    perf::Inc(counters_.n_insert);
+    entry.slot = shard->AcquireSlot(counters_.n_replace);
+    entry.value = value;
+    shard->keys[entry.slot] = key;
+    shard->SetReferenced(entry.slot, false);
+    shard->cache.Insert(key, entry);
+    shard->gauge++;
+
+    Unlock(shard);
+    return true;
+  }
+
+  /**
+   * Retrieves an element from the cache.  Only takes the read lock of the
+   * key's shard.  On a hit, the entry is marked as recently used.
+   */
+  virtual bool Lookup(const Key &key, Value *value, bool update_lru = true) {
+    Shard *shard = GetShard(key);
+    ReadLock(shard);
+    if (pause_) {
+      Unlock(shard);
+      return false;
+    }
+
+    CacheEntry entry;
+    const bool found = shard->cache.Lookup(key, &entry);
+    if (found) {
+      // Avoid dirtying the cache line if the flag is already set
+      if (update_lru && !shard->IsReferenced(entry.slot))
+        shard->SetReferenced(entry.slot, true);
+      *value = entry.value;
+    }
+    Unlock(shard);
+
+    if (found)
+      perf::Inc(counters_.n_hit);
+    else
+      perf::Inc(counters_.n_miss);
+    return found;
+  }
+
+  virtual bool Forget(const Key &key) {
+    Shard *shard = GetShard(key);
+    WriteLock(shard);
+    if (pause_) {
+      Unlock(shard);
+      return false;
+    }
+
+    CacheEntry entry;
+    const bool found = shard->cache.Lookup(key, &entry);
+    if (found) {
+      perf::Inc(counters_.n_forget);
+      shard->cache.Erase(key);
+      shard->SetReferenced(entry.slot, false);
+      shard->free_slots.push_back(entry.slot);
+      shard->gauge--;
+    }
+    Unlock(shard);
+    return found;
+  }
+
+  virtual void Drop() {
+    uint64_t bytes_allocated = 0;
+    for (unsigned i = 0; i < num_shards_; ++i) {
+      WriteLock(&shards_[i]);
+      shards_[i].Clear();
+      bytes_allocated += shards_[i].bytes_allocated();
+      Unlock(&shards_[i]);
+    }
+    perf::Inc(counters_.n_drop);
+    counters_.sz_allocated->Set(bytes_allocated);
+  }
+
+  void Pause() { SetPause(true); }
+  void Resume() { SetPause(false); }
+
+  bool IsFull() {
+    for (unsigned i = 0; i < num_shards_; ++i) {
+      ReadLock(&shards_[i]);
+      const bool is_full = shards_[i].gauge >= shards_[i].size;
+      Unlock(&shards_[i]);
+      if (is_full)
+        return true;
+    }
+    return false;
+  }
+
+  bool IsEmpty() {
+    for (unsigned i = 0; i < num_shards_; ++i) {
+      ReadLock(&shards_[i]);
+      const bool is_empty = shards_[i].gauge == 0;
+      Unlock(&shards_[i]);
+      if (!is_empty)
+        return false;
+    }
+    return true;
+  }
+
+  Counters counters() {
+    uint64_t num_collisions = 0;
+    uint32_t max_collisions = 0;
+    for (unsigned i = 0; i < num_shards_; ++i) {
+      uint64_t shard_collisions;
+      uint32_t shard_max_collisions;
+      ReadLock(&shards_[i]);
+      shards_[i].cache.GetCollisionStats(&shard_collisions,
+                                         &shard_max_collisions);
+      Unlock(&shards_[i]);
+      num_collisions += shard_collisions;
+      max_collisions = std::max(max_collisions, shard_max_collisions);
+    }
+    Counters result = counters_;
+    result.num_collisions = num_collisions;
+    result.max_collisions = max_collisions;
+    return result;
+  }
+
+  unsigned num_shards() const { return num_shards_; }
+
+ protected:
+  Counters counters_;
+
+ private:
+  /**
+   * SmallHashFixed derives the bucket from the high bits of the hash, so the
+   * shard is taken from the low bits in order to keep the buckets of a shard
+   * evenly used.
+   */
+  inline Shard *GetShard(const Key &key) const {
+    return &shards_[hasher_(key) % num_shards_];
+  }
+
+  void SetPause(const bool value) {
+    for (unsigned i = 0; i < num_shards_; ++i)
+      WriteLock(&shards_[i]);
+    pause_ = value;
+    for (unsigned i = num_shards_; i > 0; --i)
+      Unlock(&shards_[i - 1]);
+  }
+
+  inline void ReadLock(Shard *shard) const {
+    int retval = pthread_rwlock_rdlock(&shard->rwlock);
+    assert(retval == 0);
+  }
+  inline void WriteLock(Shard *shard) const {
+    int retval = pthread_rwlock_wrlock(&shard->rwlock);
+    assert(retval == 0);
+  }
+  inline void Unlock(Shard *shard) const {
+    int retval = pthread_rwlock_unlock(&shard->rwlock);
+    assert(retval == 0);
+  }
+
+  /**
+   * Only changed with the write locks of all shards held
+   */
+  bool pause_;
+  const unsigned cache_size_;
+  const unsigned num_shards_;
+  uint32_t (*hasher_)(const Key &key);
+  Shard *shards_;
+};  // class ShardedLruCache
+
 }  // namespace lru
 
 #endif  // CVMFS_LRU_H_
@@ -34,33 +34,54 @@ static inline uint32_t hasher_md5(const shash::Md5 &key) {
 static inline uint32_t hasher_inode(const fuse_ino_t &inode) {
   return MurmurHash2(&inode, sizeof(inode), 0x07387a4f);
 }
+
+/**
+ * Key of the negative lookup cache: a name within a parent directory
+ */
+struct ParentNameKey {
+  ParentNameKey() : parent(0) { }
+  ParentNameKey(const fuse_ino_t p, const char *name, const unsigned length)
+    : parent(p), name_hash(name, length) { }
+  bool operator ==(const ParentNameKey &other) const {
+    return (parent == other.parent) && (name_hash == other.name_hash);
+  }
+  bool operator !=(const ParentNameKey &other) const {
+    return !(*this == other);
+  }
+
+  fuse_ino_t parent;
+  shash::Md5 name_hash;
+};
+
+static inline uint32_t hasher_parent_name(const ParentNameKey &key) {
+  return hasher_md5(key.name_hash) ^ hasher_inode(key.parent);
+}
 // uint32_t hasher_md5(const shash::Md5 &key);
 // uint32_t hasher_inode(const fuse_ino_t &inode);
 
 
-class InodeCache : public LruCache<fuse_ino_t, catalog::DirectoryEntry>
+class InodeCache : public ShardedLruCache<fuse_ino_t, catalog::DirectoryEntry>
 {
  public:
+  typedef ShardedLruCache<fuse_ino_t, catalog::DirectoryEntry> Base;
+
   explicit InodeCache(unsigned int cache_size, perf::Statistics *statistics) :
-    LruCache<fuse_ino_t, catalog::DirectoryEntry>(
-      cache_size, fuse_ino_t(-1), hasher_inode,
-      perf::StatisticsTemplate("inode_cache", statistics))
+    Base(cache_size, fuse_ino_t(-1), hasher_inode,
+         perf::StatisticsTemplate("inode_cache", statistics))
   {
   }
 
   bool Insert(const fuse_ino_t &inode, const catalog::DirectoryEntry &dirent) {
     LogCvmfs(kLogLru, kLogDebug, "insert inode --> dirent: %u -> '%s'",
              inode, dirent.name().c_str());
-    const bool result =
-      LruCache<fuse_ino_t, catalog::DirectoryEntry>::Insert(inode, dirent);
+    const bool result = Base::Insert(inode, dirent);
     return result;
   }
 
   bool Lookup(const fuse_ino_t &inode, catalog::DirectoryEntry *dirent,
               bool update_lru = true)
   {
-    const bool result =
-      LruCache<fuse_ino_t, catalog::DirectoryEntry>::Lookup(inode, dirent);
+    const bool result = Base::Lookup(inode, dirent);
     LogCvmfs(kLogLru, kLogDebug, "lookup inode --> dirent: %u (%s)",
              inode, result ? "hit" : "miss");
     return result;
@@ -68,32 +89,32 @@ class InodeCache : public LruCache<fuse_ino_t, catalog::DirectoryEntry>
 
   void Drop() {
     LogCvmfs(kLogLru, kLogDebug, "dropping inode cache");
-    LruCache<fuse_ino_t, catalog::DirectoryEntry>::Drop();
+    Base::Drop();
   }
 };  // InodeCache
 
 
-class PathCache : public LruCache<fuse_ino_t, PathString> {
+class PathCache : public ShardedLruCache<fuse_ino_t, PathString> {
  public:
+  typedef ShardedLruCache<fuse_ino_t, PathString> Base;
+
   explicit PathCache(unsigned int cache_size, perf::Statistics *statistics) :
-    LruCache<fuse_ino_t, PathString>(cache_size, fuse_ino_t(-1), hasher_inode,
-      perf::StatisticsTemplate("path_cache", statistics))
+    Base(cache_size, fuse_ino_t(-1), hasher_inode,
+         perf::StatisticsTemplate("path_cache", statistics))
   {
   }
 
   bool Insert(const fuse_ino_t &inode, const PathString &path) {
     LogCvmfs(kLogLru, kLogDebug, "insert inode --> path %u -> '%s'",
              inode, path.c_str());
-    const bool result =
-      LruCache<fuse_ino_t, PathString>::Insert(inode, path);
+    const bool result = Base::Insert(inode, path);
     return result;
   }
 
   bool Lookup(const fuse_ino_t &inode, PathString *path,
               bool update_lru = true)
   {
-    const bool found =
-      LruCache<fuse_ino_t, PathString>::Lookup(inode, path);
+    const bool found = Base::Lookup(inode, path);
     LogCvmfs(kLogLru, kLogDebug, "lookup inode --> path: %u (%s)",
              inode, found ? "hit" : "miss");
     return found;
@@ -101,19 +122,20 @@ class PathCache : public LruCache<fuse_ino_t, PathString> {
 
   void Drop() {
     LogCvmfs(kLogLru, kLogDebug, "dropping path cache");
-    LruCache<fuse_ino_t, PathString>::Drop();
+    Base::Drop();
   }
 };  // PathCache
 
 
 class Md5PathCache :
-  public LruCache<shash::Md5, catalog::DirectoryEntry>
+  public ShardedLruCache<shash::Md5, catalog::DirectoryEntry>
 {
  public:
+  typedef ShardedLruCache<shash::Md5, catalog::DirectoryEntry> Base;
+
   explicit Md5PathCache(unsigned int cache_size, perf::Statistics *statistics) :
-    LruCache<shash::Md5, catalog::DirectoryEntry>(
-      cache_size, shash::Md5(shash::AsciiPtr("!")), hasher_md5,
-      perf::StatisticsTemplate("md5_path_cache", statistics))
+    Base(cache_size, shash::Md5(shash::AsciiPtr("!")), hasher_md5,
+         perf::StatisticsTemplate("md5_path_cache", statistics))
   {
     dirent_negative_ = catalog::DirectoryEntry(catalog::kDirentNegative);
   }
@@ -121,8 +143,7 @@ class Md5PathCache :
   bool Insert(const shash::Md5 &hash, const catalog::DirectoryEntry &dirent) {
     LogCvmfs(kLogLru, kLogDebug, "insert md5 --> dirent: %s -> '%s'",
              hash.ToString().c_str(), dirent.name().c_str());
-    const bool result =
-      LruCache<shash::Md5, catalog::DirectoryEntry>::Insert(hash, dirent);
+    const bool result = Base::Insert(hash, dirent);
     return result;
   }
 
@@ -136,8 +157,7 @@ class Md5PathCache :
   bool Lookup(const shash::Md5 &hash, catalog::DirectoryEntry *dirent,
               bool update_lru = true)
   {
-    const bool result =
-      LruCache<shash::Md5, catalog::DirectoryEntry>::Lookup(hash, dirent);
+    const bool result = Base::Lookup(hash, dirent);
     LogCvmfs(kLogLru, kLogDebug, "lookup md5 --> dirent: %s (%s)",
              hash.ToString().c_str(), result ? "hit" : "miss");
     return result;
@@ -146,18 +166,61 @@ class Md5PathCache :
   bool Forget(const shash::Md5 &hash) {
     LogCvmfs(kLogLru, kLogDebug, "forget md5: %s",
              hash.ToString().c_str());
-    return LruCache<shash::Md5, catalog::DirectoryEntry>::Forget(hash);
+    return Base::Forget(hash);
   }
 
   void Drop() {
     LogCvmfs(kLogLru, kLogDebug, "dropping md5path cache");
-    LruCache<shash::Md5, catalog::DirectoryEntry>::Drop();
+    Base::Drop();
   }
 
  private:
   catalog::DirectoryEntry dirent_negative_;
 };  // Md5PathCache
 
+
+/**
+ * Remembers (parent inode, name) pairs that did not resolve to a directory
+ * entry.  Such lookups are answered without constructing the path and without
+ * a catalog query.  Only fuse inodes are stored, so the cache needs to be
+ * dropped whenever a new catalog revision is applied.
+ */
+class NegativeLookupCache : public ShardedLruCache<ParentNameKey, bool> {
+ public:
+  typedef ShardedLruCache<ParentNameKey, bool> Base;
+
+  explicit NegativeLookupCache(unsigned int cache_size,
+                               perf::Statistics *statistics) :
+    Base(cache_size, ParentNameKey(fuse_ino_t(-1), "!", 1), hasher_parent_name,
+         perf::StatisticsTemplate("negative_lookup_cache", statistics))
+  {
+  }
+
+  bool Add(const ParentNameKey &key) {
+    LogCvmfs(kLogLru, kLogDebug, "insert negative lookup: %lu/%s",
+             static_cast<unsigned long>(key.parent),  // NOLINT
+             key.name_hash.ToString().c_str());
+    const bool result = Base::Insert(key, true);
+    if (result)
+      perf::Inc(counters_.n_insert_negative);
+    return result;
+  }
+
+  bool Contains(const ParentNameKey &key) {
+    bool value;
+    const bool result = Base::Lookup(key, &value);
+    LogCvmfs(kLogLru, kLogDebug, "lookup negative: %lu/%s (%s)",
+             static_cast<unsigned long>(key.parent),  // NOLINT
+             key.name_hash.ToString().c_str(), result ? "hit" : "miss");
+    return result;
+  }
+
+  void Drop() {
+    LogCvmfs(kLogLru, kLogDebug, "dropping negative lookup cache");
+    Base::Drop();
+  }
+};  // NegativeLookupCache
+
 }  // namespace lru
 
 #endif  // CVMFS_LRU_MD_H_
@@ -116,6 +116,7 @@ MallocHeap::MallocHeap(uint64_t capacity, CallbackPtr callback_ptr)
   , gauge_(0)
   , stored_(0)
   , num_blocks_(0)
+  , owns_heap_(true)
 {
   assert(capacity_ > kMinCapacity);
   // Ensure 8-byte alignment
@@ -125,6 +126,25 @@ MallocHeap::MallocHeap(uint64_t capacity, CallbackPtr callback_ptr)
 }
 
 
+MallocHeap::MallocHeap(
+  uint64_t capacity,
+  CallbackPtr callback_ptr,
+  void *arena)
+  : callback_ptr_(callback_ptr)
+  , capacity_(capacity)
+  , gauge_(0)
+  , stored_(0)
+  , num_blocks_(0)
+  , heap_(reinterpret_cast<unsigned char *>(arena))
+  , owns_heap_(false)
+{
+  assert(capacity_ > kMinCapacity);
+  assert((capacity_ % 8) == 0);
+  assert(uintptr_t(heap_) % 8 == 0);
+}
+
+
 MallocHeap::~MallocHeap() {
-  sxunmap(heap_, capacity_);
+  if (owns_heap_)
+    sxunmap(heap_, capacity_);
 }
@@ -46,6 +46,12 @@ class MallocHeap {
   typedef Callbackable<BlockPtr>::CallbackTN* CallbackPtr;
 
   MallocHeap(uint64_t capacity, CallbackPtr callback_ptr);
+  /**
+   * Uses the given memory area of size capacity instead of an anonymous
+   * mapping, e.g. a shared memory region.  The area is not unmapped on
+   * destruction.
+   */
+  MallocHeap(uint64_t capacity, CallbackPtr callback_ptr, void *arena);
   ~MallocHeap();
 
   void *Allocate(uint64_t size, void *header, unsigned header_size);
@@ -121,6 +127,10 @@ class MallocHeap {
    * The big mmap'd memory block used to serve allocation requests.
    */
   unsigned char *heap_;
+  /**
+   * False if heap_ was provided by the caller.
+   */
+  bool owns_heap_;
 };  // class MallocHeap
 
 #endif  // CVMFS_MALLOC_HEAP_H_
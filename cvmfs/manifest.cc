@@ -4,11 +4,14 @@
 
 #include "manifest.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <map>
+#include <vector>
 
 #include "catalog.h"
 #include "util/posix.h"
+#include "util/string.h"
 
 using namespace std;  // NOLINT
 
@@ -147,10 +150,70 @@ Manifest *Manifest::Load(const map<char, string> &content) {
     reflog_hash = MkFromHexPtr(shash::HexPtr(iter->second));
   }
 
-  return new Manifest(catalog_hash, catalog_size, root_path, ttl, revision,
-                      micro_catalog_hash, repository_name, certificate,
-                      history, publish_timestamp, garbage_collectable,
-                      has_alt_catalog_path, meta_info, reflog_hash);
+  Manifest *manifest =
+    new Manifest(catalog_hash, catalog_size, root_path, ttl, revision,
+                 micro_catalog_hash, repository_name, certificate,
+                 history, publish_timestamp, garbage_collectable,
+                 has_alt_catalog_path, meta_info, reflog_hash);
+  if ((iter = content.find('V')) != content.end())
+    manifest->set_min_client_version(iter->second);
+  return manifest;
+}
+
+
+/**
+ * Compares two dotted version strings component by component, e.g.
+ * 2.9.4 < 2.11.0.  Missing components count as zero.
+ */
+static int CompareVersions(const string &a, const string &b) {
+  vector<string> components_a = SplitString(a, '.');
+  vector<string> components_b = SplitString(b, '.');
+  const unsigned n = std::max(components_a.size(), components_b.size());
+  for (unsigned i = 0; i < n; ++i) {
+    const uint64_t va =
+      (i < components_a.size()) ? String2Uint64(components_a[i]) : 0;
+    const uint64_t vb =
+      (i < components_b.size()) ? String2Uint64(components_b[i]) : 0;
+    if (va != vb)
+      return (va < vb) ? -1 : 1;
+  }
+  return 0;
+}
+
+
+/**
+ * True if a client with the given version can read the repository.
+ */
+bool Manifest::IsSupportedBy(const string &client_version) const {
+  if (min_client_version_.empty())
+    return true;
+  return CompareVersions(client_version, min_client_version_) >= 0;
+}
+
+
+/**
+ * True if the repository already requires at least the given client version.
+ * Clients that predate the 'V' field ignore it, so features that need a new
+ * client may only be used if the requirement was set when the repository was
+ * created.
+ */
+bool Manifest::RequiresClientVersion(const string &client_version) const {
+  if (min_client_version_.empty())
+    return false;
+  return CompareVersions(min_client_version_, client_version) >= 0;
+}
+
+
+/**
+ * Raises the minimum client version.  Never lowers it: objects written for
+ * a newer client remain in the repository.
+ */
+void Manifest::RequireClientVersion(const string &client_version) {
+  if (min_client_version_.empty() ||
+      (CompareVersions(client_version, min_client_version_) > 0))
+  {
+    min_client_version_ = client_version;
+  }
 }
 
 
@@ -196,6 +259,8 @@ string Manifest::ExportString() const {
   if (!reflog_hash_.IsNull()) {
     manifest += "Y" + reflog_hash_.ToString() + "\n";
   }
+  if (!min_client_version_.empty())
+    manifest += "V" + min_client_version_ + "\n";
   // Reserved: Z -> for identification of channel tips
 
   return manifest;
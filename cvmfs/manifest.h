@@ -117,6 +117,9 @@ class Manifest {
   void set_reflog_hash(const shash::Any& checksum) {
     reflog_hash_ = checksum;
   }
+  void set_min_client_version(const std::string &min_client_version) {
+    min_client_version_ = min_client_version;
+  }
 
   uint64_t revision() const { return revision_; }
   std::string repository_name() const { return repository_name_; }
@@ -130,6 +133,11 @@ class Manifest {
   bool has_alt_catalog_path() const { return has_alt_catalog_path_; }
   shash::Any meta_info() const { return meta_info_; }
   shash::Any reflog_hash() const { return reflog_hash_; }
+  std::string min_client_version() const { return min_client_version_; }
+
+  bool IsSupportedBy(const std::string &client_version) const;
+  bool RequiresClientVersion(const std::string &client_version) const;
+  void RequireClientVersion(const std::string &client_version);
 
   std::string MakeCatalogPath() const {
     return has_alt_catalog_path_ ? catalog_hash_.MakeAlternativePath() :
@@ -172,6 +180,13 @@ class Manifest {
    * Hash of the reflog file
    */
   shash::Any reflog_hash_;
+
+  /**
+   * Clients older than this version cannot read the repository, e.g. because
+   * it contains objects compressed with an algorithm they do not know.  Empty
+   * if any client can read the repository.
+   */
+  std::string min_client_version_;
 };  // class Manifest
 
 }  // namespace manifest
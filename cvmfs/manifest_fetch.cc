@@ -2,6 +2,7 @@
  * This file is part of the CernVM File System.
  */
 
+#include "cvmfs_config.h"
 #include "manifest_fetch.h"
 
 #include <string>
@@ -71,6 +72,14 @@ static Failures DoVerify(char *manifest_data, size_t manifest_size,
     result = kFailOutdated;
     goto cleanup;
   }
+  if (!ensemble->manifest->IsSupportedBy(PACKAGE_VERSION)) {
+    LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogErr,
+             "repository %s requires client version %s or newer",
+             repository_name.c_str(),
+             ensemble->manifest->min_client_version().c_str());
+    result = kFailClientTooOld;
+    goto cleanup;
+  }
 
   // Quick way out: hash matches base catalog
   if (base_catalog && (ensemble->manifest->catalog_hash() == *base_catalog))
@@ -47,6 +47,7 @@
 #include "google/protobuf/stubs/common.h"
 #include "history.h"
 #include "history_sqlite.h"
+#include "listing_cache.h"
 #include "lru_md.h"
 #include "manifest.h"
 #include "manifest_fetch.h"
@@ -58,6 +59,8 @@
 #endif
 #include "options.h"
 #include "quota_posix.h"
+#include "quota_sharded.h"
+#include "readahead.h"
 #include "resolv_conf_event_handler.h"
 #include "sqlitemem.h"
 #include "sqlitevfs.h"
@@ -147,6 +150,13 @@ bool FileSystem::CheckPosixCacheSettings(
     }
   }
 
+  if (settings.is_sharded_quota && settings.is_shared) {
+    boot_error_ = "Failure: the sharded quota backend requires an exclusive "
+                  "cache.  Please turn off shared local disk cache.";
+    boot_status_ = loader::kFailOptions;
+    return false;
+  }
+
   if (settings.cache_base_defined && settings.cache_dir_defined) {
     boot_error_ =
       "'CVMFS_CACHE_BASE' and 'CVMFS_CACHE_DIR' are mutually exclusive";
@@ -218,26 +228,35 @@ void FileSystem::CreateStatistics() {
   statistics_->Register("linkstring.n_overflows", "Number of overflows");
 
   // Callback counters
-  n_fs_open_ = statistics_->Register("cvmfs.n_fs_open",
-                                     "Overall number of file open operations");
+  n_fs_open_ = statistics_->RegisterSharded("cvmfs.n_fs_open",
+    "Overall number of file open operations");
   n_fs_dir_open_ = statistics_->Register("cvmfs.n_fs_dir_open",
                    "Overall number of directory open operations");
-  n_fs_lookup_ = statistics_->Register("cvmfs.n_fs_lookup",
-                                       "Number of lookups");
-  n_fs_lookup_negative_ = statistics_->Register("cvmfs.n_fs_lookup_negative",
-                                                "Number of negative lookups");
-  n_fs_stat_ = statistics_->Register("cvmfs.n_fs_stat", "Number of stats");
+  n_fs_lookup_ = statistics_->RegisterSharded("cvmfs.n_fs_lookup",
+                                              "Number of lookups");
+  n_fs_lookup_negative_ = statistics_->RegisterSharded(
+    "cvmfs.n_fs_lookup_negative", "Number of negative lookups");
+  n_fs_stat_ = statistics_->RegisterSharded("cvmfs.n_fs_stat",
+                                            "Number of stats");
   n_fs_stat_stale_ = statistics_->Register("cvmfs.n_fs_stat_stale",
     "Number of stats for stale (open, meanwhile changed) regular files");
   n_fs_statfs_ = statistics_->Register("cvmfs.n_fs_statfs",
                                        "Overall number of statsfs calls");
   n_fs_statfs_cached_ = statistics_->Register("cvmfs.n_fs_statfs_cached",
                 "Number of statsfs calls that accessed the cached statfs info");
-  n_fs_read_ = statistics_->Register("cvmfs.n_fs_read", "Number of files read");
-  n_fs_readlink_ = statistics_->Register("cvmfs.n_fs_readlink",
-                                         "Number of links read");
-  n_fs_forget_ = statistics_->Register("cvmfs.n_fs_forget",
-                                       "Number of inode forgets");
+  n_fs_read_ = statistics_->RegisterSharded("cvmfs.n_fs_read",
+                                            "Number of files read");
+  n_fs_read_copy_ = statistics_->RegisterSharded("cvmfs.n_fs_read_copy",
+    "Number of reads copied through a buffer of the fuse module");
+  n_fs_read_splice_ = statistics_->RegisterSharded("cvmfs.n_fs_read_splice",
+    "Number of reads spliced from the cache file to the fuse device");
+  n_fs_open_passthrough_ = statistics_->Register(
+    "cvmfs.n_fs_open_passthrough",
+    "Number of file opens whose reads are passed through by the kernel");
+  n_fs_readlink_ = statistics_->RegisterSharded("cvmfs.n_fs_readlink",
+                                                "Number of links read");
+  n_fs_forget_ = statistics_->RegisterSharded("cvmfs.n_fs_forget",
+                                              "Number of inode forgets");
   n_fs_inode_replace_ = statistics_->Register("cvmfs.n_fs_inode_replace",
     "Number of stale inodes that got replaced by an up-to-date version");
   no_open_files_ = statistics_->Register("cvmfs.no_open_files",
@@ -318,6 +337,11 @@ FileSystem::PosixCacheSettings FileSystem::DeterminePosixCacheSettings(
   }
   if (settings.quota_limit > 0)
     settings.is_managed = true;
+  if (options_mgr_->GetValue(MkCacheParm("CVMFS_CACHE_QUOTA_BACKEND", instance),
+                             &optarg))
+  {
+    settings.is_sharded_quota = (optarg == "sharded");
+  }
 
   settings.cache_path = kDefaultCacheBase;
   if (options_mgr_->GetValue(MkCacheParm("CVMFS_CACHE_BASE", instance),
@@ -405,6 +429,9 @@ FileSystem::FileSystem(const FileSystem::FileSystemInfo &fs_info)
   , n_fs_statfs_(NULL)
   , n_fs_statfs_cached_(NULL)
   , n_fs_read_(NULL)
+  , n_fs_read_copy_(NULL)
+  , n_fs_read_splice_(NULL)
+  , n_fs_open_passthrough_(NULL)
   , n_fs_readlink_(NULL)
   , n_fs_forget_(NULL)
   , n_fs_inode_replace_(NULL)
@@ -706,6 +733,15 @@ CacheManager *FileSystem::SetupPosixCacheMgr(const string &instance) {
   if (settings.is_managed) {
     if (!SetupPosixQuotaMgr(settings, cache_mgr.weak_ref()))
       return NULL;
+    // Several managed posix caches (tiered cache) share the histogram
+    Log2Histogram *hist_quota_insert =
+      statistics_->LookupHistogram("cache.hist_quota_insert");
+    if (hist_quota_insert == NULL) {
+      hist_quota_insert = statistics_->RegisterHistogram(
+        "cache.hist_quota_insert",
+        "time to register committed objects with the quota manager");
+    }
+    cache_mgr->set_hist_quota_insert(hist_quota_insert);
   }
   return cache_mgr.Release();
 }
@@ -786,7 +822,9 @@ CacheManager *FileSystem::SetupTieredCacheMgr(const string &instance) {
     return NULL;
 
   CacheManager *tiered =
-    TieredCacheManager::Create(upper.Release(), lower.Release());
+    TieredCacheManager::Create(
+      upper.Release(), lower.Release(),
+      perf::StatisticsTemplate("cache." + instance, statistics_));
   if (tiered == NULL) {
     boot_error_ = "Failed to setup tiered cache manager " + instance;
     boot_status_ = loader::kFailCacheDir;
@@ -798,6 +836,15 @@ CacheManager *FileSystem::SetupTieredCacheMgr(const string &instance) {
   {
     static_cast<TieredCacheManager*>(tiered)->SetLowerReadOnly();
   }
+  unsigned num_promotion_threads =
+    TieredCacheManager::kDefaultNumPromotionThreads;
+  if (options_mgr_->GetValue(
+        MkCacheParm("CVMFS_CACHE_PROMOTION_THREADS", instance), &optarg))
+  {
+    num_promotion_threads = String2Uint64(optarg);
+  }
+  static_cast<TieredCacheManager*>(tiered)->SetNumPromotionThreads(
+    num_promotion_threads);
   return tiered;
 }
 
@@ -991,9 +1038,20 @@ bool FileSystem::SetupPosixQuotaMgr(
              settings.workspace.c_str(), settings.cache_path.c_str());
     cache_workspace += ":" + settings.workspace;
   }
-  PosixQuotaManager *quota_mgr;
+  QuotaManager *quota_mgr;
 
-  if (settings.is_shared) {
+  if (settings.is_sharded_quota) {
+    quota_mgr = ShardedQuotaManager::Create(
+                  cache_workspace,
+                  settings.quota_limit,
+                  quota_threshold,
+                  found_previous_crash_);
+    if (quota_mgr == NULL) {
+      boot_error_ = "Failed to initialize sharded lru cache";
+      boot_status_ = loader::kFailQuota;
+      return false;
+    }
+  } else if (settings.is_shared) {
     quota_mgr = PosixQuotaManager::CreateShared(
                   exe_path_,
                   cache_workspace,
@@ -1235,6 +1293,26 @@ void MountPoint::EnableFuseExpireEntry() {
   fuse_expire_entry_ = true;
 }
 
+/**
+ * Falls back to copying read data through a buffer.  Splicing requires
+ * FUSE_CAP_SPLICE_WRITE and a cache manager with native file descriptors.
+ *
+ * NOTE: This function should only be called before or within cvmfs_init().
+ */
+void MountPoint::DisableFuseSpliceRead() {
+  fuse_splice_read_ = false;
+}
+
+/**
+ * Fuse passthrough requires libfuse >= 3.17 (FUSE_CAP_PASSTHROUGH), linux
+ * kernel >= 6.9 and CAP_SYS_ADMIN.
+ *
+ * NOTE: This function should only be called before or within cvmfs_init().
+ */
+void MountPoint::DisableFusePassthrough() {
+  fuse_passthrough_ = false;
+}
+
 
 /**
  * The option_mgr parameter can be NULL, in which case the global option manager
@@ -1272,6 +1350,7 @@ MountPoint *MountPoint::Create(
 
   mountpoint->ReEvaluateAuthz();
   mountpoint->CreateTables();
+  mountpoint->CreateReadAhead();
   if (!mountpoint->SetupBehavior())
     return mountpoint.Release();
 
@@ -1571,6 +1650,36 @@ void MountPoint::CreateTables() {
   md5path_cache_ = new lru::Md5PathCache((memcache_num_units * 7) & mask_64,
                                          statistics_);
 
+  unsigned negative_lookup_cache_size = kDefaultNegativeLookupCacheSize;
+  if (options_mgr_->GetValue("CVMFS_NEGATIVE_LOOKUP_CACHE_SIZE", &optarg))
+    negative_lookup_cache_size = String2Uint64(optarg);
+  if (negative_lookup_cache_size > 0) {
+    // Keep at least two blocks of 64 entries
+    negative_lookup_cache_size =
+      std::max(negative_lookup_cache_size & mask_64, 128U);
+    negative_lookup_cache_ =
+      new lru::NegativeLookupCache(negative_lookup_cache_size, statistics_);
+  }
+
+  unsigned listing_cache_size_mb = kDefaultListingCacheSizeMb;
+  if (options_mgr_->GetValue("CVMFS_LISTING_CACHE_SIZE", &optarg))
+    listing_cache_size_mb = String2Uint64(optarg);
+  // The arena needs to be a multiple of 2MB and cannot exceed 512MB.  Only an
+  // explicit 0 disables the cache.
+  if (listing_cache_size_mb > 0) {
+    const unsigned requested_size_mb = listing_cache_size_mb;
+    listing_cache_size_mb =
+      std::max(std::min(listing_cache_size_mb & ~1U, 512U), 2U);
+    if (listing_cache_size_mb != requested_size_mb) {
+      LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogWarn,
+               "CVMFS_LISTING_CACHE_SIZE=%u adjusted to %u (MB)",
+               requested_size_mb, listing_cache_size_mb);
+    }
+    listing_cache_ = new cvmfs::DirectoryListingCache(
+      listing_cache_size_mb * 1024 * 1024,
+      perf::StatisticsTemplate("listing_cache", statistics_));
+  }
+
   inode_tracker_ = new glue::InodeTracker();
   dentry_tracker_ = new glue::DentryTracker();
   page_cache_tracker_ = new glue::PageCacheTracker();
@@ -1578,6 +1687,32 @@ void MountPoint::CreateTables() {
     page_cache_tracker_->Disable();
 }
 
+/**
+ * Sets up read-ahead of chunked files in the fuse module.  The number of chunks
+ * fetched ahead of a sequential reader and the number of read-ahead threads
+ * are set by CVMFS_READAHEAD_CHUNKS and CVMFS_READAHEAD_THREADS.
+ */
+void MountPoint::CreateReadAhead() {
+  if (file_system_->type() != FileSystem::kFsFuse)
+    return;
+
+  string optarg;
+  unsigned window = kDefaultReadAheadChunks;
+  unsigned num_threads = cvmfs::ChunkReadAhead::kDefaultNumThreads;
+  if (options_mgr_->GetValue("CVMFS_READAHEAD_CHUNKS", &optarg))
+    window = String2Uint64(optarg);
+  if (options_mgr_->GetValue("CVMFS_READAHEAD_THREADS", &optarg))
+    num_threads = String2Uint64(optarg);
+  read_ahead_ = new cvmfs::ChunkReadAhead(
+    window, num_threads, fetcher_, external_fetcher_,
+    perf::StatisticsTemplate("readahead", statistics_));
+  if (read_ahead_->window() > 0) {
+    LogCvmfs(kLogCvmfs, kLogDebug,
+             "read-ahead of %u chunks with %u threads",
+             read_ahead_->window(), num_threads);
+  }
+}
+
 /**
  * Will create a tracer for the current mount point
  * Tracefile path, Trace buffer size and trace buffer flush threshold
@@ -1585,6 +1720,8 @@ void MountPoint::CreateTables() {
  * CVMFS_TRACEBUFFER, CVMFS_TRACEBUFFER_THRESHOLD(respectively)
  * VMFS_TRACEBUFFER and CVMFS_TRACEBUFFER_THRESHOLD will silently fallback
  * to default values if configuration values don't exist or are invalid
+ * With CVMFS_TRACEFILE_FORMAT=binary, CVMFS_TRACEBUFFER is the size of the
+ * per-thread ring buffers and the threshold is not used.
  */
 bool MountPoint::CreateTracer() {
   string optarg;
@@ -1602,6 +1739,21 @@ bool MountPoint::CreateTracer() {
     if (options_mgr_->GetValue("CVMFS_TRACEBUFFER", &optarg)) {
       tracebuffer_size = String2Uint64(optarg);
     }
+    if (options_mgr_->GetValue("CVMFS_TRACEFILE_FORMAT", &optarg)) {
+      if (optarg == "binary") {
+        assert(tracebuffer_size <= INT_MAX);
+        LogCvmfs(kLogCvmfs, kLogDebug,
+          "Initialising binary tracer with %" PRIu64 " records per thread",
+          tracebuffer_size);
+        tracer_->ActivateBinary(tracebuffer_size, tracebuffer_file);
+        return true;
+      }
+      if (optarg != "csv") {
+        boot_error_ = "invalid trace file format: " + optarg;
+        boot_status_ = loader::kFailOptions;
+        return false;
+      }
+    }
     if (options_mgr_->GetValue("CVMFS_TRACEBUFFER_THRESHOLD",
       &optarg)) {
       tracebuffer_threshold = String2Uint64(optarg);
@@ -1770,9 +1922,12 @@ MountPoint::MountPoint(
   , catalog_mgr_(NULL)
   , chunk_tables_(NULL)
   , simple_chunk_tables_(NULL)
+  , read_ahead_(NULL)
   , inode_cache_(NULL)
   , path_cache_(NULL)
   , md5path_cache_(NULL)
+  , negative_lookup_cache_(NULL)
+  , listing_cache_(NULL)
   , tracer_(NULL)
   , inode_tracker_(NULL)
   , dentry_tracker_(NULL)
@@ -1785,6 +1940,8 @@ MountPoint::MountPoint(
   , enforce_acls_(false)
   , cache_symlinks_(false)
   , fuse_expire_entry_(false)
+  , fuse_splice_read_(false)
+  , fuse_passthrough_(false)
   , has_membership_req_(false)
   , talk_socket_path_(std::string("./cvmfs_io.") + fqrn)
   , talk_socket_uid_(0)
@@ -1802,11 +1959,15 @@ MountPoint::~MountPoint() {
   delete dentry_tracker_;
   delete inode_tracker_;
   delete tracer_;
+  delete listing_cache_;
+  delete negative_lookup_cache_;
   delete md5path_cache_;
   delete path_cache_;
   delete inode_cache_;
   delete simple_chunk_tables_;
   delete chunk_tables_;
+  // Joins the read-ahead threads, which use the fetchers
+  delete read_ahead_;
 
   delete catalog_mgr_;
   delete inode_annotation_;
@@ -1946,6 +2107,18 @@ bool MountPoint::SetupBehavior() {
     cache_symlinks_ = true;
   }
 
+  if (options_mgr_->GetValue("CVMFS_FUSE_SPLICE_READ", &optarg)
+      && options_mgr_->IsOn(optarg))
+  {
+    fuse_splice_read_ = true;
+  }
+
+  if (options_mgr_->GetValue("CVMFS_FUSE_PASSTHROUGH", &optarg)
+      && options_mgr_->IsOn(optarg))
+  {
+    fuse_passthrough_ = true;
+  }
+
 
 
   if (options_mgr_->GetValue("CVMFS_TALK_SOCKET", &optarg)) {
@@ -2134,6 +2307,17 @@ void MountPoint::SetupHttpTuning() {
   {
     download_mgr_->EnableInfoHeader();
   }
+  if (options_mgr_->GetValue("CVMFS_HTTP2", &optarg) &&
+      options_mgr_->IsOn(optarg))
+  {
+    unsigned max_streams = download::DownloadManager::kDefaultHttp2MaxStreams;
+    if (options_mgr_->GetValue("CVMFS_HTTP2_MAX_STREAMS", &optarg))
+      max_streams = String2Uint64(optarg);
+    const bool prior_knowledge =
+      options_mgr_->GetValue("CVMFS_HTTP2_PRIOR_KNOWLEDGE", &optarg) &&
+      options_mgr_->IsOn(optarg);
+    download_mgr_->EnableHttp2(max_streams, prior_knowledge);
+  }
 }
 
 
@@ -36,6 +36,8 @@ class InodeAnnotation;
 }
 struct ChunkTables;
 namespace cvmfs {
+class ChunkReadAhead;
+class DirectoryListingCache;
 class Fetcher;
 class Uuid;
 }
@@ -50,6 +52,7 @@ class PageCacheTracker;
 namespace lru {
 class InodeCache;
 class Md5PathCache;
+class NegativeLookupCache;
 class PathCache;
 }
 class NfsMaps;
@@ -221,6 +224,9 @@ class FileSystem : SingleCopy, public BootFactory {
   perf::Counter *n_fs_lookup_negative() { return n_fs_lookup_negative_; }
   perf::Counter *n_fs_open() { return n_fs_open_; }
   perf::Counter *n_fs_read() { return n_fs_read_; }
+  perf::Counter *n_fs_read_copy() { return n_fs_read_copy_; }
+  perf::Counter *n_fs_read_splice() { return n_fs_read_splice_; }
+  perf::Counter *n_fs_open_passthrough() { return n_fs_open_passthrough_; }
   perf::Counter *n_fs_readlink() { return n_fs_readlink_; }
   perf::Counter *n_fs_stat() { return n_fs_stat_; }
   perf::Counter *n_fs_stat_stale() { return n_fs_stat_stale_; }
@@ -260,7 +266,7 @@ class FileSystem : SingleCopy, public BootFactory {
     PosixCacheSettings() :
       is_shared(false), is_alien(false), is_managed(false),
       avoid_rename(false), cache_base_defined(false), cache_dir_defined(false),
-      quota_limit(0)
+      is_sharded_quota(false), quota_limit(0)
       { }
     bool is_shared;
     bool is_alien;
@@ -268,6 +274,10 @@ class FileSystem : SingleCopy, public BootFactory {
     bool avoid_rename;
     bool cache_base_defined;
     bool cache_dir_defined;
+    /**
+     * Use the ShardedQuotaManager instead of the PosixQuotaManager
+     */
+    bool is_sharded_quota;
     /**
      * Soft limit in bytes for the cache.  The quota manager removes half the
      * cache when the limit is exceeded.
@@ -333,6 +343,9 @@ class FileSystem : SingleCopy, public BootFactory {
   perf::Counter *n_fs_statfs_;
   perf::Counter *n_fs_statfs_cached_;
   perf::Counter *n_fs_read_;
+  perf::Counter *n_fs_read_copy_;
+  perf::Counter *n_fs_read_splice_;
+  perf::Counter *n_fs_open_passthrough_;
   perf::Counter *n_fs_readlink_;
   perf::Counter *n_fs_forget_;
   perf::Counter *n_fs_inode_replace_;
@@ -512,6 +525,8 @@ class MountPoint : SingleCopy, public BootFactory {
   bool enforce_acls() { return enforce_acls_; }
   bool cache_symlinks() { return cache_symlinks_; }
   bool fuse_expire_entry() { return fuse_expire_entry_; }
+  bool fuse_splice_read() { return fuse_splice_read_; }
+  bool fuse_passthrough() { return fuse_passthrough_; }
   catalog::InodeAnnotation *inode_annotation() {
     return inode_annotation_;
   }
@@ -520,9 +535,14 @@ class MountPoint : SingleCopy, public BootFactory {
   double kcache_timeout_sec() { return kcache_timeout_sec_; }
   lru::Md5PathCache *md5path_cache() { return md5path_cache_; }
   std::string membership_req() { return membership_req_; }
+  lru::NegativeLookupCache *negative_lookup_cache() {
+    return negative_lookup_cache_;
+  }
   glue::DentryTracker *dentry_tracker() { return dentry_tracker_; }
+  cvmfs::DirectoryListingCache *listing_cache() { return listing_cache_; }
   glue::PageCacheTracker *page_cache_tracker() { return page_cache_tracker_; }
   lru::PathCache *path_cache() { return path_cache_; }
+  cvmfs::ChunkReadAhead *read_ahead() { return read_ahead_; }
   std::string repository_tag() { return repository_tag_; }
   SimpleChunkTables *simple_chunk_tables() { return simple_chunk_tables_; }
   perf::Statistics *statistics() { return statistics_; }
@@ -538,6 +558,8 @@ class MountPoint : SingleCopy, public BootFactory {
   bool ReloadBlacklists();
   void DisableCacheSymlinks();
   void EnableFuseExpireEntry();
+  void DisableFuseSpliceRead();
+  void DisableFusePassthrough();
 
  private:
   /**
@@ -561,6 +583,15 @@ class MountPoint : SingleCopy, public BootFactory {
    * Default to 16M RAM for meta-data caches; does not include the inode tracker
    */
   static const unsigned kDefaultMemcacheSize = 16 * 1024 * 1024;
+  /**
+   * Number of failed (parent inode, name) lookups remembered in the fuse
+   * module; in addition to the negative entries of the md5path cache.
+   */
+  static const unsigned kDefaultNegativeLookupCacheSize = 64 * 1024;
+  /**
+   * Memory for serialized directory listings in the fuse module, in MB
+   */
+  static const unsigned kDefaultListingCacheSizeMb = 8;
   /**
    * Where to look for external authz helpers.
    */
@@ -581,6 +612,10 @@ class MountPoint : SingleCopy, public BootFactory {
    */
   static const unsigned kTracerBufferSize = 8192;
   static const unsigned kTracerFlushThreshold = 7000;
+  /**
+   * Chunk read-ahead is off by default (window of 0 chunks)
+   */
+  static const unsigned kDefaultReadAheadChunks = 0;
   static const char *kDefaultBlacklist;  // "/etc/cvmfs/blacklist"
   /**
    * Default values for telemetry aggregator
@@ -601,6 +636,7 @@ class MountPoint : SingleCopy, public BootFactory {
   void CreateFetchers();
   bool CreateCatalogManager();
   void CreateTables();
+  void CreateReadAhead();
   bool CreateTracer();
   bool SetupBehavior();
   void SetupDnsTuning(download::DownloadManager *manager);
@@ -639,9 +675,18 @@ class MountPoint : SingleCopy, public BootFactory {
   catalog::ClientCatalogManager *catalog_mgr_;
   ChunkTables *chunk_tables_;
   SimpleChunkTables *simple_chunk_tables_;
+  cvmfs::ChunkReadAhead *read_ahead_;
   lru::InodeCache *inode_cache_;
   lru::PathCache *path_cache_;
   lru::Md5PathCache *md5path_cache_;
+  /**
+   * NULL if CVMFS_NEGATIVE_LOOKUP_CACHE_SIZE=0
+   */
+  lru::NegativeLookupCache *negative_lookup_cache_;
+  /**
+   * NULL if CVMFS_LISTING_CACHE_SIZE=0
+   */
+  cvmfs::DirectoryListingCache *listing_cache_;
   Tracer *tracer_;
   glue::InodeTracker *inode_tracker_;
   glue::DentryTracker *dentry_tracker_;
@@ -658,6 +703,8 @@ class MountPoint : SingleCopy, public BootFactory {
   bool enforce_acls_;
   bool cache_symlinks_;
   bool fuse_expire_entry_;
+  bool fuse_splice_read_;
+  bool fuse_passthrough_;
   std::string repository_tag_;
   std::vector<std::string> blacklist_paths_;
 
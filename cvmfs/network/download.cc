@@ -150,6 +150,28 @@ static unsigned EscapeHeader(const string &header,
 }
 
 
+/**
+ * Size of the cvmfs-info: header for extra_info including the terminating
+ * null character.  The header is written by WriteInfoHeader().
+ */
+static unsigned GetInfoHeaderSize(const string &extra_info) {
+  return 1 + strlen("cvmfs-info: ") + EscapeHeader(extra_info, NULL, 0);
+}
+
+
+static void WriteInfoHeader(const string &extra_info,
+                            char *header,
+                            unsigned header_size)
+{
+  const char *header_name = "cvmfs-info: ";
+  const size_t header_name_len = strlen(header_name);
+  memcpy(header, header_name, header_name_len);
+  EscapeHeader(extra_info, header + header_name_len,
+               header_size - header_name_len);
+  header[header_size-1] = '\0';
+}
+
+
 static Failures PrepareDownloadDestination(JobInfo *info) {
   info->destination_mem.size = 0;
   info->destination_mem.pos = 0;
@@ -189,13 +211,15 @@ static size_t CallbackCurlHeader(void *ptr, size_t size, size_t nmemb,
   // LogCvmfs(kLogDownload, kLogDebug, "REMOVE-ME: Header callback with %s",
   //          header_line.c_str());
 
-  // Check http status codes
-  if (HasPrefix(header_line, "HTTP/1.", false)) {
+  // Check http status codes, the status line of HTTP/2 is "HTTP/2 <code>"
+  const bool is_http1 = HasPrefix(header_line, "HTTP/1.", false);
+  if (is_http1 || HasPrefix(header_line, "HTTP/2", false)) {
     if (header_line.length() < 10)
       return 0;
 
     unsigned i;
-    for (i = 8; (i < header_line.length()) && (header_line[i] == ' '); ++i) {}
+    for (i = is_http1 ? 8 : 6;
+         (i < header_line.length()) && (header_line[i] == ' '); ++i) {}
 
     // Code is initialized to -1
     if (header_line.length() > i+2) {
@@ -296,15 +320,21 @@ static size_t CallbackCurlData(void *ptr, size_t size, size_t nmemb,
     return 0;
 
   if (info->expected_hash) {
+    const uint64_t timestamp_ns = platform_monotonic_time_ns();
     shash::Update(reinterpret_cast<unsigned char *>(ptr),
                   num_bytes, info->hash_context);
+    info->ns_verify += platform_monotonic_time_ns() - timestamp_ns;
   }
 
   if (info->destination == kDestinationSink) {
     if (info->compressed) {
-      zlib::StreamStates retval =
-        zlib::DecompressZStream2Sink(ptr, static_cast<int64_t>(num_bytes),
-                                     &info->zstream, info->destination_sink);
+      const uint64_t timestamp_ns = platform_monotonic_time_ns();
+      zlib::StreamStates retval = (info->decompressor == NULL)
+        ? zlib::DecompressZStream2Sink(ptr, static_cast<int64_t>(num_bytes),
+                                       &info->zstream, info->destination_sink)
+        : info->decompressor->Decompress2Sink(
+            ptr, static_cast<int64_t>(num_bytes), info->destination_sink);
+      info->ns_inflate += platform_monotonic_time_ns() - timestamp_ns;
       if (retval == zlib::kStreamDataError) {
         LogCvmfs(kLogDownload, kLogSyslogErr, "failed to decompress %s",
                  info->url->c_str());
@@ -350,9 +380,13 @@ static size_t CallbackCurlData(void *ptr, size_t size, size_t nmemb,
     if (info->compressed) {
       // LogCvmfs(kLogDownload, kLogDebug, "REMOVE-ME: writing %d bytes for %s",
       //          num_bytes, info->url->c_str());
-      zlib::StreamStates retval =
-        zlib::DecompressZStream2File(ptr, static_cast<int64_t>(num_bytes),
-                                     &info->zstream, info->destination_file);
+      const uint64_t timestamp_ns = platform_monotonic_time_ns();
+      zlib::StreamStates retval = (info->decompressor == NULL)
+        ? zlib::DecompressZStream2File(ptr, static_cast<int64_t>(num_bytes),
+                                       &info->zstream, info->destination_file)
+        : info->decompressor->Decompress2File(
+            ptr, static_cast<int64_t>(num_bytes), info->destination_file);
+      info->ns_inflate += platform_monotonic_time_ns() - timestamp_ns;
       if (retval == zlib::kStreamDataError) {
         LogCvmfs(kLogDownload, kLogSyslogErr, "failed to decompress %s",
                  info->url->c_str());
@@ -630,7 +664,12 @@ void *DownloadManager::MainDownload(void *data) {
           // Return easy handle into pool and write result back
           download_mgr->ReleaseCurlHandle(easy_handle);
 
-          info->pipe_job_results->Write<download::Failures>(info->error_code);
+          if (info->callback != NULL) {
+            download_mgr->FinalizeAsync(info);
+          } else {
+            info->pipe_job_results->Write<download::Failures>(
+              info->error_code);
+          }
         }
       }
     }
@@ -861,12 +900,19 @@ void DownloadManager::InitializeRequest(JobInfo *info, CURL *handle) {
     info->nocache = false;
   }
   if (info->compressed) {
-    zlib::DecompressInit(&(info->zstream));
+    if (info->compression_alg != zlib::kZlibDefault) {
+      info->decompressor =
+        zlib::Decompressor::Construct(info->compression_alg);
+    }
+    // Algorithms that this build does not support fail as bad data in zlib
+    if (info->decompressor == NULL)
+      zlib::DecompressInit(&(info->zstream));
   }
   if (info->expected_hash) {
     assert(info->hash_context.buffer != NULL);
     shash::Init(info->hash_context);
   }
+  info->ns_inflate = info->ns_verify = 0;
 
   if ((info->range_offset != -1) && (info->range_size)) {
     char byte_range_array[100];
@@ -902,6 +948,14 @@ void DownloadManager::InitializeRequest(JobInfo *info, CURL *handle) {
     curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1);
     curl_easy_setopt(handle, CURLOPT_MAXREDIRS, 4);
   }
+  if (opt_http2_) {
+    // HTTP/2 is negotiated through ALPN, plain HTTP stays on HTTP/1.1 unless
+    // prior knowledge is enabled (see SetUrlOptions()).
+    // Rather wait for a connection that is about to be established than
+    // opening another one, so that the transfer can become a stream of it.
+    curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1);
+  }
 }
 
 
@@ -1048,6 +1102,13 @@ void DownloadManager::SetUrlOptions(JobInfo *info) {
     url = ReplaceAll(url, "@proxy@", replacement);
   }
 
+  if (opt_http2_prior_knowledge_) {
+    // Proxies are expected to speak HTTP/1.1
+    curl_easy_setopt(curl_handle, CURLOPT_HTTP_VERSION,
+      (info->proxy == "DIRECT") ? CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE
+                                : CURL_HTTP_VERSION_2TLS);
+  }
+
   if ((info->destination == kDestinationMem) &&
       (info->destination_mem.size == 0) &&
       HasPrefix(url, "file://", false))
@@ -1145,6 +1206,74 @@ void DownloadManager::UpdateStatistics(CURL *handle) {
   assert(retval == CURLE_OK);
   sum += static_cast<int64_t>(val);*/
   perf::Xadd(counters_->sz_transferred_bytes, sum);
+
+  // Connection reuse: curl reports the number of connections it had to open
+  // for the transfer, zero if an existing connection was used
+  long num_connects = 0;  // NOLINT(runtime/int)
+  retval = curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &num_connects);
+  if ((retval != CURLE_OK) || (num_connects < 0))
+    return;
+  long http_version = 0;  // NOLINT(runtime/int)
+  retval = curl_easy_getinfo(handle, CURLINFO_HTTP_VERSION, &http_version);
+  const bool is_http2 =
+    (retval == CURLE_OK) && (http_version == CURL_HTTP_VERSION_2_0);
+  if (num_connects == 0) {
+    perf::Inc(counters_->n_connections_reused);
+  } else {
+    perf::Xadd(counters_->n_connections_new, num_connects);
+    // The TLS handshake time is zero for plain connections
+    retval = curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME, &val);
+    if ((retval == CURLE_OK) && (val > 0.0))
+      perf::Inc(counters_->n_tls_handshakes);
+    if (is_http2)
+      perf::Inc(counters_->n_http2_connections);
+  }
+  if (is_http2)
+    perf::Inc(counters_->n_http2_streams);
+}
+
+
+/**
+ * Splits the time of a successful transfer into its stages.  Curl reports the
+ * stages as the time elapsed since the start of the transfer.  For reused
+ * connections, the connection setup times are zero.
+ */
+void DownloadManager::UpdateStageHistograms(JobInfo *info) {
+  double t_dns, t_connect, t_tls, t_pretransfer, t_first_byte, t_total;
+  CURL *handle = info->curl_handle;
+  if ((curl_easy_getinfo(handle, CURLINFO_NAMELOOKUP_TIME, &t_dns) !=
+       CURLE_OK) ||
+      (curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME, &t_connect) !=
+       CURLE_OK) ||
+      (curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME, &t_tls) !=
+       CURLE_OK) ||
+      (curl_easy_getinfo(handle, CURLINFO_PRETRANSFER_TIME, &t_pretransfer) !=
+       CURLE_OK) ||
+      (curl_easy_getinfo(handle, CURLINFO_STARTTRANSFER_TIME, &t_first_byte) !=
+       CURLE_OK) ||
+      (curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME, &t_total) != CURLE_OK))
+  {
+    return;
+  }
+  // The histograms are in microseconds
+  const double kUs = 1e6;
+  if (t_connect > 0.0) {
+    counters_->hist_dns->Add(static_cast<uint64_t>(t_dns * kUs));
+    counters_->hist_connect->Add(
+      static_cast<uint64_t>(std::max(t_connect - t_dns, 0.0) * kUs));
+    if (t_tls > 0.0) {
+      counters_->hist_tls->Add(
+        static_cast<uint64_t>(std::max(t_tls - t_connect, 0.0) * kUs));
+    }
+  }
+  counters_->hist_ttfb->Add(
+    static_cast<uint64_t>(std::max(t_first_byte - t_pretransfer, 0.0) * kUs));
+  counters_->hist_transfer->Add(
+    static_cast<uint64_t>(std::max(t_total - t_first_byte, 0.0) * kUs));
+  if (info->compressed)
+    counters_->hist_inflate->Add(info->ns_inflate / 1000);
+  if (info->expected_hash)
+    counters_->hist_verify->Add(info->ns_verify / 1000);
 }
 
 
@@ -1244,7 +1373,9 @@ bool DownloadManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
       // Verify content hash
       if (info->expected_hash) {
         shash::Any match_hash;
+        const uint64_t timestamp_ns = platform_monotonic_time_ns();
         shash::Final(info->hash_context, &match_hash);
+        info->ns_verify += platform_monotonic_time_ns() - timestamp_ns;
         if (match_hash != *(info->expected_hash)) {
           LogCvmfs(kLogDownload, kLogDebug,
                    "hash verification of %s failed (expected %s, got %s)",
@@ -1259,10 +1390,13 @@ bool DownloadManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
       if ((info->destination == kDestinationMem) && info->compressed) {
         void *buf;
         uint64_t size;
+        const uint64_t timestamp_ns = platform_monotonic_time_ns();
         bool retval = zlib::DecompressMem2Mem(
+          info->compression_alg,
           info->destination_mem.data,
           static_cast<int64_t>(info->destination_mem.pos),
           &buf, &size);
+        info->ns_inflate += platform_monotonic_time_ns() - timestamp_ns;
         if (retval) {
           free(info->destination_mem.data);
           info->destination_mem.data = static_cast<char *>(buf);
@@ -1277,6 +1411,7 @@ bool DownloadManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
       }
 
       info->error_code = kFailOk;
+      UpdateStageHistograms(info);
       break;
     case CURLE_UNSUPPORTED_PROTOCOL:
       info->error_code = kFailUnsupportedProtocol;
@@ -1443,8 +1578,13 @@ bool DownloadManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
     }
     if (info->expected_hash)
       shash::Init(info->hash_context);
-    if (info->compressed)
-      zlib::DecompressInit(&info->zstream);
+    if (info->compressed) {
+      if (info->decompressor == NULL)
+        zlib::DecompressInit(&info->zstream);
+      else
+        info->decompressor->Reset();
+    }
+    info->ns_inflate = info->ns_verify = 0;
     SetRegularCache(info);
 
     // Failure handling
@@ -1510,8 +1650,14 @@ bool DownloadManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
     info->destination_file = NULL;
   }
 
-  if (info->compressed)
-    zlib::DecompressFini(&info->zstream);
+  if (info->compressed) {
+    if (info->decompressor == NULL) {
+      zlib::DecompressFini(&info->zstream);
+    } else {
+      delete info->decompressor;
+      info->decompressor = NULL;
+    }
+  }
 
   if (info->headers) {
     header_lists_->PutList(info->headers);
@@ -1566,6 +1712,9 @@ DownloadManager::DownloadManager() {
   enable_info_header_ = false;
   opt_ipv4_only_ = false;
   follow_redirects_ = false;
+  opt_http2_ = false;
+  opt_http2_prior_knowledge_ = false;
+  opt_http2_max_streams_ = kDefaultHttp2MaxStreams;
 
   resolver_ = NULL;
 
@@ -1728,6 +1877,24 @@ void DownloadManager::Spawn() {
 }
 
 
+/**
+ * Removes partial results of a failed download.
+ */
+static void CleanupFailedDownload(JobInfo *info) {
+  LogCvmfs(kLogDownload, kLogDebug, "download failed (error %d - %s)",
+           info->error_code, Code2Ascii(info->error_code));
+
+  if (info->destination == kDestinationPath)
+    unlink(info->destination_path->c_str());
+
+  if (info->destination_mem.data) {
+    free(info->destination_mem.data);
+    info->destination_mem.data = NULL;
+    info->destination_mem.size = 0;
+  }
+}
+
+
 /**
  * Downloads data from an insecure outside channel (currently HTTP or file).
  */
@@ -1750,15 +1917,9 @@ Failures DownloadManager::Fetch(JobInfo *info) {
   // Prepare cvmfs-info: header, allocate string on the stack
   info->info_header = NULL;
   if (enable_info_header_ && info->extra_info) {
-    const char *header_name = "cvmfs-info: ";
-    const size_t header_name_len = strlen(header_name);
-    const unsigned header_size = 1 + header_name_len +
-      EscapeHeader(*(info->extra_info), NULL, 0);
+    const unsigned header_size = GetInfoHeaderSize(*(info->extra_info));
     info->info_header = static_cast<char *>(alloca(header_size));
-    memcpy(info->info_header, header_name, header_name_len);
-    EscapeHeader(*(info->extra_info), info->info_header + header_name_len,
-                 header_size - header_name_len);
-    info->info_header[header_size-1] = '\0';
+    WriteInfoHeader(*(info->extra_info), info->info_header, header_size);
   }
 
   if (atomic_xadd32(&multi_threaded_, 0) == 1) {
@@ -1773,41 +1934,103 @@ Failures DownloadManager::Fetch(JobInfo *info) {
     info->pipe_job_results->Read<download::Failures>(&result);
     // LogCvmfs(kLogDownload, kLogDebug, "got result %d", result);
   } else {
-    MutexLockGuard l(lock_synchronous_mode_);
-    CURL *handle = AcquireCurlHandle();
-    InitializeRequest(info, handle);
-    SetUrlOptions(info);
-    // curl_easy_setopt(handle, CURLOPT_VERBOSE, 1);
-    int retval;
-    do {
-      retval = curl_easy_perform(handle);
-      perf::Inc(counters_->n_requests);
-      double elapsed;
-      if (curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME, &elapsed) == CURLE_OK)
-      {
-        perf::Xadd(counters_->sz_transfer_time,
-                   static_cast<int64_t>(elapsed * 1000));
-      }
-    } while (VerifyAndFinalize(retval, info));
-    result = info->error_code;
-    ReleaseCurlHandle(info->curl_handle);
+    result = PerformSynchronously(info);
   }
 
-  if (result != kFailOk) {
-    LogCvmfs(kLogDownload, kLogDebug, "download failed (error %d - %s)", result,
-             Code2Ascii(result));
+  if (result != kFailOk)
+    CleanupFailedDownload(info);
 
-    if (info->destination == kDestinationPath)
-      unlink(info->destination_path->c_str());
+  return result;
+}
 
-    if (info->destination_mem.data) {
-      free(info->destination_mem.data);
-      info->destination_mem.data = NULL;
-      info->destination_mem.size = 0;
-    }
+
+/**
+ * Like Fetch() but returns without waiting for the transfer.  Once the job is
+ * finished, including retries and failover, info->callback is called with the
+ * job.  Usually that happens in the download I/O thread, so the callback must
+ * not block.  If the download manager runs in single-threaded mode or if the
+ * download destination cannot be prepared, the callback is called before
+ * FetchAsync() returns.  The job must stay valid until the callback is called;
+ * the callback is free to delete it.
+ */
+void DownloadManager::FetchAsync(JobInfo *info) {
+  assert(info != NULL);
+  assert(info->url != NULL);
+  assert(info->callback != NULL);
+
+  info->error_code = PrepareDownloadDestination(info);
+  if (info->error_code != kFailOk) {
+    (*info->callback)(info);
+    return;
   }
 
-  return result;
+  // The job outlives this stack frame, so the hash context and the cvmfs-info:
+  // header are allocated on the heap.  They are freed in FinalizeAsync().
+  info->hash_context.buffer = NULL;
+  if (info->expected_hash) {
+    const shash::Algorithms algorithm = info->expected_hash->algorithm;
+    info->hash_context.algorithm = algorithm;
+    info->hash_context.size = shash::GetContextSize(algorithm);
+    info->hash_context.buffer = smalloc(info->hash_context.size);
+  }
+  info->info_header = NULL;
+  if (enable_info_header_ && info->extra_info) {
+    const unsigned header_size = GetInfoHeaderSize(*(info->extra_info));
+    info->info_header = static_cast<char *>(smalloc(header_size));
+    WriteInfoHeader(*(info->extra_info), info->info_header, header_size);
+  }
+
+  if (atomic_xadd32(&multi_threaded_, 0) == 1) {
+    // NOLINTNEXTLINE(bugprone-sizeof-expression)
+    pipe_jobs_->Write<JobInfo*>(info);
+    return;
+  }
+
+  PerformSynchronously(info);
+  FinalizeAsync(info);
+}
+
+
+/**
+ * Counterpart of the result pipe for jobs from FetchAsync().  The job must not
+ * be touched after the callback was called.
+ */
+void DownloadManager::FinalizeAsync(JobInfo *info) {
+  if (info->error_code != kFailOk)
+    CleanupFailedDownload(info);
+
+  free(info->hash_context.buffer);
+  info->hash_context.buffer = NULL;
+  free(info->info_header);
+  info->info_header = NULL;
+
+  (*info->callback)(info);
+}
+
+
+/**
+ * Runs the transfer in the calling thread, used if the I/O thread has not been
+ * spawned.
+ */
+Failures DownloadManager::PerformSynchronously(JobInfo *info) {
+  MutexLockGuard l(lock_synchronous_mode_);
+  CURL *handle = AcquireCurlHandle();
+  InitializeRequest(info, handle);
+  SetUrlOptions(info);
+  // curl_easy_setopt(handle, CURLOPT_VERBOSE, 1);
+  int retval;
+  do {
+    retval = curl_easy_perform(handle);
+    perf::Inc(counters_->n_requests);
+    double elapsed;
+    if (curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME, &elapsed) == CURLE_OK)
+    {
+      perf::Xadd(counters_->sz_transfer_time,
+                 static_cast<int64_t>(elapsed * 1000));
+    }
+  } while (VerifyAndFinalize(retval, info));
+  ReleaseCurlHandle(info->curl_handle);
+  return info->error_code;
 }
 
 
@@ -2774,6 +2997,46 @@ void DownloadManager::EnableRedirects() {
   follow_redirects_ = true;
 }
 
+/**
+ * Uses HTTP/2 for hosts and proxies that support it, so that concurrent
+ * transfers to the same host are multiplexed over a single connection with up
+ * to max_streams streams.  HTTP/2 is negotiated during the TLS handshake, so
+ * only HTTPS transfers are affected; for plain HTTP and for servers without
+ * HTTP/2 support, the transfers continue to use HTTP/1.1.
+ *
+ * With prior_knowledge, plain HTTP transfers that do not go through a proxy
+ * use HTTP/2 right away (h2c).  That fails for hosts that do not speak HTTP/2.
+ * Proxies are not contacted with h2c: plain HTTP through a proxy always uses
+ * HTTP/1.1.
+ *
+ * Returns false if libcurl has been built without HTTP/2.  Needs to be called
+ * before Spawn().
+ */
+bool DownloadManager::EnableHttp2(
+  const unsigned max_streams,
+  const bool prior_knowledge)
+{
+  curl_version_info_data *version_info = curl_version_info(CURLVERSION_NOW);
+  if (!(version_info->features & CURL_VERSION_HTTP2)) {
+    LogCvmfs(kLogDownload, kLogDebug | kLogSyslogWarn,
+             "libcurl %s lacks HTTP/2 support, using HTTP/1.1",
+             version_info->version);
+    return false;
+  }
+
+  opt_http2_ = true;
+  opt_http2_prior_knowledge_ = prior_knowledge;
+  opt_http2_max_streams_ = (max_streams > 0) ? max_streams : 1;
+  curl_multi_setopt(curl_multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+  curl_multi_setopt(curl_multi_, CURLMOPT_MAX_CONCURRENT_STREAMS,
+                    static_cast<long>(opt_http2_max_streams_));  // NOLINT
+  LogCvmfs(kLogDownload, kLogDebug,
+           "enabled HTTP/2 multiplexing, up to %u streams per connection",
+           opt_http2_max_streams_);
+  return true;
+}
+
+
 void DownloadManager::UseSystemCertificatePath() {
   ssl_certificate_store_.UseSystemCertificatePath();
 }
@@ -2802,6 +3065,8 @@ DownloadManager *DownloadManager::Clone(
   clone->opt_backoff_max_ms_ = opt_backoff_max_ms_;
   clone->enable_info_header_ = enable_info_header_;
   clone->follow_redirects_ = follow_redirects_;
+  if (opt_http2_)
+    clone->EnableHttp2(opt_http2_max_streams_, opt_http2_prior_knowledge_);
   if (opt_host_chain_) {
     clone->opt_host_chain_ = new vector<string>(*opt_host_chain_);
     clone->opt_host_chain_rtt_ = new vector<int>(*opt_host_chain_rtt_);
@@ -25,6 +25,7 @@
 #include "sink.h"
 #include "ssl.h"
 #include "statistics.h"
+#include "util/async.h"
 #include "util/atomic.h"
 #include "util/pipe.h"
 #include "util/pointer.h"
@@ -133,6 +134,20 @@ struct Counters {
   perf::Counter *n_retries;
   perf::Counter *n_proxy_failover;
   perf::Counter *n_host_failover;
+  perf::Counter *n_connections_new;
+  perf::Counter *n_connections_reused;
+  perf::Counter *n_tls_handshakes;
+  perf::Counter *n_http2_connections;
+  perf::Counter *n_http2_streams;
+  // Latency of the stages of successful transfers in nanoseconds.  Connection
+  // setup stages are only recorded for new connections.
+  Log2Histogram *hist_dns;
+  Log2Histogram *hist_connect;
+  Log2Histogram *hist_tls;
+  Log2Histogram *hist_ttfb;
+  Log2Histogram *hist_transfer;
+  Log2Histogram *hist_inflate;
+  Log2Histogram *hist_verify;
 
   explicit Counters(perf::StatisticsTemplate statistics) {
     sz_transferred_bytes = statistics.RegisterTemplated("sz_transferred_bytes",
@@ -146,6 +161,30 @@ struct Counters {
         "Number of proxy failovers");
     n_host_failover = statistics.RegisterTemplated("n_host_failover",
         "Number of host failovers");
+    n_connections_new = statistics.RegisterTemplated("n_connections_new",
+        "Number of newly established connections");
+    n_connections_reused = statistics.RegisterTemplated("n_connections_reused",
+        "Number of requests sent over an existing connection");
+    n_tls_handshakes = statistics.RegisterTemplated("n_tls_handshakes",
+        "Number of TLS handshakes");
+    n_http2_connections = statistics.RegisterTemplated("n_http2_connections",
+        "Number of newly established HTTP/2 connections");
+    n_http2_streams = statistics.RegisterTemplated("n_http2_streams",
+        "Number of requests sent as HTTP/2 streams");
+    hist_dns = statistics.RegisterHistogramTemplated("hist_dns",
+        "Name resolution time of new connections");
+    hist_connect = statistics.RegisterHistogramTemplated("hist_connect",
+        "TCP connect time of new connections");
+    hist_tls = statistics.RegisterHistogramTemplated("hist_tls",
+        "TLS handshake time of new connections");
+    hist_ttfb = statistics.RegisterHistogramTemplated("hist_ttfb",
+        "Time from sending the request to the first byte of the response");
+    hist_transfer = statistics.RegisterHistogramTemplated("hist_transfer",
+        "Time from the first to the last byte of the response");
+    hist_inflate = statistics.RegisterHistogramTemplated("hist_inflate",
+        "Time spent decompressing downloaded data");
+    hist_verify = statistics.RegisterHistogramTemplated("hist_verify",
+        "Time spent hashing downloaded data");
   }
 };  // Counters
 
@@ -156,6 +195,11 @@ struct Counters {
 struct JobInfo {
   const std::string *url;
   bool compressed;
+  /**
+   * Used if compressed is set.  Objects compressed with zlib are decompressed
+   * through zstream, all other algorithms through decompressor.
+   */
+  zlib::Algorithms compression_alg;
   bool probe_hosts;
   bool head_request;
   bool follow_redirects;
@@ -181,10 +225,17 @@ struct JobInfo {
   off_t range_offset;
   off_t range_size;
 
+  /**
+   * Set for jobs handed to DownloadManager::FetchAsync(); invoked with the
+   * finished job.  Owned by the caller.
+   */
+  const CallbackBase<JobInfo *> *callback;
+
   // Default initialization of fields
   void Init() {
     url = NULL;
     compressed = false;
+    compression_alg = zlib::kZlibDefault;
     probe_hosts = false;
     head_request = false;
     follow_redirects = false;
@@ -206,6 +257,8 @@ struct JobInfo {
     curl_handle = NULL;
     headers = NULL;
     memset(&zstream, 0, sizeof(zstream));
+    decompressor = NULL;
+    ns_inflate = ns_verify = 0;
     info_header = NULL;
     pipe_job_results = NULL;
     nocache = false;
@@ -217,6 +270,7 @@ struct JobInfo {
     range_offset = -1;
     range_size = -1;
     http_code = -1;
+    callback = NULL;
   }
 
   // One constructor per destination + head request
@@ -288,7 +342,11 @@ struct JobInfo {
   curl_slist *headers;
   char *info_header;
   z_stream zstream;
+  zlib::Decompressor *decompressor;
   shash::ContextPtr hash_context;
+  // Accumulated over the data callbacks of the current attempt
+  uint64_t ns_inflate;
+  uint64_t ns_verify;
 
   /// Pipe used for the return value
   UniquePtr<Pipe<kPipeDownloadJobsResults> > pipe_job_results;
@@ -401,6 +459,7 @@ class DownloadManager {  // NOLINT(clang-analyzer-optin.performance.Padding)
   static const unsigned kDnsDefaultRetries = 1;
   static const unsigned kDnsDefaultTimeoutMs = 3000;
   static const unsigned kProxyMapScale = 16;
+  static const unsigned kDefaultHttp2MaxStreams = 100;
 
   DownloadManager();
   ~DownloadManager();
@@ -413,6 +472,7 @@ class DownloadManager {  // NOLINT(clang-analyzer-optin.performance.Padding)
   void Spawn();
   DownloadManager *Clone(const perf::StatisticsTemplate &statistics);
   Failures Fetch(JobInfo *info);
+  void FetchAsync(JobInfo *info);
 
   void SetCredentialsAttachment(CredentialsAttachment *ca);
   std::string GetDnsServer() const;
@@ -456,6 +516,8 @@ class DownloadManager {  // NOLINT(clang-analyzer-optin.performance.Padding)
   void SetProxyTemplates(const std::string &direct, const std::string &forced);
   void EnableInfoHeader();
   void EnableRedirects();
+  bool EnableHttp2(const unsigned max_streams,
+                   const bool prior_knowledge = false);
   void UseSystemCertificatePath();
 
   unsigned num_hosts() {
@@ -488,11 +550,14 @@ class DownloadManager {  // NOLINT(clang-analyzer-optin.performance.Padding)
   void SetUrlOptions(JobInfo *info);
   bool ValidateProxyIpsUnlocked(const std::string &url, const dns::Host &host);
   void UpdateStatistics(CURL *handle);
+  void UpdateStageHistograms(JobInfo *info);
   bool CanRetry(const JobInfo *info);
   void Backoff(JobInfo *info);
   void SetNocache(JobInfo *info);
   void SetRegularCache(JobInfo *info);
   bool VerifyAndFinalize(const int curl_error, JobInfo *info);
+  Failures PerformSynchronously(JobInfo *info);
+  void FinalizeAsync(JobInfo *info);
   void InitHeaders();
   void FiniHeaders();
   void CloneProxyConfig(DownloadManager *clone);
@@ -533,6 +598,18 @@ class DownloadManager {  // NOLINT(clang-analyzer-optin.performance.Padding)
   bool enable_info_header_;
   bool opt_ipv4_only_;
   bool follow_redirects_;
+  /**
+   * Negotiate HTTP/2 and multiplex transfers to the same host
+   */
+  bool opt_http2_;
+  /**
+   * Use HTTP/2 without negotiation for plain HTTP hosts without proxy
+   */
+  bool opt_http2_prior_knowledge_;
+  /**
+   * Maximum number of concurrent HTTP/2 streams per connection
+   */
+  unsigned opt_http2_max_streams_;
 
   // Host list
   std::vector<std::string> *opt_host_chain_;
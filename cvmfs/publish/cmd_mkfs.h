@@ -44,7 +44,8 @@ class CmdMkfs : public Command {
       "Specify a `date` compatible time windows for keeping auto tags"));
 
     p.push_back(Parameter::Optional("hash", 'a', "algorithm",
-      "Select a secure hash algorithm: sha1 (default) or rmd160 or shake128"));
+      "Select a secure hash algorithm: sha1 (default), rmd160, shake128, "
+      "or blake3"));
 
     p.push_back(Parameter::Switch("gc", 'z',
       "Make the repository garbage-collectable"));
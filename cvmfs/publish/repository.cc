@@ -257,6 +257,7 @@ void Publisher::ConstructSpoolers() {
     settings_.storage().GetLocator(),
     settings_.transaction().hash_algorithm(),
     settings_.transaction().compression_algorithm());
+  sd.compression_level = settings_.transaction().compression_level();
   sd.session_token_file =
     settings_.transaction().spool_area().gw_session_token();
   sd.key_file = settings_.keychain().gw_key_path();
@@ -326,6 +327,14 @@ void Publisher::CreateRootObjects() {
   manifest_->set_has_alt_catalog_path(needs_bootstrap_shortcuts);
   manifest_->set_garbage_collectability(
     settings_.transaction().is_garbage_collectable());
+  const std::string min_client_version =
+    zlib::MinClientVersion(settings_.transaction().compression_algorithm());
+  if (!min_client_version.empty())
+    manifest_->RequireClientVersion(min_client_version);
+  const std::string min_client_version_hash =
+    shash::MinClientVersion(settings_.transaction().hash_algorithm());
+  if (!min_client_version_hash.empty())
+    manifest_->RequireClientVersion(min_client_version_hash);
 
   // Tag database
   const std::string tags_path = CreateTempPath(
@@ -701,6 +710,7 @@ void Publisher::ConstructSyncManagers() {
       settings_.transaction().use_catalog_autobalance(),
       settings_.transaction().autobalance_max_weight(),
       settings_.transaction().autobalance_min_weight());
+    catalog_mgr_->SetPathFilters(settings_.transaction().path_filters());
     catalog_mgr_->Init();
   }
 
@@ -714,6 +724,8 @@ void Publisher::ConstructSyncManagers() {
     p->dir_temp = settings_.transaction().spool_area().tmp_dir();
     p->base_hash = settings_.transaction().base_hash();
     p->stratum0 = settings_.url();
+    p->compression_alg = settings_.transaction().compression_algorithm();
+    p->compression_level = settings_.transaction().compression_level();
     // p->manifest_path = SHOULD NOT BE NEEDED
     // p->spooler_definition = SHOULD NOT BE NEEDED;
     // p->union_fs_type = SHOULD NOT BE NEEDED
@@ -81,12 +81,17 @@ void SettingsTransaction::SetHashAlgorithm(const std::string &algorithm) {
 void SettingsTransaction::SetCompressionAlgorithm(const std::string &algorithm)
 {
   compression_algorithm_ = zlib::ParseCompressionAlgorithm(algorithm);
+  compression_level_ = zlib::ParseCompressionLevel(algorithm);
 }
 
 void SettingsTransaction::SetEnforceLimits(bool value) {
   enforce_limits_ = value;
 }
 
+void SettingsTransaction::SetPathFilters(bool value) {
+  path_filters_ = value;
+}
+
 void SettingsTransaction::SetLimitNestedCatalogKentries(unsigned value) {
   limit_nested_catalog_kentries_ = value;
 }
@@ -559,6 +564,10 @@ void SettingsBuilder::ApplyOptionsFromServerPath(
     settings_publisher->GetTransaction()->SetEnforceLimits(
         options_mgr_.IsOn(arg));
   }
+  if (options_mgr_.GetValue("CVMFS_CATALOG_PATH_FILTER", &arg)) {
+    settings_publisher->GetTransaction()->SetPathFilters(
+        options_mgr_.IsOn(arg));
+  }
   if (options_mgr_.GetValue("CVMFS_NESTED_KCATALOG_LIMIT", &arg)) {
     settings_publisher->GetTransaction()->SetLimitNestedCatalogKentries(
         String2Uint64(arg));
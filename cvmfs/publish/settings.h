@@ -137,10 +137,12 @@ class SettingsTransaction {
     , in_enter_session_(false)
     , hash_algorithm_(shash::kShake128)
     , compression_algorithm_(zlib::kZlibDefault)
+    , compression_level_(0)
     , ttl_second_(240)
     , is_garbage_collectable_(true)
     , is_volatile_(false)
     , enforce_limits_(false)
+    , path_filters_(false)
     // SyncParameters::kDefaultNestedKcatalogLimit
     , limit_nested_catalog_kentries_(500)
     // SyncParameters::kDefaultRootKcatalogLimit
@@ -166,6 +168,7 @@ class SettingsTransaction {
   void SetHashAlgorithm(const std::string &algorithm);
   void SetCompressionAlgorithm(const std::string &algorithm);
   void SetEnforceLimits(bool value);
+  void SetPathFilters(bool value);
   void SetLimitNestedCatalogKentries(unsigned value);
   void SetLimitRootCatalogKentries(unsigned value);
   void SetLimitFileSizeMb(unsigned value);
@@ -192,10 +195,12 @@ class SettingsTransaction {
   zlib::Algorithms compression_algorithm() const {
     return compression_algorithm_();
   }
+  int compression_level() const { return compression_level_(); }
   uint32_t ttl_second() const { return ttl_second_(); }
   bool is_garbage_collectable() const { return is_garbage_collectable_(); }
   bool is_volatile() const { return is_volatile_(); }
   bool enforce_limits() const { return enforce_limits_(); }
+  bool path_filters() const { return path_filters_(); }
   unsigned limit_nested_catalog_kentries() const {
     return limit_nested_catalog_kentries_();
   }
@@ -241,10 +246,12 @@ class SettingsTransaction {
   Setting<shash::Any> base_hash_;
   Setting<shash::Algorithms> hash_algorithm_;
   Setting<zlib::Algorithms> compression_algorithm_;
+  Setting<int> compression_level_;
   Setting<uint32_t> ttl_second_;
   Setting<bool> is_garbage_collectable_;
   Setting<bool> is_volatile_;
   Setting<bool> enforce_limits_;
+  Setting<bool> path_filters_;
   Setting<unsigned> limit_nested_catalog_kentries_;
   Setting<unsigned> limit_root_catalog_kentries_;
   Setting<unsigned> limit_file_size_mb_;
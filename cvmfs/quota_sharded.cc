@@ -0,0 +1,1144 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#define __STDC_FORMAT_MACROS
+
+#include "cvmfs_config.h"
+#include "quota_sharded.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#ifndef __APPLE__
+#include <sys/statfs.h>
+#endif
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "crypto/hash.h"
+#include "duplex_sqlite3.h"
+#include "util/exception.h"
+#include "util/logging.h"
+#include "util/mutex.h"
+#include "util/platform.h"
+#include "util/pointer.h"
+#include "util/posix.h"
+#include "util/string.h"
+
+using namespace std;  // NOLINT
+
+
+ShardedQuotaManager::Shard::Shard()
+  : index(0)
+  , clock(0)
+  , clock_published(0)
+{
+  int retval = pthread_mutex_init(&lock, NULL);
+  assert(retval == 0);
+  entries.Init(128, shash::Any(), ShardedQuotaManager::HashAny);
+}
+
+
+ShardedQuotaManager::Shard::~Shard() {
+  pthread_mutex_destroy(&lock);
+}
+
+
+/**
+ * Cleans up in data cache, until cache size is below leave_size.
+ *
+ * \return True on success, false otherwise
+ */
+bool ShardedQuotaManager::Cleanup(const uint64_t leave_size) {
+  return DoCleanup(leave_size);
+}
+
+
+void ShardedQuotaManager::CheckHighPinWatermark() {
+  const uint64_t watermark = kHighPinWatermark*cleanup_threshold_/100;
+  uint64_t pinned;
+  {
+    MutexLockGuard guard(&lock_pinned_);
+    pinned = pinned_;
+  }
+  if ((cleanup_threshold_ > 0) && (pinned > watermark)) {
+    LogCvmfs(kLogQuota, kLogDebug | kLogSyslogWarn,
+             "high watermark of pinned files (%" PRIu64 "M > %" PRIu64 "M)",
+             pinned/(1024*1024), watermark/(1024*1024));
+    BroadcastBackchannels("R");  // clients: please release pinned catalogs
+  }
+}
+
+
+void ShardedQuotaManager::CloseDatabase() {
+  if (stmt_upsert_) sqlite3_finalize(stmt_upsert_);
+  if (stmt_update_) sqlite3_finalize(stmt_update_);
+  if (stmt_rm_) sqlite3_finalize(stmt_rm_);
+  if (database_) sqlite3_close(database_);
+  if (fd_lock_cachedb_ >= 0) UnlockFile(fd_lock_cachedb_);
+
+  stmt_upsert_ = NULL;
+  stmt_update_ = NULL;
+  stmt_rm_ = NULL;
+  database_ = NULL;
+  fd_lock_cachedb_ = -1;
+}
+
+
+ShardedQuotaManager *ShardedQuotaManager::Create(
+  const string &cache_workspace,
+  const uint64_t limit,
+  const uint64_t cleanup_threshold,
+  const bool rebuild_database)
+{
+  if (cleanup_threshold >= limit) {
+    LogCvmfs(kLogQuota, kLogDebug, "invalid parameters: limit %" PRIu64 ", "
+             "cleanup_threshold %" PRIu64, limit, cleanup_threshold);
+    return NULL;
+  }
+
+  UniquePtr<ShardedQuotaManager> quota_manager(
+    new ShardedQuotaManager(limit, cleanup_threshold, cache_workspace));
+  if (!quota_manager->InitDatabase(rebuild_database))
+    return NULL;
+  MakePipe(quota_manager->pipe_background_);
+  quota_manager->protocol_revision_ = kProtocolRevision;
+  return quota_manager.Release();
+}
+
+
+bool ShardedQuotaManager::DoCleanup(const uint64_t leave_size) {
+  MutexLockGuard guard_cleanup(&lock_cleanup_);
+  if (GetSize() <= leave_size)
+    return true;
+
+  LogCvmfs(kLogQuota, kLogSyslog,
+           "clean up cache until at most %lu KB is used", leave_size/1024);
+  LogCvmfs(kLogQuota, kLogDebug, "gauge %" PRIu64, GetSize());
+  cleanup_recorder_.Tick();
+
+  // Take a snapshot of the LRU order.  Entries that are touched or replaced
+  // afterwards change their sequence number and are skipped below.
+  vector<LruCandidate> candidates;
+  for (unsigned i = 0; i < kNumShards; ++i) {
+    MutexLockGuard guard_shard(&shards_[i].lock);
+    const shash::Any empty_key = shards_[i].entries.empty_key();
+    const shash::Any *keys = shards_[i].entries.keys();
+    const Entry *values = shards_[i].entries.values();
+    for (uint32_t j = 0; j < shards_[i].entries.capacity(); ++j) {
+      if ((keys[j] == empty_key) || values[j].pinned)
+        continue;
+      candidates.push_back(LruCandidate(keys[j], values[j].size,
+                                        values[j].seq));
+    }
+  }
+  // Volatile entries have the highest bit set and come first
+  sort(candidates.begin(), candidates.end());
+
+  vector<string> trash;
+  unsigned num_pending_ops = 0;
+  for (unsigned i = 0; (i < candidates.size()) && (GetSize() > leave_size);
+       ++i)
+  {
+    const shash::Any &hash = candidates[i].hash;
+    // We must not delete a not yet inserted pinned file as it is already
+    // reserved (but will be inserted later).  Lock order: pinned, then shard.
+    MutexLockGuard guard_pinned(&lock_pinned_);
+    if (pinned_chunks_.find(hash) != pinned_chunks_.end())
+      continue;
+    Shard *shard = GetShard(hash);
+    MutexLockGuard guard_shard(&shard->lock);
+    Entry entry;
+    if (!shard->entries.Lookup(hash, &entry) ||
+        (entry.seq != candidates[i].seq) || entry.pinned)
+    {
+      continue;
+    }
+    shard->entries.Erase(hash);
+    num_pending_ops += QueueOp(shard, PendingOp(PendingOp::kDelete, hash));
+    atomic_xadd64(&gauge_, -static_cast<int64_t>(entry.size));
+    trash.push_back(cache_dir_ + "/" + hash.MakePathWithoutSuffix());
+    LogCvmfs(kLogQuota, kLogDebug, "lru cleanup %s, new gauge %" PRIu64,
+             hash.ToString().c_str(), GetSize());
+  }
+
+  if (num_pending_ops > 0)
+    WakeUp('F');
+
+  // Unlinking happens outside the shard locks.  A file that gets re-inserted
+  // in the meantime is lost, which is a cache miss but not an error.
+  for (unsigned i = 0, iEnd = trash.size(); i < iEnd; ++i) {
+    LogCvmfs(kLogQuota, kLogDebug, "unlink %s", trash[i].c_str());
+    unlink(trash[i].c_str());
+  }
+
+  if (GetSize() > leave_size) {
+    LogCvmfs(kLogQuota, kLogDebug | kLogSyslogWarn,
+             "request to clean until %" PRIu64 ", "
+             "but effective gauge is %" PRIu64, leave_size, GetSize());
+    return false;
+  }
+  return true;
+}
+
+
+void ShardedQuotaManager::DoInsert(
+  const shash::Any &hash,
+  const uint64_t size,
+  const string &description,
+  const FileTypes type,
+  const bool pinned,
+  const bool is_volatile)
+{
+  LogCvmfs(kLogQuota, kLogDebug, "insert into lru %s, path %s",
+           hash.ToString().c_str(), description.c_str());
+  Shard *shard = GetShard(hash);
+  int64_t delta;
+  bool flush_due;
+  {
+    MutexLockGuard guard(&shard->lock);
+    Entry entry;
+    delta = shard->entries.Lookup(hash, &entry)
+            ? static_cast<int64_t>(size) - static_cast<int64_t>(entry.size)
+            : static_cast<int64_t>(size);
+    entry.size = size;
+    entry.seq = NextSeq(shard) | (is_volatile ? kVolatileFlag : 0);
+    entry.type = type;
+    entry.pinned = pinned;
+    entry.dirty = true;
+    PendingOp op(PendingOp::kUpsert, hash);
+    op.description = description;
+    flush_due = QueueOp(shard, op);
+    shard->entries.Insert(hash, entry);
+  }
+  const uint64_t gauge = atomic_xadd64(&gauge_, delta) + delta;
+
+  if (flush_due)
+    WakeUp('F');
+  if ((gauge > limit_) && !RequestCleanup()) {
+    LogCvmfs(kLogQuota, kLogDebug | kLogSyslogWarn,
+             "cache over limit after insert of %s", hash.ToString().c_str());
+  }
+}
+
+
+vector<string> ShardedQuotaManager::DoList(const string &condition) {
+  vector<string> result;
+  Flush();
+
+  MutexLockGuard guard(&lock_db_);
+  sqlite3_stmt *stmt;
+  const string sql = "SELECT path FROM cache_catalog WHERE " + condition + ";";
+  int retval = sqlite3_prepare_v2(database_, sql.c_str(), -1, &stmt, NULL);
+  assert(retval == SQLITE_OK);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    string path = "(NULL)";
+    if (sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+      path = string(reinterpret_cast<const char *>(
+        sqlite3_column_text(stmt, 0)));
+    }
+    result.push_back(path);
+  }
+  sqlite3_finalize(stmt);
+  return result;
+}
+
+
+void ShardedQuotaManager::Flush() {
+  MutexLockGuard guard_db(&lock_db_);
+
+  // Collect the current state of the modified entries shard by shard
+  vector<DbRecord> records;
+  int32_t num_ops = 0;
+  for (unsigned i = 0; i < kNumShards; ++i) {
+    vector<PendingOp> ops;
+    MutexLockGuard guard_shard(&shards_[i].lock);
+    ops.swap(shards_[i].ops);
+    num_ops += ops.size();
+    for (unsigned j = 0; j < ops.size(); ++j) {
+      DbRecord record;
+      if (ops[j].kind != PendingOp::kDelete) {
+        // Missing entries have been removed, with a delete op further down
+        if (!shards_[i].entries.Lookup(ops[j].hash, &record.entry))
+          continue;
+        // Already written by an earlier op of this batch
+        if ((ops[j].kind == PendingOp::kUpdate) && !record.entry.dirty)
+          continue;
+        record.entry.dirty = false;
+        shards_[i].entries.Insert(ops[j].hash, record.entry);
+      }
+      record.op = ops[j];
+      records.push_back(record);
+    }
+  }
+  atomic_xadd32(&num_pending_ops_, -num_ops);
+  if (records.empty())
+    return;
+
+  int retval = sqlite3_exec(database_, "BEGIN", NULL, NULL, NULL);
+  assert(retval == SQLITE_OK);
+  for (unsigned i = 0; i < records.size(); ++i) {
+    const string hash_str = records[i].op.hash.ToString();
+    const Entry &entry = records[i].entry;
+    sqlite3_stmt *stmt = NULL;
+    switch (records[i].op.kind) {
+      case PendingOp::kUpsert:
+        stmt = stmt_upsert_;
+        sqlite3_bind_text(stmt, 1, &hash_str[0], hash_str.length(),
+                          SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, entry.size);
+        sqlite3_bind_int64(stmt, 3, entry.seq);
+        sqlite3_bind_text(stmt, 4, records[i].op.description.data(),
+                          records[i].op.description.length(), SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 5, entry.type);
+        sqlite3_bind_int64(stmt, 6, entry.pinned ? 1 : 0);
+        break;
+      case PendingOp::kUpdate:
+        stmt = stmt_update_;
+        sqlite3_bind_int64(stmt, 1, entry.seq);
+        sqlite3_bind_int64(stmt, 2, entry.pinned ? 1 : 0);
+        sqlite3_bind_text(stmt, 3, &hash_str[0], hash_str.length(),
+                          SQLITE_STATIC);
+        break;
+      case PendingOp::kDelete:
+        stmt = stmt_rm_;
+        sqlite3_bind_text(stmt, 1, &hash_str[0], hash_str.length(),
+                          SQLITE_STATIC);
+        break;
+      default:
+        PANIC(NULL);
+    }
+    retval = sqlite3_step(stmt);
+    if ((retval != SQLITE_DONE) && (retval != SQLITE_OK)) {
+      LogCvmfs(kLogQuota, kLogDebug | kLogSyslogErr,
+               "failed to update %s in cachedb, error %d",
+               hash_str.c_str(), retval);
+    }
+    sqlite3_reset(stmt);
+  }
+  retval = sqlite3_exec(database_, "COMMIT", NULL, NULL, NULL);
+  if (retval != SQLITE_OK) {
+    PANIC(kLogSyslogErr, "failed to commit to cachedb, error %d", retval);
+  }
+  LogCvmfs(kLogQuota, kLogDebug, "flushed %lu changes to cachedb",
+           records.size());
+}
+
+
+uint64_t ShardedQuotaManager::GetCapacity() {
+  if (limit_ != (uint64_t)(-1))
+    return limit_;
+
+  // Unrestricted cache, look at free space on cache dir fs
+  struct statfs info;
+  if (statfs(".", &info) == 0) {
+    return info.f_bavail * info.f_bsize;
+  } else {
+    LogCvmfs(kLogQuota, kLogSyslogErr | kLogDebug,
+             "failed to query file system info of cache (%d)", errno);
+    return limit_;
+  }
+}
+
+
+uint64_t ShardedQuotaManager::GetCleanupRate(uint64_t period_s) {
+  MutexLockGuard guard(&lock_cleanup_);
+  return cleanup_recorder_.GetNoTicks(period_s);
+}
+
+
+/**
+ * Since we only cleanup until cleanup_threshold, we can only add
+ * files smaller than limit-cleanup_threshold.
+ */
+uint64_t ShardedQuotaManager::GetMaxFileSize() {
+  return limit_ - cleanup_threshold_;
+}
+
+
+uint64_t ShardedQuotaManager::GetSize() {
+  return atomic_read64(&gauge_);
+}
+
+
+uint64_t ShardedQuotaManager::GetSizePinned() {
+  MutexLockGuard guard(&lock_pinned_);
+  return pinned_;
+}
+
+
+uint32_t ShardedQuotaManager::HashAny(const shash::Any &key) {
+  return *(reinterpret_cast<const uint32_t *>(key.digest) + 1);
+}
+
+
+/**
+ * Opens the cache database, which uses the same schema as the one of the
+ * PosixQuotaManager, and loads it into memory.
+ */
+bool ShardedQuotaManager::InitDatabase(const bool rebuild_database) {
+  string sql;
+  sqlite3_stmt *stmt;
+  int64_t num_rows = -1;
+  bool clean_shutdown = false;
+
+  fd_lock_cachedb_ = LockFile(workspace_dir_ + "/lock_cachedb");
+  if (fd_lock_cachedb_ < 0) {
+    LogCvmfs(kLogQuota, kLogDebug, "failed to create cachedb lock");
+    return false;
+  }
+
+  bool retry = false;
+  const string db_file = cache_dir_ + "/cachedb";
+  if (rebuild_database) {
+    LogCvmfs(kLogQuota, kLogDebug, "rebuild database, unlinking existing (%s)",
+             db_file.c_str());
+    unlink(db_file.c_str());
+    unlink((db_file + "-journal").c_str());
+  }
+
+ init_recover:
+  int err = sqlite3_open(db_file.c_str(), &database_);
+  if (err != SQLITE_OK) {
+    LogCvmfs(kLogQuota, kLogDebug, "could not open cache database (%d)", err);
+    goto init_database_fail;
+  }
+  sql = "PRAGMA synchronous=0; PRAGMA locking_mode=EXCLUSIVE; "
+    "PRAGMA auto_vacuum=1; "
+    "CREATE TABLE IF NOT EXISTS cache_catalog (sha1 TEXT, size INTEGER, "
+    "  acseq INTEGER, path TEXT, type INTEGER, pinned INTEGER, "
+    "CONSTRAINT pk_cache_catalog PRIMARY KEY (sha1)); "
+    "CREATE UNIQUE INDEX IF NOT EXISTS idx_cache_catalog_acseq "
+    "  ON cache_catalog (acseq); "
+    "CREATE TABLE IF NOT EXISTS properties (key TEXT, value TEXT, "
+    "  CONSTRAINT pk_properties PRIMARY KEY(key));";
+  err = sqlite3_exec(database_, sql.c_str(), NULL, NULL, NULL);
+  if (err != SQLITE_OK) {
+    if (!retry) {
+      retry = true;
+      sqlite3_close(database_);
+      unlink(db_file.c_str());
+      unlink((db_file + "-journal").c_str());
+      LogCvmfs(kLogQuota, kLogSyslogWarn,
+               "LRU database corrupted, re-building");
+      goto init_recover;
+    }
+    LogCvmfs(kLogQuota, kLogDebug, "could not init cache database (failed: %s)",
+             sql.c_str());
+    goto init_database_fail;
+  }
+
+  // Pins are not persistent; same schema version as the PosixQuotaManager
+  sql = "UPDATE cache_catalog SET pinned=0; "
+        "INSERT OR REPLACE INTO properties (key, value) "
+        "VALUES ('schema', '1.0');";
+  err = sqlite3_exec(database_, sql.c_str(), NULL, NULL, NULL);
+  if (err != SQLITE_OK) {
+    LogCvmfs(kLogQuota, kLogDebug, "could not init cache database (failed: %s)",
+             sql.c_str());
+    goto init_database_fail;
+  }
+
+  sqlite3_prepare_v2(database_,
+                     "INSERT OR REPLACE INTO cache_catalog "
+                     "(sha1, size, acseq, path, type, pinned) "
+                     "VALUES (:sha1, :s, :seq, :p, :t, :pin);",
+                     -1, &stmt_upsert_, NULL);
+  sqlite3_prepare_v2(database_,
+                     "UPDATE cache_catalog SET acseq=:seq, pinned=:pin "
+                     "WHERE sha1=:sha1;", -1, &stmt_update_, NULL);
+  sqlite3_prepare_v2(database_, "DELETE FROM cache_catalog WHERE sha1=:sha1;",
+                     -1, &stmt_rm_, NULL);
+
+  // If cache catalog is empty, recreate from file system
+  sqlite3_prepare_v2(database_, "SELECT count(*) FROM cache_catalog;", -1,
+                     &stmt, NULL);
+  if (sqlite3_step(stmt) == SQLITE_ROW)
+    num_rows = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+  if (num_rows < 0) {
+    LogCvmfs(kLogQuota, kLogDebug, "could not select on cache catalog");
+    goto init_database_fail;
+  }
+  // Without a clean shutdown, recent changes might be missing
+  sqlite3_prepare_v2(database_,
+                     "SELECT value FROM properties WHERE key='clean_shutdown';",
+                     -1, &stmt, NULL);
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    clean_shutdown = string(reinterpret_cast<const char *>(
+      sqlite3_column_text(stmt, 0))) == "1";
+  }
+  sqlite3_finalize(stmt);
+
+  if ((num_rows == 0) || rebuild_database) {
+    if (!RebuildDatabase()) {
+      LogCvmfs(kLogQuota, kLogDebug,
+               "could not build cache database from file system");
+      goto init_database_fail;
+    }
+  } else {
+    if (!LoadDatabase())
+      goto init_database_fail;
+    if (!clean_shutdown && !ReconcileDatabase())
+      goto init_database_fail;
+  }
+  if (!SetCleanShutdown(false))
+    goto init_database_fail;
+  return true;
+
+ init_database_fail:
+  CloseDatabase();
+  return false;
+}
+
+
+void ShardedQuotaManager::Insert(
+  const shash::Any &any_hash,
+  const uint64_t size,
+  const string &description)
+{
+  DoInsert(any_hash, size, description, kFileRegular, false, false);
+}
+
+
+void ShardedQuotaManager::InsertVolatile(
+  const shash::Any &any_hash,
+  const uint64_t size,
+  const string &description)
+{
+  DoInsert(any_hash, size, description, kFileRegular, false, true);
+}
+
+
+vector<string> ShardedQuotaManager::List() {
+  return DoList("type=" + StringifyInt(kFileRegular));
+}
+
+
+vector<string> ShardedQuotaManager::ListCatalogs() {
+  return DoList("type=" + StringifyInt(kFileCatalog));
+}
+
+
+vector<string> ShardedQuotaManager::ListPinned() {
+  return DoList("pinned<>0");
+}
+
+
+vector<string> ShardedQuotaManager::ListVolatile() {
+  return DoList("acseq < 0");
+}
+
+
+bool ShardedQuotaManager::LoadDatabase() {
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(database_,
+                     "SELECT sha1, size, acseq, type FROM cache_catalog;",
+                     -1, &stmt, NULL);
+  uint64_t max_seq = 0;
+  int retval;
+  while ((retval = sqlite3_step(stmt)) == SQLITE_ROW) {
+    const shash::Any hash = shash::MkFromHexPtr(shash::HexPtr(string(
+      reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)))));
+    Entry entry;
+    entry.size = sqlite3_column_int64(stmt, 1);
+    entry.seq = sqlite3_column_int64(stmt, 2);
+    entry.type = sqlite3_column_int64(stmt, 3);
+    GetShard(hash)->entries.Insert(hash, entry);
+    atomic_xadd64(&gauge_, entry.size);
+    max_seq = std::max(max_seq, entry.seq & ~kVolatileFlag);
+  }
+  sqlite3_finalize(stmt);
+  if (retval != SQLITE_DONE) {
+    LogCvmfs(kLogQuota, kLogDebug, "could not load cache database (%d)",
+             retval);
+    return false;
+  }
+  // New sequence numbers have to be larger than the loaded ones
+  atomic_write64(&seq_, (max_seq >> kShardBits) + 1);
+  LogCvmfs(kLogQuota, kLogDebug,
+           "loaded cache database, sequence %" PRIu64 ", gauge %" PRIu64,
+           max_seq + 1, GetSize());
+  return true;
+}
+
+
+/**
+ * Ticks the clock of the shard and returns the new sequence number, which has
+ * the shard index in the lower bits.  The shared clock seq_ is only read with a
+ * plain load, it is written once every kSeqSyncInterval ticks.  Needs to be
+ * called with the shard lock held.
+ */
+uint64_t ShardedQuotaManager::NextSeq(Shard *shard) {
+  const uint64_t clock = __atomic_load_n(&seq_, __ATOMIC_RELAXED);
+  shard->clock = std::max(shard->clock + 1, clock);
+  if (shard->clock >= shard->clock_published + kSeqSyncInterval) {
+    int64_t published = __atomic_load_n(&seq_, __ATOMIC_RELAXED);
+    while ((published < static_cast<int64_t>(shard->clock)) &&
+           !atomic_cas64(&seq_, published, shard->clock))
+    {
+      published = __atomic_load_n(&seq_, __ATOMIC_RELAXED);
+    }
+    shard->clock_published = shard->clock;
+  }
+  return (shard->clock << kShardBits) | shard->index;
+}
+
+
+/**
+ * Immediately inserts a new pinned catalog.
+ *
+ * \return True on success, false otherwise
+ */
+bool ShardedQuotaManager::Pin(
+  const shash::Any &hash,
+  const uint64_t size,
+  const string &description,
+  const bool is_catalog)
+{
+  assert((size > 0) || !is_catalog);
+
+  bool new_pin = false;
+  {
+    MutexLockGuard guard(&lock_pinned_);
+    if (pinned_chunks_.find(hash) == pinned_chunks_.end()) {
+      if (pinned_ + size > cleanup_threshold_) {
+        LogCvmfs(kLogQuota, kLogDebug, "failed to insert %s (pinned), no space",
+                 hash.ToString().c_str());
+        return false;
+      }
+      pinned_chunks_[hash] = size;
+      pinned_ += size;
+      new_pin = true;
+    }
+  }
+  if (new_pin)
+    CheckHighPinWatermark();
+
+  DoInsert(hash, size, description, is_catalog ? kFileCatalog : kFileRegular,
+           true, false);
+  return true;
+}
+
+
+bool ShardedQuotaManager::QueueOp(Shard *shard, const PendingOp &op) {
+  shard->ops.push_back(op);
+  return (atomic_xadd32(&num_pending_ops_, 1) + 1) ==
+         static_cast<int32_t>(kMaxPendingOps);
+}
+
+
+bool ShardedQuotaManager::RebuildDatabase() {
+  LogCvmfs(kLogQuota, kLogSyslog | kLogDebug, "re-building cache database");
+  int retval = sqlite3_exec(database_, "DELETE FROM cache_catalog;",
+                            NULL, NULL, NULL);
+  if (retval != SQLITE_OK) {
+    LogCvmfs(kLogQuota, kLogDebug, "could not clear cache database");
+    return false;
+  }
+
+  // Insert files from cache sub-directories 00 - ff, ordered by access time
+  FileList files;
+  if (!ScanCacheDir(&files))
+    return false;
+
+  for (unsigned i = 0; i < files.size(); ++i) {
+    const shash::Any hash =
+      shash::MkFromHexPtr(shash::HexPtr(files[i].second.first));
+    Shard *shard = GetShard(hash);
+    Entry entry;
+    entry.size = files[i].second.second;
+    entry.seq = (static_cast<uint64_t>(i) << kShardBits) | shard->index;
+    // Might also be a catalog (information is lost)
+    entry.type = kFileRegular;
+    entry.dirty = true;
+    PendingOp op(PendingOp::kUpsert, hash);
+    op.description = "unknown (automatic rebuild)";
+    QueueOp(shard, op);
+    shard->entries.Insert(hash, entry);
+    atomic_xadd64(&gauge_, entry.size);
+  }
+  atomic_write64(&seq_, files.size());
+  Flush();
+
+  LogCvmfs(kLogQuota, kLogDebug,
+           "rebuilding finished, sequence %" PRIu64 ", gauge %" PRIu64,
+           atomic_read64(&seq_), GetSize());
+  return true;
+}
+
+
+/**
+ * Brings the loaded database in line with the cache directory after the
+ * process did not shut down cleanly.  Files that are not in the database are
+ * added as the most recently used entries, in the order of their access time.
+ * Entries whose file is gone are removed.
+ */
+bool ShardedQuotaManager::ReconcileDatabase() {
+  LogCvmfs(kLogQuota, kLogSyslog | kLogDebug,
+           "cache database was not closed properly, reconciling with %s",
+           cache_dir_.c_str());
+  FileList files;
+  if (!ScanCacheDir(&files))
+    return false;
+
+  vector<shash::Any> on_disk;
+  on_disk.reserve(files.size());
+  unsigned num_added = 0;
+  for (unsigned i = 0; i < files.size(); ++i) {
+    const shash::Any hash =
+      shash::MkFromHexPtr(shash::HexPtr(files[i].second.first));
+    on_disk.push_back(hash);
+    Shard *shard = GetShard(hash);
+    if (shard->entries.Contains(hash))
+      continue;
+    Entry entry;
+    entry.size = files[i].second.second;
+    entry.seq = NextSeq(shard);
+    entry.type = kFileRegular;
+    entry.dirty = true;
+    PendingOp op(PendingOp::kUpsert, hash);
+    op.description = "unknown (automatic reconcile)";
+    QueueOp(shard, op);
+    shard->entries.Insert(hash, entry);
+    atomic_xadd64(&gauge_, entry.size);
+    num_added++;
+  }
+  sort(on_disk.begin(), on_disk.end());
+
+  unsigned num_removed = 0;
+  for (unsigned i = 0; i < kNumShards; ++i) {
+    vector<shash::Any> missing;
+    const shash::Any empty_key = shards_[i].entries.empty_key();
+    const shash::Any *keys = shards_[i].entries.keys();
+    for (uint32_t j = 0; j < shards_[i].entries.capacity(); ++j) {
+      if ((keys[j] != empty_key) &&
+          !binary_search(on_disk.begin(), on_disk.end(), keys[j]))
+      {
+        missing.push_back(keys[j]);
+      }
+    }
+    for (unsigned j = 0; j < missing.size(); ++j) {
+      Entry entry;
+      shards_[i].entries.Lookup(missing[j], &entry);
+      shards_[i].entries.Erase(missing[j]);
+      QueueOp(&shards_[i], PendingOp(PendingOp::kDelete, missing[j]));
+      atomic_xadd64(&gauge_, -static_cast<int64_t>(entry.size));
+    }
+    num_removed += missing.size();
+  }
+  Flush();
+
+  LogCvmfs(kLogQuota, kLogDebug,
+           "reconciling finished, %u files added, %u entries removed, "
+           "gauge %" PRIu64, num_added, num_removed, GetSize());
+  return true;
+}
+
+
+/**
+ * Register a channel that allows the cache manager to trigger action to its
+ * clients.  Currently used for releasing pinned catalogs.
+ */
+void ShardedQuotaManager::RegisterBackChannel(
+  int back_channel[2],
+  const string &channel_id)
+{
+  shash::Md5 hash = shash::Md5(shash::AsciiPtr(channel_id));
+  MakePipe(back_channel);
+  Block2Nonblock(back_channel[1]);  // back channels are opportunistic
+
+  LockBackChannels();
+  map<shash::Md5, int>::const_iterator iter = back_channels_.find(hash);
+  if (iter != back_channels_.end()) {
+    LogCvmfs(kLogQuota, kLogDebug | kLogSyslogWarn,
+             "closing left-over back channel %s", hash.ToString().c_str());
+    close(iter->second);
+  }
+  back_channels_[hash] = back_channel[1];
+  UnlockBackChannels();
+  LogCvmfs(kLogQuota, kLogDebug, "register back channel %s on fd %d",
+           hash.ToString().c_str(), back_channel[1]);
+}
+
+
+/**
+ * Removes a chunk from cache, if it exists.
+ */
+void ShardedQuotaManager::Remove(const shash::Any &hash) {
+  LogCvmfs(kLogQuota, kLogDebug, "manually removing %s",
+           hash.ToString().c_str());
+  Shard *shard = GetShard(hash);
+  Entry entry;
+  bool found;
+  bool flush_due = false;
+  {
+    MutexLockGuard guard(&shard->lock);
+    found = shard->entries.Lookup(hash, &entry);
+    if (found) {
+      shard->entries.Erase(hash);
+      flush_due = QueueOp(shard, PendingOp(PendingOp::kDelete, hash));
+    }
+  }
+  if (found) {
+    atomic_xadd64(&gauge_, -static_cast<int64_t>(entry.size));
+    if (entry.pinned) {
+      MutexLockGuard guard(&lock_pinned_);
+      map<shash::Any, uint64_t>::iterator iter = pinned_chunks_.find(hash);
+      if (iter != pinned_chunks_.end()) {
+        pinned_ -= iter->second;
+        pinned_chunks_.erase(iter);
+      }
+    }
+  }
+  if (flush_due)
+    WakeUp('F');
+
+  unlink((cache_dir_ + "/" + hash.MakePathWithoutSuffix()).c_str());
+}
+
+
+/**
+ * Asks the background thread to clean up the cache.  Before the thread is
+ * spawned, the cleanup runs synchronously.
+ *
+ * \return False if the synchronous cleanup could not free enough space
+ */
+bool ShardedQuotaManager::RequestCleanup() {
+  if (!spawned_) {
+    LogCvmfs(kLogQuota, kLogDebug, "over limit, gauge %" PRIu64, GetSize());
+    return DoCleanup(cleanup_threshold_);
+  }
+  if (atomic_cas32(&cleanup_requested_, 0, 1))
+    WakeUp('C');
+  return true;
+}
+
+
+/**
+ * Collects the regular files in the cache sub-directories 00 - ff, sorted by
+ * access time.  Empty files are removed on the way.
+ */
+bool ShardedQuotaManager::ScanCacheDir(FileList *files) {
+  char hex[4];
+  for (int i = 0; i <= 0xff; i++) {
+    snprintf(hex, sizeof(hex), "%02x", i);
+    const string path = cache_dir_ + "/" + string(hex);
+    DIR *dirp = opendir(path.c_str());
+    if (dirp == NULL) {
+      LogCvmfs(kLogQuota, kLogDebug | kLogSyslogErr,
+               "failed to open directory %s (tmpwatch interfering?)",
+               path.c_str());
+      return false;
+    }
+    platform_dirent64 *d;
+    while ((d = platform_readdir(dirp)) != NULL) {
+      const string file_path = path + "/" + string(d->d_name);
+      platform_stat64 info;
+      if (platform_stat(file_path.c_str(), &info) != 0) {
+        LogCvmfs(kLogQuota, kLogDebug, "could not stat %s", file_path.c_str());
+        continue;
+      }
+      if (!S_ISREG(info.st_mode))
+        continue;
+      if (info.st_size == 0) {
+        LogCvmfs(kLogQuota, kLogSyslog | kLogDebug,
+                 "removing empty file %s from cache directory",
+                 file_path.c_str());
+        unlink(file_path.c_str());
+        continue;
+      }
+      files->push_back(make_pair(info.st_atime, make_pair(
+        string(hex) + string(d->d_name), static_cast<uint64_t>(info.st_size))));
+    }
+    closedir(dirp);
+  }
+  sort(files->begin(), files->end());
+  return true;
+}
+
+
+/**
+ * Records in the database whether the cache manager was shut down cleanly,
+ * i.e. whether all changes made it into the database.
+ */
+bool ShardedQuotaManager::SetCleanShutdown(const bool clean) {
+  const string sql = string("INSERT OR REPLACE INTO properties (key, value) "
+                            "VALUES ('clean_shutdown', '") +
+                     (clean ? "1" : "0") + "');";
+  int retval = sqlite3_exec(database_, sql.c_str(), NULL, NULL, NULL);
+  if (retval != SQLITE_OK) {
+    LogCvmfs(kLogQuota, kLogDebug | kLogSyslogErr,
+             "failed to update cache database properties (%d)", retval);
+    return false;
+  }
+  return true;
+}
+
+
+ShardedQuotaManager::ShardedQuotaManager(
+  const uint64_t limit,
+  const uint64_t cleanup_threshold,
+  const string &cache_workspace)
+  : limit_(limit)
+  , cleanup_threshold_(cleanup_threshold)
+  , cache_dir_()  // initialized in body
+  , workspace_dir_()  // initialized in body
+  , shards_(new Shard[kNumShards])
+  , pinned_(0)
+  , database_(NULL)
+  , stmt_upsert_(NULL)
+  , stmt_update_(NULL)
+  , stmt_rm_(NULL)
+  , fd_lock_cachedb_(-1)
+  , spawned_(false)
+{
+  atomic_init64(&gauge_);
+  atomic_init64(&seq_);
+  atomic_init32(&num_pending_ops_);
+  atomic_init32(&cleanup_requested_);
+  for (unsigned i = 0; i < kNumShards; ++i)
+    shards_[i].index = i;
+
+  vector<string> dir_tokens(SplitString(cache_workspace, ':'));
+  assert((dir_tokens.size() == 1) || (dir_tokens.size() == 2));
+  cache_dir_ = workspace_dir_ = dir_tokens[0];
+  if (dir_tokens.size() == 2)
+    workspace_dir_ = dir_tokens[1];
+
+  int retval = pthread_mutex_init(&lock_pinned_, NULL);
+  assert(retval == 0);
+  retval = pthread_mutex_init(&lock_cleanup_, NULL);
+  assert(retval == 0);
+  retval = pthread_mutex_init(&lock_db_, NULL);
+  assert(retval == 0);
+  pipe_background_[0] = pipe_background_[1] = -1;
+
+  cleanup_recorder_.AddRecorder(1, 90);  // last 1.5 min with second resolution
+  // last 1.5 h with minute resolution
+  cleanup_recorder_.AddRecorder(60, 90*60);
+  // last 18 hours with 20 min resolution
+  cleanup_recorder_.AddRecorder(20*60, 60*60*18);
+  // last 4 days with hour resolution
+  cleanup_recorder_.AddRecorder(60*60, 60*60*24*4);
+}
+
+
+ShardedQuotaManager::~ShardedQuotaManager() {
+  if (spawned_) {
+    WakeUp('T');
+    pthread_join(thread_background_, NULL);
+  }
+  if (pipe_background_[0] >= 0)
+    ClosePipe(pipe_background_);
+
+  if (database_ != NULL) {
+    // Pinned files (loaded catalogs) become the most recently used entries.
+    // Move all shard clocks past the current maximum to make this strict.
+    uint64_t max_clock = 0;
+    for (unsigned i = 0; i < kNumShards; ++i)
+      max_clock = std::max(max_clock, shards_[i].clock);
+    atomic_write64(&seq_, max_clock + 1);
+    for (map<shash::Any, uint64_t>::const_iterator i = pinned_chunks_.begin(),
+         iEnd = pinned_chunks_.end(); i != iEnd; ++i)
+    {
+      Shard *shard = GetShard(i->first);
+      Entry entry;
+      if (!shard->entries.Lookup(i->first, &entry))
+        continue;
+      entry.seq = NextSeq(shard) | (entry.seq & kVolatileFlag);
+      if (!entry.dirty) {
+        entry.dirty = true;
+        QueueOp(shard, PendingOp(PendingOp::kUpdate, i->first));
+      }
+      shard->entries.Insert(i->first, entry);
+    }
+    Flush();
+    SetCleanShutdown(true);
+    CloseDatabase();
+  }
+
+  delete[] shards_;
+  pthread_mutex_destroy(&lock_pinned_);
+  pthread_mutex_destroy(&lock_cleanup_);
+  pthread_mutex_destroy(&lock_db_);
+}
+
+
+void *ShardedQuotaManager::MainBackground(void *data) {
+  ShardedQuotaManager *quota_mgr = static_cast<ShardedQuotaManager *>(data);
+  LogCvmfs(kLogQuota, kLogDebug, "starting sharded quota manager thread");
+
+  struct pollfd watch_ctrl;
+  watch_ctrl.fd = quota_mgr->pipe_background_[0];
+  watch_ctrl.events = POLLIN | POLLPRI;
+  while (true) {
+    watch_ctrl.revents = 0;
+    int retval = poll(&watch_ctrl, 1, kFlushIntervalMs);
+    if (retval < 0) {
+      if (errno == EINTR)
+        continue;
+      PANIC(kLogSyslogErr | kLogDebug,
+            "sharded quota manager thread failed to poll (%d)", errno);
+    }
+    if (watch_ctrl.revents) {
+      char command;
+      ReadPipe(quota_mgr->pipe_background_[0], &command, 1);
+      if (command == 'T')
+        break;
+      if (command == 'C') {
+        atomic_write32(&quota_mgr->cleanup_requested_, 0);
+        if (quota_mgr->GetSize() > quota_mgr->limit_)
+          quota_mgr->DoCleanup(quota_mgr->cleanup_threshold_);
+      }
+    }
+    quota_mgr->Flush();
+  }
+
+  LogCvmfs(kLogQuota, kLogDebug, "stopping sharded quota manager thread");
+  return NULL;
+}
+
+
+void ShardedQuotaManager::Spawn() {
+  if (spawned_)
+    return;
+
+  if (pthread_create(&thread_background_, NULL, MainBackground,
+      static_cast<void *>(this)) != 0)
+  {
+    PANIC(kLogDebug, "could not create sharded quota manager thread");
+  }
+
+  spawned_ = true;
+}
+
+
+/**
+ * Updates the position of the file specified by the hash in the LRU.
+ */
+void ShardedQuotaManager::Touch(const shash::Any &hash) {
+  Shard *shard = GetShard(hash);
+  bool flush_due = false;
+  {
+    MutexLockGuard guard(&shard->lock);
+    Entry entry;
+    if (!shard->entries.Lookup(hash, &entry))
+      return;
+
+    // In a large cache, an entry that was among the last few accessed entries
+    // is practically at the head of the LRU already.  Spare the database
+    // update.
+    if ((shard->entries.size() * kNumShards >= kTouchCoalesceMinEntries) &&
+        (((entry.seq & ~kVolatileFlag) >> kShardBits) + kTouchCoalesceWindow >=
+         shard->clock))
+    {
+      return;
+    }
+
+    entry.seq = NextSeq(shard) | (entry.seq & kVolatileFlag);
+    if (!entry.dirty) {
+      entry.dirty = true;
+      flush_due = QueueOp(shard, PendingOp(PendingOp::kUpdate, hash));
+    }
+    shard->entries.Insert(hash, entry);
+  }
+  if (flush_due)
+    WakeUp('F');
+}
+
+
+void ShardedQuotaManager::UnregisterBackChannel(
+  int back_channel[2],
+  const string &channel_id)
+{
+  shash::Md5 hash = shash::Md5(shash::AsciiPtr(channel_id));
+
+  LockBackChannels();
+  map<shash::Md5, int>::iterator iter = back_channels_.find(hash);
+  if (iter != back_channels_.end()) {
+    LogCvmfs(kLogQuota, kLogDebug,
+             "closing back channel %s", hash.ToString().c_str());
+    close(iter->second);
+    back_channels_.erase(iter);
+  } else {
+    LogCvmfs(kLogQuota, kLogDebug | kLogSyslogWarn,
+             "did not find back channel %s", hash.ToString().c_str());
+  }
+  UnlockBackChannels();
+
+  close(back_channel[0]);
+}
+
+
+void ShardedQuotaManager::Unpin(const shash::Any &hash) {
+  LogCvmfs(kLogQuota, kLogDebug, "Unpin %s", hash.ToString().c_str());
+
+  bool was_pinned = false;
+  {
+    MutexLockGuard guard(&lock_pinned_);
+    map<shash::Any, uint64_t>::iterator iter = pinned_chunks_.find(hash);
+    if (iter != pinned_chunks_.end()) {
+      pinned_ -= iter->second;
+      pinned_chunks_.erase(iter);
+      was_pinned = true;
+    }
+  }
+  if (!was_pinned)
+    LogCvmfs(kLogQuota, kLogDebug, "this chunk was not pinned");
+
+  Shard *shard = GetShard(hash);
+  bool flush_due = false;
+  {
+    MutexLockGuard guard(&shard->lock);
+    Entry entry;
+    if (shard->entries.Lookup(hash, &entry) && entry.pinned) {
+      entry.pinned = false;
+      if (!entry.dirty) {
+        entry.dirty = true;
+        flush_due = QueueOp(shard, PendingOp(PendingOp::kUpdate, hash));
+      }
+      shard->entries.Insert(hash, entry);
+    }
+  }
+  if (flush_due)
+    WakeUp('F');
+
+  // It can happen that files get pinned that were removed from the cache
+  // (see cache.cc).  We fix this at this point.
+  if (was_pinned &&
+      !FileExists(cache_dir_ + "/" + hash.MakePathWithoutSuffix()))
+  {
+    LogCvmfs(kLogQuota, kLogDebug,
+             "remove orphaned pinned hash %s from cache database",
+             hash.ToString().c_str());
+    Remove(hash);
+  }
+}
+
+
+/**
+ * Triggers the background thread.  Before it is spawned, flushes are done
+ * synchronously and cleanup requests are not sent through the pipe.
+ */
+void ShardedQuotaManager::WakeUp(const char command) {
+  if (!spawned_) {
+    if (command == 'F')
+      Flush();
+    return;
+  }
+  WritePipe(pipe_background_[1], &command, 1);
+}
@@ -0,0 +1,331 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_QUOTA_SHARDED_H_
+#define CVMFS_QUOTA_SHARDED_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "crypto/hash.h"
+#include "duplex_sqlite3.h"
+#include "gtest/gtest_prod.h"
+#include "quota.h"
+#include "smallhash.h"
+#include "statistics.h"
+#include "util/atomic.h"
+#include "util/single_copy.h"
+
+/**
+ * Alternative to the PosixQuotaManager for exclusive (non-shared) POSIX caches.
+ * Instead of sending every touch and insert through a pipe to a single
+ * thread that applies them one by one to an SQlite database, the LRU is kept in
+ * memory, distributed over a number of shards that are protected by their own
+ * locks.  A touch of an object is a hash table update within its shard.
+ *
+ * The cache database (cachedb) is kept with the same schema as the one of the
+ * PosixQuotaManager, so that a cache can be switched between both backends.
+ * Changes are written in batches by a background thread.  Modified entries are
+ * queued only once per batch, so repeated touches of hot objects coalesce into
+ * a single database update.  If the process crashes, the changes since the last
+ * batch are lost, which only affects the LRU order of the entries in question.
+ * A clean shutdown is recorded in the database.  Without it, the database is
+ * reconciled with the cache directory on the next start: files that did not
+ * make it into the database are added, entries without a file are dropped.
+ *
+ * Every shard draws sequence numbers from its own clock, so that touches in
+ * different shards do not contend on a shared counter.  The shard clocks are
+ * loosely synchronized, which keeps the order across shards close to the LRU.
+ *
+ * The soft limit of the cache is enforced by the background thread, too: an
+ * insert that pushes the cache over the limit wakes the thread, which evicts
+ * entries from a snapshot of the LRU order until cleanup_threshold is reached.
+ * Before Spawn(), cleanup runs synchronously.
+ */
+class ShardedQuotaManager : public QuotaManager {
+  FRIEND_TEST(T_ShardedQuotaManager, Coalesce);
+  FRIEND_TEST(T_ShardedQuotaManager, SeqPerShard);
+  FRIEND_TEST(T_ShardedQuotaManager, Shards);
+
+ public:
+  static ShardedQuotaManager *Create(const std::string &cache_workspace,
+    const uint64_t limit, const uint64_t cleanup_threshold,
+    const bool rebuild_database);
+
+  virtual ~ShardedQuotaManager();
+  virtual bool HasCapability(Capabilities capability) { return true; }
+
+  virtual void Insert(const shash::Any &hash, const uint64_t size,
+                      const std::string &description);
+  virtual void InsertVolatile(const shash::Any &hash, const uint64_t size,
+                              const std::string &description);
+  virtual bool Pin(const shash::Any &hash, const uint64_t size,
+                   const std::string &description, const bool is_catalog);
+  virtual void Unpin(const shash::Any &hash);
+  virtual void Touch(const shash::Any &hash);
+  virtual void Remove(const shash::Any &file);
+  virtual bool Cleanup(const uint64_t leave_size);
+
+  virtual void RegisterBackChannel(int back_channel[2],
+                                   const std::string &channel_id);
+  virtual void UnregisterBackChannel(int back_channel[2],
+                                     const std::string &channel_id);
+
+  virtual std::vector<std::string> List();
+  virtual std::vector<std::string> ListPinned();
+  virtual std::vector<std::string> ListCatalogs();
+  virtual std::vector<std::string> ListVolatile();
+  virtual uint64_t GetMaxFileSize();
+  virtual uint64_t GetCapacity();
+  virtual uint64_t GetSize();
+  virtual uint64_t GetSizePinned();
+  virtual uint64_t GetCleanupRate(uint64_t period_s);
+
+  virtual void Spawn();
+  virtual pid_t GetPid() { return getpid(); }
+  virtual uint32_t GetProtocolRevision() { return kProtocolRevision; }
+
+  /**
+   * Writes the pending changes to the cache database.  Usually called by the
+   * background thread.
+   */
+  void Flush();
+
+ private:
+  /**
+   * Same values as PosixQuotaManager::FileTypes, stored in the cache database
+   */
+  enum FileTypes {
+    kFileRegular = 0,
+    kFileCatalog,
+  };
+
+  /**
+   * Same as in the PosixQuotaManager: volatile entries have the highest bit of
+   * the sequence number set and are preferred during cleanup.
+   */
+  static const uint64_t kVolatileFlag = 1ULL << 63;
+
+  /**
+   * Number of shards of the in-memory LRU.  The shard index occupies the lower
+   * bits of the sequence numbers.
+   */
+  static const unsigned kShardBits = 6;
+  static const unsigned kNumShards = 1 << kShardBits;
+
+  /**
+   * A shard publishes its clock every so many ticks.  Shards that lag behind
+   * the published clock jump ahead on their next tick.
+   */
+  static const uint64_t kSeqSyncInterval = 64;
+
+  /**
+   * Touches of an entry that is among the most recently accessed entries do not
+   * change its position in the LRU.  Counted in ticks of the shard clock, i.e.
+   * roughly kNumShards * kTouchCoalesceWindow entries over all shards.
+   */
+  static const uint64_t kTouchCoalesceWindow = 16;
+  /**
+   * Touches are only coalesced if the LRU is much larger than the window.
+   */
+  static const uint64_t kTouchCoalesceMinEntries = 64 * 1024;
+
+  /**
+   * The background thread writes the pending changes at least every so often.
+   */
+  static const unsigned kFlushIntervalMs = 5000;
+
+  /**
+   * Wake up the background thread early if there are many pending changes.
+   */
+  static const unsigned kMaxPendingOps = 8192;
+
+  /**
+   * Alarm when more than 75% of the cache fraction allowed for pinned files
+   * (50%) is filled with pinned files
+   */
+  static const unsigned kHighPinWatermark = 75;
+
+  struct Entry {
+    Entry() : size(0), seq(0), type(kFileRegular), pinned(false), dirty(false)
+    { }
+    uint64_t size;
+    /**
+     * Position in the LRU, including the volatile flag
+     */
+    uint64_t seq;
+    unsigned char type;
+    bool pinned;
+    /**
+     * There is a pending operation for this entry in the shard's queue
+     */
+    bool dirty;
+  };
+
+  /**
+   * Pending change to the cache database.  Upserts and updates take the
+   * current values of the entry at the time of the flush.
+   */
+  struct PendingOp {
+    enum Kind {
+      kUpsert = 0,
+      kUpdate,
+      kDelete,
+    };
+    PendingOp() : kind(kUpdate) { }
+    PendingOp(Kind k, const shash::Any &h) : kind(k), hash(h) { }
+    Kind kind;
+    shash::Any hash;
+    std::string description;  // only for kUpsert
+  };
+
+  struct Shard {
+    Shard();
+    ~Shard();
+    pthread_mutex_t lock;
+    SmallHashDynamic<shash::Any, Entry> entries;
+    std::vector<PendingOp> ops;
+    unsigned index;
+    /**
+     * Sequence clock of the shard and its last value written to seq_
+     */
+    uint64_t clock;
+    uint64_t clock_published;
+  };
+
+  /**
+   * Element of the LRU snapshot taken by DoCleanup()
+   */
+  struct LruCandidate {
+    LruCandidate(const shash::Any &h, uint64_t s, uint64_t q)
+      : hash(h), size(s), seq(q) { }
+    bool operator <(const LruCandidate &other) const {
+      return static_cast<int64_t>(seq) < static_cast<int64_t>(other.seq);
+    }
+    shash::Any hash;
+    uint64_t size;
+    uint64_t seq;
+  };
+
+  /**
+   * Persisted form of an entry, collected from the shards under their locks
+   * and written to the database afterwards
+   */
+  struct DbRecord {
+    PendingOp op;
+    Entry entry;
+  };
+
+  /**
+   * Regular files found in the cache directory: access time, hash string, size
+   */
+  typedef std::vector<std::pair<time_t, std::pair<std::string, uint64_t> > >
+    FileList;
+
+  ShardedQuotaManager(const uint64_t limit, const uint64_t cleanup_threshold,
+                      const std::string &cache_workspace);
+  static uint32_t HashAny(const shash::Any &key);
+
+  Shard *GetShard(const shash::Any &hash) {
+    return &shards_[hash.digest[hash.GetDigestSize() - 1] % kNumShards];
+  }
+  uint64_t NextSeq(Shard *shard);
+  bool QueueOp(Shard *shard, const PendingOp &op);
+  void DoInsert(const shash::Any &hash, const uint64_t size,
+                const std::string &description, const FileTypes type,
+                const bool pinned, const bool is_volatile);
+  bool DoCleanup(const uint64_t leave_size);
+  bool RequestCleanup();
+  void WakeUp(const char command);
+  void CheckHighPinWatermark();
+
+  bool InitDatabase(const bool rebuild_database);
+  bool LoadDatabase();
+  bool RebuildDatabase();
+  bool ReconcileDatabase();
+  bool ScanCacheDir(FileList *files);
+  bool SetCleanShutdown(const bool clean);
+  void CloseDatabase();
+  std::vector<std::string> DoList(const std::string &condition);
+
+  static void *MainBackground(void *data);
+
+  /**
+   * Soft limit in bytes, start cleanup when reached.
+   */
+  uint64_t limit_;
+
+  /**
+   * Cleanup until cleanup_threshold_ are left in the cache.
+   */
+  uint64_t cleanup_threshold_;
+
+  /**
+   * Current size of cache.
+   */
+  atomic_int64 gauge_;
+
+  /**
+   * Highest published shard clock.  Written only every kSeqSyncInterval ticks
+   * of a shard and read without a locked instruction.
+   */
+  atomic_int64 seq_;
+
+  /**
+   * Number of queued database operations over all shards.
+   */
+  atomic_int32 num_pending_ops_;
+
+  /**
+   * Set while a cleanup request to the background thread is in flight.
+   */
+  atomic_int32 cleanup_requested_;
+
+  std::string cache_dir_;
+  std::string workspace_dir_;
+
+  Shard *shards_;
+
+  /**
+   * Pinned content hashes and their size.  Reservations are made before the
+   * pinned file is inserted, so this is separate from the shards.
+   */
+  std::map<shash::Any, uint64_t> pinned_chunks_;
+  uint64_t pinned_;
+  pthread_mutex_t lock_pinned_;
+
+  /**
+   * Serializes cleanup runs and protects the cleanup_recorder_
+   */
+  pthread_mutex_t lock_cleanup_;
+  perf::MultiRecorder cleanup_recorder_;
+
+  /**
+   * Protects the database connection, which is used by the background thread
+   * and for listings.
+   */
+  pthread_mutex_t lock_db_;
+  sqlite3 *database_;
+  sqlite3_stmt *stmt_upsert_;
+  sqlite3_stmt *stmt_update_;
+  sqlite3_stmt *stmt_rm_;
+  int fd_lock_cachedb_;
+
+  bool spawned_;
+  pthread_t thread_background_;
+  /**
+   * Wakes up the background thread: 'C' for cleanup, 'F' for flush, 'T' for
+   * termination.
+   */
+  int pipe_background_[2];
+};  // class ShardedQuotaManager
+
+#endif  // CVMFS_QUOTA_SHARDED_H_
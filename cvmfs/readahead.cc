@@ -0,0 +1,275 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "readahead.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "fetch.h"
+#include "util/concurrency.h"
+#include "util/logging.h"
+
+using namespace std;  // NOLINT
+
+namespace cvmfs {
+
+const unsigned ChunkReadAhead::kDefaultNumThreads;
+const unsigned ChunkReadAhead::kMaxWindow;
+const unsigned ChunkReadAhead::kMaxNumThreads;
+const unsigned ChunkReadAhead::kMaxQueueLength;
+const unsigned ChunkReadAhead::kMaxInFlight;
+const unsigned ChunkReadAhead::kMaxTracked;
+
+
+ChunkReadAhead::ChunkReadAhead(
+  const unsigned window,
+  const unsigned num_threads,
+  Fetcher *fetcher,
+  Fetcher *external_fetcher,
+  perf::StatisticsTemplate statistics)
+  : window_(std::min(window, kMaxWindow))
+  , num_threads_(std::max(1U, std::min(num_threads, kMaxNumThreads)))
+  , fetcher_(fetcher)
+  , external_fetcher_(external_fetcher)
+  , spawned_(false)
+  , terminate_(false)
+  , num_in_flight_(0)
+  , next_generation_(0)
+{
+  int retval = pthread_mutex_init(&lock_, NULL);
+  assert(retval == 0);
+  retval = pthread_cond_init(&cond_jobs_, NULL);
+  assert(retval == 0);
+
+  n_window_ = statistics.RegisterTemplated("window",
+    "number of chunks fetched ahead of a sequential reader");
+  n_scheduled_ = statistics.RegisterTemplated("n_scheduled",
+    "overall number of chunks queued for read-ahead");
+  n_dropped_ = statistics.RegisterTemplated("n_dropped",
+    "overall number of read-ahead requests dropped due to a full queue");
+  n_fetched_ = statistics.RegisterTemplated("n_fetched",
+    "overall number of chunks successfully fetched ahead");
+  n_failed_ = statistics.RegisterTemplated("n_failed",
+    "overall number of failed read-ahead fetches");
+  n_hit_ = statistics.RegisterTemplated("n_hit",
+    "overall number of sequentially read chunks that were fetched ahead");
+  n_miss_ = statistics.RegisterTemplated("n_miss",
+    "overall number of sequentially read chunks that were not (yet) "
+    "fetched ahead");
+  n_window_->Set(window_);
+}
+
+
+ChunkReadAhead::~ChunkReadAhead() {
+  if (spawned_) {
+    {
+      MutexLockGuard m(&lock_);
+      terminate_ = true;
+      int retval = pthread_cond_broadcast(&cond_jobs_);
+      assert(retval == 0);
+    }
+    for (unsigned i = 0; i < threads_.size(); ++i) {
+      int retval = pthread_join(threads_[i], NULL);
+      assert(retval == 0);
+    }
+    // The fetchers call back into this object
+    MutexLockGuard m(&lock_);
+    while (num_in_flight_ > 0) {
+      int retval = pthread_cond_wait(&cond_jobs_, &lock_);
+      assert(retval == 0);
+    }
+  }
+  pthread_cond_destroy(&cond_jobs_);
+  pthread_mutex_destroy(&lock_);
+}
+
+
+void *ChunkReadAhead::MainWorker(void *data) {
+  ChunkReadAhead *read_ahead = reinterpret_cast<ChunkReadAhead *>(data);
+  LogCvmfs(kLogCvmfs, kLogDebug, "starting read-ahead thread");
+
+  while (true) {
+    Job job;
+    {
+      MutexLockGuard m(&read_ahead->lock_);
+      while ((read_ahead->jobs_.empty() ||
+              (read_ahead->num_in_flight_ >= kMaxInFlight)) &&
+             !read_ahead->terminate_)
+      {
+        int retval = pthread_cond_wait(&read_ahead->cond_jobs_,
+                                       &read_ahead->lock_);
+        assert(retval == 0);
+      }
+      if (read_ahead->terminate_)
+        break;
+      job = read_ahead->jobs_.front();
+      read_ahead->jobs_.pop_front();
+      read_ahead->num_in_flight_++;
+    }
+    read_ahead->ProcessJob(job);
+  }
+
+  LogCvmfs(kLogCvmfs, kLogDebug, "stopping read-ahead thread");
+  return NULL;
+}
+
+
+void ChunkReadAhead::OnChunkOpen(
+  const FileChunkReflist &chunks,
+  const unsigned chunk_idx,
+  const bool is_sequential,
+  const CacheManager::ObjectType object_type)
+{
+  if ((window_ == 0) || (chunks.list == NULL))
+    return;
+  const unsigned num_chunks = chunks.list->size();
+  assert(chunk_idx < num_chunks);
+
+  MutexLockGuard m(&lock_);
+  const shash::Any &current_id = chunks.list->AtPtr(chunk_idx)->content_hash();
+  if (is_sequential) {
+    std::map<shash::Any, TrackedChunk>::const_iterator i =
+      tracked_.find(current_id);
+    if ((i != tracked_.end()) && (i->second.state == kChunkDone)) {
+      perf::Inc(n_hit_);
+    } else {
+      perf::Inc(n_miss_);
+    }
+  }
+  Untrack(current_id);
+
+  if (!is_sequential || !spawned_)
+    return;
+
+  const unsigned last_idx = std::min(chunk_idx + window_, num_chunks - 1);
+  unsigned num_scheduled = 0;
+  for (unsigned idx = chunk_idx + 1; idx <= last_idx; ++idx) {
+    const FileChunk *chunk = chunks.list->AtPtr(idx);
+    if (tracked_.find(chunk->content_hash()) != tracked_.end())
+      continue;
+    if (jobs_.size() >= kMaxQueueLength) {
+      perf::Xadd(n_dropped_, last_idx - idx + 1);
+      break;
+    }
+
+    Job job;
+    job.id = chunk->content_hash();
+    job.size = chunk->size();
+    job.offset = chunk->offset();
+    job.path = chunks.path.ToString();
+    job.compression_alg = chunks.compression_alg;
+    job.external_data = chunks.external_data;
+    job.object_type = object_type;
+    job.generation = Track(job.id);
+    jobs_.push_back(job);
+    num_scheduled++;
+  }
+
+  if (num_scheduled > 0) {
+    perf::Xadd(n_scheduled_, num_scheduled);
+    int retval = pthread_cond_broadcast(&cond_jobs_);
+    assert(retval == 0);
+    LogCvmfs(kLogCvmfs, kLogDebug, "scheduled %u chunks of %s for read-ahead",
+             num_scheduled, chunks.path.c_str());
+  }
+}
+
+
+/**
+ * Must not be called with lock_ held because on a cache hit, the fetcher calls
+ * OnFetched() right away.
+ */
+void ChunkReadAhead::ProcessJob(const Job &job) {
+  const string verbose_path = "Part of " + job.path;
+  const CallbackTN *callback = MakeClosure(&ChunkReadAhead::OnFetched,
+                                           this, job);
+  if (job.external_data) {
+    external_fetcher_->FetchAsync(job.id, job.size, verbose_path,
+                                  job.compression_alg, job.object_type,
+                                  callback, job.path, job.offset);
+  } else {
+    fetcher_->FetchAsync(job.id, job.size, verbose_path,
+                         job.compression_alg, job.object_type, callback);
+  }
+}
+
+
+/**
+ * Called by the fetcher once the read-ahead chunk is in the cache or failed to
+ * download, usually in the fetcher's completion thread.
+ */
+void ChunkReadAhead::OnFetched(const int &fd, const Job job) {
+  const string verbose_path = "Part of " + job.path;
+  if (fd >= 0) {
+    Fetcher *this_fetcher = job.external_data ? external_fetcher_ : fetcher_;
+    this_fetcher->cache_mgr()->Close(fd);
+    perf::Inc(n_fetched_);
+  } else {
+    LogCvmfs(kLogCvmfs, kLogDebug, "read-ahead of %s failed (%d)",
+             verbose_path.c_str(), fd);
+    perf::Inc(n_failed_);
+  }
+
+  MutexLockGuard m(&lock_);
+  assert(num_in_flight_ > 0);
+  num_in_flight_--;
+  int retval = pthread_cond_broadcast(&cond_jobs_);
+  assert(retval == 0);
+
+  std::map<shash::Any, TrackedChunk>::iterator i = tracked_.find(job.id);
+  if ((i == tracked_.end()) || (i->second.generation != job.generation))
+    return;
+  if (fd >= 0) {
+    i->second.state = kChunkDone;
+  } else {
+    Untrack(job.id);
+  }
+}
+
+
+void ChunkReadAhead::Spawn() {
+  if (window_ == 0)
+    return;
+  for (unsigned i = 0; i < num_threads_; ++i) {
+    pthread_t thread;
+    int retval = pthread_create(&thread, NULL, MainWorker, this);
+    assert(retval == 0);
+    threads_.push_back(thread);
+  }
+  spawned_ = true;
+}
+
+
+/**
+ * Called with lock_ held.  Returns the generation of the new entry.
+ */
+uint64_t ChunkReadAhead::Track(const shash::Any &id) {
+  TrackedChunk tracked_chunk;
+  tracked_chunk.generation = next_generation_++;
+  tracked_[id] = tracked_chunk;
+  tracked_fifo_.push_back(std::make_pair(id, tracked_chunk.generation));
+  while (tracked_fifo_.size() > kMaxTracked) {
+    std::map<shash::Any, TrackedChunk>::iterator i =
+      tracked_.find(tracked_fifo_.front().first);
+    if ((i != tracked_.end()) &&
+        (i->second.generation == tracked_fifo_.front().second))
+    {
+      tracked_.erase(i);
+    }
+    tracked_fifo_.pop_front();
+  }
+  return tracked_chunk.generation;
+}
+
+
+/**
+ * Called with lock_ held.  The entry in tracked_fifo_ gets removed lazily.
+ */
+void ChunkReadAhead::Untrack(const shash::Any &id) {
+  tracked_.erase(id);
+}
+
+}  // namespace cvmfs
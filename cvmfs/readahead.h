@@ -0,0 +1,171 @@
+/**
+ * This file is part of the CernVM File System.
+ *
+ * Read-ahead of chunked files: while a reader consumes a chunk, the following
+ * chunks are fetched into the cache by a small pool of background threads.
+ */
+
+#ifndef CVMFS_READAHEAD_H_
+#define CVMFS_READAHEAD_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cache.h"
+#include "compression.h"
+#include "crypto/hash.h"
+#include "file_chunk.h"
+#include "gtest/gtest_prod.h"
+#include "statistics.h"
+#include "util/async.h"
+#include "util/single_copy.h"
+
+namespace cvmfs {
+
+class Fetcher;
+
+/**
+ * Detects sequential access on chunked files and asynchronously fetches the
+ * next chunks of the FileChunkReflist into the cache while the current chunk
+ * is served.  Sequential access is assumed when a chunk handle moves from
+ * chunk i to chunk i+1.  In that case, the chunks i+1 ... i+window are queued
+ * for download.
+ *
+ * The read-ahead threads use the asynchronous interface of the regular
+ * Fetcher, so that a reader that catches up with an in-flight read-ahead
+ * download is collapsed onto it instead of downloading the chunk a second
+ * time.  A thread does not wait for its downloads; up to kMaxInFlight
+ * read-ahead downloads are driven by the download manager at the same time.
+ *
+ * If the job queue is full, read-ahead requests are silently dropped; the
+ * reader will then fetch the chunk itself.
+ */
+class ChunkReadAhead : public Callbackable<int>, SingleCopy {
+  FRIEND_TEST(T_ChunkReadAhead, Tracking);
+
+ public:
+  static const unsigned kDefaultNumThreads = 2;
+  static const unsigned kMaxWindow = 64;
+  static const unsigned kMaxNumThreads = 32;
+  /**
+   * Upper bound of read-ahead jobs waiting for a thread
+   */
+  static const unsigned kMaxQueueLength = 256;
+  /**
+   * Upper bound of read-ahead downloads handed to the fetchers at a time
+   */
+  static const unsigned kMaxInFlight = 64;
+  /**
+   * Upper bound of remembered read-ahead chunks for the hit/miss accounting
+   */
+  static const unsigned kMaxTracked = 1024;
+
+  ChunkReadAhead(const unsigned window,
+                 const unsigned num_threads,
+                 Fetcher *fetcher,
+                 Fetcher *external_fetcher,
+                 perf::StatisticsTemplate statistics);
+  ~ChunkReadAhead();
+  void Spawn();
+
+  /**
+   * Called by the reader before it opens chunk_idx of chunks.  If is_sequential
+   * is set, the following chunks are scheduled for read-ahead.
+   */
+  void OnChunkOpen(const FileChunkReflist &chunks,
+                   const unsigned chunk_idx,
+                   const bool is_sequential,
+                   const CacheManager::ObjectType object_type);
+
+  unsigned window() const { return window_; }
+
+ private:
+  struct Job {
+    Job()
+      : size(0)
+      , offset(0)
+      , compression_alg(zlib::kZlibDefault)
+      , external_data(false)
+      , object_type(CacheManager::kTypeRegular)
+      , generation(0)
+    { }
+    shash::Any id;
+    uint64_t size;
+    off_t offset;
+    std::string path;
+    zlib::Algorithms compression_alg;
+    bool external_data;
+    CacheManager::ObjectType object_type;
+    uint64_t generation;
+  };
+
+  /**
+   * State of a chunk that was handed to the read-ahead threads
+   */
+  enum ChunkState {
+    kChunkPending = 0,
+    kChunkDone,
+  };
+
+  /**
+   * The generation tells apart the entries of a chunk that was untracked and
+   * tracked again, so that stale entries in tracked_fifo_ and late callbacks
+   * of an earlier read-ahead do not touch the new state
+   */
+  struct TrackedChunk {
+    TrackedChunk() : state(kChunkPending), generation(0) { }
+    ChunkState state;
+    uint64_t generation;
+  };
+
+  static void *MainWorker(void *data);
+  void ProcessJob(const Job &job);
+  void OnFetched(const int &fd, const Job job);
+  uint64_t Track(const shash::Any &id);
+  void Untrack(const shash::Any &id);
+
+  unsigned window_;
+  unsigned num_threads_;
+  Fetcher *fetcher_;
+  Fetcher *external_fetcher_;
+  bool spawned_;
+  bool terminate_;
+  std::vector<pthread_t> threads_;
+
+  /**
+   * Protects the job queue and the chunk tracking maps
+   */
+  pthread_mutex_t lock_;
+  pthread_cond_t cond_jobs_;
+  std::deque<Job> jobs_;
+  /**
+   * Number of jobs passed to FetchAsync() whose callback did not yet return
+   */
+  unsigned num_in_flight_;
+  std::map<shash::Any, TrackedChunk> tracked_;
+  /**
+   * Insertion order of tracked_ to evict the oldest entries.  Untracked chunks
+   * are removed lazily, their generation does not match anymore.
+   */
+  std::deque<std::pair<shash::Any, uint64_t> > tracked_fifo_;
+  uint64_t next_generation_;
+
+  perf::Counter *n_window_;
+  perf::Counter *n_scheduled_;
+  perf::Counter *n_dropped_;
+  perf::Counter *n_fetched_;
+  perf::Counter *n_failed_;
+  perf::Counter *n_hit_;
+  perf::Counter *n_miss_;
+};
+
+}  // namespace cvmfs
+
+#endif  // CVMFS_READAHEAD_H_
@@ -156,6 +156,12 @@ bool GetParamsFromFile(const std::string& repo_name, Params* params) {
     params->enforce_limits = parser.IsOn(enforce_limits_str);
   }
 
+  params->path_filters = false;
+  std::string path_filters_str;
+  if (parser.GetValue("CVMFS_CATALOG_PATH_FILTER", &path_filters_str)) {
+    params->path_filters = parser.IsOn(path_filters_str);
+  }
+
   // TODO(dwd): the next 3 limit variables should take defaults from
   // SyncParameters
   params->nested_kcatalog_limit = 0;
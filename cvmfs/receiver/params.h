@@ -27,6 +27,7 @@ struct Params {
   size_t avg_chunk_size;
   size_t max_chunk_size;
   bool enforce_limits;
+  bool path_filters;
   size_t nested_kcatalog_limit;
   size_t root_kcatalog_limit;
   size_t file_mbyte_limit;
@@ -342,6 +342,7 @@ cvmfs_server_mkfs() {
       -r $upstream                                \
       -n $name                                    \
       -a $hash_algo $volatile_opt                 \
+      -Z $compression_alg                         \
       -o ${temp_dir}/new_manifest                 \
       -R $(get_reflog_checksum $name)"
       if $garbage_collectable; then
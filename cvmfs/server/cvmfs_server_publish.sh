@@ -231,6 +231,9 @@ cvmfs_server_publish() {
        -l $CVMFS_MIN_CHUNK_SIZE \
        -a $CVMFS_AVG_CHUNK_SIZE \
        -h $CVMFS_MAX_CHUNK_SIZE"
+      if [ "x$CVMFS_CHUNKING_ALGORITHM" != "x" ]; then
+        sync_command="$sync_command -G $CVMFS_CHUNKING_ALGORITHM"
+      fi
     fi
     if [ "x$CVMFS_AUTOCATALOGS" = "xtrue" ]; then
       sync_command="$sync_command -A"
@@ -250,6 +253,9 @@ cvmfs_server_publish() {
     if [ "x${CVMFS_ENFORCE_LIMITS:-$CVMFS_DEFAULT_ENFORCE_LIMITS}" = "xtrue" ]; then
       sync_command="$sync_command -E"
     fi
+    if [ "x$CVMFS_CATALOG_PATH_FILTER" = "xtrue" ]; then
+      sync_command="$sync_command -j"
+    fi
     if [ "x$CVMFS_NESTED_KCATALOG_LIMIT" != "x" ]; then
       sync_command="$sync_command -Q $CVMFS_NESTED_KCATALOG_LIMIT"
     fi
@@ -262,6 +268,20 @@ cvmfs_server_publish() {
     if [ "x$CVMFS_NUM_UPLOAD_TASKS" != "x" ]; then
       sync_command="$sync_command -0 $CVMFS_NUM_UPLOAD_TASKS"
     fi
+    # Unchanged files are registered from the content index without being
+    # compressed and uploaded again.  Every new or changed file, however, is
+    # read and hashed twice: once to look it up, once to process it.  Entries
+    # unused for 50 publish runs are pruned, and the index is capped at one
+    # million entries.  The gateway cannot verify that indexed objects still
+    # exist.
+    if [ "x$CVMFS_CONTENT_INDEX" = "xtrue" ] && [ x"$upstream_type" != xgw ]; then
+      sync_command="$sync_command -1 ${spool_dir}/content_index"
+    fi
+    # Keeps several blocks of a file in flight, using io_uring if available and
+    # a pool of pread threads otherwise
+    if [ "x$CVMFS_ASYNC_READ" = "xtrue" ]; then
+      sync_command="$sync_command -2"
+    fi
     if [ "x$manual_revision" != "x" ]; then
       sync_command="$sync_command -v $manual_revision"
     fi
@@ -202,7 +202,7 @@ bool Database<DerivedT>::Configure() {
 template <class DerivedT>
 bool Database<DerivedT>::FileReadAhead() {
   // Read-ahead into file system buffers
-  // TODO(jblomer): mmap, re-readahead
+  // TODO(jblomer): re-readahead
   assert(filename().length() > 1);
   int fd_readahead;
   if (filename()[0] != '@') {
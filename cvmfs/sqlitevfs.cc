@@ -19,6 +19,7 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <stdint.h>
+#include <sys/mman.h>
 #include <sys/select.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -62,6 +63,7 @@ struct VfsRdOnly {
     , n_sleep(NULL)
     , sz_sleep(NULL)
     , n_time(NULL)
+    , n_mmap(NULL)
   { }
   CacheManager *cache_mgr;
   perf::Counter *n_access;
@@ -73,6 +75,7 @@ struct VfsRdOnly {
   perf::Counter *n_sleep;
   perf::Counter *sz_sleep;
   perf::Counter *n_time;
+  perf::Counter *n_mmap;
 };
 
 /**
@@ -83,6 +86,13 @@ struct VfsRdOnlyFile {
   VfsRdOnly *vfs_rdonly;
   int fd;
   uint64_t size;
+  /**
+   * Read-only mapping of the entire file, created on the first xFetch() call.
+   * Only the posix cache manager hands out file descriptors that can be
+   * mapped.
+   */
+  void *mmap_base;
+  bool mmap_failed;
 };
 
 /**
@@ -108,9 +118,19 @@ static void ApplyFdMap(VfsRdOnlyFile *pFile) {
 }
 
 
+static void UnmapFile(VfsRdOnlyFile *p) {
+  if (p->mmap_base == NULL)
+    return;
+  int retval = munmap(p->mmap_base, p->size);
+  assert(retval == 0);
+  p->mmap_base = NULL;
+}
+
+
 static int VfsRdOnlyClose(sqlite3_file *pFile) {
   VfsRdOnlyFile *p = reinterpret_cast<VfsRdOnlyFile *>(pFile);
   ApplyFdMap(p);
+  UnmapFile(p);
   int retval = p->vfs_rdonly->cache_mgr->Close(p->fd);
   if (retval == 0) {
     perf::Dec(p->vfs_rdonly->no_open);
@@ -206,14 +226,23 @@ static int VfsRdOnlyCheckReservedLock(
 
 
 /**
- *  No xFileControl() verbs are implemented by this VFS.
+ * Only the kFcntlDupFd verb is implemented by this VFS.
  */
 static int VfsRdOnlyFileControl(
-  sqlite3_file *p __attribute__((unused)),
-  int op __attribute__((unused)),
-  void *pArg __attribute__((unused))
+  sqlite3_file *pFile,
+  int op,
+  void *pArg
 ) {
-  return SQLITE_NOTFOUND;
+  if (op != kFcntlDupFd)
+    return SQLITE_NOTFOUND;
+
+  VfsRdOnlyFile *p = reinterpret_cast<VfsRdOnlyFile *>(pFile);
+  ApplyFdMap(p);
+  int new_fd = p->vfs_rdonly->cache_mgr->Dup(p->fd);
+  if (new_fd < 0)
+    return SQLITE_IOERR;
+  *reinterpret_cast<int *>(pArg) = new_fd;
+  return SQLITE_OK;
 }
 
 
@@ -235,9 +264,61 @@ static int VfsRdOnlyDeviceCharacteristics(
 }
 
 
+/**
+ * Memory-mapped I/O, used by SQlite if the mmap_size pragma is set.  Returning
+ * a NULL pointer makes SQlite fall back to xRead().  Since the catalogs are
+ * immutable, the whole file is mapped once and pages are never unmapped
+ * individually.
+ */
+static int VfsRdOnlyFetch(
+  sqlite3_file *pFile,
+  sqlite3_int64 iOfst,
+  int iAmt,
+  void **pp)
+{
+  VfsRdOnlyFile *p = reinterpret_cast<VfsRdOnlyFile *>(pFile);
+  *pp = NULL;
+  if (p->mmap_base == NULL) {
+    if (p->mmap_failed || (p->size == 0))
+      return SQLITE_OK;
+    if (p->vfs_rdonly->cache_mgr->id() != kPosixCacheManager) {
+      p->mmap_failed = true;
+      return SQLITE_OK;
+    }
+    ApplyFdMap(p);
+    void *mapping = mmap(NULL, p->size, PROT_READ, MAP_SHARED, p->fd, 0);
+    if (mapping == MAP_FAILED) {
+      LogCvmfs(kLogSql, kLogDebug, "failed to mmap fd %d (%d)", p->fd, errno);
+      p->mmap_failed = true;
+      return SQLITE_OK;
+    }
+    p->mmap_base = mapping;
+    perf::Inc(p->vfs_rdonly->n_mmap);
+  }
+  if (static_cast<uint64_t>(iOfst + iAmt) <= p->size)
+    *pp = reinterpret_cast<char *>(p->mmap_base) + iOfst;
+  return SQLITE_OK;
+}
+
+
+/**
+ * A negative offset requests to release the entire mapping.
+ */
+static int VfsRdOnlyUnfetch(
+  sqlite3_file *pFile,
+  sqlite3_int64 iOfst,
+  void *pPage __attribute__((unused)))
+{
+  if (iOfst < 0)
+    UnmapFile(reinterpret_cast<VfsRdOnlyFile *>(pFile));
+  return SQLITE_OK;
+}
+
+
 /**
  * Supports only read-only opens.  The "file name" has to be in the form of
  * '@<file descriptor>', where file descriptor is usable by the cache manager.
+ * The file descriptor is owned by the VFS and closed on xClose().
  */
 static int VfsRdOnlyOpen(
   sqlite3_vfs *vfs,
@@ -247,7 +328,7 @@ static int VfsRdOnlyOpen(
   int *pOutFlags)
 {
   static const sqlite3_io_methods io_methods = {
-    1,  // iVersion
+    3,  // iVersion
     VfsRdOnlyClose,
     VfsRdOnlyRead,
     VfsRdOnlyWrite,
@@ -259,7 +340,13 @@ static int VfsRdOnlyOpen(
     VfsRdOnlyCheckReservedLock,
     VfsRdOnlyFileControl,
     VfsRdOnlySectorSize,
-    VfsRdOnlyDeviceCharacteristics
+    VfsRdOnlyDeviceCharacteristics,
+    NULL,  // xShmMap
+    NULL,  // xShmLock
+    NULL,  // xShmBarrier
+    NULL,  // xShmUnmap
+    VfsRdOnlyFetch,
+    VfsRdOnlyUnfetch
   };
 
   VfsRdOnlyFile *p = reinterpret_cast<VfsRdOnlyFile *>(pFile);
@@ -291,6 +378,8 @@ static int VfsRdOnlyOpen(
     return SQLITE_IOERR;
   }
   p->size = static_cast<uint64_t>(size);
+  p->mmap_base = NULL;
+  p->mmap_failed = false;
   if (pOutFlags)
     *pOutFlags = flags;
   p->vfs_rdonly = reinterpret_cast<VfsRdOnly *>(vfs->pAppData);
@@ -510,6 +599,8 @@ bool RegisterVfsRdOnly(
     statistics->Register("sqlite.sz_sleep", "overall microseconds slept");
   vfs_rdonly->n_time =
     statistics->Register("sqlite.n_time", "overall number of time() calls");
+  vfs_rdonly->n_mmap =
+    statistics->Register("sqlite.n_mmap", "overall number of mmap() calls");
 
   return true;
 }
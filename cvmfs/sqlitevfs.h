@@ -19,6 +19,14 @@ enum VfsOptions {
   kVfsOptDefault,  // the VFS becomes the default for new database connections.
 };
 
+/**
+ * Custom xFileControl() verb of the read-only VFS.  Duplicates the file
+ * descriptor of an open catalog through the cache manager, so that another
+ * connection to the same catalog can be opened as '@<new fd>'.  The argument
+ * is a pointer to an int that receives the new file descriptor.
+ */
+const int kFcntlDupFd = 1000;
+
 bool RegisterVfsRdOnly(CacheManager *cache_mgr,
                        perf::Statistics *statistics,
                        const VfsOptions options);
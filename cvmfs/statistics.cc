@@ -6,8 +6,11 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 
 #include "json_document_write.h"
+#include "util/algorithm.h"
 #include "util/concurrency.h"
 #include "util/platform.h"
 #include "util/smalloc.h"
@@ -34,6 +37,54 @@ std::string Counter::PrintRatio(Counter divider) {
 }
 
 
+void Counter::Set(const int64_t val) {
+  if (shards_ != NULL) {
+    for (unsigned i = 0; i < kNumShards; ++i)
+      atomic_write64(&shards_[i].value, 0);
+  }
+  atomic_write64(&counter_, val);
+}
+
+
+/**
+ * Threads may migrate to another CPU after the slot has been selected, so the
+ * slots are still updated atomically.  It is just unlikely that the atomic
+ * operation has to fight for the cache line.
+ */
+unsigned Counter::GetShardIndex() {
+  return platform_getcpu() % kNumShards;
+}
+
+
+int64_t Counter::XaddShard(const int64_t delta) {
+  return atomic_xadd64(&shards_[GetShardIndex()].value, delta);
+}
+
+
+int64_t Counter::GetSharded() {
+  int64_t result = atomic_read64(&counter_);
+  for (unsigned i = 0; i < kNumShards; ++i)
+    result += atomic_read64(&shards_[i].value);
+  return result;
+}
+
+
+void Counter::InitShards() {
+  assert(shards_ == NULL);
+  void *mem;
+  int retval = posix_memalign(&mem, kCacheLine, kNumShards * sizeof(Shard));
+  assert(retval == 0);
+  memset(mem, 0, kNumShards * sizeof(Shard));
+  shards_ = reinterpret_cast<Shard *>(mem);
+}
+
+
+void Counter::FreeShards() {
+  free(shards_);
+  shards_ = NULL;
+}
+
+
 //-----------------------------------------------------------------------------
 
 
@@ -54,6 +105,12 @@ Statistics *Statistics::Fork() {
     atomic_inc32(&i->second->refcnt);
   }
   child->counters_ = counters_;
+  for (map<string, HistogramInfo *>::iterator i = histograms_.begin(),
+       iEnd = histograms_.end(); i != iEnd; ++i)
+  {
+    atomic_inc32(&i->second->refcnt);
+  }
+  child->histograms_ = histograms_;
 
   return child;
 }
@@ -76,6 +133,15 @@ string Statistics::LookupDesc(const std::string &name) {
   return "";
 }
 
+Log2Histogram *Statistics::LookupHistogram(const std::string &name) const {
+  MutexLockGuard lock_guard(lock_);
+  map<string, HistogramInfo *>::const_iterator i = histograms_.find(name);
+  if (i != histograms_.end())
+    return i->second->histogram;
+  return NULL;
+}
+
+
 string Statistics::PrintList(const PrintOptions print_options) {
   string result;
   if (print_options == kPrintHeader)
@@ -91,6 +157,18 @@ string Statistics::PrintList(const PrintOptions print_options) {
   return result;
 }
 
+string Statistics::PrintHistograms() {
+  string result;
+  MutexLockGuard lock_guard(lock_);
+  for (map<string, HistogramInfo *>::const_iterator i = histograms_.begin(),
+       iEnd = histograms_.end(); i != iEnd; ++i)
+  {
+    result += i->first + " (" + i->second->desc + ")\n" +
+              i->second->histogram->ToString();
+  }
+  return result;
+}
+
 /**
  * Converts statistics counters into JSON string in following format
  * {
@@ -155,6 +233,34 @@ void Statistics::SnapshotCounters(
     // modify or insert
     (*counters)[i->first] = (*i->second).counter.Get();
   }
+  // The keys need to be the same in every snapshot, so that deltas can be
+  // computed even if a histogram is still empty
+  for (map<string, HistogramInfo *>::const_iterator i = histograms_.begin(),
+       iEnd = histograms_.end(); i != iEnd; ++i)
+  {
+    (*counters)[i->first + ".n"] = i->second->histogram->N();
+  }
+}
+
+/**
+ * Percentiles of the histograms.  Unlike counters, they are point-in-time
+ * values of which no deltas should be computed.  They only cover the samples
+ * added since the previous call, i.e. the last export interval, so that a
+ * change in latency is not hidden by the history since mount.  Percentiles of
+ * an interval without samples are 0.
+ */
+void Statistics::SnapshotGauges(std::map<std::string, int64_t> *gauges) {
+  MutexLockGuard lock_guard(lock_);
+  for (map<string, HistogramInfo *>::const_iterator i = histograms_.begin(),
+       iEnd = histograms_.end(); i != iEnd; ++i)
+  {
+    const Log2Histogram current(*i->second->histogram);
+    Log2Histogram interval = current.Since(*i->second->last_snapshot);
+    *i->second->last_snapshot = current;
+    (*gauges)[i->first + ".p50"] = interval.GetQuantile(0.5);
+    (*gauges)[i->first + ".p90"] = interval.GetQuantile(0.9);
+    (*gauges)[i->first + ".p99"] = interval.GetQuantile(0.99);
+  }
 }
 
 Counter *Statistics::Register(const string &name, const string &desc) {
@@ -166,6 +272,51 @@ Counter *Statistics::Register(const string &name, const string &desc) {
 }
 
 
+/**
+ * Like Register() but the counter is sharded, which makes Inc() and Xadd()
+ * scale with the number of threads at the cost of a slower Get().  Use for
+ * counters in the hot path of the file system callbacks.
+ */
+Counter *Statistics::RegisterSharded(const string &name, const string &desc) {
+  Counter *counter = Register(name, desc);
+  counter->InitShards();
+  return counter;
+}
+
+
+/**
+ * Histograms have 30 bins of microseconds; samples above ~18 minutes end up in
+ * the overflow bin.  Nanoseconds, like for the fuse callbacks, would put
+ * everything above ~0.5s into the overflow bin, which is common for downloads.
+ */
+Log2Histogram *Statistics::RegisterHistogram(
+  const string &name,
+  const string &desc)
+{
+  MutexLockGuard lock_guard(lock_);
+  assert(histograms_.find(name) == histograms_.end());
+  HistogramInfo *histogram_info = new HistogramInfo(desc);
+  histograms_[name] = histogram_info;
+  return histogram_info->histogram;
+}
+
+
+Statistics::HistogramInfo::HistogramInfo(const std::string &desc)
+  : histogram(new Log2Histogram(kNumHistogramBins))
+  , last_snapshot(new Log2Histogram(kNumHistogramBins))
+  , desc(desc)
+{
+  atomic_init32(&refcnt);
+  atomic_inc32(&refcnt);
+}
+
+
+Statistics::HistogramInfo::~HistogramInfo() {
+  delete histogram;
+  delete last_snapshot;
+}
+
+
 Statistics::Statistics() {
   lock_ =
     reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
@@ -182,6 +333,13 @@ Statistics::~Statistics() {
     if (old_value == 1)
       delete i->second;
   }
+  for (map<string, HistogramInfo *>::iterator i = histograms_.begin(),
+       iEnd = histograms_.end(); i != iEnd; ++i)
+  {
+    int32_t old_value = atomic_xadd32(&i->second->refcnt, -1);
+    if (old_value == 1)
+      delete i->second;
+  }
   pthread_mutex_destroy(lock_);
   free(lock_);
 }
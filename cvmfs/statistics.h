@@ -18,20 +18,49 @@
 namespace CVMFS_NAMESPACE_GUARD {
 #endif
 
+class Log2Histogram;
 
 namespace perf {
 
 /**
  * A wrapper around an atomic 64bit signed integer.
+ *
+ * Counters registered with Statistics::RegisterSharded() spread the updates
+ * over a number of cache line sized slots selected by the current CPU.  That
+ * avoids cache line bouncing for counters that are modified by many threads
+ * at a high rate.  Get() sums up the slots.  Sharded counters are owned by
+ * their Statistics object, copies share the slots with the original.
  */
 class Counter {
+  friend class Statistics;
+
  public:
-  Counter() { atomic_init64(&counter_); }
-  void Inc() { atomic_inc64(&counter_); }
-  void Dec() { atomic_dec64(&counter_); }
-  int64_t Get() { return atomic_read64(&counter_); }
-  void Set(const int64_t val) { atomic_write64(&counter_, val); }
-  int64_t Xadd(const int64_t delta) { return atomic_xadd64(&counter_, delta); }
+  /**
+   * Number of slots of sharded counters
+   */
+  static const unsigned kNumShards = 64;
+
+  Counter() : shards_(NULL) { atomic_init64(&counter_); }
+  void Inc() {
+    if (shards_ == NULL) atomic_inc64(&counter_); else XaddShard(1);
+  }
+  void Dec() {
+    if (shards_ == NULL) atomic_dec64(&counter_); else XaddShard(-1);
+  }
+  int64_t Get() {
+    return (shards_ == NULL) ? atomic_read64(&counter_) : GetSharded();
+  }
+  void Set(const int64_t val);
+  /**
+   * Returns the previous value.  For sharded counters, that is only the
+   * previous value of the slot of the current CPU.
+   */
+  int64_t Xadd(const int64_t delta) {
+    return (shards_ == NULL) ? atomic_xadd64(&counter_, delta)
+                             : XaddShard(delta);
+  }
+
+  bool IsSharded() const { return shards_ != NULL; }
 
   std::string Print();
   std::string PrintK();
@@ -42,7 +71,23 @@ class Counter {
   std::string ToString();
 
  private:
+  static const unsigned kCacheLine = 64;
+  struct Shard {
+    atomic_int64 value;
+    char padding[kCacheLine - sizeof(atomic_int64)];
+  };
+
+  static unsigned GetShardIndex();
+  int64_t XaddShard(const int64_t delta);
+  int64_t GetSharded();
+  void InitShards();
+  void FreeShards();
+
   atomic_int64 counter_;
+  /**
+   * NULL for regular counters, otherwise kNumShards cache line aligned slots
+   */
+  Shard *shards_;
 };
 
 // perf::Func(Counter) is more clear to read in the code
@@ -56,6 +101,11 @@ inline int64_t Xadd(class Counter *counter, const int64_t delta) {
 /**
  * A collection of Counter objects with a name and a description.  Counters in
  * a Statistics class have a name and a description.  Thread-safe.
+ *
+ * Latency histograms in microseconds can be registered alongside the counters.
+ * SnapshotCounters() exports their number of samples as a counter,
+ * SnapshotGauges() exports their percentiles over the samples since the
+ * previous call.
  */
 class Statistics {
  public:
@@ -68,12 +118,18 @@ class Statistics {
   ~Statistics();
   Statistics *Fork();
   Counter *Register(const std::string &name, const std::string &desc);
+  Counter *RegisterSharded(const std::string &name, const std::string &desc);
   Counter *Lookup(const std::string &name) const;
   std::string LookupDesc(const std::string &name);
+  Log2Histogram *RegisterHistogram(const std::string &name,
+                                   const std::string &desc);
+  Log2Histogram *LookupHistogram(const std::string &name) const;
   std::string PrintList(const PrintOptions print_options);
+  std::string PrintHistograms();
   std::string PrintJSON();
   void SnapshotCounters(std::map<std::string, int64_t> *counters,
                         uint64_t *timestamp_ns);
+  void SnapshotGauges(std::map<std::string, int64_t> *gauges);
 
  private:
   Statistics(const Statistics &other);
@@ -83,11 +139,25 @@ class Statistics {
       atomic_init32(&refcnt);
       atomic_inc32(&refcnt);
     }
+    ~CounterInfo() { counter.FreeShards(); }
     atomic_int32 refcnt;
     Counter counter;
     std::string desc;
   };
+  struct HistogramInfo {
+    explicit HistogramInfo(const std::string &desc);
+    ~HistogramInfo();
+    atomic_int32 refcnt;
+    Log2Histogram *histogram;
+    /**
+     * Copy of the histogram taken by the last SnapshotGauges()
+     */
+    Log2Histogram *last_snapshot;
+    std::string desc;
+  };
+  static const unsigned kNumHistogramBins = 30;
   std::map<std::string, CounterInfo *> counters_;
+  std::map<std::string, HistogramInfo *> histograms_;
   mutable pthread_mutex_t *lock_;
 };
 
@@ -114,6 +184,19 @@ class StatisticsTemplate {
     return statistics_->Register(name_major_ + "." + name_minor, desc);
   }
 
+  Counter *RegisterShardedTemplated(const std::string &name_minor,
+                                    const std::string &desc)
+  {
+    return statistics_->RegisterSharded(name_major_ + "." + name_minor, desc);
+  }
+
+  Log2Histogram *RegisterHistogramTemplated(const std::string &name_minor,
+                                            const std::string &desc)
+  {
+    return statistics_->RegisterHistogram(name_major_ + "." + name_minor,
+                                          desc);
+  }
+
   Counter *RegisterOrLookupTemplated(const std::string &name_minor,
                                      const std::string &desc)
   {
@@ -24,7 +24,7 @@ namespace swissknife {
 
 typedef HttpObjectFetcher<> ObjectFetcher;
 typedef CatalogTraversalParallel<ObjectFetcher> ReadonlyCatalogTraversal;
-typedef SmallhashFilter HashFilter;
+typedef CompactHashFilter HashFilter;
 typedef GarbageCollector<ReadonlyCatalogTraversal, HashFilter> GC;
 typedef GarbageCollectorAux<ReadonlyCatalogTraversal, HashFilter> GCAux;
 typedef GC::Configuration GcConfig;
@@ -67,6 +67,8 @@ int swissknife::Ingest::Main(const swissknife::ArgumentList &args) {
   if (args.find('Z') != args.end()) {
     params.compression_alg =
         zlib::ParseCompressionAlgorithm(*args.find('Z')->second);
+    params.compression_level =
+        zlib::ParseCompressionLevel(*args.find('Z')->second);
   }
 
   bool create_catalog = args.find('C') != args.end();
@@ -100,6 +102,7 @@ int swissknife::Ingest::Main(const swissknife::ArgumentList &args) {
     spooler_definition.number_of_concurrent_uploads =
         params.max_concurrent_write_jobs;
   }
+  spooler_definition.compression_level = params.compression_level;
 
   // Sanitize base_directory, removing any leading or trailing slashes
   // from non-root (!= "/") paths
@@ -7,6 +7,9 @@
 #include "swissknife_scrub.h"
 #include "cvmfs_config.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "util/fs_traversal.h"
 #include "util/logging.h"
 #include "util/posix.h"
@@ -91,6 +94,8 @@ void CommandScrub::FileCallback(
 
   shash::Any hash_from_name =
     shash::MkFromSuffixedHexPtr(shash::HexPtr(hash_string));
+  if (QueueSmallObject(full_path, hash_from_name))
+    return;
   IngestionSource* full_path_source = new FileIngestionSource(full_path);
   pipeline_scrubbing_.Process(
     full_path_source,
@@ -99,6 +104,61 @@ void CommandScrub::FileCallback(
 }
 
 
+/**
+ * Reads BLAKE3 objects that fit into a single chunk into memory.  Returns
+ * false if the object needs to go through the scrubbing pipeline.
+ */
+bool CommandScrub::QueueSmallObject(
+  const std::string &full_path,
+  const shash::Any &hash_from_name)
+{
+  if (hash_from_name.algorithm != shash::kBlake3)
+    return false;
+  const int64_t size = GetFileSize(full_path);
+  if ((size < 0) || (size > static_cast<int64_t>(shash::kBlake3ChunkSize)))
+    return false;
+
+  int fd = open(full_path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  std::string content;
+  const bool retval = SafeReadToString(fd, &content);
+  close(fd);
+  if (!retval || (content.length() > shash::kBlake3ChunkSize))
+    return false;
+
+  small_paths_.push_back(full_path);
+  small_contents_.push_back(content);
+  small_hashes_.push_back(
+    shash::Any(shash::kBlake3, hash_from_name.suffix));
+  if (small_paths_.size() == shash::kBlake3Lanes)
+    HashSmallObjects();
+  return true;
+}
+
+
+void CommandScrub::HashSmallObjects() {
+  const unsigned n = small_paths_.size();
+  if (n == 0)
+    return;
+
+  std::vector<const unsigned char *> buffers(n);
+  std::vector<unsigned> sizes(n);
+  for (unsigned i = 0; i < n; ++i) {
+    buffers[i] =
+      reinterpret_cast<const unsigned char *>(small_contents_[i].data());
+    sizes[i] = small_contents_[i].length();
+  }
+  shash::HashMemMulti(n, &buffers[0], &sizes[0], &small_hashes_[0]);
+  for (unsigned i = 0; i < n; ++i)
+    OnFileHashed(ScrubbingResult(small_paths_[i], small_hashes_[i]));
+
+  small_paths_.clear();
+  small_contents_.clear();
+  small_hashes_.clear();
+}
+
+
 void CommandScrub::DirCallback(
   const std::string &relative_path,
   const std::string &dir_name)
@@ -192,6 +252,7 @@ int CommandScrub::Main(const swissknife::ArgumentList &args) {
   traverser.fn_enter_dir = &CommandScrub::DirCallback;
   traverser.fn_new_symlink = &CommandScrub::SymlinkCallback;
   traverser.Recurse(repo_path_);
+  HashSmallObjects();
 
   // wait for reader to finish all jobs
   pipeline_scrubbing_.WaitFor();
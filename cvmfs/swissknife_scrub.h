@@ -9,6 +9,7 @@
 
 #include <cassert>
 #include <string>
+#include <vector>
 
 #include "crypto/hash.h"
 #include "ingestion/pipeline.h"
@@ -70,7 +71,18 @@ class CommandScrub : public Command {
                            const std::string &file_name) const;
   std::string MakeRelativePath(const std::string &full_path);
 
+  bool QueueSmallObject(const std::string &full_path,
+                        const shash::Any &hash_from_name);
+  void HashSmallObjects();
+
   ScrubbingPipeline             pipeline_scrubbing_;
+  /**
+   * Small BLAKE3 objects bypass the pipeline; they are read in the traversal
+   * thread and hashed together by shash::HashMemMulti()
+   */
+  std::vector<std::string>      small_paths_;
+  std::vector<std::string>      small_contents_;
+  std::vector<shash::Any>       small_hashes_;
   std::string                   repo_path_;
   bool                          machine_readable_output_;
 
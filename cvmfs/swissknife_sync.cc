@@ -133,6 +133,11 @@ int swissknife::CommandCreate::Main(const swissknife::ArgumentList &args) {
   if (args.find('V') != args.end()) {
     voms_authz = *args.find('V')->second;
   }
+  zlib::Algorithms compression_alg = zlib::kZlibDefault;
+  if (args.find('Z') != args.end()) {
+    compression_alg =
+      zlib::ParseCompressionAlgorithm(*args.find('Z')->second);
+  }
 
   const upload::SpoolerDefinition sd(spooler_definition, hash_algorithm,
                                      zlib::kZlibDefault);
@@ -172,6 +177,16 @@ int swissknife::CommandCreate::Main(const swissknife::ArgumentList &args) {
   const bool needs_bootstrap_shortcuts = !voms_authz.empty();
   manifest->set_garbage_collectability(garbage_collectable);
   manifest->set_has_alt_catalog_path(needs_bootstrap_shortcuts);
+  // Clients that do not know the 'V' field skip it, so the requirement only
+  // protects repositories that never had objects readable by older clients
+  const std::string min_client_version =
+    zlib::MinClientVersion(compression_alg);
+  if (!min_client_version.empty())
+    manifest->RequireClientVersion(min_client_version);
+  const std::string min_client_version_hash =
+    shash::MinClientVersion(hash_algorithm);
+  if (!min_client_version_hash.empty())
+    manifest->RequireClientVersion(min_client_version_hash);
 
   if (!manifest->Export(manifest_path)) {
     PrintError("Failed to create new repository");
@@ -612,6 +627,7 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
   if (args.find('k') != args.end()) params.include_xattrs = true;
   if (args.find('Y') != args.end()) params.external_data = true;
   if (args.find('W') != args.end()) params.direct_io = true;
+  if (args.find('2') != args.end()) params.async_read = true;
   if (args.find('S') != args.end()) {
     bool retval = catalog::VirtualCatalog::ParseActions(
         *args.find('S')->second, &params.virtual_dir_actions);
@@ -643,6 +659,14 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
       return 2;
     }
   }
+  if (args.find('G') != args.end()) {
+    if (!ParseChunkDetectorAlgorithm(*args.find('G')->second,
+                                     &params.chunk_detector_algorithm))
+    {
+      PrintError("unknown file chunking algorithm");
+      return 2;
+    }
+  }
   if (args.find('O') != args.end()) {
     params.generate_legacy_bulk_chunks = true;
   }
@@ -657,6 +681,8 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
   if (args.find('Z') != args.end()) {
     params.compression_alg =
         zlib::ParseCompressionAlgorithm(*args.find('Z')->second);
+    params.compression_level =
+        zlib::ParseCompressionLevel(*args.find('Z')->second);
   }
 
   if (args.find('C') != args.end()) {
@@ -664,6 +690,7 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
   }
 
   if (args.find('E') != args.end()) params.enforce_limits = true;
+  if (args.find('j') != args.end()) params.path_filters = true;
   if (args.find('Q') != args.end()) {
     params.nested_kcatalog_limit = String2Uint64(*args.find('Q')->second);
   } else {
@@ -699,6 +726,10 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
     params.num_upload_tasks = String2Uint64(*args.find('0')->second);
   }
 
+  if (args.find('1') != args.end()) {
+    params.content_index_path = *args.find('1')->second;
+  }
+
   if (args.find('T') != args.end()) {
     params.ttl_seconds = String2Uint64(*args.find('T')->second);
   }
@@ -741,7 +772,11 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
     spooler_definition.number_of_concurrent_uploads =
         params.max_concurrent_write_jobs;
   }
+  spooler_definition.compression_level = params.compression_level;
   spooler_definition.num_upload_tasks = params.num_upload_tasks;
+  spooler_definition.chunk_detector_algorithm = params.chunk_detector_algorithm;
+  spooler_definition.content_index_path = params.content_index_path;
+  spooler_definition.async_read = params.async_read;
 
   upload::SpoolerDefinition spooler_definition_catalogs(
       spooler_definition.Dup2DefaultCompression());
@@ -800,6 +835,7 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
       download_manager(), params.enforce_limits, params.nested_kcatalog_limit,
       params.root_kcatalog_limit, params.file_mbyte_limit, statistics(),
       params.is_balanced, params.max_weight, params.min_weight);
+  catalog_manager.SetPathFilters(params.path_filters);
   catalog_manager.Init();
 
   publish::SyncMediator mediator(&catalog_manager, &params, publish_statistics);
@@ -42,17 +42,22 @@ struct SyncParameters {
         ignore_special_files(false),
         branched_catalog(false),
         compression_alg(zlib::kZlibDefault),
+        compression_level(0),
         enforce_limits(false),
+        path_filters(false),
         nested_kcatalog_limit(0),
         root_kcatalog_limit(0),
         file_mbyte_limit(0),
         min_file_chunk_size(kDefaultMinFileChunkSize),
         avg_file_chunk_size(kDefaultAvgFileChunkSize),
         max_file_chunk_size(kDefaultMaxFileChunkSize),
+        chunk_detector_algorithm(kChunkDetectorXor32),
         manual_revision(0),
         ttl_seconds(0),
         max_concurrent_write_jobs(0),
         num_upload_tasks(1),
+        content_index_path(),
+        async_read(false),
         is_balanced(false),
         max_weight(kDefaultMaxWeight),
         min_weight(kDefaultMinWeight),
@@ -92,17 +97,22 @@ struct SyncParameters {
   bool ignore_special_files;
   bool branched_catalog;
   zlib::Algorithms compression_alg;
+  int compression_level;
   bool enforce_limits;
+  bool path_filters;
   unsigned nested_kcatalog_limit;
   unsigned root_kcatalog_limit;
   unsigned file_mbyte_limit;
   size_t min_file_chunk_size;
   size_t avg_file_chunk_size;
   size_t max_file_chunk_size;
+  ChunkDetectorAlgorithms chunk_detector_algorithm;
   uint64_t manual_revision;
   uint64_t ttl_seconds;
   uint64_t max_concurrent_write_jobs;
   unsigned num_upload_tasks;
+  std::string content_index_path;
+  bool async_read;
   bool is_balanced;
   unsigned max_weight;
   unsigned min_weight;
@@ -145,6 +155,9 @@ class CommandCreate : public Command {
     r.push_back(Parameter::Optional('V',
                                     "VOMS authz requirement "
                                     "(default: none)"));
+    r.push_back(Parameter::Optional('Z', "compression algorithm that the "
+                                    "repository is going to use "
+                                    "(default: zlib)"));
     return r;
   }
   int Main(const ArgumentList &args);
@@ -264,9 +277,13 @@ class CommandSync : public Command {
     r.push_back(Parameter::Optional('e', "hash algorithm (default: SHA-1)"));
     r.push_back(Parameter::Optional('f', "union filesystem type"));
     r.push_back(Parameter::Optional('h', "maximal file chunk size in bytes"));
+    r.push_back(Parameter::Optional('G',
+                                    "file chunking algorithm "
+                                    "[xor32, fastcdc] (default: xor32)"));
     r.push_back(Parameter::Optional('l', "minimal file chunk size in bytes"));
     r.push_back(Parameter::Optional('q', "number of concurrent write jobs"));
     r.push_back(Parameter::Optional('0', "number of upload tasks"));
+    r.push_back(Parameter::Optional('1', "content index file"));
     r.push_back(Parameter::Optional('v', "manual revision number"));
     r.push_back(Parameter::Optional('z', "log level (0-4, default: 2)"));
     r.push_back(Parameter::Optional('C', "trusted certificates"));
@@ -309,8 +326,10 @@ class CommandSync : public Command {
                                   "authenticated repos"));
     r.push_back(Parameter::Switch('Y', "enable external data"));
     r.push_back(Parameter::Switch('W', "set direct I/O for regular files"));
+    r.push_back(Parameter::Switch('2', "read files asynchronously"));
     r.push_back(Parameter::Switch('B', "branched catalog (no manifest)"));
     r.push_back(Parameter::Switch('I', "upload updated statistics DB file"));
+    r.push_back(Parameter::Switch('j', "store path filters in catalogs"));
 
     r.push_back(Parameter::Optional('P', "session_token_file"));
     r.push_back(Parameter::Optional('H', "key file for HTTP API"));
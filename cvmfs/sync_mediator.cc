@@ -19,6 +19,7 @@
 #include "crypto/hash.h"
 #include "directory_entry.h"
 #include "json_document.h"
+#include "manifest.h"
 #include "publish/repository.h"
 #include "sync_union.h"
 #include "upload.h"
@@ -294,6 +295,32 @@ void SyncMediator::LeaveDirectory(SharedPtr<SyncItem> entry)
 bool SyncMediator::Commit(manifest::Manifest *manifest) {
   reporter_->CommitReport();
 
+  // Older clients would serve objects compressed with a newer algorithm as
+  // file contents.  Only repositories created for newer clients may use them.
+  const std::string min_client_version =
+    zlib::MinClientVersion(params_->compression_alg);
+  if (!min_client_version.empty() &&
+      !manifest->RequiresClientVersion(min_client_version))
+  {
+    LogCvmfs(kLogPublish, kLogStderr,
+             "compression algorithm %s can only be used by repositories that "
+             "were created with it",
+             zlib::AlgorithmName(params_->compression_alg).c_str());
+    return false;
+  }
+  // Same for content hashed with a newer algorithm, which older clients
+  // cannot verify
+  const shash::Algorithms hash_alg = params_->spooler->GetHashAlgorithm();
+  const std::string min_client_version_hash = shash::MinClientVersion(hash_alg);
+  if (!min_client_version_hash.empty() &&
+      !manifest->RequiresClientVersion(min_client_version_hash))
+  {
+    LogCvmfs(kLogPublish, kLogStderr,
+             "hash algorithm %s can only be used by repositories that "
+             "were created with it", shash::kAlgorithmIds[hash_alg] + 1);
+    return false;
+  }
+
   if (!params_->dry_run) {
     LogCvmfs(kLogPublish, kLogStdout,
              "Waiting for upload of files before committing...");
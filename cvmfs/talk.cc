@@ -637,6 +637,9 @@ void *TalkManager::MainResponder(void *data) {
       result += "Read\n" + file_system->hist_fs_read()->ToString();
       result += "Release\n" + file_system->hist_fs_release()->ToString();
 
+      result += "\nLatency distribution of cache misses (microseconds):\n" +
+                mount_point->statistics()->PrintHistograms();
+
       result += "\nRaw Counters:\n" +
         mount_point->statistics()->PrintList(perf::Statistics::kPrintHeader);
 
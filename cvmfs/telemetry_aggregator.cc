@@ -103,6 +103,7 @@ void *TelemetryAggregator::MainTelemetry(void *data) {
     if (retval == 0) {
       statistics->SnapshotCounters(&telemetry->counters_,
                                    &telemetry->timestamp_);
+      statistics->SnapshotGauges(&telemetry->gauges_);
       telemetry->PushMetrics();
       continue;
     }
@@ -43,6 +43,7 @@ class TelemetryAggregator : SingleCopy {
   FRIEND_TEST(T_TelemetryAggregator, FailCreate);
   FRIEND_TEST(T_TelemetryAggregator, ExtraFields_Tags);
   FRIEND_TEST(T_TelemetryAggregator, UpdateCounters_WithExtraFields_Tags);
+  FRIEND_TEST(T_TelemetryAggregator, Gauges);
 
  public:
   /**
@@ -76,6 +77,11 @@ class TelemetryAggregator : SingleCopy {
 
   uint64_t timestamp_;
   std::map<std::string, int64_t> counters_;
+  /**
+   * Point-in-time values, e.g. latency percentiles, that must not be
+   * aggregated as deltas
+   */
+  std::map<std::string, int64_t> gauges_;
 
   /**
    * Main loop executed by the telemetry thread.
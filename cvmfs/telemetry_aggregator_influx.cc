@@ -99,7 +99,8 @@ TelemetryAggregatorInflux::~TelemetryAggregatorInflux() {
 
 /**
  * Creates a string in the influx data format containing the absolute values
- * of the counters. Counters are only included if their absolute value is > 0.
+ * of the counters and the gauges. Counters and gauges are only included if
+ * their absolute value is > 0.
  * 
  * Influx dataformat
  * ( https://docs.influxdata.com/influxdb/cloud/reference/syntax/line-protocol/ )
@@ -130,6 +131,16 @@ std::string TelemetryAggregatorInflux::MakePayload() {
       add_token = true;
     }
   }
+  for (std::map<std::string, int64_t>::iterator it
+      = gauges_.begin(), iEnd = gauges_.end(); it != iEnd; it++) {
+    if (it->second != 0) {
+      if (add_token) {
+        ret += ",";
+      }
+      ret += it->first + "=" + StringifyInt(it->second);
+      add_token = true;
+    }
+  }
   if (influx_extra_fields_ != "") {
     if (add_token) {
       ret += ",";
@@ -153,7 +164,7 @@ std::string TelemetryAggregatorInflux::MakePayload() {
  * absolute value is > 0 (delta can be 0).
  * 
  * NOTE: As influx_extra_fields_ are static, they are excluded of this 
- *       delta format
+ *       delta format, as are the gauges
  * 
  * Influx dataformat
  * ( https://docs.influxdata.com/influxdb/cloud/reference/syntax/line-protocol/ )
@@ -27,6 +27,7 @@ class TelemetryAggregatorInflux : TelemetryAggregator {
   FRIEND_TEST(T_TelemetryAggregator, FailCreate);
   FRIEND_TEST(T_TelemetryAggregator, ExtraFields_Tags);
   FRIEND_TEST(T_TelemetryAggregator, UpdateCounters_WithExtraFields_Tags);
+  FRIEND_TEST(T_TelemetryAggregator, Gauges);
 
  public:
   TelemetryAggregatorInflux(Statistics* statistics,
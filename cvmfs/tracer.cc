@@ -5,22 +5,30 @@
 #include "cvmfs_config.h"
 #include "tracer.h"
 
+#include <inttypes.h>
+#include <poll.h>
 #include <pthread.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <string>
+#include <vector>
 
 #include "util/atomic.h"
 #include "util/concurrency.h"
+#include "util/platform.h"
 #include "util/posix.h"
+#include "util/smalloc.h"
 #include "util/string.h"
 
 using namespace std;  // NOLINT
 
+const char Tracer::kBinaryMagic[8] = {'C', 'V', 'M', 'F', 'S', 'T', 'R', 'C'};
+
 
 void Tracer::Activate(
   const int buffer_size,
@@ -104,6 +112,10 @@ int32_t Tracer::DoTrace(
 
 
 void Tracer::Flush() {
+  if (binary_) {
+    DrainBinary();
+    return;
+  }
   if (!active_) return;
 
   int32_t save_seq_no = DoTrace(kEventFlush, PathString("Tracer", 6),
@@ -209,7 +221,167 @@ void *Tracer::MainFlush(void *data) {
 }
 
 
+/**
+ * Switches to binary mode.  The per-thread ring buffers are rounded up to a
+ * power of 2.  The trace file is opened for appending, a new header marks the
+ * beginning of this session.
+ */
+void Tracer::ActivateBinary(
+  const unsigned records_per_thread,
+  const string &trace_file)
+{
+  assert(!active_ && !binary_);
+  assert(records_per_thread > 0);
+  trace_file_ = trace_file;
+  binary_capacity_ = 1;
+  while (binary_capacity_ < records_per_thread)
+    binary_capacity_ *= 2;
+
+  binary_file_ = fopen(trace_file_.c_str(), "a");
+  assert(binary_file_ != NULL && "Could not open trace file");
+  BinaryHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kBinaryMagic, sizeof(header.magic));
+  header.version = kBinaryVersion;
+  header.record_size = sizeof(BinaryRecord);
+  header.monotonic_ns = platform_monotonic_time_ns();
+  header.realtime_ns = platform_realtime_ns();
+  size_t written = fwrite(&header, sizeof(header), 1, binary_file_);
+  assert(written == 1);
+
+  int retval = pthread_key_create(&thread_buffer_key_, ThreadBufferDestructor);
+  assert(retval == 0);
+  retval = pthread_mutex_init(&lock_binary_, NULL);
+  assert(retval == 0);
+
+  binary_ = true;
+}
+
+
+void Tracer::ThreadBufferDestructor(void *data) {
+  ThreadBuffer *buffer = reinterpret_cast<ThreadBuffer *>(data);
+  atomic_write32(&buffer->orphaned, 1);
+}
+
+
+Tracer::ThreadBuffer *Tracer::GetThreadBuffer() {
+  ThreadBuffer *buffer = reinterpret_cast<ThreadBuffer *>(
+    pthread_getspecific(thread_buffer_key_));
+  if (buffer != NULL)
+    return buffer;
+
+  buffer = new ThreadBuffer();
+  buffer->records = reinterpret_cast<BinaryRecord *>(
+    smalloc(binary_capacity_ * sizeof(BinaryRecord)));
+  atomic_init64(&buffer->head);
+  atomic_init64(&buffer->tail);
+  atomic_init32(&buffer->orphaned);
+  buffer->thread_id = platform_thread_id();
+  int retval = pthread_setspecific(thread_buffer_key_, buffer);
+  assert(retval == 0);
+
+  MutexLockGuard m(&lock_binary_);
+  thread_buffers_.push_back(buffer);
+  return buffer;
+}
+
+
+/**
+ * Lock-free except for the first call of a thread, which registers the
+ * thread's ring buffer.
+ */
+void Tracer::DoTraceBinary(
+  const int event,
+  const uint64_t inode,
+  const uint64_t start_ns,
+  const int result)
+{
+  const uint64_t now = platform_monotonic_time_ns();
+  ThreadBuffer *buffer = GetThreadBuffer();
+  // Only this thread modifies head
+  const int64_t head = buffer->head;
+  if (head - atomic_read64(&buffer->tail) >= binary_capacity_) {
+    atomic_inc64(&n_dropped_);
+    return;
+  }
+  BinaryRecord *record = &buffer->records[head & (binary_capacity_ - 1)];
+  record->timestamp_ns = start_ns;
+  record->inode = inode;
+  record->duration_ns = now - start_ns;
+  record->thread_id = buffer->thread_id;
+  record->event = event;
+  record->result = result;
+  record->reserved = 0;
+  // Publishes the record, atomic operations are full barriers
+  atomic_inc64(&buffer->head);
+}
+
+
+/**
+ * Writes out the records of all threads and frees the buffers of threads that
+ * have exited.  Called by the flush thread and by Flush().
+ */
+void Tracer::DrainBinary() {
+  MutexLockGuard m(&lock_binary_);
+  vector<ThreadBuffer *> alive;
+  for (unsigned i = 0; i < thread_buffers_.size(); ++i) {
+    ThreadBuffer *buffer = thread_buffers_[i];
+    // Read before head so that no records are written after an orphaned
+    // buffer is drained for the last time
+    const bool orphaned = atomic_read32(&buffer->orphaned);
+    const int64_t head = atomic_read64(&buffer->head);
+    int64_t tail = atomic_read64(&buffer->tail);
+    while (tail < head) {
+      const unsigned pos = tail & (binary_capacity_ - 1);
+      const unsigned n =
+        std::min(static_cast<int64_t>(binary_capacity_ - pos), head - tail);
+      size_t written =
+        fwrite(&buffer->records[pos], sizeof(BinaryRecord), n, binary_file_);
+      assert(written == n);
+      tail += n;
+    }
+    atomic_write64(&buffer->tail, tail);
+
+    if (orphaned) {
+      free(buffer->records);
+      delete buffer;
+    } else {
+      alive.push_back(buffer);
+    }
+  }
+  thread_buffers_.swap(alive);
+  int retval = fflush(binary_file_);
+  assert(retval == 0);
+}
+
+
+void *Tracer::MainFlushBinary(void *data) {
+  Tracer *tracer = reinterpret_cast<Tracer *>(data);
+  struct pollfd watch_term;
+  watch_term.fd = tracer->pipe_terminate_[0];
+  watch_term.events = POLLIN | POLLPRI;
+  while (true) {
+    watch_term.revents = 0;
+    int retval = poll(&watch_term, 1, kBinaryFlushIntervalMs);
+    if ((retval < 0) && (errno == EINTR))
+      continue;
+    assert(retval >= 0);
+    tracer->DrainBinary();
+    if (retval > 0)
+      break;
+  }
+  return NULL;
+}
+
+
 void Tracer::Spawn() {
+  if (binary_) {
+    MakePipe(pipe_terminate_);
+    int retval = pthread_create(&thread_flush_, NULL, MainFlushBinary, this);
+    assert(retval == 0);
+    spawned_ = true;
+    return;
+  }
   if (active_) {
     int retval = pthread_create(&thread_flush_, NULL, MainFlush, this);
     assert(retval == 0);
@@ -227,7 +399,12 @@ Tracer::Tracer()
   , flush_threshold_(0)
   , ring_buffer_(NULL)
   , commit_buffer_(NULL)
+  , binary_(false)
+  , binary_capacity_(0)
+  , binary_file_(NULL)
 {
+  pipe_terminate_[0] = pipe_terminate_[1] = -1;
+  atomic_init64(&n_dropped_);
   memset(&thread_flush_, 0, sizeof(thread_flush_));
   atomic_init32(&seq_no_);
   atomic_init32(&flushed_);
@@ -237,6 +414,27 @@ Tracer::Tracer()
 
 
 Tracer::~Tracer() {
+  if (binary_) {
+    if (spawned_) {
+      char c = 'T';
+      WritePipe(pipe_terminate_[1], &c, 1);
+      int retval = pthread_join(thread_flush_, NULL);
+      assert(retval == 0);
+      ClosePipe(pipe_terminate_);
+    }
+    // Threads that are still running keep their buffers registered; the
+    // buffers are released here
+    pthread_key_delete(thread_buffer_key_);
+    DrainBinary();
+    for (unsigned i = 0; i < thread_buffers_.size(); ++i) {
+      free(thread_buffers_[i]->records);
+      delete thread_buffers_[i];
+    }
+    fclose(binary_file_);
+    pthread_mutex_destroy(&lock_binary_);
+    return;
+  }
+
   if (!active_)
     return;
   int retval;
@@ -266,6 +464,84 @@ Tracer::~Tracer() {
 }
 
 
+const char *Tracer::GetEventName(const int event) {
+  switch (event) {
+    case kEventOpen: return "open";
+    case kEventOpenDir: return "opendir";
+    case kEventReadlink: return "readlink";
+    case kEventLookup: return "lookup";
+    case kEventStatFs: return "statfs";
+    case kEventGetAttr: return "getattr";
+    case kEventListAttr: return "listxattr";
+    case kEventGetXAttr: return "getxattr";
+    default: return "unknown";
+  }
+}
+
+
+/**
+ * Converts a binary trace file into csv or into Chrome's trace event format
+ * (JSON).  Records are written in file order, which is chronological per
+ * thread only.  Timestamps are converted to wall clock time using the header
+ * of the session.  Returns false if the file is not a valid binary trace.
+ */
+bool Tracer::ConvertBinary(FILE *src, FILE *dst, const ConvertFormat format) {
+  assert(sizeof(BinaryHeader) == sizeof(BinaryRecord));
+  if (format == kConvertChrome)
+    fprintf(dst, "{\"traceEvents\":[");
+  else
+    fprintf(dst, "timestamp,event,inode,duration_ns,thread_id,result\n");
+
+  bool has_header = false;
+  bool first_event = true;
+  int64_t offset_ns = 0;
+  BinaryRecord record;
+  while (fread(&record, sizeof(record), 1, src) == 1) {
+    if (memcmp(&record, kBinaryMagic, sizeof(kBinaryMagic)) == 0) {
+      BinaryHeader header;
+      memcpy(&header, &record, sizeof(header));
+      if ((header.version != kBinaryVersion) ||
+          (header.record_size != sizeof(BinaryRecord)))
+      {
+        return false;
+      }
+      offset_ns = static_cast<int64_t>(header.realtime_ns) -
+                  static_cast<int64_t>(header.monotonic_ns);
+      has_header = true;
+      continue;
+    }
+    if (!has_header)
+      return false;
+
+    const uint64_t timestamp_ns = record.timestamp_ns + offset_ns;
+    if (format == kConvertChrome) {
+      // Chrome expects microseconds
+      fprintf(dst, "%s\n{\"name\":\"%s\",\"cat\":\"cvmfs\",\"ph\":\"X\","
+              "\"ts\":%" PRIu64 ".%03u,\"dur\":%" PRIu64 ".%03u,"
+              "\"pid\":0,\"tid\":%u,"
+              "\"args\":{\"inode\":%" PRIu64 ",\"result\":%d}}",
+              first_event ? "" : ",", GetEventName(record.event),
+              timestamp_ns / 1000, unsigned(timestamp_ns % 1000),
+              record.duration_ns / 1000, unsigned(record.duration_ns % 1000),
+              record.thread_id, record.inode, record.result);
+    } else {
+      fprintf(dst, "%" PRIu64 ".%09u,%s,%" PRIu64 ",%" PRIu64 ",%u,%d\n",
+              timestamp_ns / 1000000000,
+              unsigned(timestamp_ns % 1000000000),
+              GetEventName(record.event), record.inode, record.duration_ns,
+              record.thread_id, record.result);
+    }
+    first_event = false;
+  }
+  if (ferror(src))
+    return false;
+
+  if (format == kConvertChrome)
+    fprintf(dst, "\n]}\n");
+  return true;
+}
+
+
 int Tracer::WriteCsvFile(FILE *fp, const string &field) {
   if (fp == NULL)
     return 0;
@@ -289,3 +565,15 @@ int Tracer::WriteCsvFile(FILE *fp, const string &field) {
 
   return 0;
 }
+
+
+//------------------------------------------------------------------------------
+
+
+TraceGuard::TraceGuard(Tracer *tracer, const int event, const uint64_t inode)
+  : tracer_(tracer->IsBinary() ? tracer : NULL)
+  , event_(event)
+  , inode_(inode)
+  , start_ns_((tracer_ != NULL) ? platform_monotonic_time_ns() : 0)
+  , result_(0)
+{ }
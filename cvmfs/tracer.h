@@ -11,6 +11,7 @@
 
 #include <cstdio>
 #include <string>
+#include <vector>
 
 #include "shortstring.h"
 #include "util/atomic.h"
@@ -29,6 +30,14 @@
  *
  * Csv output is adapted from libcsv.
  *
+ * In binary mode (ActivateBinary()), the tracer instead writes fixed-size
+ * records of inode, event, timestamp, duration and result.  Every thread
+ * appends to its own ring buffer, which the flush thread drains periodically.
+ * Tracing then neither allocates nor takes a lock.  If a ring buffer is full,
+ * records are dropped rather than blocking the file system call.  The
+ * cvmfs_trace utility converts binary traces to csv or to the Chrome trace
+ * event format.
+ *
  * \todo If anything goes wrong, the whole thing breaks down on assertion.  This
  * might be not desired behavior.
  */
@@ -45,13 +54,67 @@ class Tracer : SingleCopy {
     kEventGetXAttr
   };
 
+  enum ConvertFormat {
+    kConvertCsv = 0,
+    kConvertChrome
+  };
+
+  /**
+   * A single event in the binary trace file.  All fields are in host byte
+   * order.
+   */
+  struct BinaryRecord {
+    uint64_t timestamp_ns;  ///< CLOCK_MONOTONIC at the start of the event
+    uint64_t inode;
+    uint64_t duration_ns;
+    uint32_t thread_id;
+    int32_t event;
+    int32_t result;  ///< 0 or the negative errno returned to the kernel
+    uint32_t reserved;
+  };
+
+  /**
+   * Starts every session in the binary trace file.  Has the size of a record,
+   * so that sessions can be appended to an existing file.  The timestamps of
+   * the session are relative to monotonic_ns, which was taken at the wall
+   * clock time realtime_ns.
+   */
+  struct BinaryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t monotonic_ns;
+    uint64_t realtime_ns;
+    uint64_t reserved;
+  };
+
+  static const char kBinaryMagic[8];
+  static const uint32_t kBinaryVersion = 1;
+  /**
+   * The flush thread drains the per-thread ring buffers at this interval
+   */
+  static const unsigned kBinaryFlushIntervalMs = 250;
+
   Tracer();
   ~Tracer();
 
   void Activate(const int buffer_size, const int flush_threshold,
                 const std::string &trace_file);
+  void ActivateBinary(const unsigned records_per_thread,
+                      const std::string &trace_file);
   void Spawn();
   void Flush();
+  /**
+   * Records an event that started at start_ns (platform_monotonic_time_ns())
+   * and ends now.
+   */
+  void inline __attribute__((used)) TraceBinary(const int event,
+                                                const uint64_t inode,
+                                                const uint64_t start_ns,
+                                                const int result)
+  {
+    if (binary_) DoTraceBinary(event, inode, start_ns, result);
+  }
   void inline __attribute__((used)) Trace(const int event,
                                           const PathString &path,
                                           const std::string &msg)
@@ -63,6 +126,15 @@ class Tracer : SingleCopy {
     return active_;
   }
 
+  bool inline __attribute__((used)) IsBinary() {
+    return binary_;
+  }
+
+  int64_t GetNumDropped() { return atomic_read64(&n_dropped_); }
+
+  static const char *GetEventName(const int event);
+  static bool ConvertBinary(FILE *src, FILE *dst, const ConvertFormat format);
+
  private:
   /**
    * Code of the first log line in the trace file.
@@ -93,7 +165,30 @@ class Tracer : SingleCopy {
     std::string msg;
   };
 
+  /**
+   * Single producer (the owning thread), single consumer (the flush thread)
+   * ring buffer of binary records.  head and tail count records; the buffer
+   * is full if head - tail equals the capacity.
+   */
+  struct ThreadBuffer {
+    BinaryRecord *records;
+    atomic_int64 head;
+    atomic_int64 tail;
+    uint32_t thread_id;
+    /**
+     * Set when the thread exits, the flush thread frees the buffer after it
+     * has been drained.
+     */
+    atomic_int32 orphaned;
+  };
+
   static void *MainFlush(void *data);
+  static void *MainFlushBinary(void *data);
+  static void ThreadBufferDestructor(void *data);
+  ThreadBuffer *GetThreadBuffer();
+  void DoTraceBinary(const int event, const uint64_t inode,
+                     const uint64_t start_ns, const int result);
+  void DrainBinary();
   void GetTimespecRel(const int64_t ms, timespec *ts);
   int WriteCsvFile(FILE *fp, const std::string &field);
   int32_t DoTrace(const int event,
@@ -129,6 +224,51 @@ class Tracer : SingleCopy {
   atomic_int32 flushed_;
   atomic_int32 terminate_flush_thread_;
   atomic_int32 flush_immediately_;
+
+  bool binary_;
+  /**
+   * Records per thread, a power of 2
+   */
+  unsigned binary_capacity_;
+  pthread_key_t thread_buffer_key_;
+  /**
+   * Protects thread_buffers_ and the binary trace file
+   */
+  pthread_mutex_t lock_binary_;
+  std::vector<ThreadBuffer *> thread_buffers_;
+  FILE *binary_file_;
+  /**
+   * Wakes up the binary flush thread for termination
+   */
+  int pipe_terminate_[2];
+  atomic_int64 n_dropped_;
+};
+
+
+/**
+ * Traces a fuse callback in binary mode on destruction.  Does nothing unless
+ * the tracer is in binary mode.
+ */
+class TraceGuard : SingleCopy {
+ public:
+  TraceGuard(Tracer *tracer, const int event, const uint64_t inode);
+  ~TraceGuard() {
+    if (tracer_ != NULL)
+      tracer_->TraceBinary(event_, inode_, start_ns_, result_);
+  }
+
+  void set_inode(const uint64_t inode) { inode_ = inode; }
+  /**
+   * Records the error code and returns it, for use in fuse_reply_err() calls
+   */
+  int Errno(const int err) { result_ = -err; return err; }
+
+ private:
+  Tracer *tracer_;
+  int event_;
+  uint64_t inode_;
+  uint64_t start_ns_;
+  int result_;
 };
 
 #endif  // CVMFS_TRACER_H_
@@ -4,6 +4,8 @@
 
 #include "upload_gateway.h"
 
+#include <alloca.h>
+
 #include <cassert>
 #include <limits>
 #include <vector>
@@ -145,8 +147,8 @@ void GatewayUploader::DoUpload(const std::string& remote_path,
     return;
   }
 
-  unsigned char hash_ctx[shash::kMaxContextSize];
-  shash::ContextPtr hash_ctx_ptr(spooler_definition().hash_algorithm, hash_ctx);
+  shash::ContextPtr hash_ctx_ptr(spooler_definition().hash_algorithm);
+  hash_ctx_ptr.buffer = alloca(hash_ctx_ptr.size);
   shash::Init(hash_ctx_ptr);
   std::vector<char> buf(1024);
   ssize_t read_bytes = 0;
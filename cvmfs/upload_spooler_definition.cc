@@ -28,15 +28,19 @@ SpoolerDefinition::SpoolerDefinition(
     : driver_type(Unknown),
       hash_algorithm(hash_algorithm),
       compression_alg(compression_algorithm),
+      compression_level(0),
       generate_legacy_bulk_chunks(generate_legacy_bulk_chunks),
       use_file_chunking(use_file_chunking),
       min_file_chunk_size(min_file_chunk_size),
       avg_file_chunk_size(avg_file_chunk_size),
       max_file_chunk_size(max_file_chunk_size),
+      chunk_detector_algorithm(kChunkDetectorXor32),
       number_of_concurrent_uploads(kDefaultMaxConcurrentUploads),
       num_upload_tasks(kDefaultNumUploadTasks),
       session_token_file(session_token_file),
       key_file(key_file),
+      content_index_path(""),
+      async_read(false),
       valid_(false) {
   // check if given file chunking values are sane
   if (use_file_chunking && (min_file_chunk_size >= avg_file_chunk_size ||
@@ -77,6 +81,8 @@ SpoolerDefinition::SpoolerDefinition(
 SpoolerDefinition SpoolerDefinition::Dup2DefaultCompression() const {
   SpoolerDefinition result(*this);
   result.compression_alg = zlib::kZlibDefault;
+  // The content index is tied to the pipeline settings of the data spooler
+  result.content_index_path = "";
   return result;
 }
 
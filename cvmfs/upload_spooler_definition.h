@@ -9,6 +9,7 @@
 
 #include "compression.h"
 #include "crypto/hash.h"
+#include "ingestion/chunk_detector.h"
 
 namespace upload {
 
@@ -66,6 +67,11 @@ struct SpoolerDefinition {
 
   shash::Algorithms hash_algorithm;
   zlib::Algorithms compression_alg;
+  /**
+   * Level for the algorithms that have one, such as zstd.  Zero selects the
+   * default level of the algorithm.
+   */
+  int compression_level;
   /**
    * If a file is chunked, clients >= 2.1.7 do not need the bulk chunk.  We can
    * force creating the bulk chunks for backwards compatibility.
@@ -75,6 +81,10 @@ struct SpoolerDefinition {
   size_t min_file_chunk_size;
   size_t avg_file_chunk_size;
   size_t max_file_chunk_size;
+  /**
+   * Content-defined chunking algorithm used if use_file_chunking is set
+   */
+  ChunkDetectorAlgorithms chunk_detector_algorithm;
 
   /**
    * This is the number of concurrently open files to be uploaded. It does not,
@@ -92,6 +102,18 @@ struct SpoolerDefinition {
   std::string session_token_file;
   std::string key_file;
 
+  /**
+   * If set, the IngestionPipeline maintains a persistent index of the
+   * uncompressed file content and skips processing of unchanged files
+   */
+  std::string content_index_path;
+
+  /**
+   * If set, the IngestionPipeline reads regular files with several blocks in
+   * flight, using io_uring if available
+   */
+  bool async_read;
+
   bool valid_;
 };
 
@@ -108,22 +108,27 @@ std::vector<atomic_int32> UTLog2Histogram::GetBins(const Log2Histogram &h) {
 
 unsigned int Log2Histogram::GetQuantile(float n) {
   uint64_t total = this->N();
+  if (total == 0)
+    return 0;
   // pivot is the index of the element corresponding to the requested quantile
   uint64_t pivot = static_cast<uint64_t>(static_cast<float>(total) * n);
   float normalized_pivot = 0.0;
   // now we iterate through all the bins
   // note that we _exclude_ the overflow bin
   unsigned int i = 0;
-  for (i = 1; 1 <= this->bins_.size() - 1; i++) {
+  for (i = 1; i <= this->bins_.size() - 1; i++) {
     unsigned int bin_value =
       static_cast<unsigned int>(atomic_read32(&(this->bins_[i])));
-    if (pivot <= bin_value) {
+    if ((bin_value > 0) && (pivot <= bin_value)) {
       normalized_pivot =
         static_cast<float>(pivot) / static_cast<float>(bin_value);
       break;
     }
     pivot -= bin_value;
   }
+  // the quantile is in the overflow bin
+  if (i == this->bins_.size())
+    return this->boundary_values_[i - 1];
   // now i stores the index of the bin corresponding to the requested quantile
   // and normalized_pivot is the element we want inside the bin
   unsigned int min_value = this->boundary_values_[i - 1];
@@ -133,6 +138,14 @@ unsigned int Log2Histogram::GetQuantile(float n) {
     static_cast<float>(max_value - min_value) * normalized_pivot);
 }
 
+Log2Histogram Log2Histogram::Since(const Log2Histogram &earlier) const {
+  assert(this->bins_.size() == earlier.bins_.size());
+  Log2Histogram result(*this);
+  for (unsigned int i = 0; i < result.bins_.size(); i++)
+    result.bins_[i] -= earlier.bins_[i];
+  return result;
+}
+
 std::string Log2Histogram::ToString() {
   unsigned int i = 0;
 
@@ -174,6 +174,12 @@ friend class UTLog2Histogram;
    */
   unsigned int GetQuantile(float n);
 
+  /**
+   * Returns a histogram of the samples that were added after the earlier copy
+   * of this histogram was taken.
+   */
+  Log2Histogram Since(const Log2Histogram &earlier) const;
+
   std::string ToString();
 
   void PrintLog2Histogram();
@@ -5,11 +5,15 @@
 #include "cvmfs_config.h"
 #include "util/concurrency.h"
 
+#include <sched.h>
 #include <unistd.h>
 
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 
 #include "util/logging.h"
+#include "util/platform.h"
 
 #ifdef CVMFS_NAMESPACE_GUARD
 namespace CVMFS_NAMESPACE_GUARD {
@@ -68,6 +72,72 @@ bool Signal::IsSleeping() {
   return fired_ == false;
 }
 
+
+//------------------------------------------------------------------------------
+
+
+EpochLock::EpochLock() : slots_(NULL) {
+  void *mem;
+  int retval = posix_memalign(&mem, kCacheLine, kNumSlots * sizeof(Slot));
+  assert(retval == 0);
+  memset(mem, 0, kNumSlots * sizeof(Slot));
+  slots_ = reinterpret_cast<Slot *>(mem);
+  atomic_init32(&writer_);
+  retval = pthread_mutex_init(&writer_lock_, NULL);
+  assert(retval == 0);
+}
+
+
+EpochLock::~EpochLock() {
+  pthread_mutex_destroy(&writer_lock_);
+  free(slots_);
+}
+
+
+/**
+ * The increment of the reader slot is a full memory barrier, so either the
+ * reader sees the writer flag or the writer sees the reader in its slot.
+ * The writer flag is read with a plain load in order to keep the shared cache
+ * line in the readers' caches.
+ */
+unsigned EpochLock::ReadLock() {
+  const unsigned slot = platform_getcpu() % kNumSlots;
+  while (true) {
+    atomic_inc32(&slots_[slot].readers);
+    if (*const_cast<volatile atomic_int32 *>(&writer_) == 0)
+      return slot;
+    atomic_dec32(&slots_[slot].readers);
+    // Wait for the writer to finish
+    pthread_mutex_lock(&writer_lock_);
+    pthread_mutex_unlock(&writer_lock_);
+  }
+}
+
+
+void EpochLock::ReadUnlock(const unsigned slot) {
+  atomic_dec32(&slots_[slot].readers);
+}
+
+
+void EpochLock::WriteLock() {
+  pthread_mutex_lock(&writer_lock_);
+  bool retval = atomic_cas32(&writer_, 0, 1);
+  assert(retval);
+  // Grace period: readers of the previous epoch leave
+  for (unsigned i = 0; i < kNumSlots; ++i) {
+    while (atomic_read32(&slots_[i].readers) != 0)
+      sched_yield();
+  }
+}
+
+
+void EpochLock::WriteUnlock() {
+  bool retval = atomic_cas32(&writer_, 1, 0);
+  assert(retval);
+  pthread_mutex_unlock(&writer_lock_);
+}
+
+
 #ifdef CVMFS_NAMESPACE_GUARD
 }  // namespace CVMFS_NAMESPACE_GUARD
 #endif
@@ -343,6 +343,80 @@ class CVMFS_EXPORT Signal : SingleCopy {
 //
 
 
+/**
+ * A reader-writer lock for read-mostly data.  Readers announce themselves in
+ * one of several cache line sized slots selected by the current CPU, so that
+ * concurrent readers do not write to a shared cache line.  A writer closes
+ * the current epoch by raising the writer flag and then waits until all
+ * reader slots drained (the grace period) before it modifies or frees the
+ * protected data.  Readers that find the writer flag raised step back and
+ * block on the writer mutex until the writer is done.
+ *
+ * Taking the lock for writing is considerably more expensive than for a
+ * pthread rwlock.  The lock is not recursive.
+ */
+class CVMFS_EXPORT EpochLock : SingleCopy {
+ public:
+  EpochLock();
+  ~EpochLock();
+
+  /**
+   * Returns the reader slot that needs to be passed to ReadUnlock()
+   */
+  unsigned ReadLock();
+  void ReadUnlock(const unsigned slot);
+  void WriteLock();
+  void WriteUnlock();
+
+ private:
+  static const unsigned kNumSlots = 64;
+  static const unsigned kCacheLine = 64;
+  struct Slot {
+    atomic_int32 readers;
+    char padding[kCacheLine - sizeof(atomic_int32)];
+  };
+
+  /**
+   * kNumSlots cache line aligned reader counters
+   */
+  Slot *slots_;
+  /**
+   * Only modified while holding writer_lock_
+   */
+  atomic_int32 writer_;
+  pthread_mutex_t writer_lock_;
+};
+
+
+class EpochReadGuard : SingleCopy {
+ public:
+  explicit EpochReadGuard(EpochLock *lock)
+    : lock_(lock), slot_(lock->ReadLock()) { }
+  ~EpochReadGuard() { lock_->ReadUnlock(slot_); }
+
+ private:
+  EpochLock *lock_;
+  unsigned slot_;
+};
+
+
+class EpochWriteGuard : SingleCopy {
+ public:
+  explicit EpochWriteGuard(EpochLock *lock) : lock_(lock) {
+    lock_->WriteLock();
+  }
+  ~EpochWriteGuard() { lock_->WriteUnlock(); }
+
+ private:
+  EpochLock *lock_;
+};
+
+
+//
+// -----------------------------------------------------------------------------
+//
+
+
 /**
  * Asynchronous FIFO channel template
  * Implements a thread safe FIFO queue that handles thread blocking if the queue
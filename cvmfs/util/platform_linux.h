@@ -15,12 +15,15 @@
 #include <limits.h>
 #include <mntent.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
+#include <stdint.h>
 #include <sys/file.h>
 #include <sys/mount.h>
 #include <sys/prctl.h>
 #include <sys/select.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/utsname.h>
 #include <unistd.h>
 
@@ -162,6 +165,21 @@ inline void platform_spinlock_unlock(platform_spinlock *lock) {
  */
 inline pthread_t platform_gettid() { return pthread_self(); }
 
+/**
+ * The kernel's id of the calling thread, as shown by ps and top
+ */
+inline uint32_t platform_thread_id() {
+  return static_cast<uint32_t>(syscall(SYS_gettid));
+}
+
+/**
+ * The CPU the calling thread is running on; 0 if unknown
+ */
+inline unsigned platform_getcpu() {
+  const int cpu = sched_getcpu();
+  return (cpu < 0) ? 0 : cpu;
+}
+
 inline int platform_sigwait(const int signum) {
   sigset_t sigset;
   int retval = sigemptyset(&sigset);
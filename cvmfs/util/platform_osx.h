@@ -20,7 +20,9 @@
 #include <mach-o/dyld.h>
 #include <mach/mach.h>  // NOLINT
 #include <mach/mach_time.h>
+#include <pthread.h>
 #include <signal.h>
+#include <stdint.h>
 #include <sys/mount.h>
 #include <sys/param.h>
 #include <sys/stat.h>
@@ -129,6 +131,18 @@ inline void platform_spinlock_unlock(platform_spinlock *lock) {
  */
 inline thread_port_t platform_gettid() { return mach_thread_self(); }
 
+inline uint32_t platform_thread_id() {
+  return pthread_mach_thread_np(pthread_self());
+}
+
+/**
+ * There is no sched_getcpu() on macOS, spread the threads by their id instead
+ */
+inline unsigned platform_getcpu() {
+  const uintptr_t tid = reinterpret_cast<uintptr_t>(pthread_self());
+  return static_cast<unsigned>(tid >> 12);
+}
+
 inline int platform_sigwait(const int signum) {
   sigset_t sigset;
   int retval = sigemptyset(&sigset);
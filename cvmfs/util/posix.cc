@@ -45,6 +45,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <map>
 #include <set>
@@ -1493,6 +1494,35 @@ void GetLimitNoFile(unsigned *soft_limit, unsigned *hard_limit) {
 }
 
 
+/**
+ * Checks the effective capability set of the calling process, as shown in
+ * /proc/self/status.  Always false on platforms other than Linux.
+ */
+bool HasEffectiveCapability(const unsigned capability) {
+#ifdef __APPLE__
+  return false;
+#else
+  if (capability >= 64)
+    return false;
+  FILE *f = fopen("/proc/self/status", "r");
+  if (f == NULL)
+    return false;
+  std::string line;
+  bool result = false;
+  while (GetLineFile(f, &line)) {
+    if (!HasPrefix(line, "CapEff:", false))
+      continue;
+    const uint64_t cap_eff =
+      strtoull(Trim(line.substr(7)).c_str(), NULL, 16);
+    result = (cap_eff >> capability) & 1;
+    break;
+  }
+  fclose(f);
+  return result;
+#endif
+}
+
+
 std::vector<LsofEntry> Lsof(const std::string &path) {
   std::vector<LsofEntry> result;
 
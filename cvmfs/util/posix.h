@@ -155,6 +155,12 @@ CVMFS_EXPORT std::string GetArch();
 CVMFS_EXPORT int SetLimitNoFile(unsigned limit_nofile);
 CVMFS_EXPORT void GetLimitNoFile(unsigned *soft_limit, unsigned *hard_limit);
 
+/**
+ * Bit number of CAP_SYS_ADMIN in the capability sets of a Linux process
+ */
+const unsigned kCapSysAdmin = 21;
+CVMFS_EXPORT bool HasEffectiveCapability(const unsigned capability);
+
 /**
  * Searches for open file descriptors on the subtree starting at path.
  * For the time being works only on Linux, not on macOS.
@@ -9,6 +9,10 @@ if [ x"$(uname)" = x"Darwin" ]; then
   # On macOS, c-ares >= 1.16.1 uses libresolv for finding name servers
   LIBS="-lresolv"
 fi
+curl_nghttp2_config="--without-nghttp2"
+if [ x"$ENABLE_HTTP2" != x"" ]; then
+  curl_nghttp2_config="--with-nghttp2=$EXTERNALS_INSTALL_LOCATION"
+fi
 
 sh configure $FIX_COMP CPPFLAGS="$CPPFLAGS -D_FILE_OFFSET_BITS=64" \
   LDFLAGS="$LDFLAGS -rdynamic" \
@@ -73,7 +77,7 @@ sh configure $FIX_COMP CPPFLAGS="$CPPFLAGS -D_FILE_OFFSET_BITS=64" \
   --without-librtmp \
   --without-winidn \
   --without-libidn2 \
-  --without-nghttp2 \
+  ${curl_nghttp2_config} \
   --without-ngtcp2 \
   --without-nghttp3 \
   --without-quiche \
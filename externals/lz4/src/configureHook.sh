@@ -0,0 +1,3 @@
+#!/bin/sh
+
+# lz4 ships plain Makefiles, nothing to configure
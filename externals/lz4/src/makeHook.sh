@@ -0,0 +1,7 @@
+#!/bin/sh
+
+cd lib
+make clean
+make liblz4.a CFLAGS="$CVMFS_BASE_C_FLAGS -O3 -fPIC -fvisibility=hidden"
+strip -S liblz4.a
+make install PREFIX=$EXTERNALS_INSTALL_LOCATION BUILD_SHARED=no
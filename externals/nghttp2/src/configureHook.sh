@@ -0,0 +1,16 @@
+#!/bin/sh
+
+FIX_COMP=""
+if [ x"$(uname)" = x"Darwin" ]; then
+  FIX_COMP="CC=/usr/bin/clang CXX=/usr/bin/clang++"
+fi
+
+sh configure $FIX_COMP LDFLAGS="$LDFLAGS -rdynamic" \
+             CFLAGS="$CFLAGS $CVMFS_BASE_C_FLAGS -fPIC -fvisibility=hidden" \
+             --enable-lib-only \
+             --enable-shared=no \
+             --enable-static=yes \
+             --disable-python-bindings \
+             --without-systemd \
+             --without-jemalloc \
+             --prefix=$EXTERNALS_INSTALL_LOCATION
@@ -0,0 +1,3 @@
+#!/bin/sh
+
+# zstd ships plain Makefiles, nothing to configure
@@ -0,0 +1,9 @@
+#!/bin/sh
+
+cd lib
+make clean
+make libzstd.a \
+  CFLAGS="$CVMFS_BASE_C_FLAGS -O3 -fPIC -fvisibility=hidden" \
+  ZSTD_LEGACY_SUPPORT=0
+strip -S libzstd.a
+make install-static install-includes PREFIX=$EXTERNALS_INSTALL_LOCATION
@@ -588,6 +588,7 @@ systemctl daemon-reload
 %{_libdir}/libcvmfs_fuse_debug.so
 %{_libdir}/libcvmfs_fuse_debug.so.%{version}
 %{_bindir}/cvmfs_talk
+%{_bindir}/cvmfs_trace
 %{_bindir}/cvmfs_fsck
 %{_bindir}/cvmfs_config
 /usr/libexec/cvmfs/auto.cvmfs
@@ -0,0 +1,222 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cache.h"
+#include "cache.pb.h"
+#include "cache_extern.h"
+#include "cache_plugin/channel.h"
+#include "crypto/hash.h"
+#include "util/posix.h"
+#include "util/prng.h"
+
+using namespace std;  // NOLINT
+
+namespace {
+
+/**
+ * Minimal in-memory plugin that serves a fixed set of objects
+ */
+class BenchCachePlugin : public CachePlugin {
+ public:
+  explicit BenchCachePlugin(const string &socket_path)
+    : CachePlugin(cvmfs::CAP_REFCOUNT)
+  {
+    bool retval = Listen("unix=" + socket_path);
+    if (!retval) abort();
+    ProcessRequests(0);
+  }
+
+  void AddObject(const shash::Any &id, const string &content) {
+    objects_[id] = content;
+  }
+
+ protected:
+  virtual cvmfs::EnumStatus ChangeRefcount(const shash::Any &id,
+                                           int32_t change_by)
+  {
+    return (objects_.count(id) > 0) ? cvmfs::STATUS_OK
+                                    : cvmfs::STATUS_NOENTRY;
+  }
+  virtual cvmfs::EnumStatus GetObjectInfo(const shash::Any &id,
+                                          ObjectInfo *info)
+  {
+    map<shash::Any, string>::const_iterator iter = objects_.find(id);
+    if (iter == objects_.end())
+      return cvmfs::STATUS_NOENTRY;
+    info->size = iter->second.length();
+    return cvmfs::STATUS_OK;
+  }
+  virtual cvmfs::EnumStatus Pread(const shash::Any &id,
+                                  uint64_t offset,
+                                  uint32_t *size,
+                                  unsigned char *buffer)
+  {
+    map<shash::Any, string>::const_iterator iter = objects_.find(id);
+    if (iter == objects_.end())
+      return cvmfs::STATUS_NOENTRY;
+    if (offset > iter->second.length())
+      return cvmfs::STATUS_OUTOFBOUNDS;
+    *size = std::min(static_cast<uint64_t>(*size),
+                     iter->second.length() - offset);
+    memcpy(buffer, iter->second.data() + offset, *size);
+    return cvmfs::STATUS_OK;
+  }
+  virtual cvmfs::EnumStatus StartTxn(const shash::Any &id,
+                                     const uint64_t txn_id,
+                                     const ObjectInfo &info)
+  { return cvmfs::STATUS_NOSUPPORT; }
+  virtual cvmfs::EnumStatus WriteTxn(const uint64_t txn_id,
+                                     unsigned char *buffer,
+                                     uint32_t size)
+  { return cvmfs::STATUS_NOSUPPORT; }
+  virtual cvmfs::EnumStatus AbortTxn(const uint64_t txn_id) {
+    return cvmfs::STATUS_NOSUPPORT;
+  }
+  virtual cvmfs::EnumStatus CommitTxn(const uint64_t txn_id) {
+    return cvmfs::STATUS_NOSUPPORT;
+  }
+  virtual cvmfs::EnumStatus GetInfo(Info *info) {
+    return cvmfs::STATUS_NOSUPPORT;
+  }
+  virtual cvmfs::EnumStatus Shrink(uint64_t shrink_to, uint64_t *used_bytes) {
+    return cvmfs::STATUS_NOSUPPORT;
+  }
+  virtual cvmfs::EnumStatus ListingBegin(uint64_t lst_id,
+                                         cvmfs::EnumObjectType type)
+  { return cvmfs::STATUS_NOSUPPORT; }
+  virtual cvmfs::EnumStatus ListingNext(int64_t lst_id, ObjectInfo *item) {
+    return cvmfs::STATUS_NOSUPPORT;
+  }
+  virtual cvmfs::EnumStatus ListingEnd(int64_t lst_id) {
+    return cvmfs::STATUS_NOSUPPORT;
+  }
+  virtual cvmfs::EnumStatus LoadBreadcrumb(
+    const std::string &fqrn, manifest::Breadcrumb *breadcrumb)
+  { return cvmfs::STATUS_NOSUPPORT; }
+  virtual cvmfs::EnumStatus StoreBreadcrumb(
+    const std::string &fqrn, const manifest::Breadcrumb &breadcrumb)
+  { return cvmfs::STATUS_NOSUPPORT; }
+
+ private:
+  map<shash::Any, string> objects_;
+};
+
+}  // anonymous namespace
+
+
+/**
+ * Reads a batch of small blocks from different objects of an external cache
+ * plugin, either with one Pread() round trip per block, as done by protocol
+ * version 1, or with a single pipelined, vectored Preadv() call.
+ */
+class BM_ExternalCache : public benchmark::Fixture {
+ protected:
+  virtual void SetUp(const benchmark::State &st) {
+    socket_path_ = "cvmfs_ubench_cache.socket";
+    plugin_ = new BenchCachePlugin(socket_path_);
+    for (unsigned i = 0; i < kNumObjects; ++i) {
+      shash::Any id(shash::kSha1);
+      id.digest[0] = 1;
+      id.digest[1] = i;
+      plugin_->AddObject(id, string(kObjectSize, 'x'));
+      ids_.push_back(id);
+    }
+
+    int fd_client = ConnectSocket(socket_path_);
+    if (fd_client < 0) abort();
+    cache_mgr_ = ExternalCacheManager::Create(fd_client, kNumObjects, "bench");
+    if (cache_mgr_ == NULL) abort();
+    cache_mgr_->Spawn();
+    for (unsigned i = 0; i < kNumObjects; ++i) {
+      fds_.push_back(cache_mgr_->Open(CacheManager::Bless(ids_[i])));
+      if (fds_.back() < 0) abort();
+    }
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    for (unsigned i = 0; i < fds_.size(); ++i)
+      cache_mgr_->Close(fds_[i]);
+    fds_.clear();
+    ids_.clear();
+    delete cache_mgr_;
+    unlink(socket_path_.c_str());
+    delete plugin_;
+  }
+
+  void MakeRanges(unsigned block_size,
+                  char *buffer,
+                  vector<ExternalCacheManager::ReadRange> *ranges)
+  {
+    Prng prng;
+    prng.InitSeed(42);
+    ranges->clear();
+    for (unsigned i = 0; i < kNumReads; ++i) {
+      const int fd = fds_[prng.Next(kNumObjects)];
+      const uint64_t offset = prng.Next(kObjectSize / block_size) * block_size;
+      ranges->push_back(ExternalCacheManager::ReadRange(
+        fd, buffer + i * block_size, block_size, offset));
+    }
+  }
+
+  static const unsigned kNumObjects = 64;
+  static const uint64_t kObjectSize = 256 * 1024;
+  static const unsigned kNumReads = 64;
+
+  string socket_path_;
+  BenchCachePlugin *plugin_;
+  ExternalCacheManager *cache_mgr_;
+  vector<shash::Any> ids_;
+  vector<int> fds_;
+};
+
+
+// The argument is the block size
+BENCHMARK_DEFINE_F(BM_ExternalCache, PreadLoop)(benchmark::State &st) {
+  const unsigned block_size = st.range(0);
+  char *buffer = reinterpret_cast<char *>(malloc(kNumReads * block_size));
+  vector<ExternalCacheManager::ReadRange> ranges;
+  MakeRanges(block_size, buffer, &ranges);
+  while (st.KeepRunning()) {
+    for (unsigned i = 0; i < ranges.size(); ++i) {
+      int64_t nbytes = cache_mgr_->Pread(ranges[i].fd, ranges[i].buf,
+                                         ranges[i].size, ranges[i].offset);
+      if (nbytes != static_cast<int64_t>(block_size)) abort();
+    }
+  }
+  st.SetItemsProcessed(int64_t(st.iterations()) * kNumReads);
+  st.SetBytesProcessed(int64_t(st.iterations()) * kNumReads * block_size);
+  free(buffer);
+}
+BENCHMARK_REGISTER_F(BM_ExternalCache, PreadLoop)->Repetitions(3)
+  ->Arg(512)->Arg(4096)->Arg(32768)->UseRealTime();
+
+
+BENCHMARK_DEFINE_F(BM_ExternalCache, Preadv)(benchmark::State &st) {
+  const unsigned block_size = st.range(0);
+  char *buffer = reinterpret_cast<char *>(malloc(kNumReads * block_size));
+  vector<ExternalCacheManager::ReadRange> ranges;
+  MakeRanges(block_size, buffer, &ranges);
+  while (st.KeepRunning()) {
+    cache_mgr_->Preadv(&ranges);
+    for (unsigned i = 0; i < ranges.size(); ++i) {
+      if (ranges[i].result != static_cast<int64_t>(block_size)) abort();
+    }
+  }
+  st.SetItemsProcessed(int64_t(st.iterations()) * kNumReads);
+  st.SetBytesProcessed(int64_t(st.iterations()) * kNumReads * block_size);
+  free(buffer);
+}
+BENCHMARK_REGISTER_F(BM_ExternalCache, Preadv)->Repetitions(3)
+  ->Arg(512)->Arg(4096)->Arg(32768)->UseRealTime();
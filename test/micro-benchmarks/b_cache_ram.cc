@@ -0,0 +1,140 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+#include <benchmark/benchmark.h>
+
+#include <alloca.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "cache.h"
+#include "cache_ram.h"
+#include "crypto/hash.h"
+#include "statistics.h"
+#include "util/prng.h"
+
+using namespace std;  // NOLINT
+
+/**
+ * Concurrent Pread() throughput of the RAM cache manager.  Every thread
+ * reads 4kB blocks at random offsets from a set of open objects.  With a
+ * small set, all threads hit the same hot objects.
+ */
+class BM_RamCache : public benchmark::Fixture {
+ protected:
+  virtual void SetUp(const benchmark::State &st) {
+    statistics_ = new perf::Statistics();
+    cache_ = new RamCacheManager(kCacheSize, kNumFds,
+                                 MemoryKvStore::kMallocHeap,
+                                 perf::StatisticsTemplate("ram", statistics_));
+    void *buf = malloc(kObjectSize);
+    memset(buf, 42, kObjectSize);
+    void *txn = alloca(cache_->SizeOfTxn());
+    for (unsigned i = 0; i < kNumObjects; ++i) {
+      shash::Any id(shash::kSha1);
+      id.digest[0] = 1;
+      id.digest[1] = i;
+      id.digest[2] = i >> 8;
+      int retval = cache_->StartTxn(id, kObjectSize, txn);
+      if (retval != 0) abort();
+      cache_->Write(buf, kObjectSize, txn);
+      retval = cache_->CommitTxn(txn);
+      if (retval != 0) abort();
+      fds_.push_back(cache_->Open(CacheManager::Bless(id)));
+      if (fds_.back() < 0) abort();
+    }
+    free(buf);
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    for (unsigned i = 0; i < fds_.size(); ++i)
+      cache_->Close(fds_[i]);
+    fds_.clear();
+    delete cache_;
+    delete statistics_;
+  }
+
+  struct WorkerData {
+    RamCacheManager *cache;
+    const vector<int> *fds;
+    unsigned num_objects;
+    unsigned seed;
+  };
+
+  static void *MainWorker(void *data) {
+    WorkerData *worker_data = reinterpret_cast<WorkerData *>(data);
+    Prng prng;
+    prng.InitSeed(worker_data->seed);
+    char block[kBlockSize];
+    for (unsigned i = 0; i < kNumReadsPerThread; ++i) {
+      const int fd =
+        (*worker_data->fds)[prng.Next(worker_data->num_objects)];
+      const uint64_t offset =
+        prng.Next(kObjectSize / kBlockSize) * kBlockSize;
+      if (worker_data->cache->Pread(fd, block, kBlockSize, offset) !=
+          static_cast<int64_t>(kBlockSize))
+      {
+        abort();
+      }
+    }
+    return NULL;
+  }
+
+  void Run(benchmark::State *st, unsigned num_objects) {
+    const unsigned num_threads = st->range(0);
+    vector<pthread_t> threads(num_threads);
+    vector<WorkerData> worker_data(num_threads);
+    for (unsigned i = 0; i < num_threads; ++i) {
+      worker_data[i].cache = cache_;
+      worker_data[i].fds = &fds_;
+      worker_data[i].num_objects = num_objects;
+      worker_data[i].seed = i + 1;
+    }
+    while (st->KeepRunning()) {
+      for (unsigned i = 0; i < num_threads; ++i) {
+        int retval =
+          pthread_create(&threads[i], NULL, MainWorker, &worker_data[i]);
+        if (retval != 0)
+          abort();
+      }
+      for (unsigned i = 0; i < num_threads; ++i)
+        pthread_join(threads[i], NULL);
+    }
+    st->SetItemsProcessed(
+      int64_t(st->iterations()) * num_threads * kNumReadsPerThread);
+    st->SetBytesProcessed(
+      int64_t(st->iterations()) * num_threads * kNumReadsPerThread *
+      kBlockSize);
+  }
+
+  static const uint64_t kCacheSize = 256 * 1024 * 1024;
+  static const unsigned kNumFds = 1024;
+  static const unsigned kNumObjects = 256;
+  static const unsigned kNumHotObjects = 4;
+  static const uint64_t kObjectSize = 128 * 1024;
+  static const unsigned kBlockSize = 4096;
+  static const unsigned kNumReadsPerThread = 20000;
+
+  perf::Statistics *statistics_;
+  RamCacheManager *cache_;
+  vector<int> fds_;
+};
+
+
+// The argument is the number of threads
+BENCHMARK_DEFINE_F(BM_RamCache, PreadHot)(benchmark::State &st) {
+  Run(&st, kNumHotObjects);
+}
+BENCHMARK_REGISTER_F(BM_RamCache, PreadHot)->Repetitions(3)
+  ->Arg(1)->Arg(8)->Arg(32)->Arg(64)->UseRealTime();
+
+
+BENCHMARK_DEFINE_F(BM_RamCache, PreadSpread)(benchmark::State &st) {
+  Run(&st, kNumObjects);
+}
+BENCHMARK_REGISTER_F(BM_RamCache, PreadSpread)->Repetitions(3)
+  ->Arg(1)->Arg(8)->Arg(32)->Arg(64)->UseRealTime();
@@ -0,0 +1,162 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+#include <benchmark/benchmark.h>
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bm_util.h"
+#include "catalog.h"
+#include "catalog_sql.h"
+#include "crypto/hash.h"
+#include "directory_entry.h"
+#include "shortstring.h"
+#include "util/pointer.h"
+#include "util/posix.h"
+#include "util/prng.h"
+#include "util/string.h"
+
+/**
+ * Concurrent path lookups in a single, synthetic catalog with kNumDirs
+ * directories of kNumFiles files each.  The argument is the number of threads.
+ * The catalog is created once and shared by all benchmark runs.
+ */
+class BM_Catalog : public benchmark::Fixture {
+ protected:
+  static const unsigned kNumDirs = 1000;
+  static const unsigned kNumFiles = 1000;
+  static const unsigned kOpsPerThread = 20000;
+
+  struct ThreadData {
+    catalog::Catalog *catalog;
+    uint64_t seed;
+  };
+
+  static std::string MakePath(unsigned dir, unsigned file) {
+    return "/dir" + StringifyInt(dir) + "/file" + StringifyInt(file);
+  }
+
+  static void *MainWorker(void *data) {
+    ThreadData *td = reinterpret_cast<ThreadData *>(data);
+    Prng prng;
+    prng.InitSeed(td->seed);
+    catalog::DirectoryEntry dirent;
+    for (unsigned i = 0; i < kOpsPerThread; ++i) {
+      std::string path = MakePath(prng.Next(kNumDirs), prng.Next(kNumFiles));
+      if (!td->catalog->LookupPath(PathString(path), &dirent))
+        abort();
+    }
+    return NULL;
+  }
+
+  static void InsertEntry(catalog::SqlCatalog *sql,
+                          const std::string &path,
+                          const std::string &parent_path,
+                          const std::string &name,
+                          const unsigned mode,
+                          const int flags)
+  {
+    bool retval =
+      sql->BindMd5(1, 2, shash::Md5(shash::AsciiPtr(path))) &&
+      sql->BindMd5(3, 4, shash::Md5(shash::AsciiPtr(parent_path))) &&
+      sql->BindInt64(5, 1) &&
+      sql->BindInt64(6, 4096) &&
+      sql->BindInt64(7, mode) &&
+      sql->BindInt64(8, 0) &&
+      sql->BindInt64(9, flags) &&
+      sql->BindText(10, name) &&
+      sql->BindText(11, "") &&
+      sql->BindInt64(12, 0) &&
+      sql->BindInt64(13, 0) &&
+      sql->Execute() &&
+      sql->Reset();
+    if (!retval)
+      abort();
+  }
+
+  static void CreateCatalog() {
+    tmp_path_ = CreateTempDir("/tmp/cvmfs_ubench_catalog");
+    db_path_ = tmp_path_ + "/catalog.db";
+    UniquePtr<catalog::CatalogDatabase>
+      database(catalog::CatalogDatabase::Create(db_path_));
+    if (!database.IsValid() ||
+        !database->InsertInitialValues("", false, "") ||
+        !database->BeginTransaction())
+    {
+      abort();
+    }
+    catalog::SqlCatalog sql(*database,
+      "INSERT INTO catalog (md5path_1, md5path_2, parent_1, parent_2, "
+      "hardlinks, size, mode, mtime, flags, name, symlink, uid, gid) "
+      "VALUES (:md5_1, :md5_2, :p_1, :p_2, :links, :size, :mode, :mtime, "
+      ":flags, :name, :symlink, :uid, :gid);");
+    for (unsigned d = 0; d < kNumDirs; ++d) {
+      const std::string dir_name = "dir" + StringifyInt(d);
+      InsertEntry(&sql, "/" + dir_name, "", dir_name, S_IFDIR | 0755,
+                  catalog::SqlDirent::kFlagDir);
+      for (unsigned f = 0; f < kNumFiles; ++f) {
+        InsertEntry(&sql, MakePath(d, f), "/" + dir_name,
+                    "file" + StringifyInt(f), S_IFREG | 0644,
+                    catalog::SqlDirent::kFlagFile);
+      }
+    }
+    if (!database->CommitTransaction())
+      abort();
+    atexit(RemoveCatalog);
+  }
+
+  static void RemoveCatalog() {
+    RemoveTree(tmp_path_);
+  }
+
+  virtual void SetUp(const benchmark::State &st) {
+    if (db_path_.empty())
+      CreateCatalog();
+    catalog_ = catalog::Catalog::AttachFreely("", db_path_, shash::Any(),
+                                              NULL, false);
+    if (catalog_ == NULL)
+      abort();
+    num_threads_ = st.range(0);
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    delete catalog_;
+  }
+
+  static std::string tmp_path_;
+  static std::string db_path_;
+  catalog::Catalog *catalog_;
+  unsigned num_threads_;
+};
+
+std::string BM_Catalog::tmp_path_;
+std::string BM_Catalog::db_path_;
+
+
+BENCHMARK_DEFINE_F(BM_Catalog, LookupPath)(benchmark::State &st) {
+  std::vector<pthread_t> threads(num_threads_);
+  std::vector<ThreadData> thread_data(num_threads_);
+  uint64_t seed = 0;
+  while (st.KeepRunning()) {
+    for (unsigned i = 0; i < num_threads_; ++i) {
+      thread_data[i].catalog = catalog_;
+      thread_data[i].seed = ++seed;
+      int retval = pthread_create(&threads[i], NULL, MainWorker,
+                                  &thread_data[i]);
+      if (retval != 0)
+        abort();
+    }
+    for (unsigned i = 0; i < num_threads_; ++i)
+      pthread_join(threads[i], NULL);
+  }
+  st.SetItemsProcessed(
+    int64_t(st.iterations()) * num_threads_ * kOpsPerThread);
+}
+BENCHMARK_REGISTER_F(BM_Catalog, LookupPath)->Repetitions(3)
+  ->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16)
+  ->UseRealTime();
@@ -0,0 +1,84 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+#include <benchmark/benchmark.h>
+
+#include <inttypes.h>
+
+#include <vector>
+
+#include "bm_util.h"
+#include "ingestion/chunk_detector.h"
+#include "ingestion/item.h"
+#include "ingestion/item_mem.h"
+#include "util/prng.h"
+
+/**
+ * Throughput of the chunk detectors on random data with the default chunk
+ * sizes of cvmfs_server (4M/8M/16M).  The argument is the
+ * ChunkDetectorAlgorithms value.
+ */
+class BM_Chunking : public benchmark::Fixture {
+ protected:
+  static const unsigned kBlockSize = 2 * 1024 * 1024;
+  static const unsigned kNumBlocks = 32;
+  static const uint64_t kMinChunkSize = 4 * 1024 * 1024;
+  static const uint64_t kAvgChunkSize = 8 * 1024 * 1024;
+  static const uint64_t kMaxChunkSize = 16 * 1024 * 1024;
+
+  virtual void SetUp(const benchmark::State &st) {
+    Prng prng;
+    prng.InitSeed(42);
+    for (unsigned i = 0; i < kNumBlocks; ++i) {
+      BlockItem *block = new BlockItem(&allocator_);
+      block->MakeData(kBlockSize);
+      for (unsigned j = 0; j < kBlockSize; ++j)
+        block->data()[j] = static_cast<unsigned char>(prng.Next(256));
+      block->set_size(kBlockSize);
+      blocks_.push_back(block);
+    }
+    algorithm_ = static_cast<ChunkDetectorAlgorithms>(st.range(0));
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    for (unsigned i = 0; i < blocks_.size(); ++i)
+      delete blocks_[i];
+    blocks_.clear();
+  }
+
+  ChunkDetector *MakeDetector() {
+    switch (algorithm_) {
+      case kChunkDetectorXor32:
+        return new Xor32Detector(kMinChunkSize, kAvgChunkSize, kMaxChunkSize);
+      case kChunkDetectorFastCdc:
+        return new FastCdcDetector(kMinChunkSize, kAvgChunkSize, kMaxChunkSize);
+      default:
+        abort();
+    }
+  }
+
+  ItemAllocator allocator_;
+  std::vector<BlockItem *> blocks_;
+  ChunkDetectorAlgorithms algorithm_;
+};
+
+
+BENCHMARK_DEFINE_F(BM_Chunking, FindCutMarks)(benchmark::State &st) {
+  uint64_t nchunks = 0;
+  while (st.KeepRunning()) {
+    ChunkDetector *detector = MakeDetector();
+    for (unsigned i = 0; i < blocks_.size(); ++i) {
+      uint64_t cut_mark;
+      while ((cut_mark = detector->FindNextCutMark(blocks_[i])) != 0) {
+        Escape(&cut_mark);
+        nchunks++;
+      }
+    }
+    delete detector;
+  }
+  st.SetBytesProcessed(int64_t(st.iterations()) * kNumBlocks * kBlockSize);
+  st.SetItemsProcessed(nchunks);
+  st.SetLabel(ChunkDetectorAlgorithmName(algorithm_).c_str());
+}
+BENCHMARK_REGISTER_F(BM_Chunking, FindCutMarks)->Repetitions(3)->
+  Arg(kChunkDetectorXor32)->Arg(kChunkDetectorFastCdc);
@@ -7,9 +7,12 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <string>
 
 #include "bm_util.h"
 #include "compression.h"
+#include "util/prng.h"
+#include "util/string.h"
 
 class BM_Compression : public benchmark::Fixture {
  protected:
@@ -34,3 +37,87 @@ BENCHMARK_DEFINE_F(BM_Compression, Zlib)(benchmark::State &st) {
 }
 BENCHMARK_REGISTER_F(BM_Compression, Zlib)->Repetitions(3)->
   Arg(100)->Arg(4096)->Arg(100*1024);
+
+
+/**
+ * Compares the algorithms on a partially compressible input: words drawn from
+ * a small dictionary interleaved with random bytes.  The first argument is the
+ * zlib::Algorithms value, the second one the input size.
+ */
+class BM_CompressionAlgorithms : public benchmark::Fixture {
+ protected:
+  virtual void SetUp(const benchmark::State &st) {
+    const char *words[] = {"cvmfs ", "catalog ", "chunk ", "/software/",
+                           "lib64 ", ".so ", "0x1f3a ", "\n"};
+    Prng prng;
+    prng.InitSeed(42);
+    input_.clear();
+    const unsigned size = st.range(1);
+    while (input_.size() < size) {
+      if (prng.Next(4) == 0)
+        input_.push_back(static_cast<char>(prng.Next(256)));
+      else
+        input_.append(words[prng.Next(8)]);
+    }
+    input_.resize(size);
+
+    algorithm_ = static_cast<zlib::Algorithms>(st.range(0));
+    compressed_ = NULL;
+    zlib::CompressMem2Mem(algorithm_, input_.data(), input_.size(),
+                          &compressed_, &compressed_size_);
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    free(compressed_);
+  }
+
+  std::string Label() {
+    return zlib::AlgorithmName(algorithm_) + ", ratio " +
+      StringifyDouble(static_cast<double>(input_.size()) / compressed_size_);
+  }
+
+  std::string input_;
+  zlib::Algorithms algorithm_;
+  void *compressed_;
+  uint64_t compressed_size_;
+};
+
+
+BENCHMARK_DEFINE_F(BM_CompressionAlgorithms, Compress)(benchmark::State &st) {
+  while (st.KeepRunning()) {
+    void *out_buf;
+    uint64_t out_size;
+    zlib::CompressMem2Mem(algorithm_, input_.data(), input_.size(),
+                          &out_buf, &out_size);
+    Escape(out_buf);
+    free(out_buf);
+  }
+  st.SetBytesProcessed(int64_t(st.iterations()) * input_.size());
+  st.SetLabel(Label().c_str());
+}
+BENCHMARK_REGISTER_F(BM_CompressionAlgorithms, Compress)->Repetitions(3)->
+#ifdef CVMFS_ENABLE_ZSTD_LZ4
+  ArgPair(zlib::kZstd, 4096)->ArgPair(zlib::kZstd, 1024*1024)->
+  ArgPair(zlib::kLz4, 4096)->ArgPair(zlib::kLz4, 1024*1024)->
+#endif
+  ArgPair(zlib::kZlibDefault, 4096)->ArgPair(zlib::kZlibDefault, 1024*1024);
+
+
+BENCHMARK_DEFINE_F(BM_CompressionAlgorithms, Decompress)(benchmark::State &st) {
+  while (st.KeepRunning()) {
+    void *out_buf;
+    uint64_t out_size;
+    zlib::DecompressMem2Mem(algorithm_, compressed_, compressed_size_,
+                            &out_buf, &out_size);
+    Escape(out_buf);
+    free(out_buf);
+  }
+  st.SetBytesProcessed(int64_t(st.iterations()) * input_.size());
+  st.SetLabel(Label().c_str());
+}
+BENCHMARK_REGISTER_F(BM_CompressionAlgorithms, Decompress)->Repetitions(3)->
+#ifdef CVMFS_ENABLE_ZSTD_LZ4
+  ArgPair(zlib::kZstd, 4096)->ArgPair(zlib::kZstd, 1024*1024)->
+  ArgPair(zlib::kLz4, 4096)->ArgPair(zlib::kLz4, 1024*1024)->
+#endif
+  ArgPair(zlib::kZlibDefault, 4096)->ArgPair(zlib::kZlibDefault, 1024*1024);
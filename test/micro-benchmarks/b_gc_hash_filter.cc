@@ -0,0 +1,156 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "bm_util.h"
+#include "crypto/hash.h"
+#include "garbage_collection/hash_filter.h"
+#include "util/prng.h"
+
+namespace {
+
+/**
+ * Resets the peak resident set size of the process to the current one
+ * (Linux >= 4.0).  Returns false if the peak cannot be reset.
+ *
+ * Fixing the mmap threshold of glibc keeps large vectors in their own mappings
+ * in all iterations.  Otherwise, the threshold grows with the first large
+ * free() and freed vectors linger on the heap, inflating later peaks.
+ */
+bool ResetPeakRss() {
+#ifdef __GLIBC__
+  mallopt(M_MMAP_THRESHOLD, 128 * 1024);
+  malloc_trim(0);
+#endif
+  FILE *f = fopen("/proc/self/clear_refs", "w");
+  if (f == NULL)
+    return false;
+  const bool result = (fputs("5", f) >= 0);
+  return (fclose(f) == 0) && result;
+}
+
+/**
+ * Peak resident set size in kB since the last reset, or 0 if unknown
+ */
+uint64_t GetPeakRss() {
+  FILE *f = fopen("/proc/self/status", "r");
+  if (f == NULL)
+    return 0;
+  char line[256];
+  unsigned long long peak = 0;  // NOLINT
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (strncmp(line, "VmHWM:", 6) == 0) {
+      if (sscanf(line + 6, "%llu", &peak) != 1)
+        peak = 0;
+      break;
+    }
+  }
+  fclose(f);
+  return peak;
+}
+
+}  // anonymous namespace
+
+
+/**
+ * Mark and sweep with the hash filters of the garbage collector on a synthetic
+ * repository.  Each of the kNumRevisions revisions references st.range(0)
+ * objects and replaces a tenth of the objects of its predecessor.  The newer
+ * half of the revisions is preserved, the older half is swept.  The label
+ * shows the memory used by the filters per preserved object and the peak
+ * resident set size of the last iteration, which includes the input objects
+ * and transient allocations such as merge buffers.
+ */
+template <class HashFilterT>
+class BM_GcHashFilter : public benchmark::Fixture {
+ protected:
+  static const unsigned kNumRevisions = 10;
+
+  virtual void SetUp(const benchmark::State &st) {
+    num_objects_ = st.range(0);
+    Prng prng;
+    prng.InitSeed(42);
+    objects_.resize(num_objects_ + (kNumRevisions - 1) * Churn(),
+                    shash::Any(shash::kSha1));
+    for (unsigned i = 0; i < objects_.size(); ++i)
+      objects_[i].Randomize(&prng);
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    std::vector<shash::Any>().swap(objects_);
+  }
+
+  unsigned Churn() const { return num_objects_ / 10; }
+
+  void Run(benchmark::State *st) {
+    uint64_t bytes_allocated = 0;
+    size_t num_preserved = 0;
+    size_t num_condemned = 0;
+    uint64_t peak_rss = 0;
+    while (st->KeepRunning()) {
+      const bool has_peak_rss = ResetPeakRss();
+      HashFilterT preserved;
+      HashFilterT delete_requests;
+      for (unsigned r = kNumRevisions / 2; r < kNumRevisions; ++r) {
+        for (unsigned i = 0; i < num_objects_; ++i)
+          preserved.Fill(objects_[r * Churn() + i]);
+      }
+      preserved.Freeze();
+
+      for (unsigned r = 0; r < kNumRevisions / 2; ++r) {
+        for (unsigned i = 0; i < num_objects_; ++i) {
+          const shash::Any &hash = objects_[r * Churn() + i];
+          if (!preserved.Contains(hash) && !delete_requests.Contains(hash))
+            delete_requests.Fill(hash);
+        }
+      }
+      bytes_allocated =
+        preserved.bytes_allocated() + delete_requests.bytes_allocated();
+      num_preserved = preserved.Count();
+      num_condemned = delete_requests.Count();
+      peak_rss = has_peak_rss ? GetPeakRss() : 0;
+    }
+    st->SetItemsProcessed(
+      int64_t(st->iterations()) * kNumRevisions * num_objects_);
+
+    char label[192];
+    snprintf(label, sizeof(label),
+             "%zu preserved, %zu condemned, %.1f bytes per preserved object, "
+             "peak RSS %.1f MB",
+             num_preserved, num_condemned,
+             static_cast<double>(bytes_allocated) / num_preserved,
+             static_cast<double>(peak_rss) / 1024.0);
+    st->SetLabel(label);
+  }
+
+  unsigned num_objects_;
+  std::vector<shash::Any> objects_;
+};
+
+
+BENCHMARK_TEMPLATE_DEFINE_F(BM_GcHashFilter, Smallhash, SmallhashFilter)
+  (benchmark::State &st)
+{
+  Run(&st);
+}
+BENCHMARK_REGISTER_F(BM_GcHashFilter, Smallhash)->Repetitions(3)
+  ->Arg(1000000)->Arg(4000000)->Unit(benchmark::kMillisecond);
+
+
+BENCHMARK_TEMPLATE_DEFINE_F(BM_GcHashFilter, Compact, CompactHashFilter)
+  (benchmark::State &st)
+{
+  Run(&st);
+}
+BENCHMARK_REGISTER_F(BM_GcHashFilter, Compact)->Repetitions(3)
+  ->Arg(1000000)->Arg(4000000)->Unit(benchmark::kMillisecond);
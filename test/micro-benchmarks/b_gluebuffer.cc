@@ -4,7 +4,10 @@
 #define __STDC_FORMAT_MACROS
 #include <benchmark/benchmark.h>
 
+#include <pthread.h>
+
 #include <cassert>
+#include <cstdlib>
 #include <string>
 #include <vector>
 
@@ -50,7 +53,9 @@ class BM_InodeTracker : public benchmark::Fixture {
     assert(inodes_.size() == paths_.size());
 
     inode_tracker_ = new glue::InodeTracker();
-    inode_tracker_->VfsGet(kNumInodes + 1, PathString("/", 1));
+    inode_tracker_->VfsGet(
+      glue::InodeEx(kNumInodes + 1, glue::InodeEx::kDirectory),
+      PathString("/", 1));
   }
 
   virtual void TearDown(const benchmark::State &st) {
@@ -59,9 +64,41 @@ class BM_InodeTracker : public benchmark::Fixture {
     paths_.clear();
   }
 
+  static glue::InodeEx InodeEx(const uint64_t inode) {
+    return glue::InodeEx(inode, glue::InodeEx::kUnknownType);
+  }
+
   // Construction of paths_ needs to be changed if this number changes
   static const unsigned kNumInodes = 11111;
 
+  struct WorkerData {
+    BM_InodeTracker *fixture;
+    unsigned begin;
+    unsigned end;
+  };
+
+  /**
+   * Every worker repeatedly looks up and forgets its own slice of the paths,
+   * as parallel find processes would do
+   */
+  static void *MainGetPut(void *data) {
+    WorkerData *worker_data = reinterpret_cast<WorkerData *>(data);
+    BM_InodeTracker *fixture = worker_data->fixture;
+    for (unsigned round = 0; round < kNumRounds; ++round) {
+      for (unsigned i = worker_data->begin; i < worker_data->end; ++i) {
+        fixture->inode_tracker_->VfsGet(InodeEx(fixture->inodes_[i]),
+                                        fixture->paths_[i]);
+      }
+      for (unsigned i = worker_data->begin; i < worker_data->end; ++i) {
+        fixture->inode_tracker_->GetVfsPutRaii().VfsPut(
+          fixture->inodes_[i], 1);
+      }
+    }
+    return NULL;
+  }
+
+  static const unsigned kNumRounds = 10;
+
   vector<uint64_t> inodes_;
   vector<PathString> paths_;
   glue::InodeTracker *inode_tracker_;
@@ -72,7 +109,7 @@ BENCHMARK_DEFINE_F(BM_InodeTracker, Get)(benchmark::State &st) {
   unsigned i = 0;
   while (st.KeepRunning()) {
     unsigned idx = i % kNumInodes;
-    inode_tracker_->VfsGet(inodes_[idx], paths_[idx]);
+    inode_tracker_->VfsGet(InodeEx(inodes_[idx]), paths_[idx]);
     ++i;
   }
   st.SetItemsProcessed(st.iterations());
@@ -87,9 +124,9 @@ BENCHMARK_DEFINE_F(BM_InodeTracker, GetPut)(benchmark::State &st) {
   while (st.KeepRunning()) {
     unsigned idx = i % 5000;
     if (((i / 5000) % 2) == 0) {
-      inode_tracker_->VfsGet(inodes_[idx], paths_[idx]);
+      inode_tracker_->VfsGet(InodeEx(inodes_[idx]), paths_[idx]);
     } else {
-      inode_tracker_->VfsPut(inodes_[idx], 1);
+      inode_tracker_->GetVfsPutRaii().VfsPut(inodes_[idx], 1);
     }
     ++i;
   }
@@ -98,16 +135,48 @@ BENCHMARK_DEFINE_F(BM_InodeTracker, GetPut)(benchmark::State &st) {
 BENCHMARK_REGISTER_F(BM_InodeTracker, GetPut)->Repetitions(3);
 
 
+// Concurrent lookups and forgets, the argument is the number of threads
+BENCHMARK_DEFINE_F(BM_InodeTracker, GetPutMultiThreaded)
+  (benchmark::State &st)
+{
+  const unsigned num_threads = st.range(0);
+  vector<pthread_t> threads(num_threads);
+  vector<WorkerData> worker_data(num_threads);
+  // Skip the root path, which is pinned by SetUp()
+  const unsigned slice = (kNumInodes - 1) / num_threads;
+  for (unsigned i = 0; i < num_threads; ++i) {
+    worker_data[i].fixture = this;
+    worker_data[i].begin = 1 + i * slice;
+    worker_data[i].end = 1 + (i + 1) * slice;
+  }
+  while (st.KeepRunning()) {
+    for (unsigned i = 0; i < num_threads; ++i) {
+      int retval =
+        pthread_create(&threads[i], NULL, MainGetPut, &worker_data[i]);
+      if (retval != 0)
+        abort();
+    }
+    for (unsigned i = 0; i < num_threads; ++i)
+      pthread_join(threads[i], NULL);
+  }
+  st.SetItemsProcessed(
+    int64_t(st.iterations()) * num_threads * slice * kNumRounds * 2);
+}
+BENCHMARK_REGISTER_F(BM_InodeTracker, GetPutMultiThreaded)->Repetitions(3)
+  ->Arg(1)->Arg(4)->Arg(16)->UseRealTime();
+
+
 BENCHMARK_DEFINE_F(BM_InodeTracker, FindPath)(benchmark::State &st) {
   unsigned size = st.range(0);
   for (unsigned i = 0; i < size; ++i)
-    inode_tracker_->VfsGet(inodes_[i], paths_[i]);
+    inode_tracker_->VfsGet(InodeEx(inodes_[i]), paths_[i]);
 
   unsigned i = 0;
   PathString path;
   while (st.KeepRunning()) {
     unsigned idx = i % size;
-    bool retval = inode_tracker_->FindPath(inodes_[idx], &path);
+    glue::InodeEx inode_ex = InodeEx(inodes_[idx]);
+    bool retval = inode_tracker_->FindPath(&inode_ex, &path);
     assert(retval == true);
     Escape(&path);
     ++i;
@@ -120,7 +189,7 @@ BENCHMARK_REGISTER_F(BM_InodeTracker, FindPath)->Repetitions(3)->Arg(10000);
 BENCHMARK_DEFINE_F(BM_InodeTracker, FindInode)(benchmark::State &st) {
   unsigned size = st.range(0);
   for (unsigned i = 0; i < size; ++i)
-    inode_tracker_->VfsGet(inodes_[i], paths_[i]);
+    inode_tracker_->VfsGet(InodeEx(inodes_[i]), paths_[i]);
 
   unsigned i = 0;
   uint64_t inode;
@@ -138,7 +207,7 @@ BENCHMARK_REGISTER_F(BM_InodeTracker, FindInode)->Repetitions(3)->Arg(10000);
 BENCHMARK_DEFINE_F(BM_InodeTracker, Nadd)(benchmark::State &st) {
   unsigned size = st.range(0);
   while (st.KeepRunning()) {
-    glue::NentryTracker tracker;
+    glue::DentryTracker tracker;
     for (unsigned i = 0; i < size; ++i)
       tracker.Add(0, "libCore.so", 1000);
   }
@@ -5,6 +5,7 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
 #include "bm_util.h"
 #include "crypto/hash.h"
@@ -63,3 +64,59 @@ BENCHMARK_DEFINE_F(BM_Hash, Sha1)(benchmark::State &st) {
 }
 BENCHMARK_REGISTER_F(BM_Hash, Sha1)->Repetitions(3)->Arg(100)->Arg(4096)->
   Arg(100*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Hash, Blake3)(benchmark::State &st) {
+  unsigned size = st.range(0);
+  unsigned char buffer[size];
+  memset(buffer, 0, size);
+  shash::Any content_hash(shash::kBlake3);
+  while (st.KeepRunning()) {
+    HashMem(buffer, size, &content_hash);
+  }
+  st.SetItemsProcessed(st.iterations());
+  st.SetBytesProcessed(int64_t(st.iterations()) * size);
+}
+BENCHMARK_REGISTER_F(BM_Hash, Blake3)->Repetitions(3)->Arg(100)->Arg(4096)->
+  Arg(100*1024);
+
+
+/**
+ * Many small objects of st.range(1) bytes hashed either one by one
+ * (st.range(2) == 0) or together by HashMemMulti
+ */
+BENCHMARK_DEFINE_F(BM_Hash, SmallObjects)(benchmark::State &st) {
+  const shash::Algorithms algorithm =
+    static_cast<shash::Algorithms>(st.range(0));
+  const unsigned size = st.range(1);
+  const bool multi = st.range(2);
+  const unsigned kNumObjects = 64;
+  unsigned char *data =
+    reinterpret_cast<unsigned char *>(malloc(kNumObjects * size + 1));
+  memset(data, 0, kNumObjects * size + 1);
+  const unsigned char *buffers[kNumObjects];
+  unsigned sizes[kNumObjects];
+  for (unsigned i = 0; i < kNumObjects; ++i) {
+    buffers[i] = data + i * size;
+    sizes[i] = size;
+  }
+  std::vector<shash::Any> digests(kNumObjects, shash::Any(algorithm));
+
+  while (st.KeepRunning()) {
+    if (multi) {
+      shash::HashMemMulti(kNumObjects, buffers, sizes, &digests[0]);
+    } else {
+      for (unsigned i = 0; i < kNumObjects; ++i)
+        shash::HashMem(buffers[i], sizes[i], &digests[i]);
+    }
+    Escape(&digests[0]);
+  }
+  st.SetItemsProcessed(int64_t(st.iterations()) * kNumObjects);
+  st.SetBytesProcessed(int64_t(st.iterations()) * kNumObjects * size);
+  free(data);
+}
+BENCHMARK_REGISTER_F(BM_Hash, SmallObjects)->Repetitions(3)
+  ->Args({shash::kSha1, 64, 0})->Args({shash::kSha1, 1024, 0})
+  ->Args({shash::kSha1, 1024, 1})
+  ->Args({shash::kBlake3, 64, 0})->Args({shash::kBlake3, 64, 1})
+  ->Args({shash::kBlake3, 1024, 0})->Args({shash::kBlake3, 1024, 1});
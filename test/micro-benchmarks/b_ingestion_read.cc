@@ -0,0 +1,155 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "ingestion/async_reader.h"
+#include "ingestion/ingestion_source.h"
+#include "ingestion/item.h"
+#include "ingestion/item_mem.h"
+#include "ingestion/task.h"
+#include "ingestion/task_read.h"
+#include "ingestion/tube.h"
+#include "util/posix.h"
+#include "util/prng.h"
+#include "util/string.h"
+
+using namespace std;  // NOLINT
+
+namespace {
+
+/**
+ * Stands in for the chunking stage: frees the blocks and counts finished files
+ */
+class BenchSink : public TubeConsumer<BlockItem> {
+ public:
+  BenchSink(Tube<BlockItem> *tube_in, Tube<FileItem> *tube_counter)
+    : TubeConsumer<BlockItem>(tube_in)
+    , tube_counter_(tube_counter)
+  { }
+
+ protected:
+  virtual void Process(BlockItem *block_item) {
+    if (block_item->type() == BlockItem::kBlockStop) {
+      delete block_item->file_item();
+      tube_counter_->PopFront();
+    }
+    delete block_item;
+  }
+
+ private:
+  Tube<FileItem> *tube_counter_;
+};
+
+}  // anonymous namespace
+
+
+/**
+ * Files/second read by the TaskRead stage of the ingestion pipeline, either
+ * for a directory of many small files or for a few huge files.  The files are
+ * in the page cache, so that the benchmark measures the overhead of the read
+ * stage rather than the disk.  The argument selects the reader: 0 reads
+ * synchronously, 1 and 2 use the asynchronous io_uring and pread readers.
+ */
+class BM_IngestionRead : public benchmark::Fixture {
+ protected:
+  static const unsigned kNumReaders = 8;
+  static const unsigned kNumSinks = 2;
+
+  virtual void SetUp(const benchmark::State &st) {
+    dir_ = "cvmfs_ubench_ingestion";
+    MkdirDeep(dir_, 0700);
+    tubes_out_ = new TubeGroup<BlockItem>();
+    tasks_read_ = new TubeConsumerGroup<FileItem>();
+    tasks_sink_ = new TubeConsumerGroup<BlockItem>();
+    for (unsigned i = 0; i < kNumSinks; ++i) {
+      Tube<BlockItem> *tube = new Tube<BlockItem>();
+      tubes_out_->TakeTube(tube);
+      tasks_sink_->TakeConsumer(new BenchSink(tube, &tube_counter_));
+    }
+    tubes_out_->Activate();
+    for (unsigned i = 0; i < kNumReaders; ++i) {
+      TaskRead *task_read = new TaskRead(&tube_in_, tubes_out_, &allocator_);
+      if (st.range(0) == 1)
+        task_read->SetAsyncReader(AsyncReader::kIoUring);
+      else if (st.range(0) == 2)
+        task_read->SetAsyncReader(AsyncReader::kPread);
+      tasks_read_->TakeConsumer(task_read);
+    }
+    tasks_sink_->Spawn();
+    tasks_read_->Spawn();
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    tasks_read_->Terminate();
+    tasks_sink_->Terminate();
+    delete tasks_read_;
+    delete tasks_sink_;
+    delete tubes_out_;
+    for (unsigned i = 0; i < paths_.size(); ++i)
+      unlink(paths_[i].c_str());
+    paths_.clear();
+    rmdir(dir_.c_str());
+  }
+
+  void CreateFiles(unsigned num_files, uint64_t file_size) {
+    Prng prng;
+    prng.InitSeed(42);
+    string content(file_size, '\0');
+    for (uint64_t i = 0; i < file_size; ++i)
+      content[i] = static_cast<char>(prng.Next(256));
+    for (unsigned i = 0; i < num_files; ++i) {
+      paths_.push_back(dir_ + "/" + StringifyInt(i));
+      if (!SafeWriteToFile(content, paths_.back(), 0600)) abort();
+    }
+  }
+
+  void Run(benchmark::State *st, uint64_t file_size) {
+    while (st->KeepRunning()) {
+      for (unsigned i = 0; i < paths_.size(); ++i) {
+        FileItem *file_item =
+          new FileItem(new FileIngestionSource(paths_[i]));
+        tube_counter_.EnqueueBack(file_item);
+        tube_in_.EnqueueBack(file_item);
+      }
+      tube_counter_.Wait();
+    }
+    st->SetItemsProcessed(int64_t(st->iterations()) * paths_.size());
+    st->SetBytesProcessed(
+      int64_t(st->iterations()) * paths_.size() * file_size);
+  }
+
+  string dir_;
+  vector<string> paths_;
+  ItemAllocator allocator_;
+  Tube<FileItem> tube_in_;
+  Tube<FileItem> tube_counter_;
+  TubeGroup<BlockItem> *tubes_out_;
+  TubeConsumerGroup<FileItem> *tasks_read_;
+  TubeConsumerGroup<BlockItem> *tasks_sink_;
+};
+
+
+BENCHMARK_DEFINE_F(BM_IngestionRead, SmallFiles)(benchmark::State &st) {
+  const uint64_t file_size = 4096;
+  CreateFiles(4000, file_size);
+  Run(&st, file_size);
+}
+BENCHMARK_REGISTER_F(BM_IngestionRead, SmallFiles)->Repetitions(3)
+  ->UseRealTime()->Arg(0)->Arg(1)->Arg(2);
+
+
+BENCHMARK_DEFINE_F(BM_IngestionRead, HugeFiles)(benchmark::State &st) {
+  const uint64_t file_size = 128 * 1024 * 1024;
+  CreateFiles(2, file_size);
+  Run(&st, file_size);
+}
+BENCHMARK_REGISTER_F(BM_IngestionRead, HugeFiles)->Repetitions(3)
+  ->UseRealTime()->Arg(0)->Arg(1)->Arg(2);
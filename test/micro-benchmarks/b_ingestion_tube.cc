@@ -0,0 +1,128 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "ingestion/task.h"
+#include "ingestion/tube.h"
+
+using namespace std;  // NOLINT
+
+namespace {
+
+class BenchItem {
+ public:
+  static BenchItem *CreateQuitBeacon() { return new BenchItem(-1); }
+  explicit BenchItem(int64_t tag) : tag_(tag) { }
+  bool IsQuitBeacon() { return tag_ == -1; }
+  int64_t tag() { return tag_; }
+
+ private:
+  int64_t tag_;
+};
+
+
+/**
+ * Forwards items to the next stage or, in the last stage, to the sink
+ */
+class BenchTask : public TubeConsumer<BenchItem> {
+ public:
+  BenchTask(Tube<BenchItem> *tube_in,
+            TubeGroup<BenchItem> *tubes_out,
+            Tube<BenchItem> *tube_sink)
+    : TubeConsumer<BenchItem>(tube_in)
+    , tubes_out_(tubes_out)
+    , tube_sink_(tube_sink)
+  { }
+
+ protected:
+  virtual void Process(BenchItem *item) {
+    if (tubes_out_ != NULL)
+      tubes_out_->Dispatch(item);
+    else
+      tube_sink_->EnqueueBack(item);
+  }
+
+ private:
+  TubeGroup<BenchItem> *tubes_out_;
+  Tube<BenchItem> *tube_sink_;
+};
+
+}  // anonymous namespace
+
+
+/**
+ * Items/second through a pipeline of five stages, like read, chunk, compress,
+ * hash, and write in the ingestion pipeline.  Every stage has a group of
+ * tubes, one per consumer thread.  Items carry different tags and are thus
+ * spread over the tubes of a stage.
+ */
+class BM_IngestionTube : public benchmark::Fixture {
+ protected:
+  static const unsigned kNumStages = 5;
+  static const unsigned kNumItems = 100000;
+  static const unsigned kNumTags = 1024;
+
+  virtual void SetUp(const benchmark::State &st) {
+    const unsigned num_consumers = st.range(0);
+    for (unsigned i = 0; i < kNumItems; ++i)
+      items_.push_back(new BenchItem(i % kNumTags));
+
+    for (unsigned s = 0; s < kNumStages; ++s) {
+      tube_groups_.push_back(new TubeGroup<BenchItem>());
+      task_groups_.push_back(new TubeConsumerGroup<BenchItem>());
+    }
+    // Build from the last stage backwards so that the output exists
+    for (int s = kNumStages - 1; s >= 0; --s) {
+      TubeGroup<BenchItem> *tubes_out =
+        (s == kNumStages - 1) ? NULL : tube_groups_[s + 1];
+      for (unsigned i = 0; i < num_consumers; ++i) {
+        Tube<BenchItem> *tube = new Tube<BenchItem>();
+        tube_groups_[s]->TakeTube(tube);
+        task_groups_[s]->TakeConsumer(
+          new BenchTask(tube, tubes_out, &tube_sink_));
+      }
+      tube_groups_[s]->Activate();
+      task_groups_[s]->Spawn();
+    }
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    for (unsigned s = 0; s < kNumStages; ++s) {
+      task_groups_[s]->Terminate();
+      delete task_groups_[s];
+      delete tube_groups_[s];
+    }
+    task_groups_.clear();
+    tube_groups_.clear();
+    for (unsigned i = 0; i < items_.size(); ++i)
+      delete items_[i];
+    items_.clear();
+  }
+
+  vector<BenchItem *> items_;
+  vector<TubeGroup<BenchItem> *> tube_groups_;
+  vector<TubeConsumerGroup<BenchItem> *> task_groups_;
+  Tube<BenchItem> tube_sink_;
+};
+
+
+// The argument is the number of consumer threads per stage
+BENCHMARK_DEFINE_F(BM_IngestionTube, Pipeline)(benchmark::State &st) {
+  vector<BenchItem *> collected;
+  collected.reserve(kNumItems);
+  while (st.KeepRunning()) {
+    for (unsigned i = 0; i < kNumItems; ++i)
+      tube_groups_[0]->Dispatch(items_[i]);
+    collected.clear();
+    while (collected.size() < kNumItems)
+      tube_sink_.PopFrontBatch(kNumItems, &collected);
+  }
+  st.SetItemsProcessed(int64_t(st.iterations()) * kNumItems);
+}
+BENCHMARK_REGISTER_F(BM_IngestionTube, Pipeline)->Repetitions(3)
+  ->Arg(1)->Arg(4)->Arg(16)->UseRealTime();
@@ -0,0 +1,129 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+#define __STDC_FORMAT_MACROS
+#include <benchmark/benchmark.h>
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "lru.h"
+#include "statistics.h"
+#include "util/murmur.hxx"
+#include "util/prng.h"
+
+using namespace std;  // NOLINT
+
+/**
+ * Compares the mutex protected LruCache with the ShardedLruCache under
+ * concurrent lookups of a skewed key distribution, as produced by many
+ * processes stat'ing the same software stack.  A miss is followed by an
+ * insert.  The hit ratio is reported as the benchmark label.
+ */
+class BM_LruCache : public benchmark::Fixture {
+ protected:
+  virtual void SetUp(const benchmark::State &st) {
+    Prng prng;
+    prng.InitSeed(42);
+    keys_.resize(kNumKeys);
+    // Most lookups go to a hot set that is slightly larger than the cache
+    for (unsigned i = 0; i < kNumKeys; ++i) {
+      if (prng.Next(100) < kHotPercent)
+        keys_[i] = prng.Next(kNumHotKeys) + 1;
+      else
+        keys_[i] = prng.Next(kKeySpace) + kNumHotKeys + 1;
+    }
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    keys_.clear();
+  }
+
+  static inline uint32_t hasher_uint64t(const uint64_t &value) {
+    return MurmurHash2(&value, sizeof(value), 0x07387a4f);
+  }
+
+  template <class CacheT>
+  struct WorkerData {
+    CacheT *cache;
+    const vector<uint64_t> *keys;
+    unsigned offset;
+  };
+
+  template <class CacheT>
+  static void *MainWorker(void *data) {
+    WorkerData<CacheT> *worker_data =
+      reinterpret_cast<WorkerData<CacheT> *>(data);
+    const vector<uint64_t> &keys = *worker_data->keys;
+    uint64_t value;
+    for (unsigned i = 0; i < kNumOpsPerThread; ++i) {
+      const uint64_t key = keys[(worker_data->offset + i) % kNumKeys];
+      if (!worker_data->cache->Lookup(key, &value))
+        worker_data->cache->Insert(key, key);
+    }
+    return NULL;
+  }
+
+  template <class CacheT>
+  void Run(benchmark::State *st) {
+    const unsigned num_threads = st->range(0);
+    perf::Statistics statistics;
+    CacheT cache(kCacheSize, 0, hasher_uint64t,
+                 perf::StatisticsTemplate("lru", &statistics));
+    vector<pthread_t> threads(num_threads);
+    vector<WorkerData<CacheT> > worker_data(num_threads);
+    for (unsigned i = 0; i < num_threads; ++i) {
+      worker_data[i].cache = &cache;
+      worker_data[i].keys = &keys_;
+      worker_data[i].offset = i * (kNumKeys / num_threads);
+    }
+    while (st->KeepRunning()) {
+      for (unsigned i = 0; i < num_threads; ++i) {
+        int retval = pthread_create(&threads[i], NULL, MainWorker<CacheT>,
+                                    &worker_data[i]);
+        if (retval != 0)
+          abort();
+      }
+      for (unsigned i = 0; i < num_threads; ++i)
+        pthread_join(threads[i], NULL);
+    }
+    st->SetItemsProcessed(
+      int64_t(st->iterations()) * num_threads * kNumOpsPerThread);
+
+    const double num_hits = statistics.Lookup("lru.n_hit")->Get();
+    const double num_misses = statistics.Lookup("lru.n_miss")->Get();
+    char label[64];
+    snprintf(label, sizeof(label), "hit ratio %.4f",
+             num_hits / (num_hits + num_misses));
+    st->SetLabel(label);
+  }
+
+  static const unsigned kCacheSize = 16384;
+  static const unsigned kNumHotKeys = 20000;
+  static const unsigned kHotPercent = 90;
+  static const unsigned kKeySpace = 1000000;
+  static const unsigned kNumKeys = 1000000;
+  static const unsigned kNumOpsPerThread = 100000;
+
+  vector<uint64_t> keys_;
+};
+
+
+// The argument is the number of threads
+BENCHMARK_DEFINE_F(BM_LruCache, Mutex)(benchmark::State &st) {
+  Run<lru::LruCache<uint64_t, uint64_t> >(&st);
+}
+BENCHMARK_REGISTER_F(BM_LruCache, Mutex)->Repetitions(3)
+  ->Arg(1)->Arg(8)->Arg(32)->Arg(64)->UseRealTime();
+
+
+BENCHMARK_DEFINE_F(BM_LruCache, Sharded)(benchmark::State &st) {
+  Run<lru::ShardedLruCache<uint64_t, uint64_t> >(&st);
+}
+BENCHMARK_REGISTER_F(BM_LruCache, Sharded)->Repetitions(3)
+  ->Arg(1)->Arg(8)->Arg(32)->Arg(64)->UseRealTime();
@@ -0,0 +1,123 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+#include <benchmark/benchmark.h>
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bm_util.h"
+#include "crypto/hash.h"
+#include "quota.h"
+#include "quota_posix.h"
+#include "quota_sharded.h"
+#include "util/posix.h"
+#include "util/prng.h"
+
+/**
+ * Concurrent Touch() and Insert() calls against the quota manager backends.
+ * The first argument selects the backend (0: posix, 1: sharded), the second
+ * one the number of threads.  Every thread touches random entries of a
+ * populated cache and inserts a new entry every kInsertInterval operations.
+ * Each iteration ends with a GetSize() call, which makes the posix backend
+ * process the touches queued in its pipe.
+ */
+class BM_Quota : public benchmark::Fixture {
+ protected:
+  static const unsigned kNumEntries = 100000;
+  static const unsigned kOpsPerThread = 20000;
+  static const unsigned kInsertInterval = 16;
+
+  struct ThreadData {
+    QuotaManager *quota_mgr;
+    std::vector<shash::Any> *hashes;
+    uint64_t seed;
+  };
+
+  static void *MainWorker(void *data) {
+    ThreadData *td = reinterpret_cast<ThreadData *>(data);
+    Prng prng;
+    prng.InitSeed(td->seed);
+    std::vector<shash::Any> &hashes = *td->hashes;
+    for (unsigned i = 0; i < kOpsPerThread; ++i) {
+      if ((i % kInsertInterval) == 0) {
+        shash::Any hash(shash::kSha1);
+        hash.Randomize(&prng);
+        td->quota_mgr->Insert(hash, 1, "");
+      } else {
+        td->quota_mgr->Touch(hashes[prng.Next(hashes.size())]);
+      }
+    }
+    return NULL;
+  }
+
+  virtual void SetUp(const benchmark::State &st) {
+    tmp_path_ = CreateTempDir("/tmp/cvmfs_ubench_quota");
+    if (!MakeCacheDirectories(tmp_path_, 0700))
+      abort();
+    const uint64_t limit = 1024ULL * 1024ULL * 1024ULL * 1024ULL;
+    if (st.range(0) == 0) {
+      quota_mgr_ = PosixQuotaManager::Create(tmp_path_, limit, limit / 2,
+                                             false);
+    } else {
+      quota_mgr_ = ShardedQuotaManager::Create(tmp_path_, limit, limit / 2,
+                                               false);
+    }
+    if (quota_mgr_ == NULL)
+      abort();
+    quota_mgr_->Spawn();
+
+    Prng prng;
+    prng.InitSeed(42);
+    for (unsigned i = 0; i < kNumEntries; ++i) {
+      hashes_.push_back(shash::Any(shash::kSha1));
+      hashes_[i].Randomize(&prng);
+      quota_mgr_->Insert(hashes_[i], 1, "");
+    }
+    quota_mgr_->GetSize();
+    num_threads_ = st.range(1);
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    delete quota_mgr_;
+    hashes_.clear();
+    RemoveTree(tmp_path_);
+  }
+
+  std::string tmp_path_;
+  QuotaManager *quota_mgr_;
+  std::vector<shash::Any> hashes_;
+  unsigned num_threads_;
+};
+
+
+BENCHMARK_DEFINE_F(BM_Quota, TouchInsert)(benchmark::State &st) {
+  std::vector<pthread_t> threads(num_threads_);
+  std::vector<ThreadData> thread_data(num_threads_);
+  uint64_t seed = 0;
+  while (st.KeepRunning()) {
+    for (unsigned i = 0; i < num_threads_; ++i) {
+      thread_data[i].quota_mgr = quota_mgr_;
+      thread_data[i].hashes = &hashes_;
+      thread_data[i].seed = ++seed;
+      int retval = pthread_create(&threads[i], NULL, MainWorker,
+                                  &thread_data[i]);
+      if (retval != 0)
+        abort();
+    }
+    for (unsigned i = 0; i < num_threads_; ++i)
+      pthread_join(threads[i], NULL);
+    uint64_t size = quota_mgr_->GetSize();
+    Escape(&size);
+  }
+  st.SetItemsProcessed(
+    int64_t(st.iterations()) * num_threads_ * kOpsPerThread);
+}
+BENCHMARK_REGISTER_F(BM_Quota, TouchInsert)->Repetitions(3)
+  ->ArgPair(0, 1)->ArgPair(0, 4)->ArgPair(0, 16)
+  ->ArgPair(1, 1)->ArgPair(1, 4)->ArgPair(1, 16)
+  ->UseRealTime();
@@ -0,0 +1,68 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+#include <benchmark/benchmark.h>
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "bm_util.h"
+#include "statistics.h"
+
+/**
+ * Contended increments of a single counter.  The first argument selects the
+ * counter type (0: plain, 1: sharded), the second one the number of threads.
+ */
+class BM_Counter : public benchmark::Fixture {
+ protected:
+  static const unsigned kOpsPerThread = 1000000;
+
+  static void *MainWorker(void *data) {
+    perf::Counter *counter = reinterpret_cast<perf::Counter *>(data);
+    for (unsigned i = 0; i < kOpsPerThread; ++i)
+      perf::Inc(counter);
+    return NULL;
+  }
+
+  virtual void SetUp(const benchmark::State &st) {
+    statistics_ = new perf::Statistics();
+    if (st.range(0) == 0)
+      counter_ = statistics_->Register("test.counter", "a test counter");
+    else
+      counter_ = statistics_->RegisterSharded("test.counter", "a test counter");
+    num_threads_ = st.range(1);
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    delete statistics_;
+  }
+
+  perf::Statistics *statistics_;
+  perf::Counter *counter_;
+  unsigned num_threads_;
+};
+
+
+BENCHMARK_DEFINE_F(BM_Counter, Inc)(benchmark::State &st) {
+  std::vector<pthread_t> threads(num_threads_);
+  while (st.KeepRunning()) {
+    for (unsigned i = 0; i < num_threads_; ++i) {
+      int retval = pthread_create(&threads[i], NULL, MainWorker, counter_);
+      if (retval != 0)
+        abort();
+    }
+    for (unsigned i = 0; i < num_threads_; ++i)
+      pthread_join(threads[i], NULL);
+    int64_t value = counter_->Get();
+    Escape(&value);
+  }
+  st.SetItemsProcessed(
+    int64_t(st.iterations()) * num_threads_ * kOpsPerThread);
+}
+BENCHMARK_REGISTER_F(BM_Counter, Inc)->Repetitions(3)
+  ->ArgPair(0, 1)->ArgPair(0, 4)->ArgPair(0, 16)
+  ->ArgPair(1, 1)->ArgPair(1, 4)->ArgPair(1, 16)
+  ->UseRealTime();
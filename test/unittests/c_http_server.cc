@@ -423,3 +423,176 @@ HTTPResponse MockGateway::GatewayHandler(const HTTPRequest &req, void *data) {
   MockGateway *gateway = static_cast<MockGateway *>(data);
   return gateway->next_response_;
 }
+
+
+//------------------------------------------------------------------------------
+
+
+MockHttp2Server::MockHttp2Server(int port, const std::string &body)
+  : port_(port)
+  , body_(body)
+{
+  assert(body_.length() < 65535);
+  atomic_init32(&server_thread_ready_);
+  atomic_init32(&num_processed_requests_);
+  atomic_init32(&num_connections_);
+  atomic_init32(&running_);
+  atomic_write32(&running_, 1);
+  int retval = pthread_create(&server_thread_, NULL, Main, this);
+  assert(retval == 0);
+  while (!atomic_read32(&server_thread_ready_)) {}
+}
+
+MockHttp2Server::~MockHttp2Server() {
+  atomic_write32(&running_, 0);
+  pthread_join(server_thread_, NULL);
+}
+
+void MockHttp2Server::WriteFrame(
+  int fd,
+  unsigned char type,
+  unsigned char flags,
+  uint32_t stream_id,
+  const std::string &payload)
+{
+  unsigned char header[kFrameHeaderSize];
+  header[0] = (payload.length() >> 16) & 0xff;
+  header[1] = (payload.length() >> 8) & 0xff;
+  header[2] = payload.length() & 0xff;
+  header[3] = type;
+  header[4] = flags;
+  header[5] = (stream_id >> 24) & 0x7f;
+  header[6] = (stream_id >> 16) & 0xff;
+  header[7] = (stream_id >> 8) & 0xff;
+  header[8] = stream_id & 0xff;
+  std::string frame(reinterpret_cast<char *>(header), kFrameHeaderSize);
+  frame += payload;
+  bool retval = SafeWrite(fd, frame.data(), frame.length());
+  assert(retval);
+}
+
+/**
+ * Returns false if the connection should be closed.
+ */
+bool MockHttp2Server::ProcessFrame(
+  int fd,
+  unsigned char type,
+  unsigned char flags,
+  uint32_t stream_id,
+  const std::string &payload)
+{
+  switch (type) {
+    case kFrameSettings:
+      if (!(flags & kFlagAck))
+        WriteFrame(fd, kFrameSettings, kFlagAck, 0, "");
+      return true;
+    case kFramePing:
+      if (!(flags & kFlagAck))
+        WriteFrame(fd, kFramePing, kFlagAck, 0, payload);
+      return true;
+    case kFrameGoaway:
+      return false;
+    case kFrameHeaders: {
+      // A GET request fits into a single HEADERS frame without body
+      assert((flags & kFlagEndHeaders) && (flags & kFlagEndStream));
+      // HPACK: ":status: 200" from the static table (index 8), followed by
+      // "content-length" as a literal with the name from the static table
+      // (index 28)
+      const std::string content_length = StringifyUint(body_.length());
+      std::string header_block = "\x88\x0f\x0d";
+      header_block.push_back(static_cast<char>(content_length.length()));
+      header_block += content_length;
+      WriteFrame(fd, kFrameHeaders, kFlagEndHeaders, stream_id, header_block);
+      for (unsigned pos = 0; pos < body_.length(); pos += kMaxFrameSize) {
+        const bool is_last = (pos + kMaxFrameSize >= body_.length());
+        WriteFrame(fd, kFrameData, is_last ? kFlagEndStream : 0, stream_id,
+                   body_.substr(pos, kMaxFrameSize));
+      }
+      if (body_.empty())
+        WriteFrame(fd, kFrameData, kFlagEndStream, stream_id, "");
+      atomic_inc32(&num_processed_requests_);
+      return true;
+    }
+    default:
+      // WINDOW_UPDATE, PRIORITY, RST_STREAM, ...
+      return true;
+  }
+}
+
+void MockHttp2Server::ServeConnection(int fd) {
+  const std::string preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+  bool preface_seen = false;
+  std::string input;
+  WriteFrame(fd, kFrameSettings, 0, 0, "");
+
+  while (atomic_read32(&running_)) {
+    struct timeval select_timeout;
+    select_timeout.tv_sec = 0;
+    select_timeout.tv_usec = 2000;  // 2 ms
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    FD_SET(fd, &rfds);
+    int retval = select(fd + 1, &rfds, NULL, NULL, &select_timeout);
+    assert(retval >= 0);
+    if (retval == 0)
+      continue;
+
+    char buffer[4096];
+    ssize_t nbytes = read(fd, buffer, sizeof(buffer));
+    if (nbytes <= 0)
+      return;
+    input.append(buffer, nbytes);
+
+    if (!preface_seen) {
+      if (input.length() < preface.length())
+        continue;
+      assert(input.substr(0, preface.length()) == preface);
+      input.erase(0, preface.length());
+      preface_seen = true;
+    }
+    while (input.length() >= kFrameHeaderSize) {
+      const unsigned char *header =
+        reinterpret_cast<const unsigned char *>(input.data());
+      const unsigned length = (header[0] << 16) | (header[1] << 8) | header[2];
+      if (input.length() < kFrameHeaderSize + length)
+        break;
+      const uint32_t stream_id = ((header[5] & 0x7f) << 24) |
+        (header[6] << 16) | (header[7] << 8) | header[8];
+      const bool keep_open = ProcessFrame(fd, header[3], header[4], stream_id,
+        input.substr(kFrameHeaderSize, length));
+      input.erase(0, kFrameHeaderSize + length);
+      if (!keep_open)
+        return;
+    }
+  }
+}
+
+void *MockHttp2Server::Main(void *data) {
+  MockHttp2Server *server = static_cast<MockHttp2Server *>(data);
+  int listen_sockfd = MakeTcpEndpoint("", server->port_);
+  assert(listen_sockfd >= 0);
+  listen(listen_sockfd, 5);
+  atomic_inc32(&server->server_thread_ready_);
+
+  while (atomic_read32(&server->running_)) {
+    struct timeval select_timeout;
+    select_timeout.tv_sec = 0;
+    select_timeout.tv_usec = 2000;  // 2 ms
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    FD_SET(listen_sockfd, &rfds);
+    int retval = select(listen_sockfd + 1, &rfds, NULL, NULL, &select_timeout);
+    assert(retval >= 0);
+    if (retval == 0)
+      continue;
+
+    int accept_sockfd = accept(listen_sockfd, NULL, NULL);
+    if (accept_sockfd < 0)
+      continue;
+    atomic_inc32(&server->num_connections_);
+    server->ServeConnection(accept_sockfd);
+    close(accept_sockfd);
+  }
+  close(listen_sockfd);
+  return NULL;
+}
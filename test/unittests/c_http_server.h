@@ -222,4 +222,46 @@ class MockGateway {
   MockHTTPServer *server_;
 };
 
+// A minimal HTTP/2 server with prior knowledge (h2c).  Replies to every
+// request with the given body and keeps the connection open.  There is no
+// flow control, so the body needs to be smaller than 64kB.
+class MockHttp2Server {
+ public:
+  MockHttp2Server(int port, const std::string &body);
+  ~MockHttp2Server();
+  int num_processed_requests() {
+    return atomic_read32(&num_processed_requests_);
+  }
+  int num_connections() { return atomic_read32(&num_connections_); }
+
+ protected:
+  enum FrameTypes {
+    kFrameData = 0x0,
+    kFrameHeaders = 0x1,
+    kFrameSettings = 0x4,
+    kFramePing = 0x6,
+    kFrameGoaway = 0x7,
+  };
+  static const unsigned char kFlagAck = 0x1;
+  static const unsigned char kFlagEndStream = 0x1;
+  static const unsigned char kFlagEndHeaders = 0x4;
+  static const unsigned kFrameHeaderSize = 9;
+  static const unsigned kMaxFrameSize = 16384;
+
+  static void *Main(void *data);
+  void ServeConnection(int fd);
+  bool ProcessFrame(int fd, unsigned char type, unsigned char flags,
+                    uint32_t stream_id, const std::string &payload);
+  static void WriteFrame(int fd, unsigned char type, unsigned char flags,
+                         uint32_t stream_id, const std::string &payload);
+
+  int port_;
+  std::string body_;
+  atomic_int32 running_;
+  atomic_int32 server_thread_ready_;
+  atomic_int32 num_processed_requests_;
+  atomic_int32 num_connections_;
+  pthread_t server_thread_;
+};
+
 #endif  // TEST_UNITTESTS_C_HTTP_SERVER_H_
@@ -123,6 +123,14 @@ class IngestionMockUploader
 
   virtual int64_t DoGetObjectSize(const std::string &file_name) { return 0;}
 
+  virtual bool Peek(const std::string &path) {
+    for (unsigned i = 0; i < results.size(); ++i) {
+      if (path == "data/" + results[i].computed_hash.MakePath())
+        return true;
+    }
+    return false;
+  }
+
   Results results;
   bool keep_results;
 };
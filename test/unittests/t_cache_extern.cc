@@ -23,6 +23,7 @@
 #include "cache_extern.h"
 #include "cache_plugin/channel.h"
 #include "cache_transport.h"
+#include "compat.h"
 #include "crypto/hash.h"
 #include "util/posix.h"
 #include "util/smalloc.h"
@@ -36,17 +37,27 @@ class MockCachePlugin : public CachePlugin {
  public:
   static const unsigned kMockCacheSize;
   static const unsigned kMockListingNitems;
+  static const unsigned kMockShmSize;
 
-  MockCachePlugin(const string &socket_path, bool read_only)
+  MockCachePlugin(const string &socket_path, bool read_only,
+                  bool with_shm = false)
     : CachePlugin(read_only ? (cvmfs::CAP_ALL_V1 & ~cvmfs::CAP_WRITE)
-                            : cvmfs::CAP_ALL_V2)
+                            : (with_shm ? cvmfs::CAP_ALL_V3
+                                        : cvmfs::CAP_ALL_V2))
+    , shm_data(NULL)
   {
-    bool retval = Listen("unix=" + socket_path);
-    assert(retval);
-    ProcessRequests(0);
     known_object.algorithm = shash::kSha1;
     known_object_content = "Hello, World";
     shash::HashString(known_object_content, &known_object);
+    if (with_shm) {
+      shm_data = CreateShm(kMockShmSize);
+      assert(shm_data != NULL);
+      memcpy(shm_data, known_object_content.data(),
+             known_object_content.length());
+    }
+    bool retval = Listen("unix=" + socket_path);
+    assert(retval);
+    ProcessRequests(0);
     known_object_refcnt = 0;
     next_status = -1;
     listing_nitems = 0;
@@ -76,8 +87,21 @@ class MockCachePlugin : public CachePlugin {
   char *last_reponame;
   char *last_client_instance;
   std::map<std::string, manifest::Breadcrumb> breadcrumbs;
+  unsigned char *shm_data;
 
  protected:
+  virtual cvmfs::EnumStatus LocateShm(
+    const shash::Any &id,
+    uint64_t *offset,
+    uint64_t *size)
+  {
+    if (id != known_object)
+      return cvmfs::STATUS_NOENTRY;
+    *offset = 0;
+    *size = known_object_content.length();
+    return cvmfs::STATUS_OK;
+  }
+
   virtual cvmfs::EnumStatus ChangeRefcount(
     const shash::Any &id,
     int32_t change_by)
@@ -232,6 +256,7 @@ class MockCachePlugin : public CachePlugin {
 
 const unsigned MockCachePlugin::kMockCacheSize = 10 * 1024 * 1024;
 const unsigned MockCachePlugin::kMockListingNitems = 100000;
+const unsigned MockCachePlugin::kMockShmSize = 4096;
 
 
 class T_ExternalCacheManager : public ::testing::Test {
@@ -393,6 +418,89 @@ TEST_F(T_ExternalCacheManager, Pread) {
 }
 
 
+TEST_F(T_ExternalCacheManager, Preadv) {
+  EXPECT_LE(2U, cache_mgr_->protocol_version());
+  const string &content = mock_plugin_->known_object_content;
+  int fd = cache_mgr_->Open(CacheManager::Bless(mock_plugin_->known_object));
+  EXPECT_GE(fd, 0);
+
+  char buf_full[64];
+  char buf_tail[64];
+  char buf_oob[64];
+  char buf_badf[64];
+  char buf_empty[1];
+  vector<ExternalCacheManager::ReadRange> ranges;
+  ranges.push_back(ExternalCacheManager::ReadRange(fd, buf_full, 64, 0));
+  ranges.push_back(ExternalCacheManager::ReadRange(fd, buf_tail, 5, 7));
+  ranges.push_back(ExternalCacheManager::ReadRange(fd, buf_oob, 1, 64));
+  ranges.push_back(ExternalCacheManager::ReadRange(-1, buf_badf, 1, 0));
+  ranges.push_back(ExternalCacheManager::ReadRange(fd, buf_empty, 0, 0));
+
+  for (unsigned i = 0; i < 2; ++i) {
+    // Synchronous and pipelined
+    if (i == 1)
+      cache_mgr_->Spawn();
+    memset(buf_full, 0, sizeof(buf_full));
+    memset(buf_tail, 0, sizeof(buf_tail));
+    cache_mgr_->Preadv(&ranges);
+    EXPECT_EQ(static_cast<int>(content.length()), ranges[0].result);
+    EXPECT_EQ(content, string(buf_full, content.length()));
+    EXPECT_EQ(5, ranges[1].result);
+    EXPECT_EQ(content.substr(7, 5), string(buf_tail, 5));
+    EXPECT_EQ(-EINVAL, ranges[2].result);
+    EXPECT_EQ(-EBADF, ranges[3].result);
+    EXPECT_EQ(0, ranges[4].result);
+  }
+
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+}
+
+
+TEST_F(T_ExternalCacheManager, SharedMemory) {
+  delete cache_mgr_;
+  unlink(socket_path_.c_str());
+  delete mock_plugin_;
+  mock_plugin_ = new MockCachePlugin(socket_path_, false, true);
+  fd_client = ConnectSocket(socket_path_);
+  ASSERT_GE(fd_client, 0);
+  cache_mgr_ = ExternalCacheManager::Create(fd_client, nfiles, "test");
+  ASSERT_TRUE(cache_mgr_ != NULL);
+  quota_mgr_ = ExternalQuotaManager::Create(cache_mgr_);
+  cache_mgr_->AcquireQuotaManager(quota_mgr_);
+  EXPECT_EQ(3U, cache_mgr_->protocol_version());
+  cache_mgr_->Spawn();
+
+  const string content = mock_plugin_->known_object_content;
+  int fd = cache_mgr_->Open(CacheManager::Bless(mock_plugin_->known_object));
+  EXPECT_GE(fd, 0);
+  char buf[64];
+  EXPECT_EQ(static_cast<int>(content.length()),
+            cache_mgr_->Pread(fd, buf, sizeof(buf), 0));
+  EXPECT_EQ(content, string(buf, content.length()));
+  EXPECT_EQ(-EINVAL, cache_mgr_->Pread(fd, buf, 1, content.length() + 1));
+
+  // Reads are served from the shared memory region, not from the socket
+  mock_plugin_->shm_data[0] = 'J';
+  EXPECT_EQ(5, cache_mgr_->Pread(fd, buf, 5, 0));
+  EXPECT_EQ("Jello", string(buf, 5));
+
+  // After the plugin moved data, the location is stale and reads fall back
+  // to the socket until the object is reopened
+  mock_plugin_->BeginShmMove();
+  mock_plugin_->EndShmMove();
+  EXPECT_EQ(5, cache_mgr_->Pread(fd, buf, 5, 0));
+  EXPECT_EQ("Hello", string(buf, 5));
+  int fd_dup = cache_mgr_->Dup(fd);
+  EXPECT_GE(fd_dup, 0);
+  EXPECT_EQ(5, cache_mgr_->Pread(fd_dup, buf, 5, 0));
+  EXPECT_EQ("Jello", string(buf, 5));
+
+  EXPECT_EQ(0, cache_mgr_->Close(fd_dup));
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+  EXPECT_EQ(0, mock_plugin_->known_object_refcnt);
+}
+
+
 TEST_F(T_ExternalCacheManager, Readahead) {
   EXPECT_EQ(-EBADF, cache_mgr_->Readahead(0));
   int fd = cache_mgr_->Open(CacheManager::Bless(mock_plugin_->known_object));
@@ -696,3 +804,36 @@ TEST_F(T_ExternalCacheManager, SaveState) {
   EXPECT_EQ(0, strcmp(mock_plugin_->last_reponame, "test"));
   EXPECT_EQ(NULL, mock_plugin_->last_client_instance);
 }
+
+
+TEST_F(T_ExternalCacheManager, RestoreOldState) {
+  int fd = cache_mgr_->Open(CacheManager::Bless(mock_plugin_->known_object));
+  EXPECT_GE(fd, 0);
+  // File descriptor table as saved by a version 0 cache manager state
+  FdTable<compat::cache_extern::ReadOnlyHandle> *old_fd_table =
+    new FdTable<compat::cache_extern::ReadOnlyHandle>(
+      nfiles, compat::cache_extern::ReadOnlyHandle());
+  EXPECT_EQ(fd, old_fd_table->OpenFd(
+    compat::cache_extern::ReadOnlyHandle(mock_plugin_->known_object)));
+  void *data = cache_mgr_->SaveState(-1);
+  delete cache_mgr_;
+  fd_client = ConnectSocket(socket_path_);
+  ASSERT_GE(fd_client, 0);
+  cache_mgr_ = ExternalCacheManager::Create(fd_client, nfiles, "test");
+  ASSERT_TRUE(cache_mgr_ != NULL);
+  quota_mgr_ = ExternalQuotaManager::Create(cache_mgr_);
+  ASSERT_TRUE(cache_mgr_ != NULL);
+  cache_mgr_->AcquireQuotaManager(quota_mgr_);
+
+  EXPECT_EQ(-1, cache_mgr_->DoRestoreOldState(old_fd_table, 0));
+  EXPECT_TRUE(cache_mgr_->DoFreeOldState(old_fd_table, 0));
+  cache_mgr_->FreeState(-1, data);
+  EXPECT_EQ(mock_plugin_->known_object,
+            cache_mgr_->fd_table_.GetHandle(fd).id);
+  EXPECT_FALSE(cache_mgr_->fd_table_.GetHandle(fd).HasShmLocation());
+  char buffer[64];
+  int64_t len = cache_mgr_->Pread(fd, buffer, 64, 0);
+  EXPECT_EQ(static_cast<int>(mock_plugin_->known_object_content.length()), len);
+  EXPECT_EQ(mock_plugin_->known_object_content, string(buffer, len));
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+}
@@ -4,6 +4,7 @@
 
 #include <alloca.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <string.h>
 #include <gtest/gtest.h>
@@ -91,6 +92,64 @@ TEST_F(T_RamCacheManager, Read) {
   EXPECT_EQ(0, ramcache_.Close(fd));
 }
 
+struct ReaderData {
+  RamCacheManager *cache;
+  int fd;
+  int nerrors;
+};
+
+static void *MainReader(void *data) {
+  ReaderData *d = reinterpret_cast<ReaderData *>(data);
+  char out[alloc_size];
+  for (unsigned i = 0; i < 10000; ++i) {
+    memset(out, 0, alloc_size);
+    if ((d->cache->Pread(d->fd, out, alloc_size, 0) != alloc_size) ||
+        (out[0] != 42) || (out[alloc_size - 1] != 42))
+    {
+      d->nerrors++;
+    }
+  }
+  return NULL;
+}
+
+TEST_F(T_RamCacheManager, ConcurrentRead) {
+  int fd;
+  char buf[alloc_size];
+  memset(buf, 42, alloc_size);
+  void *txn = alloca(ramcache_.SizeOfTxn());
+  EXPECT_EQ(0, ramcache_.StartTxn(a_, alloc_size, txn));
+  EXPECT_EQ(alloc_size, ramcache_.Write(buf, alloc_size, txn));
+  EXPECT_EQ(0, ramcache_.CommitTxn(txn));
+  EXPECT_GE((fd = ramcache_.Open(CacheManager::Bless(a_))), 0);
+
+  const unsigned kNumReaders = 4;
+  pthread_t threads[kNumReaders];
+  ReaderData data[kNumReaders];
+  for (unsigned i = 0; i < kNumReaders; ++i) {
+    data[i].cache = &ramcache_;
+    data[i].fd = fd;
+    data[i].nerrors = 0;
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, MainReader, &data[i]));
+  }
+
+  // Meanwhile, keep committing and evicting other objects
+  shash::Any b;
+  char other[alloc_size];
+  memset(other, 1, alloc_size);
+  for (unsigned i = 0; i < 1000; ++i) {
+    b.digest[1] = 2 + (i % 8);
+    EXPECT_EQ(0, ramcache_.StartTxn(b, alloc_size, txn));
+    EXPECT_EQ(alloc_size, ramcache_.Write(other, alloc_size, txn));
+    EXPECT_EQ(0, ramcache_.CommitTxn(txn));
+  }
+
+  for (unsigned i = 0; i < kNumReaders; ++i) {
+    pthread_join(threads[i], NULL);
+    EXPECT_EQ(0, data[i].nerrors);
+  }
+  EXPECT_EQ(0, ramcache_.Close(fd));
+}
+
 TEST_F(T_RamCacheManager, OpenFromTxn) {
   int fd;
   char buf[alloc_size];
@@ -4,11 +4,14 @@
 
 #include <gtest/gtest.h>
 
+#include <unistd.h>
+
 #include "cache.h"
 #include "cache_ram.h"
 #include "cache_tiered.h"
 #include "crypto/hash.h"
 #include "statistics.h"
+#include "util/posix.h"
 
 using namespace std;  // NOLINT
 
@@ -21,7 +24,9 @@ class T_TieredCacheManager : public ::testing::Test {
     lower_cache_ =
       new RamCacheManager(1024, 128, MemoryKvStore::kMallocLibc,
                           perf::StatisticsTemplate("test", &stats_lower_));
-    tiered_cache_ = TieredCacheManager::Create(upper_cache_, lower_cache_);
+    tiered_cache_ = TieredCacheManager::Create(
+      upper_cache_, lower_cache_,
+      perf::StatisticsTemplate("tiered", &stats_tiered_));
     EXPECT_FALSE(tiered_cache_->LoadBreadcrumb("test").IsValid());
     buf_ = 'x';
     hash_one_.digest[1] = 1;
@@ -33,6 +38,7 @@ class T_TieredCacheManager : public ::testing::Test {
 
   perf::Statistics stats_upper_;
   perf::Statistics stats_lower_;
+  perf::Statistics stats_tiered_;
   CacheManager *tiered_cache_;
   RamCacheManager *upper_cache_;
   RamCacheManager *lower_cache_;
@@ -79,6 +85,52 @@ TEST_F(T_TieredCacheManager, CopyUp) {
 }
 
 
+TEST_F(T_TieredCacheManager, AsyncPromotion) {
+  TieredCacheManager *tiered =
+    reinterpret_cast<TieredCacheManager *>(tiered_cache_);
+  tiered->SetNumPromotionThreads(2);
+  tiered->Spawn();
+
+  EXPECT_TRUE(lower_cache_->CommitFromMem(hash_one_, &buf_, 1, "one"));
+  int fd = tiered_cache_->Open(CacheManager::Bless(hash_one_));
+  EXPECT_GE(fd, 0);
+  EXPECT_TRUE(fd & TieredCacheManager::kLowerFdFlag);
+  EXPECT_EQ(1, stats_tiered_.Lookup("tiered.n_open_lower")->Get());
+
+  EXPECT_EQ(1, tiered_cache_->GetSize(fd));
+  unsigned char buf;
+  EXPECT_EQ(1, tiered_cache_->Pread(fd, &buf, 1, 0));
+  EXPECT_EQ(buf_, buf);
+  int fd_dup = tiered_cache_->Dup(fd);
+  EXPECT_TRUE(fd_dup & TieredCacheManager::kLowerFdFlag);
+  EXPECT_EQ(0, tiered_cache_->Close(fd_dup));
+  EXPECT_EQ(0, tiered_cache_->Close(fd));
+
+  perf::Counter *n_promoted = stats_tiered_.Lookup("tiered.n_promoted");
+  for (unsigned i = 0; (i < 1000) && (n_promoted->Get() == 0); ++i)
+    SafeSleepMs(10);
+  EXPECT_EQ(1, n_promoted->Get());
+  EXPECT_EQ(1, stats_tiered_.Lookup("tiered.sz_promoted")->Get());
+  EXPECT_EQ(0, stats_tiered_.Lookup("tiered.sz_promotion_queue")->Get());
+
+  fd = tiered_cache_->Open(CacheManager::Bless(hash_one_));
+  EXPECT_GE(fd, 0);
+  EXPECT_FALSE(fd & TieredCacheManager::kLowerFdFlag);
+  EXPECT_EQ(0, tiered_cache_->Close(fd));
+
+  // Catalogs are copied synchronously
+  shash::Any hash_two;
+  hash_two.digest[1] = 2;
+  EXPECT_TRUE(lower_cache_->CommitFromMem(hash_two, &buf_, 1, "two"));
+  fd = tiered_cache_->Open(
+    CacheManager::Bless(hash_two, CacheManager::kTypeCatalog));
+  EXPECT_GE(fd, 0);
+  EXPECT_FALSE(fd & TieredCacheManager::kLowerFdFlag);
+  EXPECT_EQ(0, tiered_cache_->Close(fd));
+  EXPECT_EQ(1, stats_tiered_.Lookup("tiered.n_open_lower")->Get());
+}
+
+
 TEST_F(T_TieredCacheManager, Transaction) {
   EXPECT_EQ(-ENOENT, tiered_cache_->Open(CacheManager::Bless(hash_one_)));
   EXPECT_TRUE(tiered_cache_->CommitFromMem(hash_one_, &buf_, 1, "one"));
@@ -4,15 +4,20 @@
 
 #include <gtest/gtest.h>
 
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "cache_posix.h"
 #include "catalog.h"
 #include "catalog_rw.h"
 #include "compression.h"
 #include "crypto/hash.h"
 #include "shortstring.h"
+#include "sqlitevfs.h"
+#include "statistics.h"
 #include "testutil.h"
+#include "util/pointer.h"
 #include "util/posix.h"
 
 using namespace std;  // NOLINT
@@ -367,6 +372,185 @@ TEST_F(T_Catalog, Listing) {
     EXPECT_NE(NameString("hidden"), root_stat_entry_list.At(i).name);
 }
 
+TEST_F(T_Catalog, Readers) {
+  catalog = catalog::Catalog::AttachFreely("",
+                                           catalog_db_root,
+                                           shash::Any(),
+                                           NULL,
+                                           false);
+  nested = catalog::Catalog::AttachFreely(nested_path,
+                                          catalog_db_nested,
+                                          shash::Any(),
+                                          catalog,
+                                          true);
+  DirectoryEntry dirent;
+  EXPECT_TRUE(catalog->LookupPath(PathString("/dir/dir"), &dirent));
+  EXPECT_EQ(0u, catalog->num_readers_);
+
+  // Simulate a concurrent lookup that keeps the main connection busy
+  pthread_mutex_lock(catalog->lock_);
+  EXPECT_TRUE(catalog->LookupPath(PathString("/dir/dir"), &dirent));
+  EXPECT_EQ(NameString("dir"), dirent.name());
+  EXPECT_FALSE(catalog->LookupPath(PathString("/fakepath"), &dirent));
+  StatEntryList listing;
+  EXPECT_TRUE(catalog->ListingPathStat(PathString("/dir/dir"), &listing));
+  EXPECT_EQ(3u, listing.size());
+  EXPECT_EQ(1u, catalog->num_readers_);
+  EXPECT_EQ(1u, catalog->idle_readers_.size());
+  pthread_mutex_unlock(catalog->lock_);
+
+  DirectoryEntry unlocked_dirent;
+  EXPECT_TRUE(nested->LookupPath(PathString(nested_path + "/file1"),
+                                 &unlocked_dirent));
+  pthread_mutex_lock(nested->lock_);
+  EXPECT_TRUE(nested->LookupPath(PathString(nested_path + "/file1"), &dirent));
+  EXPECT_EQ(unlocked_dirent.name(), dirent.name());
+  EXPECT_EQ(unlocked_dirent.checksum(), dirent.checksum());
+  EXPECT_EQ(1u, nested->num_readers_);
+  pthread_mutex_unlock(nested->lock_);
+}
+
+TEST_F(T_Catalog, ReaderLimits) {
+  catalog = catalog::Catalog::AttachFreely("",
+                                           catalog_db_root,
+                                           shash::Any(),
+                                           NULL,
+                                           false);
+  const int32_t num_readers_total = atomic_read32(&Catalog::num_readers_total_);
+
+  // Readers beyond kMaxIdleReaders are closed once they are returned
+  vector<Catalog::Reader *> readers;
+  for (unsigned i = 0; i < Catalog::kMaxReaders; ++i) {
+    readers.push_back(catalog->AcquireReader());
+    ASSERT_TRUE(readers.back() != NULL);
+  }
+  EXPECT_EQ(NULL, catalog->AcquireReader());
+  EXPECT_EQ(num_readers_total + static_cast<int32_t>(Catalog::kMaxReaders),
+            atomic_read32(&Catalog::num_readers_total_));
+  for (unsigned i = 0; i < readers.size(); ++i)
+    catalog->UnlockReader(readers[i]);
+  EXPECT_EQ(Catalog::kMaxIdleReaders, catalog->num_readers_);
+  EXPECT_EQ(Catalog::kMaxIdleReaders, catalog->idle_readers_.size());
+  EXPECT_EQ(num_readers_total + static_cast<int32_t>(Catalog::kMaxIdleReaders),
+            atomic_read32(&Catalog::num_readers_total_));
+
+  // Idle readers are reused, new ones are subject to the global limit
+  Catalog::Reader *reader1 = catalog->AcquireReader();
+  Catalog::Reader *reader2 = catalog->AcquireReader();
+  EXPECT_TRUE((reader1 != NULL) && (reader2 != NULL));
+  atomic_write32(&Catalog::num_readers_total_,
+                 static_cast<int32_t>(Catalog::kMaxReadersTotal));
+  EXPECT_EQ(NULL, catalog->AcquireReader());
+  EXPECT_EQ(Catalog::kMaxIdleReaders, catalog->num_readers_);
+  atomic_write32(&Catalog::num_readers_total_,
+                 num_readers_total + Catalog::kMaxIdleReaders);
+  catalog->UnlockReader(reader1);
+  catalog->UnlockReader(reader2);
+
+  delete catalog;
+  catalog = NULL;
+  EXPECT_EQ(num_readers_total, atomic_read32(&Catalog::num_readers_total_));
+}
+
+TEST_F(T_Catalog, Mmap) {
+  // Open the catalog through the read-only VFS like the client does
+  ASSERT_TRUE(MkdirDeep(sandbox + "/cache", 0700));
+  UniquePtr<PosixCacheManager> cache_mgr(
+    PosixCacheManager::Create(sandbox + "/cache", false));
+  ASSERT_TRUE(cache_mgr.IsValid());
+  shash::Any catalog_hash(shash::kSha1);
+  ASSERT_TRUE(shash::HashFile(catalog_db_root, &catalog_hash));
+  string content;
+  const int fd_catalog = open(catalog_db_root.c_str(), O_RDONLY);
+  ASSERT_GE(fd_catalog, 0);
+  ASSERT_TRUE(SafeReadToString(fd_catalog, &content));
+  close(fd_catalog);
+  ASSERT_TRUE(cache_mgr->CommitFromMem(
+    catalog_hash, reinterpret_cast<const unsigned char *>(content.data()),
+    content.size(), "catalog"));
+
+  perf::Statistics statistics;
+  sqlite3_vfs *default_vfs = sqlite3_vfs_find(NULL);
+  ASSERT_TRUE(sqlite::RegisterVfsRdOnly(cache_mgr.weak_ref(), &statistics,
+                                        sqlite::kVfsOptDefault));
+  const int fd = cache_mgr->Open(CacheManager::Bless(catalog_hash));
+  ASSERT_GE(fd, 0);
+  catalog = Catalog::AttachFreely("", "@" + StringifyInt(fd), catalog_hash,
+                                  NULL, false);
+  ASSERT_TRUE(catalog != NULL);
+
+  DirectoryEntry dirent;
+  EXPECT_TRUE(catalog->LookupPath(PathString("/dir/dir/bar"), &dirent));
+  EXPECT_EQ(NameString("bar"), dirent.name());
+  // SQlite requests pages from the VFS only if mmap_size is set
+  EXPECT_EQ(1, statistics.Lookup("sqlite.n_mmap")->Get());
+
+  // Readers map the catalog through their own file descriptor.  Duplicating
+  // the descriptor needs the main connection, so the reader is opened first.
+  Catalog::Reader *reader = catalog->AcquireReader();
+  ASSERT_TRUE(reader != NULL);
+  catalog->UnlockReader(reader);
+  pthread_mutex_lock(catalog->lock_);
+  EXPECT_TRUE(catalog->LookupPath(PathString("/dir/dir/bar2"), &dirent));
+  EXPECT_EQ(NameString("bar2"), dirent.name());
+  pthread_mutex_unlock(catalog->lock_);
+  EXPECT_EQ(1u, catalog->num_readers_);
+  EXPECT_EQ(2, statistics.Lookup("sqlite.n_mmap")->Get());
+
+  delete catalog;
+  catalog = NULL;
+  EXPECT_EQ(0, statistics.Lookup("sqlite.no_open")->Get());
+  EXPECT_TRUE(sqlite::UnregisterVfsRdOnly());
+  sqlite3_vfs_register(default_vfs, 1);
+}
+
+TEST_F(T_Catalog, PathFilter) {
+  WritableCatalog *writable_catalog =
+    WritableCatalog::AttachFreely("", catalog_db_root, shash::Any(), NULL,
+                                  false);
+  ASSERT_TRUE(writable_catalog != NULL);
+  writable_catalog->Transaction();
+  writable_catalog->UpdatePathFilter(true);
+  writable_catalog->Commit();
+  // Writable catalogs change, they never use the filter
+  EXPECT_EQ(NULL, writable_catalog->path_filter_);
+  delete writable_catalog;
+
+  DirectoryEntry dirent;
+  catalog = Catalog::AttachFreely("", catalog_db_root, shash::Any(), NULL,
+                                  false);
+  ASSERT_TRUE(catalog->path_filter_ != NULL);
+  EXPECT_TRUE(catalog->LookupPath(PathString("/dir/dir/bar"), &dirent));
+  EXPECT_TRUE(catalog->LookupPath(PathString("/hidden"), &dirent));
+  EXPECT_TRUE(catalog->LookupPath(PathString(nested_path), &dirent));
+  EXPECT_FALSE(catalog->LookupPath(PathString("/fakepath"), &dirent));
+  delete catalog;
+  catalog = NULL;
+
+  // A filter of a previous revision is ignored
+  writable_catalog = WritableCatalog::AttachFreely("", catalog_db_root,
+                                                   shash::Any(), NULL, false);
+  writable_catalog->Transaction();
+  writable_catalog->IncrementRevision();
+  writable_catalog->Commit();
+  delete writable_catalog;
+  catalog = Catalog::AttachFreely("", catalog_db_root, shash::Any(), NULL,
+                                  false);
+  EXPECT_EQ(NULL, catalog->path_filter_);
+  EXPECT_TRUE(catalog->LookupPath(PathString("/dir/dir/bar"), &dirent));
+  delete catalog;
+  catalog = NULL;
+
+  writable_catalog = WritableCatalog::AttachFreely("", catalog_db_root,
+                                                   shash::Any(), NULL, false);
+  writable_catalog->Transaction();
+  writable_catalog->UpdatePathFilter(false);
+  writable_catalog->Commit();
+  EXPECT_FALSE(
+    writable_catalog->database().HasProperty(Catalog::kPathFilterKey));
+  delete writable_catalog;
+}
+
 TEST_F(T_Catalog, Chunks) {
   catalog = catalog::Catalog::AttachFreely("",
                                            catalog_db_root,
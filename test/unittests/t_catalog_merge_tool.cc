@@ -58,6 +58,7 @@ receiver::Params MakeMergeToolParams(const std::string& name) {
   params.avg_chunk_size = 8388608;
   params.max_chunk_size = 16777216;
   params.enforce_limits = false;
+  params.path_filters = false;
   params.nested_kcatalog_limit = 0;
   params.root_kcatalog_limit = 0;
   params.file_mbyte_limit = 0;
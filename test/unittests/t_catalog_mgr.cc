@@ -322,6 +322,22 @@ TEST_F(T_CatalogManager, Balance) {
                                       kLookupDefault, &dirent));
 }
 
+TEST_F(T_CatalogManager, Incarnation) {
+  catalog::DirectoryEntry dirent;
+  ASSERT_TRUE(catalog_mgr_.Init());
+  AddTree();
+  const uint64_t incarnation = catalog_mgr_.GetIncarnation();
+  EXPECT_TRUE(catalog_mgr_.LookupPath("/dir/dir/dir/file4", kLookupDefault,
+                                      &dirent));
+  EXPECT_EQ(2, catalog_mgr_.GetNumCatalogs());
+  EXPECT_EQ(incarnation, catalog_mgr_.GetIncarnation());
+
+  // The nested catalog would get new inodes when it is attached again
+  catalog_mgr_.DetachNested();
+  EXPECT_EQ(1, catalog_mgr_.GetNumCatalogs());
+  EXPECT_LT(incarnation, catalog_mgr_.GetIncarnation());
+}
+
 TEST_F(T_CatalogManager, Remount) {
   EXPECT_TRUE(catalog_mgr_.Init());
   LoadError le;
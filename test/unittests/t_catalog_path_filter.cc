@@ -0,0 +1,80 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "catalog_path_filter.h"
+#include "crypto/hash.h"
+#include "util/pointer.h"
+#include "util/string.h"
+
+using namespace std;  // NOLINT
+
+namespace catalog {
+
+static shash::Md5 MkPath(const unsigned i) {
+  return shash::Md5(shash::AsciiPtr("/path/" + StringifyInt(i)));
+}
+
+
+TEST(T_CatalogPathFilter, Basics) {
+  const unsigned N = 10000;
+  PathFilter filter(N);
+  EXPECT_EQ(0u, filter.num_bits() % 64);
+  EXPECT_LE(N * PathFilter::kBitsPerEntry, filter.num_bits());
+
+  for (unsigned i = 0; i < N; ++i) {
+    EXPECT_FALSE(filter.MayContain(MkPath(i)) && (i == 0));
+    filter.Add(MkPath(i));
+  }
+  for (unsigned i = 0; i < N; ++i)
+    EXPECT_TRUE(filter.MayContain(MkPath(i)));
+
+  unsigned false_positives = 0;
+  for (unsigned i = N; i < 2 * N; ++i) {
+    if (filter.MayContain(MkPath(i)))
+      false_positives++;
+  }
+  // About 1% expected
+  EXPECT_LT(false_positives, N / 30);
+}
+
+
+TEST(T_CatalogPathFilter, Empty) {
+  PathFilter filter(0);
+  EXPECT_EQ(64u, filter.num_bits());
+  EXPECT_FALSE(filter.MayContain(MkPath(0)));
+  filter.Add(MkPath(0));
+  EXPECT_TRUE(filter.MayContain(MkPath(0)));
+}
+
+
+TEST(T_CatalogPathFilter, Serialize) {
+  const unsigned N = 1000;
+  PathFilter filter(N);
+  for (unsigned i = 0; i < N; ++i)
+    filter.Add(MkPath(i));
+
+  const string data = filter.Serialize();
+  EXPECT_EQ(2 + filter.num_bits() / 8, data.length());
+  UniquePtr<PathFilter> restored(PathFilter::Deserialize(data));
+  ASSERT_TRUE(restored.IsValid());
+  EXPECT_EQ(filter.num_bits(), restored->num_bits());
+  EXPECT_EQ(data, restored->Serialize());
+  for (unsigned i = 0; i < 2 * N; ++i)
+    EXPECT_EQ(filter.MayContain(MkPath(i)), restored->MayContain(MkPath(i)));
+
+  EXPECT_EQ(NULL, PathFilter::Deserialize(""));
+  EXPECT_EQ(NULL, PathFilter::Deserialize(data.substr(0, data.length() - 1)));
+  string wrong_version = data;
+  wrong_version[0] = 0;
+  EXPECT_EQ(NULL, PathFilter::Deserialize(wrong_version));
+  string no_hashes = data;
+  no_hashes[1] = 0;
+  EXPECT_EQ(NULL, PathFilter::Deserialize(no_hashes));
+}
+
+}  // namespace catalog
@@ -17,7 +17,14 @@ class T_CatalogSql : public ::testing::Test {
   }
 };
 
+static void RevertToRevision6(catalog::CatalogDatabase *db) {
+  ASSERT_TRUE(sqlite::Sql(db->sqlite_db(),
+    "UPDATE properties SET value=6 WHERE key='schema_revision';").Execute());
+}
+
 static void RevertToRevision5(catalog::CatalogDatabase *db) {
+  RevertToRevision6(db);
+
   ASSERT_TRUE(sqlite::Sql(db->sqlite_db(),
     "UPDATE properties SET value=5 WHERE key='schema_revision';").Execute());
 }
@@ -132,7 +139,7 @@ TEST_F(T_CatalogSql, SchemaMigration) {
   fclose(ftmp);
   UnlinkGuard unlink_guard(path);
 
-  // Revision 1 --> 6
+  // Revision 1 --> 7
   {
     UniquePtr<catalog::CatalogDatabase>
       db(catalog::CatalogDatabase::Create(path));
@@ -150,7 +157,7 @@ TEST_F(T_CatalogSql, SchemaMigration) {
     sqlite::Sql sql2(db->sqlite_db(),
       "SELECT value FROM properties WHERE key='schema_revision'");
     ASSERT_TRUE(sql2.FetchRow());
-    EXPECT_EQ(6, sql2.RetrieveInt(0));
+    EXPECT_EQ(7, sql2.RetrieveInt(0));
     sqlite::Sql sql3(db->sqlite_db(),
       "SELECT value FROM statistics WHERE counter='self_xattr'");
     ASSERT_TRUE(sql3.FetchRow());
@@ -173,7 +180,7 @@ TEST_F(T_CatalogSql, SchemaMigration) {
     EXPECT_EQ(0, sql7.RetrieveInt(0));
   }
 
-  // Revision 0 --> 6
+  // Revision 0 --> 7
   {
     UniquePtr<catalog::CatalogDatabase> db(catalog::CatalogDatabase::Open(
       path, catalog::CatalogDatabase::kOpenReadWrite));
@@ -194,7 +201,7 @@ TEST_F(T_CatalogSql, SchemaMigration) {
     sqlite::Sql sql3(db->sqlite_db(),
       "SELECT value FROM properties WHERE key='schema_revision'");
     ASSERT_TRUE(sql3.FetchRow());
-    EXPECT_EQ(6, sql3.RetrieveInt(0));
+    EXPECT_EQ(7, sql3.RetrieveInt(0));
     sqlite::Sql sql4(db->sqlite_db(),
       "SELECT value FROM statistics WHERE counter='self_xattr'");
     ASSERT_TRUE(sql4.FetchRow());
@@ -5,6 +5,8 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <set>
+#include <string>
 #include <vector>
 
 #include "ingestion/chunk_detector.h"
@@ -309,3 +311,156 @@ TEST_F(T_ChunkDetectors, Xor32ChunkDetectorZerosBufferPowerOfTwo) {
     }
   }
 }
+
+
+TEST_F(T_ChunkDetectors, FastCdcMasks) {
+  EXPECT_EQ(0u, FastCdcDetector::MakeMask(0));
+  EXPECT_EQ(0x8000000000000000ULL, FastCdcDetector::MakeMask(1));
+  EXPECT_EQ(0xFFF0000000000000ULL, FastCdcDetector::MakeMask(12));
+  EXPECT_EQ(~uint64_t(0), FastCdcDetector::MakeMask(64));
+
+  // 2^20 <= avg < 2^21
+  FastCdcDetector detector(512000, 1024000 * 2, 1024000 * 4);
+  EXPECT_EQ(FastCdcDetector::MakeMask(20 + 2), detector.mask_strict_);
+  EXPECT_EQ(FastCdcDetector::MakeMask(20 - 2), detector.mask_loose_);
+
+  FastCdcDetector tiny(64, 65, 66);
+  EXPECT_EQ(FastCdcDetector::MakeMask(8), tiny.mask_strict_);
+  EXPECT_EQ(FastCdcDetector::MakeMask(4), tiny.mask_loose_);
+}
+
+
+TEST_F(T_ChunkDetectors, FastCdcChunkDetectorSlow) {
+  const size_t base = 512000;
+  const size_t min_chk_size = base;
+  const size_t avg_chk_size = base * 2;
+  const size_t max_chk_size = base * 4;
+  FastCdcDetector fastcdc_detector(min_chk_size, avg_chk_size, max_chk_size);
+
+  EXPECT_FALSE(fastcdc_detector.MightFindChunks(0));
+  EXPECT_FALSE(fastcdc_detector.MightFindChunks(base));
+  EXPECT_TRUE(fastcdc_detector.MightFindChunks(base + 1));
+
+  std::vector<size_t> buffer_sizes;
+  buffer_sizes.push_back(102400);    // 100kB
+  buffer_sizes.push_back(base);      // same as minimal chunk size
+  buffer_sizes.push_back(base * 2);  // same as average chunk size
+  buffer_sizes.push_back(10485760);  // 10MB
+  buffer_sizes.push_back(4093);      // prime, not aligned to the unrolling
+
+  // The cut marks must not depend on how the data is split into buffers
+  std::vector<off_t> reference;
+  for (unsigned i = 0; i < buffer_sizes.size(); ++i) {
+    CreateBuffers(buffer_sizes[i]);
+    FastCdcDetector detector(min_chk_size, avg_chk_size, max_chk_size);
+    std::vector<off_t> cuts;
+    off_t next_cut = 0;
+    off_t last_cut = 0;
+    for (unsigned j = 0; j < buffers_.size(); ++j) {
+      while ((next_cut = detector.FindNextCutMark(buffers_[j])) != 0) {
+        const size_t chunk_size = next_cut - last_cut;
+        ASSERT_GE(max_chk_size, chunk_size)
+          << "too large chunk with buffer size " << buffer_sizes[i];
+        ASSERT_LT(min_chk_size, chunk_size)
+          << "too small chunk with buffer size " << buffer_sizes[i];
+        cuts.push_back(next_cut);
+        last_cut = next_cut;
+      }
+    }
+
+    if (i == 0) {
+      reference = cuts;
+      // Normalized chunking keeps the chunks close to the average size
+      ASSERT_LT(data_size() / max_chk_size, cuts.size());
+      EXPECT_LT(data_size() / (avg_chk_size * 2), cuts.size());
+      EXPECT_GT(data_size() / (min_chk_size + base / 2), cuts.size());
+    } else {
+      EXPECT_EQ(reference, cuts)
+        << "unexpected cut marks with buffer size " << buffer_sizes[i];
+    }
+  }
+}
+
+
+
+namespace {
+
+std::vector<std::string> Chunks(ChunkDetector *detector,
+                                const std::string &data,
+                                ItemAllocator *allocator)
+{
+  std::vector<std::string> chunks;
+  uint64_t last_cut = 0;
+  const size_t buffer_size = 100 * 1024;
+  for (size_t i = 0; i < data.size(); i += buffer_size) {
+    BlockItem block(allocator);
+    block.MakeDataCopy(
+      reinterpret_cast<const unsigned char *>(data.data()) + i,
+      std::min(buffer_size, data.size() - i));
+    uint64_t next_cut;
+    while ((next_cut = detector->FindNextCutMark(&block)) != 0) {
+      chunks.push_back(data.substr(last_cut, next_cut - last_cut));
+      last_cut = next_cut;
+    }
+  }
+  if (last_cut < data.size())
+    chunks.push_back(data.substr(last_cut));
+  return chunks;
+}
+
+unsigned SharedChunks(const std::vector<std::string> &a,
+                      const std::vector<std::string> &b)
+{
+  std::set<std::string> chunks_b(b.begin(), b.end());
+  unsigned shared = 0;
+  for (unsigned i = 0; i < a.size(); ++i)
+    shared += chunks_b.count(a[i]);
+  return shared;
+}
+
+}  // anonymous namespace
+
+
+TEST_F(T_ChunkDetectors, FastCdcBoundaryStability) {
+  const size_t min_chk_size = 8 * 1024;
+  const size_t avg_chk_size = 16 * 1024;
+  const size_t max_chk_size = 64 * 1024;
+  ItemAllocator allocator;
+
+  Prng prng;
+  prng.InitSeed(42);
+  std::string original;
+  for (unsigned i = 0; i < 8 * 1024 * 1024; ++i)
+    original.push_back(static_cast<char>(prng.Next(256)));
+
+  // Insert a few bytes at a couple of places throughout the file
+  std::string modified = original;
+  const unsigned kNumEdits = 8;
+  for (unsigned i = 0; i < kNumEdits; ++i) {
+    const size_t pos = (i + 1) * (original.size() / (kNumEdits + 1));
+    modified.insert(pos, std::string(1 + prng.Next(100), 'x'));
+  }
+
+  FastCdcDetector detector_orig(min_chk_size, avg_chk_size, max_chk_size);
+  FastCdcDetector detector_mod(min_chk_size, avg_chk_size, max_chk_size);
+  std::vector<std::string> chunks_orig =
+    Chunks(&detector_orig, original, &allocator);
+  std::vector<std::string> chunks_mod =
+    Chunks(&detector_mod, modified, &allocator);
+
+  // Every edit should invalidate only one or two chunks; in the worst case, the
+  // resynchronization takes a max-size chunk
+  ASSERT_LT(original.size() / max_chk_size, chunks_orig.size());
+  const unsigned shared = SharedChunks(chunks_orig, chunks_mod);
+  EXPECT_GE(shared, chunks_orig.size() - 4 * kNumEdits);
+
+  // For comparison, the Xor32 detector resynchronizes as well
+  Xor32Detector xor32_orig(min_chk_size, avg_chk_size, max_chk_size);
+  Xor32Detector xor32_mod(min_chk_size, avg_chk_size, max_chk_size);
+  std::vector<std::string> xor32_chunks_orig =
+    Chunks(&xor32_orig, original, &allocator);
+  std::vector<std::string> xor32_chunks_mod =
+    Chunks(&xor32_mod, modified, &allocator);
+  EXPECT_GE(SharedChunks(xor32_chunks_orig, xor32_chunks_mod),
+            xor32_chunks_orig.size() - 4 * kNumEdits);
+}
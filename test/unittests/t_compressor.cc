@@ -4,9 +4,15 @@
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <cstring>
+#include <string>
 
 #include "compression.h"
+#include "network/sink.h"
+#include "util/file_guard.h"
 #include "util/pointer.h"
+#include "util/posix.h"
 #include "util/smalloc.h"
 
 // TODO(jblomer): typed tests
@@ -155,4 +161,247 @@ TEST_F(T_Compressor, EchoCompressionLong) {
   EXPECT_EQ(0, memcmp(compress_buf.weak_ref(), long_string, long_size));
 }
 
+namespace {
+
+class StringSink : public cvmfs::Sink {
+ public:
+  virtual int64_t Write(const void *buf, uint64_t sz) {
+    data.append(static_cast<const char *>(buf), sz);
+    return sz;
+  }
+  virtual int Reset() { data.clear(); return 0; }
+  std::string data;
+};
+
+}  // anonymous namespace
+
+
+template <Algorithms A>
+struct AlgorithmTag {
+  static const Algorithms value = A;
+};
+
+template <class AlgorithmTagT>
+class T_CompressorAlgorithms : public ::testing::Test {
+ protected:
+  static Algorithms GetAlgorithm() { return AlgorithmTagT::value; }
+};
+
+#ifdef CVMFS_ENABLE_ZSTD_LZ4
+typedef ::testing::Types<
+  AlgorithmTag<kZlibDefault>,
+  AlgorithmTag<kZstd>,
+  AlgorithmTag<kLz4> > CompressingAlgorithms;
+#else
+typedef ::testing::Types<
+  AlgorithmTag<kZlibDefault> > CompressingAlgorithms;
+#endif
+TYPED_TEST_CASE(T_CompressorAlgorithms, CompressingAlgorithms);
+
+
+TYPED_TEST(T_CompressorAlgorithms, StreamRoundTrip) {
+  const Algorithms alg = TestFixture::GetAlgorithm();
+  const size_t size = 4 * 1024 * 1024;
+  std::string input(size, '\0');
+  for (size_t i = 0; i < size; ++i)
+    input[i] = static_cast<char>((i % 251) ^ (i / 4096));
+
+  // Compress through a small output buffer in multiple rounds
+  UniquePtr<Compressor> compressor(Compressor::Construct(alg));
+  std::string compressed;
+  unsigned char out[1000];
+  unsigned char *in_pos =
+    reinterpret_cast<unsigned char *>(const_cast<char *>(input.data()));
+  size_t remaining = size;
+  bool done = false;
+  unsigned rounds = 0;
+  while (!done) {
+    unsigned char *out_pos = out;
+    size_t out_size = sizeof(out);
+    done = compressor->Deflate(true, &in_pos, &remaining, &out_pos, &out_size);
+    compressed.append(reinterpret_cast<char *>(out), out_size);
+    rounds++;
+  }
+  EXPECT_GT(rounds, 1U);
+  EXPECT_EQ(0U, remaining);
+  EXPECT_LT(compressed.size(), size);
+  EXPECT_LE(compressed.size(), compressor->DeflateBound(size));
+
+  // Decompress in pieces of odd size
+  UniquePtr<Decompressor> decompressor(Decompressor::Construct(alg));
+  StringSink sink;
+  StreamStates state = kStreamContinue;
+  for (size_t pos = 0; pos < compressed.size(); pos += 777) {
+    const size_t nbytes = std::min(size_t(777), compressed.size() - pos);
+    state = decompressor->Decompress2Sink(compressed.data() + pos, nbytes,
+                                          &sink);
+    ASSERT_NE(kStreamDataError, state);
+    ASSERT_NE(kStreamIOError, state);
+  }
+  EXPECT_EQ(kStreamEnd, state);
+  EXPECT_EQ(input, sink.data);
+
+  // The decompressor can be reused after a reset
+  decompressor->Reset();
+  sink.Reset();
+  state = decompressor->Decompress2Sink(compressed.data(), compressed.size(),
+                                        &sink);
+  EXPECT_EQ(kStreamEnd, state);
+  EXPECT_EQ(input, sink.data);
+}
+
+
+TYPED_TEST(T_CompressorAlgorithms, Mem2Mem) {
+  const Algorithms alg = TestFixture::GetAlgorithm();
+  const char *test_string = "Hello World!";
+  void *compressed;
+  uint64_t compressed_size;
+  EXPECT_TRUE(CompressMem2Mem(alg, test_string, strlen(test_string),
+                              &compressed, &compressed_size));
+  void *decompressed;
+  uint64_t decompressed_size;
+  EXPECT_TRUE(DecompressMem2Mem(alg, compressed, compressed_size,
+                                &decompressed, &decompressed_size));
+  ASSERT_EQ(strlen(test_string), decompressed_size);
+  EXPECT_EQ(0, memcmp(test_string, decompressed, decompressed_size));
+  free(decompressed);
+
+  // Empty input
+  free(compressed);
+  EXPECT_TRUE(CompressMem2Mem(alg, NULL, 0,
+                              &compressed, &compressed_size));
+  EXPECT_TRUE(DecompressMem2Mem(alg, compressed, compressed_size,
+                                &decompressed, &decompressed_size));
+  EXPECT_EQ(0U, decompressed_size);
+  free(decompressed);
+  free(compressed);
+}
+
+
+TYPED_TEST(T_CompressorAlgorithms, Path2File) {
+  const Algorithms alg = TestFixture::GetAlgorithm();
+  std::string input(200 * 1024, '\0');
+  for (unsigned i = 0; i < input.size(); ++i)
+    input[i] = static_cast<char>(i % 7);
+  void *compressed;
+  uint64_t compressed_size;
+  ASSERT_TRUE(CompressMem2Mem(alg, input.data(), input.size(),
+                              &compressed, &compressed_size));
+  std::string path;
+  FILE *fsrc = CreateTempFile("./cvmfs_ut_compressor", 0600, "w", &path);
+  ASSERT_TRUE(fsrc != NULL);
+  UnlinkGuard unlink_guard(path);
+  EXPECT_EQ(compressed_size, fwrite(compressed, 1, compressed_size, fsrc));
+  fclose(fsrc);
+  free(compressed);
+
+  FILE *fdest = tmpfile();
+  ASSERT_TRUE(fdest != NULL);
+  EXPECT_TRUE(DecompressPath2File(alg, path, fdest));
+  std::string output(input.size() + 1, '\0');
+  rewind(fdest);
+  EXPECT_EQ(input.size(), fread(&output[0], 1, output.size(), fdest));
+  output.resize(input.size());
+  EXPECT_EQ(input, output);
+  fclose(fdest);
+}
+
+
+TYPED_TEST(T_CompressorAlgorithms, Corrupted) {
+  const Algorithms alg = TestFixture::GetAlgorithm();
+  const std::string input(64 * 1024, 'x');
+  void *compressed;
+  uint64_t compressed_size;
+  EXPECT_TRUE(CompressMem2Mem(alg, input.data(), input.size(),
+                              &compressed, &compressed_size));
+  void *decompressed;
+  uint64_t decompressed_size;
+  // Truncated
+  EXPECT_FALSE(DecompressMem2Mem(alg, compressed, compressed_size / 2,
+                                 &decompressed, &decompressed_size));
+  // Garbage
+  memset(compressed, 0xAA, compressed_size);
+  EXPECT_FALSE(DecompressMem2Mem(alg, compressed, compressed_size,
+                                 &decompressed, &decompressed_size));
+  free(compressed);
+}
+
+
+TEST(T_CompressionAlgorithm, Parse) {
+  EXPECT_EQ(kZlibDefault, ParseCompressionAlgorithm("default"));
+  EXPECT_EQ(kZlibDefault, ParseCompressionAlgorithm("zlib"));
+  EXPECT_EQ(kNoCompression, ParseCompressionAlgorithm("none"));
+#ifdef CVMFS_ENABLE_ZSTD_LZ4
+  EXPECT_EQ(kLz4, ParseCompressionAlgorithm("lz4"));
+  EXPECT_EQ(kZstd, ParseCompressionAlgorithm("zstd"));
+  EXPECT_EQ(kZstd, ParseCompressionAlgorithm("zstd:19"));
+#endif
+  EXPECT_EQ(0, ParseCompressionLevel("zstd"));
+  EXPECT_EQ(19, ParseCompressionLevel("zstd:19"));
+  EXPECT_EQ(0, ParseCompressionLevel("zstd:x"));
+  EXPECT_EQ(0, ParseCompressionLevel("lz4"));
+
+  EXPECT_EQ("zstd", AlgorithmName(kZstd));
+  EXPECT_EQ("lz4", AlgorithmName(kLz4));
+
+  EXPECT_EQ("", MinClientVersion(kZlibDefault));
+  EXPECT_EQ("", MinClientVersion(kNoCompression));
+  EXPECT_NE("", MinClientVersion(kZstd));
+  EXPECT_NE("", MinClientVersion(kLz4));
+}
+
+
+#ifdef CVMFS_ENABLE_ZSTD_LZ4
+TEST(T_CompressionAlgorithm, ZstdLevel) {
+  std::string input(1024 * 1024, '\0');
+  for (unsigned i = 0; i < input.size(); ++i)
+    input[i] = static_cast<char>((i % 251) ^ (i / 4096));
+
+  // The level is a property of the compressor instance, not of the process
+  UniquePtr<Compressor> fast(Compressor::Construct(kZstd));
+  UniquePtr<Compressor> strong(Compressor::Construct(kZstd));
+  strong->SetLevel(19);
+  EXPECT_EQ(ZstdCompressor::kDefaultLevel,
+            static_cast<ZstdCompressor *>(fast.weak_ref())->level());
+  EXPECT_EQ(19, static_cast<ZstdCompressor *>(strong.weak_ref())->level());
+  UniquePtr<Compressor> clone(strong->Clone());
+  EXPECT_EQ(19, static_cast<ZstdCompressor *>(clone.weak_ref())->level());
+
+  std::string compressed[2];
+  Compressor *compressors[2] = { fast.weak_ref(), strong.weak_ref() };
+  for (unsigned c = 0; c < 2; ++c) {
+    std::string out(compressors[c]->DeflateBound(input.size()), '\0');
+    unsigned char *in_pos =
+      reinterpret_cast<unsigned char *>(const_cast<char *>(input.data()));
+    size_t in_size = input.size();
+    unsigned char *out_pos = reinterpret_cast<unsigned char *>(&out[0]);
+    size_t out_size = out.size();
+    EXPECT_TRUE(compressors[c]->Deflate(true, &in_pos, &in_size,
+                                        &out_pos, &out_size));
+    compressed[c] = out.substr(0, out_size);
+  }
+  EXPECT_NE(compressed[0], compressed[1]);
+  for (unsigned c = 0; c < 2; ++c) {
+    void *decompressed;
+    uint64_t decompressed_size;
+    EXPECT_TRUE(DecompressMem2Mem(kZstd, compressed[c].data(),
+                                  compressed[c].size(),
+                                  &decompressed, &decompressed_size));
+    EXPECT_EQ(input, std::string(static_cast<char *>(decompressed),
+                                 decompressed_size));
+    free(decompressed);
+  }
+}
+#else
+TEST(T_CompressionAlgorithm, Unsupported) {
+  void *out_buf;
+  uint64_t out_size;
+  const char data[] = "data";
+  EXPECT_FALSE(DecompressMem2Mem(kZstd, data, sizeof(data),
+                                 &out_buf, &out_size));
+  EXPECT_FALSE(DecompressMem2Mem(kLz4, data, sizeof(data),
+                                 &out_buf, &out_size));
+}
+#endif  // CVMFS_ENABLE_ZSTD_LZ4
+
 }  // end namespace zlib
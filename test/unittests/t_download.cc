@@ -4,19 +4,25 @@
 
 #include "gtest/gtest.h"
 
+#include <fcntl.h>
 #include <unistd.h>
 
 #include <cassert>
 #include <cstdio>
+#include <string>
+#include <vector>
 
 #include "c_file_sandbox.h"
 #include "c_http_server.h"
 #include "compression.h"
 #include "crypto/hash.h"
+#include "duplex_curl.h"
 #include "interrupt.h"
 #include "network/download.h"
 #include "network/sink.h"
 #include "statistics.h"
+#include "util/async.h"
+#include "util/concurrency.h"
 #include "util/file_guard.h"
 #include "util/posix.h"
 #include "util/prng.h"
@@ -135,6 +141,118 @@ TEST_F(T_Download, RemoteFile) {
   fclose(fdest);
 }
 
+TEST_F(T_Download, ConnectionStatistics) {
+  MockFileServer file_server(8082, sandbox_path_);
+  string src_path = GetSmallFile();
+  string src_url = "http://127.0.0.1:8082/" + GetFileName(src_path);
+
+  for (unsigned i = 0; i < 2; ++i) {
+    JobInfo info(&src_url, false /* compressed */, false /* probe hosts */,
+                 NULL /* expected hash */);
+    download_mgr.Fetch(&info);
+    EXPECT_EQ(kFailOk, info.error_code);
+    free(info.destination_mem.data);
+  }
+  EXPECT_EQ(2, file_server.num_processed_requests());
+  // The mock server closes the connection after every reply
+  EXPECT_EQ(2, statistics.Lookup("test.n_connections_new")->Get());
+  EXPECT_EQ(0, statistics.Lookup("test.n_connections_reused")->Get());
+  EXPECT_EQ(0, statistics.Lookup("test.n_tls_handshakes")->Get());
+  EXPECT_EQ(0, statistics.Lookup("test.n_http2_connections")->Get());
+  EXPECT_EQ(0, statistics.Lookup("test.n_http2_streams")->Get());
+}
+
+TEST_F(T_Download, Http2Fallback) {
+  MockFileServer file_server(8082, sandbox_path_);
+  string src_path = GetSmallFile();
+  string src_url = "http://127.0.0.1:8082/" + GetFileName(src_path);
+
+  // Depends on the libcurl build; plain HTTP stays on HTTP/1.1 in any case
+  download_mgr.EnableHttp2(8);
+  download_mgr.Spawn();
+  JobInfo info(&src_url, false /* compressed */, false /* probe hosts */,
+               NULL /* expected hash */);
+  download_mgr.Fetch(&info);
+  EXPECT_EQ(kFailOk, info.error_code);
+  free(info.destination_mem.data);
+  EXPECT_EQ(1, file_server.num_processed_requests());
+  EXPECT_EQ(0, statistics.Lookup("test.n_http2_streams")->Get());
+}
+
+TEST_F(T_Download, Http2PriorKnowledge) {
+  string src_path = GetSmallFile();
+  int fd = open(src_path.c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  string content;
+  ASSERT_TRUE(SafeReadToString(fd, &content));
+  close(fd);
+  MockHttp2Server http2_server(8082, content);
+  string src_url = "http://127.0.0.1:8082/" + GetFileName(src_path);
+
+  if (!download_mgr.EnableHttp2(8, true /* prior_knowledge */)) {
+    printf("Skipping, libcurl without HTTP/2 support\n");
+    return;
+  }
+  JobInfo info(&src_url, false /* compressed */, false /* probe hosts */,
+               NULL /* expected hash */);
+  download_mgr.Fetch(&info);
+  EXPECT_EQ(kFailOk, info.error_code);
+  EXPECT_EQ(content, string(info.destination_mem.data,
+                            info.destination_mem.pos));
+  free(info.destination_mem.data);
+  EXPECT_EQ(1, http2_server.num_processed_requests());
+  EXPECT_EQ(1, statistics.Lookup("test.n_http2_connections")->Get());
+  EXPECT_EQ(1, statistics.Lookup("test.n_http2_streams")->Get());
+
+  // libcurl 7.88 fails on the second request of a prior knowledge connection
+  // with "Error in the HTTP2 framing layer"
+  curl_version_info_data *curl_version = curl_version_info(CURLVERSION_NOW);
+  if ((curl_version->version_num >> 8) == 0x0758) {
+    printf("Skipping connection reuse, broken in libcurl %s\n",
+           curl_version->version);
+    return;
+  }
+  JobInfo info_reuse(&src_url, false /* compressed */,
+                     false /* probe hosts */, NULL /* expected hash */);
+  download_mgr.Fetch(&info_reuse);
+  EXPECT_EQ(kFailOk, info_reuse.error_code);
+  EXPECT_EQ(content, string(info_reuse.destination_mem.data,
+                            info_reuse.destination_mem.pos));
+  free(info_reuse.destination_mem.data);
+  EXPECT_EQ(2, http2_server.num_processed_requests());
+  EXPECT_EQ(1, http2_server.num_connections());
+  EXPECT_EQ(1, statistics.Lookup("test.n_connections_new")->Get());
+  EXPECT_EQ(1, statistics.Lookup("test.n_connections_reused")->Get());
+  EXPECT_EQ(1, statistics.Lookup("test.n_http2_connections")->Get());
+  EXPECT_EQ(2, statistics.Lookup("test.n_http2_streams")->Get());
+}
+
+TEST_F(T_Download, Http2PriorKnowledgeProxy) {
+  string src_path = GetSmallFile();
+  string src_content = GetFileContents(src_path);
+
+  MockProxyServer proxy_server(8083);
+  MockFileServer file_server(8082, sandbox_path_);
+  if (!download_mgr.EnableHttp2(8, true /* prior_knowledge */)) {
+    printf("Skipping, libcurl without HTTP/2 support\n");
+    return;
+  }
+  // Plain HTTP through a proxy stays on HTTP/1.1
+  download_mgr.SetProxyChain("http://127.0.0.1:8083", "",
+                             DownloadManager::kSetProxyRegular);
+  string url = "http://127.0.0.1:8082/" + GetFileName(src_path);
+  JobInfo info(&url, false /* compressed */, false /* probe hosts */, NULL);
+  download_mgr.Fetch(&info);
+  EXPECT_EQ(1, proxy_server.num_processed_requests());
+  EXPECT_EQ(1, file_server.num_processed_requests());
+  EXPECT_EQ(kFailOk, info.error_code);
+  ASSERT_EQ(src_content.length(), info.destination_mem.pos);
+  EXPECT_EQ(src_content, string(info.destination_mem.data,
+                                info.destination_mem.pos));
+  free(info.destination_mem.data);
+  EXPECT_EQ(0, statistics.Lookup("test.n_http2_connections")->Get());
+}
+
 TEST_F(T_Download, Clone) {
   DownloadManager *download_mgr_cloned = download_mgr.Clone(
     perf::StatisticsTemplate("x", &statistics));
@@ -411,6 +529,130 @@ TEST_F(T_Download, LocalFile2Sink) {
 }
 
 
+#ifdef CVMFS_ENABLE_ZSTD_LZ4
+TEST_F(T_Download, LocalFile2SinkAlgorithms) {
+  Prng prng;
+  prng.InitLocaltime();
+  unsigned N = 64*1024;
+  unsigned size = N*sizeof(uint32_t);
+  vector<uint32_t> rnd_buf(N);
+  for (unsigned i = 0; i < N; ++i)
+    rnd_buf[i] = prng.Next(1024);
+
+  zlib::Algorithms algorithms[] = {zlib::kZstd, zlib::kLz4};
+  for (unsigned i = 0; i < 2; ++i) {
+    void *compressed;
+    uint64_t compressed_size;
+    ASSERT_TRUE(zlib::CompressMem2Mem(algorithms[i], &rnd_buf[0], size,
+                                      &compressed, &compressed_size));
+    string dest_path;
+    FILE *fdest = CreateTemporaryFile(&dest_path);
+    ASSERT_TRUE(fdest != NULL);
+    UnlinkGuard unlink_guard(dest_path);
+    EXPECT_EQ(compressed_size,
+              fwrite(compressed, 1, compressed_size, fdest));
+    fclose(fdest);
+    shash::Any checksum(shash::kMd5);
+    shash::HashMem(static_cast<unsigned char *>(compressed), compressed_size,
+                   &checksum);
+    free(compressed);
+
+    string url = "file://" + dest_path;
+    TestSink test_sink;
+    JobInfo info(&url, true /* compressed */, false /* probe hosts */,
+                 &test_sink, &checksum /* expected hash */);
+    info.compression_alg = algorithms[i];
+    download_mgr.Fetch(&info);
+    EXPECT_EQ(info.error_code, kFailOk);
+    EXPECT_EQ(size, GetFileSize(test_sink.path));
+    vector<uint32_t> validation(N);
+    EXPECT_EQ(static_cast<int>(size),
+      pread(test_sink.fd, &validation[0], size, 0));
+    EXPECT_EQ(0, memcmp(&validation[0], &rnd_buf[0], size));
+
+    JobInfo info_mem(&url, true /* compressed */, false /* probe hosts */,
+                     &checksum /* expected hash */);
+    info_mem.compression_alg = algorithms[i];
+    download_mgr.Fetch(&info_mem);
+    EXPECT_EQ(info_mem.error_code, kFailOk);
+    ASSERT_EQ(size, info_mem.destination_mem.size);
+    EXPECT_EQ(0, memcmp(info_mem.destination_mem.data, &rnd_buf[0], size));
+    free(info_mem.destination_mem.data);
+
+    // Data in a different format is rejected
+    TestSink test_sink_wrong;
+    JobInfo info_wrong(&url, true /* compressed */, false /* probe hosts */,
+                       &test_sink_wrong, &checksum /* expected hash */);
+    download_mgr.Fetch(&info_wrong);
+    EXPECT_NE(info_wrong.error_code, kFailOk);
+  }
+}
+#endif  // CVMFS_ENABLE_ZSTD_LZ4
+
+class AsyncJobResult {
+ public:
+  void OnJobDone(JobInfo * const &info) { error_code.Set(info->error_code); }
+  Future<Failures> error_code;
+};
+
+TEST_F(T_Download, FetchAsync) {
+  string dest_path;
+  FILE *fdest = CreateTemporaryFile(&dest_path);
+  ASSERT_TRUE(fdest != NULL);
+  UnlinkGuard unlink_guard(dest_path);
+  char buf = '1';
+  fwrite(&buf, 1, 1, fdest);
+  fclose(fdest);
+  string url = "file://" + dest_path;
+  string url_missing = "file://" + dest_path + ".missing";
+
+  // Without I/O thread, the callback runs before FetchAsync() returns
+  AsyncJobResult result_sync;
+  UniquePtr<Callbackable<JobInfo *>::CallbackTN> callback_sync(
+    Callbackable<JobInfo *>::MakeCallback(&AsyncJobResult::OnJobDone,
+                                          &result_sync));
+  TestSink test_sink;
+  JobInfo info_sync(&url, false /* compressed */, false /* probe hosts */,
+                    &test_sink, NULL /* expected hash */);
+  info_sync.callback = callback_sync.weak_ref();
+  download_mgr.FetchAsync(&info_sync);
+  EXPECT_EQ(kFailOk, result_sync.error_code.Get());
+  EXPECT_EQ(1, pread(test_sink.fd, &buf, 1, 0));
+  EXPECT_EQ('1', buf);
+
+  DownloadManager async_mgr;
+  async_mgr.Init(8, perf::StatisticsTemplate("async", &statistics));
+  async_mgr.Spawn();
+
+  const unsigned kNumJobs = 16;
+  AsyncJobResult results[kNumJobs];
+  UniquePtr<Callbackable<JobInfo *>::CallbackTN> callbacks[kNumJobs];
+  JobInfo *infos[kNumJobs];
+  for (unsigned i = 0; i < kNumJobs; ++i) {
+    callbacks[i] = Callbackable<JobInfo *>::MakeCallback(
+      &AsyncJobResult::OnJobDone, &results[i]);
+    infos[i] = new JobInfo((i % 2) ? &url_missing : &url,
+                           false /* compressed */, false /* probe hosts */,
+                           NULL /* expected hash */);
+    infos[i]->callback = callbacks[i].weak_ref();
+    async_mgr.FetchAsync(infos[i]);
+  }
+  for (unsigned i = 0; i < kNumJobs; ++i) {
+    if (i % 2) {
+      EXPECT_NE(kFailOk, results[i].error_code.Get());
+      EXPECT_TRUE(infos[i]->destination_mem.data == NULL);
+    } else {
+      EXPECT_EQ(kFailOk, results[i].error_code.Get());
+      ASSERT_EQ(1U, infos[i]->destination_mem.pos);
+      EXPECT_EQ('1', infos[i]->destination_mem.data[0]);
+      free(infos[i]->destination_mem.data);
+    }
+    delete infos[i];
+  }
+  async_mgr.Fini();
+}
+
+
 TEST_F(T_Download, StripDirect) {
   string cleaned = "FALSE";
   EXPECT_FALSE(download_mgr.StripDirect("", &cleaned));
@@ -15,6 +15,7 @@
 #include "statistics.h"
 #include "testutil.h"
 #include "util/atomic.h"
+#include "util/concurrency.h"
 
 using namespace std;  // NOLINT
 
@@ -439,15 +440,18 @@ TEST_F(T_Fetcher, SignalWaitingThreads) {
   fetcher_->queues_download_[hash_cert_] = NULL;
 
   fetcher_->GetTls()->other_pipes_waiting.push_back(tls_pipe[1]);
-  fetcher_->SignalWaitingThreads(-1, hash_regular_, fetcher_->GetTls());
+  fetcher_->SignalWaitingThreads(-1, hash_regular_,
+    &fetcher_->GetTls()->other_pipes_waiting);
   EXPECT_EQ(0U, fetcher_->queues_download_.count(hash_regular_));
 
   fetcher_->GetTls()->other_pipes_waiting.push_back(tls_pipe[1]);
-  fetcher_->SignalWaitingThreads(fd, hash_catalog_, fetcher_->GetTls());
+  fetcher_->SignalWaitingThreads(fd, hash_catalog_,
+    &fetcher_->GetTls()->other_pipes_waiting);
   EXPECT_EQ(0U, fetcher_->queues_download_.count(hash_catalog_));
 
   fetcher_->GetTls()->other_pipes_waiting.push_back(tls_pipe[1]);
-  fetcher_->SignalWaitingThreads(1000000, hash_cert_, fetcher_->GetTls());
+  fetcher_->SignalWaitingThreads(1000000, hash_cert_,
+    &fetcher_->GetTls()->other_pipes_waiting);
   EXPECT_EQ(0U, fetcher_->queues_download_.count(hash_cert_));
 
   int fd_return0;
@@ -465,4 +469,129 @@ TEST_F(T_Fetcher, SignalWaitingThreads) {
   EXPECT_EQ(0, cache_mgr_->Close(fd));
 }
 
+
+class FetchAsyncResult {
+ public:
+  void OnFetched(const int &fd) {
+    thread = pthread_self();
+    this->fd.Set(fd);
+  }
+  Future<int> fd;
+  pthread_t thread;
+};
+
+TEST_F(T_Fetcher, FetchAsync) {
+  // Null hash
+  FetchAsyncResult result_null;
+  fetcher_->FetchAsync(shash::Any(shash::kSha1), 1, "null",
+    zlib::kZlibDefault, CacheManager::kTypeRegular,
+    Fetcher::MakeCallback(&FetchAsyncResult::OnFetched, &result_null));
+  EXPECT_EQ(-EIO, result_null.fd.Get());
+
+  // Cache hit
+  unsigned char x = 'x';
+  shash::Any hash_avail(shash::kSha1);
+  EXPECT_TRUE(cache_mgr_->CommitFromMem(hash_avail, &x, 1, ""));
+  FetchAsyncResult result_hit;
+  fetcher_->FetchAsync(hash_avail, 1, "", zlib::kZlibDefault,
+    CacheManager::kTypeRegular,
+    Fetcher::MakeCallback(&FetchAsyncResult::OnFetched, &result_hit));
+  EXPECT_GE(result_hit.fd.Get(), 0);
+  EXPECT_EQ(0, cache_mgr_->Close(result_hit.fd.Get()));
+
+  // Download and store in cache
+  FetchAsyncResult result_miss;
+  fetcher_->FetchAsync(hash_regular_, CacheManager::kSizeUnknown, "reg",
+    zlib::kZlibDefault, CacheManager::kTypeRegular,
+    Fetcher::MakeCallback(&FetchAsyncResult::OnFetched, &result_miss));
+  EXPECT_GE(result_miss.fd.Get(), 0);
+  EXPECT_EQ(0, cache_mgr_->Close(result_miss.fd.Get()));
+  // Committed to the cache by the completion thread
+  EXPECT_FALSE(pthread_equal(pthread_self(), result_miss.thread));
+  int fd = cache_mgr_->Open(CacheManager::Bless(hash_regular_));
+  EXPECT_GE(fd, 0);
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+
+  // Download fails
+  shash::Any rnd_hash(shash::kSha1);
+  rnd_hash.Randomize();
+  FetchAsyncResult result_fail;
+  fetcher_->FetchAsync(rnd_hash, CacheManager::kSizeUnknown, "rnd",
+    zlib::kZlibDefault, CacheManager::kTypeRegular,
+    Fetcher::MakeCallback(&FetchAsyncResult::OnFetched, &result_fail));
+  EXPECT_EQ(-EIO, result_fail.fd.Get());
+
+  // In the download I/O thread
+  download_mgr_->Spawn();
+  FetchAsyncResult result_catalog;
+  fetcher_->FetchAsync(hash_catalog_, CacheManager::kSizeUnknown, "cat",
+    zlib::kZlibDefault, CacheManager::kTypeCatalog,
+    Fetcher::MakeCallback(&FetchAsyncResult::OnFetched, &result_catalog));
+  EXPECT_GE(result_catalog.fd.Get(), 0);
+  EXPECT_EQ(0, cache_mgr_->Close(result_catalog.fd.Get()));
+  fd = cache_mgr_->Open(CacheManager::Bless(hash_catalog_));
+  EXPECT_GE(fd, 0);
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+
+  FetchAsyncResult result_uncompressed;
+  fetcher_->FetchAsync(hash_uncompressed_, 1, "x",
+    zlib::kZlibDefault, CacheManager::kTypeRegular,
+    Fetcher::MakeCallback(&FetchAsyncResult::OnFetched,
+                          &result_uncompressed));
+  EXPECT_EQ(-EIO, result_uncompressed.fd.Get());
+}
+
+
+TEST_F(T_Fetcher, FetchAsyncCollapse) {
+  unsigned char x = 'x';
+  EXPECT_TRUE(cache_mgr_->CommitFromMem(hash_cert_, &x, 1, ""));
+  int fd = cache_mgr_->Open(CacheManager::Bless(hash_cert_));
+  EXPECT_GE(fd, 0);
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+
+  // Pretend that hash_regular_ is in flight; the callbacks are queued
+  std::vector<int> other_pipes_waiting;
+  fetcher_->queues_download_[hash_regular_] = &other_pipes_waiting;
+  FetchAsyncResult results[3];
+  for (unsigned i = 0; i < 3; ++i) {
+    fetcher_->FetchAsync(hash_regular_, CacheManager::kSizeUnknown, "reg",
+      zlib::kZlibDefault, CacheManager::kTypeRegular,
+      Fetcher::MakeCallback(&FetchAsyncResult::OnFetched, &results[i]));
+  }
+  EXPECT_EQ(3U, fetcher_->queues_callbacks_[hash_regular_].size());
+  fd = cache_mgr_->Open(CacheManager::Bless(hash_cert_));
+  EXPECT_GE(fd, 0);
+  fetcher_->SignalWaitingThreads(fd, hash_regular_, &other_pipes_waiting);
+  EXPECT_EQ(0U, fetcher_->queues_download_.count(hash_regular_));
+  EXPECT_EQ(0U, fetcher_->queues_callbacks_.count(hash_regular_));
+  for (unsigned i = 0; i < 3; ++i) {
+    EXPECT_GE(results[i].fd.Get(), 0);
+    EXPECT_NE(fd, results[i].fd.Get());
+    EXPECT_EQ(0, cache_mgr_->Close(results[i].fd.Get()));
+  }
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+
+  // Concurrent requests for the same object result in a single download
+  download_mgr_->Spawn();
+  const unsigned kNumRequests = 32;
+  FetchAsyncResult results_concurrent[kNumRequests];
+  for (unsigned i = 0; i < kNumRequests; ++i) {
+    fetcher_->FetchAsync(hash_catalog_, CacheManager::kSizeUnknown, "cat",
+      zlib::kZlibDefault, CacheManager::kTypeRegular,
+      Fetcher::MakeCallback(&FetchAsyncResult::OnFetched,
+                            &results_concurrent[i]));
+  }
+  fd = fetcher_->Fetch(hash_catalog_, CacheManager::kSizeUnknown, "cat",
+                       zlib::kZlibDefault, CacheManager::kTypeRegular);
+  EXPECT_GE(fd, 0);
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+  for (unsigned i = 0; i < kNumRequests; ++i) {
+    EXPECT_GE(results_concurrent[i].fd.Get(), 0);
+    EXPECT_EQ(0, cache_mgr_->Close(results_concurrent[i].fd.Get()));
+  }
+  EXPECT_EQ(1, statistics_.Lookup("fetch.n_downloads")->Get());
+  EXPECT_EQ(static_cast<int64_t>(3 + kNumRequests + 1),
+            statistics_.Lookup("fetch.n_invocations")->Get());
+}
+
 }  // namespace cvmfs
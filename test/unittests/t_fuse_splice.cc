@@ -0,0 +1,129 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "fuse_splice.h"
+#include "testutil.h"
+#include "util/posix.h"
+
+class T_SplicePipes : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    tmp_path_ = CreateTempDir(GetCurrentWorkingDirectory() + "/cvmfs_ut_splice");
+    ASSERT_NE("", tmp_path_);
+    content_.resize(3 * 4096 + 123);
+    for (unsigned i = 0; i < content_.size(); ++i)
+      content_[i] = static_cast<char>(i % 251);
+    ASSERT_TRUE(SafeWriteToFile(content_, tmp_path_ + "/file", 0600));
+    fd_ = open((tmp_path_ + "/file").c_str(), O_RDONLY);
+    ASSERT_GE(fd_, 0);
+  }
+
+  virtual void TearDown() {
+    close(fd_);
+    RemoveTree(tmp_path_);
+  }
+
+  std::string DrainPipe(const SplicePipes::Pipe &pipe, int64_t nbytes) {
+    std::string result(nbytes, '\0');
+    if (nbytes > 0)
+      EXPECT_EQ(nbytes, SafeRead(pipe.fd[0], &result[0], nbytes));
+    return result;
+  }
+
+  std::string tmp_path_;
+  std::string content_;
+  int fd_;
+  SplicePipes splice_pipes_;
+};
+
+
+#ifdef __linux__
+TEST_F(T_SplicePipes, Splice) {
+  SplicePipes::Pipe pipe;
+  int64_t nbytes = splice_pipes_.Splice(fd_, 0, 4096, &pipe);
+  ASSERT_EQ(4096, nbytes);
+  EXPECT_EQ(content_.substr(0, 4096), DrainPipe(pipe, nbytes));
+  splice_pipes_.Release(&pipe);
+
+  // Unaligned offset and size
+  nbytes = splice_pipes_.Splice(fd_, 1000, 2 * 4096 + 1, &pipe);
+  ASSERT_EQ(2 * 4096 + 1, nbytes);
+  EXPECT_EQ(content_.substr(1000, 2 * 4096 + 1), DrainPipe(pipe, nbytes));
+  splice_pipes_.Release(&pipe);
+
+  // Beyond the end of the file
+  nbytes = splice_pipes_.Splice(fd_, content_.size() - 10, 4096, &pipe);
+  ASSERT_EQ(10, nbytes);
+  EXPECT_EQ(content_.substr(content_.size() - 10), DrainPipe(pipe, nbytes));
+  splice_pipes_.Release(&pipe);
+
+  nbytes = splice_pipes_.Splice(fd_, content_.size() + 10, 4096, &pipe);
+  EXPECT_EQ(0, nbytes);
+  splice_pipes_.Release(&pipe);
+}
+
+
+TEST_F(T_SplicePipes, Errors) {
+  SplicePipes::Pipe pipe;
+  EXPECT_EQ(-EBADF, splice_pipes_.Splice(-1, 0, 4096, &pipe));
+  EXPECT_EQ(-1, pipe.fd[0]);
+
+  int fd_wronly = open((tmp_path_ + "/file").c_str(), O_WRONLY);
+  ASSERT_GE(fd_wronly, 0);
+  EXPECT_EQ(-EBADF, splice_pipes_.Splice(fd_wronly, 0, 4096, &pipe));
+  EXPECT_EQ(-1, pipe.fd[0]);
+  close(fd_wronly);
+
+  // A directory cannot be spliced, the error is passed on
+  int fd_dir = open(tmp_path_.c_str(), O_RDONLY);
+  ASSERT_GE(fd_dir, 0);
+  EXPECT_GT(0, splice_pipes_.Splice(fd_dir, 0, 4096, &pipe));
+  EXPECT_EQ(-1, pipe.fd[0]);
+  close(fd_dir);
+}
+
+
+TEST_F(T_SplicePipes, Reuse) {
+  SplicePipes::Pipe pipe;
+  int64_t nbytes = splice_pipes_.Splice(fd_, 0, 4096, &pipe);
+  ASSERT_EQ(4096, nbytes);
+  const int fd_pipe = pipe.fd[0];
+  DrainPipe(pipe, nbytes);
+  splice_pipes_.Release(&pipe);
+  EXPECT_EQ(-1, pipe.fd[0]);
+  EXPECT_EQ(1U, splice_pipes_.idle_pipes_.size());
+
+  nbytes = splice_pipes_.Splice(fd_, 0, 4096, &pipe);
+  ASSERT_EQ(4096, nbytes);
+  EXPECT_EQ(fd_pipe, pipe.fd[0]);
+  EXPECT_EQ(0U, splice_pipes_.idle_pipes_.size());
+  EXPECT_EQ(content_.substr(0, 4096), DrainPipe(pipe, nbytes));
+  splice_pipes_.Release(&pipe);
+}
+
+
+TEST_F(T_SplicePipes, DiscardFilled) {
+  SplicePipes::Pipe pipe;
+  int64_t nbytes = splice_pipes_.Splice(fd_, 0, 4096, &pipe);
+  ASSERT_EQ(4096, nbytes);
+  // Pipe not drained, e.g. failed reply
+  splice_pipes_.Release(&pipe);
+  EXPECT_EQ(-1, pipe.fd[0]);
+  EXPECT_EQ(0U, splice_pipes_.idle_pipes_.size());
+
+  nbytes = splice_pipes_.Splice(fd_, 4096, 4096, &pipe);
+  ASSERT_EQ(4096, nbytes);
+  EXPECT_EQ(content_.substr(4096, 4096), DrainPipe(pipe, nbytes));
+  splice_pipes_.Release(&pipe);
+  EXPECT_EQ(1U, splice_pipes_.idle_pipes_.size());
+}
+#endif
@@ -3,6 +3,7 @@
  */
 
 #include <gtest/gtest.h>
+#include <pthread.h>
 
 #include <set>
 #include <string>
@@ -13,6 +14,7 @@
 #include "util/platform.h"
 #include "util/posix.h"
 #include "util/prng.h"
+#include "util/string.h"
 
 namespace glue {
 
@@ -91,6 +93,136 @@ TEST_F(T_GlueBuffer, InodeTracker) {
 }
 
 
+TEST_F(T_GlueBuffer, InodeTrackerStripes) {
+  // Enough inodes and paths to populate all stripes
+  const unsigned kNumDirs = 8;
+  const unsigned kNumFiles = 64;
+  inode_tracker_.VfsGet(glue::InodeEx(1, glue::InodeEx::kDirectory),
+                        PathString(""));
+  for (unsigned i = 0; i < kNumDirs; ++i) {
+    const uint64_t dir_inode = 1000 + i;
+    const std::string dir = "/dir" + StringifyInt(i);
+    inode_tracker_.VfsGet(glue::InodeEx(dir_inode, glue::InodeEx::kDirectory),
+                          PathString(dir));
+    for (unsigned j = 0; j < kNumFiles; ++j) {
+      inode_tracker_.VfsGetBy(
+        glue::InodeEx(dir_inode * 1000 + j, glue::InodeEx::kRegular), 2,
+        PathString(dir + "/file" + StringifyInt(j)));
+    }
+  }
+  const unsigned kNumInodes = 1 + kNumDirs + kNumDirs * kNumFiles;
+  EXPECT_EQ(static_cast<int64_t>(kNumInodes),
+            inode_tracker_.GetStatistics().num_inserts);
+
+  // Every path is enumerated exactly once, although parents are replicated
+  uint64_t inode_parent;
+  NameString name;
+  uint64_t inode;
+  std::set<std::string> entries;
+  std::set<uint64_t> inodes;
+  InodeTracker::Cursor cursor = inode_tracker_.BeginEnumerate();
+  while (inode_tracker_.NextEntry(&cursor, &inode_parent, &name)) {
+    std::string entry = StringifyInt(inode_parent) + "/" + name.ToString();
+    EXPECT_TRUE(entries.insert(entry).second) << entry;
+  }
+  while (inode_tracker_.NextInode(&cursor, &inode))
+    EXPECT_TRUE(inodes.insert(inode).second) << inode;
+  inode_tracker_.EndEnumerate(&cursor);
+  EXPECT_EQ(kNumInodes, entries.size());
+  EXPECT_EQ(kNumInodes, inodes.size());
+  EXPECT_EQ(1U, entries.count("1003/file42"));
+
+  PathString path;
+  glue::InodeEx inode_ex(1003042, glue::InodeEx::kUnknownType);
+  EXPECT_TRUE(inode_tracker_.FindPath(&inode_ex, &path));
+  EXPECT_EQ("/dir3/file42", path.ToString());
+  EXPECT_EQ(glue::InodeEx::kRegular, inode_ex.GetFileType());
+  EXPECT_EQ(1003042U, inode_tracker_.FindInode(PathString("/dir3/file42")));
+  EXPECT_TRUE(inode_tracker_.FindDentry(1003042, &inode_parent, &name));
+  EXPECT_EQ(1003U, inode_parent);
+  EXPECT_EQ("file42", name.ToString());
+
+  // Old and new inode in different stripes
+  EXPECT_TRUE(inode_tracker_.ReplaceInode(
+    1003042, glue::InodeEx(1003043 + InodeTracker::kNumStripes * 1000,
+                           glue::InodeEx::kRegular)));
+  inode_ex = glue::InodeEx(1003042, glue::InodeEx::kUnknownType);
+  EXPECT_FALSE(inode_tracker_.FindPath(&inode_ex, &path));
+  EXPECT_EQ(1003043U + InodeTracker::kNumStripes * 1000,
+            inode_tracker_.FindInode(PathString("/dir3/file42")));
+  EXPECT_FALSE(inode_tracker_.ReplaceInode(
+    1003042, glue::InodeEx(42, glue::InodeEx::kRegular)));
+
+  {
+    InodeTracker::VfsPutRaii vfs_put_raii = inode_tracker_.GetVfsPutRaii();
+    EXPECT_FALSE(vfs_put_raii.VfsPut(1005001, 1));
+    EXPECT_TRUE(vfs_put_raii.VfsPut(1005001, 1));
+    // Already removed
+    EXPECT_FALSE(vfs_put_raii.VfsPut(1005001, 1));
+  }
+  EXPECT_EQ(0U, inode_tracker_.FindInode(PathString("/dir5/file1")));
+  EXPECT_EQ(1005U, inode_tracker_.FindInode(PathString("/dir5")));
+  EXPECT_EQ(1U, inode_tracker_.GetStatistics().num_removes);
+
+  InodeTracker copy(inode_tracker_);
+  EXPECT_EQ(1007063U, copy.FindInode(PathString("/dir7/file63")));
+  EXPECT_EQ(0U, copy.FindInode(PathString("/dir5/file1")));
+}
+
+
+struct InodeTrackerStartData {
+  InodeTracker *tracker;
+  unsigned thread_id;
+};
+
+static void *MainInodeTrackerGetPut(void *data) {
+  InodeTrackerStartData *sd = reinterpret_cast<InodeTrackerStartData *>(data);
+  const std::string prefix = "/t" + StringifyInt(sd->thread_id);
+  for (unsigned round = 0; round < 20; ++round) {
+    for (unsigned i = 0; i < 100; ++i) {
+      // Inode 2 is shared by all threads
+      sd->tracker->VfsGet(glue::InodeEx(2, glue::InodeEx::kDirectory),
+                          PathString("/shared"));
+      sd->tracker->VfsGet(
+        glue::InodeEx(100 + sd->thread_id * 1000 + i, glue::InodeEx::kRegular),
+        PathString(prefix + "/" + StringifyInt(i)));
+    }
+    for (unsigned i = 0; i < 100; ++i) {
+      InodeTracker::VfsPutRaii vfs_put_raii = sd->tracker->GetVfsPutRaii();
+      vfs_put_raii.VfsPut(100 + sd->thread_id * 1000 + i, 1);
+      vfs_put_raii.VfsPut(2, 1);
+    }
+  }
+  return NULL;
+}
+
+TEST_F(T_GlueBuffer, InodeTrackerMultiThreaded) {
+  const unsigned kNumThreads = 8;
+  pthread_t threads[kNumThreads];
+  InodeTrackerStartData start_data[kNumThreads];
+  for (unsigned i = 0; i < kNumThreads; ++i) {
+    start_data[i].tracker = &inode_tracker_;
+    start_data[i].thread_id = i;
+    int retval = pthread_create(&threads[i], NULL, MainInodeTrackerGetPut,
+                                &start_data[i]);
+    ASSERT_EQ(0, retval);
+  }
+  for (unsigned i = 0; i < kNumThreads; ++i)
+    pthread_join(threads[i], NULL);
+
+  EXPECT_EQ(0, inode_tracker_.GetStatistics().num_references);
+  EXPECT_EQ(inode_tracker_.GetStatistics().num_inserts,
+            inode_tracker_.GetStatistics().num_removes);
+  uint64_t inode_parent;
+  NameString name;
+  uint64_t inode;
+  InodeTracker::Cursor cursor = inode_tracker_.BeginEnumerate();
+  EXPECT_FALSE(inode_tracker_.NextEntry(&cursor, &inode_parent, &name));
+  EXPECT_FALSE(inode_tracker_.NextInode(&cursor, &inode));
+  inode_tracker_.EndEnumerate(&cursor);
+}
+
+
 TEST_F(T_GlueBuffer, DentryTracker) {
   DentryTracker tracker;
   const unsigned kTimeoutNever = 100000;
@@ -132,6 +264,41 @@ TEST_F(T_GlueBuffer, DentryTracker) {
 }
 
 
+TEST_F(T_GlueBuffer, DentryTrackerStripes) {
+  DentryTracker tracker;
+  const unsigned kTimeoutNever = 100000;
+  for (unsigned i = 0; i < 4 * DentryTracker::kNumStripes; ++i)
+    tracker.Add(i, ("entry" + StringifyInt(i)).c_str(), kTimeoutNever);
+  EXPECT_EQ(4 * DentryTracker::kNumStripes,
+            static_cast<unsigned>(tracker.GetStatistics().num_insert));
+
+  uint64_t parent_inode = 0;
+  NameString name;
+  std::set<uint64_t> parents;
+  DentryTracker::Cursor cursor = tracker.BeginEnumerate();
+  while (tracker.NextEntry(&cursor, &parent_inode, &name)) {
+    EXPECT_EQ("entry" + StringifyInt(parent_inode), name.ToString());
+    EXPECT_TRUE(parents.insert(parent_inode).second);
+  }
+  tracker.EndEnumerate(&cursor);
+  EXPECT_EQ(4 * DentryTracker::kNumStripes, parents.size());
+
+  DentryTracker *dst = tracker.Move();
+  EXPECT_EQ(4 * DentryTracker::kNumStripes,
+            static_cast<unsigned>(tracker.GetStatistics().num_remove));
+  cursor = tracker.BeginEnumerate();
+  EXPECT_FALSE(tracker.NextEntry(&cursor, &parent_inode, &name));
+  tracker.EndEnumerate(&cursor);
+  parents.clear();
+  cursor = dst->BeginEnumerate();
+  while (dst->NextEntry(&cursor, &parent_inode, &name))
+    parents.insert(parent_inode);
+  dst->EndEnumerate(&cursor);
+  EXPECT_EQ(4 * DentryTracker::kNumStripes, parents.size());
+  delete dst;
+}
+
+
 TEST_F(T_GlueBuffer, DentryMove) {
   DentryTracker tracker;
   const unsigned kTimeoutNever = 100000;
@@ -5,6 +5,7 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <vector>
 
 #include "garbage_collection/hash_filter.h"
 
@@ -67,7 +68,8 @@ class T_HashFilter : public ::testing::Test {
   };
 };
 
-typedef ::testing::Types<SimpleHashFilter, SmallhashFilter> HashFilterTypes;
+typedef ::testing::Types<SimpleHashFilter, SmallhashFilter, CompactHashFilter>
+  HashFilterTypes;
 TYPED_TEST_CASE(T_HashFilter, HashFilterTypes);
 
 
@@ -424,3 +426,34 @@ TYPED_TEST(T_HashFilter, FillManyRandomHashesSlow) {
 
   std::for_each(random_hashes.begin(), random_hashes.end(), check_contains);
 }
+
+
+TEST(T_CompactHashFilter, MergeWhileFilling) {
+  // Small tail so that the new fingerprints are merged many times
+  CompactHashFilter filter(64);
+  SimpleHashFilter reference;
+
+  Prng rng;
+  rng.InitSeed(4217);
+  RandomHashGenerator random_hash_generator(rng);
+  std::vector<shash::Any> hashes;
+  for (unsigned i = 0; i < 20000; ++i) {
+    // Every third hash is a duplicate of an earlier one
+    const shash::Any hash = ((i % 3 == 2) && !hashes.empty())
+      ? hashes[rng.Next(hashes.size())]
+      : random_hash_generator();
+    EXPECT_EQ(reference.Contains(hash), filter.Contains(hash));
+    filter.Fill(hash);
+    reference.Fill(hash);
+    hashes.push_back(hash);
+    EXPECT_TRUE(filter.Contains(hash));
+  }
+  EXPECT_EQ(reference.Count(), filter.Count());
+
+  filter.Freeze();
+  EXPECT_EQ(reference.Count(), filter.Count());
+  for (unsigned i = 0; i < hashes.size(); ++i)
+    EXPECT_TRUE(filter.Contains(hashes[i]));
+  for (unsigned i = 0; i < 20000; ++i)
+    EXPECT_FALSE(filter.Contains(random_hash_generator()));
+}
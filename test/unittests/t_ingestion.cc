@@ -27,6 +27,7 @@
 #include "util/atomic.h"
 #include "util/pointer.h"
 #include "util/posix.h"
+#include "util/prng.h"
 #include "util/smalloc.h"
 
 using namespace std;  // NOLINT
@@ -69,9 +70,11 @@ struct FnFileProcessed {
   FnFileProcessed() { atomic_init64(&ncall); }
 
   void OnFileProcessed(const upload::SpoolerResult &spooler_result) {
+    last_result = spooler_result;
     atomic_inc64(&ncall);
   }
 
+  upload::SpoolerResult last_result;
   atomic_int64 ncall;
 };
 
@@ -243,6 +246,66 @@ TEST_F(T_Ingestion, TaskRead) {
 }
 
 
+TEST_F(T_Ingestion, TaskReadAsync) {
+  unsigned nblocks = 2 * TaskRead::kAsyncDepth + 1;
+  int fd_tmp = open("./large", O_CREAT | O_TRUNC | O_WRONLY, 0600);
+  EXPECT_GT(fd_tmp, 0);
+  for (unsigned i = 0; i < nblocks; ++i) {
+    string str_block(TaskRead::kBlockSize, static_cast<char>(i));
+    EXPECT_TRUE(SafeWrite(fd_tmp, str_block.data(), str_block.size()));
+  }
+  // Partial last block
+  EXPECT_TRUE(SafeWrite(fd_tmp, "abc", 3));
+  close(fd_tmp);
+  unsigned size = nblocks * TaskRead::kBlockSize + 3;
+
+  AsyncReader::Type types[] = {AsyncReader::kIoUring, AsyncReader::kPread};
+  for (unsigned t = 0; t < 2; ++t) {
+    Tube<FileItem> tube_in;
+    Tube<BlockItem> *tube_out = new Tube<BlockItem>();
+    TubeGroup<BlockItem> tube_group_out;
+    tube_group_out.TakeTube(tube_out);
+    tube_group_out.Activate();
+
+    TubeConsumerGroup<FileItem> task_group;
+    TaskRead *task_read = new TaskRead(&tube_in, &tube_group_out, &allocator_);
+    task_read->SetAsyncReader(types[t]);
+    task_group.TakeConsumer(task_read);
+    task_group.Spawn();
+
+    FileItem file_null(new FileIngestionSource(std::string("/dev/null")));
+    tube_in.EnqueueBack(&file_null);
+    BlockItem *item_stop = tube_out->PopFront();
+    EXPECT_EQ(0U, file_null.size());
+    EXPECT_EQ(BlockItem::kBlockStop, item_stop->type());
+    delete item_stop;
+
+    FileItem file_large(new FileIngestionSource(std::string("./large")));
+    tube_in.EnqueueBack(&file_large);
+    for (unsigned i = 0; i < nblocks; ++i) {
+      BlockItem *item_data = tube_out->PopFront();
+      EXPECT_EQ(BlockItem::kBlockData, item_data->type());
+      EXPECT_EQ(string(TaskRead::kBlockSize, static_cast<char>(i)),
+                string(reinterpret_cast<char *>(item_data->data()),
+                                                item_data->size()));
+      delete item_data;
+    }
+    BlockItem *item_data = tube_out->PopFront();
+    EXPECT_EQ(BlockItem::kBlockData, item_data->type());
+    EXPECT_EQ("abc", string(reinterpret_cast<char *>(item_data->data()),
+                            item_data->size()));
+    delete item_data;
+    EXPECT_EQ(size, file_large.size());
+    item_stop = tube_out->PopFront();
+    EXPECT_EQ(BlockItem::kBlockStop, item_stop->type());
+    delete item_stop;
+
+    task_group.Terminate();
+  }
+  unlink("./large");
+}
+
+
 TEST_F(T_Ingestion, TaskReadThrottle) {
   Tube<FileItem> tube_in;
   Tube<BlockItem> *tube_out = new Tube<BlockItem>();
@@ -826,6 +889,76 @@ TEST_F(T_Ingestion, PipelineNull) {
 }
 
 
+TEST_F(T_Ingestion, PipelineContentIndex) {
+  upload::SpoolerDefinition spooler_definition = MockSpoolerDefinition(false);
+  spooler_definition.content_index_path = "./content_index";
+  unlink("./content_index");
+
+  EXPECT_TRUE(SafeWriteToFile("abc", "./abc", 0600));
+  const unsigned size_large = 4 * spooler_definition.max_file_chunk_size;
+  string str_large(size_large, '\0');
+  Prng prng;
+  prng.InitSeed(42);
+  for (unsigned i = 0; i < size_large; ++i)
+    str_large[i] = static_cast<char>(prng.Next(256));
+  EXPECT_TRUE(SafeWriteToFile(str_large, "./large", 0600));
+
+  FnFileProcessed fn_processed;
+  UniquePtr<IngestionPipeline> pipeline(
+    new IngestionPipeline(uploader_, spooler_definition));
+  pipeline->RegisterListener(&FnFileProcessed::OnFileProcessed, &fn_processed);
+  pipeline->Spawn();
+  pipeline->Process(new FileIngestionSource(std::string("./abc")), true);
+  pipeline->WaitFor();
+  const shash::Any hash_abc = fn_processed.last_result.content_hash;
+  pipeline->Process(new FileIngestionSource(std::string("./large")), true);
+  pipeline->WaitFor();
+  const upload::SpoolerResult result_large = fn_processed.last_result;
+  EXPECT_TRUE(result_large.IsChunked());
+  const unsigned nuploads = uploader_->results.size();
+  EXPECT_EQ(1U + result_large.file_chunks.size(), nuploads);
+  EXPECT_TRUE(FileExists("./content_index"));
+
+  // Touched but unchanged files are not processed again
+  pipeline = new IngestionPipeline(uploader_, spooler_definition);
+  pipeline->RegisterListener(&FnFileProcessed::OnFileProcessed, &fn_processed);
+  pipeline->Spawn();
+  pipeline->Process(new FileIngestionSource(std::string("./abc")), true);
+  pipeline->WaitFor();
+  EXPECT_EQ(3, atomic_read64(&fn_processed.ncall));
+  EXPECT_EQ(hash_abc, fn_processed.last_result.content_hash);
+  pipeline->Process(new FileIngestionSource(std::string("./large")), true);
+  pipeline->WaitFor();
+  EXPECT_EQ(4, atomic_read64(&fn_processed.ncall));
+  EXPECT_EQ(nuploads, uploader_->results.size());
+  EXPECT_TRUE(fn_processed.last_result.content_hash.IsNull());
+  ASSERT_EQ(result_large.file_chunks.size(),
+            fn_processed.last_result.file_chunks.size());
+  for (unsigned i = 0; i < result_large.file_chunks.size(); ++i) {
+    EXPECT_EQ(result_large.file_chunks.At(i).content_hash(),
+              fn_processed.last_result.file_chunks.At(i).content_hash());
+    EXPECT_EQ(result_large.file_chunks.At(i).offset(),
+              fn_processed.last_result.file_chunks.At(i).offset());
+  }
+
+  // Changed content and vanished objects are processed as usual
+  EXPECT_TRUE(SafeWriteToFile("xyz", "./abc", 0600));
+  pipeline->Process(new FileIngestionSource(std::string("./abc")), true);
+  pipeline->WaitFor();
+  EXPECT_EQ(nuploads + 1, uploader_->results.size());
+  EXPECT_NE(hash_abc, fn_processed.last_result.content_hash);
+  uploader_->ClearResults();
+  pipeline->Process(new FileIngestionSource(std::string("./large")), true);
+  pipeline->WaitFor();
+  EXPECT_EQ(result_large.file_chunks.size(), uploader_->results.size());
+
+  pipeline.Destroy();
+  unlink("./abc");
+  unlink("./large");
+  unlink("./content_index");
+}
+
+
 TEST_F(T_Ingestion, Scrubbing) {
   UniquePtr<ScrubbingPipeline> pipeline_scrubbing(new ScrubbingPipeline());
   FnFileHashed fn_hashed;
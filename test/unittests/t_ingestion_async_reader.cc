@@ -0,0 +1,121 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "gtest/gtest.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "ingestion/async_reader.h"
+#include "util/pointer.h"
+#include "util/posix.h"
+
+using namespace std;  // NOLINT
+
+class T_AsyncReader : public ::testing::TestWithParam<AsyncReader::Type> {
+ protected:
+  virtual void SetUp() {
+    path_ = "./async_reader";
+    content_.resize(1000 * 1000 + 17);
+    for (unsigned i = 0; i < content_.size(); ++i)
+      content_[i] = static_cast<char>(i % 253);
+    ASSERT_TRUE(SafeWriteToFile(content_, path_, 0600));
+    fd_ = open(path_.c_str(), O_RDONLY);
+    ASSERT_GE(fd_, 0);
+    reader_ = AsyncReader::Create(GetParam(), kDepth);
+    ASSERT_TRUE(reader_.IsValid());
+    EXPECT_EQ(kDepth, reader_->depth());
+  }
+
+  virtual void TearDown() {
+    close(fd_);
+    unlink(path_.c_str());
+  }
+
+  static const unsigned kDepth = 4;
+  string path_;
+  string content_;
+  int fd_;
+  UniquePtr<AsyncReader> reader_;
+};
+
+const unsigned T_AsyncReader::kDepth;
+
+
+TEST_P(T_AsyncReader, Type) {
+  // io_uring can be unavailable, e.g. in containers
+  if (GetParam() == AsyncReader::kPread)
+    EXPECT_EQ(AsyncReader::kPread, reader_->type());
+}
+
+
+TEST_P(T_AsyncReader, ReadAll) {
+  const unsigned kBlockSize = 64 * 1024;
+  const unsigned num_blocks = (content_.size() + kBlockSize - 1) / kBlockSize;
+  vector<string> buffers(num_blocks, string(kBlockSize, '\0'));
+  vector<AsyncReader::Request> requests(num_blocks);
+
+  // Keep kDepth requests in flight, collect them in order
+  unsigned next_submit = 0;
+  for (unsigned i = 0; i < num_blocks; ++i) {
+    while ((next_submit < num_blocks) && (next_submit < i + kDepth)) {
+      requests[next_submit] = AsyncReader::Request(
+        fd_, static_cast<uint64_t>(next_submit) * kBlockSize,
+        reinterpret_cast<unsigned char *>(&buffers[next_submit][0]),
+        kBlockSize);
+      reader_->Submit(&requests[next_submit]);
+      next_submit++;
+    }
+    reader_->Wait(&requests[i]);
+    EXPECT_TRUE(requests[i].done);
+    const uint64_t offset = static_cast<uint64_t>(i) * kBlockSize;
+    const int64_t expected =
+      std::min(static_cast<uint64_t>(kBlockSize), content_.size() - offset);
+    ASSERT_EQ(expected, requests[i].result);
+    EXPECT_EQ(content_.substr(offset, expected),
+              buffers[i].substr(0, expected));
+  }
+}
+
+
+TEST_P(T_AsyncReader, Eof) {
+  unsigned char buffer[16];
+  AsyncReader::Request request(fd_, content_.size() - 4, buffer, 16);
+  reader_->Submit(&request);
+  reader_->Wait(&request);
+  ASSERT_EQ(4, request.result);
+  EXPECT_EQ(content_.substr(content_.size() - 4),
+            string(reinterpret_cast<char *>(buffer), 4));
+
+  request = AsyncReader::Request(fd_, content_.size() + 100, buffer, 16);
+  reader_->Submit(&request);
+  reader_->Wait(&request);
+  EXPECT_EQ(0, request.result);
+}
+
+
+TEST_P(T_AsyncReader, Errors) {
+  unsigned char buffer[16];
+  AsyncReader::Request request(-1, 0, buffer, 16);
+  reader_->Submit(&request);
+  reader_->Wait(&request);
+  EXPECT_EQ(-EBADF, request.result);
+
+  int fd_dir = open(".", O_RDONLY);
+  ASSERT_GE(fd_dir, 0);
+  request = AsyncReader::Request(fd_dir, 0, buffer, 16);
+  reader_->Submit(&request);
+  reader_->Wait(&request);
+  EXPECT_EQ(-EISDIR, request.result);
+  close(fd_dir);
+}
+
+
+INSTANTIATE_TEST_CASE_P(AsyncReaderTypes, T_AsyncReader,
+                        ::testing::Values(AsyncReader::kIoUring,
+                                          AsyncReader::kPread));
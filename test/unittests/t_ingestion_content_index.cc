@@ -0,0 +1,225 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "gtest/gtest.h"
+
+#include <unistd.h>
+
+#include <string>
+
+#include "crypto/hash.h"
+#include "ingestion/content_index.h"
+#include "util/pointer.h"
+#include "util/posix.h"
+
+using namespace std;  // NOLINT
+
+class T_Ingestion_ContentIndex : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    path_ = "./content_index";
+    unlink(path_.c_str());
+
+    hash_abc_ = hash_xyz_ = bulk_abc_ = chunk1_ = chunk2_ =
+      shash::Any(shash::kSha1);
+    shash::HashString("abc", &hash_abc_);
+    shash::HashString("xyz", &hash_xyz_);
+    shash::HashString("compressed abc", &bulk_abc_);
+    shash::HashString("chunk 1", &chunk1_);
+    shash::HashString("chunk 2", &chunk2_);
+    chunk1_.suffix = shash::kSuffixPartial;
+    chunk2_.suffix = shash::kSuffixPartial;
+  }
+
+  virtual void TearDown() {
+    unlink(path_.c_str());
+  }
+
+  string path_;
+  shash::Any hash_abc_;
+  shash::Any hash_xyz_;
+  shash::Any bulk_abc_;
+  shash::Any chunk1_;
+  shash::Any chunk2_;
+};
+
+
+TEST_F(T_Ingestion_ContentIndex, Lookup) {
+  UniquePtr<ContentIndex> index(ContentIndex::Create(path_, "settings"));
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(0U, index->size());
+
+  ContentIndex::Key key(hash_abc_, 3, shash::kSuffixNone, false);
+  ContentIndex::Entry entry;
+  EXPECT_FALSE(index->Lookup(key, &entry));
+
+  entry.bulk_hash = bulk_abc_;
+  entry.compression_algorithm = zlib::kZstd;
+  index->Insert(key, entry);
+  ContentIndex::Entry result;
+  EXPECT_TRUE(index->Lookup(key, &result));
+  EXPECT_EQ(bulk_abc_, result.bulk_hash);
+  EXPECT_EQ(zlib::kZstd, result.compression_algorithm);
+  EXPECT_TRUE(result.chunks.empty());
+
+  // Every component of the key matters
+  EXPECT_FALSE(index->Lookup(
+    ContentIndex::Key(hash_xyz_, 3, shash::kSuffixNone, false), &result));
+  EXPECT_FALSE(index->Lookup(
+    ContentIndex::Key(hash_abc_, 4, shash::kSuffixNone, false), &result));
+  EXPECT_FALSE(index->Lookup(
+    ContentIndex::Key(hash_abc_, 3, shash::kSuffixMicroCatalog, false),
+    &result));
+  EXPECT_FALSE(index->Lookup(
+    ContentIndex::Key(hash_abc_, 3, shash::kSuffixNone, true), &result));
+  EXPECT_EQ(1U, index->n_hit());
+  EXPECT_EQ(5U, index->n_miss());
+}
+
+
+TEST_F(T_Ingestion_ContentIndex, Persistency) {
+  UniquePtr<ContentIndex> index(ContentIndex::Create(path_, "settings"));
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_TRUE(index->Commit());
+  EXPECT_FALSE(FileExists(path_));
+
+  ContentIndex::Key key_abc(hash_abc_, 3, shash::kSuffixNone, false);
+  ContentIndex::Entry entry_abc;
+  entry_abc.bulk_hash = bulk_abc_;
+  index->Insert(key_abc, entry_abc);
+
+  ContentIndex::Key key_xyz(hash_xyz_, 2000000, shash::kSuffixNone, true);
+  ContentIndex::Entry entry_xyz;
+  entry_xyz.chunks.push_back(FileChunk(chunk1_, 0, 1000000));
+  entry_xyz.chunks.push_back(FileChunk(chunk2_, 1000000, 1000000));
+  entry_xyz.compression_algorithm = zlib::kNoCompression;
+  index->Insert(key_xyz, entry_xyz);
+  EXPECT_TRUE(index->Commit());
+  EXPECT_TRUE(FileExists(path_));
+
+  index = ContentIndex::Create(path_, "settings");
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(2U, index->size());
+  ContentIndex::Entry result;
+  EXPECT_TRUE(index->Lookup(key_abc, &result));
+  EXPECT_EQ(bulk_abc_, result.bulk_hash);
+  EXPECT_TRUE(result.chunks.empty());
+  EXPECT_TRUE(index->Lookup(key_xyz, &result));
+  EXPECT_TRUE(result.bulk_hash.IsNull());
+  EXPECT_EQ(zlib::kNoCompression, result.compression_algorithm);
+  ASSERT_EQ(2U, result.chunks.size());
+  EXPECT_EQ(chunk1_, result.chunks[0].content_hash());
+  EXPECT_EQ(shash::kSuffixPartial, result.chunks[0].content_hash().suffix);
+  EXPECT_EQ(0, result.chunks[0].offset());
+  EXPECT_EQ(1000000U, result.chunks[0].size());
+  EXPECT_EQ(chunk2_, result.chunks[1].content_hash());
+  EXPECT_EQ(1000000, result.chunks[1].offset());
+
+  // Different pipeline settings invalidate the entries
+  index = ContentIndex::Create(path_, "other settings");
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(0U, index->size());
+  EXPECT_TRUE(index->Commit());
+  index = ContentIndex::Create(path_, "settings");
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(0U, index->size());
+}
+
+
+TEST_F(T_Ingestion_ContentIndex, Corrupted) {
+  string content = "version=2 settings\n"
+    "garbage\n"
+    "1 " + hash_abc_.ToString() + " 3 0 0 1 " + bulk_abc_.ToString() + "\n" +
+    // Single chunk
+    "1 " + hash_xyz_.ToString() + " 3 0 1 1 - 0 3 " + chunk1_.ToString() +
+    "\n" +
+    "1 " + hash_xyz_.ToString() + " 3 0 0 1 " + bulk_abc_.ToString() +
+    " 0\n" +
+    // Missing run
+    hash_xyz_.ToString() + " 3 0 0 1 " + bulk_abc_.ToString() + "\n";
+  EXPECT_TRUE(SafeWriteToFile(content, path_, 0600));
+
+  UniquePtr<ContentIndex> index(ContentIndex::Create(path_, "settings"));
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(1U, index->size());
+  ContentIndex::Entry result;
+  EXPECT_TRUE(index->Lookup(
+    ContentIndex::Key(hash_abc_, 3, shash::kSuffixNone, false), &result));
+  EXPECT_EQ(bulk_abc_, result.bulk_hash);
+  EXPECT_EQ(zlib::kNoCompression, result.compression_algorithm);
+}
+
+
+TEST_F(T_Ingestion_ContentIndex, FormatChange) {
+  // Index files without format version are discarded
+  string content = "settings\n" +
+    hash_abc_.ToString() + " 3 0 0 1 " + bulk_abc_.ToString() + "\n";
+  EXPECT_TRUE(SafeWriteToFile(content, path_, 0600));
+
+  UniquePtr<ContentIndex> index(ContentIndex::Create(path_, "settings"));
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(0U, index->size());
+  EXPECT_EQ(1U, index->run());
+}
+
+
+TEST_F(T_Ingestion_ContentIndex, PruneIdle) {
+  string content = "version=2 settings\n"
+    "1 " + hash_abc_.ToString() + " 3 0 0 1 " + bulk_abc_.ToString() + "\n" +
+    "60 " + hash_xyz_.ToString() + " 3 0 0 1 " + bulk_abc_.ToString() + "\n";
+  EXPECT_TRUE(SafeWriteToFile(content, path_, 0600));
+
+  UniquePtr<ContentIndex> index(ContentIndex::Create(path_, "settings"));
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(61U, index->run());
+  EXPECT_EQ(2U, index->size());
+  EXPECT_TRUE(index->Commit());
+  EXPECT_EQ(1U, index->size());
+
+  index = ContentIndex::Create(path_, "settings");
+  ASSERT_TRUE(index.IsValid());
+  ContentIndex::Entry result;
+  EXPECT_FALSE(index->Lookup(
+    ContentIndex::Key(hash_abc_, 3, shash::kSuffixNone, false), &result));
+  EXPECT_TRUE(index->Lookup(
+    ContentIndex::Key(hash_xyz_, 3, shash::kSuffixNone, false), &result));
+  EXPECT_EQ(61U, result.last_run);
+
+  // The hit is recorded
+  EXPECT_TRUE(index->Commit());
+  index = ContentIndex::Create(path_, "settings");
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(62U, index->run());
+}
+
+
+TEST_F(T_Ingestion_ContentIndex, MaxEntries) {
+  shash::Any hash_def(shash::kSha1);
+  shash::HashString("def", &hash_def);
+  string content = "version=2 settings\n"
+    "3 " + hash_abc_.ToString() + " 3 0 0 1 " + bulk_abc_.ToString() + "\n" +
+    "2 " + hash_xyz_.ToString() + " 3 0 0 1 " + bulk_abc_.ToString() + "\n" +
+    "2 " + hash_def.ToString() + " 3 0 0 1 " + bulk_abc_.ToString() + "\n";
+  EXPECT_TRUE(SafeWriteToFile(content, path_, 0600));
+
+  UniquePtr<ContentIndex> index(ContentIndex::Create(path_, "settings", 2));
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(3U, index->size());
+  ContentIndex::Entry result;
+  EXPECT_TRUE(index->Lookup(
+    ContentIndex::Key(hash_def, 3, shash::kSuffixNone, false), &result));
+  EXPECT_TRUE(index->Commit());
+  EXPECT_EQ(2U, index->size());
+  EXPECT_FALSE(index->Lookup(
+    ContentIndex::Key(hash_xyz_, 3, shash::kSuffixNone, false), &result));
+
+  // Among entries of the same run, as many as necessary are dropped
+  index = ContentIndex::Create(path_, "settings", 1);
+  ASSERT_TRUE(index.IsValid());
+  EXPECT_EQ(2U, index->size());
+  EXPECT_TRUE(index->Commit());
+  EXPECT_EQ(1U, index->size());
+  EXPECT_TRUE(index->Lookup(
+    ContentIndex::Key(hash_def, 3, shash::kSuffixNone, false), &result));
+}
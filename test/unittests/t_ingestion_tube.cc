@@ -4,7 +4,10 @@
 
 #include "gtest/gtest.h"
 
+#include <pthread.h>
+
 #include <string>
+#include <vector>
 
 #include "ingestion/tube.h"
 
@@ -125,3 +128,77 @@ TEST_F(T_Ingestion_Tube, QueueDeferItem) {
   EXPECT_EQ(&s3, tube_.PopFront());
   EXPECT_TRUE(tube_.IsEmpty());
 }
+
+TEST_F(T_Ingestion_Tube, Batch) {
+  vector<string *> items;
+  tube_.EnqueueBackBatch(items);
+  EXPECT_TRUE(tube_.IsEmpty());
+  items.push_back(&s1);
+  items.push_back(&s2);
+  items.push_back(&s3);
+  tube_.EnqueueBackBatch(items);
+  tube_.EnqueueBack(&s4);
+  EXPECT_EQ(4U, tube_.size());
+
+  vector<string *> popped;
+  EXPECT_EQ(2U, tube_.PopFrontBatch(2, &popped));
+  EXPECT_EQ(2U, popped.size());
+  EXPECT_EQ(&s1, popped[0]);
+  EXPECT_EQ(&s2, popped[1]);
+  EXPECT_EQ(2U, tube_.size());
+  EXPECT_EQ(2U, tube_.PopFrontBatch(16, &popped));
+  EXPECT_EQ(4U, popped.size());
+  EXPECT_EQ(&s3, popped[2]);
+  EXPECT_EQ(&s4, popped[3]);
+  EXPECT_TRUE(tube_.IsEmpty());
+
+  // The tube remains usable after batches emptied it
+  tube_.EnqueueFront(&s2);
+  tube_.EnqueueBack(&s3);
+  EXPECT_EQ(&s3, tube_.PopBack());
+  EXPECT_EQ(&s2, tube_.PopFront());
+  EXPECT_TRUE(tube_.IsEmpty());
+}
+
+
+namespace {
+
+struct BatchProducerData {
+  Tube<string> *tube;
+  vector<string *> *items;
+};
+
+void *MainBatchProducer(void *data) {
+  BatchProducerData *producer_data =
+    reinterpret_cast<BatchProducerData *>(data);
+  producer_data->tube->EnqueueBackBatch(*producer_data->items);
+  return NULL;
+}
+
+}  // anonymous namespace
+
+TEST_F(T_Ingestion_Tube, BatchLimit) {
+  Tube<string> tube(2);
+  vector<string *> items;
+  items.push_back(&s1);
+  items.push_back(&s2);
+  items.push_back(&s3);
+  items.push_back(&s4);
+  BatchProducerData producer_data;
+  producer_data.tube = &tube;
+  producer_data.items = &items;
+  pthread_t thread_producer;
+  int retval =
+    pthread_create(&thread_producer, NULL, MainBatchProducer, &producer_data);
+  ASSERT_EQ(0, retval);
+
+  vector<string *> popped;
+  while (popped.size() < items.size()) {
+    tube.PopFrontBatch(4, &popped);
+    EXPECT_LE(popped.size(), items.size());
+  }
+  pthread_join(thread_producer, NULL);
+  for (unsigned i = 0; i < items.size(); ++i)
+    EXPECT_EQ(items[i], popped[i]);
+  EXPECT_TRUE(tube.IsEmpty());
+}
@@ -0,0 +1,117 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <string>
+
+#include "bigvector.h"
+#include "listing_cache.h"
+#include "statistics.h"
+#include "util/smalloc.h"
+
+using namespace std;  // NOLINT
+
+namespace cvmfs {
+
+class T_DirectoryListingCache : public ::testing::Test {
+ protected:
+  static const unsigned kArenaSize = 2 * 1024 * 1024;
+
+  virtual void SetUp() {
+    cache_ = new DirectoryListingCache(
+      kArenaSize, perf::StatisticsTemplate("listing_cache", &statistics_));
+  }
+
+  virtual void TearDown() {
+    delete cache_;
+  }
+
+  string Get(uint64_t inode, uint64_t revision, uint64_t incarnation = 0) {
+    BigVector<char> listing(512);
+    if (!cache_->Lookup(inode, revision, incarnation, &listing))
+      return "<miss>";
+    char *buffer;
+    bool large_alloc;
+    listing.ShareBuffer(&buffer, &large_alloc);
+    string result(buffer, listing.size());
+    // Buffer is shared, free manually like cvmfs_releasedir()
+    if (large_alloc)
+      smunmap(buffer);
+    else
+      free(buffer);
+    return result;
+  }
+
+  bool Put(uint64_t inode, uint64_t revision, const string &listing,
+           uint64_t incarnation = 0)
+  {
+    return cache_->Insert(inode, revision, incarnation,
+                          listing.data(), listing.length());
+  }
+
+  int64_t GetCounter(const string &name) {
+    return statistics_.Lookup("listing_cache." + name)->Get();
+  }
+
+  perf::Statistics statistics_;
+  DirectoryListingCache *cache_;
+};
+
+
+TEST_F(T_DirectoryListingCache, Basics) {
+  EXPECT_EQ("<miss>", Get(1, 1));
+  EXPECT_TRUE(Put(1, 1, "abc"));
+  EXPECT_FALSE(Put(1, 1, "abc"));
+  EXPECT_TRUE(Put(2, 1, ""));
+  EXPECT_EQ("abc", Get(1, 1));
+  EXPECT_EQ("", Get(2, 1));
+  // A new catalog revision does not see the old listings
+  EXPECT_EQ("<miss>", Get(1, 2));
+  // Neither do catalogs that were detached and got new inodes
+  EXPECT_EQ("<miss>", Get(1, 1, 1));
+  EXPECT_TRUE(Put(1, 1, "def", 1));
+  EXPECT_EQ("def", Get(1, 1, 1));
+  EXPECT_EQ("abc", Get(1, 1));
+
+  EXPECT_EQ(4, GetCounter("n_hit"));
+  EXPECT_EQ(3, GetCounter("n_miss"));
+  EXPECT_EQ(3, GetCounter("n_insert"));
+  EXPECT_EQ(6, GetCounter("sz_listings"));
+}
+
+
+TEST_F(T_DirectoryListingCache, LargeListing) {
+  // Exceeds the initial capacity of the BigVector
+  string large(cache_->max_listing_size(), 'x');
+  EXPECT_TRUE(Put(1, 1, large));
+  EXPECT_EQ(large, Get(1, 1));
+
+  EXPECT_FALSE(Put(2, 1, large + "x"));
+  EXPECT_EQ(1, GetCounter("n_too_large"));
+  EXPECT_EQ("<miss>", Get(2, 1));
+}
+
+
+TEST_F(T_DirectoryListingCache, Lru) {
+  const string listing(64 * 1024, 'x');
+  // More than fits into the arena
+  const unsigned N = 2 * kArenaSize / listing.length();
+  for (unsigned i = 0; i < N; ++i) {
+    EXPECT_TRUE(Put(i, 1, listing));
+    // Keep the first listing hot
+    EXPECT_EQ(listing, Get(0, 1));
+  }
+  EXPECT_LT(0, GetCounter("n_evict"));
+  EXPECT_EQ(listing, Get(0, 1));
+  EXPECT_EQ("<miss>", Get(1, 1));
+  EXPECT_EQ(listing, Get(N - 1, 1));
+
+  EXPECT_EQ(N - GetCounter("n_evict"), cache_->entries_.size());
+  EXPECT_EQ(static_cast<int64_t>(cache_->entries_.size() * listing.length()),
+            GetCounter("sz_listings"));
+}
+
+}  // namespace cvmfs
@@ -3,10 +3,12 @@
  */
 
 #include <gtest/gtest.h>
+#include <pthread.h>
 
 #include <string>
 
 #include "lru.h"
+#include "lru_md.h"
 #include "statistics.h"
 #include "util/string.h"
 
@@ -569,3 +571,156 @@ TEST(T_LruCache, PauseAndResume) {
   EXPECT_TRUE(cache.IsEmpty());
   EXPECT_FALSE(cache.IsFull());
 }
+
+
+TEST(T_LruCache, NegativeLookupCache) {
+  perf::Statistics statistics;
+  lru::NegativeLookupCache cache(cache_size, &statistics);
+
+  EXPECT_FALSE(cache.Contains(lru::ParentNameKey(1, "foo", 3)));
+  EXPECT_TRUE(cache.Add(lru::ParentNameKey(1, "foo", 3)));
+  EXPECT_FALSE(cache.Add(lru::ParentNameKey(1, "foo", 3)));
+  EXPECT_TRUE(cache.Contains(lru::ParentNameKey(1, "foo", 3)));
+  EXPECT_FALSE(cache.Contains(lru::ParentNameKey(2, "foo", 3)));
+  EXPECT_FALSE(cache.Contains(lru::ParentNameKey(1, "fo", 2)));
+  EXPECT_EQ(1U,
+    statistics.Lookup("negative_lookup_cache.n_insert_negative")->Get());
+  EXPECT_EQ(1U, statistics.Lookup("negative_lookup_cache.n_hit")->Get());
+  EXPECT_EQ(3U, statistics.Lookup("negative_lookup_cache.n_miss")->Get());
+
+  cache.Pause();
+  EXPECT_FALSE(cache.Contains(lru::ParentNameKey(1, "foo", 3)));
+  cache.Drop();
+  cache.Resume();
+  EXPECT_FALSE(cache.Contains(lru::ParentNameKey(1, "foo", 3)));
+  EXPECT_TRUE(cache.IsEmpty());
+
+  // Entries are distributed over shards, so only the total is predictable
+  for (unsigned i = 0; i < 2 * cache_size; ++i) {
+    const std::string entry = StringifyInt(i);
+    cache.Add(lru::ParentNameKey(1, entry.data(), entry.length()));
+  }
+  EXPECT_TRUE(cache.IsFull());
+  EXPECT_LE(cache_size,
+    statistics.Lookup("negative_lookup_cache.n_replace")->Get());
+  const std::string last = StringifyInt(2 * cache_size - 1);
+  EXPECT_TRUE(cache.Contains(
+    lru::ParentNameKey(1, last.data(), last.length())));
+}
+
+
+TEST(T_LruCache, ShardedClockReplacement) {
+  perf::Statistics statistics;
+  // Small caches use a single shard, which makes the order predictable
+  const unsigned kSmallSize = 128;
+  lru::ShardedLruCache<int, int> cache(kSmallSize, -1, hasher_int,
+      perf::StatisticsTemplate(name, &statistics));
+  EXPECT_EQ(1U, cache.num_shards());
+  EXPECT_TRUE(cache.IsEmpty());
+
+  for (unsigned i = 0; i < kSmallSize; ++i)
+    EXPECT_TRUE(cache.Insert(i, i));
+  EXPECT_TRUE(cache.IsFull());
+  EXPECT_FALSE(cache.Insert(0, 42));
+
+  int value;
+  EXPECT_TRUE(cache.Lookup(0, &value));
+  EXPECT_EQ(42, value);
+  // 0 is referenced, 1 is the victim of the clock hand
+  EXPECT_TRUE(cache.Insert(kSmallSize, kSmallSize));
+  EXPECT_TRUE(cache.Lookup(0, &value));
+  EXPECT_FALSE(cache.Lookup(1, &value));
+  EXPECT_TRUE(cache.Lookup(2, &value));
+  EXPECT_EQ(1U, statistics.Lookup(name + ".n_replace")->Get());
+
+  // Forgotten slots are reused before anything is evicted
+  EXPECT_TRUE(cache.Forget(3));
+  EXPECT_FALSE(cache.Forget(3));
+  EXPECT_FALSE(cache.IsFull());
+  EXPECT_TRUE(cache.Insert(1, 1));
+  EXPECT_EQ(1U, statistics.Lookup(name + ".n_replace")->Get());
+  EXPECT_TRUE(cache.IsFull());
+}
+
+
+TEST(T_LruCache, ShardedPauseAndDrop) {
+  perf::Statistics statistics;
+  const unsigned kLargeSize = 4096;
+  lru::ShardedLruCache<int, int> cache(kLargeSize, -1, hasher_int,
+      perf::StatisticsTemplate(name, &statistics));
+  EXPECT_EQ(16U, cache.num_shards());
+
+  for (unsigned i = 0; i < kLargeSize; ++i)
+    EXPECT_TRUE(cache.Insert(i, i));
+  // With the identity hash every shard is exactly full
+  EXPECT_TRUE(cache.IsFull());
+  EXPECT_EQ(0U, statistics.Lookup(name + ".n_replace")->Get());
+  int value;
+  for (unsigned i = 0; i < kLargeSize; ++i) {
+    EXPECT_TRUE(cache.Lookup(i, &value));
+    EXPECT_EQ(static_cast<int>(i), value);
+  }
+
+  cache.Pause();
+  EXPECT_FALSE(cache.Lookup(1, &value));
+  EXPECT_FALSE(cache.Insert(kLargeSize, 0));
+  EXPECT_FALSE(cache.Forget(1));
+  cache.Drop();
+  EXPECT_TRUE(cache.IsEmpty());
+  cache.Resume();
+  EXPECT_FALSE(cache.Lookup(1, &value));
+  EXPECT_TRUE(cache.Insert(1, 1));
+  EXPECT_TRUE(cache.Lookup(1, &value));
+  EXPECT_EQ(1U, statistics.Lookup(name + ".n_drop")->Get());
+}
+
+
+struct ShardedCacheStartData {
+  lru::ShardedLruCache<int, int> *cache;
+  int offset;
+};
+
+static void *MainShardedCacheWorker(void *data) {
+  ShardedCacheStartData *sd = reinterpret_cast<ShardedCacheStartData *>(data);
+  int value;
+  for (int i = 0; i < 20000; ++i) {
+    const int key = sd->offset + (i % 3000);
+    if (sd->cache->Lookup(key, &value)) {
+      EXPECT_EQ(key, value);
+    } else {
+      sd->cache->Insert(key, key);
+    }
+    if ((i % 7) == 0)
+      sd->cache->Forget(key);
+  }
+  return NULL;
+}
+
+TEST(T_LruCache, ShardedMultiThreaded) {
+  perf::Statistics statistics;
+  lru::ShardedLruCache<int, int> cache(cache_size, -1, hasher_int,
+      perf::StatisticsTemplate(name, &statistics));
+
+  const unsigned kNumThreads = 8;
+  pthread_t threads[kNumThreads];
+  ShardedCacheStartData start_data[kNumThreads];
+  for (unsigned i = 0; i < kNumThreads; ++i) {
+    start_data[i].cache = &cache;
+    // Neighboring threads share half of their keys
+    start_data[i].offset = i * 1500;
+    int retval = pthread_create(&threads[i], NULL, MainShardedCacheWorker,
+                                &start_data[i]);
+    ASSERT_EQ(0, retval);
+  }
+  for (unsigned i = 0; i < kNumThreads; ++i)
+    pthread_join(threads[i], NULL);
+
+  EXPECT_EQ(kNumThreads * 20000U,
+            statistics.Lookup(name + ".n_hit")->Get() +
+            statistics.Lookup(name + ".n_miss")->Get());
+  int value;
+  unsigned num_entries = 0;
+  for (int key = 0; key < static_cast<int>(kNumThreads * 1500 + 1500); ++key)
+    num_entries += cache.Lookup(key, &value);
+  EXPECT_LE(num_entries, cache_size);
+}
@@ -87,4 +87,38 @@ TEST_F(T_Manifest, ReadBreadcrumb) {
   fclose(f);
 }
 
+
+
+TEST_F(T_Manifest, MinClientVersion) {
+  shash::Any catalog_hash(shash::kSha1);
+  catalog_hash.Randomize();
+  Manifest manifest(catalog_hash, 1, "");
+  EXPECT_TRUE(manifest.IsSupportedBy("2.0.0"));
+  EXPECT_FALSE(manifest.RequiresClientVersion("2.11.0"));
+  EXPECT_EQ(string::npos, manifest.ExportString().find("\nV"));
+
+  manifest.RequireClientVersion("2.11.0");
+  EXPECT_TRUE(manifest.RequiresClientVersion("2.11.0"));
+  EXPECT_TRUE(manifest.RequiresClientVersion("2.10"));
+  EXPECT_FALSE(manifest.RequiresClientVersion("2.11.1"));
+  EXPECT_FALSE(manifest.IsSupportedBy("2.9.4"));
+  EXPECT_FALSE(manifest.IsSupportedBy("2.10"));
+  EXPECT_TRUE(manifest.IsSupportedBy("2.11.0"));
+  EXPECT_TRUE(manifest.IsSupportedBy("2.11.1"));
+  EXPECT_TRUE(manifest.IsSupportedBy("3.0"));
+
+  // Never lowered
+  manifest.RequireClientVersion("2.10.1");
+  EXPECT_EQ("2.11.0", manifest.min_client_version());
+
+  const string exported = manifest.ExportString();
+  Manifest *reloaded = Manifest::LoadMem(
+    reinterpret_cast<const unsigned char *>(exported.data()),
+    exported.length());
+  ASSERT_TRUE(reloaded != NULL);
+  EXPECT_EQ("2.11.0", reloaded->min_client_version());
+  EXPECT_FALSE(reloaded->IsSupportedBy("2.10.1"));
+  delete reloaded;
+}
+
 }  // namespace manifest
@@ -497,6 +497,28 @@ TEST_F(T_MountPoint, MountMulti) {
 }
 
 
+TEST_F(T_MountPoint, ListingCacheSize) {
+  CreateMiniRepository(&options_mgr_, &repo_path_);
+  UniquePtr<FileSystem> fs(FileSystem::Create(fs_info_));
+  ASSERT_EQ(loader::kFailOk, fs->boot_status());
+
+  // Rounded up to the minimum arena size instead of disabling the cache
+  options_mgr_.SetValue("CVMFS_LISTING_CACHE_SIZE", "1");
+  {
+    UniquePtr<MountPoint> mp(MountPoint::Create("keys.cern.ch", fs.weak_ref()));
+    ASSERT_EQ(loader::kFailOk, mp->boot_status());
+    EXPECT_TRUE(mp->listing_cache() != NULL);
+  }
+
+  options_mgr_.SetValue("CVMFS_LISTING_CACHE_SIZE", "0");
+  {
+    UniquePtr<MountPoint> mp(MountPoint::Create("keys.cern.ch", fs.weak_ref()));
+    ASSERT_EQ(loader::kFailOk, mp->boot_status());
+    EXPECT_EQ(NULL, mp->listing_cache());
+  }
+}
+
+
 TEST_F(T_MountPoint, MountErrors) {
   CreateMiniRepository(&options_mgr_, &repo_path_);
   UniquePtr<FileSystem> fs(FileSystem::Create(fs_info_));
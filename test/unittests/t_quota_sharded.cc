@@ -0,0 +1,450 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "cache_posix.h"
+#include "crypto/hash.h"
+#include "duplex_sqlite3.h"
+#include "quota_posix.h"
+#include "quota_sharded.h"
+#include "testutil.h"
+#include "util/algorithm.h"
+#include "util/posix.h"
+#include "util/prng.h"
+#include "util/string.h"
+
+using namespace std;  // NOLINT
+
+class T_ShardedQuotaManager : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    used_fds_ = GetNoUsedFds();
+
+    tmp_path_ = CreateTempDir("./cvmfs_ut_sharded_quota_manager");
+    delete PosixCacheManager::Create(tmp_path_, false);
+
+    limit_ = 10*1024*1024;  // 10M
+    threshold_ = 5*1024*1024;  // 5M
+
+    quota_mgr_ =
+      ShardedQuotaManager::Create(tmp_path_, limit_, threshold_, false);
+    ASSERT_TRUE(quota_mgr_ != NULL);
+    quota_mgr_->Spawn();
+
+    for (unsigned i = 0; i < 8; ++i) {
+      hashes_.push_back(shash::Any(shash::kSha1));
+      hashes_[i].digest[0] = i;
+      hashes_[i].digest[19] = i;
+    }
+    prng_.InitLocaltime();
+  }
+
+  virtual void TearDown() {
+    delete quota_mgr_;
+    if (tmp_path_ != "")
+      RemoveTree(tmp_path_);
+    EXPECT_EQ(used_fds_, GetNoUsedFds());
+  }
+
+  void Restart(const bool rebuild) {
+    delete quota_mgr_;
+    quota_mgr_ =
+      ShardedQuotaManager::Create(tmp_path_, limit_, threshold_, rebuild);
+    ASSERT_TRUE(quota_mgr_ != NULL);
+    quota_mgr_->Spawn();
+  }
+
+  // The listing order depends on the sharding
+  string PrintSortedStringVector(vector<string> lines) {
+    sort(lines.begin(), lines.end());
+    string result;
+    for (unsigned i = 0; i < lines.size(); ++i)
+      result += lines[i] + "\n";
+    return result;
+  }
+
+  uint64_t limit_;
+  uint64_t threshold_;
+  ShardedQuotaManager *quota_mgr_;
+  string tmp_path_;
+  unsigned used_fds_;
+  vector<shash::Any> hashes_;
+  Prng prng_;
+};
+
+
+TEST_F(T_ShardedQuotaManager, BroadcastBackchannels) {
+  int channel1[2];
+  int channel2[2];
+  quota_mgr_->RegisterBackChannel(channel1, "A");
+  quota_mgr_->RegisterBackChannel(channel2, "B");
+  quota_mgr_->BroadcastBackchannels("X");
+  char buf;
+  ReadPipe(channel1[0], &buf, 1);
+  EXPECT_EQ('X', buf);
+  ReadPipe(channel2[0], &buf, 1);
+  EXPECT_EQ('X', buf);
+  quota_mgr_->UnregisterBackChannel(channel1, "A");
+  quota_mgr_->UnregisterBackChannel(channel2, "B");
+}
+
+
+TEST_F(T_ShardedQuotaManager, Cleanup) {
+  shash::Any hash_null(shash::kSha1);
+  shash::Any hash_rnd(shash::kSha1);
+  hash_rnd.Randomize();
+  CreateFile(tmp_path_ + "/" + hash_null.MakePath(), 0600);
+  CreateFile(tmp_path_ + "/" + hash_rnd.MakePath(), 0600);
+
+  quota_mgr_->Insert(hash_null, 1, "");
+  quota_mgr_->Insert(hash_rnd, 1, "");
+  EXPECT_TRUE(quota_mgr_->Cleanup(2));
+  EXPECT_EQ(0U, quota_mgr_->GetCleanupRate(60));
+  EXPECT_EQ(2U, quota_mgr_->GetSize());
+  EXPECT_TRUE(quota_mgr_->Cleanup(0));
+  EXPECT_EQ(1U, quota_mgr_->GetCleanupRate(60));
+  EXPECT_EQ(0U, quota_mgr_->GetSize());
+  EXPECT_FALSE(FileExists(tmp_path_ + "/" + hash_null.MakePath()));
+  EXPECT_FALSE(FileExists(tmp_path_ + "/" + hash_rnd.MakePath()));
+  EXPECT_EQ("", PrintSortedStringVector(quota_mgr_->List()));
+
+  quota_mgr_->Insert(hash_null, 1, "");
+  EXPECT_TRUE(quota_mgr_->Pin(hash_rnd, 1, "", false));
+  EXPECT_FALSE(quota_mgr_->Cleanup(0));
+  EXPECT_EQ(1U, quota_mgr_->GetSize());
+}
+
+
+TEST_F(T_ShardedQuotaManager, CleanupLru) {
+  unsigned N = hashes_.size();
+  vector<shash::Any> shuffled_hashes = Shuffle(hashes_, &prng_);
+  for (unsigned i = 0; i < N; ++i)
+    quota_mgr_->Insert(shuffled_hashes[i], 1,
+                       StringifyInt(shuffled_hashes[i].digest[0]));
+  for (unsigned i = 0; i < N; ++i)
+    quota_mgr_->Touch(hashes_[i]);
+
+  EXPECT_TRUE(quota_mgr_->Cleanup(N/2));
+  vector<string> remaining = quota_mgr_->List();
+  EXPECT_EQ(N/2, remaining.size());
+  sort(remaining.begin(), remaining.end());
+  for (unsigned i = 0; i < remaining.size(); ++i) {
+    EXPECT_EQ(StringifyInt(N/2 + i), remaining[i]);
+  }
+}
+
+
+TEST_F(T_ShardedQuotaManager, CleanupVolatile) {
+  unsigned N = hashes_.size();
+  for (unsigned i = 0; i < N-2; ++i)
+    quota_mgr_->Insert(hashes_[i], 1, StringifyInt(i));
+  for (unsigned i = N-2; i < N; ++i)
+    quota_mgr_->InsertVolatile(hashes_[i], 1, StringifyInt(i));
+  // Touching doesn't remove the volatile flag
+  quota_mgr_->Touch(hashes_[N-2]);
+  EXPECT_EQ(StringifyInt(N-2) + "\n" + StringifyInt(N-1) + "\n",
+            PrintSortedStringVector(quota_mgr_->ListVolatile()));
+
+  EXPECT_TRUE(quota_mgr_->Cleanup(N-1));
+  EXPECT_EQ(StringifyInt(N-2) + "\n",
+            PrintSortedStringVector(quota_mgr_->ListVolatile()));
+  EXPECT_TRUE(quota_mgr_->Cleanup(N-3));
+  EXPECT_EQ("", PrintSortedStringVector(quota_mgr_->ListVolatile()));
+  vector<string> remaining = quota_mgr_->List();
+  ASSERT_EQ(N-3, remaining.size());
+  sort(remaining.begin(), remaining.end());
+  EXPECT_EQ(StringifyInt(1), remaining[0]);
+}
+
+
+TEST_F(T_ShardedQuotaManager, AsyncCleanup) {
+  // Crossing the limit wakes up the background thread
+  const uint64_t size = limit_ / 4;
+  for (unsigned i = 0; i < 5; ++i)
+    quota_mgr_->Insert(hashes_[i], size, StringifyInt(i));
+  for (unsigned i = 0; (i < 100) && (quota_mgr_->GetSize() > threshold_); ++i)
+    SafeSleepMs(50);
+  EXPECT_GE(threshold_, quota_mgr_->GetSize());
+  EXPECT_EQ("3\n4\n", PrintSortedStringVector(quota_mgr_->List()));
+}
+
+
+TEST_F(T_ShardedQuotaManager, InsertList) {
+  EXPECT_EQ("", PrintSortedStringVector(quota_mgr_->List()));
+  EXPECT_EQ("", PrintSortedStringVector(quota_mgr_->ListCatalogs()));
+  EXPECT_EQ("", PrintSortedStringVector(quota_mgr_->ListPinned()));
+  EXPECT_EQ("", PrintSortedStringVector(quota_mgr_->ListVolatile()));
+
+  for (unsigned i = 0; i < 2; ++i) {
+    quota_mgr_->Insert(hashes_[0], 0, "regular");
+    quota_mgr_->InsertVolatile(hashes_[1], 0, "volatile");
+    EXPECT_TRUE(quota_mgr_->Pin(hashes_[2], 0, "pinned", false));
+    EXPECT_TRUE(quota_mgr_->Pin(hashes_[3], 1, "catalog", true));
+    EXPECT_EQ(1U, quota_mgr_->GetSize());
+    EXPECT_EQ(1U, quota_mgr_->GetSizePinned());
+    EXPECT_EQ("pinned\nregular\nvolatile\n",
+              PrintSortedStringVector(quota_mgr_->List()));
+    EXPECT_EQ("catalog\n", PrintSortedStringVector(quota_mgr_->ListCatalogs()));
+    EXPECT_EQ("catalog\npinned\n",
+              PrintSortedStringVector(quota_mgr_->ListPinned()));
+    EXPECT_EQ("volatile\n",
+              PrintSortedStringVector(quota_mgr_->ListVolatile()));
+  }
+
+  // Re-insertion with a different size corrects the gauge
+  quota_mgr_->Insert(hashes_[0], 10, "regular");
+  EXPECT_EQ(11U, quota_mgr_->GetSize());
+}
+
+
+TEST_F(T_ShardedQuotaManager, PinUnpin) {
+  EXPECT_FALSE(quota_mgr_->Pin(hashes_[0], 1000000000, "", false));
+  EXPECT_TRUE(quota_mgr_->Pin(hashes_[0], threshold_, "x", false));
+  EXPECT_TRUE(quota_mgr_->Pin(hashes_[0], threshold_, "x", false));
+  EXPECT_FALSE(quota_mgr_->Pin(hashes_[1], 1, "", false));
+  quota_mgr_->Insert(hashes_[1], threshold_, "y");
+  EXPECT_EQ("x\ny\n", PrintSortedStringVector(quota_mgr_->List()));
+  EXPECT_EQ("x\n", PrintSortedStringVector(quota_mgr_->ListPinned()));
+
+  // Unpin keeps files that still exist
+  CreateFile(tmp_path_ + "/" + hashes_[0].MakePathWithoutSuffix(), 0600);
+  quota_mgr_->Unpin(hashes_[0]);
+  EXPECT_EQ(0U, quota_mgr_->GetSizePinned());
+  EXPECT_EQ("", PrintSortedStringVector(quota_mgr_->ListPinned()));
+  EXPECT_EQ("x\ny\n", PrintSortedStringVector(quota_mgr_->List()));
+
+  // Unpin removes a file that does not exist anymore
+  EXPECT_TRUE(quota_mgr_->Pin(hashes_[2], 1, "z", false));
+  quota_mgr_->Unpin(hashes_[2]);
+  EXPECT_EQ("x\ny\n", PrintSortedStringVector(quota_mgr_->List()));
+  EXPECT_EQ(2 * threshold_, quota_mgr_->GetSize());
+}
+
+
+TEST_F(T_ShardedQuotaManager, Persistence) {
+  EXPECT_TRUE(quota_mgr_->Pin(hashes_[0], 1, "pinned", true));
+  quota_mgr_->Insert(hashes_[1], 2, "regular");
+  quota_mgr_->InsertVolatile(hashes_[2], 4, "volatile");
+  quota_mgr_->Insert(hashes_[3], 8, "removed");
+  quota_mgr_->Remove(hashes_[3]);
+  quota_mgr_->Touch(hashes_[1]);
+
+  Restart(false);
+  EXPECT_EQ(7U, quota_mgr_->GetSize());
+  // Pins are not persistent
+  EXPECT_EQ(0U, quota_mgr_->GetSizePinned());
+  EXPECT_EQ("", PrintSortedStringVector(quota_mgr_->ListPinned()));
+  EXPECT_EQ("regular\nvolatile\n",
+            PrintSortedStringVector(quota_mgr_->List()));
+  EXPECT_EQ("pinned\n", PrintSortedStringVector(quota_mgr_->ListCatalogs()));
+  EXPECT_EQ("volatile\n", PrintSortedStringVector(quota_mgr_->ListVolatile()));
+
+  // LRU order survives the restart: volatile, regular, previously pinned
+  EXPECT_TRUE(quota_mgr_->Cleanup(3));
+  EXPECT_EQ("regular\n", PrintSortedStringVector(quota_mgr_->List()));
+  EXPECT_TRUE(quota_mgr_->Cleanup(1));
+  EXPECT_EQ("", PrintSortedStringVector(quota_mgr_->List()));
+  EXPECT_EQ("pinned\n", PrintSortedStringVector(quota_mgr_->ListCatalogs()));
+
+  // New entries get sequence numbers beyond the loaded ones
+  quota_mgr_->Insert(hashes_[4], 1, "new");
+  Restart(false);
+  EXPECT_TRUE(quota_mgr_->Cleanup(1));
+  EXPECT_EQ("new\n", PrintSortedStringVector(quota_mgr_->List()));
+}
+
+
+TEST_F(T_ShardedQuotaManager, PosixCompatibility) {
+  delete quota_mgr_;
+  quota_mgr_ = NULL;
+
+  PosixQuotaManager *posix_mgr =
+    PosixQuotaManager::Create(tmp_path_, limit_, threshold_, false);
+  ASSERT_TRUE(posix_mgr != NULL);
+  posix_mgr->Spawn();
+  posix_mgr->Insert(hashes_[0], 1, "a");
+  posix_mgr->InsertVolatile(hashes_[1], 2, "b");
+  posix_mgr->Insert(hashes_[2], 4, "c");
+  posix_mgr->Touch(hashes_[0]);
+  delete posix_mgr;
+
+  Restart(false);
+  EXPECT_EQ(7U, quota_mgr_->GetSize());
+  EXPECT_EQ("a\nb\nc\n", PrintSortedStringVector(quota_mgr_->List()));
+  EXPECT_EQ("b\n", PrintSortedStringVector(quota_mgr_->ListVolatile()));
+  quota_mgr_->Insert(hashes_[3], 8, "d");
+  delete quota_mgr_;
+  quota_mgr_ = NULL;
+
+  posix_mgr = PosixQuotaManager::Create(tmp_path_, limit_, threshold_, false);
+  ASSERT_TRUE(posix_mgr != NULL);
+  posix_mgr->Spawn();
+  EXPECT_EQ(15U, posix_mgr->GetSize());
+  EXPECT_TRUE(posix_mgr->Cleanup(9));
+  EXPECT_EQ("a\nd\n", PrintSortedStringVector(posix_mgr->List()));
+  delete posix_mgr;
+
+  Restart(false);
+}
+
+
+TEST_F(T_ShardedQuotaManager, RebuildDatabase) {
+  delete quota_mgr_;
+  quota_mgr_ = NULL;
+  EXPECT_TRUE(MkdirDeep(tmp_path_ + "/new", 0700));
+  EXPECT_EQ(NULL, ShardedQuotaManager::Create(tmp_path_ + "/new", limit_,
+                                              threshold_, true));
+
+  CreateFile(tmp_path_ + "/" + hashes_[0].MakePath(), 0600);
+  CreateFile(tmp_path_ + "/" + hashes_[1].MakePath(), 0600);
+  unsigned char buf = 'x';
+  EXPECT_TRUE(CopyMem2Path(&buf, 1, tmp_path_ + "/" + hashes_[1].MakePath()));
+  Restart(true);
+  // The empty file was removed during rebuild
+  EXPECT_EQ(1U, quota_mgr_->GetSize());
+  EXPECT_EQ("unknown (automatic rebuild)\n",
+            PrintSortedStringVector(quota_mgr_->List()));
+  quota_mgr_->Touch(hashes_[1]);
+  quota_mgr_->Remove(hashes_[1]);
+  EXPECT_EQ(0U, quota_mgr_->GetSize());
+  EXPECT_FALSE(FileExists(tmp_path_ + "/" + hashes_[1].MakePath()));
+}
+
+
+TEST_F(T_ShardedQuotaManager, Reconcile) {
+  unsigned char buf[3] = {'x', 'y', 'z'};
+  EXPECT_TRUE(CopyMem2Path(buf, 1, tmp_path_ + "/" + hashes_[0].MakePath()));
+  quota_mgr_->Insert(hashes_[0], 1, "a");
+  // Never written to the cache directory
+  quota_mgr_->Insert(hashes_[1], 2, "b");
+  delete quota_mgr_;
+  quota_mgr_ = NULL;
+  // Missing from the database
+  EXPECT_TRUE(CopyMem2Path(buf, 3, tmp_path_ + "/" + hashes_[2].MakePath()));
+
+  // After a clean shutdown, the cache directory is not scanned
+  Restart(false);
+  EXPECT_EQ(3U, quota_mgr_->GetSize());
+  EXPECT_EQ("a\nb\n", PrintSortedStringVector(quota_mgr_->List()));
+  delete quota_mgr_;
+  quota_mgr_ = NULL;
+
+  sqlite3 *db;
+  ASSERT_EQ(SQLITE_OK, sqlite3_open((tmp_path_ + "/cachedb").c_str(), &db));
+  EXPECT_EQ(SQLITE_OK, sqlite3_exec(db,
+    "UPDATE properties SET value='0' WHERE key='clean_shutdown';",
+    NULL, NULL, NULL));
+  sqlite3_close(db);
+
+  Restart(false);
+  EXPECT_EQ(4U, quota_mgr_->GetSize());
+  EXPECT_EQ("a\nunknown (automatic reconcile)\n",
+            PrintSortedStringVector(quota_mgr_->List()));
+  EXPECT_TRUE(quota_mgr_->Cleanup(3));
+  EXPECT_EQ("unknown (automatic reconcile)\n",
+            PrintSortedStringVector(quota_mgr_->List()));
+}
+
+
+TEST_F(T_ShardedQuotaManager, SeqPerShard) {
+  ShardedQuotaManager::Shard *shard1 = quota_mgr_->GetShard(hashes_[1]);
+  ShardedQuotaManager::Shard *shard2 = quota_mgr_->GetShard(hashes_[2]);
+  ShardedQuotaManager::Shard *shard3 = quota_mgr_->GetShard(hashes_[3]);
+  quota_mgr_->Insert(hashes_[1], 1, "a");
+  quota_mgr_->Insert(hashes_[2], 1, "b");
+  const int64_t clock = atomic_read64(&quota_mgr_->seq_);
+  const uint64_t clock2 = shard2->clock;
+
+  // Touches only tick the clock of their shard
+  for (unsigned i = 0; i < 10; ++i)
+    quota_mgr_->Touch(hashes_[1]);
+  EXPECT_EQ(clock2, shard2->clock);
+  EXPECT_EQ(clock, atomic_read64(&quota_mgr_->seq_));
+
+  // ...until the clock is published, then lagging shards catch up
+  for (unsigned i = 0; i < ShardedQuotaManager::kSeqSyncInterval; ++i)
+    quota_mgr_->Touch(hashes_[1]);
+  EXPECT_LT(clock, atomic_read64(&quota_mgr_->seq_));
+  quota_mgr_->Insert(hashes_[3], 1, "c");
+  EXPECT_LE(static_cast<uint64_t>(atomic_read64(&quota_mgr_->seq_)),
+            shard3->clock);
+
+  ShardedQuotaManager::Entry entry1;
+  ShardedQuotaManager::Entry entry2;
+  ShardedQuotaManager::Entry entry3;
+  EXPECT_TRUE(shard1->entries.Lookup(hashes_[1], &entry1));
+  EXPECT_TRUE(shard2->entries.Lookup(hashes_[2], &entry2));
+  EXPECT_TRUE(shard3->entries.Lookup(hashes_[3], &entry3));
+  EXPECT_EQ(shard3->index, entry3.seq % ShardedQuotaManager::kNumShards);
+  EXPECT_LT(entry2.seq, entry1.seq);
+  EXPECT_LT(entry2.seq, entry3.seq);
+}
+
+
+TEST_F(T_ShardedQuotaManager, Coalesce) {
+  quota_mgr_->Insert(hashes_[0], 1, "a");
+  quota_mgr_->Flush();
+  ShardedQuotaManager::Shard *shard = quota_mgr_->GetShard(hashes_[0]);
+  EXPECT_EQ(0U, shard->ops.size());
+  for (unsigned i = 0; i < 100; ++i)
+    quota_mgr_->Touch(hashes_[0]);
+  // Only the first touch queues a database update
+  EXPECT_EQ(1U, shard->ops.size());
+  quota_mgr_->Flush();
+  EXPECT_EQ(0U, shard->ops.size());
+}
+
+
+struct ThreadData {
+  ShardedQuotaManager *quota_mgr;
+  vector<shash::Any> *hashes;
+  unsigned offset;
+};
+
+static void *MainInsertTouch(void *data) {
+  ThreadData *td = reinterpret_cast<ThreadData *>(data);
+  for (unsigned i = td->offset; i < td->hashes->size(); i += 4) {
+    td->quota_mgr->Insert((*td->hashes)[i], 1, "");
+    td->quota_mgr->Touch((*td->hashes)[(i * 7) % td->hashes->size()]);
+  }
+  return NULL;
+}
+
+TEST_F(T_ShardedQuotaManager, Shards) {
+  vector<shash::Any> hashes;
+  for (unsigned i = 0; i < 10000; ++i) {
+    hashes.push_back(shash::Any(shash::kSha1));
+    hashes[i].Randomize(&prng_);
+  }
+
+  pthread_t threads[4];
+  ThreadData thread_data[4];
+  for (unsigned i = 0; i < 4; ++i) {
+    thread_data[i].quota_mgr = quota_mgr_;
+    thread_data[i].hashes = &hashes;
+    thread_data[i].offset = i;
+    int retval = pthread_create(&threads[i], NULL, MainInsertTouch,
+                                &thread_data[i]);
+    ASSERT_EQ(0, retval);
+  }
+  for (unsigned i = 0; i < 4; ++i)
+    pthread_join(threads[i], NULL);
+
+  EXPECT_EQ(hashes.size(), quota_mgr_->GetSize());
+  unsigned num_entries = 0;
+  for (unsigned i = 0; i < ShardedQuotaManager::kNumShards; ++i) {
+    // The shards are used evenly
+    EXPECT_LT(0U, quota_mgr_->shards_[i].entries.size());
+    num_entries += quota_mgr_->shards_[i].entries.size();
+  }
+  EXPECT_EQ(hashes.size(), num_entries);
+  EXPECT_EQ(hashes.size(), quota_mgr_->List().size());
+}
@@ -0,0 +1,235 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "backoff.h"
+#include "cache_posix.h"
+#include "compression.h"
+#include "crypto/hash.h"
+#include "fetch.h"
+#include "file_chunk.h"
+#include "network/download.h"
+#include "readahead.h"
+#include "statistics.h"
+#include "testutil.h"
+#include "util/concurrency.h"
+#include "util/posix.h"
+
+using namespace std;  // NOLINT
+
+namespace cvmfs {
+
+class T_ChunkReadAhead : public ::testing::Test {
+ protected:
+  static const unsigned kNumChunks = 8;
+  static const unsigned kChunkSize = 1024;
+
+  virtual void SetUp() {
+    used_fds_ = GetNoUsedFds();
+
+    tmp_path_ =
+      CreateTempDir(GetCurrentWorkingDirectory() + "/cvmfs_ut_readahead");
+    const string src_path = tmp_path_ + "/data";
+    for (unsigned i = 0; i < kNumChunks; ++i) {
+      const string content(kChunkSize, static_cast<char>('a' + i));
+      void *buf;
+      uint64_t buf_size;
+      EXPECT_TRUE(zlib::CompressMem2Mem(content.data(), content.size(),
+                                        &buf, &buf_size));
+      shash::Any hash(shash::kSha1);
+      shash::HashMem(static_cast<unsigned char *>(buf), buf_size, &hash);
+      MkdirDeep(GetParentPath(src_path + "/" + hash.MakePath()), 0700);
+      EXPECT_TRUE(CopyMem2Path(static_cast<unsigned char *>(buf), buf_size,
+                               src_path + "/" + hash.MakePath()));
+      free(buf);
+      chunk_list_.PushBack(FileChunk(hash, i * kChunkSize, kChunkSize));
+    }
+    chunks_ = FileChunkReflist(&chunk_list_, PathString("/chunked"),
+                               zlib::kZlibDefault, false);
+
+    cache_mgr_ = PosixCacheManager::Create(tmp_path_ + "/cache", false);
+    ASSERT_TRUE(cache_mgr_ != NULL);
+
+    download_mgr_ = new download::DownloadManager();
+    download_mgr_->Init(8, perf::StatisticsTemplate("test", &statistics_));
+    download_mgr_->SetHostChain("file://" + tmp_path_);
+
+    fetcher_ = new Fetcher(
+      cache_mgr_, download_mgr_, &backoff_throttle_,
+      perf::StatisticsTemplate("fetch", &statistics_));
+  }
+
+  virtual void TearDown() {
+    delete fetcher_;
+    download_mgr_->Fini();
+    delete download_mgr_;
+    delete cache_mgr_;
+    if (tmp_path_ != "")
+      RemoveTree(tmp_path_);
+    EXPECT_EQ(used_fds_, GetNoUsedFds());
+  }
+
+  perf::StatisticsTemplate ReadAheadStatistics() {
+    return perf::StatisticsTemplate("readahead", &statistics_);
+  }
+
+  int64_t GetCounter(const string &name) {
+    return statistics_.Lookup("readahead." + name)->Get();
+  }
+
+  bool WaitForFetched(const int64_t expected) {
+    for (unsigned i = 0; i < 500; ++i) {
+      if (GetCounter("n_fetched") + GetCounter("n_failed") >= expected)
+        return true;
+      SafeSleepMs(10);
+    }
+    return false;
+  }
+
+  bool IsCached(const unsigned chunk_idx) {
+    int fd = cache_mgr_->Open(CacheManager::Bless(
+      chunk_list_.AtPtr(chunk_idx)->content_hash()));
+    if (fd < 0)
+      return false;
+    cache_mgr_->Close(fd);
+    return true;
+  }
+
+  unsigned used_fds_;
+  string tmp_path_;
+  FileChunkList chunk_list_;
+  FileChunkReflist chunks_;
+  Fetcher *fetcher_;
+  PosixCacheManager *cache_mgr_;
+  perf::Statistics statistics_;
+  download::DownloadManager *download_mgr_;
+  BackoffThrottle backoff_throttle_;
+};
+
+
+TEST_F(T_ChunkReadAhead, Disabled) {
+  ChunkReadAhead read_ahead(0, 2, fetcher_, fetcher_,
+                            ReadAheadStatistics());
+  read_ahead.Spawn();
+  EXPECT_EQ(0, GetCounter("window"));
+  read_ahead.OnChunkOpen(chunks_, 0, false, CacheManager::kTypeRegular);
+  read_ahead.OnChunkOpen(chunks_, 1, true, CacheManager::kTypeRegular);
+  EXPECT_EQ(0, GetCounter("n_scheduled"));
+  EXPECT_EQ(0, GetCounter("n_miss"));
+}
+
+
+TEST_F(T_ChunkReadAhead, RandomAccess) {
+  ChunkReadAhead read_ahead(4, 2, fetcher_, fetcher_,
+                            ReadAheadStatistics());
+  read_ahead.Spawn();
+  EXPECT_EQ(4, GetCounter("window"));
+  read_ahead.OnChunkOpen(chunks_, 0, false, CacheManager::kTypeRegular);
+  read_ahead.OnChunkOpen(chunks_, 5, false, CacheManager::kTypeRegular);
+  read_ahead.OnChunkOpen(chunks_, 2, false, CacheManager::kTypeRegular);
+  EXPECT_EQ(0, GetCounter("n_scheduled"));
+  for (unsigned i = 0; i < kNumChunks; ++i)
+    EXPECT_FALSE(IsCached(i));
+}
+
+
+TEST_F(T_ChunkReadAhead, Sequential) {
+  ChunkReadAhead read_ahead(3, 2, fetcher_, fetcher_,
+                            ReadAheadStatistics());
+  read_ahead.Spawn();
+
+  read_ahead.OnChunkOpen(chunks_, 0, false, CacheManager::kTypeRegular);
+  EXPECT_EQ(0, GetCounter("n_scheduled"));
+  // Chunk 1 has not been fetched ahead
+  read_ahead.OnChunkOpen(chunks_, 1, true, CacheManager::kTypeRegular);
+  EXPECT_EQ(1, GetCounter("n_miss"));
+  EXPECT_EQ(3, GetCounter("n_scheduled"));
+  ASSERT_TRUE(WaitForFetched(3));
+  EXPECT_EQ(3, GetCounter("n_fetched"));
+  EXPECT_FALSE(IsCached(1));
+  EXPECT_TRUE(IsCached(2));
+  EXPECT_TRUE(IsCached(3));
+  EXPECT_TRUE(IsCached(4));
+  EXPECT_FALSE(IsCached(5));
+
+  // Chunk 2 is ready, only chunk 5 is new in the window
+  read_ahead.OnChunkOpen(chunks_, 2, true, CacheManager::kTypeRegular);
+  EXPECT_EQ(1, GetCounter("n_hit"));
+  EXPECT_EQ(4, GetCounter("n_scheduled"));
+  ASSERT_TRUE(WaitForFetched(4));
+  EXPECT_TRUE(IsCached(5));
+
+  // The window is capped at the end of the file
+  read_ahead.OnChunkOpen(chunks_, 6, true, CacheManager::kTypeRegular);
+  EXPECT_EQ(5, GetCounter("n_scheduled"));
+  ASSERT_TRUE(WaitForFetched(5));
+  EXPECT_TRUE(IsCached(7));
+  EXPECT_EQ(0, GetCounter("n_failed"));
+}
+
+
+TEST_F(T_ChunkReadAhead, FetchFailure) {
+  ChunkReadAhead read_ahead(2, 1, fetcher_, fetcher_,
+                            ReadAheadStatistics());
+  read_ahead.Spawn();
+  EXPECT_EQ(0, unlink((tmp_path_ + "/data/" +
+    chunk_list_.AtPtr(2)->content_hash().MakePath()).c_str()));
+
+  read_ahead.OnChunkOpen(chunks_, 1, true, CacheManager::kTypeRegular);
+  ASSERT_TRUE(WaitForFetched(2));
+  EXPECT_EQ(1, GetCounter("n_fetched"));
+  EXPECT_EQ(1, GetCounter("n_failed"));
+  EXPECT_FALSE(IsCached(2));
+  EXPECT_TRUE(IsCached(3));
+
+  // The failed chunk is not counted as being read ahead
+  read_ahead.OnChunkOpen(chunks_, 2, true, CacheManager::kTypeRegular);
+  EXPECT_EQ(0, GetCounter("n_hit"));
+  read_ahead.OnChunkOpen(chunks_, 3, true, CacheManager::kTypeRegular);
+  EXPECT_EQ(1, GetCounter("n_hit"));
+}
+
+
+TEST_F(T_ChunkReadAhead, Tracking) {
+  ChunkReadAhead read_ahead(4, 1, fetcher_, fetcher_,
+                            ReadAheadStatistics());
+  MutexLockGuard m(&read_ahead.lock_);
+  for (unsigned i = 0; i < 2 * ChunkReadAhead::kMaxTracked; ++i) {
+    shash::Any id(shash::kSha1);
+    id.Randomize(i);
+    read_ahead.Track(id);
+  }
+  EXPECT_EQ(ChunkReadAhead::kMaxTracked, read_ahead.tracked_.size());
+  EXPECT_EQ(ChunkReadAhead::kMaxTracked, read_ahead.tracked_fifo_.size());
+
+  // A chunk that is untracked and tracked again must survive the eviction of
+  // its stale entry at the head of the fifo
+  const shash::Any oldest_id = read_ahead.tracked_fifo_.front().first;
+  read_ahead.Untrack(oldest_id);
+  const uint64_t generation = read_ahead.Track(oldest_id);
+  EXPECT_EQ(ChunkReadAhead::kMaxTracked, read_ahead.tracked_.size());
+  EXPECT_EQ(ChunkReadAhead::kMaxTracked, read_ahead.tracked_fifo_.size());
+  ASSERT_EQ(1U, read_ahead.tracked_.count(oldest_id));
+  EXPECT_EQ(generation, read_ahead.tracked_[oldest_id].generation);
+  EXPECT_EQ(ChunkReadAhead::kChunkPending,
+            read_ahead.tracked_[oldest_id].state);
+
+  // The re-tracked chunk is evicted with its new fifo entry
+  for (unsigned i = 0; i < ChunkReadAhead::kMaxTracked - 1; ++i) {
+    shash::Any id(shash::kSha1);
+    id.Randomize(2 * ChunkReadAhead::kMaxTracked + i);
+    read_ahead.Track(id);
+  }
+  EXPECT_EQ(1U, read_ahead.tracked_.count(oldest_id));
+  shash::Any id(shash::kSha1);
+  id.Randomize(3 * ChunkReadAhead::kMaxTracked);
+  read_ahead.Track(id);
+  EXPECT_EQ(0U, read_ahead.tracked_.count(oldest_id));
+  EXPECT_EQ(ChunkReadAhead::kMaxTracked, read_ahead.tracked_.size());
+}
+
+}  // namespace cvmfs
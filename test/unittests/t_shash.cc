@@ -12,6 +12,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <string>
+#include <vector>
 
 #include "crypto/hash.h"
 #include "crypto/openssl_version.h"
@@ -30,11 +31,18 @@ TEST(T_Shash, ContextSize) {
   EXPECT_EQ(max_size, shash::kMaxContextSize);
 }
 
+TEST(T_Shash, MinClientVersion) {
+  EXPECT_EQ("", shash::MinClientVersion(shash::kSha1));
+  EXPECT_EQ("", shash::MinClientVersion(shash::kShake128));
+  EXPECT_EQ("2.11.0", shash::MinClientVersion(shash::kBlake3));
+}
+
 TEST(T_Shash, TestVectors) {
   shash::Any md5(shash::kMd5);
   shash::Any sha1(shash::kSha1);
   shash::Any rmd160(shash::kRmd160);
   shash::Any shake128(shash::kShake128);
+  shash::Any blake3(shash::kBlake3);
 
   HashString("", &md5);
   HashString("", &sha1);
@@ -46,6 +54,9 @@ TEST(T_Shash, TestVectors) {
     "9c1185a5c5e9fc54612808977ee8f548b2258d31-rmd160", rmd160.ToString());
   EXPECT_EQ(
     "7f9c2ba4e88f827d616045507605853ed73b8093-shake128", shake128.ToString());
+  HashString("", &blake3);
+  EXPECT_EQ(
+    "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9-blake3", blake3.ToString());
 
   HashString("abc", &md5);
   HashString("abc", &sha1);
@@ -57,6 +68,9 @@ TEST(T_Shash, TestVectors) {
     "8eb208f7e05d987a9b044a8e98c6b087f15a0bfc-rmd160", rmd160.ToString());
   EXPECT_EQ(
     "5881092dd818bf5cf8a3ddb793fbcba74097d5c5-shake128", shake128.ToString());
+  HashString("abc", &blake3);
+  EXPECT_EQ(
+    "6437b3ac38465133ffb63b75273a8db548c55846-blake3", blake3.ToString());
 
   HashString("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", &md5);
   HashString("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", &sha1);
@@ -70,6 +84,10 @@ TEST(T_Shash, TestVectors) {
     "12a053384a9c0c88e405a06c27dcf49ada62eb2b-rmd160", rmd160.ToString());
   EXPECT_EQ(
     "1a96182b50fb8c7e74e0a707788f55e98209b8d9-shake128", shake128.ToString());
+  HashString("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+             &blake3);
+  EXPECT_EQ(
+    "c19012cc2aaf0dc3d8e5c45a1b79114d2df42abb-blake3", blake3.ToString());
 
   HashString("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoi"
              "jklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", &md5);
@@ -85,6 +103,10 @@ TEST(T_Shash, TestVectors) {
     "6f3fa39b6b503c384f919a49a7aa5c2c08bdfb45-rmd160", rmd160.ToString());
   EXPECT_EQ(
     "7b6df6ff181173b6d7898d7ff63fb07b7c237daf-shake128", shake128.ToString());
+  HashString("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoi"
+             "jklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", &blake3);
+  EXPECT_EQ(
+    "553e1aa2a477cb3166e6ab38c12d59f6c5017f08-blake3", blake3.ToString());
 
   HashString("The quick brown fox jumps over the lazy dog", &md5);
   HashString("The quick brown fox jumps over the lazy dog", &sha1);
@@ -96,6 +118,9 @@ TEST(T_Shash, TestVectors) {
     "37f332f68db77bd9d7edd4969571ad671cf9dd3b-rmd160", rmd160.ToString());
   EXPECT_EQ(
     "f4202e3c5852f9182a0430fd8144f0a74b95e741-shake128", shake128.ToString());
+  HashString("The quick brown fox jumps over the lazy dog", &blake3);
+  EXPECT_EQ(
+    "2f1514181aadccd913abd94cfa592701a5686ab2-blake3", blake3.ToString());
 
   void *a_1m = smalloc(1000000);
   memset(a_1m, 'a', 1000000);
@@ -113,10 +138,47 @@ TEST(T_Shash, TestVectors) {
   HashMem(reinterpret_cast<const unsigned char *>(a_1m), 1000000, &shake128);
   EXPECT_EQ(
     "9d222c79c4ff9d092cf6ca86143aa411e3699738-shake128", shake128.ToString());
+
+  HashMem(reinterpret_cast<const unsigned char *>(a_1m), 1000000, &blake3);
+  EXPECT_EQ(
+    "616f575a1b58d4c9797d4217b9730ae5e6eb319d-blake3", blake3.ToString());
   free(a_1m);
 }
 
 
+TEST(T_Shash, HashMemMulti) {
+  // Covers empty buffers, partial and full BLAKE3 blocks and chunks, and
+  // buffers that are too large for the SIMD lanes
+  const unsigned kNumBuffers = 21;
+  const unsigned sizes[kNumBuffers] = {0, 1, 63, 64, 65, 100, 1023, 1024, 1025,
+    2048, 5000, 0, 17, 128, 129, 512, 777, 1000, 1024, 64, 100000};
+  // Buffer i starts at offset i
+  const unsigned kDataSize = 100000 + kNumBuffers;
+  unsigned char *data = reinterpret_cast<unsigned char *>(smalloc(kDataSize));
+  for (unsigned i = 0; i < kDataSize; ++i)
+    data[i] = i % 251;
+  const unsigned char *buffers[kNumBuffers];
+  for (unsigned i = 0; i < kNumBuffers; ++i)
+    buffers[i] = data + i;
+
+  for (int a = 0; a < shash::kAny; ++a) {
+    const shash::Algorithms algorithm = static_cast<shash::Algorithms>(a);
+    vector<shash::Any> digests(kNumBuffers, shash::Any(algorithm));
+    // Also use fewer buffers than SIMD lanes
+    shash::HashMemMulti(3, buffers, sizes, &digests[0]);
+    shash::HashMemMulti(kNumBuffers - 3, buffers + 3, sizes + 3,
+                        &digests[3]);
+    for (unsigned i = 0; i < kNumBuffers; ++i) {
+      shash::Any expected(algorithm);
+      shash::HashMem(buffers[i], sizes[i], &expected);
+      EXPECT_EQ(expected, digests[i]) << "algorithm " << a << ", size "
+                                      << sizes[i];
+    }
+  }
+  free(data);
+}
+
+
 TEST(T_Shash, LongTestVectorsSlow) {
   string s = "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmno";
   unsigned rep_s = 16777216;
@@ -201,6 +263,19 @@ TEST(T_Shash, LongTestVectorsSlow) {
   EXPECT_EQ(
     "89037f62987385ffd69f4b3c3a97c43ac72de761-shake128", shake128.ToString());
 
+  shash::Any blake3(shash::kBlake3);
+  shash::ContextPtr context_ptr_blake3(shash::kBlake3);
+  context_ptr_blake3.buffer = smalloc(context_ptr_blake3.size);
+  shash::Init(context_ptr_blake3);
+  for (unsigned i = 0; i < rep_s; ++i) {
+    shash::Update(reinterpret_cast<const unsigned char *>(s.data()), s.length(),
+                  context_ptr_blake3);
+  }
+  shash::Final(context_ptr_blake3, &blake3);
+  EXPECT_EQ(
+    "b616a3c03125f6b9da48f8075d69de91984ed007-blake3", blake3.ToString());
+  free(context_ptr_blake3.buffer);
+
   free(context_ptr_md5.buffer);
   free(context_ptr_sha1.buffer);
   free(context_ptr_rmd160.buffer);
@@ -267,6 +342,13 @@ TEST(T_Shash, VerifyHex) {
   EXPECT_EQ(shash::HexPtr(
     "adc83b19e793491b1c6ea0fd8b46cd9f32e592fcc-shake128").IsValid(),
     false);
+
+  EXPECT_EQ(shash::HexPtr(
+    "adc83b19e793491b1c6ea0fd8b46cd9f32e592fc-blake3").IsValid(),
+    true);
+  EXPECT_EQ(shash::HexPtr(
+    "adc83b19e793491b1c6ea0fd8b46cd9f32e592fc-blake2").IsValid(),
+    false);
 }
 
 
@@ -281,11 +363,21 @@ TEST(T_Shash, MkFromHexPtr) {
   sha1.Randomize();
   rmd160.Randomize();
   shake128.Randomize();
+  shash::Any blake3(shash::kBlake3);
+  blake3.Randomize();
 
   EXPECT_EQ(md5, shash::MkFromHexPtr(shash::HexPtr(md5.ToString())));
   EXPECT_EQ(sha1, shash::MkFromHexPtr(shash::HexPtr(sha1.ToString())));
   EXPECT_EQ(rmd160, shash::MkFromHexPtr(shash::HexPtr(rmd160.ToString())));
   EXPECT_EQ(shake128, shash::MkFromHexPtr(shash::HexPtr(shake128.ToString())));
+  // Same length as RIPEMD-160, told apart by the identifier
+  EXPECT_EQ(blake3, shash::MkFromHexPtr(shash::HexPtr(blake3.ToString())));
+  EXPECT_EQ(shash::kBlake3,
+            shash::MkFromHexPtr(shash::HexPtr(blake3.ToString())).algorithm);
+  EXPECT_EQ(shash::kRmd160,
+            shash::MkFromHexPtr(shash::HexPtr(rmd160.ToString())).algorithm);
+  EXPECT_EQ(shash::Any(), shash::MkFromHexPtr(shash::HexPtr(
+    "adc83b19e793491b1c6ea0fd8b46cd9f32e592fc-blake2")));
 
   shash::Any constructed = shash::MkFromHexPtr(shash::HexPtr(sha1.ToString()));
   EXPECT_EQ(shash::kSuffixNone, constructed.suffix);
@@ -341,6 +433,15 @@ TEST(T_Shash, MkFromSuffixedHexPtr) {
     shash::MkFromSuffixedHexPtr(shash::HexPtr(shake128S.ToString(true)));
   EXPECT_EQ(shake128S, constructed);
   EXPECT_EQ(shake128S.suffix, constructed.suffix);
+
+  shash::Any blake3S(shash::kBlake3);
+  blake3S.Randomize();
+  blake3S.suffix = shash::kSuffixCatalog;
+  constructed =
+    shash::MkFromSuffixedHexPtr(shash::HexPtr(blake3S.ToString(true)));
+  EXPECT_EQ(blake3S, constructed);
+  EXPECT_EQ(shash::kBlake3, constructed.algorithm);
+  EXPECT_EQ(blake3S.suffix, constructed.suffix);
 }
 
 
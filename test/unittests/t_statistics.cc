@@ -4,9 +4,15 @@
 
 #include "gtest/gtest.h"
 
+#include <pthread.h>
+
+#include <map>
+#include <string>
+
 #include "json_document.h"
 #include "json_document_write.h"
 #include "statistics.h"
+#include "util/algorithm.h"
 #include "util/platform.h"
 #include "util/pointer.h"
 
@@ -98,6 +104,115 @@ TEST(T_Statistics, StatisticsTemplate) {
 }
 
 
+static void *MainIncrement(void *data) {
+  Counter *counter = reinterpret_cast<Counter *>(data);
+  for (unsigned i = 0; i < 10000; ++i) {
+    counter->Inc();
+    counter->Xadd(2);
+    counter->Dec();
+  }
+  return NULL;
+}
+
+
+TEST(T_Statistics, Sharded) {
+  Statistics statistics;
+  StatisticsTemplate stat_template("template", &statistics);
+
+  Counter *counter = statistics.RegisterSharded("sharded", "a test counter");
+  EXPECT_TRUE(counter->IsSharded());
+  EXPECT_FALSE(statistics.Register("plain", "a test counter")->IsSharded());
+  EXPECT_EQ(counter, statistics.Lookup("sharded"));
+  Counter *cnt_template =
+    stat_template.RegisterShardedTemplated("value", "a test counter");
+  EXPECT_TRUE(cnt_template->IsSharded());
+  EXPECT_EQ(cnt_template, statistics.Lookup("template.value"));
+
+  EXPECT_EQ(0, counter->Get());
+  counter->Inc();
+  counter->Xadd(10);
+  counter->Dec();
+  EXPECT_EQ(10, counter->Get());
+  counter->Set(5);
+  EXPECT_EQ(5, counter->Get());
+  EXPECT_EQ("5", counter->Print());
+
+  const unsigned kNumThreads = 8;
+  pthread_t threads[kNumThreads];
+  for (unsigned i = 0; i < kNumThreads; ++i) {
+    int retval = pthread_create(&threads[i], NULL, MainIncrement, counter);
+    ASSERT_EQ(0, retval);
+  }
+  for (unsigned i = 0; i < kNumThreads; ++i)
+    pthread_join(threads[i], NULL);
+  EXPECT_EQ(5 + kNumThreads * 10000 * 2, counter->Get());
+
+  // Forked statistics share the slots
+  Statistics *stat_child = statistics.Fork();
+  perf::Inc(stat_child->Lookup("sharded"));
+  delete stat_child;
+  EXPECT_EQ(6 + kNumThreads * 10000 * 2, counter->Get());
+}
+
+
+TEST(T_Statistics, Histograms) {
+  Statistics statistics;
+  StatisticsTemplate stat_template("template", &statistics);
+
+  Log2Histogram *hist =
+    stat_template.RegisterHistogramTemplated("hist", "a test histogram");
+  ASSERT_TRUE(hist != NULL);
+  EXPECT_EQ(hist, statistics.LookupHistogram("template.hist"));
+  EXPECT_EQ(NULL, statistics.LookupHistogram("template.unknown"));
+  EXPECT_EQ(NULL, statistics.Lookup("template.hist"));
+  ASSERT_DEATH(statistics.RegisterHistogram("template.hist", "Name Clash"),
+               ".*");
+
+  map<string, int64_t> snapshot;
+  uint64_t timestamp;
+  statistics.SnapshotCounters(&snapshot, &timestamp);
+  EXPECT_EQ(1U, snapshot.size());
+  EXPECT_EQ(0, snapshot["template.hist.n"]);
+  map<string, int64_t> gauges;
+  statistics.SnapshotGauges(&gauges);
+  EXPECT_EQ(3U, gauges.size());
+  EXPECT_EQ(0, gauges["template.hist.p50"]);
+
+  for (unsigned i = 0; i < 100; ++i)
+    hist->Add(1000);
+  statistics.SnapshotCounters(&snapshot, &timestamp);
+  EXPECT_EQ(1U, snapshot.size());
+  EXPECT_EQ(100, snapshot["template.hist.n"]);
+  statistics.SnapshotGauges(&gauges);
+  EXPECT_EQ(3U, gauges.size());
+  EXPECT_LE(512, gauges["template.hist.p50"]);
+  EXPECT_GE(1024, gauges["template.hist.p90"]);
+  EXPECT_GE(1024, gauges["template.hist.p99"]);
+
+  // Percentiles only cover the samples since the previous snapshot
+  statistics.SnapshotGauges(&gauges);
+  EXPECT_EQ(0, gauges["template.hist.p50"]);
+  EXPECT_EQ(0, gauges["template.hist.p99"]);
+  for (unsigned i = 0; i < 100; ++i)
+    hist->Add(100000);
+  statistics.SnapshotGauges(&gauges);
+  EXPECT_LE(65536, gauges["template.hist.p50"]);
+  EXPECT_GE(131072, gauges["template.hist.p99"]);
+  statistics.SnapshotCounters(&snapshot, &timestamp);
+  EXPECT_EQ(200, snapshot["template.hist.n"]);
+
+  // Forked statistics share the histogram
+  Statistics *stat_child = statistics.Fork();
+  EXPECT_EQ(hist, stat_child->LookupHistogram("template.hist"));
+  delete stat_child;
+  hist->Add(1000);
+  EXPECT_EQ(201U, statistics.LookupHistogram("template.hist")->N());
+
+  EXPECT_EQ(0U, statistics.PrintHistograms().find(
+    "template.hist (a test histogram)\n"));
+}
+
+
 TEST(T_Statistics, RecorderConstruct) {
   Recorder recorder(5, 10);
   EXPECT_EQ(10U, recorder.capacity_s());
@@ -7,6 +7,7 @@
 #include <cstdlib>
 
 #include "options.h"
+#include "util/algorithm.h"
 #include "util/file_guard.h"
 #include "util/posix.h"
 #include "util/string.h"
@@ -234,4 +235,40 @@ TEST_F(T_TelemetryAggregator, UpdateCounters_WithExtraFields_Tags) {
   EXPECT_NO_FATAL_FAILURE(String2Uint64(delta_payload_split[2]));
 }
 
+TEST_F(T_TelemetryAggregator, Gauges) {
+  perf::TelemetryAggregatorInflux telemetry_influx(&statistics_, 10,
+                                                   &options_manager_,
+                                                   fqrn_);
+  EXPECT_FALSE(telemetry_influx.is_zombie_);
+  Log2Histogram *hist = statistics_.RegisterHistogram("test.hist", "test");
+  for (unsigned i = 0; i < 10; ++i)
+    hist->Add(1000);
+
+  statistics_.SnapshotCounters(&telemetry_influx.counters_,
+                               &telemetry_influx.timestamp_);
+  statistics_.SnapshotGauges(&telemetry_influx.gauges_);
+  EXPECT_EQ(1u, telemetry_influx.counters_.count("test.hist.n"));
+  EXPECT_EQ(0u, telemetry_influx.counters_.count("test.hist.p50"));
+  EXPECT_EQ(3u, telemetry_influx.gauges_.size());
+
+  // Percentiles are only reported as absolute values
+  vector<string> payload_split =
+    SplitString(telemetry_influx.MakePayload(), ' ');
+  RemoveWhitespace(&payload_split);
+  ASSERT_EQ(3u, payload_split.size());
+  EXPECT_NE(string::npos, payload_split[1].find("test.hist.n=10"));
+  EXPECT_NE(string::npos, payload_split[1].find("test.hist.p50="));
+  EXPECT_NE(string::npos, payload_split[1].find("test.hist.p99="));
+
+  hist->Add(1000);
+  telemetry_influx.counters_.swap(telemetry_influx.old_counters_);
+  statistics_.SnapshotCounters(&telemetry_influx.counters_,
+                               &telemetry_influx.timestamp_);
+  statistics_.SnapshotGauges(&telemetry_influx.gauges_);
+  vector<string> delta_payload_split =
+    SplitString(telemetry_influx.MakeDeltaPayload(), ' ');
+  ASSERT_EQ(3u, delta_payload_split.size());
+  EXPECT_EQ("test.hist.n=1", delta_payload_split[1]);
+}
+
 }  // END namespace perf
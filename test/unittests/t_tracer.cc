@@ -7,9 +7,11 @@
 #include <pthread.h>
 
 #include <cassert>
+#include <cerrno>
 #include <cstdio>
 
 #include "tracer.h"
+#include "util/platform.h"
 #include "util/posix.h"
 #include "util/string.h"
 
@@ -61,6 +63,38 @@ class T_Tracer : public ::testing::Test {
     unsigned thread_id;
   };
 
+  static void *ThreadLogBinary(void *data) {
+    StartData *sd = reinterpret_cast<StartData *>(data);
+    for (unsigned i = 0; i < sd->iterations; ++i) {
+      TraceGuard guard(sd->tracer, Tracer::kEventLookup, sd->thread_id);
+      if ((i % 2) == 0)
+        guard.Errno(ENOENT);
+    }
+    return NULL;
+  }
+
+  unsigned GetNumBinaryRecords() {
+    int64_t size = GetFileSize(trace_file_);
+    EXPECT_EQ(0, size % sizeof(Tracer::BinaryRecord));
+    return size / sizeof(Tracer::BinaryRecord);
+  }
+
+  string ConvertBinary(Tracer::ConvertFormat format) {
+    FILE *src = fopen(trace_file_.c_str(), "r");
+    assert(src != NULL);
+    FILE *dst = tmpfile();
+    assert(dst != NULL);
+    EXPECT_TRUE(Tracer::ConvertBinary(src, dst, format));
+    fclose(src);
+    rewind(dst);
+    string result;
+    string line;
+    while (GetLineFile(dst, &line))
+      result += line + "\n";
+    fclose(dst);
+    return result;
+  }
+
   Tracer *tracer_;
   string trace_file_;
   pthread_t pthreads_[10];
@@ -313,4 +347,105 @@ TEST_F(T_Tracer, FlushTen) {
   EXPECT_EQ(11002U, GetNol());
 }
 
+
+
+TEST_F(T_Tracer, BinaryMultiThreaded) {
+  tracer_ = new Tracer();
+  tracer_->ActivateBinary(1024, trace_file_);
+  EXPECT_TRUE(tracer_->IsBinary());
+  EXPECT_FALSE(tracer_->IsActive());
+  tracer_->Spawn();
+  // Ignored in binary mode
+  tracer_->Trace(Tracer::kEventOpen, PathString("id"), "test string");
+  for (unsigned i = 0; i < 10; ++i) {
+    inits_[i].tracer = tracer_;
+    inits_[i].iterations = 1000;
+    inits_[i].thread_id = i;
+    int retval = pthread_create(&pthreads_[i], NULL, ThreadLogBinary,
+                                reinterpret_cast<void *>(&inits_[i]));
+    EXPECT_EQ(0, retval);
+  }
+  for (int i = 0; i < 10; i++) {
+    pthread_join(pthreads_[i], NULL);
+  }
+  tracer_->Flush();
+  const int64_t dropped = tracer_->GetNumDropped();
+  delete tracer_;
+  // Header + records
+  EXPECT_EQ(1U + 10000U - dropped, GetNumBinaryRecords());
+}
+
+
+TEST_F(T_Tracer, BinaryDrop) {
+  tracer_ = new Tracer();
+  // Without the flush thread, nothing drains the ring buffer
+  tracer_->ActivateBinary(4, trace_file_);
+  for (unsigned i = 0; i < 10; ++i)
+    tracer_->TraceBinary(Tracer::kEventOpen, i, platform_monotonic_time_ns(),
+                         0);
+  EXPECT_EQ(6, tracer_->GetNumDropped());
+  tracer_->Flush();
+  for (unsigned i = 0; i < 2; ++i)
+    tracer_->TraceBinary(Tracer::kEventOpen, i, platform_monotonic_time_ns(),
+                         0);
+  EXPECT_EQ(6, tracer_->GetNumDropped());
+  delete tracer_;
+  EXPECT_EQ(1U + 6U, GetNumBinaryRecords());
+}
+
+
+TEST_F(T_Tracer, BinaryConvert) {
+  tracer_ = new Tracer();
+  tracer_->ActivateBinary(16, trace_file_);
+  tracer_->Spawn();
+  {
+    TraceGuard guard(tracer_, Tracer::kEventGetAttr, 42);
+  }
+  {
+    TraceGuard guard(tracer_, Tracer::kEventLookup, 1);
+    guard.set_inode(43);
+    EXPECT_EQ(ENOENT, guard.Errno(ENOENT));
+  }
+  delete tracer_;
+  EXPECT_EQ(3U, GetNumBinaryRecords());
+
+  vector<string> lines = SplitString(ConvertBinary(Tracer::kConvertCsv), '\n');
+  ASSERT_EQ(4U, lines.size());
+  EXPECT_EQ("timestamp,event,inode,duration_ns,thread_id,result", lines[0]);
+  vector<string> fields = SplitString(lines[1], ',');
+  ASSERT_EQ(6U, fields.size());
+  EXPECT_EQ("getattr", fields[1]);
+  EXPECT_EQ("42", fields[2]);
+  EXPECT_EQ(StringifyInt(platform_thread_id()), fields[4]);
+  EXPECT_EQ("0", fields[5]);
+  fields = SplitString(lines[2], ',');
+  ASSERT_EQ(6U, fields.size());
+  EXPECT_EQ("lookup", fields[1]);
+  EXPECT_EQ("43", fields[2]);
+  EXPECT_EQ(StringifyInt(-ENOENT), fields[5]);
+  EXPECT_EQ("", lines[3]);
+
+  const string chrome = ConvertBinary(Tracer::kConvertChrome);
+  EXPECT_EQ(0U, chrome.find("{\"traceEvents\":["));
+  EXPECT_NE(string::npos, chrome.find("\"name\":\"getattr\""));
+  EXPECT_NE(string::npos, chrome.find("\"name\":\"lookup\""));
+  EXPECT_NE(string::npos, chrome.find("\"ph\":\"X\""));
+}
+
+
+TEST_F(T_Tracer, BinaryConvertInvalid) {
+  tracer_ = new Tracer();
+  tracer_->Activate(5, 2, trace_file_);
+  tracer_->Spawn();
+  delete tracer_;
+
+  FILE *src = fopen(trace_file_.c_str(), "r");
+  ASSERT_TRUE(src != NULL);
+  FILE *dst = tmpfile();
+  ASSERT_TRUE(dst != NULL);
+  EXPECT_FALSE(Tracer::ConvertBinary(src, dst, Tracer::kConvertCsv));
+  fclose(src);
+  fclose(dst);
+}
+
 }  // namespace tracer
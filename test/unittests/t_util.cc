@@ -6,6 +6,9 @@
 
 #include <alloca.h>
 #include <fcntl.h>
+#ifdef __linux__
+#include <linux/capability.h>
+#endif
 #include <netinet/in.h>
 #include <pthread.h>
 #include <sys/resource.h>
@@ -1996,6 +1999,26 @@ TEST_F(T_Util, GetLimitNoFile) {
 }
 
 
+TEST_F(T_Util, HasEffectiveCapability) {
+  EXPECT_FALSE(HasEffectiveCapability(64));
+#ifdef __linux__
+  struct __user_cap_header_struct header;
+  struct __user_cap_data_struct data[_LINUX_CAPABILITY_U32S_3];
+  header.version = _LINUX_CAPABILITY_VERSION_3;
+  header.pid = 0;
+  ASSERT_EQ(0, syscall(SYS_capget, &header, data));
+  for (unsigned i = 0; i < 64; ++i) {
+    const bool expected = (data[i / 32].effective >> (i % 32)) & 1;
+    EXPECT_EQ(expected, HasEffectiveCapability(i)) << i;
+  }
+  EXPECT_EQ(((data[0].effective >> CAP_SYS_ADMIN) & 1) == 1,
+            HasEffectiveCapability(kCapSysAdmin));
+#else
+  EXPECT_FALSE(HasEffectiveCapability(kCapSysAdmin));
+#endif
+}
+
+
 TEST_F(T_Util, Lsof) {
   std::vector<LsofEntry> list;
   CreateFile("cvmfs_test_lsof", 0600, false /* ignore_failure */);
@@ -2172,3 +2195,37 @@ TEST(Log2Histogram, Quantiles) {
     EXPECT_NEAR(q, expected, max_difference);
   }
 }
+
+
+TEST(Log2Histogram, QuantilesCornerCases) {
+  Log2Histogram log2hist(4);
+  EXPECT_EQ(0U, log2hist.GetQuantile(0.5));
+
+  // Leading empty bins
+  log2hist.Add(5);
+  EXPECT_EQ(4U, log2hist.GetQuantile(0.0));
+  EXPECT_EQ(4U, log2hist.GetQuantile(0.5));
+
+  // Quantiles in the overflow bin are capped at the last boundary
+  for (unsigned i = 0; i < 10; ++i)
+    log2hist.Add(1000);
+  EXPECT_EQ(16U, log2hist.GetQuantile(0.99));
+}
+
+
+TEST(Log2Histogram, Since) {
+  Log2Histogram log2hist(2);
+  log2hist.Add(0);
+  log2hist.Add(3);
+  const Log2Histogram earlier(log2hist);
+  log2hist.Add(1);
+  log2hist.Add(4);
+
+  UTLog2Histogram unit_test;
+  std::vector<atomic_int32> bins = unit_test.GetBins(log2hist.Since(earlier));
+  int res[3] = {1, 1, 0};
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(res[i], atomic_read32(&bins[i]));
+  }
+  EXPECT_EQ(0U, earlier.Since(earlier).N());
+}
@@ -5,6 +5,8 @@
 #include <gtest/gtest.h>
 
 #include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <unistd.h>
 
 #include "util/concurrency.h"
@@ -416,3 +418,64 @@ TEST(T_UtilConcurrency, Signal) {
     pthread_join(thread_signal, NULL);
   }
 }
+
+
+struct EpochLockData {
+  EpochLock *lock;
+  volatile uint64_t first;
+  volatile uint64_t second;
+  atomic_int32 nerrors;
+};
+
+static void *MainEpochReader(void *data) {
+  EpochLockData *d = reinterpret_cast<EpochLockData *>(data);
+  for (unsigned i = 0; i < 100000; ++i) {
+    EpochReadGuard guard(d->lock);
+    if (d->first != d->second)
+      atomic_inc32(&d->nerrors);
+  }
+  return NULL;
+}
+
+static void *MainEpochWriter(void *data) {
+  EpochLockData *d = reinterpret_cast<EpochLockData *>(data);
+  for (unsigned i = 0; i < 1000; ++i) {
+    EpochWriteGuard guard(d->lock);
+    d->first = d->first + 1;
+    d->second = d->second + 1;
+  }
+  return NULL;
+}
+
+TEST(T_UtilConcurrency, EpochLock) {
+  EpochLock lock;
+  {
+    EpochReadGuard guard1(&lock);
+    EpochReadGuard guard2(&lock);
+  }
+  {
+    EpochWriteGuard guard(&lock);
+  }
+
+  EpochLockData data;
+  data.lock = &lock;
+  data.first = data.second = 0;
+  atomic_init32(&data.nerrors);
+
+  const unsigned kNumReaders = 8;
+  pthread_t readers[kNumReaders];
+  pthread_t writer;
+  for (unsigned i = 0; i < kNumReaders; ++i) {
+    int retval = pthread_create(&readers[i], NULL, MainEpochReader, &data);
+    ASSERT_EQ(0, retval);
+  }
+  int retval = pthread_create(&writer, NULL, MainEpochWriter, &data);
+  ASSERT_EQ(0, retval);
+  for (unsigned i = 0; i < kNumReaders; ++i)
+    pthread_join(readers[i], NULL);
+  pthread_join(writer, NULL);
+
+  EXPECT_EQ(0, atomic_read32(&data.nerrors));
+  EXPECT_EQ(1000U, data.first);
+  EXPECT_EQ(1000U, data.second);
+}